@@ -0,0 +1,250 @@
+/*! \file half.h
+
+    \brief 16-bit floating-point storage formats, and conversion to and from float
+
+    These formats exist only for storage.  Arithmetic always happens in float:
+    code unpacks values as it loads them, then accumulates at full precision.
+    Halving the bytes per value halves the memory bandwidth consumed by
+    routines which stream large arrays, such as those which sample grids.
+
+    Two formats are available:
+
+        -   IEEE 754 binary16 ("half") has 11 significant bits, i.e. about
+            3 decimal digits, but its range spans only about 6e-5 to 65504.
+
+        -   bfloat16 has only 8 significant bits, i.e. about 2 decimal digits,
+            but it has the same range as float, since it is simply the upper
+            half of a float.
+
+    \author Copyright 2009 Dr. Michael Jason Gourlay; All rights reserved.
+*/
+#ifndef HALF_H
+#define HALF_H
+
+#include "Core/Math/simd.h"
+
+// Macros --------------------------------------------------------------
+
+/*! \brief Whether the target converts IEEE half-precision values in hardware (F16C)
+*/
+#if SIMD_SSE && defined( __F16C__ )
+    #define SIMD_F16C 1
+    #include <immintrin.h>
+#else
+    #define SIMD_F16C 0
+#endif
+
+// Types --------------------------------------------------------------
+
+/*! \brief Number format in which to store floating-point values
+*/
+enum StoragePrecision
+{
+    STORAGE_FLOAT32     ,   ///< IEEE 754 binary32, i.e. float.  Exact.
+    STORAGE_FLOAT16     ,   ///< IEEE 754 binary16.  More precise than bfloat16 but values must lie within +/-65504.
+    STORAGE_BFLOAT16        ///< Upper 16 bits of float.  Less precise than float16 but with the same range as float.
+} ;
+
+
+
+
+/*! \brief Four floats, each stored in 16 bits, in a format chosen by the caller
+
+    Four values occupy 8 bytes, which a single load can bring into a 4-lane packet.
+    So a 3-vector stored this way occupies 8 bytes instead of the 12 of a Vec3,
+    and has a spare component in which to store some other scalar.
+
+    \see Pack, Unpack
+*/
+struct PackedFloat4
+{
+    unsigned short  mV[ 4 ] ;   ///< 16-bit values, in the format given to Pack
+} ;
+
+/*! \brief Bits of a float, for converting between formats without violating aliasing rules
+*/
+union FloatBits
+{
+    float       f ;
+    unsigned    u ;
+} ;
+
+// Public variables --------------------------------------------------------------
+// Public functions --------------------------------------------------------------
+
+/*! \brief Convert float to IEEE half-precision, rounding to nearest even
+
+    Values too large for half precision become infinity, and values too
+    small for a normalized half become denormalized halves or zero.
+
+    \see Fabian Giesen: "float->half variants", float_to_half_fast3_rtne.
+*/
+inline unsigned short FloatToHalf( const float & f )
+{
+    static const unsigned   f32Infinity = 255 << 23 ;
+    static const unsigned   f16Overflow = ( 127 + 16 ) << 23 ;  // 2^16.  Floats this large, and some just below it, round to infinity.
+    static const unsigned   f16MinNorm  = ( 127 - 14 ) << 23 ;  // 2^-14, the smallest normalized half.
+    FloatBits               denormMagic ;
+    denormMagic.u = ( ( 127 - 15 ) + ( 23 - 10 ) + 1 ) << 23 ;
+    FloatBits               bits ;
+    bits.f = f ;
+    const unsigned          sign        = bits.u & 0x80000000 ;
+    unsigned short          result ;
+
+    bits.u ^= sign ;
+    if( bits.u >= f16Overflow )
+    {   // Result is infinity or NaN.  All NaNs become quiet NaNs.
+        result = ( bits.u > f32Infinity ) ? 0x7e00 : 0x7c00 ;
+    }
+    else if( bits.u < f16MinNorm )
+    {   // Result is denormalized or zero.
+        // Adding a magic number makes the FPU align and round the mantissa.
+        bits.f += denormMagic.f ;
+        result = (unsigned short)( bits.u - denormMagic.u ) ;
+    }
+    else
+    {   // Result is normalized.
+        const unsigned mantissaOdd = ( bits.u >> 13 ) & 1 ;
+        bits.u += ( unsigned( 15 - 127 ) << 23 ) + 0xfff ;  // Rebias exponent and round.
+        bits.u += mantissaOdd ;                             // Break ties toward even.
+        result = (unsigned short)( bits.u >> 13 ) ;
+    }
+    return result | (unsigned short)( sign >> 16 ) ;
+}
+
+
+
+
+/*! \brief Convert IEEE half-precision to float
+
+    Every half value, including denormals, infinities and NaNs, has an exact float equivalent.
+*/
+inline float HalfToFloat( const unsigned short & h )
+{
+    static const unsigned   shiftedExp  = 0x7c00 << 13 ;    // Exponent mask after shift
+    FloatBits               magic ;
+    magic.u = ( 127 - 14 ) << 23 ;                          // 2^-14, the smallest normalized half.
+    FloatBits               bits ;
+    bits.u = ( h & 0x7fff ) << 13 ;                         // Exponent and mantissa bits
+    const unsigned          exponent    = shiftedExp & bits.u ;
+
+    bits.u += ( 127 - 15 ) << 23 ;  // Rebias exponent.
+    if( shiftedExp == exponent )
+    {   // Infinity or NaN: Push exponent up to that of float.
+        bits.u += ( 128 - 16 ) << 23 ;
+    }
+    else if( 0 == exponent )
+    {   // Zero or denormal: Renormalize.
+        bits.u += 1 << 23 ;
+        bits.f -= magic.f ;
+    }
+    bits.u |= ( h & 0x8000 ) << 16 ;    // Sign bit
+    return bits.f ;
+}
+
+
+
+
+/*! \brief Convert float to bfloat16, rounding to nearest even
+*/
+inline unsigned short FloatToBFloat16( const float & f )
+{
+    FloatBits bits ;
+    bits.f = f ;
+    if( ( bits.u & 0x7fffffff ) > 0x7f800000 )
+    {   // NaN.  Keep it a (quiet) NaN, which truncation might otherwise turn into infinity.
+        return (unsigned short)( ( bits.u >> 16 ) | 0x40 ) ;
+    }
+    bits.u += 0x7fff + ( ( bits.u >> 16 ) & 1 ) ;  // Round, breaking ties toward even.
+    return (unsigned short)( bits.u >> 16 ) ;
+}
+
+
+
+
+/*! \brief Convert bfloat16 to float
+*/
+inline float BFloat16ToFloat( const unsigned short & b )
+{
+    FloatBits bits ;
+    bits.u = unsigned( b ) << 16 ;
+    return bits.f ;
+}
+
+
+
+
+/*! \brief Store four floats in the given 16-bit format
+
+    \param rPacked - (out) packed values
+
+    \param x, y, z, w - values to pack
+
+    \param format - STORAGE_FLOAT16 or STORAGE_BFLOAT16.
+*/
+inline void Pack( PackedFloat4 & rPacked , float x , float y , float z , float w , StoragePrecision format )
+{
+    if( STORAGE_FLOAT16 == format )
+    {
+        rPacked.mV[ 0 ] = FloatToHalf( x ) ;
+        rPacked.mV[ 1 ] = FloatToHalf( y ) ;
+        rPacked.mV[ 2 ] = FloatToHalf( z ) ;
+        rPacked.mV[ 3 ] = FloatToHalf( w ) ;
+    }
+    else
+    {
+        rPacked.mV[ 0 ] = FloatToBFloat16( x ) ;
+        rPacked.mV[ 1 ] = FloatToBFloat16( y ) ;
+        rPacked.mV[ 2 ] = FloatToBFloat16( z ) ;
+        rPacked.mV[ 3 ] = FloatToBFloat16( w ) ;
+    }
+}
+
+
+
+
+/*! \brief Load four 16-bit values into a packet of floats
+
+    \param packed - values stored by Pack
+
+    \param format - format given to Pack
+
+    \return packet whose lane i holds value i.
+
+    This uses a single hardware conversion when the target supports it:
+    F16C for half precision, and an integer unpack for bfloat16, which
+    merely places each value in the upper half of a float lane.
+*/
+inline Float4 Unpack( const PackedFloat4 & packed , StoragePrecision format )
+{
+#if SIMD_SSE
+    const __m128i bits = _mm_loadl_epi64( reinterpret_cast< const __m128i * >( packed.mV ) ) ;
+    if( STORAGE_BFLOAT16 == format )
+    {
+        return _mm_castsi128_ps( _mm_unpacklo_epi16( _mm_setzero_si128() , bits ) ) ;
+    }
+    #if SIMD_F16C
+    return _mm_cvtph_ps( bits ) ;
+    #endif
+#endif
+    Float4 result ;
+    for( unsigned i = 0 ; i < 4 ; ++ i )
+    {
+        result.SetLane( i , ( STORAGE_FLOAT16 == format ) ? HalfToFloat( packed.mV[ i ] ) : BFloat16ToFloat( packed.mV[ i ] ) ) ;
+    }
+    return result ;
+}
+
+
+
+
+/*! \brief Function object that unpacks values for UniformGrid::InterpolateConverted
+*/
+struct UnpackFloat4
+{
+    UnpackFloat4( StoragePrecision format ) : mFormat( format ) {}
+    Float4 operator()( const PackedFloat4 & packed ) const { return Unpack( packed , mFormat ) ; }
+    StoragePrecision mFormat ;  ///< Format in which values were packed
+} ;
+
+#endif
@@ -57,7 +57,7 @@ struct Mat33
         */
         Vec3 operator* ( const Vec3 & v3 ) const
         {
-            return Vec3( Vec3( x.x , y.x , z.x ) * v3 , Vec3( x.y , y.y , z.y ) * v3 , Vec3( z.z , y.z , z.z ) * v3 ) ;
+            return Vec3( Vec3( x.x , y.x , z.x ) * v3 , Vec3( x.y , y.y , z.y ) * v3 , Vec3( x.z , y.z , z.z ) * v3 ) ;
         }
 
 
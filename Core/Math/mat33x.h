@@ -0,0 +1,103 @@
+/*! \file mat33x.h
+
+    \brief Packets of 3x3 matrices, stored as one Vec3xN per row
+
+    \author Copyright 2005-2009 UCF/FIEA/MJG; All rights reserved.
+*/
+#ifndef MAT33X_H
+#define MAT33X_H
+
+#include "Core/Math/mat33.h"
+#include "Core/Math/vec3x.h"
+
+// Macros --------------------------------------------------------------
+// Types --------------------------------------------------------------
+
+/*! \brief Packet of 3x3 matrices, with the same row layout and operators as Mat33
+
+    \param FloatT - packet type for each element, e.g. Float4.
+*/
+template< class FloatT > struct Mat33xN
+{
+    public:
+        typedef Vec3xN< FloatT > Vec3x ;
+        enum { NumLanes = FloatT::NumLanes } ;
+
+        Mat33xN() {}
+        Mat33xN( const Vec3x & x0 , const Vec3x & y0 , const Vec3x & z0 )
+            : x( x0 )
+            , y( y0 )
+            , z( z0 )
+        {
+        }
+
+        //! \brief Broadcast a matrix into every lane
+        explicit Mat33xN( const Mat33 & m )
+            : x( m.x )
+            , y( m.y )
+            , z( m.z )
+        {
+        }
+
+        //! \brief Return matrix in lane i
+        Mat33 GetLane( unsigned i ) const               { return Mat33( x.GetLane( i ) , y.GetLane( i ) , z.GetLane( i ) ) ; }
+        //! \brief Assign matrix in lane i
+        void SetLane( unsigned i , const Mat33 & m )    { x.SetLane( i , m.x ) ; y.SetLane( i , m.y ) ; z.SetLane( i , m.z ) ; }
+
+        // unary operators
+        Mat33xN operator - () const                     { return Mat33xN( -x , -y , -z ) ; }
+
+        // binary operators
+        Mat33xN operator + ( const Mat33xN & that ) const   { return Mat33xN( x + that.x , y + that.y , z + that.z ) ; }
+        Mat33xN operator - ( const Mat33xN & that ) const   { return Mat33xN( x - that.x , y - that.y , z - that.z ) ; }
+        Mat33xN operator * ( const FloatT & f ) const       { return Mat33xN( x * f , y * f , z * f ) ; }
+        Mat33xN operator / ( const FloatT & f ) const       { return (*this) * ( FloatT( 1.0f ) / f ) ; }
+        friend Mat33xN operator * ( const FloatT & f , const Mat33xN & x33 ) { return x33 * f ; }
+
+        /*! \brief Transform vectors by the transpose of these matrices
+            \param v3 - Vectors to transform
+        */
+        Vec3x operator* ( const Vec3x & v3 ) const
+        {
+            return Vec3x( GetCol0() * v3 , GetCol1() * v3 , GetCol2() * v3 ) ;
+        }
+
+        /*! \brief Transform vectors by matrices
+            \param v3 - Vectors to transform
+            \param x33 - Transformation matrices
+        */
+        friend Vec3x operator* ( const Vec3x & v3 , const Mat33xN & x33 )
+        {
+            return Vec3x( x33.x * v3 , x33.y * v3 , x33.z * v3 ) ;
+        }
+
+        Mat33xN operator*( const Mat33xN & that ) const    // Matrix-matrix multiplication
+        {
+            const Vec3x c0 = that.GetCol0() ;
+            const Vec3x c1 = that.GetCol1() ;
+            const Vec3x c2 = that.GetCol2() ;
+            return Mat33xN( Vec3x( x * c0 , x * c1 , x * c2 ) ,
+                            Vec3x( y * c0 , y * c1 , y * c2 ) ,
+                            Vec3x( z * c0 , z * c1 , z * c2 ) ) ;
+        }
+
+        /*! \brief Return column vectors
+        */
+        Vec3x GetCol0( void ) const { return Vec3x( x.x , y.x , z.x ) ; }
+        Vec3x GetCol1( void ) const { return Vec3x( x.y , y.y , z.y ) ; }
+        Vec3x GetCol2( void ) const { return Vec3x( x.z , y.z , z.z ) ; }
+
+        Vec3x x ;
+        Vec3x y ;
+        Vec3x z ;
+} ;
+
+typedef Mat33xN< Float4 >       Mat33x4 ;
+typedef Mat33xN< Float8 >       Mat33x8 ;
+typedef Mat33xN< Float16 >      Mat33x16 ;
+typedef Mat33xN< FloatNative >  Mat33xNative ;
+
+// Public variables --------------------------------------------------------------
+// Public functions --------------------------------------------------------------
+
+#endif
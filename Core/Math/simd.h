@@ -0,0 +1,540 @@
+/*! \file simd.h
+
+    \brief Packets of floats and lane masks, for processing several elements at once
+
+    Each packet type holds N float lanes and supports the same arithmetic
+    vocabulary as a scalar float, so a kernel written for "float" can be
+    rewritten for FloatN by changing types, and the rest of the code reads the same.
+
+    Packets map onto SSE (4 lanes), AVX (8 lanes) and AVX-512 (16 lanes) registers
+    when the compiler targets those instruction sets.  Any width without native
+    support falls back to a plain array of floats, processed one lane at a time,
+    which the compiler may still choose to vectorize.
+
+    \note Compare operators return masks, not bools.  Use Select to blend packets
+            by mask, and Any / All / Bits to branch on the outcome of a comparison.
+
+    \author Copyright 2005-2009 UCF/FIEA/MJG; All rights reserved.
+*/
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <math.h>
+
+#include "Core/Math/math.h"
+
+// Macros --------------------------------------------------------------
+
+/*! \brief Whether to ignore SIMD instruction sets and use only the scalar fallback
+
+    Set this to 1 to compare SIMD results against the scalar reference implementation.
+*/
+#if ! defined( SIMD_DISABLE )
+    #define SIMD_DISABLE 0
+#endif
+
+#if ! SIMD_DISABLE
+    #if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && ( _M_IX86_FP >= 2 ) )
+        #define SIMD_SSE 1
+        #include <emmintrin.h>
+    #endif
+    #if defined( __AVX__ )
+        #define SIMD_AVX 1
+        #include <immintrin.h>
+    #endif
+    #if defined( __AVX512F__ )
+        #define SIMD_AVX512 1
+        #include <immintrin.h>
+    #endif
+    #if defined( __FMA__ ) || defined( __AVX2__ )
+        #define SIMD_FMA 1
+    #endif
+#endif
+
+#if ! defined( SIMD_SSE )
+    #define SIMD_SSE 0
+#endif
+#if ! defined( SIMD_AVX )
+    #define SIMD_AVX 0
+#endif
+#if ! defined( SIMD_AVX512 )
+    #define SIMD_AVX512 0
+#endif
+#if ! defined( SIMD_FMA )
+    #define SIMD_FMA 0
+#endif
+
+/*! \brief Number of float lanes in the widest packet the target supports natively
+*/
+#if SIMD_AVX512
+    #define SIMD_NATIVE_WIDTH 16
+#elif SIMD_AVX
+    #define SIMD_NATIVE_WIDTH 8
+#else
+    #define SIMD_NATIVE_WIDTH 4
+#endif
+
+// Types --------------------------------------------------------------
+
+/*! \brief Set of N boolean lanes, as produced by comparing packets
+
+    This generic version stores one bit per lane.
+*/
+template< unsigned N > struct MaskN
+{
+    public:
+        MaskN() {}
+        explicit MaskN( unsigned bits ) : mBits( bits & AllBits() ) {}
+
+        MaskN operator & ( const MaskN & rhs ) const    { return MaskN( mBits & rhs.mBits ) ; }
+        MaskN operator | ( const MaskN & rhs ) const    { return MaskN( mBits | rhs.mBits ) ; }
+        MaskN operator ^ ( const MaskN & rhs ) const    { return MaskN( mBits ^ rhs.mBits ) ; }
+        MaskN operator ~ () const                       { return MaskN( ~ mBits ) ; }
+
+        //! \brief Return whether lane i is set
+        bool        operator[]( unsigned i ) const      { return ( mBits >> i ) & 1 ; }
+
+        //! \brief Return one bit per lane, lane 0 in the least significant bit
+        unsigned    Bits() const                        { return mBits ; }
+        bool        Any() const                         { return mBits != 0 ; }
+        bool        All() const                         { return mBits == AllBits() ; }
+        bool        None() const                        { return mBits == 0 ; }
+
+        static unsigned AllBits()                       { return ( N >= 32 ) ? ~ 0u : ( ( 1u << N ) - 1 ) ; }
+
+        unsigned    mBits ; ///< One bit per lane
+} ;
+
+
+
+
+/*! \brief Packet of N floats
+
+    This generic version stores a plain array and processes one lane at a time.
+*/
+template< unsigned N > struct FloatN
+{
+    public:
+        typedef MaskN< N > Mask ;
+        enum { NumLanes = N } ;
+
+        FloatN() {}
+
+        //! \brief Broadcast a scalar into every lane
+        FloatN( float f )                               { for( unsigned i = 0 ; i < N ; ++ i ) mV[ i ] = f ; }
+
+        //! \brief Load N contiguous floats from an address aligned to the packet size
+        static FloatN Load( const float * p )           { return LoadUnaligned( p ) ; }
+        //! \brief Load N contiguous floats from any address
+        static FloatN LoadUnaligned( const float * p )  { FloatN r ; for( unsigned i = 0 ; i < N ; ++ i ) r.mV[ i ] = p[ i ] ; return r ; }
+        //! \brief Store N contiguous floats to an address aligned to the packet size
+        void Store( float * p ) const                   { StoreUnaligned( p ) ; }
+        //! \brief Store N contiguous floats to any address
+        void StoreUnaligned( float * p ) const          { for( unsigned i = 0 ; i < N ; ++ i ) p[ i ] = mV[ i ] ; }
+
+        //! \brief Return value of lane i
+        float operator[]( unsigned i ) const            { return mV[ i ] ; }
+        //! \brief Assign value of lane i
+        void SetLane( unsigned i , float f )            { mV[ i ] = f ; }
+
+        FloatN & operator += ( const FloatN & rhs )     { for( unsigned i = 0 ; i < N ; ++ i ) mV[ i ] += rhs.mV[ i ] ; return * this ; }
+        FloatN & operator -= ( const FloatN & rhs )     { for( unsigned i = 0 ; i < N ; ++ i ) mV[ i ] -= rhs.mV[ i ] ; return * this ; }
+        FloatN & operator *= ( const FloatN & rhs )     { for( unsigned i = 0 ; i < N ; ++ i ) mV[ i ] *= rhs.mV[ i ] ; return * this ; }
+        FloatN & operator /= ( const FloatN & rhs )     { for( unsigned i = 0 ; i < N ; ++ i ) mV[ i ] /= rhs.mV[ i ] ; return * this ; }
+
+        FloatN operator - () const                      { FloatN r ; for( unsigned i = 0 ; i < N ; ++ i ) r.mV[ i ] = - mV[ i ] ; return r ; }
+        FloatN operator + ( const FloatN & rhs ) const  { FloatN r( * this ) ; return r += rhs ; }
+        FloatN operator - ( const FloatN & rhs ) const  { FloatN r( * this ) ; return r -= rhs ; }
+        FloatN operator * ( const FloatN & rhs ) const  { FloatN r( * this ) ; return r *= rhs ; }
+        FloatN operator / ( const FloatN & rhs ) const  { FloatN r( * this ) ; return r /= rhs ; }
+
+        Mask operator <  ( const FloatN & rhs ) const   { unsigned b = 0 ; for( unsigned i = 0 ; i < N ; ++ i ) b |= unsigned( mV[ i ] <  rhs.mV[ i ] ) << i ; return Mask( b ) ; }
+        Mask operator <= ( const FloatN & rhs ) const   { unsigned b = 0 ; for( unsigned i = 0 ; i < N ; ++ i ) b |= unsigned( mV[ i ] <= rhs.mV[ i ] ) << i ; return Mask( b ) ; }
+        Mask operator >  ( const FloatN & rhs ) const   { return rhs <  * this ; }
+        Mask operator >= ( const FloatN & rhs ) const   { return rhs <= * this ; }
+
+        float mV[ N ] ; ///< Lane values
+} ;
+
+#if SIMD_SSE
+
+/*! \brief Mask of 4 lanes, stored as SSE comparison result (all-ones or all-zeros per lane)
+*/
+template<> struct MaskN< 4 >
+{
+    public:
+        MaskN() {}
+        explicit MaskN( __m128 v ) : mV( v ) {}
+
+        MaskN operator & ( const MaskN & rhs ) const    { return MaskN( _mm_and_ps( mV , rhs.mV ) ) ; }
+        MaskN operator | ( const MaskN & rhs ) const    { return MaskN( _mm_or_ps( mV , rhs.mV ) ) ; }
+        MaskN operator ^ ( const MaskN & rhs ) const    { return MaskN( _mm_xor_ps( mV , rhs.mV ) ) ; }
+        MaskN operator ~ () const                       { return MaskN( _mm_xor_ps( mV , _mm_castsi128_ps( _mm_set1_epi32( -1 ) ) ) ) ; }
+
+        bool        operator[]( unsigned i ) const      { return ( Bits() >> i ) & 1 ; }
+        unsigned    Bits() const                        { return _mm_movemask_ps( mV ) ; }
+        bool        Any() const                         { return Bits() != 0 ; }
+        bool        All() const                         { return Bits() == 0xf ; }
+        bool        None() const                        { return Bits() == 0 ; }
+
+        __m128      mV ;
+} ;
+
+
+
+
+/*! \brief Packet of 4 floats in an SSE register
+*/
+template<> struct FloatN< 4 >
+{
+    public:
+        typedef MaskN< 4 > Mask ;
+        enum { NumLanes = 4 } ;
+
+        FloatN() {}
+        FloatN( float f ) : mV( _mm_set1_ps( f ) ) {}
+        FloatN( __m128 v ) : mV( v ) {}
+
+        static FloatN Load( const float * p )           { return _mm_load_ps( p ) ; }
+        static FloatN LoadUnaligned( const float * p )  { return _mm_loadu_ps( p ) ; }
+        void Store( float * p ) const                   { _mm_store_ps( p , mV ) ; }
+        void StoreUnaligned( float * p ) const          { _mm_storeu_ps( p , mV ) ; }
+
+        float operator[]( unsigned i ) const            { return reinterpret_cast< const float * >( & mV )[ i ] ; }
+        void SetLane( unsigned i , float f )            { reinterpret_cast< float * >( & mV )[ i ] = f ; }
+
+        FloatN & operator += ( const FloatN & rhs )     { mV = _mm_add_ps( mV , rhs.mV ) ; return * this ; }
+        FloatN & operator -= ( const FloatN & rhs )     { mV = _mm_sub_ps( mV , rhs.mV ) ; return * this ; }
+        FloatN & operator *= ( const FloatN & rhs )     { mV = _mm_mul_ps( mV , rhs.mV ) ; return * this ; }
+        FloatN & operator /= ( const FloatN & rhs )     { mV = _mm_div_ps( mV , rhs.mV ) ; return * this ; }
+
+        FloatN operator - () const                      { return _mm_xor_ps( mV , _mm_set1_ps( -0.0f ) ) ; }
+        FloatN operator + ( const FloatN & rhs ) const  { return _mm_add_ps( mV , rhs.mV ) ; }
+        FloatN operator - ( const FloatN & rhs ) const  { return _mm_sub_ps( mV , rhs.mV ) ; }
+        FloatN operator * ( const FloatN & rhs ) const  { return _mm_mul_ps( mV , rhs.mV ) ; }
+        FloatN operator / ( const FloatN & rhs ) const  { return _mm_div_ps( mV , rhs.mV ) ; }
+
+        Mask operator <  ( const FloatN & rhs ) const   { return Mask( _mm_cmplt_ps( mV , rhs.mV ) ) ; }
+        Mask operator <= ( const FloatN & rhs ) const   { return Mask( _mm_cmple_ps( mV , rhs.mV ) ) ; }
+        Mask operator >  ( const FloatN & rhs ) const   { return Mask( _mm_cmpgt_ps( mV , rhs.mV ) ) ; }
+        Mask operator >= ( const FloatN & rhs ) const   { return Mask( _mm_cmpge_ps( mV , rhs.mV ) ) ; }
+
+        __m128 mV ;
+} ;
+
+#endif
+
+#if SIMD_AVX
+
+/*! \brief Mask of 8 lanes, stored as AVX comparison result
+*/
+template<> struct MaskN< 8 >
+{
+    public:
+        MaskN() {}
+        explicit MaskN( __m256 v ) : mV( v ) {}
+
+        MaskN operator & ( const MaskN & rhs ) const    { return MaskN( _mm256_and_ps( mV , rhs.mV ) ) ; }
+        MaskN operator | ( const MaskN & rhs ) const    { return MaskN( _mm256_or_ps( mV , rhs.mV ) ) ; }
+        MaskN operator ^ ( const MaskN & rhs ) const    { return MaskN( _mm256_xor_ps( mV , rhs.mV ) ) ; }
+        MaskN operator ~ () const                       { return MaskN( _mm256_xor_ps( mV , _mm256_castsi256_ps( _mm256_set1_epi32( -1 ) ) ) ) ; }
+
+        bool        operator[]( unsigned i ) const      { return ( Bits() >> i ) & 1 ; }
+        unsigned    Bits() const                        { return _mm256_movemask_ps( mV ) ; }
+        bool        Any() const                         { return Bits() != 0 ; }
+        bool        All() const                         { return Bits() == 0xff ; }
+        bool        None() const                        { return Bits() == 0 ; }
+
+        __m256      mV ;
+} ;
+
+
+
+
+/*! \brief Packet of 8 floats in an AVX register
+*/
+template<> struct FloatN< 8 >
+{
+    public:
+        typedef MaskN< 8 > Mask ;
+        enum { NumLanes = 8 } ;
+
+        FloatN() {}
+        FloatN( float f ) : mV( _mm256_set1_ps( f ) ) {}
+        FloatN( __m256 v ) : mV( v ) {}
+
+        static FloatN Load( const float * p )           { return _mm256_load_ps( p ) ; }
+        static FloatN LoadUnaligned( const float * p )  { return _mm256_loadu_ps( p ) ; }
+        void Store( float * p ) const                   { _mm256_store_ps( p , mV ) ; }
+        void StoreUnaligned( float * p ) const          { _mm256_storeu_ps( p , mV ) ; }
+
+        float operator[]( unsigned i ) const            { return reinterpret_cast< const float * >( & mV )[ i ] ; }
+        void SetLane( unsigned i , float f )            { reinterpret_cast< float * >( & mV )[ i ] = f ; }
+
+        FloatN & operator += ( const FloatN & rhs )     { mV = _mm256_add_ps( mV , rhs.mV ) ; return * this ; }
+        FloatN & operator -= ( const FloatN & rhs )     { mV = _mm256_sub_ps( mV , rhs.mV ) ; return * this ; }
+        FloatN & operator *= ( const FloatN & rhs )     { mV = _mm256_mul_ps( mV , rhs.mV ) ; return * this ; }
+        FloatN & operator /= ( const FloatN & rhs )     { mV = _mm256_div_ps( mV , rhs.mV ) ; return * this ; }
+
+        FloatN operator - () const                      { return _mm256_xor_ps( mV , _mm256_set1_ps( -0.0f ) ) ; }
+        FloatN operator + ( const FloatN & rhs ) const  { return _mm256_add_ps( mV , rhs.mV ) ; }
+        FloatN operator - ( const FloatN & rhs ) const  { return _mm256_sub_ps( mV , rhs.mV ) ; }
+        FloatN operator * ( const FloatN & rhs ) const  { return _mm256_mul_ps( mV , rhs.mV ) ; }
+        FloatN operator / ( const FloatN & rhs ) const  { return _mm256_div_ps( mV , rhs.mV ) ; }
+
+        Mask operator <  ( const FloatN & rhs ) const   { return Mask( _mm256_cmp_ps( mV , rhs.mV , _CMP_LT_OQ ) ) ; }
+        Mask operator <= ( const FloatN & rhs ) const   { return Mask( _mm256_cmp_ps( mV , rhs.mV , _CMP_LE_OQ ) ) ; }
+        Mask operator >  ( const FloatN & rhs ) const   { return Mask( _mm256_cmp_ps( mV , rhs.mV , _CMP_GT_OQ ) ) ; }
+        Mask operator >= ( const FloatN & rhs ) const   { return Mask( _mm256_cmp_ps( mV , rhs.mV , _CMP_GE_OQ ) ) ; }
+
+        __m256 mV ;
+} ;
+
+#endif
+
+#if SIMD_AVX512
+
+/*! \brief Mask of 16 lanes, stored in an AVX-512 mask register
+*/
+template<> struct MaskN< 16 >
+{
+    public:
+        MaskN() {}
+        explicit MaskN( __mmask16 k ) : mK( k ) {}
+
+        MaskN operator & ( const MaskN & rhs ) const    { return MaskN( __mmask16( mK & rhs.mK ) ) ; }
+        MaskN operator | ( const MaskN & rhs ) const    { return MaskN( __mmask16( mK | rhs.mK ) ) ; }
+        MaskN operator ^ ( const MaskN & rhs ) const    { return MaskN( __mmask16( mK ^ rhs.mK ) ) ; }
+        MaskN operator ~ () const                       { return MaskN( __mmask16( ~ mK ) ) ; }
+
+        bool        operator[]( unsigned i ) const      { return ( Bits() >> i ) & 1 ; }
+        unsigned    Bits() const                        { return mK ; }
+        bool        Any() const                         { return mK != 0 ; }
+        bool        All() const                         { return mK == 0xffff ; }
+        bool        None() const                        { return mK == 0 ; }
+
+        __mmask16   mK ;
+} ;
+
+
+
+
+/*! \brief Packet of 16 floats in an AVX-512 register
+*/
+template<> struct FloatN< 16 >
+{
+    public:
+        typedef MaskN< 16 > Mask ;
+        enum { NumLanes = 16 } ;
+
+        FloatN() {}
+        FloatN( float f ) : mV( _mm512_set1_ps( f ) ) {}
+        FloatN( __m512 v ) : mV( v ) {}
+
+        static FloatN Load( const float * p )           { return _mm512_load_ps( p ) ; }
+        static FloatN LoadUnaligned( const float * p )  { return _mm512_loadu_ps( p ) ; }
+        void Store( float * p ) const                   { _mm512_store_ps( p , mV ) ; }
+        void StoreUnaligned( float * p ) const          { _mm512_storeu_ps( p , mV ) ; }
+
+        float operator[]( unsigned i ) const            { return reinterpret_cast< const float * >( & mV )[ i ] ; }
+        void SetLane( unsigned i , float f )            { reinterpret_cast< float * >( & mV )[ i ] = f ; }
+
+        FloatN & operator += ( const FloatN & rhs )     { mV = _mm512_add_ps( mV , rhs.mV ) ; return * this ; }
+        FloatN & operator -= ( const FloatN & rhs )     { mV = _mm512_sub_ps( mV , rhs.mV ) ; return * this ; }
+        FloatN & operator *= ( const FloatN & rhs )     { mV = _mm512_mul_ps( mV , rhs.mV ) ; return * this ; }
+        FloatN & operator /= ( const FloatN & rhs )     { mV = _mm512_div_ps( mV , rhs.mV ) ; return * this ; }
+
+        FloatN operator - () const                      { return _mm512_sub_ps( _mm512_setzero_ps() , mV ) ; }
+        FloatN operator + ( const FloatN & rhs ) const  { return _mm512_add_ps( mV , rhs.mV ) ; }
+        FloatN operator - ( const FloatN & rhs ) const  { return _mm512_sub_ps( mV , rhs.mV ) ; }
+        FloatN operator * ( const FloatN & rhs ) const  { return _mm512_mul_ps( mV , rhs.mV ) ; }
+        FloatN operator / ( const FloatN & rhs ) const  { return _mm512_div_ps( mV , rhs.mV ) ; }
+
+        Mask operator <  ( const FloatN & rhs ) const   { return Mask( _mm512_cmp_ps_mask( mV , rhs.mV , _CMP_LT_OQ ) ) ; }
+        Mask operator <= ( const FloatN & rhs ) const   { return Mask( _mm512_cmp_ps_mask( mV , rhs.mV , _CMP_LE_OQ ) ) ; }
+        Mask operator >  ( const FloatN & rhs ) const   { return Mask( _mm512_cmp_ps_mask( mV , rhs.mV , _CMP_GT_OQ ) ) ; }
+        Mask operator >= ( const FloatN & rhs ) const   { return Mask( _mm512_cmp_ps_mask( mV , rhs.mV , _CMP_GE_OQ ) ) ; }
+
+        __m512 mV ;
+} ;
+
+#endif
+
+typedef FloatN< 4 >     Float4 ;
+typedef FloatN< 8 >     Float8 ;
+typedef FloatN< 16 >    Float16 ;
+typedef MaskN< 4 >      Mask4 ;
+typedef MaskN< 8 >      Mask8 ;
+typedef MaskN< 16 >     Mask16 ;
+
+//! \brief Widest packet the target supports natively
+typedef FloatN< SIMD_NATIVE_WIDTH > FloatNative ;
+
+// Public variables --------------------------------------------------------------
+// Public functions --------------------------------------------------------------
+
+/*! \brief Return packet whose lanes come from a where mask is set and from b elsewhere
+*/
+template< unsigned N > inline FloatN< N > Select( const MaskN< N > & mask , const FloatN< N > & a , const FloatN< N > & b )
+{
+    FloatN< N > r ;
+    for( unsigned i = 0 ; i < N ; ++ i ) r.mV[ i ] = mask[ i ] ? a.mV[ i ] : b.mV[ i ] ;
+    return r ;
+}
+
+template< unsigned N > inline FloatN< N > Min( const FloatN< N > & a , const FloatN< N > & b )
+{
+    FloatN< N > r ;
+    for( unsigned i = 0 ; i < N ; ++ i ) r.mV[ i ] = MIN2( a.mV[ i ] , b.mV[ i ] ) ;
+    return r ;
+}
+
+template< unsigned N > inline FloatN< N > Max( const FloatN< N > & a , const FloatN< N > & b )
+{
+    FloatN< N > r ;
+    for( unsigned i = 0 ; i < N ; ++ i ) r.mV[ i ] = MAX2( a.mV[ i ] , b.mV[ i ] ) ;
+    return r ;
+}
+
+template< unsigned N > inline FloatN< N > FAbs( const FloatN< N > & a )
+{
+    FloatN< N > r ;
+    for( unsigned i = 0 ; i < N ; ++ i ) r.mV[ i ] = FAbs( a.mV[ i ] ) ;
+    return r ;
+}
+
+template< unsigned N > inline FloatN< N > Sqrt( const FloatN< N > & a )
+{
+    FloatN< N > r ;
+    for( unsigned i = 0 ; i < N ; ++ i ) r.mV[ i ] = sqrtf( a.mV[ i ] ) ;
+    return r ;
+}
+
+//! \brief Reciprocal square root of each lane; see scalar finvsqrtf
+template< unsigned N > inline FloatN< N > finvsqrtf( const FloatN< N > & a )
+{
+    FloatN< N > r ;
+    for( unsigned i = 0 ; i < N ; ++ i ) r.mV[ i ] = finvsqrtf( a.mV[ i ] ) ;
+    return r ;
+}
+
+//! \brief Return a * b + c, fused where the target supports it
+template< unsigned N > inline FloatN< N > MultiplyAdd( const FloatN< N > & a , const FloatN< N > & b , const FloatN< N > & c )
+{
+    return a * b + c ;
+}
+
+//! \brief Return sum of all lanes
+template< unsigned N > inline float HorizontalSum( const FloatN< N > & a )
+{
+    float sum = 0.0f ;
+    for( unsigned i = 0 ; i < N ; ++ i ) sum += a.mV[ i ] ;
+    return sum ;
+}
+
+#if SIMD_SSE
+
+inline Float4 Select( const Mask4 & mask , const Float4 & a , const Float4 & b )
+{   // SSE2 lacks blendv so combine and/andnot.
+    return _mm_or_ps( _mm_and_ps( mask.mV , a.mV ) , _mm_andnot_ps( mask.mV , b.mV ) ) ;
+}
+inline Float4 Min( const Float4 & a , const Float4 & b )    { return _mm_min_ps( a.mV , b.mV ) ; }
+inline Float4 Max( const Float4 & a , const Float4 & b )    { return _mm_max_ps( a.mV , b.mV ) ; }
+inline Float4 FAbs( const Float4 & a )                      { return _mm_andnot_ps( _mm_set1_ps( -0.0f ) , a.mV ) ; }
+inline Float4 Sqrt( const Float4 & a )                      { return _mm_sqrt_ps( a.mV ) ; }
+
+/*! \brief Reciprocal square root of each lane
+
+    The hardware estimate has about 12 bits of precision; one iteration of
+    Newton's method brings that to about 22 bits, comparable to the scalar finvsqrtf.
+*/
+inline Float4 finvsqrtf( const Float4 & a )
+{
+    const __m128 y = _mm_rsqrt_ps( a.mV ) ;
+    return _mm_mul_ps( y , _mm_sub_ps( _mm_set1_ps( 1.5f ) , _mm_mul_ps( _mm_mul_ps( _mm_set1_ps( 0.5f ) , a.mV ) , _mm_mul_ps( y , y ) ) ) ) ;
+}
+
+inline Float4 MultiplyAdd( const Float4 & a , const Float4 & b , const Float4 & c )
+{
+#if SIMD_FMA
+    return _mm_fmadd_ps( a.mV , b.mV , c.mV ) ;
+#else
+    return _mm_add_ps( _mm_mul_ps( a.mV , b.mV ) , c.mV ) ;
+#endif
+}
+
+inline float HorizontalSum( const Float4 & a )
+{
+    const __m128 pairs = _mm_add_ps( a.mV , _mm_movehl_ps( a.mV , a.mV ) ) ;
+    return _mm_cvtss_f32( _mm_add_ss( pairs , _mm_shuffle_ps( pairs , pairs , 1 ) ) ) ;
+}
+
+#endif
+
+#if SIMD_AVX
+
+inline Float8 Select( const Mask8 & mask , const Float8 & a , const Float8 & b )
+{
+    return _mm256_blendv_ps( b.mV , a.mV , mask.mV ) ;
+}
+inline Float8 Min( const Float8 & a , const Float8 & b )    { return _mm256_min_ps( a.mV , b.mV ) ; }
+inline Float8 Max( const Float8 & a , const Float8 & b )    { return _mm256_max_ps( a.mV , b.mV ) ; }
+inline Float8 FAbs( const Float8 & a )                      { return _mm256_andnot_ps( _mm256_set1_ps( -0.0f ) , a.mV ) ; }
+inline Float8 Sqrt( const Float8 & a )                      { return _mm256_sqrt_ps( a.mV ) ; }
+
+//! \brief Reciprocal square root of each lane: hardware estimate plus one Newton iteration
+inline Float8 finvsqrtf( const Float8 & a )
+{
+    const __m256 y = _mm256_rsqrt_ps( a.mV ) ;
+    return _mm256_mul_ps( y , _mm256_sub_ps( _mm256_set1_ps( 1.5f ) , _mm256_mul_ps( _mm256_mul_ps( _mm256_set1_ps( 0.5f ) , a.mV ) , _mm256_mul_ps( y , y ) ) ) ) ;
+}
+
+inline Float8 MultiplyAdd( const Float8 & a , const Float8 & b , const Float8 & c )
+{
+#if SIMD_FMA
+    return _mm256_fmadd_ps( a.mV , b.mV , c.mV ) ;
+#else
+    return _mm256_add_ps( _mm256_mul_ps( a.mV , b.mV ) , c.mV ) ;
+#endif
+}
+
+inline float HorizontalSum( const Float8 & a )
+{
+    const __m128 quads = _mm_add_ps( _mm256_castps256_ps128( a.mV ) , _mm256_extractf128_ps( a.mV , 1 ) ) ;
+    const __m128 pairs = _mm_add_ps( quads , _mm_movehl_ps( quads , quads ) ) ;
+    return _mm_cvtss_f32( _mm_add_ss( pairs , _mm_shuffle_ps( pairs , pairs , 1 ) ) ) ;
+}
+
+#endif
+
+#if SIMD_AVX512
+
+inline Float16 Select( const Mask16 & mask , const Float16 & a , const Float16 & b )
+{
+    return _mm512_mask_blend_ps( mask.mK , b.mV , a.mV ) ;
+}
+inline Float16 Min( const Float16 & a , const Float16 & b ) { return _mm512_min_ps( a.mV , b.mV ) ; }
+inline Float16 Max( const Float16 & a , const Float16 & b ) { return _mm512_max_ps( a.mV , b.mV ) ; }
+inline Float16 FAbs( const Float16 & a )                    { return _mm512_abs_ps( a.mV ) ; }
+inline Float16 Sqrt( const Float16 & a )                    { return _mm512_sqrt_ps( a.mV ) ; }
+
+//! \brief Reciprocal square root of each lane: 14-bit hardware estimate plus one Newton iteration
+inline Float16 finvsqrtf( const Float16 & a )
+{
+    const __m512 y = _mm512_rsqrt14_ps( a.mV ) ;
+    return _mm512_mul_ps( y , _mm512_fnmadd_ps( _mm512_mul_ps( _mm512_set1_ps( 0.5f ) , a.mV ) , _mm512_mul_ps( y , y ) , _mm512_set1_ps( 1.5f ) ) ) ;
+}
+
+inline Float16 MultiplyAdd( const Float16 & a , const Float16 & b , const Float16 & c )
+{
+    return _mm512_fmadd_ps( a.mV , b.mV , c.mV ) ;
+}
+
+inline float HorizontalSum( const Float16 & a )
+{
+    return _mm512_reduce_add_ps( a.mV ) ;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,140 @@
+/*! \file vec3x.h
+
+    \brief Packets of 3-vectors, stored as one float packet per component
+
+    Vec3xN holds N 3-vectors in "structure of arrays" form: x holds the x-components
+    of all N vectors, and so on.  Its operators match those of Vec3, so a routine
+    written for Vec3 can process N elements at once by changing types.
+
+    \author Copyright 2005-2009 UCF/FIEA/MJG; All rights reserved.
+*/
+#ifndef VEC3X_H
+#define VEC3X_H
+
+#include <stddef.h>
+
+#include "Core/Math/simd.h"
+#include "Core/Math/vec3.h"
+
+// Macros --------------------------------------------------------------
+// Types --------------------------------------------------------------
+
+/*! \brief Packet of 3-vectors
+
+    \param FloatT - packet type for each component, e.g. Float4.
+*/
+template< class FloatT > struct Vec3xN
+{
+    public:
+        typedef typename FloatT::Mask Mask ;
+        enum { NumLanes = FloatT::NumLanes } ;
+
+        Vec3xN() {}
+
+        //! \brief construct vector packet from component packets
+        Vec3xN( const FloatT & fx , const FloatT & fy , const FloatT & fz ) : x( fx ) , y( fy ) , z( fz ) {}
+
+        //! \brief Broadcast a vector into every lane
+        explicit Vec3xN( const Vec3 & v ) : x( v.x ) , y( v.y ) , z( v.z ) {}
+
+        /*! \brief Gather vectors from memory into lanes
+
+            \param pFirst - address of the first vector
+
+            \param strideBytes - distance in bytes between consecutive vectors.
+                Use sizeof(Vec3) for a plain array of Vec3, or the size of
+                the enclosing struct to gather a Vec3 member from an array of structs.
+
+            \param count - number of vectors to load.  Lanes beyond count are zero.
+        */
+        static Vec3xN LoadStrided( const Vec3 * pFirst , size_t strideBytes , unsigned count = NumLanes )
+        {
+            Vec3xN      r( Vec3( 0.0f , 0.0f , 0.0f ) ) ;
+            const char * pBytes = reinterpret_cast< const char * >( pFirst ) ;
+            for( unsigned i = 0 ; i < count ; ++ i )
+            {
+                r.SetLane( i , * reinterpret_cast< const Vec3 * >( pBytes + i * strideBytes ) ) ;
+            }
+            return r ;
+        }
+
+        //! \brief Scatter lanes into memory; see LoadStrided
+        void StoreStrided( Vec3 * pFirst , size_t strideBytes , unsigned count = NumLanes ) const
+        {
+            char * pBytes = reinterpret_cast< char * >( pFirst ) ;
+            for( unsigned i = 0 ; i < count ; ++ i )
+            {
+                * reinterpret_cast< Vec3 * >( pBytes + i * strideBytes ) = GetLane( i ) ;
+            }
+        }
+
+        //! \brief Return vector in lane i
+        Vec3 GetLane( unsigned i ) const                { return Vec3( x[ i ] , y[ i ] , z[ i ] ) ; }
+        //! \brief Assign vector in lane i
+        void SetLane( unsigned i , const Vec3 & v )     { x.SetLane( i , v.x ) ; y.SetLane( i , v.y ) ; z.SetLane( i , v.z ) ; }
+
+        //! \brief Return sum of the vectors in all lanes
+        Vec3 HorizontalSum() const                      { return Vec3( ::HorizontalSum( x ) , ::HorizontalSum( y ) , ::HorizontalSum( z ) ) ; }
+
+        // assignment operators
+        Vec3xN & operator += ( const Vec3xN & rhs )     { x += rhs.x ; y += rhs.y ; z += rhs.z ; return * this ; }
+        Vec3xN & operator -= ( const Vec3xN & rhs )     { x -= rhs.x ; y -= rhs.y ; z -= rhs.z ; return * this ; }
+        Vec3xN & operator *= ( const FloatT & f )       { x *= f ; y *= f ; z *= f ; return * this ; }
+        Vec3xN & operator /= ( const FloatT & f )       { (*this) *= ( FloatT( 1.0f ) / f ) ; return * this ; }
+
+        // unary operators
+        Vec3xN operator + () const                      { return * this ; }
+        Vec3xN operator - () const                      { return Vec3xN( -x , -y , -z ) ; }
+
+        // binary operators
+        Vec3xN operator + ( const Vec3xN & rhs ) const  { return Vec3xN( x + rhs.x , y + rhs.y , z + rhs.z ) ; }
+        Vec3xN operator - ( const Vec3xN & rhs ) const  { return Vec3xN( x - rhs.x , y - rhs.y , z - rhs.z ) ; }
+        Vec3xN operator * ( const FloatT & f ) const    { return Vec3xN( x * f , y * f , z * f ) ; }
+        Vec3xN operator / ( const FloatT & f ) const    { return (*this) * ( FloatT( 1.0f ) / f ) ; }
+        friend Vec3xN operator * ( const FloatT & f , const Vec3xN & v ) { return v * f ; }
+
+        //! \brief compute inner (i.e. dot) product of each pair of vectors
+        FloatT operator * ( const Vec3xN & rhs ) const  { return MultiplyAdd( x , rhs.x , MultiplyAdd( y , rhs.y , z * rhs.z ) ) ; }
+
+        //! \brief compute outer (i.e. cross) product of each pair of vectors
+        Vec3xN operator ^ ( const Vec3xN & rhs ) const  { return Vec3xN( y * rhs.z - z * rhs.y , z * rhs.x - x * rhs.z , x * rhs.y - y * rhs.x ) ; }
+
+        //! \brief return magnitude squared of each vector
+        FloatT Mag2() const                             { return (*this) * (*this) ; }
+
+        //! \brief return magnitude of each vector
+        FloatT Magnitude() const                        { return Sqrt( Mag2() ) ; }
+
+        //! \brief return reciprocal magnitude of each vector
+        FloatT ReciprocalMagnitude() const              { return finvsqrtf( Mag2() ) ; }
+
+        //! \brief return unit vectors in the same directions as these vectors
+        Vec3xN GetDir() const                           { return (*this) * finvsqrtf( Mag2() + FloatT( FLT_MIN ) ) ; }
+
+        //! \brief normalize each vector
+        void Normalize()                                { * this = GetDir() ; }
+
+        //! \brief Assign every vector to zero
+        void Zero()                                     { x = y = z = FloatT( 0.0f ) ; }
+
+        FloatT x ;   ///< x-components
+        FloatT y ;   ///< y-components
+        FloatT z ;   ///< z-components
+} ;
+
+typedef Vec3xN< Float4 >        Vec3x4 ;
+typedef Vec3xN< Float8 >        Vec3x8 ;
+typedef Vec3xN< Float16 >       Vec3x16 ;
+typedef Vec3xN< FloatNative >   Vec3xNative ;
+
+// Public variables --------------------------------------------------------------
+// Public functions --------------------------------------------------------------
+
+/*! \brief Return vectors whose lanes come from a where mask is set and from b elsewhere
+*/
+template< class FloatT > inline Vec3xN< FloatT > Select( const typename FloatT::Mask & mask , const Vec3xN< FloatT > & a , const Vec3xN< FloatT > & b )
+{
+    return Vec3xN< FloatT >( Select( mask , a.x , b.x ) , Select( mask , a.y , b.y ) , Select( mask , a.z , b.z ) ) ;
+}
+
+#endif
@@ -0,0 +1,108 @@
+/*! \file alignedVector.cpp
+
+    \brief Aligned and large-page memory allocation for AlignedVector
+
+    \author Copyright 2009 Dr. Michael Jason Gourlay; All rights reserved.
+*/
+
+#if defined( WIN32 )
+    #include <windows.h>
+    #include <malloc.h>
+#else
+    #include <stdlib.h>
+    #include <sys/mman.h>
+#endif
+
+#include "alignedVector.h"
+
+// Private variables --------------------------------------------------------------
+
+#if ! defined( WIN32 )
+/*! \brief Alignment of allocations that request large pages
+
+    Transparent huge pages can back only whole, aligned 2 MiB regions.
+*/
+static const size_t sLargePageAlignment = 2 * 1024 * 1024 ;
+#endif
+
+// Public functions --------------------------------------------------------------
+
+/*! \brief Allocate memory aligned to ALIGNED_ALLOCATION_ALIGNMENT
+
+    \param numBytes - number of bytes to allocate
+
+    \param bLargePages - whether to request that large pages back the allocation.
+        On Windows, large pages require that the process hold the
+        "Lock pages in memory" privilege, and when it does not, this falls back to
+        ordinary pages.  Elsewhere this aligns the allocation to a large page and
+        advises the kernel to back it with transparent huge pages.
+        Allocations smaller than a large page always use ordinary pages,
+        since a large page would mostly go to waste.
+
+    \param rLargePageAllocation - (out) whether the memory came from the large-page allocator.
+        Pass this to AlignedFree.
+
+    \return address of allocated memory, or NULL upon failure.
+*/
+void * AlignedAllocate( size_t numBytes , bool bLargePages , bool & rLargePageAllocation )
+{
+    rLargePageAllocation = false ;
+#if defined( WIN32 )
+    if( bLargePages )
+    {
+        const SIZE_T largePageSize = GetLargePageMinimum() ;
+        if( ( largePageSize > 0 ) && ( numBytes >= largePageSize ) )
+        {   // Large-page allocations must span a whole number of large pages.
+            const SIZE_T    numBytesRounded = ( numBytes + largePageSize - 1 ) / largePageSize * largePageSize ;
+            void *          pMemory         = VirtualAlloc( NULL , numBytesRounded , MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES , PAGE_READWRITE ) ;
+            if( pMemory )
+            {
+                rLargePageAllocation = true ;
+                return pMemory ;
+            }
+        }
+    }
+    return _aligned_malloc( numBytes , ALIGNED_ALLOCATION_ALIGNMENT ) ;
+#else
+    bLargePages = bLargePages && ( numBytes >= sLargePageAlignment ) ;
+    const size_t    alignment   = bLargePages ? sLargePageAlignment : ALIGNED_ALLOCATION_ALIGNMENT ;
+    void *          pMemory     = NULL ;
+    if( posix_memalign( & pMemory , alignment , numBytes ) != 0 )
+    {
+        return NULL ;
+    }
+    #if defined( MADV_HUGEPAGE )
+    if( bLargePages )
+    {   // Advice is only a hint, so ignore failure.
+        madvise( pMemory , numBytes , MADV_HUGEPAGE ) ;
+    }
+    #endif
+    return pMemory ;
+#endif
+}
+
+
+
+
+/*! \brief Free memory that AlignedAllocate returned
+
+    \param pMemory - address AlignedAllocate returned
+
+    \param bLargePageAllocation - value AlignedAllocate assigned to rLargePageAllocation
+*/
+void AlignedFree( void * pMemory , bool bLargePageAllocation )
+{
+#if defined( WIN32 )
+    if( bLargePageAllocation )
+    {
+        VirtualFree( pMemory , 0 , MEM_RELEASE ) ;
+    }
+    else
+    {
+        _aligned_free( pMemory ) ;
+    }
+#else
+    (void) bLargePageAllocation ;
+    free( pMemory ) ;
+#endif
+}
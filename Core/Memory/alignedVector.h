@@ -0,0 +1,233 @@
+/*! \file alignedVector.h
+
+    \brief Array container with cache-line alignment and optional uninitialized growth
+
+    \author Copyright 2009 Dr. Michael Jason Gourlay; All rights reserved.
+*/
+#ifndef ALIGNED_VECTOR_H
+#define ALIGNED_VECTOR_H
+
+#include <stddef.h>
+#include <new>
+
+// Macros --------------------------------------------------------------
+
+/*! \brief Alignment, in bytes, of memory that AlignedAllocate returns
+
+    This is the size of a cache line, which also satisfies every SIMD load.
+*/
+static const size_t ALIGNED_ALLOCATION_ALIGNMENT = 64 ;
+
+// Public variables --------------------------------------------------------------
+// Public functions --------------------------------------------------------------
+
+extern void * AlignedAllocate( size_t numBytes , bool bLargePages , bool & rLargePageAllocation ) ;
+extern void   AlignedFree( void * pMemory , bool bLargePageAllocation ) ;
+
+// Types --------------------------------------------------------------
+
+/*! \brief Dynamic array whose storage starts on a cache line
+
+    This resembles std::vector, and members it shares with std::vector
+    have the same names, so wrapper macros such as Size and Resize apply.
+    It differs in these ways:
+
+        -   Storage is aligned to ALIGNED_ALLOCATION_ALIGNMENT bytes,
+            so aligned SIMD loads from the start of the array are safe.
+
+        -   ResizeUninitialized grows the array without value-initializing
+            new elements.  For types with trivial default constructors,
+            such as float, that leaves new elements indeterminate and so
+            avoids zeroing them, which is worthwhile for arrays the caller
+            will completely overwrite.  Types whose default constructor
+            is user-provided, such as Vec3 and Mat33, gain nothing, since
+            value-initializing them already just calls that constructor.
+
+        -   SetLargePages requests that storage reside in large (a.k.a. huge)
+            pages, which reduces TLB misses when traversing large arrays.
+            When the platform or process cannot provide large pages,
+            storage comes from ordinary pages instead.
+
+        -   Growing reallocates to exactly the requested size, since clients
+            typically size the array once then reuse it.  Clear keeps the
+            allocation, so resizing again to the same size does not reallocate.
+*/
+template< typename ItemT > class AlignedVector
+{
+    public:
+        typedef ItemT *         iterator        ;
+        typedef const ItemT *   const_iterator  ;
+
+        AlignedVector( void )
+            : mItems( 0 )
+            , mSize( 0 )
+            , mCapacity( 0 )
+            , mUseLargePages( false )
+            , mLargePageAllocation( false )
+        {
+        }
+
+        AlignedVector( const AlignedVector & that )
+            : mItems( 0 )
+            , mSize( 0 )
+            , mCapacity( 0 )
+            , mUseLargePages( that.mUseLargePages )
+            , mLargePageAllocation( false )
+        {
+            Assign( that ) ;
+        }
+
+        ~AlignedVector()
+        {
+            clear() ;
+            Deallocate() ;
+        }
+
+        AlignedVector & operator=( const AlignedVector & that )
+        {
+            if( this != & that )
+            {
+                Assign( that ) ;
+            }
+            return * this ;
+        }
+
+        /*! \brief Request that subsequent allocations use large pages
+
+            This takes effect the next time the array reallocates.
+        */
+        void SetLargePages( bool bUseLargePages )   { mUseLargePages = bUseLargePages ; }
+        bool GetLargePages( void ) const            { return mUseLargePages ; }
+
+        size_t size( void ) const       { return mSize ; }
+        size_t capacity( void ) const   { return mCapacity ; }
+        bool   empty( void ) const      { return 0 == mSize ; }
+
+              ItemT * data( void )          { return mItems ; }
+        const ItemT * data( void ) const    { return mItems ; }
+
+              iterator          begin( void )       { return mItems ; }
+        const_iterator          begin( void ) const { return mItems ; }
+              iterator          end( void )         { return mItems + mSize ; }
+        const_iterator          end( void ) const   { return mItems + mSize ; }
+
+              ItemT & operator[]( size_t index )       { return mItems[ index ] ; }
+        const ItemT & operator[]( size_t index ) const { return mItems[ index ] ; }
+
+
+        /*! \brief Ensure capacity for at least the given number of elements
+        */
+        void reserve( size_t numItems )
+        {
+            if( numItems <= mCapacity )
+            {
+                return ;
+            }
+            bool    bLargePageAllocation ;
+            ItemT * pItems = static_cast< ItemT * >( AlignedAllocate( numItems * sizeof( ItemT ) , mUseLargePages , bLargePageAllocation ) ) ;
+            if( 0 == pItems )
+            {
+                throw std::bad_alloc() ;
+            }
+            for( size_t i = 0 ; i < mSize ; ++ i )
+            {   // Relocate existing elements.
+                new ( & pItems[ i ] ) ItemT( mItems[ i ] ) ;
+                mItems[ i ].~ItemT() ;
+            }
+            Deallocate() ;
+            mItems                  = pItems ;
+            mCapacity               = numItems ;
+            mLargePageAllocation    = bLargePageAllocation ;
+        }
+
+
+        /*! \brief Change the number of elements, value-initializing new ones, like std::vector::resize
+        */
+        void resize( size_t numItems )
+        {
+            Shrink( numItems ) ;
+            reserve( numItems ) ;
+            for( size_t i = mSize ; i < numItems ; ++ i )
+            {
+                new ( & mItems[ i ] ) ItemT() ;
+            }
+            mSize = numItems ;
+        }
+
+
+        /*! \brief Change the number of elements, default-initializing new ones
+
+            Elements whose type has a trivial default constructor remain indeterminate,
+            so use this only when the caller will assign every new element before reading it.
+        */
+        void ResizeUninitialized( size_t numItems )
+        {
+            Shrink( numItems ) ;
+            reserve( numItems ) ;
+            for( size_t i = mSize ; i < numItems ; ++ i )
+            {
+                new ( & mItems[ i ] ) ItemT ;
+            }
+            mSize = numItems ;
+        }
+
+
+        /*! \brief Assign the given value to every element
+        */
+        void Fill( const ItemT & value )
+        {
+            for( size_t i = 0 ; i < mSize ; ++ i )
+            {
+                mItems[ i ] = value ;
+            }
+        }
+
+
+        /*! \brief Destroy all elements but retain storage
+        */
+        void clear( void )
+        {
+            Shrink( 0 ) ;
+        }
+
+
+    private:
+        /// Destroy elements beyond the given number.
+        void Shrink( size_t numItems )
+        {
+            while( mSize > numItems )
+            {
+                -- mSize ;
+                mItems[ mSize ].~ItemT() ;
+            }
+        }
+
+        void Assign( const AlignedVector & that )
+        {
+            clear() ;
+            reserve( that.mSize ) ;
+            for( size_t i = 0 ; i < that.mSize ; ++ i )
+            {
+                new ( & mItems[ i ] ) ItemT( that.mItems[ i ] ) ;
+            }
+            mSize = that.mSize ;
+        }
+
+        void Deallocate( void )
+        {
+            if( mItems )
+            {
+                AlignedFree( mItems , mLargePageAllocation ) ;
+            }
+            mItems      = 0 ;
+            mCapacity   = 0 ;
+        }
+
+        ItemT * mItems                  ;   ///< Storage for elements, aligned to ALIGNED_ALLOCATION_ALIGNMENT
+        size_t  mSize                   ;   ///< Number of constructed elements
+        size_t  mCapacity               ;   ///< Number of elements storage can hold
+        bool    mUseLargePages          ;   ///< Whether future allocations should request large pages
+        bool    mLargePageAllocation    ;   ///< Whether current storage came from the large-page allocator
+} ;
+
+#endif
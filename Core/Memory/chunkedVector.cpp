@@ -0,0 +1,43 @@
+/*! \file chunkedVector.cpp
+
+    \brief Atomic reference counting for ChunkedVector
+
+    \author Copyright 2009 Dr. Michael Jason Gourlay; All rights reserved.
+*/
+
+#if defined( WIN32 )
+    #include <windows.h>
+#endif
+
+#include "chunkedVector.h"
+
+// Public functions --------------------------------------------------------------
+
+/*! \brief Increment a value atomically
+
+    \return incremented value
+*/
+long AtomicIncrement( volatile long & rValue )
+{
+#if defined( WIN32 )
+    return InterlockedIncrement( & rValue ) ;
+#else
+    return __sync_add_and_fetch( & rValue , 1L ) ;
+#endif
+}
+
+
+
+
+/*! \brief Decrement a value atomically
+
+    \return decremented value
+*/
+long AtomicDecrement( volatile long & rValue )
+{
+#if defined( WIN32 )
+    return InterlockedDecrement( & rValue ) ;
+#else
+    return __sync_sub_and_fetch( & rValue , 1L ) ;
+#endif
+}
@@ -0,0 +1,273 @@
+/*! \file chunkedVector.h
+
+    \brief Array container whose storage lies in reference-counted chunks that copies share until they write
+
+    \author Copyright 2009 Dr. Michael Jason Gourlay; All rights reserved.
+*/
+#ifndef CHUNKED_VECTOR_H
+#define CHUNKED_VECTOR_H
+
+#include <stddef.h>
+#include <vector>
+
+// Macros --------------------------------------------------------------
+// Public variables --------------------------------------------------------------
+// Public functions --------------------------------------------------------------
+
+extern long AtomicIncrement( volatile long & rValue ) ;
+extern long AtomicDecrement( volatile long & rValue ) ;
+
+// Types --------------------------------------------------------------
+
+/*! \brief Dynamic array whose elements lie in reference-counted chunks, which copies share until one of them writes
+
+    Copying a ChunkedVector copies only its table of chunks and increments
+    the reference count of each, so it costs about 1/CHUNK_SIZE as much as
+    copying the elements.  Each copy then behaves as an independent array,
+    because every mutating member, including non-const operator[], is a
+    write barrier: before writing to a chunk that another array shares,
+    it gives this array its own copy of that chunk.  So copies occupy
+    additional memory only for chunks in which they differ.
+
+    This resembles std::vector, and members it shares with std::vector
+    have the same names, so wrapper macros such as Size and Resize apply.
+    It differs in these ways:
+
+        -   Elements are contiguous only within each chunk, so callers that
+            need a contiguous array must visit one chunk at a time, with
+            GetChunk, or copy elements out.
+
+        -   Non-const operator[] is a write barrier, so read elements
+            through a const reference to the array where possible,
+            to avoid copying shared chunks needlessly.
+
+        -   The write barrier is not thread-safe, since two threads writing
+            the same shared chunk could both copy it.  Call Unshare, on
+            only the range of elements that will change, before threads
+            write to elements concurrently, then write through GetUnshared,
+            which skips the write barrier.  Reference counts change
+            atomically, so arrays that share chunks can change
+            concurrently on different threads.
+
+        -   Copying a chunk assigns its elements, rather than copy-constructing
+            them, so copies retain members that copy constructors omit.
+*/
+template< typename ItemT > class ChunkedVector
+{
+    public:
+        static const size_t CHUNK_SHIFT = 10 ;                      ///< Base-2 logarithm of CHUNK_SIZE
+        static const size_t CHUNK_SIZE  = size_t( 1 ) << CHUNK_SHIFT ; ///< Number of elements in each chunk
+
+        ChunkedVector( void )
+            : mSize( 0 )
+        {
+        }
+
+        ChunkedVector( const ChunkedVector & that )
+            : mChunks( that.mChunks )
+            , mSize( that.mSize )
+        {
+            for( size_t iChunk = 0 ; iChunk < mChunks.size() ; ++ iChunk )
+            {   // For each chunk, which this array now shares...
+                AtomicIncrement( mChunks[ iChunk ]->mRefCount ) ;
+            }
+        }
+
+        ~ChunkedVector()
+        {
+            clear() ;
+        }
+
+        ChunkedVector & operator=( const ChunkedVector & that )
+        {
+            ChunkedVector copy( that ) ;
+            swap( copy ) ;
+            return * this ;
+        }
+
+        size_t size( void ) const       { return mSize ; }
+        bool   empty( void ) const      { return 0 == mSize ; }
+
+        const ItemT & operator[]( size_t index ) const { return mChunks[ index >> CHUNK_SHIFT ]->mItems[ index & ( CHUNK_SIZE - 1 ) ] ; }
+              ItemT & operator[]( size_t index )       { return WritableChunk( index >> CHUNK_SHIFT )->mItems[ index & ( CHUNK_SIZE - 1 ) ] ; }
+
+        /// Return element for writing, without the write barrier.  Only call this after Unshare on a range that includes index.
+        ItemT &         GetUnshared( size_t index )                 { return mChunks[ index >> CHUNK_SHIFT ]->mItems[ index & ( CHUNK_SIZE - 1 ) ] ; }
+
+        /// Return number of chunks that hold elements.
+        size_t          GetNumChunks( void ) const                  { return ( mSize + CHUNK_SIZE - 1 ) >> CHUNK_SHIFT ; }
+
+        /// Return contiguous elements of the given chunk, whose first element has index iChunk*CHUNK_SIZE.
+        const ItemT *   GetChunk( size_t iChunk ) const             { return mChunks[ iChunk ]->mItems ; }
+
+        /// Return whether another array shares the given chunk.
+        bool            IsChunkShared( size_t iChunk ) const        { return mChunks[ iChunk ]->mRefCount > 1 ; }
+
+
+        /*! \brief Ensure the table of chunks has room for the given number of elements
+        */
+        void reserve( size_t numItems )
+        {
+            mChunks.reserve( ( numItems + CHUNK_SIZE - 1 ) >> CHUNK_SHIFT ) ;
+        }
+
+
+        /*! \brief Change the number of elements, value-initializing new ones, like std::vector::resize
+        */
+        void resize( size_t numItems )
+        {
+            const size_t numChunks = ( numItems + CHUNK_SIZE - 1 ) >> CHUNK_SHIFT ;
+            while( mChunks.size() > numChunks )
+            {   // Release chunks beyond the new size.
+                Release( mChunks.back() ) ;
+                mChunks.pop_back() ;
+            }
+            if( numItems < mSize )
+            {   // Elements beyond the new size remain in the last chunk, but resize reinitializes them before they reappear.
+                mSize = numItems ;
+                return ;
+            }
+            const size_t iFirstNewChunk = mChunks.size() ;
+            while( mChunks.size() < numChunks )
+            {   // Allocate chunks, whose elements are value-initialized.
+                mChunks.push_back( new Chunk ) ;
+            }
+            const size_t iOldEnd = ( numItems < ( iFirstNewChunk << CHUNK_SHIFT ) ) ? numItems : ( iFirstNewChunk << CHUNK_SHIFT ) ;
+            for( size_t index = mSize ; index < iOldEnd ; ++ index )
+            {   // For each new element that lies in a chunk that existed before...
+                ( * this )[ index ] = ItemT() ;
+            }
+            mSize = numItems ;
+        }
+
+
+        /*! \brief Append an element
+        */
+        void push_back( const ItemT & item )
+        {
+            if( ( mSize >> CHUNK_SHIFT ) == mChunks.size() )
+            {   // Last chunk is full, or none exists.
+                mChunks.push_back( new Chunk ) ;
+            }
+            ++ mSize ;
+            ( * this )[ mSize - 1 ] = item ;
+        }
+
+
+        /*! \brief Remove the last element
+        */
+        void pop_back( void )
+        {
+            resize( mSize - 1 ) ;
+        }
+
+
+        /*! \brief Remove all elements, and release every chunk
+        */
+        void clear( void )
+        {
+            for( size_t iChunk = 0 ; iChunk < mChunks.size() ; ++ iChunk )
+            {
+                Release( mChunks[ iChunk ] ) ;
+            }
+            mChunks.clear() ;
+            mSize = 0 ;
+        }
+
+
+        /*! \brief Exchange contents with another array, without copying elements
+        */
+        void swap( ChunkedVector & that )
+        {
+            mChunks.swap( that.mChunks ) ;
+            const size_t numItems = mSize ;
+            mSize       = that.mSize ;
+            that.mSize  = numItems ;
+        }
+
+
+        /*! \brief Copy every chunk that another array shares, so that threads can then write to elements concurrently
+        */
+        void Unshare( void )
+        {
+            for( size_t iChunk = 0 ; iChunk < mChunks.size() ; ++ iChunk )
+            {
+                WritableChunk( iChunk ) ;
+            }
+        }
+
+
+        /*! \brief Copy each chunk that another array shares and that holds any element in [iBegin,iEnd)
+
+            This copies only chunks that hold elements in the given range,
+            so chunks outside it remain shared.
+        */
+        void Unshare( size_t iBegin , size_t iEnd )
+        {
+            if( iBegin >= iEnd )
+            {   // Range is empty.
+                return ;
+            }
+            const size_t iChunkEnd = ( ( iEnd - 1 ) >> CHUNK_SHIFT ) + 1 ;
+            for( size_t iChunk = iBegin >> CHUNK_SHIFT ; iChunk < iChunkEnd ; ++ iChunk )
+            {
+                WritableChunk( iChunk ) ;
+            }
+        }
+
+
+    private:
+        /*! \brief Block of elements that one or more arrays share
+        */
+        struct Chunk
+        {
+            Chunk( void )
+                : mRefCount( 1 )
+                , mItems()
+            {
+            }
+
+            volatile long   mRefCount               ;   ///< Number of arrays that share this chunk
+            ItemT           mItems[ CHUNK_SIZE ]    ;   ///< Elements
+        } ;
+
+        /// Remove a reference to the given chunk, and delete it if that was the last.
+        static void Release( Chunk * pChunk )
+        {
+            if( 0 == AtomicDecrement( pChunk->mRefCount ) )
+            {
+                delete pChunk ;
+            }
+        }
+
+        /*! \brief Return the given chunk, after copying it if another array shares it
+
+            This is the write barrier.
+        */
+        Chunk * WritableChunk( size_t iChunk )
+        {
+            Chunk * pChunk = mChunks[ iChunk ] ;
+            if( pChunk->mRefCount > 1 )
+            {   // Another array shares this chunk, so copy it before writing.
+                Chunk *         pCopy       = new Chunk ;
+                const size_t    iBegin      = iChunk << CHUNK_SHIFT ;
+                const size_t    numItems    = ( mSize <= iBegin ) ? 0 : ( ( mSize - iBegin < CHUNK_SIZE ) ? ( mSize - iBegin ) : CHUNK_SIZE ) ;
+                for( size_t iItem = 0 ; iItem < numItems ; ++ iItem )
+                {
+                    pCopy->mItems[ iItem ] = pChunk->mItems[ iItem ] ;
+                }
+                Release( pChunk ) ;
+                mChunks[ iChunk ] = pCopy ;
+                pChunk = pCopy ;
+            }
+            return pChunk ;
+        }
+
+        std::vector< Chunk * >  mChunks ;   ///< Table of chunks, each holding CHUNK_SIZE elements, which other arrays might share
+        size_t                  mSize   ;   ///< Number of elements
+} ;
+
+template< typename ItemT > const size_t ChunkedVector< ItemT >::CHUNK_SHIFT ;
+template< typename ItemT > const size_t ChunkedVector< ItemT >::CHUNK_SIZE ;
+
+#endif
@@ -104,4 +104,18 @@ extern bool gPrintProfileData ;
 // Public variables --------------------------------------------------------------
 // Public functions --------------------------------------------------------------
 
+/*! \brief Return wall-clock time, in seconds, from the high-resolution performance counter
+
+    Unlike QUERY_PERFORMANCE_ENTER and QUERY_PERFORMANCE_EXIT, this is
+    available in every build, so code can compare it with deadlines.
+*/
+inline double QueryPerformanceSeconds( void )
+{
+    LARGE_INTEGER count ;
+    LARGE_INTEGER frequency ;
+    QueryPerformanceCounter( & count ) ;
+    QueryPerformanceFrequency( & frequency ) ;
+    return double( count.QuadPart ) / double( frequency.QuadPart ) ;
+}
+
 #endif
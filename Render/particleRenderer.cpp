@@ -100,6 +100,8 @@ struct VertexFormatPos4Tex4
 */
 ParticleRenderer::ParticleRenderer( const char * pParticleData , size_t stride , size_t offsetToAngVel , size_t offsetToSize )
     : mParticleData( pParticleData )
+    , mParticleChunks( 0 )
+    , mChunkShift( 0 )
     , mStride( stride )
     , mOffsetToAngVel( offsetToAngVel )
     , mOffsetToSize( offsetToSize )
@@ -192,7 +194,7 @@ void ParticleRenderer::FillVertexBufferSlice( const double & timeNow , const Mat
     VertexFormatPositionNormalTexture * pVertices = ( VertexFormatPositionNormalTexture * ) mVertexBuffer ;
     for( unsigned iPcl = iPclStart ; iPcl < iPclEnd ; ++ iPcl )
     {   // For each particle in this slice...
-        const char *    pPos        = mParticleData + mIndices[ iPcl ].mPcl * mStride ;
+        const char *    pPos        = GetParticle( mIndices[ iPcl ].mPcl ) ;
         const char *    pAngVel     = pPos + mOffsetToAngVel ;
         const char *    pSize       = pPos + mOffsetToSize ;
         const Vec3  &   pclPos      = * ( (Vec3*) pPos ) ;
@@ -257,7 +259,7 @@ void ParticleRenderer::FillVertexBufferSlice( const double & timeNow , const Mat
     VertexFormatPos3Tex2 * pVertices = ( VertexFormatPos3Tex2 * ) mVertexBuffer ;
     for( size_t iPcl = iPclStart ; iPcl < iPclEnd ; ++ iPcl )
     {   // For each particle in this slice...
-        const char *    pPos        = mParticleData + iPcl * mStride ;
+        const char *    pPos        = GetParticle( iPcl ) ;
         const char *    pAngVel     = pPos + mOffsetToAngVel ;
         const char *    pSize       = pPos + mOffsetToSize ;
         const Vec3  &   pclPos      = * ( (Vec3*) pPos ) ;
@@ -371,7 +373,7 @@ void ParticleRenderer::Render( double timeNow , float timeChange , size_t numPar
 
         for( unsigned iPcl = 0 ; iPcl < numParticles ; ++ iPcl )
         {   // For each particle...
-            const char *    pPos    = mParticleData + iPcl * mStride ;
+            const char *    pPos    = GetParticle( iPcl ) ;
             const Vec3   &  pclPos  = * ( (Vec3*) pPos) ;
             // Assign particle index map values.
             // Later these will be sorted and therefore by proxy so will the particles
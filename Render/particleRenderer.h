@@ -35,10 +35,22 @@ class ParticleRenderer
         /*! \brief Set address of particle data
             \note When a dynamic array stores particle data, the address can change each frame
         */
-        void SetParticleData( const char * pParticleData ) { mParticleData = pParticleData ; }
+        void SetParticleData( const char * pParticleData ) { mParticleData = pParticleData ; mParticleChunks = 0 ; }
+
+        /*! \brief Set addresses of chunks of particle data, for containers that store particles in equal-sized chunks
+
+            \param ppParticleChunks - address of each chunk.  Renderer reads this table, so it must persist until Render returns.
+
+            \param chunkShift - base-2 logarithm of the number of particles in each chunk
+
+            \see ChunkedVector
+        */
+        void SetParticleChunks( const char * const * ppParticleChunks , size_t chunkShift ) { mParticleChunks = ppParticleChunks ; mChunkShift = chunkShift ; }
 
     private:
-        const char *                mParticleData           ;   ///< Dynamic array of particles
+        const char *                mParticleData           ;   ///< Dynamic array of particles, used unless mParticleChunks is set
+        const char * const *        mParticleChunks         ;   ///< Address of each chunk of particles, or 0 to use mParticleData
+        size_t                      mChunkShift             ;   ///< Base-2 logarithm of the number of particles in each of mParticleChunks
         size_t                      mStride                 ;   ///< Number of bytes between particles
         size_t                      mOffsetToAngVel         ;   ///< Number of bytes to angular velocity
         size_t                      mOffsetToSize           ;   ///< Number of bytes to size
@@ -52,6 +64,16 @@ class ParticleRenderer
 
         void FillVertexBufferSlice( const double & timeNow , const struct Mat4 & viewMatrix , size_t iPclStart , size_t iPclEnd ) ;
 
+        /// Return address of the given particle, in either mParticleData or mParticleChunks.
+        const char * GetParticle( size_t iPcl ) const
+        {
+            if( mParticleChunks != 0 )
+            {
+                return mParticleChunks[ iPcl >> mChunkShift ] + ( iPcl & ( ( size_t( 1 ) << mChunkShift ) - 1 ) ) * mStride ;
+            }
+            return mParticleData + iPcl * mStride ;
+        }
+
     #if USE_TBB
         friend class ParticleRenderer_FillVertexBuffer_TBB ;
     #endif
@@ -0,0 +1,280 @@
+/*! \file vortexFilament.h
+
+    \brief Vortex filament, a polyline of vortex segments that share a circulation
+
+    \author Copyright 2009 Dr. Michael Jason Gourlay; All rights reserved.
+*/
+#ifndef VORTEX_FILAMENT_H
+#define VORTEX_FILAMENT_H
+
+#include <math.h>
+
+#include "Core/Math/vec3.h"
+#include "wrapperMacros.h"
+#include "vorton.h"
+
+// Macros --------------------------------------------------------------
+// Types --------------------------------------------------------------
+
+/*! \brief Vortex filament, a polyline of straight vortex segments that share a circulation
+
+    Vortex rings and tubes concentrate vorticity near a curve.  Vortons
+    represent such a flow by filling the volume around that curve, which
+    spends most of them describing what is effectively a 1-D object.
+    A filament describes the curve itself, so a ring which needs thousands
+    of vortons needs only tens of segments.
+
+    Nodes advect with the flow, so segments stretch and tilt without any
+    explicit stretching term, and circulation stays constant along the
+    filament, as Kelvin's theorem requires.  Refine keeps segment lengths
+    between mMinSegmentLength and mMaxSegmentLength as the filament deforms.
+
+    \see VortonSim::AdvectFilaments, AssignFilaments
+*/
+class VortexFilament
+{
+    public:
+        /*! \brief Construct an empty vortex filament
+        */
+        VortexFilament()
+            : mCirculation( 0.0f )
+            , mCoreRadius( 0.0f )
+            , mMinSegmentLength( 0.0f )
+            , mMaxSegmentLength( FLT_MAX )
+            , mClosed( false )
+        {
+        }
+
+        /*! \brief Construct a vortex filament without nodes
+
+            \param fCirculation - circulation of every segment
+
+            \param fCoreRadius - radius of core, within which velocity varies linearly instead of diverging
+
+            \param fSegmentLength - nominal segment length.  Refine keeps segments between half and 1.5 times this.
+
+            \param bClosed - whether the last node connects back to the first, as in a ring
+        */
+        VortexFilament( float fCirculation , float fCoreRadius , float fSegmentLength , bool bClosed )
+            : mCirculation( fCirculation )
+            , mCoreRadius( fCoreRadius )
+            , mMinSegmentLength( 0.5f * fSegmentLength )
+            , mMaxSegmentLength( 1.5f * fSegmentLength )
+            , mClosed( bClosed )
+        {
+        }
+
+        /*! \brief Place nodes evenly around a circle
+
+            \param vCenter - center of circle
+
+            \param fRadius - radius of circle
+
+            \param vAxis - unit vector normal to plane of circle.
+                    Vorticity circulates counterclockwise about it, so a ring propagates along it.
+
+            \param numSegments - number of segments into which to divide circle
+        */
+        void AssignRing( const Vec3 & vCenter , float fRadius , const Vec3 & vAxis , unsigned numSegments )
+        {
+            // Find unit vectors spanning the plane of the circle, such that e1 ^ e2 = vAxis.
+            const Vec3  vNotAxis    = ( fabsf( vAxis.x ) < 0.5f ) ? Vec3( 1.0f , 0.0f , 0.0f ) : Vec3( 0.0f , 1.0f , 0.0f ) ;
+            const Vec3  e1          = ( vNotAxis ^ vAxis ).GetDir() ;
+            const Vec3  e2          = vAxis ^ e1 ;
+            mClosed = true ;
+            mNodes.Clear() ;
+            mNodes.Reserve( numSegments ) ;
+            for( unsigned iNode = 0 ; iNode < numSegments ; ++ iNode )
+            {   // For each node...
+                const float angle = 0.5f * FourPi * float( iNode ) / float( numSegments ) ;
+                mNodes.PushBack( vCenter + fRadius * ( cosf( angle ) * e1 + sinf( angle ) * e2 ) ) ;
+            }
+        }
+
+        /*! \brief Place nodes evenly along a straight line
+
+            \param vBegin, vEnd - endpoints of line.  Vorticity points from vBegin toward vEnd.
+
+            \param numSegments - number of segments into which to divide line
+        */
+        void AssignLine( const Vec3 & vBegin , const Vec3 & vEnd , unsigned numSegments )
+        {
+            mClosed = false ;
+            mNodes.Clear() ;
+            mNodes.Reserve( numSegments + 1 ) ;
+            for( unsigned iNode = 0 ; iNode <= numSegments ; ++ iNode )
+            {   // For each node...
+                const float t = float( iNode ) / float( numSegments ) ;
+                mNodes.PushBack( vBegin + t * ( vEnd - vBegin ) ) ;
+            }
+        }
+
+        /*! \brief Return number of segments, which join consecutive nodes
+        */
+        size_t GetNumSegments( void ) const
+        {
+            const size_t numNodes = mNodes.Size() ;
+            if( numNodes < 2 )
+            {   // Filament has no segments.
+                return 0 ;
+            }
+            return mClosed ? numNodes : numNodes - 1 ;
+        }
+
+        /*! \brief Return total length of all segments
+        */
+        float ComputeLength( void ) const
+        {
+            float length = 0.0f ;
+            const size_t numSegments = GetNumSegments() ;
+            for( size_t iSegment = 0 ; iSegment < numSegments ; ++ iSegment )
+            {   // For each segment...
+                length += ( GetSegmentEnd( iSegment ) - GetSegmentBegin( iSegment ) ).Magnitude() ;
+            }
+            return length ;
+        }
+
+        const Vec3 & GetSegmentBegin( size_t iSegment ) const   { return mNodes[ iSegment ] ; }
+        const Vec3 & GetSegmentEnd( size_t iSegment ) const     { return mNodes[ ( iSegment + 1 == mNodes.Size() ) ? 0 : iSegment + 1 ] ; }
+
+        /*! \brief Return a vorton whose far-field influence matches that of the given segment
+
+            A straight segment of length L with circulation G has the same
+            vorticity integral, G L, as a vorton at its midpoint with
+            vorticity G L / volumeElement.  This lets segments aggregate into
+            the influence tree alongside vortons.
+        */
+        Vorton MakeSegmentVorton( size_t iSegment ) const
+        {
+            const Vec3 &    vBegin          = GetSegmentBegin( iSegment ) ;
+            const Vec3 &    vEnd            = GetSegmentEnd( iSegment ) ;
+            const float     volumeElement   = POW3( mCoreRadius ) * 8.0f ;
+            return Vorton( 0.5f * ( vBegin + vEnd ) , ( vEnd - vBegin ) * ( mCirculation / volumeElement ) , mCoreRadius ) ;
+        }
+
+        /*! \brief Compute velocity induced by a straight vortex segment
+
+            \param vVelocity - (in/out) variable in which to accumulate velocity
+
+            \param vPosQuery - position where we want to know velocity
+
+            \param vBegin, vEnd - endpoints of segment.  Vorticity points from vBegin toward vEnd.
+
+            \param fCirculation - circulation of segment
+
+            \param fCoreRadius - radius of core.  This regularizes the Biot-Savart law
+                        near the line through the segment, where it would otherwise diverge.
+
+            \see Katz & Plotkin: Low-Speed Aerodynamics, section 10.4.5.
+        */
+        static void AccumulateSegmentVelocity( Vec3 & vVelocity , const Vec3 & vPosQuery , const Vec3 & vBegin , const Vec3 & vEnd , float fCirculation , float fCoreRadius )
+        {
+            const Vec3  r0          = vEnd - vBegin ;
+            const Vec3  r1          = vPosQuery - vBegin ;
+            const Vec3  r2          = vPosQuery - vEnd ;
+            const Vec3  r1CrossR2   = r1 ^ r2 ;
+            const float denom       = r1CrossR2.Mag2() + POW2( fCoreRadius ) * r0.Mag2() + sAvoidSingularity ;
+            const float projection  = r0 * ( r1 * finvsqrtf( r1.Mag2() + sAvoidSingularity ) - r2 * finvsqrtf( r2.Mag2() + sAvoidSingularity ) ) ;
+            vVelocity += r1CrossR2 * ( OneOverFourPi * fCirculation * projection / denom ) ;
+        }
+
+        /*! \brief Compute velocity induced by every segment of this filament
+
+            \param vVelocity - (in/out) variable in which to accumulate velocity
+
+            \param vPosQuery - position where we want to know velocity
+        */
+        void AccumulateVelocity( Vec3 & vVelocity , const Vec3 & vPosQuery ) const
+        {
+            const size_t numSegments = GetNumSegments() ;
+            for( size_t iSegment = 0 ; iSegment < numSegments ; ++ iSegment )
+            {   // For each segment...
+                AccumulateSegmentVelocity( vVelocity , vPosQuery , GetSegmentBegin( iSegment ) , GetSegmentEnd( iSegment ) , mCirculation , mCoreRadius ) ;
+            }
+        }
+
+        /*! \brief Remove nodes that crowd together and insert nodes where segments stretched
+
+            \return whether the filament still has any segments.
+                    When it has collapsed to fewer, caller should discard it.
+
+            This first merges segments shorter than mMinSegmentLength into their
+            successors, then splits segments longer than mMaxSegmentLength.
+            New nodes lie on a Catmull-Rom spline through neighboring nodes,
+            so refinement preserves curvature instead of flattening corners.
+            Open filaments keep their endpoints.
+        */
+        bool Refine( void )
+        {
+            // Merge short segments by removing interior nodes.
+            Vector< Vec3 > coarse ;
+            coarse.Reserve( mNodes.Size() ) ;
+            const size_t numNodes = mNodes.Size() ;
+            for( size_t iNode = 0 ; iNode < numNodes ; ++ iNode )
+            {   // For each node...
+                const bool bEndpoint = ( 0 == iNode ) || ( ! mClosed && ( iNode + 1 == numNodes ) ) ;
+                if( ! bEndpoint && ( ( mNodes[ iNode ] - coarse.Back() ).Mag2() < POW2( mMinSegmentLength ) ) )
+                {   // Node lies too close to its predecessor, so drop it.
+                    continue ;
+                }
+                coarse.PushBack( mNodes[ iNode ] ) ;
+            }
+            if( mClosed && ( coarse.Size() > 3 ) && ( ( coarse.Back() - coarse.Front() ).Mag2() < POW2( mMinSegmentLength ) ) )
+            {   // Closing segment is too short, so drop last node.
+                coarse.PopBack() ;
+            }
+            if( coarse.Size() < ( mClosed ? 3u : 2u ) )
+            {   // Filament collapsed.
+                mNodes.Clear() ;
+                return false ;
+            }
+
+            // Split long segments.
+            mNodes.Clear() ;
+            const size_t numCoarse      = coarse.Size() ;
+            const size_t numSegments    = mClosed ? numCoarse : numCoarse - 1 ;
+            for( size_t iSegment = 0 ; iSegment < numSegments ; ++ iSegment )
+            {   // For each segment...
+                const Vec3 & p1 = coarse[ iSegment ] ;
+                const Vec3 & p2 = coarse[ ( iSegment + 1 ) % numCoarse ] ;
+                mNodes.PushBack( p1 ) ;
+                const float length = ( p2 - p1 ).Magnitude() ;
+                if( length > mMaxSegmentLength )
+                {   // Segment is too long, so subdivide it.
+                    // Neighbors shape the spline.  At ends of open filaments, duplicate the endpoint.
+                    const bool      bHasPrev    = mClosed || ( iSegment > 0 ) ;
+                    const bool      bHasNext    = mClosed || ( iSegment + 2 < numCoarse ) ;
+                    const Vec3 &    p0          = bHasPrev ? coarse[ ( iSegment + numCoarse - 1 ) % numCoarse ] : p1 ;
+                    const Vec3 &    p3          = bHasNext ? coarse[ ( iSegment + 2 ) % numCoarse ] : p2 ;
+                    const unsigned  numPieces   = unsigned( ceilf( length / mMaxSegmentLength ) ) ;
+                    for( unsigned iPiece = 1 ; iPiece < numPieces ; ++ iPiece )
+                    {   // For each new node...
+                        const float t   = float( iPiece ) / float( numPieces ) ;
+                        const float t2  = t * t ;
+                        const float t3  = t2 * t ;
+                        mNodes.PushBack( 0.5f * (   2.0f * p1
+                                                +   ( p2 - p0 ) * t
+                                                +   ( 2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3 ) * t2
+                                                +   ( 3.0f * ( p1 - p2 ) + p3 - p0 ) * t3 ) ) ;
+                    }
+                }
+            }
+            if( ! mClosed )
+            {   // Open filament has one more node than segments.
+                mNodes.PushBack( coarse.Back() ) ;
+            }
+            return true ;
+        }
+
+        Vector< Vec3 >  mNodes              ;   ///< Positions of nodes.  Segment i joins node i to node i+1.
+        float           mCirculation        ;   ///< Circulation of every segment
+        float           mCoreRadius         ;   ///< Radius of core, which regularizes induced velocity near segments
+        float           mMinSegmentLength   ;   ///< Refine merges segments shorter than this
+        float           mMaxSegmentLength   ;   ///< Refine splits segments longer than this
+        bool            mClosed             ;   ///< Whether the last node connects back to the first
+} ;
+
+// Public variables --------------------------------------------------------------
+// Public functions --------------------------------------------------------------
+
+#endif
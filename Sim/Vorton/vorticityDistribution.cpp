@@ -37,7 +37,7 @@ static const float sTiny = expf( 0.5f * ( logf( FLT_EPSILON ) + logf( FLT_MIN )
         Suggested value provided should be at least 512, which corresponds to an 8x8x8 grid.
 
 */
-void AssignVorticity( Vector<Vorton> & vortons , float fMagnitude , unsigned numVortonsMax , const IVorticityDistribution & vorticityDistribution )
+void AssignVorticity( ChunkedVector<Vorton> & vortons , float fMagnitude , unsigned numVortonsMax , const IVorticityDistribution & vorticityDistribution )
 {
     const Vec3          vDimensions     = vorticityDistribution.GetDomainSize() ;       // length of each side of grid box
     const Vec3          vCenter         ( 0.0f , 0.0f , 0.0f ) ;                        // Center of vorticity distribution
@@ -96,3 +96,33 @@ void AssignVorticity( Vector<Vorton> & vortons , float fMagnitude , unsigned num
         }
     }
 }
+
+
+
+
+/*! \brief Create a vorticity field using a vortex filament
+
+    \param filaments - (out) array of vortex filaments, to which this appends
+
+    \param fMagnitude - maximum value of vorticity, as for AssignVorticity
+
+    \param numSegments - number of segments into which to divide the filament.
+        Far fewer segments than AssignVorticity would need vortons suffice,
+        since segments describe only the centerline of the core.
+
+    \param vorticityDistribution - vorticity distribution which the filament should approximate
+
+    \return whether the distribution concentrates vorticity along a curve.
+        When false, this appends nothing, and caller should use AssignVorticity instead.
+
+*/
+bool AssignFilaments( Vector<VortexFilament> & filaments , float fMagnitude , unsigned numSegments , const IVorticityDistribution & vorticityDistribution )
+{
+    VortexFilament filament ;
+    if( ! vorticityDistribution.AssignFilament( filament , fMagnitude , numSegments ) )
+    {   // Distribution has no filament equivalent.
+        return false ;
+    }
+    filaments.PushBack( filament ) ;
+    return true ;
+}
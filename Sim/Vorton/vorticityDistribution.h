@@ -13,8 +13,10 @@
 #include <math.h>
 
 #include "Core/Math/vec3.h"
+#include "Core/Memory/chunkedVector.h"
 #include "wrapperMacros.h"
 #include "vorton.h"
+#include "vortexFilament.h"
 
 // Macros --------------------------------------------------------------
 
@@ -30,6 +32,20 @@ class IVorticityDistribution
     public:
         virtual Vec3 GetDomainSize( void ) const = 0 ;
         virtual void AssignVorticity( Vec3 & vorticity , const Vec3 & position , const Vec3 & vCenter ) const = 0 ;
+
+        /*! \brief Assign a vortex filament equivalent to this distribution, if one exists
+
+            \param filament - (out) filament whose circulation and centerline match those of this distribution
+
+            \param fMagnitude - scale factor for vorticity, as for AssignVorticity
+
+            \param numSegments - number of segments into which to divide filament
+
+            \return whether this distribution concentrates vorticity along a curve, so a filament can represent it
+
+            \see AssignFilaments
+        */
+        virtual bool AssignFilament( VortexFilament & /* filament */ , float /* fMagnitude */ , unsigned /* numSegments */ ) const { return false ; }
 } ;
 
 
@@ -92,6 +108,15 @@ class VortexRing : public IVorticityDistribution
             }
         }
 
+        virtual bool AssignFilament( VortexFilament & filament , float fMagnitude , unsigned numSegments ) const
+        {
+            // Circulation is the integral of the core profile, 0.5 ( cos( Pi r / mThickness ) + 1 ), over the disc r < mThickness.
+            const float circulation = fMagnitude * POW2( mThickness ) * ( 0.5f * Pi - 2.0f / Pi ) ;
+            filament = VortexFilament( circulation , 0.5f * mThickness , TwoPi * mRadius / float( numSegments ) , true ) ;
+            filament.AssignRing( Vec3( 0.0f , 0.0f , 0.0f ) , mRadius , mDirection , numSegments ) ;
+            return true ;
+        }
+
         float   mRadius     ;
         float   mThickness  ;
         Vec3    mDirection  ;
@@ -163,6 +188,19 @@ class JetRing : public IVorticityDistribution
             }
         }
 
+        virtual bool AssignFilament( VortexFilament & filament , float fMagnitude , unsigned numSegments ) const
+        {
+            // Circulation is the integral of the vorticity profile over the half-plane through the axis:
+            // streamwise profile integrates to mRadiusSlug and radial profile integrates to 2 mThickness / Pi.
+            const float circulation = fMagnitude * 2.0f * mRadiusSlug ;
+            const float radiusRing  = mRadiusSlug + 0.5f * mThickness ;
+            // Core is elongated: 2 mRadiusSlug long and mThickness wide.  Use geometric mean of half-widths.
+            const float radiusCore  = sqrtf( 0.5f * mRadiusSlug * mThickness ) ;
+            filament = VortexFilament( circulation , radiusCore , TwoPi * radiusRing / float( numSegments ) , true ) ;
+            filament.AssignRing( Vec3( 0.0f , 0.0f , 0.0f ) , radiusRing , mDirection , numSegments ) ;
+            return true ;
+        }
+
         float   mRadiusSlug     ;   ///< Radius of central region of jet, where velocity is uniform.
         float   mThickness      ;   ///< Thickness of region outside central jet, where velocity decays gradually
         float   mRadiusOuter    ;   ///< Radius of jet, including central region and gradial falloff.
@@ -260,6 +298,35 @@ class VortexTube : public IVorticityDistribution
             }
         }
 
+        /*! \brief Assign a straight filament along the centerline of this tube
+
+            The filament has the circulation of the unmodulated tube, so it ignores mVariation.
+        */
+        virtual bool AssignFilament( VortexFilament & filament , float fMagnitude , unsigned numSegments ) const
+        {
+            // Circulation is the integral of the core profile, 0.5 ( cos( Pi r / mRadius ) + 1 ), over the disc r < mRadius.
+            const float circulation = fMagnitude * POW2( mRadius ) * ( 0.5f * Pi - 2.0f / Pi ) ;
+            filament = VortexFilament( circulation , 0.5f * mRadius , mWidth / float( numSegments ) , false ) ;
+            const float halfWidth = 0.5f * mWidth ;
+            if( 0 == mLocation )
+            {
+                filament.AssignLine( Vec3( 0.0f , - halfWidth , 0.0f ) , Vec3( 0.0f , halfWidth , 0.0f ) , numSegments ) ;
+            }
+            else if( 1 == mLocation )
+            {
+                filament.AssignLine( Vec3( 0.0f , - halfWidth , mRadius ) , Vec3( 0.0f , halfWidth , mRadius ) , numSegments ) ;
+            }
+            else if( -1 == mLocation )
+            {
+                filament.AssignLine( Vec3( - halfWidth , 0.0f , - mRadius ) , Vec3( halfWidth , 0.0f , - mRadius ) , numSegments ) ;
+            }
+            else
+            {
+                return false ;
+            }
+            return true ;
+        }
+
         float   mRadius     ;   ///< Maximum radius of vortex tube
         float   mVariation  ;   ///< Amplitude of radius variation
         float   mWidth      ;   ///< Spanwise width of domain
@@ -370,7 +437,8 @@ class VortexNoise : public IVorticityDistribution
 
 // Public functions --------------------------------------------------------------
 
-extern void AddCornerVortons( Vector<Vorton> & vortons , const Vec3 & vMin , const Vec3 & vMax ) ;
-extern void AssignVorticity( Vector<Vorton> & vortons , float fMagnitude , unsigned numVortonsMax , const IVorticityDistribution & vorticityDistribution ) ;
+extern void AddCornerVortons( ChunkedVector<Vorton> & vortons , const Vec3 & vMin , const Vec3 & vMax ) ;
+extern void AssignVorticity( ChunkedVector<Vorton> & vortons , float fMagnitude , unsigned numVortonsMax , const IVorticityDistribution & vorticityDistribution ) ;
+extern bool AssignFilaments( Vector<VortexFilament> & filaments , float fMagnitude , unsigned numSegments , const IVorticityDistribution & vorticityDistribution ) ;
 
 #endif
@@ -13,6 +13,7 @@
 #include <math.h>
 
 #include "Core/Math/vec3.h"
+#include "Core/Math/half.h"
 #include "wrapperMacros.h"
 
 // Macros --------------------------------------------------------------
@@ -73,6 +74,15 @@ class Vorton
         {
         }
 
+        Vorton & operator=( const Vorton & that )
+        {
+            mPosition   = that.mPosition    ;
+            mVorticity  = that.mVorticity   ;
+            mRadius     = that.mRadius      ;
+            mVelocity   = that.mVelocity    ;
+            return * this ;
+        }
+
         /*! \brief Compute velocity induced by a tiny vortex element (a vorton)
 
             \param vVelocity - (in/out) variable in which to accumulate velocity
@@ -127,6 +137,23 @@ class Vorton
         Vec3    mVelocity   ;   ///< Velocity of this vorton -- used to cache value obtained during advection, to optimize collision response.
 } ;
 
+
+
+
+/*! \brief Vorton stored in a 16-bit float format, for reading by influence tree traversals
+
+    This holds only what VORTON_ACCUMULATE_VELOCITY reads, in 16 bytes instead of
+    the 40 of a Vorton.  Position is relative to the minimal corner of the cell
+    that holds it, which keeps its magnitude small, so it retains more precision.
+
+    \see VortonSim::PackInfluenceTree
+*/
+struct PackedVorton
+{
+    PackedFloat4    mPositionRadius ;   ///< Position relative to minimal corner of its cell, in xyz, and radius, in w
+    PackedFloat4    mVorticity      ;   ///< Vorticity, in xyz.  w is unused.
+} ;
+
 // Public variables --------------------------------------------------------------
 
 // Public functions --------------------------------------------------------------
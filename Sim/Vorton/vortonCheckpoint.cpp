@@ -0,0 +1,452 @@
+/*! \file vortonCheckpoint.cpp
+
+    \brief Checkpoints of vorton simulations, and upsampling them to restart at higher resolution
+
+    \author Copyright 2009 Dr. Michael Jason Gourlay; All rights reserved.
+*/
+
+#include <string.h>
+
+#include "Core/Math/vec3.h"
+
+#include "vortonSim.h"
+
+// Private variables --------------------------------------------------------------
+
+/*! \brief First bytes of every checkpoint, identifying its format and version
+*/
+static const char sCheckpointHeader[] = "VortonSim checkpoint 2" ;
+
+// Private types --------------------------------------------------------------
+
+/*! \brief Pseudo-random number generator whose state is its own, so using it neither depends on nor disturbs rand
+
+    This is a linear congruential generator, which suffices for perturbations and jitter.
+*/
+class UpsampleRandom
+{
+    public:
+        explicit UpsampleRandom( unsigned seed )
+            : mState( seed )
+        {
+        }
+
+        /// Return a pseudo-random number between -fSpread/2 and fSpread/2, like RandomSpread.
+        float Spread( float fSpread )
+        {
+            mState = mState * 1664525u + 1013904223u ;
+            return fSpread * ( float( ( mState >> 8 ) & 0xffffff ) / float( 0xffffff ) - 0.5f ) ;
+        }
+
+        /// Return a pseudo-random vector whose components lie between -vSpread/2 and vSpread/2, like RandomSpread.
+        Vec3 Spread( const Vec3 & vSpread )
+        {
+            const float x = Spread( vSpread.x ) ;
+            const float y = Spread( vSpread.y ) ;
+            const float z = Spread( vSpread.z ) ;
+            return Vec3( x , y , z ) ;
+        }
+
+    private:
+        unsigned    mState  ;   ///< Most recent number in the sequence
+} ;
+
+// Private functions --------------------------------------------------------------
+
+/*! \brief Write the contents of an array of plain data to a file, preceded by its length
+*/
+template< typename ItemT > static bool WriteArray( FILE * pFile , const Vector< ItemT > & items )
+{
+    const unsigned numItems = unsigned( items.Size() ) ;
+    if( fwrite( & numItems , sizeof( numItems ) , 1 , pFile ) != 1 )
+    {
+        return false ;
+    }
+    return ( 0 == numItems ) || ( fwrite( & items[ 0 ] , sizeof( ItemT ) , numItems , pFile ) == numItems ) ;
+}
+
+
+
+
+/*! \brief Read an array that WriteArray wrote
+*/
+template< typename ItemT > static bool ReadArray( FILE * pFile , Vector< ItemT > & items )
+{
+    unsigned numItems ;
+    if( fread( & numItems , sizeof( numItems ) , 1 , pFile ) != 1 )
+    {
+        return false ;
+    }
+    items.Clear() ;
+    items.Resize( numItems ) ;
+    return ( 0 == numItems ) || ( fread( & items[ 0 ] , sizeof( ItemT ) , numItems , pFile ) == numItems ) ;
+}
+
+
+
+
+/*! \brief Write the contents of a chunked array of plain data to a file, in the same format as for a Vector
+*/
+template< typename ItemT > static bool WriteArray( FILE * pFile , const ChunkedVector< ItemT > & items )
+{
+    const unsigned numItems = unsigned( items.Size() ) ;
+    if( fwrite( & numItems , sizeof( numItems ) , 1 , pFile ) != 1 )
+    {
+        return false ;
+    }
+    const size_t numChunks = items.GetNumChunks() ;
+    for( size_t iChunk = 0 ; iChunk < numChunks ; ++ iChunk )
+    {   // For each chunk, within which elements are contiguous...
+        const size_t numInChunk = MIN2( ChunkedVector< ItemT >::CHUNK_SIZE , numItems - iChunk * ChunkedVector< ItemT >::CHUNK_SIZE ) ;
+        if( fwrite( items.GetChunk( iChunk ) , sizeof( ItemT ) , numInChunk , pFile ) != numInChunk )
+        {
+            return false ;
+        }
+    }
+    return true ;
+}
+
+
+
+
+/*! \brief Read a chunked array that WriteArray wrote
+*/
+template< typename ItemT > static bool ReadArray( FILE * pFile , ChunkedVector< ItemT > & items )
+{
+    Vector< ItemT > contiguous ;
+    const bool      bOk         = ReadArray( pFile , contiguous ) ;
+    const size_t    numItems    = contiguous.Size() ;
+    items.Clear() ;
+    items.Reserve( numItems ) ;
+    for( size_t iItem = 0 ; iItem < numItems ; ++ iItem )
+    {
+        items.PushBack( contiguous[ iItem ] ) ;
+    }
+    return bOk ;
+}
+
+
+
+
+/*! \brief Write a value of plain data to a file
+*/
+template< typename ItemT > static bool WriteValue( FILE * pFile , const ItemT & item )
+{
+    return fwrite( & item , sizeof( ItemT ) , 1 , pFile ) == 1 ;
+}
+
+
+
+
+/*! \brief Read a value that WriteValue wrote
+*/
+template< typename ItemT > static bool ReadValue( FILE * pFile , ItemT & item )
+{
+    return fread( & item , sizeof( ItemT ) , 1 , pFile ) == 1 ;
+}
+
+
+
+
+/*! \brief Remove the mean and the linear trend from perturbations assigned to a lattice of children
+
+    \param perturbations - (in/out) perturbation of each child
+
+    \param displacements - displacement of each child from the center of the lattice
+
+    \param sumDisp2 - sum of squares, along each axis, of the displacements,
+        which for a lattice symmetric about its center is also the
+        diagonal of the sum of outer products of displacements.
+        Zero for an axis along which the lattice has no extent.
+
+    Afterward, the perturbations sum to zero, as do their moments about the
+    lattice center, so they change neither the circulation nor the
+    linear impulse of the vortons they perturb.
+*/
+static void RemoveMeanAndTrend( Vector< Vec3 > & perturbations , const Vector< Vec3 > & displacements , const Vec3 & sumDisp2 )
+{
+    const size_t numChildren = perturbations.Size() ;
+    Vec3 vMean( 0.0f , 0.0f , 0.0f ) ;
+    for( size_t iChild = 0 ; iChild < numChildren ; ++ iChild )
+    {
+        vMean += perturbations[ iChild ] ;
+    }
+    vMean /= float( numChildren ) ;
+
+    // Least-squares fit of perturbation = A * displacement, where row j of A is vTrend[j].
+    Vec3 vTrend[ 3 ] = { Vec3( 0.0f , 0.0f , 0.0f ) , Vec3( 0.0f , 0.0f , 0.0f ) , Vec3( 0.0f , 0.0f , 0.0f ) } ;
+    for( size_t iChild = 0 ; iChild < numChildren ; ++ iChild )
+    {
+        const Vec3 vDeviation = perturbations[ iChild ] - vMean ;
+        vTrend[ 0 ] += vDeviation.x * displacements[ iChild ] ;
+        vTrend[ 1 ] += vDeviation.y * displacements[ iChild ] ;
+        vTrend[ 2 ] += vDeviation.z * displacements[ iChild ] ;
+    }
+    const Vec3 vSumDisp2Inv( sumDisp2.x > 0.0f ? 1.0f / sumDisp2.x : 0.0f
+                           , sumDisp2.y > 0.0f ? 1.0f / sumDisp2.y : 0.0f
+                           , sumDisp2.z > 0.0f ? 1.0f / sumDisp2.z : 0.0f ) ;
+    for( unsigned j = 0 ; j < 3 ; ++ j )
+    {
+        vTrend[ j ] = Vec3( vTrend[ j ].x * vSumDisp2Inv.x , vTrend[ j ].y * vSumDisp2Inv.y , vTrend[ j ].z * vSumDisp2Inv.z ) ;
+    }
+
+    for( size_t iChild = 0 ; iChild < numChildren ; ++ iChild )
+    {
+        const Vec3 & vDisp = displacements[ iChild ] ;
+        perturbations[ iChild ] -= vMean + Vec3( vTrend[ 0 ] * vDisp , vTrend[ 1 ] * vDisp , vTrend[ 2 ] * vDisp ) ;
+    }
+}
+
+// Public functions --------------------------------------------------------------
+
+/*! \brief Write the state of this simulation to a file
+
+    \param pFile - file, opened for binary writing, to which to write
+
+    \return whether writing succeeded
+
+    This writes vortons, filaments, tracers and the quantities that
+    Initialize computes from them, which suffices to resume the simulation
+    with ReadCheckpoint, without Initialize.  It omits everything that
+    Update recomputes each frame, such as the influence tree and velocity grid.
+
+    Particles are written as they lie in memory, so only builds with the same
+    layout of Vorton and Particle can read the checkpoint.
+
+    \see ReadCheckpoint, Upsample
+*/
+bool VortonSim::WriteCheckpoint( FILE * pFile ) const
+{
+    if( fwrite( sCheckpointHeader , sizeof( sCheckpointHeader ) , 1 , pFile ) != 1 )
+    {
+        return false ;
+    }
+    bool bOk =  WriteValue( pFile , mCirculationInitial )
+            &&  WriteValue( pFile , mLinearImpulseInitial )
+            &&  WriteValue( pFile , mMassPerVorton )
+            &&  WriteValue( pFile , mMassPerTracer )
+            &&  WriteArray( pFile , mVortons )
+            &&  WriteArray( pFile , mTracers ) ;
+    const unsigned numFilaments = unsigned( mFilaments.Size() ) ;
+    bOk = bOk && WriteValue( pFile , numFilaments ) ;
+    for( unsigned iFilament = 0 ; bOk && ( iFilament < numFilaments ) ; ++ iFilament )
+    {   // For each vortex filament...
+        const VortexFilament & rFilament = mFilaments[ iFilament ] ;
+        bOk =   WriteArray( pFile , rFilament.mNodes )
+            &&  WriteValue( pFile , rFilament.mCirculation )
+            &&  WriteValue( pFile , rFilament.mCoreRadius )
+            &&  WriteValue( pFile , rFilament.mMinSegmentLength )
+            &&  WriteValue( pFile , rFilament.mMaxSegmentLength )
+            &&  WriteValue( pFile , rFilament.mClosed ) ;
+    }
+    return bOk ;
+}
+
+
+
+
+/*! \brief Replace the state of this simulation with that which WriteCheckpoint wrote
+
+    \param pFile - file, opened for binary reading, from which to read
+
+    \return whether the file held a valid checkpoint.
+        If not, this simulation is empty afterward.
+
+    \note Construct this simulation with the same viscosity and density as the one that wrote the checkpoint.
+
+    \see WriteCheckpoint
+*/
+bool VortonSim::ReadCheckpoint( FILE * pFile )
+{
+    Clear() ;
+
+    char header[ sizeof( sCheckpointHeader ) ] ;
+    if( ( fread( header , sizeof( header ) , 1 , pFile ) != 1 ) || ( memcmp( header , sCheckpointHeader , sizeof( header ) ) != 0 ) )
+    {   // File is not a checkpoint.
+        return false ;
+    }
+    bool bOk =  ReadValue( pFile , mCirculationInitial )
+            &&  ReadValue( pFile , mLinearImpulseInitial )
+            &&  ReadValue( pFile , mMassPerVorton )
+            &&  ReadValue( pFile , mMassPerTracer )
+            &&  ReadArray( pFile , mVortons )
+            &&  ReadArray( pFile , mTracers ) ;
+    unsigned numFilaments = 0 ;
+    bOk = bOk && ReadValue( pFile , numFilaments ) ;
+    mFilaments.Resize( bOk ? numFilaments : 0 ) ;
+    for( unsigned iFilament = 0 ; bOk && ( iFilament < numFilaments ) ; ++ iFilament )
+    {   // For each vortex filament...
+        VortexFilament & rFilament = mFilaments[ iFilament ] ;
+        bOk =   ReadArray( pFile , rFilament.mNodes )
+            &&  ReadValue( pFile , rFilament.mCirculation )
+            &&  ReadValue( pFile , rFilament.mCoreRadius )
+            &&  ReadValue( pFile , rFilament.mMinSegmentLength )
+            &&  ReadValue( pFile , rFilament.mMaxSegmentLength )
+            &&  ReadValue( pFile , rFilament.mClosed ) ;
+    }
+    if( ! bOk )
+    {   // Checkpoint was truncated.
+        Clear() ;
+        return false ;
+    }
+    ComputeAverageVorticity() ;
+    return true ;
+}
+
+
+
+
+/*! \brief Increase the resolution of this simulation, to restart a developed flow at higher resolution
+
+    \param vortonRefinement - number of smaller vortons into which to split each vorton, along each axis
+
+    \param tracerRefinement - number of tracers into which to split each tracer, along each axis
+
+    \param perturbation - magnitude, relative to each vorton's vorticity, of random vorticity to add to its children
+
+    \param randomSeed - seed for the pseudo-random numbers that perturb vortons and jitter tracers
+
+    This replaces each vorton with a lattice of vortonRefinement^3 vortons,
+    each with 1/vortonRefinement the radius, which fill the volume of the
+    original.  Children inherit the vorticity of their parent, so together
+    they have the same circulation, and since they lie symmetrically about
+    the parent, the same linear impulse.
+
+    The random perturbation seeds the small scales that the coarse
+    simulation could not represent, so they develop sooner in the fine one.
+    Each lattice's perturbations have no mean and no linear trend, so they
+    preserve both circulation and linear impulse.
+
+    CreateInfluenceTree sizes grids according to the number of vortons,
+    so the next Update runs at correspondingly higher resolution.
+
+    If vortons lie in a plane, this does not split them across it.
+    Then each lattice has fewer children, whose vorticity grows to
+    compensate, so circulation and impulse remain the same.
+
+    Children of vortons and of tracers each carry a share of their
+    parent's mass, so the total mass of each kind of particle remains
+    the same.  The pseudo-random numbers come from a generator local to
+    this call, so the same seed always yields the same children, and
+    the sequence that rand returns elsewhere remains undisturbed.
+
+    Vortex filaments remain unchanged, since Refine already adapts their resolution.
+
+    \see ReadCheckpoint
+*/
+void VortonSim::Upsample( unsigned vortonRefinement , unsigned tracerRefinement , float perturbation , unsigned randomSeed )
+{
+    UpsampleRandom random( randomSeed ) ;
+
+    // Split vortons.
+    if( vortonRefinement > 1 )
+    {
+        FindBoundingBox() ;
+        const Vec3      vExtent         = mMaxCorner - mMinCorner ;
+        const unsigned  numPerAxis[3]   = { vExtent.x > 0.0f ? vortonRefinement : 1
+                                          , vExtent.y > 0.0f ? vortonRefinement : 1
+                                          , vExtent.z > 0.0f ? vortonRefinement : 1 } ;
+        const unsigned  numChildren     = numPerAxis[0] * numPerAxis[1] * numPerAxis[2] ;
+        const float     vorticityScale  = float( POW3( vortonRefinement ) ) / float( numChildren ) ;   // Compensates for axes along which vortons do not split.
+
+        // Displacements of children, in units of their parent's radius.
+        Vector< Vec3 >  unitDisplacements ;
+        Vec3            vSumDisp2( 0.0f , 0.0f , 0.0f ) ;
+        unsigned        idx[3] ;
+        for( idx[2] = 0 ; idx[2] < numPerAxis[2] ; ++ idx[2] )
+        for( idx[1] = 0 ; idx[1] < numPerAxis[1] ; ++ idx[1] )
+        for( idx[0] = 0 ; idx[0] < numPerAxis[0] ; ++ idx[0] )
+        {   // For each child in lattice...
+            // Parent occupies a cube 2 radii across, and children lie at the centers of its sub-cubes.
+            const Vec3 vDisp( float( 2 * idx[0] + 1 ) / float( numPerAxis[0] ) - 1.0f
+                            , float( 2 * idx[1] + 1 ) / float( numPerAxis[1] ) - 1.0f
+                            , float( 2 * idx[2] + 1 ) / float( numPerAxis[2] ) - 1.0f ) ;
+            unitDisplacements.PushBack( vDisp ) ;
+            vSumDisp2 += Vec3( vDisp.x * vDisp.x , vDisp.y * vDisp.y , vDisp.z * vDisp.z ) ;
+        }
+
+        const size_t    numVortons      = mVortons.Size() ;
+        const ChunkedVector< Vorton > & rVortons = mVortons ;
+        ChunkedVector< Vorton > children ;
+        Vector< Vec3 >  perturbations( numChildren ) ;
+        children.Reserve( numVortons * numChildren ) ;
+        for( size_t iVorton = 0 ; iVorton < numVortons ; ++ iVorton )
+        {   // For each vorton...
+            const Vorton &  rParent         = rVortons[ iVorton ] ;
+            const float     perturbMag      = perturbation * rParent.mVorticity.Magnitude() ;
+            for( unsigned iChild = 0 ; iChild < numChildren ; ++ iChild )
+            {
+                perturbations[ iChild ] = random.Spread( Vec3( perturbMag , perturbMag , perturbMag ) ) ;
+            }
+            RemoveMeanAndTrend( perturbations , unitDisplacements , vSumDisp2 ) ;
+            for( unsigned iChild = 0 ; iChild < numChildren ; ++ iChild )
+            {   // For each child of this vorton...
+                Vorton child( rParent.mPosition + rParent.mRadius * unitDisplacements[ iChild ]
+                            , vorticityScale * ( rParent.mVorticity + perturbations[ iChild ] )
+                            , rParent.mRadius / float( vortonRefinement ) ) ;
+                child.mVelocity = rParent.mVelocity ;
+                children.PushBack( child ) ;
+            }
+        }
+        mVortons.Swap( children ) ;
+        // Mass is conserved, so each vorton carries a share of its parent's.
+        mMassPerVorton /= float( numChildren ) ;
+        ComputeAverageVorticity() ;
+    }
+
+    // Densify tracers.
+    const size_t numTracers = mTracers.Size() ;
+    if( ( tracerRefinement > 1 ) && ( numTracers > 0 ) )
+    {
+        const ChunkedVector< Particle > & rTracers = mTracers ;
+
+        // Estimate spacing between tracers from the volume they occupy.
+        Vec3 vMin( rTracers[ 0 ].mPosition ) ;
+        Vec3 vMax( rTracers[ 0 ].mPosition ) ;
+        for( size_t iTracer = 0 ; iTracer < numTracers ; ++ iTracer )
+        {
+            const Vec3 & vPos = rTracers[ iTracer ].mPosition ;
+            vMin = Vec3( MIN2( vMin.x , vPos.x ) , MIN2( vMin.y , vPos.y ) , MIN2( vMin.z , vPos.z ) ) ;
+            vMax = Vec3( MAX2( vMax.x , vPos.x ) , MAX2( vMax.y , vPos.y ) , MAX2( vMax.z , vPos.z ) ) ;
+        }
+        const Vec3      vExtent         = vMax - vMin ;
+        const unsigned  numPerAxis[3]   = { vExtent.x > 0.0f ? tracerRefinement : 1
+                                          , vExtent.y > 0.0f ? tracerRefinement : 1
+                                          , vExtent.z > 0.0f ? tracerRefinement : 1 } ;
+        const float     extents[3]      = { vExtent.x , vExtent.y , vExtent.z } ;
+        float           volume          = 1.0f ;
+        unsigned        numDims         = 0 ;
+        for( unsigned i = 0 ; i < 3 ; ++ i )
+        {   // For each axis along which tracers spread...
+            if( extents[ i ] > 0.0f )
+            {
+                volume *= extents[ i ] ;
+                ++ numDims ;
+            }
+        }
+        const float spacing     = ( numDims > 0 ) ? powf( volume / float( numTracers ) , 1.0f / float( numDims ) ) : 0.0f ;
+        const Vec3  vSubSpacing = Vec3( float( numPerAxis[0] > 1 ) , float( numPerAxis[1] > 1 ) , float( numPerAxis[2] > 1 ) ) * ( spacing / float( tracerRefinement ) ) ;
+
+        ChunkedVector< Particle > children ;
+        children.Reserve( numTracers * numPerAxis[0] * numPerAxis[1] * numPerAxis[2] ) ;
+        for( size_t iTracer = 0 ; iTracer < numTracers ; ++ iTracer )
+        {   // For each tracer...
+            Particle child = rTracers[ iTracer ] ;
+            child.mSize /= float( tracerRefinement ) ;
+            unsigned idx[3] ;
+            for( idx[2] = 0 ; idx[2] < numPerAxis[2] ; ++ idx[2] )
+            for( idx[1] = 0 ; idx[1] < numPerAxis[1] ; ++ idx[1] )
+            for( idx[0] = 0 ; idx[0] < numPerAxis[0] ; ++ idx[0] )
+            {   // For each child of this tracer, spread children over the space the parent represented, like InitializePassiveTracers does.
+                const Vec3 vShift( ( float( idx[0] ) - 0.5f * float( numPerAxis[0] - 1 ) ) * vSubSpacing.x
+                                 , ( float( idx[1] ) - 0.5f * float( numPerAxis[1] - 1 ) ) * vSubSpacing.y
+                                 , ( float( idx[2] ) - 0.5f * float( numPerAxis[2] - 1 ) ) * vSubSpacing.z ) ;
+                child.mPosition = rTracers[ iTracer ].mPosition + vShift + random.Spread( vSubSpacing ) ;
+                children.PushBack( child ) ;
+            }
+        }
+        mTracers.Swap( children ) ;
+        // Mass is conserved, so each tracer carries a share of its parent's.
+        mMassPerTracer /= float( numPerAxis[0] * numPerAxis[1] * numPerAxis[2] ) ;
+    }
+}
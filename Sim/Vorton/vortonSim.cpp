@@ -6,8 +6,12 @@
 */
 
 #include <stdlib.h>
+#include <float.h>
+
+#include <algorithm>
 
 #include "Core/Performance/perf.h"
+#include "Core/Math/vec3x.h"
 #include "Space/uniformGridMath.h"
 #include "vortonClusterAux.h"
 #include "vorticityDistribution.h"
@@ -16,6 +20,44 @@
 
 
 
+/*! \brief Sum per-chunk vorticity splats and normalize them, for a subset of z-slices
+
+    \param vortGrids - grids of weighted vorticity sums, one per chunk of vortons.
+        Upon return, vortGrids[0] contains the weighted average vorticity of all chunks.
+
+    \param weightGrids - grids of weight sums, one per chunk of vortons.
+
+    \param izStart - first z index to process
+
+    \param izEnd - one past the last z index to process
+
+    \see VortonSim::DiffuseVorticityGrid
+
+*/
+static void ReduceVorticitySplatsSlice( Vector< UniformGrid< Vec3 > > & vortGrids , Vector< UniformGrid< float > > & weightGrids , size_t izStart , size_t izEnd )
+{
+    const size_t    numChunks   = vortGrids.Size() ;
+    const unsigned  numXY       = vortGrids[0].GetNumPoints( 0 ) * vortGrids[0].GetNumPoints( 1 ) ;
+    const unsigned  offsetEnd   = unsigned( izEnd ) * numXY ;
+    for( unsigned offset = unsigned( izStart ) * numXY ; offset < offsetEnd ; ++ offset )
+    {   // For each gridpoint in this slice...
+        Vec3 &  rVortSum    = vortGrids[ 0 ][ offset ] ;
+        float   weightSum   = weightGrids[ 0 ][ offset ] ;
+        for( size_t iChunk = 1 ; iChunk < numChunks ; ++ iChunk )
+        {   // For each other chunk...
+            rVortSum  += vortGrids[ iChunk ][ offset ] ;
+            weightSum += weightGrids[ iChunk ][ offset ] ;
+        }
+        if( weightSum > 0.0f )
+        {   // Some vorton contributed to this gridpoint.
+            rVortSum /= weightSum ;
+        }
+    }
+}
+
+
+
+
 #if USE_TBB
     unsigned gNumberOfProcessors = 8 ;  // Number of processors this machine has.
 
@@ -27,7 +69,7 @@
         public:
             void operator() ( const tbb::blocked_range<size_t> & r ) const
             {   // Compute subset of velocity grid.
-                mVortonSim->ComputeVelocityGridSlice( r.begin() , r.end() ) ;
+                mVortonSim->ComputeVelocityGridTiles( r.begin() , r.end() ) ;
             }
             VortonSim_ComputeVelocityGrid_TBB( VortonSim * pVortonSim )
                 : mVortonSim( pVortonSim ) {}
@@ -51,355 +93,5249 @@
                 , mFrame( uFrame )
             {}
     } ;
-#endif
 
+    /*! \brief Function object to splat vorton vorticity onto per-chunk grids using Threading Building Blocks
+    */
+    class VortonSim_SplatVorticity_TBB
+    {
+            const VortonSim *                   mVortonSim ;    ///< Address of VortonSim object
+            Vector< UniformGrid< Vec3 > > &     mVortGrids ;
+            Vector< UniformGrid< float > > &    mWeightGrids ;
+        public:
+            void operator() ( const tbb::blocked_range<size_t> & r ) const
+            {   // Splat subset of chunks of vortons.
+                mVortonSim->SplatVorticityChunks( mVortGrids , mWeightGrids , r.begin() , r.end() ) ;
+            }
+            VortonSim_SplatVorticity_TBB( const VortonSim * pVortonSim , Vector< UniformGrid< Vec3 > > & vortGrids , Vector< UniformGrid< float > > & weightGrids )
+                : mVortonSim( pVortonSim )
+                , mVortGrids( vortGrids )
+                , mWeightGrids( weightGrids )
+            {}
+    } ;
 
+    /*! \brief Function object to combine per-chunk vorticity splats using Threading Building Blocks
+    */
+    class VortonSim_ReduceVorticitySplats_TBB
+    {
+            Vector< UniformGrid< Vec3 > > &     mVortGrids ;
+            Vector< UniformGrid< float > > &    mWeightGrids ;
+        public:
+            void operator() ( const tbb::blocked_range<size_t> & r ) const
+            {   // Reduce subset of z-slices.
+                ReduceVorticitySplatsSlice( mVortGrids , mWeightGrids , r.begin() , r.end() ) ;
+            }
+            VortonSim_ReduceVorticitySplats_TBB( Vector< UniformGrid< Vec3 > > & vortGrids , Vector< UniformGrid< float > > & weightGrids )
+                : mVortGrids( vortGrids )
+                , mWeightGrids( weightGrids )
+            {}
+    } ;
 
+    /*! \brief Function object to compute Laplacian of a grid using Threading Building Blocks
+    */
+    class VortonSim_ComputeLaplacian_TBB
+    {
+            UniformGrid< Vec3 > &       mLaplacian ;
+            const UniformGrid< Vec3 > & mVec ;
+        public:
+            void operator() ( const tbb::blocked_range<size_t> & r ) const
+            {   // Compute subset of z-slices.
+                ComputeLaplacian( mLaplacian , mVec , r.begin() , r.end() ) ;
+            }
+            VortonSim_ComputeLaplacian_TBB( UniformGrid< Vec3 > & laplacian , const UniformGrid< Vec3 > & vec )
+                : mLaplacian( laplacian )
+                , mVec( vec )
+            {}
+    } ;
 
-/*! \brief Compute velocity from vorton tree
+    /*! \brief Function object to apply the implicit diffusion operator using Threading Building Blocks
+    */
+    class VortonSim_ApplyDiffusionOperator_TBB
+    {
+            UniformGrid< Vec3 > &       mResult ;
+            const UniformGrid< Vec3 > & mVec ;
+            const float                 mDiffusivityTimesStep ;
+            Vector< double > &          mSliceDots ;
+        public:
+            void operator() ( const tbb::blocked_range<size_t> & r ) const
+            {   // Compute subset of z-slices.
+                ApplyDiffusionOperator( mResult , mVec , mDiffusivityTimesStep , mSliceDots , r.begin() , r.end() ) ;
+            }
+            VortonSim_ApplyDiffusionOperator_TBB( UniformGrid< Vec3 > & result , const UniformGrid< Vec3 > & vec , float diffusivityTimesStep , Vector< double > & sliceDots )
+                : mResult( result )
+                , mVec( vec )
+                , mDiffusivityTimesStep( diffusivityTimesStep )
+                , mSliceDots( sliceDots )
+            {}
+    } ;
 
-    ...as opposed to using brute force, which is much slower.
-*/
-#define VELOCITY_FROM_TREE 1
+    /*! \brief Function object to advance the solution of a conjugate-gradient solve using Threading Building Blocks
+    */
+    class VortonSim_UpdateConjugateGradientSolution_TBB
+    {
+            UniformGrid< Vec3 > &       mSoln ;
+            UniformGrid< Vec3 > &       mResidual ;
+            const UniformGrid< Vec3 > & mDirection ;
+            const UniformGrid< Vec3 > & mOperatorTimesDirection ;
+            const float                 mAlpha ;
+            Vector< double > &          mSliceDots ;
+        public:
+            void operator() ( const tbb::blocked_range<size_t> & r ) const
+            {   // Compute subset of z-slices.
+                UpdateConjugateGradientSolution( mSoln , mResidual , mDirection , mOperatorTimesDirection , mAlpha , mSliceDots , r.begin() , r.end() ) ;
+            }
+            VortonSim_UpdateConjugateGradientSolution_TBB( UniformGrid< Vec3 > & soln , UniformGrid< Vec3 > & residual , const UniformGrid< Vec3 > & direction , const UniformGrid< Vec3 > & operatorTimesDirection , float alpha , Vector< double > & sliceDots )
+                : mSoln( soln )
+                , mResidual( residual )
+                , mDirection( direction )
+                , mOperatorTimesDirection( operatorTimesDirection )
+                , mAlpha( alpha )
+                , mSliceDots( sliceDots )
+            {}
+    } ;
 
+    /*! \brief Function object to compute the next search direction of a conjugate-gradient solve using Threading Building Blocks
+    */
+    class VortonSim_UpdateConjugateGradientDirection_TBB
+    {
+            UniformGrid< Vec3 > &       mDirection ;
+            const UniformGrid< Vec3 > & mResidual ;
+            const float                 mBeta ;
+        public:
+            void operator() ( const tbb::blocked_range<size_t> & r ) const
+            {   // Compute subset of z-slices.
+                UpdateConjugateGradientDirection( mDirection , mResidual , mBeta , r.begin() , r.end() ) ;
+            }
+            VortonSim_UpdateConjugateGradientDirection_TBB( UniformGrid< Vec3 > & direction , const UniformGrid< Vec3 > & residual , float beta )
+                : mDirection( direction )
+                , mResidual( residual )
+                , mBeta( beta )
+            {}
+    } ;
 
+    /*! \brief Function object to gather vorticity change from a grid to vortons using Threading Building Blocks
+    */
+    class VortonSim_GatherVorticity_TBB
+    {
+            VortonSim *                 mVortonSim ;    ///< Address of VortonSim object
+            const UniformGrid< Vec3 > & mVortChange ;
+            const float                 mScale ;
+        public:
+            void operator() ( const tbb::blocked_range<size_t> & r ) const
+            {   // Gather to subset of vortons.
+                mVortonSim->GatherVorticitySlice( mVortChange , mScale , r.begin() , r.end() ) ;
+            }
+            VortonSim_GatherVorticity_TBB( VortonSim * pVortonSim , const UniformGrid< Vec3 > & vortChange , float scale )
+                : mVortonSim( pVortonSim )
+                , mVortChange( vortChange )
+                , mScale( scale )
+            {}
+    } ;
 
+    /*! \brief Function object to sub-step vortons in fine time-step bins using Threading Building Blocks
+    */
+    class VortonSim_AdvectVortonsInBlockSteps_TBB
+    {
+            VortonSim * mVortonSim ;    ///< Address of VortonSim object
+            float       mTickStep ;     ///< Duration of a sub-step of the finest bin
+            unsigned    mTick ;         ///< Index of current sub-step of the finest bin
+            unsigned    mFinestLevel ;  ///< Finest bin any vorton occupies this frame
+        public:
+            void operator() ( const tbb::blocked_range<size_t> & r ) const
+            {   // Sub-step subset of vortons.
+                mVortonSim->AdvectVortonsInBlockStepsSlice( mTickStep , mTick , mFinestLevel , r.begin() , r.end() ) ;
+            }
+            VortonSim_AdvectVortonsInBlockSteps_TBB( VortonSim * pVortonSim , float tickStep , unsigned iTick , unsigned finestLevel )
+                : mVortonSim( pVortonSim )
+                , mTickStep( tickStep )
+                , mTick( iTick )
+                , mFinestLevel( finestLevel )
+            {}
+    } ;
 
-/*! \brief Update axis-aligned bounding box corners to include given point
+    /*! \brief Function object to compute velocity in sparse grid blocks using Threading Building Blocks
+    */
+    class VortonSim_ComputeFarVelocityGrid_TBB
+    {
+            VortonSim * mVortonSim ;    ///< Address of VortonSim object
+        public:
+            void operator() ( const tbb::blocked_range<size_t> & r ) const
+            {   // Compute subset of blocks.
+                mVortonSim->ComputeFarVelocityGridSlice( r.begin() , r.end() ) ;
+            }
+            VortonSim_ComputeFarVelocityGrid_TBB( VortonSim * pVortonSim )
+                : mVortonSim( pVortonSim ) {}
+    } ;
 
-    \param vMinCorner - minimal corner of axis-aligned bounding box
+    /*! \brief Function object to compute octree keys of vortons using Threading Building Blocks
+    */
+    class VortonSim_ComputeVortonKeys_TBB
+    {
+            VortonSim * mVortonSim ;    ///< Address of VortonSim object
+        public:
+            void operator() ( const tbb::blocked_range<size_t> & r ) const
+            {   // Compute keys of subset of vortons.
+                mVortonSim->ComputeVortonKeysSlice( r.begin() , r.end() ) ;
+            }
+            VortonSim_ComputeVortonKeys_TBB( VortonSim * pVortonSim )
+                : mVortonSim( pVortonSim ) {}
+    } ;
 
-    \param vMaxCorner - maximal corner of axis-aligned bounding box
+    /*! \brief Function object to populate octree leaves from vortons using Threading Building Blocks
+    */
+    class VortonSim_MakeBaseVortonOctree_TBB
+    {
+            VortonSim * mVortonSim ;    ///< Address of VortonSim object
+        public:
+            void operator() ( const tbb::blocked_range<size_t> & r ) const
+            {   // Populate subset of leaves.
+                mVortonSim->MakeBaseVortonOctreeSlice( r.begin() , r.end() ) ;
+            }
+            VortonSim_MakeBaseVortonOctree_TBB( VortonSim * pVortonSim )
+                : mVortonSim( pVortonSim ) {}
+    } ;
 
-    \param vPoint - point to include in bounding box
+    /*! \brief Function object to aggregate a level of the influence octree using Threading Building Blocks
+    */
+    class VortonSim_AggregateOctreeClusters_TBB
+    {
+            VortonSim * mVortonSim ;    ///< Address of VortonSim object
+            size_t      mParentLevel ;
+        public:
+            void operator() ( const tbb::blocked_range<size_t> & r ) const
+            {   // Aggregate subset of cells in parent level.
+                mVortonSim->AggregateOctreeClustersSlice( mParentLevel , r.begin() , r.end() ) ;
+            }
+            VortonSim_AggregateOctreeClusters_TBB( VortonSim * pVortonSim , size_t iParentLevel )
+                : mVortonSim( pVortonSim )
+                , mParentLevel( iParentLevel )
+            {}
+    } ;
+    /*! \brief Function object to assign particles to cells using Threading Building Blocks
+    */
+    class VortonSim_IndexParticles_TBB
+    {
+            VortonSim * mVortonSim ;    ///< Address of VortonSim object
+        public:
+            void operator() ( const tbb::blocked_range<size_t> & r ) const
+            {   // Assign subset of chunks of particles to cells.
+                mVortonSim->IndexParticlesChunks( r.begin() , r.end() ) ;
+            }
+            VortonSim_IndexParticles_TBB( VortonSim * pVortonSim )
+                : mVortonSim( pVortonSim ) {}
+    } ;
 
-*/
-void UpdateBoundingBox( Vec3 & vMinCorner , Vec3 & vMaxCorner , const Vec3 vPoint )
-{
-    vMinCorner.x = MIN2( vPoint.x , vMinCorner.x ) ;
-    vMinCorner.y = MIN2( vPoint.y , vMinCorner.y ) ;
-    vMinCorner.z = MIN2( vPoint.z , vMinCorner.z ) ;
-    vMaxCorner.x = MAX2( vPoint.x , vMaxCorner.x ) ;
-    vMaxCorner.y = MAX2( vPoint.y , vMaxCorner.y ) ;
-    vMaxCorner.z = MAX2( vPoint.z , vMaxCorner.z ) ;
-}
+    /*! \brief Function object to count particles per cell using Threading Building Blocks
+    */
+    class VortonSim_CountParticles_TBB
+    {
+            VortonSim * mVortonSim ;    ///< Address of VortonSim object
+        public:
+            void operator() ( const tbb::blocked_range<size_t> & r ) const
+            {   // Count subset of chunks of particles.
+                mVortonSim->CountParticlesChunks( r.begin() , r.end() ) ;
+            }
+            VortonSim_CountParticles_TBB( VortonSim * pVortonSim )
+                : mVortonSim( pVortonSim ) {}
+    } ;
 
+    /*! \brief Function object to recompute leaf cells of the influence tree from their vortons using Threading Building Blocks
+    */
+    class VortonSim_RefitLeaves_TBB
+    {
+            VortonSim *                 mVortonSim ;    ///< Address of VortonSim object
+            Vector< unsigned char > &   mLeafDirty ;    ///< Whether each leaf cell changed
+        public:
+            void operator() ( const tbb::blocked_range<size_t> & r ) const
+            {   // Refit subset of z-slices of leaf layer.
+                mVortonSim->RefitLeafSlices( mLeafDirty , r.begin() , r.end() ) ;
+            }
+            VortonSim_RefitLeaves_TBB( VortonSim * pVortonSim , Vector< unsigned char > & leafDirty )
+                : mVortonSim( pVortonSim )
+                , mLeafDirty( leafDirty )
+            {}
+    } ;
 
+    /*! \brief Function object to re-aggregate influence tree clusters whose children changed using Threading Building Blocks
+    */
+    class VortonSim_RefitClusters_TBB
+    {
+            VortonSim *                     mVortonSim ;    ///< Address of VortonSim object
+            unsigned                        mParentLayer ;  ///< Index of layer to refit
+            const Vector< unsigned char > & mChildDirty ;   ///< Whether each cell of child layer changed
+            Vector< unsigned char > &       mParentDirty ;  ///< Whether each cell of parent layer changed
+        public:
+            void operator() ( const tbb::blocked_range<size_t> & r ) const
+            {   // Refit subset of z-slices of parent layer.
+                mVortonSim->RefitClusterSlices( mParentLayer , mChildDirty , mParentDirty , r.begin() , r.end() ) ;
+            }
+            VortonSim_RefitClusters_TBB( VortonSim * pVortonSim , unsigned uParentLayer , const Vector< unsigned char > & childDirty , Vector< unsigned char > & parentDirty )
+                : mVortonSim( pVortonSim )
+                , mParentLayer( uParentLayer )
+                , mChildDirty( childDirty )
+                , mParentDirty( parentDirty )
+            {}
+    } ;
 
+    /*! \brief Function object to sort particles by cell using Threading Building Blocks
+    */
+    class VortonSim_ScatterParticles_TBB
+    {
+            VortonSim * mVortonSim ;    ///< Address of VortonSim object
+        public:
+            void operator() ( const tbb::blocked_range<size_t> & r ) const
+            {   // Sort subset of chunks of particles by cell.
+                mVortonSim->ScatterParticlesChunks( r.begin() , r.end() ) ;
+            }
+            VortonSim_ScatterParticles_TBB( VortonSim * pVortonSim )
+                : mVortonSim( pVortonSim ) {}
+    } ;
 
-/*! \brief Assign vortons from a uniform grid of vorticity
+    /*! \brief Function object to count vortons that z-slices of a vorticity grid would generate, using Threading Building Blocks
+    */
+    class VortonSim_CountVortonsFromVorticity_TBB
+    {
+            const VortonSim *           mVortonSim ;    ///< Address of VortonSim object
+            const UniformGrid< Vec3 > & mVortGrid ;
+            Vector< unsigned > &        mNumVortonsPerSlice ;
+        public:
+            void operator() ( const tbb::blocked_range<size_t> & r ) const
+            {   // Count vortons in subset of slices.
+                mVortonSim->CountVortonsFromVorticitySlice( mVortGrid , mNumVortonsPerSlice , r.begin() , r.end() ) ;
+            }
+            VortonSim_CountVortonsFromVorticity_TBB( const VortonSim * pVortonSim , const UniformGrid< Vec3 > & vortGrid , Vector< unsigned > & numVortonsPerSlice )
+                : mVortonSim( pVortonSim )
+                , mVortGrid( vortGrid )
+                , mNumVortonsPerSlice( numVortonsPerSlice )
+            {}
+    } ;
 
-    \param vortGrid - uniform grid of vorticity values
+    /*! \brief Function object to assign vortons from z-slices of a vorticity grid, using Threading Building Blocks
+    */
+    class VortonSim_AssignVortonsFromVorticity_TBB
+    {
+            VortonSim *                 mVortonSim ;    ///< Address of VortonSim object
+            const UniformGrid< Vec3 > & mVortGrid ;
+            const Vector< unsigned > &  mFirstVortonPerSlice ;
+        public:
+            void operator() ( const tbb::blocked_range<size_t> & r ) const
+            {   // Assign vortons from subset of slices.
+                mVortonSim->AssignVortonsFromVorticitySlice( mVortGrid , mFirstVortonPerSlice , r.begin() , r.end() ) ;
+            }
+            VortonSim_AssignVortonsFromVorticity_TBB( VortonSim * pVortonSim , const UniformGrid< Vec3 > & vortGrid , const Vector< unsigned > & firstVortonPerSlice )
+                : mVortonSim( pVortonSim )
+                , mVortGrid( vortGrid )
+                , mFirstVortonPerSlice( firstVortonPerSlice )
+            {}
+    } ;
 
-*/
-void VortonSim::AssignVortonsFromVorticity( UniformGrid< Vec3 > & vortGrid )
-{
-    mVortons.Clear() ; // Empty out any existing vortons.
+    /*! \brief Function object to compute velocity at vortex filament nodes using Threading Building Blocks
+    */
+    class VortonSim_ComputeFilamentVelocities_TBB
+    {
+            VortonSim *             mVortonSim ;    ///< Address of VortonSim object
+            const Vector< Vec3 > &  mNodePositions ;
+            Vector< Vec3 > &        mNodeVelocities ;
+        public:
+            void operator() ( const tbb::blocked_range<size_t> & r ) const
+            {   // Compute velocity at subset of nodes.
+                mVortonSim->ComputeFilamentVelocitiesSlice( mNodePositions , mNodeVelocities , r.begin() , r.end() ) ;
+            }
+            VortonSim_ComputeFilamentVelocities_TBB( VortonSim * pVortonSim , const Vector< Vec3 > & nodePositions , Vector< Vec3 > & nodeVelocities )
+                : mVortonSim( pVortonSim )
+                , mNodePositions( nodePositions )
+                , mNodeVelocities( nodeVelocities )
+            {}
+    } ;
 
-    // Obtain characteristic size of each grid cell.
+    /*! \brief Function object to compute z-slices of a field derived from velocity, using Threading Building Blocks
+    */
+    class VortonSim_ComputeDerivedField_TBB
+    {
+            VortonSim *             mVortonSim ;    ///< Address of VortonSim object
+            VortonSim::DerivedField mField ;
+        public:
+            void operator() ( const tbb::blocked_range<size_t> & r ) const
+            {   // Compute subset of slices of derived field.
+                mVortonSim->ComputeDerivedFieldSlice( mField , r.begin() , r.end() ) ;
+            }
+            VortonSim_ComputeDerivedField_TBB( VortonSim * pVortonSim , VortonSim::DerivedField field )
+                : mVortonSim( pVortonSim )
+                , mField( field )
+            {}
+    } ;
 
-    const UniformGridGeometry & ug  = vortGrid ;
-    const float     fVortonRadius   = powf( ug.GetCellSpacing().x * ug.GetCellSpacing().y  * ug.GetCellSpacing().z , 1.0f / 3.0f ) * 0.5f ;
-    const Vec3      Nudge           ( ug.GetExtent() * FLT_EPSILON * 4.0f ) ;
-    const Vec3      vMin            ( ug.GetMinCorner()   + Nudge ) ;
-    const Vec3      vSpacing        ( ug.GetCellSpacing() * ( 1.0f - 0.0f * FLT_EPSILON ) ) ;
-    const unsigned  numPoints[3]    = { ug.GetNumPoints(0) , ug.GetNumPoints(1) , ug.GetNumPoints(2) } ;
-    const unsigned  numXY           = numPoints[0] * numPoints[1] ;
-    unsigned idx[3] ;
-    for( idx[2] = 0 ; idx[2] < numPoints[2] ; ++ idx[2] )
+    /*! \brief Function object to find which clusters tiles of the velocity grid visit, using Threading Building Blocks
+    */
+    class VortonSim_BuildTraversalCuts_TBB
     {
-        Vec3 vPositionOfGridCellCenter ;
-        vPositionOfGridCellCenter.z = vMin.z + float( idx[2] ) * vSpacing.z ;
-        const unsigned offsetZ = idx[2] * numXY ;
-        for( idx[1] = 0 ; idx[1] < numPoints[1] ; ++ idx[1] )
-        {
-            vPositionOfGridCellCenter.y = vMin.y + float( idx[1] ) * vSpacing.y ;
-            const unsigned offsetYZ = idx[1] * vortGrid.GetNumPoints(0) + offsetZ ;
-            for( idx[0] = 0 ; idx[0] < numPoints[0] ; ++ idx[0] )
-            {
-                vPositionOfGridCellCenter.x = vMin.x + float( idx[0] ) * vSpacing.x ;
-                const unsigned offsetXYZ = idx[0] + offsetYZ ;
-                const Vec3 & rVort = vortGrid[ offsetXYZ ] ;
-                if( rVort.Mag2() > FLT_EPSILON )
-                {   // This grid cell contains significant vorticity.
-                    Vorton vorton( vPositionOfGridCellCenter , rVort , fVortonRadius ) ;
-                    mVortons.PushBack( vorton ) ;
-                }
+            VortonSim * mVortonSim ;    ///< Address of VortonSim object
+        public:
+            void operator() ( const tbb::blocked_range<size_t> & r ) const
+            {   // Build cuts for subset of tiles.
+                mVortonSim->BuildTraversalCutsSlice( r.begin() , r.end() ) ;
             }
-        }
-    }
-}
+            VortonSim_BuildTraversalCuts_TBB( VortonSim * pVortonSim )
+                : mVortonSim( pVortonSim ) {}
+    } ;
 
+    /*! \brief Function object to compute velocity in patches nested within the velocity grid, using Threading Building Blocks
+    */
+    class VortonSim_ComputeVelocityPatches_TBB
+    {
+            VortonSim * mVortonSim ;    ///< Address of VortonSim object
+        public:
+            void operator() ( const tbb::blocked_range<size_t> & r ) const
+            {   // Compute subset of z-slices of patches.
+                mVortonSim->ComputeVelocityPatchSlices( r.begin() , r.end() ) ;
+            }
+            VortonSim_ComputeVelocityPatches_TBB( VortonSim * pVortonSim )
+                : mVortonSim( pVortonSim ) {}
+    } ;
 
+    /*! \brief Function object to copy vortons into leaf buckets of the influence tree, using Threading Building Blocks
+    */
+    class VortonSim_GatherLeafBuckets_TBB
+    {
+            VortonSim * mVortonSim ;    ///< Address of VortonSim object
+        public:
+            void operator() ( const tbb::blocked_range<size_t> & r ) const
+            {   // Gather buckets in subset of z-slices.
+                mVortonSim->GatherLeafBucketsSlice( r.begin() , r.end() ) ;
+            }
+            VortonSim_GatherLeafBuckets_TBB( VortonSim * pVortonSim )
+                : mVortonSim( pVortonSim ) {}
+    } ;
 
 
-/*! \brief Compute the total circulation and linear impulse of all vortons in this simulation.
 
-    \param vCirculation - Total circulation, the volume integral of vorticity, computed by this routine.
 
-    \param vLinearImpulse - Volume integral of circulation weighted by position, computed by this routine.
+    /*! \brief Function object to sum influence of vortons on each other directly, using Threading Building Blocks
+    */
+    class VortonSim_ComputeVelocityDirect_TBB
+    {
+            VortonSim * mVortonSim ;    ///< Address of VortonSim object
+        public:
+            void operator() ( const tbb::blocked_range<size_t> & r ) const
+            {   // Sum influences for subset of chunks.
+                mVortonSim->ComputeVelocityDirectChunks( r.begin() , r.end() ) ;
+            }
+            VortonSim_ComputeVelocityDirect_TBB( VortonSim * pVortonSim )
+                : mVortonSim( pVortonSim ) {}
+    } ;
+
+
+
+
+    /*! \brief Function object to combine sums that each chunk of direct summation accumulated, using Threading Building Blocks
+    */
+    class VortonSim_ReduceVelocityDirect_TBB
+    {
+            VortonSim * mVortonSim ;    ///< Address of VortonSim object
+        public:
+            void operator() ( const tbb::blocked_range<size_t> & r ) const
+            {   // Combine sums for subset of vortons.
+                mVortonSim->ReduceVelocityDirectSlice( r.begin() , r.end() ) ;
+            }
+            VortonSim_ReduceVelocityDirect_TBB( VortonSim * pVortonSim )
+                : mVortonSim( pVortonSim ) {}
+    } ;
+
+
+
+    /*! \brief Function object to perform a step of the P3M mesh solve, using Threading Building Blocks
+    */
+    class VortonSim_P3MSlices_TBB
+    {
+            VortonSim *         mVortonSim  ;   ///< Address of VortonSim object
+            VortonSim::P3MStep  mStep       ;   ///< Operation to perform
+            size_t              mLevel      ;   ///< Level of mesh on which to operate
+        public:
+            void operator() ( const tbb::blocked_range<size_t> & r ) const
+            {   // Perform step on subset of z-slices.
+                mVortonSim->P3MSlices( mStep , mLevel , r.begin() , r.end() ) ;
+            }
+            VortonSim_P3MSlices_TBB( VortonSim * pVortonSim , VortonSim::P3MStep step , size_t iLevel )
+                : mVortonSim( pVortonSim )
+                , mStep( step )
+                , mLevel( iLevel )
+            {}
+    } ;
+
+
+
+
+    /*! \brief Function object to add the P3M near field to the velocity grid, using Threading Building Blocks
+    */
+    class VortonSim_ComputeP3MNearVelocityGrid_TBB
+    {
+            VortonSim * mVortonSim ;    ///< Address of VortonSim object
+            float       mReach     ;    ///< Distance within which vortons contribute to the near field
+        public:
+            void operator() ( const tbb::blocked_range<size_t> & r ) const
+            {   // Add near field to subset of z-slices.
+                mVortonSim->ComputeP3MNearVelocityGridSlice( mReach , r.begin() , r.end() ) ;
+            }
+            VortonSim_ComputeP3MNearVelocityGrid_TBB( VortonSim * pVortonSim , float reach )
+                : mVortonSim( pVortonSim )
+                , mReach( reach )
+            {}
+    } ;
+
+
+
+
+    /*! \brief Function object to compute velocity at each vorton with P3M, using Threading Building Blocks
+    */
+    class VortonSim_ComputeP3MVortonVelocities_TBB
+    {
+            VortonSim * mVortonSim ;    ///< Address of VortonSim object
+            float       mReach     ;    ///< Distance within which vortons contribute to the near field
+        public:
+            void operator() ( const tbb::blocked_range<size_t> & r ) const
+            {   // Compute velocity of subset of vortons.
+                mVortonSim->ComputeP3MVortonVelocitiesSlice( mReach , r.begin() , r.end() ) ;
+            }
+            VortonSim_ComputeP3MVortonVelocities_TBB( VortonSim * pVortonSim , float reach )
+                : mVortonSim( pVortonSim )
+                , mReach( reach )
+            {}
+    } ;
+#endif
+
+
+
+
+/*! \brief Compute velocity from vorton tree
 
+    ...as opposed to using brute force, which is much slower.
 */
-void    VortonSim::ConservedQuantities( Vec3 & vCirculation , Vec3 & vLinearImpulse ) const
-{
-    // Zero accumulators.
-    vCirculation = vLinearImpulse = Vec3( 0.0f , 0.0f , 0.0f ) ;
-    const size_t numVortons = mVortons.Size() ;
-    for( unsigned iVorton = 0 ; iVorton < numVortons ; ++ iVorton )
-    {   // For each vorton in this simulation...
-        const Vorton &  rVorton         = mVortons[ iVorton ] ;
-        const float     volumeElement   = POW3( rVorton.mRadius ) * 8.0f ;
-        // Accumulate total circulation.
-        vCirculation    += rVorton.mVorticity * volumeElement ;
-        // Accumulate total linear impulse.
-        vLinearImpulse  += rVorton.mPosition ^ rVorton.mVorticity * volumeElement ;
-    }
-}
+#define VELOCITY_FROM_TREE 1
 
 
 
 
-/*! \brief Compute the average vorticity of all vortons in this simulation.
+/*! \brief Factor by which implicit grid diffusion reduces the norm of its residual before it stops
+
+    \see VortonSim::SolveDiffusionConjugateGradient
+*/
+static const double sDiffusionTolerance = 1.0e-4 ;
+
 
-    \note This is used to compute a hacky, non-physical approximation to
-            viscous vortex diffusion.
 
+
+/*! \brief Maximum number of conjugate-gradient iterations per implicit grid diffusion solve
+
+    The number of iterations needed grows with the square root of
+    viscosity * timeStep / spacing^2, so this bounds the cost of extreme
+    settings.  Stopping early leaves the solve less accurate, but still stable.
+
+    \see VortonSim::SolveDiffusionConjugateGradient
 */
-void    VortonSim::ComputeAverageVorticity( void )
+static const unsigned sMaxDiffusionIterations = 100 ;
+
+
+
+
+/*! \brief Return the sum of per-slice partial sums, which parallel passes over z-slices compute
+
+    Summing slices in order makes the result independent of how threads divided them.
+*/
+static double SumOfSlices( const Vector< double > & sliceSums )
 {
-    // Zero accumulators.
-    mAverageVorticity = Vec3( 0.0f , 0.0f , 0.0f ) ;
-    const size_t numVortons = mVortons.Size() ;
-    for( unsigned iVorton = 0 ; iVorton < numVortons ; ++ iVorton )
-    {   // For each vorton in this simulation...
-        const Vorton &  rVorton         = mVortons[ iVorton ] ;
-        mAverageVorticity += rVorton.mVorticity ;
+    double sum = 0.0 ;
+    for( size_t iz = 0 ; iz < sliceSums.Size() ; ++ iz )
+    {
+        sum += sliceSums[ iz ] ;
     }
-    mAverageVorticity /= float( numVortons ) ;
+    return sum ;
 }
 
 
 
 
-/*! \brief Initialize a vortex particle fluid simulation
+/*! \brief Margin, relative to cell size, by which a query point may lie outside a cell and still descend into it
 
-    \note This method assumes the vortons have been initialized.
-            That includes removing any vortons embedded inside
-            rigid bodies.
+    The larger this is, the more accurate (and slower) the evaluation.
+    Reasonable values lie in [0.00001,4.0].
+    Setting this to 0 leads to very bad errors, but values greater than (tiny) lead to drastic improvements.
+    Changes in margin have a quantized effect since they effectively indicate how many additional
+    cluster subdivisions to visit.
+
+    \see VortonSim::ComputeVelocity, VortonSim::ComputeVelocityOctree
 */
-void VortonSim::Initialize( unsigned numTracersPerCellCubeRoot )
-{
-#if USE_TBB
-    // Query environment for number of processors on this machine.
-    const char * strNumberOfProcessors = getenv( "NUMBER_OF_PROCESSORS" ) ;
-    if( strNumberOfProcessors != 0 )
-    {   // Environment contains a value for number of processors.
-        gNumberOfProcessors = atoi( strNumberOfProcessors ) ;
-    }
-#endif
+static const float sTreeMarginFactor = 0.0001f ; // 0.4f ; // ship with this number: 0.0001f ; test with 0.4
 
-    ConservedQuantities( mCirculationInitial , mLinearImpulseInitial ) ;
-    ComputeAverageVorticity() ;
-    CreateInfluenceTree() ; // This is a marginally superfluous call.  We only need the grid geometry to seed passive tracer particles.
-    InitializePassiveTracers( numTracersPerCellCubeRoot ) ;
 
-    {
-        float domainVolume = mInfluenceTree[0].GetExtent().x * mInfluenceTree[0].GetExtent().y * mInfluenceTree[0].GetExtent().z ;
-        if( 0.0f == mInfluenceTree[0].GetExtent().z )
-        {   // Domain is 2D in XY plane.
-            domainVolume = mInfluenceTree[0].GetExtent().x * mInfluenceTree[0].GetExtent().y ;
-        }
-        const float totalMass = domainVolume * mFluidDensity ;
-        const unsigned numTracersPerCell = POW3( numTracersPerCellCubeRoot ) ;
-        mMassPerParticle = totalMass / float( mInfluenceTree[0].GetGridCapacity() * numTracersPerCell ) ;
-    }
-}
 
 
+/*! \brief Base-2 exponent to which PackInfluenceTree scales the largest vorticity component of each layer
 
+    Cluster vorticity is a sum over every vorton in the cluster, so coarse
+    layers can exceed the largest finite half-precision value (65504).
+    Scaling each layer by a power of two, so its largest component lies in
+    [2^13,2^14), keeps every value finite with headroom for round-off, and
+    leaves small values as far as possible above the subnormal range.
+    Powers of two scale without rounding error.
 
-/*! \brief Find axis-aligned bounding box for all vortons in this simulation.
+    \see VortonSim::PackInfluenceTree
 */
-void VortonSim::FindBoundingBox( void )
-{
-    QUERY_PERFORMANCE_ENTER ;
-    const size_t numVortons = mVortons.Size() ;
-    mMinCorner.x = mMinCorner.y = mMinCorner.z =   FLT_MAX ;
-    mMaxCorner = - mMinCorner ;
-    for( unsigned iVorton = 0 ; iVorton < numVortons ; ++ iVorton )
-    {   // For each vorton in this simulation...
-        const Vorton & rVorton = mVortons[ iVorton ] ;
-        // Find corners of axis-aligned bounding box.
-        UpdateBoundingBox( mMinCorner , mMaxCorner , rVorton.mPosition ) ;
-    }
-    QUERY_PERFORMANCE_EXIT( VortonSim_CreateInfluenceTree_FindBoundingBox_Vortons ) ;
+static const int sPackedVorticityExponent = 14 ;
 
-    QUERY_PERFORMANCE_ENTER ;
-    const size_t numTracers = mTracers.Size() ;
-    for( unsigned iTracer = 0 ; iTracer < numTracers ; ++ iTracer )
-    {   // For each passive tracer particle in this simulation...
-        const Particle & rTracer = mTracers[ iTracer ] ;
-        // Find corners of axis-aligned bounding box.
-        UpdateBoundingBox( mMinCorner , mMaxCorner , rTracer.mPosition ) ;
-    }
-    QUERY_PERFORMANCE_EXIT( VortonSim_CreateInfluenceTree_FindBoundingBox_Tracers ) ;
 
-    // Slightly enlarge bounding box to allow for round-off errors.
-    const Vec3 extent( mMaxCorner - mMinCorner ) ;
-    const Vec3 nudge( extent * FLT_EPSILON ) ;
-    mMinCorner -= nudge ;
-    mMaxCorner += nudge ;
-}
 
 
+/*! \brief Number of velocity gridpoints along each side of a tile
 
+    ComputeVelocityGrid evaluates gridpoints one tile at a time, and each
+    tile shares a traversal cut.  Larger tiles need fewer cuts, but overlap
+    more cells, so leave more decisions to each gridpoint.
 
-/*! \brief Create base layer of vorton influence tree.
+    \see VortonSim::UpdateVelocityTiles, VortonSim::BuildTraversalCuts
+*/
+static const unsigned sVelocityTileSize = 2 ;
 
-    This is the leaf layer, where each grid cell corresponds (on average) to
-    a single vorton.  Some cells might contain multiple vortons and some zero.
-    Each cell effectively has a single "supervorton" which its parent layers
-    in the influence tree will in turn aggregate.
 
-    \note This implementation of gridifying the base layer is NOT suitable
-            for Eulerian operations like approximating spatial derivatives
-            of vorticity or solving a vector Poisson equation, because this
-            routine associates each vortex with a single corner point of the
-            grid cell that contains it.  To create a grid for Eulerian calculations,
-            each vorton would contribute to all 8 corner points of the grid
-            cell that contains it.
 
-            We could rewrite this to suit "Eulerian" operations, in which case
-            we would want to omit "size" and "position" since the grid would
-            implicitly represent that information.  That concern goes hand-in-hand
-            with the method used to compute velocity from vorticity.
-            Ultimately we need to make sure theoretically conserved quantities behave as expected.
 
-    \note This method assumes the influence tree skeleton has already been created,
-            and the leaf layer initialized to all "zeros", meaning it contains no
-            vortons.
+/*! \brief Number of batches into which UpdateSliced divides velocity grid tiles
 
+    UpdateSliced can yield between batches, so more batches let it meet
+    deadlines more closely, but each batch synchronizes all threads once.
+
+    \see VortonSim::UpdateSliced
 */
-void VortonSim::MakeBaseVortonGrid( void )
-{
-    const size_t numVortons = mVortons.Size() ;
+static const size_t sNumVelocityGridBatches = 16 ;
 
-    UniformGrid< VortonClusterAux > ugAux( mInfluenceTree[0] ) ; // Temporary auxilliary information used during aggregation.
-    ugAux.Init() ;
 
-    // Compute preliminary vorticity grid.
-    for( unsigned uVorton = 0 ; uVorton < numVortons ; ++ uVorton )
-    {   // For each vorton in this simulation...
-        const Vorton     &  rVorton     = mVortons[ uVorton ] ;
-        const Vec3       &  rPosition   = rVorton.mPosition   ;
-        const unsigned      uOffset     = mInfluenceTree[0].OffsetOfPosition( rPosition ) ;
-        Vorton           &  rVortonCell = mInfluenceTree[0][ uOffset ] ;
-        VortonClusterAux &  rVortonAux  = ugAux[ uOffset ] ;
-        const float         vortMag     = rVorton.mVorticity.Magnitude() ;
 
-        rVortonCell.mPosition  += rVorton.mPosition * vortMag ; // Compute weighted position -- to be normalized later.
-        rVortonCell.mVorticity += rVorton.mVorticity          ; // Tally vorticity sum.
-        rVortonCell.mRadius     = rVorton.mRadius             ; // Assign volume element size.
-        // OBSOLETE. See comments below: UpdateBoundingBox( rVortonAux.mMinCorner , rVortonAux.mMaxCorner , rVorton.mPosition ) ;
-        rVortonAux.mVortNormSum += vortMag ;
-    }
 
-    // Post-process preliminary grid; normalize center-of-vorticity and compute sizes, for each grid cell.
-    const unsigned num[3] = {   mInfluenceTree[0].GetNumPoints( 0 ) ,
-                                mInfluenceTree[0].GetNumPoints( 1 ) ,
-                                mInfluenceTree[0].GetNumPoints( 2 ) } ;
-    const unsigned numXY = num[0] * num[1] ;
-    unsigned idx[3] ;
-    for( idx[2] = 0 ; idx[2] < num[2] ; ++ idx[2] )
-    {
-        const unsigned zShift = idx[2] * numXY ;
-        for( idx[1] = 0 ; idx[1] < num[1] ; ++ idx[1] )
-        {
-            const unsigned yzShift = idx[1] * num[0] + zShift ;
-            for( idx[0] = 0 ; idx[0] < num[0] ; ++ idx[0] )
-            {
-                const unsigned      offset      = idx[0] + yzShift ;
-                VortonClusterAux &  rVortonAux  = ugAux[ offset ] ;
-                if( rVortonAux.mVortNormSum != FLT_MIN )
-                {   // This cell contains at least one vorton.
-                    Vorton & rVortonCell = mInfluenceTree[0][ offset ] ;
-                    // Normalize weighted position sum to obtain center-of-vorticity.
-                    rVortonCell.mPosition /= rVortonAux.mVortNormSum ;
-                }
-            }
-        }
-    }
-}
+/*! \brief Number of batches into which UpdateSliced divides each stage that visits every vorton or tracer
 
+    Each batch spans whole chunks of particles, so it unshares only chunks it writes.
 
+    \see VortonSim::UpdateSliced, VortonSim::GetParticleBatchEnd
+*/
+static const size_t sNumParticleBatches = 16 ;
 
 
-/*! \brief Aggregate vorton clusters from a child layer into a parent layer of the influence tree
 
-    This routine assumes the given parent layer is empty and its child layer (i.e. the layer
-    with index uParentLayer-1) is populated.
 
-    \param uParentLayer - index of parent layer into which aggregated influence information will be stored.
-        This must be greater than 0 because the base layer, which has no children, has index 0.
+/*! \brief Number of floats each vorton occupies in a leaf bucket
 
-    \see CreateInfluenceTree
+    Buckets store vortons in packets of FloatNative::NumLanes vortons.
+    Each packet holds, one component after another, each vorton's position
+    (3 floats), vorticity (3 floats), squared radius, and the coefficient
+    VORTON_ACCUMULATE_VELOCITY multiplies by its distance law, so each
+    component loads as a single aligned packet.
 
+    \see VortonSim::GatherLeafBuckets, VortonSim::AccumulateVelocityFromBucket
 */
-void VortonSim::AggregateClusters( unsigned uParentLayer )
-{
-    UniformGrid<Vorton> & rParentLayer  = mInfluenceTree[ uParentLayer ] ;
+static const unsigned sLeafBucketChannels = 8 ;
 
-    // number of cells in each grid cluster
-    const unsigned * const pClusterDims = mInfluenceTree.GetDecimations( uParentLayer ) ;
 
-    const unsigned  numCells[3]         = { rParentLayer.GetNumCells( 0 ) , rParentLayer.GetNumCells( 1 ) , rParentLayer.GetNumCells( 2 ) } ;
-    const unsigned  numXY               = rParentLayer.GetNumPoints( 0 ) * rParentLayer.GetNumPoints( 1 ) ;
-    // (Since this loop writes to each parent cell, it should readily parallelize without contention.)
-    unsigned idxParent[3] ;
-    for( idxParent[2] = 0 ; idxParent[2] < numCells[2] ; ++ idxParent[2] )
-    {
-        const unsigned offsetZ = idxParent[2] * numXY ;
-        for( idxParent[1] = 0 ; idxParent[1] < numCells[1] ; ++ idxParent[1] )
-        {
-            const unsigned offsetYZ = idxParent[1] * rParentLayer.GetNumPoints( 0 ) + offsetZ ;
-            for( idxParent[0] = 0 ; idxParent[0] < numCells[0] ; ++ idxParent[0] )
-            {   // For each cell in the parent layer...
-                const unsigned offsetXYZ = idxParent[0] + offsetYZ ;
-                UniformGrid<Vorton> & rChildLayer   = mInfluenceTree[ uParentLayer - 1 ] ;
-                Vorton              & rVortonParent = rParentLayer[ offsetXYZ ] ;
-                VortonClusterAux vortAux ;
-                unsigned clusterMinIndices[ 3 ] ;
-                mInfluenceTree.GetChildClusterMinCornerIndex( clusterMinIndices , pClusterDims , idxParent ) ;
-                unsigned increment[3] = { 0 , 0 , 0 } ;
-                const unsigned & numXchild  = rChildLayer.GetNumPoints( 0 ) ;
-                const unsigned   numXYchild = numXchild * rChildLayer.GetNumPoints( 1 ) ;
-                // For each cell of child layer in this grid cluster...
-                for( increment[2] = 0 ; increment[2] < pClusterDims[2] ; ++ increment[2] )
-                {
-                    const unsigned offsetZ = ( clusterMinIndices[2] + increment[2] ) * numXYchild ;
-                    for( increment[1] = 0 ; increment[1] < pClusterDims[1] ; ++ increment[1] )
+
+
+/*! \brief Number of floats each vorton occupies in each chunk of direct summation sums
+
+    Like leaf buckets, sums lie in packets of FloatNative::NumLanes vortons.
+    Each packet holds, one component after another, velocity (3 floats)
+    then each row of the velocity Jacobian (3 floats each).
+
+    \see VortonSim::ComputeVelocityDirect
+*/
+static const unsigned sDirectSumChannels = 12 ;
+
+
+
+
+/*! \brief Number of vortons in each tile of direct summation
+
+    Direct summation visits pairs of vortons one pair of tiles at a time,
+    so that the sources and sums of a tile stay in L1 cache while every
+    vorton of another tile visits them.  A tile occupies
+    ( sLeafBucketChannels + sDirectSumChannels ) * 4 bytes per vorton,
+    so 128 vortons occupy 10 KiB.  This must be a multiple of FloatNative::NumLanes.
+
+    \see VortonSim::ComputeVelocityDirectChunks
+*/
+static const unsigned sDirectTileSize = 128 ;
+
+
+
+/*! \brief Number of P3M mesh cells between the blob of any vorton and the boundary of the mesh
+
+    The mesh extends beyond the velocity grid by this many cells plus the blob radius,
+    so that vorticity lies well inside the boundary, where the vector potential
+    comes from a coarse sum over mesh vorticity.
+
+    \see VortonSim::DefineP3MMesh
+*/
+static const unsigned sP3MMarginCells = 4 ;
+
+
+
+
+/*! \brief Level of the P3M multigrid hierarchy whose vorticity determines the vector potential on the mesh boundary
+
+    Sources lie at gridpoints of this level, and the vector potential they
+    induce is summed at boundary gridpoints of this level then interpolated
+    onto the boundary of the finest level.  Coarser levels have fewer points
+    so cost less to sum, but approximate the vector potential less accurately.
+
+    \see VortonSim::GatherP3MBoundarySources
+*/
+static const size_t sP3MBoundarySourceLevel = 2 ;
+
+
+
+
+/*! \brief Number of multigrid V-cycles with which to solve the Poisson equation on the P3M mesh
+
+    Each V-cycle reduces the error by roughly an order of magnitude.
+
+    \see VortonSim::VCycleP3M
+*/
+static const unsigned sP3MNumVCycles = 4 ;
+
+
+
+
+/*! \brief Number of Gauss-Seidel sweeps before and after coarse-grid correction on each level of a V-cycle
+
+    \see VortonSim::VCycleP3M
+*/
+static const unsigned sP3MNumSmoothingSweeps = 2 ;
+
+
+
+
+/*! \brief Smallest factor by which the velocity grid decimates the base grid, when direct summation supplies velocity to vortons
+
+    Then only tracers and bodies read the velocity grid.  Tracers only
+    need to look plausible, and bodies also get refined velocity patches,
+    so a coarser grid suffices, and decimating by 2 cuts its cost by about 8.
+
+    \see VortonSim::BeginVelocityGrid, VortonSim::DirectSummationSuffices
+*/
+static const unsigned sDirectSummationVelGridDecimation = 2 ;
+
+
+
+
+/*! \brief Store a vorton into one lane of a packet laid out like a leaf bucket
+
+    \see sLeafBucketChannels
+*/
+static void StoreVortonInPacket( float * pPacket , unsigned iLane , const Vorton & rVorton )
+{
+    const unsigned  numLanes    = FloatNative::NumLanes ;
+    const float     radius2     = rVorton.mRadius * rVorton.mRadius ;
+    pPacket[ 0 * numLanes + iLane ] = rVorton.mPosition.x ;
+    pPacket[ 1 * numLanes + iLane ] = rVorton.mPosition.y ;
+    pPacket[ 2 * numLanes + iLane ] = rVorton.mPosition.z ;
+    pPacket[ 3 * numLanes + iLane ] = rVorton.mVorticity.x ;
+    pPacket[ 4 * numLanes + iLane ] = rVorton.mVorticity.y ;
+    pPacket[ 5 * numLanes + iLane ] = rVorton.mVorticity.z ;
+    pPacket[ 6 * numLanes + iLane ] = radius2 ;
+    pPacket[ 7 * numLanes + iLane ] = OneOverFourPi * ( 8.0f * radius2 * rVorton.mRadius ) ;
+}
+
+
+
+
+/*! \brief Pad lanes of a packet, from the given lane onward, with vortons that have no influence
+
+    \see StoreVortonInPacket
+*/
+static void PadPacket( float * pPacket , unsigned iLaneBegin )
+{
+    const unsigned numLanes = FloatNative::NumLanes ;
+    for( unsigned iLane = iLaneBegin ; iLane < numLanes ; ++ iLane )
+    {   // For each unused lane...
+        for( unsigned iChannel = 0 ; iChannel < sLeafBucketChannels ; ++ iChannel )
+        {
+            pPacket[ iChannel * numLanes + iLane ] = 0.0f ;
+        }
+        pPacket[ 6 * numLanes + iLane ] = 1.0f ;    // Nonzero squared radius avoids dividing by zero.
+    }
+}
+
+
+
+
+/*! \brief Number of velocity grid cells along each side of a block that one velocity patch covers
+
+    Each block whose cells need refinement gets one patch, which covers
+    the bounding box of those cells.  Smaller blocks fit patches more
+    tightly around the cells that need them, but make more patches.
+
+    \see VortonSim::DefineVelocityPatches
+*/
+static const unsigned sVelocityPatchBlockSize = 4 ;
+
+
+
+
+/*! \brief Largest product of time step and strain rate that a vorton may take in a single step
+
+    Block time-stepping puts each vorton into the coarsest bin whose
+    step satisfies this limit.
+
+    \see VortonSim::StretchAndTiltVortons, VortonSim::AdvectVortonsInBlockSteps
+*/
+static const float sMaxStrainPerStep = 0.5f ;
+
+
+
+
+/*! \brief Largest number of vortons in fine time-step bins for which sub-steps account for motion of each other
+
+    Each sub-step corrects the velocity a vorton interpolates from the
+    velocity grid by how much every other sub-stepping vorton has moved
+    since the grid sampled it, which costs time quadratic in their number.
+    Beyond this many, sub-steps use the velocity grid alone.
+
+    \see VortonSim::AdvectVortonsInBlockSteps
+*/
+static const size_t sMaxBlockStepInteractions = 1024 ;
+
+
+
+
+const unsigned VortonSim::MAX_TIME_STEP_LEVEL ;
+
+
+
+
+/*! \brief Return magnitude of the rate-of-strain tensor, i.e. of the symmetric part of a velocity Jacobian
+
+    \param velJac - velocity Jacobian, where velJac.a.b = d v.b / d a
+
+    \return Frobenius norm of ( velJac + transpose( velJac ) ) / 2
+*/
+static float StrainRate( const Mat33 & velJac )
+{
+    const float sxy = 0.5f * ( velJac.x.y + velJac.y.x ) ;
+    const float sxz = 0.5f * ( velJac.x.z + velJac.z.x ) ;
+    const float syz = 0.5f * ( velJac.y.z + velJac.z.y ) ;
+    return sqrtf( POW2( velJac.x.x ) + POW2( velJac.y.y ) + POW2( velJac.z.z ) + 2.0f * ( POW2( sxy ) + POW2( sxz ) + POW2( syz ) ) ) ;
+}
+
+
+
+
+/*! \brief Return given position, moved if necessary to lie within a uniform grid
+
+    Use this before interpolating a grid at a position which could lie outside it.
+*/
+static Vec3 ClampToGrid( const Vec3 & vPosition , const UniformGridGeometry & grid )
+{
+    static const float  shrink  = 1.0f - 4.0f * FLT_EPSILON ;
+    const Vec3 &        vMin    = grid.GetMinCorner() ;
+    const Vec3          vMax    = vMin + grid.GetExtent() * shrink ;
+    return Vec3( CLAMP( vPosition.x , vMin.x , vMax.x ) , CLAMP( vPosition.y , vMin.y , vMax.y ) , CLAMP( vPosition.z , vMin.z , vMax.z ) ) ;
+}
+
+
+
+
+/*! \brief Return whether a uniform grid can interpolate at the given position
+
+    \see ClampToGrid
+*/
+static bool IsInsideGrid( const Vec3 & vPosition , const UniformGridGeometry & grid )
+{
+    const Vec3 vPosInGrid = ClampToGrid( vPosition , grid ) ;
+    return ( vPosInGrid.x == vPosition.x ) && ( vPosInGrid.y == vPosition.y ) && ( vPosInGrid.z == vPosition.z ) ;
+}
+
+
+
+
+/*! \brief Update axis-aligned bounding box corners to include given point
+
+    \param vMinCorner - minimal corner of axis-aligned bounding box
+
+    \param vMaxCorner - maximal corner of axis-aligned bounding box
+
+    \param vPoint - point to include in bounding box
+
+*/
+void UpdateBoundingBox( Vec3 & vMinCorner , Vec3 & vMaxCorner , const Vec3 vPoint )
+{
+    vMinCorner.x = MIN2( vPoint.x , vMinCorner.x ) ;
+    vMinCorner.y = MIN2( vPoint.y , vMinCorner.y ) ;
+    vMinCorner.z = MIN2( vPoint.z , vMinCorner.z ) ;
+    vMaxCorner.x = MAX2( vPoint.x , vMaxCorner.x ) ;
+    vMaxCorner.y = MAX2( vPoint.y , vMaxCorner.y ) ;
+    vMaxCorner.z = MAX2( vPoint.z , vMaxCorner.z ) ;
+}
+
+
+
+
+/*! \brief Compute range of gridpoint indices that a tile of the velocity grid spans
+
+    \param idxMin - (out) indices of minimal gridpoint in tile
+
+    \param idxEnd - (out) indices of maximal gridpoint in tile, plus one
+
+    \param iTile - index of tile, in x-fastest order
+
+    \param numTiles - number of tiles along each axis
+
+    \param dims - number of gridpoints along each axis
+
+    \see sVelocityTileSize
+*/
+static void VelocityTileBounds( unsigned idxMin[3] , unsigned idxEnd[3] , size_t iTile , const unsigned numTiles[3] , const unsigned dims[3] )
+{
+    idxMin[0] = unsigned(   iTile % numTiles[0] ) * sVelocityTileSize ;
+    idxMin[1] = unsigned( ( iTile / numTiles[0] ) % numTiles[1] ) * sVelocityTileSize ;
+    idxMin[2] = unsigned(   iTile / ( size_t( numTiles[0] ) * numTiles[1] ) ) * sVelocityTileSize ;
+    for( unsigned i = 0 ; i < 3 ; ++ i )
+    {
+        idxEnd[i] = MIN2( idxMin[i] + sVelocityTileSize , dims[i] ) ;
+    }
+}
+
+
+
+
+/*! \brief Hilbert key of a tile of the velocity grid, with the index of that tile
+
+    \see VortonSim::UpdateVelocityTiles
+*/
+struct VelocityTileKey
+{
+    unsigned    mKey    ;   ///< Position of tile along Hilbert curve
+    unsigned    mTile   ;   ///< Index of tile, in x-fastest order
+    bool operator<( const VelocityTileKey & that ) const { return mKey < that.mKey ; }
+} ;
+
+
+
+
+/*! \brief Return whether a gridpoint has enough vorticity to warrant a vorton
+
+    \see VortonSim::AssignVortonsFromVorticity
+*/
+static bool IsVorticitySignificant( const Vec3 & vVorticity )
+{
+    return vVorticity.Mag2() > FLT_EPSILON ;
+}
+
+
+
+
+/*! \brief Count vortons that a subset of z-slices of a vorticity grid would generate
+
+    \param vortGrid - uniform grid of vorticity values
+
+    \param numVortonsPerSlice - (out) number of significant gridpoints in each z-slice.
+        Only elements [izStart,izEnd) change.
+
+    \param izStart - first z index to process
+
+    \param izEnd - one past the last z index to process
+
+    \see AssignVortonsFromVorticity
+
+*/
+void VortonSim::CountVortonsFromVorticitySlice( const UniformGrid< Vec3 > & vortGrid , Vector< unsigned > & numVortonsPerSlice , size_t izStart , size_t izEnd ) const
+{
+    const unsigned numXY = vortGrid.GetNumPoints( 0 ) * vortGrid.GetNumPoints( 1 ) ;
+    for( size_t iz = izStart ; iz < izEnd ; ++ iz )
+    {   // For each z-slice in this subset...
+        const unsigned  offsetBegin = unsigned( iz ) * numXY ;
+        const unsigned  offsetEnd   = offsetBegin + numXY ;
+        unsigned        numVortons  = 0 ;
+        for( unsigned offset = offsetBegin ; offset < offsetEnd ; ++ offset )
+        {   // For each gridpoint in this slice...
+            numVortons += IsVorticitySignificant( vortGrid[ offset ] ) ? 1 : 0 ;
+        }
+        numVortonsPerSlice[ iz ] = numVortons ;
+    }
+}
+
+
+
+
+/*! \brief Assign vortons from a subset of z-slices of a vorticity grid
+
+    \param vortGrid - uniform grid of vorticity values
+
+    \param firstVortonPerSlice - index of the first vorton that each z-slice generates.
+
+    \param izStart - first z index to process
+
+    \param izEnd - one past the last z index to process
+
+    Each slice writes to its own range of mVortons, so slices can
+    execute concurrently.
+
+    \see AssignVortonsFromVorticity
+
+*/
+void VortonSim::AssignVortonsFromVorticitySlice( const UniformGrid< Vec3 > & vortGrid , const Vector< unsigned > & firstVortonPerSlice , size_t izStart , size_t izEnd )
+{
+    // Obtain characteristic size of each grid cell.
+    const UniformGridGeometry & ug  = vortGrid ;
+    const float     fVortonRadius   = powf( ug.GetCellSpacing().x * ug.GetCellSpacing().y  * ug.GetCellSpacing().z , 1.0f / 3.0f ) * 0.5f ;
+    const Vec3      Nudge           ( ug.GetExtent() * FLT_EPSILON * 4.0f ) ;
+    const Vec3      vMin            ( ug.GetMinCorner()   + Nudge ) ;
+    const Vec3      vSpacing        ( ug.GetCellSpacing() * ( 1.0f - 0.0f * FLT_EPSILON ) ) ;
+    const unsigned  numPoints[3]    = { ug.GetNumPoints(0) , ug.GetNumPoints(1) , ug.GetNumPoints(2) } ;
+    const unsigned  numXY           = numPoints[0] * numPoints[1] ;
+    unsigned idx[3] ;
+    for( idx[2] = unsigned( izStart ) ; idx[2] < izEnd ; ++ idx[2] )
+    {
+        unsigned iVorton = firstVortonPerSlice[ idx[2] ] ;
+        Vec3 vPositionOfGridCellCenter ;
+        vPositionOfGridCellCenter.z = vMin.z + float( idx[2] ) * vSpacing.z ;
+        const unsigned offsetZ = idx[2] * numXY ;
+        for( idx[1] = 0 ; idx[1] < numPoints[1] ; ++ idx[1] )
+        {
+            vPositionOfGridCellCenter.y = vMin.y + float( idx[1] ) * vSpacing.y ;
+            const unsigned offsetYZ = idx[1] * vortGrid.GetNumPoints(0) + offsetZ ;
+            for( idx[0] = 0 ; idx[0] < numPoints[0] ; ++ idx[0] )
+            {
+                vPositionOfGridCellCenter.x = vMin.x + float( idx[0] ) * vSpacing.x ;
+                const unsigned offsetXYZ = idx[0] + offsetYZ ;
+                const Vec3 & rVort = vortGrid[ offsetXYZ ] ;
+                if( IsVorticitySignificant( rVort ) )
+                {   // This grid cell contains significant vorticity.
+                    mVortons.GetUnshared( iVorton ) = Vorton( vPositionOfGridCellCenter , rVort , fVortonRadius ) ;
+                    ++ iVorton ;
+                }
+            }
+        }
+    }
+}
+
+
+
+
+/*! \brief Assign vortons from a uniform grid of vorticity
+
+    \param vortGrid - uniform grid of vorticity values
+
+    This replaces any existing vortons with one per gridpoint that has
+    significant vorticity, in the order of gridpoint offsets.
+
+    Each z-slice counts its significant gridpoints, then a prefix sum of
+    those counts tells each slice where its vortons begin, so slices
+    can write vortons concurrently, directly into their final places.
+
+*/
+void VortonSim::AssignVortonsFromVorticity( UniformGrid< Vec3 > & vortGrid )
+{
+    const unsigned      numZ                = vortGrid.GetNumPoints( 2 ) ;
+    Vector< unsigned >  vortonsPerSlice     ;   // First, number of vortons in each slice.  Then, index of first vorton in each slice.
+    vortonsPerSlice.Resize( numZ + 1 ) ;
+
+#if USE_TBB
+    // Estimate grain size based on size of problem and number of processors.
+    const size_t grainSize =  MAX2( 1 , numZ / gNumberOfProcessors ) ;
+    // Count vortons in each slice using multiple threads.
+    parallel_for( tbb::blocked_range<size_t>( 0 , numZ , grainSize ) , VortonSim_CountVortonsFromVorticity_TBB( this , vortGrid , vortonsPerSlice ) ) ;
+#else
+    CountVortonsFromVorticitySlice( vortGrid , vortonsPerSlice , 0 , numZ ) ;
+#endif
+
+    // Convert counts to offsets, by exclusive prefix sum.
+    unsigned numVortons = 0 ;
+    for( unsigned iz = 0 ; iz < numZ ; ++ iz )
+    {   // For each slice...
+        const unsigned numVortonsInSlice = vortonsPerSlice[ iz ] ;
+        vortonsPerSlice[ iz ] = numVortons ;
+        numVortons += numVortonsInSlice ;
+    }
+    vortonsPerSlice[ numZ ] = numVortons ;
+
+    mVortons.Clear() ; // Empty out any existing vortons.
+    mVortons.Resize( numVortons ) ; // Allocates new chunks, which no other array shares, so slices can write through GetUnshared.
+
+#if USE_TBB
+    // Assign vortons using multiple threads.
+    parallel_for( tbb::blocked_range<size_t>( 0 , numZ , grainSize ) , VortonSim_AssignVortonsFromVorticity_TBB( this , vortGrid , vortonsPerSlice ) ) ;
+#else
+    AssignVortonsFromVorticitySlice( vortGrid , vortonsPerSlice , 0 , numZ ) ;
+#endif
+}
+
+
+
+
+/*! \brief Compute the total circulation and linear impulse of all vortons in this simulation.
+
+    \param vCirculation - Total circulation, the volume integral of vorticity, computed by this routine.
+
+    \param vLinearImpulse - Volume integral of circulation weighted by position, computed by this routine.
+
+*/
+void    VortonSim::ConservedQuantities( Vec3 & vCirculation , Vec3 & vLinearImpulse ) const
+{
+    // Zero accumulators.
+    vCirculation = vLinearImpulse = Vec3( 0.0f , 0.0f , 0.0f ) ;
+    const size_t numVortons = mVortons.Size() ;
+    for( unsigned iVorton = 0 ; iVorton < numVortons ; ++ iVorton )
+    {   // For each vorton in this simulation...
+        const Vorton &  rVorton         = mVortons[ iVorton ] ;
+        const float     volumeElement   = POW3( rVorton.mRadius ) * 8.0f ;
+        // Accumulate total circulation.
+        vCirculation    += rVorton.mVorticity * volumeElement ;
+        // Accumulate total linear impulse.
+        vLinearImpulse  += rVorton.mPosition ^ rVorton.mVorticity * volumeElement ;
+    }
+    const size_t numFilaments = mFilaments.Size() ;
+    for( unsigned iFilament = 0 ; iFilament < numFilaments ; ++ iFilament )
+    {   // For each vortex filament in this simulation...
+        const VortexFilament &  rFilament   = mFilaments[ iFilament ] ;
+        const size_t            numSegments = rFilament.GetNumSegments() ;
+        for( size_t iSegment = 0 ; iSegment < numSegments ; ++ iSegment )
+        {   // For each segment, whose vorticity integral is circulation times displacement...
+            const Vec3 vVortIntegral = ( rFilament.GetSegmentEnd( iSegment ) - rFilament.GetSegmentBegin( iSegment ) ) * rFilament.mCirculation ;
+            const Vec3 vMidpoint     = 0.5f * ( rFilament.GetSegmentBegin( iSegment ) + rFilament.GetSegmentEnd( iSegment ) ) ;
+            vCirculation    += vVortIntegral ;
+            vLinearImpulse  += vMidpoint ^ vVortIntegral ;
+        }
+    }
+}
+
+
+
+
+/*! \brief Compute the average vorticity of all vortons in this simulation.
+
+    \note This is used to compute a hacky, non-physical approximation to
+            viscous vortex diffusion.
+
+*/
+void    VortonSim::ComputeAverageVorticity( void )
+{
+    const ChunkedVector< Vorton > &    rVortons    = mVortons ;
+    // Zero accumulators.
+    mAverageVorticity = Vec3( 0.0f , 0.0f , 0.0f ) ;
+    const size_t numVortons = mVortons.Size() ;
+    for( unsigned iVorton = 0 ; iVorton < numVortons ; ++ iVorton )
+    {   // For each vorton in this simulation...
+        const Vorton &  rVorton         = rVortons[ iVorton ] ;
+        mAverageVorticity += rVorton.mVorticity ;
+    }
+    mAverageVorticity /= float( numVortons ) ;
+}
+
+
+
+
+/*! \brief Initialize a vortex particle fluid simulation
+
+    \note This method assumes the vortons have been initialized.
+            That includes removing any vortons embedded inside
+            rigid bodies.
+*/
+void VortonSim::Initialize( unsigned numTracersPerCellCubeRoot )
+{
+#if USE_TBB
+    // Query environment for number of processors on this machine.
+    const char * strNumberOfProcessors = getenv( "NUMBER_OF_PROCESSORS" ) ;
+    if( strNumberOfProcessors != 0 )
+    {   // Environment contains a value for number of processors.
+        gNumberOfProcessors = atoi( strNumberOfProcessors ) ;
+    }
+#endif
+
+    ConservedQuantities( mCirculationInitial , mLinearImpulseInitial ) ;
+    ComputeAverageVorticity() ;
+    CreateInfluenceTree() ; // This is a marginally superfluous call.  We only need the grid geometry to seed passive tracer particles.
+    InitializePassiveTracers( numTracersPerCellCubeRoot ) ;
+
+    {
+        float domainVolume = mGridGeometry.GetExtent().x * mGridGeometry.GetExtent().y * mGridGeometry.GetExtent().z ;
+        if( 0.0f == mGridGeometry.GetExtent().z )
+        {   // Domain is 2D in XY plane.
+            domainVolume = mGridGeometry.GetExtent().x * mGridGeometry.GetExtent().y ;
+        }
+        const float totalMass = domainVolume * mFluidDensity ;
+        const unsigned numTracersPerCell = POW3( numTracersPerCellCubeRoot ) ;
+        mMassPerTracer = totalMass / float( mGridGeometry.GetGridCapacity() * numTracersPerCell ) ;
+        mMassPerVorton = mMassPerTracer ;   // Vortons collide with bodies as though they had the same mass as tracers.
+    }
+}
+
+
+
+
+/*! \brief Make the given simulation a branch of this one, which continues from the same state
+
+    \param branch - (out) simulation to replace with a copy of this one's state and settings
+
+    This copies only what persists from one Update to the next: particles,
+    filaments, settings and the quantities Initialize computed.  It omits the
+    influence tree, grids and other structures that Update derives from
+    particles, which are by far the largest part of a simulation, and the
+    branch allocates derived structures only when it first updates.
+
+    Vortons and tracers lie in chunks that the branch shares with this
+    simulation, so forking copies only tables of chunks, not particles.
+    Either simulation copies a chunk only when it writes to it.  Each update
+    writes every particle, from multiple threads, so it first copies every
+    chunk it still shares.  Until then, a branch that is only read, for
+    example to render it, occupies almost no memory for particles.
+
+    Since the branch rebuilds its influence tree on its first Update, it
+    can differ, by round-off, from this simulation when refitting is enabled.
+    Otherwise, branches with the same settings evolve identically.
+
+    \note Forking while UpdateSliced has an update in progress gives the
+        branch the particles as they are, which are those of the last
+        complete update only until the update reaches UPDATE_STRETCH_AND_TILT.
+        The branch does not resume that update.
+
+    \see FluidBodySim::Fork
+*/
+void VortonSim::Fork( VortonSim & branch ) const
+{
+    branch.Clear() ;
+
+    // Copy settings.
+    branch.mViscosity                       = mViscosity ;
+    branch.mFluidDensity                    = mFluidDensity ;
+    branch.mDiffusionScheme                 = mDiffusionScheme ;
+    branch.mMaxTimeStepLevel                = mMaxTimeStepLevel ;
+    branch.mInfluenceStructure              = mInfluenceStructure ;
+    branch.mTracersUnbounded                = mTracersUnbounded ;
+    branch.mRefitTolerance                  = mRefitTolerance ;
+    branch.mLeafCapacity                    = mLeafCapacity ;
+    branch.mDirectSummationLimit            = mDirectSummationLimit ;
+    branch.mDirectSummationJacobians        = mDirectSummationJacobians ;
+    branch.mVelocitySolver                  = mVelocitySolver ;
+    branch.mP3MSmoothing                    = mP3MSmoothing ;
+    branch.mTreePrecision                   = mTreePrecision ;
+    branch.mPackedTreeMinLayer              = mPackedTreeMinLayer ;
+    branch.mVelGridPrecision                = mVelGridPrecision ;
+    branch.mCacheTraversalCuts              = mCacheTraversalCuts ;
+    branch.mVelGridDecimation               = mVelGridDecimation ;
+    branch.mFiniteDifferenceScheme          = mFiniteDifferenceScheme ;
+    branch.mVelRefinement                   = mVelRefinement ;
+    branch.mVelRefinementVorticityFraction  = mVelRefinementVorticityFraction ;
+    branch.mVelRefinementRegions            = mVelRefinementRegions ;
+    branch.mPotentialFlowSpheres            = mPotentialFlowSpheres ;
+    branch.SetLargePages( GetLargePages() ) ;
+
+    // Copy state.
+    branch.mVortons                         = mVortons ;
+    branch.mFilaments                       = mFilaments ;
+    branch.mTracers                         = mTracers ;
+    branch.mCirculationInitial              = mCirculationInitial ;
+    branch.mLinearImpulseInitial            = mLinearImpulseInitial ;
+    branch.mAverageVorticity                = mAverageVorticity ;
+    branch.mMassPerVorton                   = mMassPerVorton ;
+    branch.mMassPerTracer                   = mMassPerTracer ;
+    branch.mGridGeometry                    = mGridGeometry ;
+    branch.mMinCorner                       = mMinCorner ;
+    branch.mMaxCorner                       = mMaxCorner ;
+    branch.mNumRefits                       = 0 ;
+    branch.mTimeSinceIndex                  = 0.0f ;
+}
+
+
+
+
+/*! \brief Return number of vortons it would take to fill the cores of all vortex filaments
+
+    A few segments suffice to describe the centerline of a filament, but
+    grids must still resolve its core, for example so that advecting nodes
+    through the velocity grid reproduces the self-induced motion of a ring.
+    This counts vortons spaced a third of the core radius apart, which is
+    about as finely as AssignVorticity resolves a ring with the same core.
+
+    \see CreateInfluenceTree
+*/
+size_t VortonSim::CountFilamentEquivalentVortons( void ) const
+{
+    static const float sCellsPerCoreRadius = 3.0f ;
+    float numEquivalent = 0.0f ;
+    const size_t numFilaments = mFilaments.Size() ;
+    for( unsigned iFilament = 0 ; iFilament < numFilaments ; ++ iFilament )
+    {   // For each vortex filament in this simulation, count cells of size coreRadius/sCellsPerCoreRadius in a tube around it.
+        const VortexFilament & rFilament = mFilaments[ iFilament ] ;
+        numEquivalent += 0.25f * FourPi * POW3( sCellsPerCoreRadius ) * rFilament.ComputeLength() / rFilament.mCoreRadius ;
+    }
+    return size_t( numEquivalent ) ;
+}
+
+
+
+
+/*! \brief Find axis-aligned bounding box for all vortons in this simulation.
+*/
+void VortonSim::FindBoundingBox( void )
+{
+    const ChunkedVector< Vorton > &    rVortons    = mVortons ;
+    const ChunkedVector< Particle > &  rTracers    = mTracers ;
+    QUERY_PERFORMANCE_ENTER ;
+    const size_t numVortons = mVortons.Size() ;
+    mMinCorner.x = mMinCorner.y = mMinCorner.z =   FLT_MAX ;
+    mMaxCorner = - mMinCorner ;
+    for( unsigned iVorton = 0 ; iVorton < numVortons ; ++ iVorton )
+    {   // For each vorton in this simulation...
+        const Vorton & rVorton = rVortons[ iVorton ] ;
+        // Find corners of axis-aligned bounding box.
+        UpdateBoundingBox( mMinCorner , mMaxCorner , rVorton.mPosition ) ;
+    }
+    const size_t numFilaments = mFilaments.Size() ;
+    for( unsigned iFilament = 0 ; iFilament < numFilaments ; ++ iFilament )
+    {   // For each vortex filament in this simulation...
+        const Vector< Vec3 > &  rNodes      = mFilaments[ iFilament ].mNodes ;
+        const size_t            numNodes    = rNodes.Size() ;
+        // Vorticity occupies the core around each node, so include that, which also keeps the box from
+        // collapsing to a plane when a filament is planar, as a ring is.
+        const float             coreRadius  = mFilaments[ iFilament ].mCoreRadius ;
+        const Vec3              vCore( coreRadius , coreRadius , coreRadius ) ;
+        for( unsigned iNode = 0 ; iNode < numNodes ; ++ iNode )
+        {   // For each node of filament...
+            UpdateBoundingBox( mMinCorner , mMaxCorner , rNodes[ iNode ] - vCore ) ;
+            UpdateBoundingBox( mMinCorner , mMaxCorner , rNodes[ iNode ] + vCore ) ;
+        }
+    }
+    QUERY_PERFORMANCE_EXIT( VortonSim_CreateInfluenceTree_FindBoundingBox_Vortons ) ;
+
+    QUERY_PERFORMANCE_ENTER ;
+    // When tracers are unbounded, the domain excludes them.  See ComputeFarVelocityGrid.
+    const size_t numTracers = mTracersUnbounded ? 0 : mTracers.Size() ;
+    for( unsigned iTracer = 0 ; iTracer < numTracers ; ++ iTracer )
+    {   // For each passive tracer particle in this simulation...
+        const Particle & rTracer = rTracers[ iTracer ] ;
+        // Find corners of axis-aligned bounding box.
+        UpdateBoundingBox( mMinCorner , mMaxCorner , rTracer.mPosition ) ;
+    }
+    QUERY_PERFORMANCE_EXIT( VortonSim_CreateInfluenceTree_FindBoundingBox_Tracers ) ;
+
+    // Slightly enlarge bounding box to allow for round-off errors.
+    const Vec3 extent( mMaxCorner - mMinCorner ) ;
+    const Vec3 nudge( extent * FLT_EPSILON ) ;
+    mMinCorner -= nudge ;
+    mMaxCorner += nudge ;
+}
+
+
+
+
+/*! \brief Assign vortons and tracers in a subset of chunks to the leaf cells that contain them
+
+    \param icStart - index of first chunk to process
+
+    \param icEnd - one past index of last chunk to process
+
+    \see IndexParticles
+*/
+void VortonSim::IndexParticlesChunks( size_t icStart , size_t icEnd )
+{
+    const ChunkedVector< Vorton > &    rVortons    = mVortons ;
+    const ChunkedVector< Particle > &  rTracers    = mTracers ;
+    for( size_t iChunk = icStart ; iChunk < icEnd ; ++ iChunk )
+    {   // For each chunk in this subset...
+        const size_t ivEnd = mVortonCells.GetChunkBegin( iChunk + 1 ) ;
+        for( size_t iVorton = mVortonCells.GetChunkBegin( iChunk ) ; iVorton < ivEnd ; ++ iVorton )
+        {   // For each vorton in this chunk...
+            const Vorton & rVorton = rVortons[ iVorton ] ;
+            mVortonCells.AddParticle( iChunk , iVorton , rVorton.mPosition , rVorton.mRadius ) ;
+        }
+        const size_t itEnd = mTracerCells.GetChunkBegin( iChunk + 1 ) ;
+        for( size_t iTracer = mTracerCells.GetChunkBegin( iChunk ) ; iTracer < itEnd ; ++ iTracer )
+        {   // For each tracer in this chunk...
+            const Particle & rTracer = rTracers[ iTracer ] ;
+            mTracerCells.AddParticle( iChunk , iTracer , rTracer.mPosition , rTracer.mSize ) ;
+        }
+    }
+}
+
+
+
+
+/*! \brief Count vortons and tracers in a subset of chunks, for indices that could not update incrementally
+
+    \param icStart - index of first chunk to process
+
+    \param icEnd - one past index of last chunk to process
+
+    \see IndexParticles
+*/
+void VortonSim::CountParticlesChunks( size_t icStart , size_t icEnd )
+{
+    for( size_t iChunk = icStart ; iChunk < icEnd ; ++ iChunk )
+    {   // For each chunk in this subset...
+        mVortonCells.CountChunk( iChunk ) ;
+        mTracerCells.CountChunk( iChunk ) ;
+    }
+}
+
+
+
+
+/*! \brief Sort vortons and tracers in a subset of chunks by the cells that contain them
+
+    \param icStart - index of first chunk to process
+
+    \param icEnd - one past index of last chunk to process
+
+    \see IndexParticles
+*/
+void VortonSim::ScatterParticlesChunks( size_t icStart , size_t icEnd )
+{
+    for( size_t iChunk = icStart ; iChunk < icEnd ; ++ iChunk )
+    {   // For each chunk in this subset...
+        if( mVortonCells.NeedsScatter() )
+        {
+            mVortonCells.ScatterChunk( iChunk ) ;
+        }
+        if( mTracerCells.NeedsScatter() )
+        {
+            mTracerCells.ScatterChunk( iChunk ) ;
+        }
+    }
+}
+
+
+
+
+/*! \brief Index which leaf cell of the influence tree contains each vorton and each tracer
+
+    Building the tree, diffusing vorticity and colliding particles with
+    bodies all need to find particles by location.  Rather than each of
+    those binning particles separately, this bins every particle once per
+    frame, into cells that have the shape of the leaf layer of the influence
+    tree, and those stages all share the result.
+
+    \note This routine assumes mGridGeometry describes the current leaf layer.
+
+    \see GetVortonCellIndex, GetTracerCellIndex
+*/
+void VortonSim::IndexParticles( void )
+{
+#if USE_TBB
+    // Use a chunk per processor.  More chunks would cost memory and time to accumulate counts for no gain.
+    const size_t numChunks = MAX2( 1 , gNumberOfProcessors ) ;
+#else
+    const size_t numChunks = 1 ;
+#endif
+    // Fraction of particles that may change cells before rebuilding an index costs less than updating it.
+    static const float sMaxMovedFraction = 0.25f ;
+
+    // When the grid has not changed, as when refitting the influence tree, update indices instead of rebuilding them.
+    if( mVortonCells.CanUpdate( mGridGeometry , mVortons.Size() ) )
+    {
+        mVortonCells.BeginUpdate( numChunks ) ;
+    }
+    else
+    {
+        mVortonCells.Reset( mGridGeometry , mVortons.Size() , numChunks ) ;
+    }
+    if( mTracerCells.CanUpdate( mGridGeometry , mTracers.Size() ) )
+    {
+        mTracerCells.BeginUpdate( numChunks ) ;
+    }
+    else
+    {
+        mTracerCells.Reset( mGridGeometry , mTracers.Size() , numChunks ) ;
+    }
+
+#if USE_TBB
+    parallel_for( tbb::blocked_range<size_t>( 0 , numChunks , 1 ) , VortonSim_IndexParticles_TBB( this ) ) ;
+#else
+    IndexParticlesChunks( 0 , numChunks ) ;
+#endif
+
+    const bool bVortonsIndexed = mVortonCells.ApplyMoves( sMaxMovedFraction ) ;
+    const bool bTracersIndexed = mTracerCells.ApplyMoves( sMaxMovedFraction ) ;
+
+    if( ! bVortonsIndexed || ! bTracersIndexed )
+    {   // At least one index must finish rebuilding.
+    #if USE_TBB
+        parallel_for( tbb::blocked_range<size_t>( 0 , numChunks , 1 ) , VortonSim_CountParticles_TBB( this ) ) ;
+    #else
+        CountParticlesChunks( 0 , numChunks ) ;
+    #endif
+
+        if( ! bVortonsIndexed )
+        {
+            mVortonCells.AccumulateCounts() ;
+        }
+        if( ! bTracersIndexed )
+        {
+            mTracerCells.AccumulateCounts() ;
+        }
+
+    #if USE_TBB
+        parallel_for( tbb::blocked_range<size_t>( 0 , numChunks , 1 ) , VortonSim_ScatterParticles_TBB( this ) ) ;
+    #else
+        ScatterParticlesChunks( 0 , numChunks ) ;
+    #endif
+    }
+
+    mTimeSinceIndex = 0.0f ;
+}
+
+
+
+
+/*! \brief Return how far any particle could have moved since IndexParticles last executed
+
+    Particles advect with velocity interpolated from mVelGrid, mVelPatches or mFarVelGrid,
+    and interpolation never exceeds the largest value it interpolates,
+    so no particle could have moved faster than the fastest grid point,
+    or vorton velocity from direct summation or P3M,
+    plus the potential flow of spheres, which nowhere exceeds their speed.
+
+    Block time-stepping moves vortons with other velocities: vortons in
+    inactive coarse bins drift with the velocity they had when their bin
+    was last active, and sub-steps correct the grid for how other
+    sub-stepping vortons moved.  So the bound also includes the fastest
+    drift velocity, and the fastest speed of any sub-step.
+
+    \see GetVortonCellIndex, GetTracerCellIndex
+*/
+float VortonSim::ComputeMaxDisplacementSinceIndex( void ) const
+{
+    if( 0.0f == mTimeSinceIndex )
+    {   // Particles have not moved since IndexParticles executed.
+        return 0.0f ;
+    }
+    float maxSpeed2 = 0.0f ;
+    const size_t numPoints = mVelGrid.Size() ;
+    for( size_t offset = 0 ; offset < numPoints ; ++ offset )
+    {   // For each point in velocity grid...
+        maxSpeed2 = MAX2( maxSpeed2 , mVelGrid[ unsigned( offset ) ].Mag2() ) ;
+    }
+    const size_t numBlocks = mFarVelGrid.GetNumBlocks() ;
+    for( size_t iBlock = 0 ; iBlock < numBlocks ; ++ iBlock )
+    {   // For each block of far velocity grid...
+        const SparseUniformGrid< Vec3 >::Block & rBlock = mFarVelGrid.GetBlock( iBlock ) ;
+        for( unsigned offset = 0 ; offset < SparseUniformGrid< Vec3 >::NUM_POINTS_PER_BLOCK ; ++ offset )
+        {   // For each point in this block...
+            maxSpeed2 = MAX2( maxSpeed2 , rBlock.mPoints[ offset ].Mag2() ) ;
+        }
+    }
+    const size_t numPatches = mVelPatches.Size() ;
+    for( size_t iPatch = 0 ; iPatch < numPatches ; ++ iPatch )
+    {   // For each velocity patch, which InterpolateVelocity blends with mVelGrid...
+        const UniformGrid< Vec3 > & rPatch = mVelPatches[ iPatch ] ;
+        const size_t numPatchPoints = rPatch.Size() ;
+        for( size_t offset = 0 ; offset < numPatchPoints ; ++ offset )
+        {   // For each point in this patch...
+            maxSpeed2 = MAX2( maxSpeed2 , rPatch[ unsigned( offset ) ].Mag2() ) ;
+        }
+    }
+    const size_t numVortonVelocities = mVortonVelocities.Size() ;
+    for( size_t iVorton = 0 ; iVorton < numVortonVelocities ; ++ iVorton )
+    {   // For each vorton whose velocity came from direct summation or P3M...
+        maxSpeed2 = MAX2( maxSpeed2 , mVortonVelocities[ iVorton ].Mag2() ) ;
+    }
+    if( mMaxTimeStepLevel > 0 )
+    {   // Block time-stepping is enabled, so vortons might have moved with velocities that none of the above contain.
+        const size_t numDriftVelocities = mDriftVelocities.Size() ;
+        for( size_t iVorton = 0 ; iVorton < numDriftVelocities ; ++ iVorton )
+        {   // For each vorton, which might lie in an inactive coarse bin...
+            maxSpeed2 = MAX2( maxSpeed2 , mDriftVelocities[ iVorton ].Mag2() ) ;
+        }
+        maxSpeed2 = MAX2( maxSpeed2 , mBlockStepMaxSpeed * mBlockStepMaxSpeed ) ;
+    }
+    float maxSpeed = sqrtf( maxSpeed2 ) ;
+    const size_t numSpheres = mPotentialFlowSpheres.Size() ;
+    for( size_t iSphere = 0 ; iSphere < numSpheres ; ++ iSphere )
+    {   // For each sphere whose potential flow InterpolateVelocity adds...
+        maxSpeed += mPotentialFlowSpheres[ iSphere ].mVelocity.Magnitude() ;
+    }
+    return maxSpeed * mTimeSinceIndex ;
+}
+
+
+
+
+/*! \brief Create base layer of vorton influence tree.
+
+    This is the leaf layer, where each grid cell corresponds (on average) to
+    a single vorton.  Some cells might contain multiple vortons and some zero.
+    Each cell effectively has a single "supervorton" which its parent layers
+    in the influence tree will in turn aggregate.
+
+    \note This implementation of gridifying the base layer is NOT suitable
+            for Eulerian operations like approximating spatial derivatives
+            of vorticity or solving a vector Poisson equation, because this
+            routine associates each vortex with a single corner point of the
+            grid cell that contains it.  To create a grid for Eulerian calculations,
+            each vorton would contribute to all 8 corner points of the grid
+            cell that contains it.
+
+            We could rewrite this to suit "Eulerian" operations, in which case
+            we would want to omit "size" and "position" since the grid would
+            implicitly represent that information.  That concern goes hand-in-hand
+            with the method used to compute velocity from vorticity.
+            Ultimately we need to make sure theoretically conserved quantities behave as expected.
+
+    \note This method assumes the influence tree skeleton has already been created,
+            and the leaf layer initialized to all "zeros", meaning it contains no
+            vortons.  It also assumes IndexParticles has already executed.
+
+*/
+void VortonSim::MakeBaseVortonGrid( void )
+{
+    const ChunkedVector< Vorton > &    rVortons    = mVortons ;
+    const size_t numVortons = mVortons.Size() ;
+
+    UniformGrid< VortonClusterAux > ugAux( mInfluenceTree[0] ) ; // Temporary auxilliary information used during aggregation.
+    ugAux.Init() ;
+
+    // Compute preliminary vorticity grid.
+    for( unsigned uVorton = 0 ; uVorton < numVortons ; ++ uVorton )
+    {   // For each vorton in this simulation...
+        const Vorton     &  rVorton     = rVortons[ uVorton ] ;
+        const unsigned      uOffset     = mVortonCells.GetCellOfParticle( uVorton ) ;
+        Vorton           &  rVortonCell = mInfluenceTree[0][ uOffset ] ;
+        VortonClusterAux &  rVortonAux  = ugAux[ uOffset ] ;
+        const float         vortMag     = rVorton.mVorticity.Magnitude() ;
+
+        rVortonCell.mPosition  += rVorton.mPosition * vortMag ; // Compute weighted position -- to be normalized later.
+        rVortonCell.mVorticity += rVorton.mVorticity          ; // Tally vorticity sum.
+        rVortonCell.mRadius     = rVorton.mRadius             ; // Assign volume element size.
+        // OBSOLETE. See comments below: UpdateBoundingBox( rVortonAux.mMinCorner , rVortonAux.mMaxCorner , rVorton.mPosition ) ;
+        rVortonAux.mVortNormSum += vortMag ;
+    }
+
+    // Aggregate filament segments into the same cells, each as a vorton with the same far-field influence.
+    const size_t numFilaments = mFilaments.Size() ;
+    for( unsigned iFilament = 0 ; iFilament < numFilaments ; ++ iFilament )
+    {   // For each vortex filament in this simulation...
+        const VortexFilament &  rFilament   = mFilaments[ iFilament ] ;
+        const size_t            numSegments = rFilament.GetNumSegments() ;
+        for( size_t iSegment = 0 ; iSegment < numSegments ; ++ iSegment )
+        {   // For each segment of filament...
+            const Vorton        vSegment    = rFilament.MakeSegmentVorton( iSegment ) ;
+            const unsigned      uOffset     = mInfluenceTree[0].OffsetOfPosition( ClampToGrid( vSegment.mPosition , mInfluenceTree[0] ) ) ;
+            Vorton           &  rVortonCell = mInfluenceTree[0][ uOffset ] ;
+            VortonClusterAux &  rVortonAux  = ugAux[ uOffset ] ;
+            const float         vortMag     = vSegment.mVorticity.Magnitude() ;
+
+            rVortonCell.mPosition  += vSegment.mPosition * vortMag ;
+            rVortonCell.mVorticity += vSegment.mVorticity ;
+            rVortonCell.mRadius     = vSegment.mRadius ;
+            rVortonAux.mVortNormSum += vortMag ;
+        }
+    }
+
+    // Post-process preliminary grid; normalize center-of-vorticity and compute sizes, for each grid cell.
+    const unsigned num[3] = {   mInfluenceTree[0].GetNumPoints( 0 ) ,
+                                mInfluenceTree[0].GetNumPoints( 1 ) ,
+                                mInfluenceTree[0].GetNumPoints( 2 ) } ;
+    const unsigned numXY = num[0] * num[1] ;
+    unsigned idx[3] ;
+    for( idx[2] = 0 ; idx[2] < num[2] ; ++ idx[2] )
+    {
+        const unsigned zShift = idx[2] * numXY ;
+        for( idx[1] = 0 ; idx[1] < num[1] ; ++ idx[1] )
+        {
+            const unsigned yzShift = idx[1] * num[0] + zShift ;
+            for( idx[0] = 0 ; idx[0] < num[0] ; ++ idx[0] )
+            {
+                const unsigned      offset      = idx[0] + yzShift ;
+                VortonClusterAux &  rVortonAux  = ugAux[ offset ] ;
+                if( rVortonAux.mVortNormSum != FLT_MIN )
+                {   // This cell contains at least one vorton.
+                    Vorton & rVortonCell = mInfluenceTree[0][ offset ] ;
+                    // Normalize weighted position sum to obtain center-of-vorticity.
+                    rVortonCell.mPosition /= rVortonAux.mVortNormSum ;
+                }
+            }
+        }
+    }
+}
+
+
+
+
+/*! \brief Aggregate a single vorton cluster from a child layer into a cell of its parent layer
+
+    This overwrites the given parent cell, so it suits both building
+    the influence tree and refitting individual cells of it.
+
+    \param uParentLayer - index of parent layer into which aggregated influence information will be stored.
+        This must be greater than 0 because the base layer, which has no children, has index 0.
+
+    \param idxParent - indices of cell in parent layer
+
+    \see AggregateClusters, RefitInfluenceTree
+
+*/
+void VortonSim::AggregateCluster( unsigned uParentLayer , const unsigned idxParent[3] )
+{
+    UniformGrid<Vorton> & rParentLayer  = mInfluenceTree[ uParentLayer ] ;
+    UniformGrid<Vorton> & rChildLayer   = mInfluenceTree[ uParentLayer - 1 ] ;
+
+    // number of cells in each grid cluster
+    const unsigned * const pClusterDims = mInfluenceTree.GetDecimations( uParentLayer ) ;
+
+    const unsigned offsetParent = idxParent[0] + rParentLayer.GetNumPoints( 0 ) * ( idxParent[1] + rParentLayer.GetNumPoints( 1 ) * idxParent[2] ) ;
+    Vorton & rVortonParent = rParentLayer[ offsetParent ] ;
+    rVortonParent = Vorton() ;
+    VortonClusterAux vortAux ;
+    unsigned clusterMinIndices[ 3 ] ;
+    mInfluenceTree.GetChildClusterMinCornerIndex( clusterMinIndices , pClusterDims , idxParent ) ;
+    unsigned increment[3] = { 0 , 0 , 0 } ;
+    const unsigned & numXchild  = rChildLayer.GetNumPoints( 0 ) ;
+    const unsigned   numXYchild = numXchild * rChildLayer.GetNumPoints( 1 ) ;
+    // For each cell of child layer in this grid cluster...
+    for( increment[2] = 0 ; increment[2] < pClusterDims[2] ; ++ increment[2] )
+    {
+        const unsigned offsetZ = ( clusterMinIndices[2] + increment[2] ) * numXYchild ;
+        for( increment[1] = 0 ; increment[1] < pClusterDims[1] ; ++ increment[1] )
+        {
+            const unsigned offsetYZ = ( clusterMinIndices[1] + increment[1] ) * numXchild + offsetZ ;
+            for( increment[0] = 0 ; increment[0] < pClusterDims[0] ; ++ increment[0] )
+            {
+                const unsigned  offsetXYZ       = ( clusterMinIndices[0] + increment[0] ) + offsetYZ ;
+                Vorton &        rVortonChild    = rChildLayer[ offsetXYZ ] ;
+                const float     vortMag         = rVortonChild.mVorticity.Magnitude() ;
+
+                // Aggregate vorton cluster from child layer into parent layer:
+                rVortonParent.mPosition  += rVortonChild.mPosition * vortMag ;
+                rVortonParent.mVorticity += rVortonChild.mVorticity ;
+                vortAux.mVortNormSum     += vortMag ;
+                if( rVortonChild.mRadius != 0.0f )
+                {
+                    rVortonParent.mRadius  = rVortonChild.mRadius ;
+                }
+            }
+        }
+    }
+    // Normalize weighted position sum to obtain center-of-vorticity.
+    // (See analogous code in MakeBaseVortonGrid.)
+    rVortonParent.mPosition /= vortAux.mVortNormSum ;
+}
+
+
+
+
+/*! \brief Aggregate vorton clusters from a child layer into a parent layer of the influence tree
+
+    This routine assumes the child layer (i.e. the layer with index uParentLayer-1) is populated.
+
+    \param uParentLayer - index of parent layer into which aggregated influence information will be stored.
+        This must be greater than 0 because the base layer, which has no children, has index 0.
+
+    \see CreateInfluenceTree
+
+*/
+void VortonSim::AggregateClusters( unsigned uParentLayer )
+{
+    UniformGrid<Vorton> & rParentLayer  = mInfluenceTree[ uParentLayer ] ;
+
+    const unsigned  numCells[3]         = { rParentLayer.GetNumCells( 0 ) , rParentLayer.GetNumCells( 1 ) , rParentLayer.GetNumCells( 2 ) } ;
+    // (Since this loop writes to each parent cell, it should readily parallelize without contention.)
+    unsigned idxParent[3] ;
+    for( idxParent[2] = 0 ; idxParent[2] < numCells[2] ; ++ idxParent[2] )
+    {
+        for( idxParent[1] = 0 ; idxParent[1] < numCells[1] ; ++ idxParent[1] )
+        {
+            for( idxParent[0] = 0 ; idxParent[0] < numCells[0] ; ++ idxParent[0] )
+            {   // For each cell in the parent layer...
+                AggregateCluster( uParentLayer , idxParent ) ;
+            }
+        }
+    }
+}
+
+
+
+
+/*! \brief Return whether RefitInfluenceTree can update the influence tree, instead of rebuilding it
+
+    Refitting is impossible when refitting is disabled, when the number of
+    vortons changed, when the bounding box left the tree or shrank too much,
+    or when too many consecutive refits have let the tree drift from the
+    shape a rebuild would give it.
+
+    \note This routine assumes FindBoundingBox has already executed.
+
+*/
+bool VortonSim::CanRefitInfluenceTree( void ) const
+{
+    static const unsigned sMaxConsecutiveRefits = 32 ; // Periodically rebuild so the grid tracks how vortons spread.
+
+    const size_t numVortons = mVortons.Size() ;
+    if(     ( mRefitTolerance <= 0.0f )
+        ||  ( INFLUENCE_NESTED_GRID != mInfluenceStructure )
+        ||  ( mInfluenceTree.GetDepth() == 0 )
+        ||  ! mVortonCells.CanUpdate( mGridGeometry , numVortons )
+        ||  ( numVortons == 0 )
+        ||  ( mFilaments.Size() > 0 )   // Refitting tracks only vortons, not filament segments.
+        ||  ( mNumRefits >= sMaxConsecutiveRefits ) )
+    {   // Tree is unsuitable for refitting.
+        return false ;
+    }
+
+    // Make sure the bounding box still fits the tree.
+    const Vec3 & vGridMin   = mGridGeometry.GetMinCorner() ;
+    const Vec3   vGridMax   = vGridMin + mGridGeometry.GetExtent() ;
+    const Vec3   vExtent    = mMaxCorner - mMinCorner ;
+    const float  minFrac    = 1.0f - mRefitTolerance ;
+    if(     ( mMinCorner.x < vGridMin.x ) || ( mMinCorner.y < vGridMin.y ) || ( mMinCorner.z < vGridMin.z )
+        ||  ( mMaxCorner.x > vGridMax.x ) || ( mMaxCorner.y > vGridMax.y ) || ( mMaxCorner.z > vGridMax.z ) )
+    {   // Vortons left region of tree.
+        return false ;
+    }
+    if(     ( vExtent.x < minFrac * mRefitExtent.x )
+        ||  ( vExtent.y < minFrac * mRefitExtent.y )
+        ||  ( vExtent.z < minFrac * mRefitExtent.z ) )
+    {   // Vortons contracted so much that a fresh tree would have finer cells.
+        return false ;
+    }
+    return true ;
+}
+
+
+
+
+/*! \brief Recompute leaf cells of the influence tree, in a subset of z-slices, from the vortons they contain
+
+    \param leafDirty - (out) whether each leaf cell changed.  Caller must size this to match the leaf layer.
+
+    \param izStart - index of first z-slice to process
+
+    \param izEnd - one past index of last z-slice to process
+
+    \see RefitInfluenceTree
+
+*/
+void VortonSim::RefitLeafSlices( Vector< unsigned char > & leafDirty , size_t izStart , size_t izEnd )
+{
+    const ChunkedVector< Vorton > &    rVortons    = mVortons ;
+    UniformGrid< Vorton > & rLeaves = mInfluenceTree[ 0 ] ;
+    const unsigned          numXY   = rLeaves.GetNumPoints( 0 ) * rLeaves.GetNumPoints( 1 ) ;
+    const unsigned          iEnd    = unsigned( izEnd ) * numXY ;
+
+    for( unsigned offset = unsigned( izStart ) * numXY ; offset < iEnd ; ++ offset )
+    {   // For each leaf cell in this subset of slices...
+        Vorton              vortonCell ;
+        VortonClusterAux    vortAux ;
+        const unsigned      iSortEnd    = mVortonCells.GetCellEnd( offset ) ;
+        for( unsigned iSorted = mVortonCells.GetCellBegin( offset ) ; iSorted < iSortEnd ; ++ iSorted )
+        {   // For each vorton in this cell...
+            const Vorton &  rVorton = rVortons[ mVortonCells.GetParticle( iSorted ) ] ;
+            const float     vortMag = rVorton.mVorticity.Magnitude() ;
+            vortonCell.mPosition  += rVorton.mPosition * vortMag ;
+            vortonCell.mVorticity += rVorton.mVorticity ;
+            vortonCell.mRadius     = rVorton.mRadius ;
+            vortAux.mVortNormSum  += vortMag ;
+        }
+        if( vortAux.mVortNormSum != FLT_MIN )
+        {   // This cell contains at least one vorton.  Normalize weighted position sum to obtain center-of-vorticity.
+            vortonCell.mPosition /= vortAux.mVortNormSum ;
+        }
+
+        Vorton &    rVortonLeaf = rLeaves[ offset ] ;
+        const bool  bChanged    =   ( vortonCell.mPosition  != rVortonLeaf.mPosition  )
+                                ||  ( vortonCell.mVorticity != rVortonLeaf.mVorticity )
+                                ||  ( vortonCell.mRadius    != rVortonLeaf.mRadius    ) ;
+        leafDirty[ offset ] = bChanged ;
+        if( bChanged )
+        {
+            rVortonLeaf = vortonCell ;
+        }
+    }
+}
+
+
+
+
+/*! \brief Re-aggregate clusters of the influence tree, in a subset of z-slices, that have a child which changed
+
+    \param uParentLayer - index of layer to refit.  Must be greater than 0.
+
+    \param childDirty - whether each cell of the child layer changed
+
+    \param parentDirty - (out) whether each cell of the parent layer changed.  Caller must size this to match the parent layer and zero it.
+
+    \param izStart - index of first z-slice of parent layer to process
+
+    \param izEnd - one past index of last z-slice of parent layer to process
+
+    \see RefitInfluenceTree
+
+*/
+void VortonSim::RefitClusterSlices( unsigned uParentLayer , const Vector< unsigned char > & childDirty , Vector< unsigned char > & parentDirty , size_t izStart , size_t izEnd )
+{
+    const UniformGrid< Vorton > &   rParentLayer    = mInfluenceTree[ uParentLayer ] ;
+    const UniformGrid< Vorton > &   rChildLayer     = mInfluenceTree[ uParentLayer - 1 ] ;
+    const unsigned * const          pClusterDims    = mInfluenceTree.GetDecimations( uParentLayer ) ;
+    const unsigned                  numXchild       = rChildLayer.GetNumPoints( 0 ) ;
+    const unsigned                  numXYchild      = numXchild * rChildLayer.GetNumPoints( 1 ) ;
+
+    unsigned idxParent[3] ;
+    for( idxParent[2] = unsigned( izStart ) ; idxParent[2] < izEnd ; ++ idxParent[2] )
+    {
+        for( idxParent[1] = 0 ; idxParent[1] < rParentLayer.GetNumCells( 1 ) ; ++ idxParent[1] )
+        {
+            for( idxParent[0] = 0 ; idxParent[0] < rParentLayer.GetNumCells( 0 ) ; ++ idxParent[0] )
+            {   // For each cell in this subset of the parent layer...
+                unsigned clusterMinIndices[ 3 ] ;
+                mInfluenceTree.GetChildClusterMinCornerIndex( clusterMinIndices , pClusterDims , idxParent ) ;
+                bool bChanged = false ;
+                unsigned increment[3] ;
+                for( increment[2] = 0 ; ( increment[2] < pClusterDims[2] ) && ! bChanged ; ++ increment[2] )
+                {
+                    for( increment[1] = 0 ; ( increment[1] < pClusterDims[1] ) && ! bChanged ; ++ increment[1] )
+                    {
+                        const unsigned offsetYZ = ( clusterMinIndices[1] + increment[1] ) * numXchild + ( clusterMinIndices[2] + increment[2] ) * numXYchild ;
+                        for( increment[0] = 0 ; increment[0] < pClusterDims[0] ; ++ increment[0] )
+                        {   // For each child cell in this cluster...
+                            bChanged = bChanged || ( childDirty[ clusterMinIndices[0] + increment[0] + offsetYZ ] != 0 ) ;
+                        }
+                    }
+                }
+                if( bChanged )
+                {   // Some child changed, so this cluster did too.
+                    AggregateCluster( uParentLayer , idxParent ) ;
+                    parentDirty[ idxParent[0] + rParentLayer.GetNumPoints( 0 ) * ( idxParent[1] + rParentLayer.GetNumPoints( 1 ) * idxParent[2] ) ] = 1 ;
+                }
+            }
+        }
+    }
+}
+
+
+
+
+/*! \brief Update the influence tree in place to reflect vortons that moved or changed since it was built
+
+    Between consecutive frames, most vortons remain in the same leaf cell,
+    so rebuilding the whole tree wastes effort.  IndexParticles already
+    re-binned only the vortons that changed cells.  This recomputes each
+    leaf cell from the vortons the index lists for it, in parallel, and
+    flags the leaf cells whose contents changed.  Then, layer by layer,
+    it re-aggregates only clusters with a flagged child, and flags those.
+
+    This deliberately visits every leaf, rather than only the cells that
+    the index's moved-particle list names:  Every vorton advects and
+    stretches every frame, so the center-of-vorticity and net vorticity
+    of every occupied leaf change even when no vorton changes cells.
+    What refitting saves, relative to CreateInfluenceTree, is re-binning
+    vortons, reallocating layers, and re-aggregating unchanged clusters.
+
+    \note This routine assumes CanRefitInfluenceTree returned true
+            and IndexParticles has already executed.
+
+    \see CreateInfluenceTree, SetRefitTolerance
+
+*/
+void VortonSim::RefitInfluenceTree( void )
+{
+    Vector< unsigned char > childDirty ;
+    Vector< unsigned char > parentDirty ;
+
+    // Recompute leaf cells.
+    childDirty.Resize( mInfluenceTree[ 0 ].GetGridCapacity() , 0 ) ;
+    const size_t numLeafSlices = mInfluenceTree[ 0 ].GetNumPoints( 2 ) ;
+#if USE_TBB
+    {
+        // Estimate grain size based on size of problem and number of processors.
+        const size_t grainSize =  MAX2( 1 , numLeafSlices / gNumberOfProcessors ) ;
+        parallel_for( tbb::blocked_range<size_t>( 0 , numLeafSlices , grainSize ) , VortonSim_RefitLeaves_TBB( this , childDirty ) ) ;
+    }
+#else
+    RefitLeafSlices( childDirty , 0 , numLeafSlices ) ;
+#endif
+
+    // Re-aggregate ancestors of changed cells, layer by layer.
+    const size_t numLayers = mInfluenceTree.GetDepth() ;
+    for( unsigned uParentLayer = 1 ; uParentLayer < numLayers ; ++ uParentLayer )
+    {   // For each layer above the leaves...
+        const UniformGrid< Vorton > & rParentLayer = mInfluenceTree[ uParentLayer ] ;
+        parentDirty.Clear() ;
+        parentDirty.Resize( rParentLayer.GetGridCapacity() , 0 ) ;
+        // AggregateClusters visits only cells, not points on the maximal boundary, so do the same.
+        const size_t numParentSlices = rParentLayer.GetNumCells( 2 ) ;
+#if USE_TBB
+        // Estimate grain size based on size of problem and number of processors.
+        const size_t grainSize =  MAX2( 1 , numParentSlices / gNumberOfProcessors ) ;
+        parallel_for( tbb::blocked_range<size_t>( 0 , numParentSlices , grainSize ) , VortonSim_RefitClusters_TBB( this , uParentLayer , childDirty , parentDirty ) ) ;
+#else
+        RefitClusterSlices( uParentLayer , childDirty , parentDirty , 0 , numParentSlices ) ;
+#endif
+        childDirty.Swap( parentDirty ) ;
+    }
+
+    ++ mNumRefits ;
+}
+
+
+
+
+/*! \brief Compute octree leaf keys for a subset of vortons
+
+    \param iStart - index of first vorton to process
+
+    \param iEnd - one past index of last vorton to process
+
+    \see CreateInfluenceOctree
+
+*/
+void VortonSim::ComputeVortonKeysSlice( size_t iStart , size_t iEnd )
+{
+    const ChunkedVector< Vorton > &    rVortons    = mVortons ;
+    for( size_t iVorton = iStart ; iVorton < iEnd ; ++ iVorton )
+    {   // For each vorton in this slice...
+        LinearOctree< Vorton >::KeyIndexPair & rKeyIndex = mVortonKeys[ iVorton ] ;
+        rKeyIndex.mKey      = mInfluenceOctree.KeyOfPosition( rVortons[ iVorton ].mPosition ) ;
+        rKeyIndex.mIndex    = unsigned( iVorton ) ;
+    }
+}
+
+
+
+
+/*! \brief Populate a subset of leaf cells of the influence octree from the vortons they contain
+
+    \param iStart - index of first leaf cell to populate
+
+    \param iEnd - one past index of last leaf cell to populate
+
+    Each leaf cell gets a single "supervorton" aggregated from its vortons,
+    the same way MakeBaseVortonGrid populates the leaf layer of the nested grid.
+
+    \see CreateInfluenceOctree, MakeBaseVortonGrid
+
+*/
+void VortonSim::MakeBaseVortonOctreeSlice( size_t iStart , size_t iEnd )
+{
+    const ChunkedVector< Vorton > &    rVortons    = mVortons ;
+    LinearOctree< Vorton >::Level & rLeaves = mInfluenceOctree[ 0 ] ;
+    for( size_t iLeaf = iStart ; iLeaf < iEnd ; ++ iLeaf )
+    {   // For each leaf cell in this slice...
+        Vorton &            rVortonCell = rLeaves.mItems[ iLeaf ] ;
+        VortonClusterAux    vortAux ;
+        const unsigned      iPairEnd    = rLeaves.mFirstChild[ iLeaf + 1 ] ;
+        for( unsigned iPair = rLeaves.mFirstChild[ iLeaf ] ; iPair < iPairEnd ; ++ iPair )
+        {   // For each vorton in this leaf cell...
+            const Vorton &  rVorton = rVortons[ mVortonKeys[ iPair ].mIndex ] ;
+            const float     vortMag = rVorton.mVorticity.Magnitude() ;
+
+            rVortonCell.mPosition  += rVorton.mPosition * vortMag ; // Compute weighted position -- to be normalized later.
+            rVortonCell.mVorticity += rVorton.mVorticity          ; // Tally vorticity sum.
+            rVortonCell.mRadius     = rVorton.mRadius             ; // Assign volume element size.
+            vortAux.mVortNormSum   += vortMag ;
+        }
+        if( vortAux.mVortNormSum != FLT_MIN )
+        {   // Cell contains at least one vorton with nonzero vorticity.
+            // Normalize weighted position sum to obtain center-of-vorticity.
+            rVortonCell.mPosition /= vortAux.mVortNormSum ;
+        }
+    }
+}
+
+
+
+
+/*! \brief Aggregate a subset of cells in a parent level of the influence octree from their children
+
+    \param iParentLevel - index of parent level.  This must be greater than 0.
+
+    \param iStart - index of first parent cell to aggregate
+
+    \param iEnd - one past index of last parent cell to aggregate
+
+    Only occupied children exist, and the octree stores them in the same
+    order that AggregateClusters visits a grid cluster, so this yields the
+    same cluster as AggregateClusters.
+
+    \see CreateInfluenceOctree, AggregateClusters
+
+*/
+void VortonSim::AggregateOctreeClustersSlice( size_t iParentLevel , size_t iStart , size_t iEnd )
+{
+    LinearOctree< Vorton >::Level &         rParentLevel    = mInfluenceOctree[ iParentLevel ] ;
+    const LinearOctree< Vorton >::Level &   rChildLevel     = mInfluenceOctree[ iParentLevel - 1 ] ;
+    for( size_t iParent = iStart ; iParent < iEnd ; ++ iParent )
+    {   // For each cell in this slice of the parent level...
+        Vorton &            rVortonParent   = rParentLevel.mItems[ iParent ] ;
+        VortonClusterAux    vortAux ;
+        const unsigned      iChildEnd       = rParentLevel.mFirstChild[ iParent + 1 ] ;
+        for( unsigned iChild = rParentLevel.mFirstChild[ iParent ] ; iChild < iChildEnd ; ++ iChild )
+        {   // For each occupied child of this cell...
+            const Vorton &  rVortonChild    = rChildLevel.mItems[ iChild ] ;
+            const float     vortMag         = rVortonChild.mVorticity.Magnitude() ;
+
+            // Aggregate vorton cluster from child level into parent level:
+            rVortonParent.mPosition  += rVortonChild.mPosition * vortMag ;
+            rVortonParent.mVorticity += rVortonChild.mVorticity ;
+            vortAux.mVortNormSum     += vortMag ;
+            if( rVortonChild.mRadius != 0.0f )
+            {
+                rVortonParent.mRadius  = rVortonChild.mRadius ;
+            }
+        }
+        // Normalize weighted position sum to obtain center-of-vorticity.
+        rVortonParent.mPosition /= vortAux.mVortNormSum ;
+    }
+}
+
+
+
+
+/*! \brief Create linear octree vorticity influence tree
+
+    This builds the same hierarchy of vorton clusters as the nested grid
+    does, but stores only occupied cells: sort vortons by the Morton key
+    of their leaf cell, derive occupied cells of each level from those of
+    the level below, populate leaves, then aggregate levels bottom-up.
+
+    \see CreateInfluenceTree, ComputeVelocityOctree
+
+    \note This method assumes mGridGeometry has already been assigned.
+
+*/
+void VortonSim::CreateInfluenceOctree( void )
+{
+    mInfluenceOctree.Initialize( mGridGeometry ) ;
+
+    QUERY_PERFORMANCE_ENTER ;
+    const size_t numVortons = mVortons.Size() ;
+    mVortonKeys.Resize( numVortons ) ;
+#if USE_TBB
+    {
+        // Estimate grain size based on size of problem and number of processors.
+        const size_t grainSize =  MAX2( 1 , numVortons / gNumberOfProcessors ) ;
+        parallel_for( tbb::blocked_range<size_t>( 0 , numVortons , grainSize ) , VortonSim_ComputeVortonKeys_TBB( this ) ) ;
+        tbb::parallel_sort( mVortonKeys.Begin() , mVortonKeys.End() ) ;
+    }
+#else
+    ComputeVortonKeysSlice( 0 , numVortons ) ;
+    sort( mVortonKeys.Begin() , mVortonKeys.End() ) ;
+#endif
+    QUERY_PERFORMANCE_EXIT( VortonSim_CreateInfluenceOctree_SortKeys ) ;
+
+    QUERY_PERFORMANCE_ENTER ;
+    mInfluenceOctree.BuildSkeleton( mVortonKeys ) ;
+    QUERY_PERFORMANCE_EXIT( VortonSim_CreateInfluenceOctree_BuildSkeleton ) ;
+
+    QUERY_PERFORMANCE_ENTER ;
+    const size_t numLeaves = mInfluenceOctree[ 0 ].mKeys.Size() ;
+#if USE_TBB
+    {
+        // Estimate grain size based on size of problem and number of processors.
+        const size_t grainSize =  MAX2( 1 , numLeaves / gNumberOfProcessors ) ;
+        parallel_for( tbb::blocked_range<size_t>( 0 , numLeaves , grainSize ) , VortonSim_MakeBaseVortonOctree_TBB( this ) ) ;
+    }
+#else
+    MakeBaseVortonOctreeSlice( 0 , numLeaves ) ;
+#endif
+    QUERY_PERFORMANCE_EXIT( VortonSim_CreateInfluenceOctree_MakeBaseVortonOctree ) ;
+
+    QUERY_PERFORMANCE_ENTER ;
+    const size_t numLevels = mInfluenceOctree.GetDepth() ;
+    for( size_t iParentLevel = 1 ; iParentLevel < numLevels ; ++ iParentLevel )
+    {   // For each level above the leaves...
+        const size_t numCells = mInfluenceOctree[ iParentLevel ].mKeys.Size() ;
+    #if USE_TBB
+        // Estimate grain size based on size of problem and number of processors.
+        const size_t grainSize =  MAX2( 1 , numCells / gNumberOfProcessors ) ;
+        // Each parent cell reads only its own children, so cells in a level aggregate independently.
+        parallel_for( tbb::blocked_range<size_t>( 0 , numCells , grainSize ) , VortonSim_AggregateOctreeClusters_TBB( this , iParentLevel ) ) ;
+    #else
+        AggregateOctreeClustersSlice( iParentLevel , 0 , numCells ) ;
+    #endif
+    }
+    QUERY_PERFORMANCE_EXIT( VortonSim_CreateInfluenceOctree_AggregateClusters ) ;
+}
+
+
+
+
+/*! \brief Create nested grid vorticity influence tree
+
+    Each layer of this tree represents a simplified, aggregated version of
+    all of the information in its "child" layer, where each
+    "child" has higher resolution than its "parent".
+
+    \see MakeBaseVortonGrid, AggregateClusters, NeedsVelocityGrid
+
+    When direct summation supplies everything vortons need, and neither
+    tracers nor bodies need a velocity grid, this only indexes particles.
+
+    Derivation:
+
+    Using conservation properties, I_0 = I_0' , I_1 = I_1' , I_2 = I_2'
+
+    I_0 : wx d = w1x d1 + w2x d2
+        : wy d = w1y d1 + w2y d2
+        : wz d = w1z d1 + w2z d2
+
+        These 3 are not linearly independent:
+    I_1 : ( y wz - z wy ) d = ( y1 wz1 - z1 wy1 ) d1 + ( y2 wz2 - z2 wy2 ) d2
+        : ( z wx - x wz ) d = ( z1 wx1 - x1 wz1 ) d1 + ( z2 wx2 - x2 wz2 ) d2
+        : ( x wy - y wx ) d = ( x1 wy1 - y1 wx1 ) d1 + ( x2 wy2 - y2 wx2 ) d2
+
+    I_2 : ( x^2 + y^2 + z^2 ) wx d = (x1^2 + y1^2 + z1^2 ) wx1 d1 + ( x2^2 + y2^2 + z2^2 ) wx2 d2
+        : ( x^2 + y^2 + z^2 ) wy d = (x1^2 + y1^2 + z1^2 ) wy1 d1 + ( x2^2 + y2^2 + z2^2 ) wy2 d2
+        : ( x^2 + y^2 + z^2 ) wz d = (x1^2 + y1^2 + z1^2 ) wz1 d1 + ( x2^2 + y2^2 + z2^2 ) wz2 d2
+
+    Can replace I_2 with its magnitude:
+              ( x^2  + y^2  + z^2  ) ( wx^2  + wy^2  + wz^2  )^(1/2) d
+            = ( x1^2 + y1^2 + z1^2 ) ( wx1^2 + w1y^2 + w1z^2 )^(1/2) d1
+            + ( x2^2 + y2^2 + z2^2 ) ( wx2^2 + w2y^2 + w2z^2 )^(1/2) d2
+
+*/
+void VortonSim::CreateInfluenceTree( void )
+{
+    QUERY_PERFORMANCE_ENTER ;
+    FindBoundingBox() ; // Find axis-aligned bounding box that encloses all vortons.
+    QUERY_PERFORMANCE_EXIT( VortonSim_CreateInfluenceTree_FindBoundingBox ) ;
+
+    mVelGridRequired = NeedsVelocityGrid() ;
+
+    if( mVelGridRequired && CanRefitInfluenceTree() )
+    {   // Update existing tree in place, so no need to rebuild it.
+        QUERY_PERFORMANCE_ENTER ;
+        IndexParticles() ;
+        QUERY_PERFORMANCE_EXIT( VortonSim_CreateInfluenceTree_IndexParticles ) ;
+
+        QUERY_PERFORMANCE_ENTER ;
+        RefitInfluenceTree() ;
+        QUERY_PERFORMANCE_EXIT( VortonSim_CreateInfluenceTree_RefitInfluenceTree ) ;
+
+        QUERY_PERFORMANCE_ENTER ;
+        GatherLeafBuckets() ;
+        QUERY_PERFORMANCE_EXIT( VortonSim_CreateInfluenceTree_GatherLeafBuckets ) ;
+        return ;
+    }
+
+    // Create skeletal nested grid for influence tree.
+    const size_t numVortons = mVortons.Size() ;
+    const size_t numSources = numVortons + CountFilamentEquivalentVortons() ;  // Grids must resolve filament cores too.
+    {
+        // When refitting, pad the grid so vortons can wander for several frames before the next rebuild.
+        mRefitExtent = mMaxCorner - mMinCorner ;
+        mNumRefits   = 0 ;
+        const Vec3 vPadding = mRefitTolerance * mRefitExtent ;
+        UniformGrid< Vorton >   ugSkeleton ;   ///< Uniform grid with the same size & shape as the one holding aggregated information about mVortons.
+        ugSkeleton.DefineShape( numSources , mMinCorner - vPadding , mMaxCorner + vPadding , true ) ;
+        mGridGeometry.CopyShape( ugSkeleton ) ;
+
+        QUERY_PERFORMANCE_ENTER ;
+        IndexParticles() ;
+        QUERY_PERFORMANCE_EXIT( VortonSim_CreateInfluenceTree_IndexParticles ) ;
+
+        if( ! mVelGridRequired )
+        {   // Direct summation supplies everything vortons need, and nothing else reads the velocity grid, so no tree is needed.
+            // Diffusion and collisions still use the particle index.
+            mInfluenceTree.Clear() ;
+            mInfluenceOctree.Clear() ;
+            mLeafBucketLayer = 0 ;
+            mLeafBucketBegin.Clear() ;
+            mLeafBuckets.Clear() ;
+            mTraversalCuts.Clear() ;
+            return ;
+        }
+
+        if(     ( INFLUENCE_LINEAR_OCTREE == mInfluenceStructure )
+            &&  ( numVortons > 0 )
+            &&  ( 0 == mFilaments.Size() )  // Octree holds only vortons, not filament segments.
+            &&  LinearOctree< Vorton >::CanRepresent( mGridGeometry ) )
+        {   // Use sparse octree instead of nested grid.
+            mInfluenceTree.Clear() ;
+            mLeafBucketLayer = 0 ;  // Octree leaves are always supervortons.
+            mLeafBucketBegin.Clear() ;
+            mLeafBuckets.Clear() ;
+            mTraversalCuts.Clear() ;
+            CreateInfluenceOctree() ;
+            return ;
+        }
+        // Otherwise use nested grid, including when the grid is too large for octree keys.
+        mInfluenceOctree.Clear() ;
+        mTraversalCuts.Clear() ;    // Geometry of tree changed, so cached cuts no longer apply.
+        mInfluenceTree.Initialize( ugSkeleton ) ; // Create skeleton of influence tree.
+    }
+
+    QUERY_PERFORMANCE_ENTER ;
+    MakeBaseVortonGrid() ;
+    QUERY_PERFORMANCE_EXIT( VortonSim_CreateInfluenceTree_MakeBaseVortonGrid ) ;
+
+    QUERY_PERFORMANCE_ENTER ;
+    const size_t numLayers = mInfluenceTree.GetDepth() ;
+    for( unsigned int uParentLayer = 1 ; uParentLayer < numLayers ; ++ uParentLayer )
+    {   // For each layer in the influence tree...
+        AggregateClusters( uParentLayer ) ;
+    }
+    QUERY_PERFORMANCE_EXIT( VortonSim_CreateInfluenceTree_AggregateClusters ) ;
+
+    QUERY_PERFORMANCE_ENTER ;
+    GatherLeafBuckets() ;
+    QUERY_PERFORMANCE_EXIT( VortonSim_CreateInfluenceTree_GatherLeafBuckets ) ;
+}
+
+
+
+
+/*! \brief Compute velocity at a given point in space, due to influence of vortons in the linear octree
+
+    \param vPosition - point in space whose velocity to evaluate
+
+    \param iLevel - level of the cell whose children to visit
+
+    \param iNode - index of that cell within its level
+
+    \return velocity at vPosition, due to influence of vortons
+
+    \note This is a recursive algorithm with time complexity O(log(N)).
+            The outermost caller should pass in mInfluenceOctree.GetDepth()-1 and 0, i.e. the root.
+            It visits the same clusters as ComputeVelocity, except empty ones, which have no influence.
+
+*/
+Vec3 VortonSim::ComputeVelocityOctree( const Vec3 & vPosition , size_t iLevel , size_t iNode ) const
+{
+    const LinearOctree< Vorton >::Level &   rParentLevel    = mInfluenceOctree[ iLevel ] ;
+    const LinearOctree< Vorton >::Level &   rChildLevel     = mInfluenceOctree[ iLevel - 1 ] ;
+    const Vec3 &                            vGridMinCorner  = rChildLevel.mGeometry.GetMinCorner() ;
+    const Vec3                              vSpacing        = rChildLevel.mGeometry.GetCellSpacing() ;
+    Vec3                                    velocityAccumulator( 0.0f , 0.0f , 0.0f ) ;
+
+    // When domain is 2D in XY plane, min.z==max.z so vPos.z test below would fail unless margin.z!=0.
+    const Vec3          margin          = sTreeMarginFactor * vSpacing + ( 0.0f == vSpacing.z ? Vec3(0,0,FLT_MIN) : Vec3(0,0,0) );
+
+    const unsigned iChildEnd = rParentLevel.mFirstChild[ iNode + 1 ] ;
+    for( unsigned iChild = rParentLevel.mFirstChild[ iNode ] ; iChild < iChildEnd ; ++ iChild )
+    {   // For each occupied child of this cell...
+        unsigned idxChild[3] ;
+        MortonIndices( idxChild , rChildLevel.mKeys[ iChild ] ) ;
+        Vec3 vCellMinCorner , vCellMaxCorner ;
+        vCellMinCorner.x = vGridMinCorner.x + float( idxChild[0]     ) * vSpacing.x ;
+        vCellMinCorner.y = vGridMinCorner.y + float( idxChild[1]     ) * vSpacing.y ;
+        vCellMinCorner.z = vGridMinCorner.z + float( idxChild[2]     ) * vSpacing.z ;
+        vCellMaxCorner.x = vGridMinCorner.x + float( idxChild[0] + 1 ) * vSpacing.x ;
+        vCellMaxCorner.y = vGridMinCorner.y + float( idxChild[1] + 1 ) * vSpacing.y ;
+        vCellMaxCorner.z = vGridMinCorner.z + float( idxChild[2] + 1 ) * vSpacing.z ;
+        if(
+                ( iLevel > 1 )
+            &&  ( vPosition.x >= vCellMinCorner.x - margin.x )
+            &&  ( vPosition.y >= vCellMinCorner.y - margin.y )
+            &&  ( vPosition.z >= vCellMinCorner.z - margin.z )
+            &&  ( vPosition.x <  vCellMaxCorner.x + margin.x )
+            &&  ( vPosition.y <  vCellMaxCorner.y + margin.y )
+            &&  ( vPosition.z <  vCellMaxCorner.z + margin.z )
+          )
+        {   // Test position is inside childCell and child is not a leaf...
+            // Recurse child level.
+            velocityAccumulator += ComputeVelocityOctree( vPosition , iLevel - 1 , iChild ) ;
+        }
+        else
+        {   // Test position is outside childCell, or reached leaf node.
+            //    Compute velocity induced by cell at corner point x.
+            //    Accumulate influence, storing in velocityAccumulator.
+            const Vorton &  rVortonChild    = rChildLevel.mItems[ iChild ] ;
+            VORTON_ACCUMULATE_VELOCITY( velocityAccumulator , vPosition , rVortonChild ) ;
+        }
+    }
+
+    return velocityAccumulator ;
+}
+
+
+
+
+/*! \brief Copy coarse layers of the influence tree into reduced-precision storage
+
+    Traversals read only what VORTON_ACCUMULATE_VELOCITY needs from each
+    cell, so a packed copy of each layer lets them stream fewer bytes.
+    Each cluster position is stored relative to the minimal corner of its
+    cell, which ComputeVelocity already knows, so positions retain about
+    as much precision relative to the cell size as vorticity does.
+    Each layer's vorticity is stored divided by a power-of-two scale,
+    in mPackedTreeScales, which keeps aggregated vorticity of large
+    clusters within half-precision range.
+
+    This repacks every cell of every packed layer, even after
+    RefitInfluenceTree, since every occupied cell changes each frame,
+    and when the largest cluster vorticity crosses a power of two, the
+    layer scale changes, which alters every packed cell.
+
+    \see SetTreePrecision, ComputeVelocity
+
+    \note This routine assumes CreateInfluenceTree has already executed.
+
+*/
+void VortonSim::PackInfluenceTree( void )
+{
+    const size_t numLayers = mInfluenceTree.GetDepth() ;
+    // Traversals never read the root layer as a child, so there is no need to pack it.
+    mPackedLayerBegin = ( STORAGE_FLOAT32 == mTreePrecision ) ? numLayers : MIN2( size_t( mPackedTreeMinLayer ) , numLayers ) ;
+    mPackedTree.Resize( numLayers ) ;
+    mPackedTreeScales.Resize( numLayers ) ;
+    for( size_t iLayer = 0 ; iLayer < numLayers ; ++ iLayer )
+    {   // For each layer in the influence tree...
+        Vector< PackedVorton > & rPackedLayer = mPackedTree[ iLayer ] ;
+        mPackedTreeScales[ iLayer ] = 1.0f ;
+        if( ( iLayer < mPackedLayerBegin ) || ( iLayer + 1 == numLayers ) )
+        {   // Traversals read this layer at full precision, so it needs no packed copy.
+            rPackedLayer.Clear() ;
+            continue ;
+        }
+        const UniformGrid< Vorton > &   rLayer          = mInfluenceTree[ iLayer ] ;
+        const size_t                    numCells        = rLayer.GetGridCapacity() ;
+
+        // Find scale that brings largest vorticity component of this layer within range of the packed format.
+        float vortMaxComponent = 0.0f ;
+        for( size_t offset = 0 ; offset < numCells ; ++ offset )
+        {   // For each cell in this layer...
+            const Vec3 & rVorticity = rLayer[ offset ].mVorticity ;
+            vortMaxComponent = MAX2( vortMaxComponent , MAX2( fabsf( rVorticity.x ) , MAX2( fabsf( rVorticity.y ) , fabsf( rVorticity.z ) ) ) ) ;
+        }
+        float oneOverScale = 1.0f ;
+        if( vortMaxComponent > 0.0f )
+        {
+            int exponent ;
+            frexpf( vortMaxComponent , & exponent ) ;    // vortMaxComponent lies in [2^(exponent-1),2^exponent).
+            mPackedTreeScales[ iLayer ] = ldexpf( 1.0f , exponent - sPackedVorticityExponent ) ;
+            oneOverScale                = ldexpf( 1.0f , sPackedVorticityExponent - exponent ) ;
+        }
+
+        const Vec3 &                    vGridMinCorner  = rLayer.GetMinCorner() ;
+        const Vec3                      vSpacing        = rLayer.GetCellSpacing() ;
+        const unsigned                  dims[3]         =   { rLayer.GetNumPoints( 0 )
+                                                            , rLayer.GetNumPoints( 1 )
+                                                            , rLayer.GetNumPoints( 2 ) } ;
+        rPackedLayer.Resize( numCells ) ;
+        unsigned offset = 0 ;
+        unsigned idx[3] ;
+        Vec3     vCellMinCorner ;
+        for( idx[2] = 0 ; idx[2] < dims[2] ; ++ idx[2] )
+        {
+            vCellMinCorner.z = vGridMinCorner.z + float( idx[2] ) * vSpacing.z ;
+            for( idx[1] = 0 ; idx[1] < dims[1] ; ++ idx[1] )
+            {
+                vCellMinCorner.y = vGridMinCorner.y + float( idx[1] ) * vSpacing.y ;
+                for( idx[0] = 0 ; idx[0] < dims[0] ; ++ idx[0] , ++ offset )
+                {   // For each cell in this layer...
+                    vCellMinCorner.x = vGridMinCorner.x + float( idx[0] ) * vSpacing.x ;
+                    const Vorton &  rVorton     = rLayer[ offset ] ;
+                    PackedVorton &  rPacked     = rPackedLayer[ offset ] ;
+                    const Vec3      vPosInCell  = rVorton.mPosition - vCellMinCorner ;
+                    Pack( rPacked.mPositionRadius , vPosInCell.x , vPosInCell.y , vPosInCell.z , rVorton.mRadius , mTreePrecision ) ;
+                    const Vec3      vVortScaled = rVorton.mVorticity * oneOverScale ;
+                    Pack( rPacked.mVorticity , vVortScaled.x , vVortScaled.y , vVortScaled.z , 0.0f , mTreePrecision ) ;
+                }
+            }
+        }
+    }
+}
+
+
+
+
+/*! \brief Compute how many leaf cells, along each axis, each cell of a layer of the influence tree covers
+
+    \param leavesPerCell - (out) number of leaf cells along each axis of each cell of the given layer
+
+    \param tree - influence tree
+
+    \param iLayer - index of layer
+*/
+static void LeavesPerCell( unsigned leavesPerCell[3] , const NestedGrid< Vorton > & tree , size_t iLayer )
+{
+    leavesPerCell[0] = leavesPerCell[1] = leavesPerCell[2] = 1 ;
+    for( size_t iParentLayer = 1 ; iParentLayer <= iLayer ; ++ iParentLayer )
+    {   // For each layer from the leaves up to the given layer...
+        const unsigned * pDecimations = tree.GetDecimations( iParentLayer ) ;
+        leavesPerCell[0] *= pDecimations[0] ;
+        leavesPerCell[1] *= pDecimations[1] ;
+        leavesPerCell[2] *= pDecimations[2] ;
+    }
+}
+
+
+
+
+/*! \brief Return range of leaf indices, along each axis, that a cell of a coarser layer of the influence tree covers
+
+    \param idxLeafBegin - (out) indices of first leaf cell the given cell covers
+
+    \param idxLeafEnd - (out) one past indices of last leaf cell the given cell covers
+
+    \param idx - indices of cell in its layer
+
+    \param numCells - number of cells along each axis of that layer
+
+    \param leavesPerCell - number of leaf cells along each axis of each cell of that layer
+
+    \param numLeafPoints - number of points along each axis of the leaf layer
+
+    Cells along the maximal boundary also cover whatever leaves
+    decimation left over, so every leaf belongs to some cell.
+*/
+static void LeafRangeOfCell( unsigned idxLeafBegin[3] , unsigned idxLeafEnd[3] , const unsigned idx[3] , const unsigned numCells[3] , const unsigned leavesPerCell[3] , const unsigned numLeafPoints[3] )
+{
+    for( unsigned axis = 0 ; axis < 3 ; ++ axis )
+    {
+        idxLeafBegin[ axis ] = idx[ axis ] * leavesPerCell[ axis ] ;
+        idxLeafEnd  [ axis ] = ( idx[ axis ] + 1 < numCells[ axis ] ) ? ( idx[ axis ] + 1 ) * leavesPerCell[ axis ] : numLeafPoints[ axis ] ;
+    }
+}
+
+
+
+
+/*! \brief Copy vortons into leaf buckets, for a subset of z-slices of the bucket layer
+
+    \param izStart - index of first z-slice of layer mLeafBucketLayer to process
+
+    \param izEnd - one past index of last z-slice of layer mLeafBucketLayer to process
+
+    \see GatherLeafBuckets
+*/
+void VortonSim::GatherLeafBucketsSlice( size_t izStart , size_t izEnd )
+{
+    const ChunkedVector< Vorton > &    rVortons    = mVortons ;
+    const UniformGrid< Vorton > &   rLeaves         = mInfluenceTree[ 0 ] ;
+    const UniformGrid< Vorton > &   rBuckets        = mInfluenceTree[ mLeafBucketLayer ] ;
+    const unsigned                  numLanes        = FloatNative::NumLanes ;
+    const unsigned                  numLeafPoints[3] = { rLeaves.GetNumPoints( 0 ) , rLeaves.GetNumPoints( 1 ) , rLeaves.GetNumPoints( 2 ) } ;
+    const unsigned                  numCells[3]     = { rBuckets.GetNumCells( 0 ) , rBuckets.GetNumCells( 1 ) , rBuckets.GetNumCells( 2 ) } ;
+    unsigned                        leavesPerCell[3] ;
+    LeavesPerCell( leavesPerCell , mInfluenceTree , mLeafBucketLayer ) ;
+
+    unsigned idx[3] ;
+    for( idx[2] = unsigned( izStart ) ; idx[2] < izEnd ; ++ idx[2] )
+    {
+        for( idx[1] = 0 ; idx[1] < numCells[1] ; ++ idx[1] )
+        {
+            for( idx[0] = 0 ; idx[0] < numCells[0] ; ++ idx[0] )
+            {   // For each cell in bucket layer...
+                const unsigned  offset  = idx[0] + rBuckets.GetNumPoints( 0 ) * ( idx[1] + rBuckets.GetNumPoints( 1 ) * idx[2] ) ;
+                float *         pPacket = & mLeafBuckets[ mLeafBucketBegin[ offset ] * sLeafBucketChannels * numLanes ] ;
+                unsigned        iLane   = 0 ;
+                unsigned idxLeafBegin[3] , idxLeafEnd[3] , idxLeaf[3] ;
+                LeafRangeOfCell( idxLeafBegin , idxLeafEnd , idx , numCells , leavesPerCell , numLeafPoints ) ;
+                for( idxLeaf[2] = idxLeafBegin[2] ; idxLeaf[2] < idxLeafEnd[2] ; ++ idxLeaf[2] )
+                {
+                    for( idxLeaf[1] = idxLeafBegin[1] ; idxLeaf[1] < idxLeafEnd[1] ; ++ idxLeaf[1] )
+                    {
+                        for( idxLeaf[0] = idxLeafBegin[0] ; idxLeaf[0] < idxLeafEnd[0] ; ++ idxLeaf[0] )
+                        {   // For each leaf cell in this bucket...
+                            const unsigned leaf     = idxLeaf[0] + numLeafPoints[0] * ( idxLeaf[1] + numLeafPoints[1] * idxLeaf[2] ) ;
+                            const unsigned iSortEnd = mVortonCells.GetCellEnd( leaf ) ;
+                            for( unsigned iSorted = mVortonCells.GetCellBegin( leaf ) ; iSorted < iSortEnd ; ++ iSorted )
+                            {   // For each vorton in this leaf cell...
+                                StoreVortonInPacket( pPacket , iLane , rVortons[ mVortonCells.GetParticle( iSorted ) ] ) ;
+                                if( ++ iLane == numLanes )
+                                {   // Packet is full.  Start next one.
+                                    pPacket += sLeafBucketChannels * numLanes ;
+                                    iLane = 0 ;
+                                }
+                            }
+                        }
+                    }
+                }
+                if( iLane > 0 )
+                {   // Last packet is partially full.
+                    PadPacket( pPacket , iLane ) ;
+                }
+            }
+        }
+    }
+}
+
+
+
+
+/*! \brief Copy vortons in each cell of a coarse layer of the influence tree into contiguous buckets
+
+    When mLeafCapacity exceeds 1, traversals stop at the coarsest layer
+    whose cells hold, on average, no more than mLeafCapacity vortons,
+    and sum over each vorton in those cells, instead of using aggregates.
+    This copies the vortons of each such cell, in the order mVortonCells
+    lists them, into packets that AccumulateVelocityFromBucket sums a
+    whole packet at a time.
+
+    \note This routine assumes CreateInfluenceTree built a nested grid
+            and IndexParticles has already executed.
+
+    \see SetLeafCapacity, AccumulateVelocityFromBucket
+*/
+void VortonSim::GatherLeafBuckets( void )
+{
+    const size_t    numLayers       = mInfluenceTree.GetDepth() ;
+    const size_t    numVortons      = mVortons.Size() ;
+    const size_t    prevBucketLayer = mLeafBucketLayer ;
+    mLeafBucketLayer = 0 ;
+    if( ( mLeafCapacity > 1 ) && ( 0 == mFilaments.Size() ) )  // Buckets hold only vortons, not filament segments.
+    {   // Find coarsest layer, below the root, whose cells hold no more than mLeafCapacity vortons on average.
+        while( mLeafBucketLayer + 2 < numLayers )
+        {
+            const UniformGrid< Vorton > & rParent = mInfluenceTree[ mLeafBucketLayer + 1 ] ;
+            const size_t numParentCells = size_t( rParent.GetNumCells( 0 ) ) * rParent.GetNumCells( 1 ) * rParent.GetNumCells( 2 ) ;
+            if( numVortons > size_t( mLeafCapacity ) * numParentCells )
+            {   // Parent layer would hold too many vortons per cell.
+                break ;
+            }
+            ++ mLeafBucketLayer ;
+        }
+    }
+    if( mLeafBucketLayer != prevBucketLayer )
+    {   // Cached cuts stop at whichever layer held buckets when they were built.
+        mTraversalCuts.Clear() ;
+    }
+    if( 0 == mLeafBucketLayer )
+    {   // Leaves are supervortons, so there are no buckets.
+        mLeafBucketBegin.Clear() ;
+        mLeafBuckets.Clear() ;
+        return ;
+    }
+
+    // Count packets each bucket needs.
+    const UniformGrid< Vorton > &   rLeaves         = mInfluenceTree[ 0 ] ;
+    const UniformGrid< Vorton > &   rBuckets        = mInfluenceTree[ mLeafBucketLayer ] ;
+    const unsigned                  numLanes        = FloatNative::NumLanes ;
+    const unsigned                  numLeafPoints[3] = { rLeaves.GetNumPoints( 0 ) , rLeaves.GetNumPoints( 1 ) , rLeaves.GetNumPoints( 2 ) } ;
+    const unsigned                  numCells[3]     = { rBuckets.GetNumCells( 0 ) , rBuckets.GetNumCells( 1 ) , rBuckets.GetNumCells( 2 ) } ;
+    unsigned                        leavesPerCell[3] ;
+    LeavesPerCell( leavesPerCell , mInfluenceTree , mLeafBucketLayer ) ;
+    const unsigned numBucketPoints = rBuckets.GetGridCapacity() ;
+    mLeafBucketBegin.Clear() ;
+    mLeafBucketBegin.Resize( numBucketPoints + 1 , 0 ) ;
+    unsigned idx[3] ;
+    for( idx[2] = 0 ; idx[2] < numCells[2] ; ++ idx[2] )
+    {
+        for( idx[1] = 0 ; idx[1] < numCells[1] ; ++ idx[1] )
+        {
+            for( idx[0] = 0 ; idx[0] < numCells[0] ; ++ idx[0] )
+            {   // For each cell in bucket layer...
+                unsigned idxLeafBegin[3] , idxLeafEnd[3] , idxLeaf[3] ;
+                LeafRangeOfCell( idxLeafBegin , idxLeafEnd , idx , numCells , leavesPerCell , numLeafPoints ) ;
+                unsigned numInBucket = 0 ;
+                for( idxLeaf[2] = idxLeafBegin[2] ; idxLeaf[2] < idxLeafEnd[2] ; ++ idxLeaf[2] )
+                {
+                    for( idxLeaf[1] = idxLeafBegin[1] ; idxLeaf[1] < idxLeafEnd[1] ; ++ idxLeaf[1] )
+                    {
+                        for( idxLeaf[0] = idxLeafBegin[0] ; idxLeaf[0] < idxLeafEnd[0] ; ++ idxLeaf[0] )
+                        {   // For each leaf cell in this bucket...
+                            const unsigned leaf = idxLeaf[0] + numLeafPoints[0] * ( idxLeaf[1] + numLeafPoints[1] * idxLeaf[2] ) ;
+                            numInBucket += mVortonCells.GetCellEnd( leaf ) - mVortonCells.GetCellBegin( leaf ) ;
+                        }
+                    }
+                }
+                const unsigned offset = idx[0] + rBuckets.GetNumPoints( 0 ) * ( idx[1] + rBuckets.GetNumPoints( 1 ) * idx[2] ) ;
+                mLeafBucketBegin[ offset ] = ( numInBucket + numLanes - 1 ) / numLanes ;
+            }
+        }
+    }
+    // Convert counts to where each bucket begins.
+    unsigned numPackets = 0 ;
+    for( unsigned offset = 0 ; offset <= numBucketPoints ; ++ offset )
+    {
+        const unsigned count = mLeafBucketBegin[ offset ] ;
+        mLeafBucketBegin[ offset ] = numPackets ;
+        numPackets += count ;
+    }
+    mLeafBuckets.ResizeUninitialized( numPackets * sLeafBucketChannels * numLanes ) ;
+
+#if USE_TBB
+    // Estimate grain size based on size of problem and number of processors.
+    const size_t grainSize =  MAX2( 1 , numCells[2] / gNumberOfProcessors ) ;
+    // Gather buckets using multiple threads.
+    parallel_for( tbb::blocked_range<size_t>( 0 , numCells[2] , grainSize ) , VortonSim_GatherLeafBuckets_TBB( this ) ) ;
+#else
+    GatherLeafBucketsSlice( 0 , numCells[2] ) ;
+#endif
+}
+
+
+
+
+/*! \brief Accumulate velocity induced by each vorton in a leaf bucket
+
+    \param vVelocity - (in/out) velocity to which to add influence
+
+    \param vPosition - point in space at which to evaluate velocity
+
+    \param offset - offset of bucket cell within layer mLeafBucketLayer
+
+    This evaluates the same law as VORTON_ACCUMULATE_VELOCITY, for a whole
+    packet of vortons at once.  Unused lanes hold vortons without vorticity.
+
+    \see GatherLeafBuckets
+*/
+void VortonSim::AccumulateVelocityFromBucket( Vec3 & vVelocity , const Vec3 & vPosition , unsigned offset ) const
+{
+    const unsigned      numLanes    = FloatNative::NumLanes ;
+    const unsigned      iPacketEnd  = mLeafBucketBegin[ offset + 1 ] ;
+    const Vec3xNative   vPosQuery( vPosition ) ;
+    const FloatNative   avoidSingularity( sAvoidSingularity ) ;
+    Vec3xNative         velocityAccumulator( Vec3( 0.0f , 0.0f , 0.0f ) ) ;
+    for( unsigned iPacket = mLeafBucketBegin[ offset ] ; iPacket < iPacketEnd ; ++ iPacket )
+    {   // For each packet of vortons in this bucket...
+        const float *       pPacket         = & mLeafBuckets[ iPacket * sLeafBucketChannels * numLanes ] ;
+        const Vec3xNative   vPosVorton( FloatNative::Load( pPacket + 0 * numLanes ) , FloatNative::Load( pPacket + 1 * numLanes ) , FloatNative::Load( pPacket + 2 * numLanes ) ) ;
+        const Vec3xNative   vVorticity( FloatNative::Load( pPacket + 3 * numLanes ) , FloatNative::Load( pPacket + 4 * numLanes ) , FloatNative::Load( pPacket + 5 * numLanes ) ) ;
+        const FloatNative   radius2         = FloatNative::Load( pPacket + 6 * numLanes ) ;
+        const FloatNative   strength        = FloatNative::Load( pPacket + 7 * numLanes ) ;
+        const Vec3xNative   vNeighborToSelf = vPosQuery - vPosVorton ;
+        const FloatNative   dist2           = vNeighborToSelf.Mag2() + avoidSingularity ;
+        const FloatNative   oneOverDist     = finvsqrtf( dist2 ) ;
+        // Use linear law inside vortex core and reciprocal law outside it.  See VORTON_ACCUMULATE_VELOCITY.
+        const FloatNative   distLaw         = Select( dist2 < radius2 , oneOverDist / radius2 , oneOverDist / dist2 ) ;
+        velocityAccumulator += ( vVorticity ^ vNeighborToSelf ) * ( strength * distLaw ) ;
+    }
+    vVelocity += velocityAccumulator.HorizontalSum() ;
+}
+
+
+
+
+/*! \brief Accumulate influences between one vorton and a run of source packets, visiting each pair once
+
+    \param pSums - packets of velocity and Jacobian sums, laid out per sDirectSumChannels,
+        one per packet of pSources
+
+    \param pSources - packets of vortons, laid out like leaf buckets
+
+    \param iTarget - index of vorton whose influences with sources to accumulate
+
+    \param iPacketBegin - index of first source packet to visit
+
+    \param iPacketEnd - one past index of last source packet to visit
+
+    This adds the influence of each source on the target to the target's sums,
+    and the equal-and-opposite influence of the target on each source to that source's sums,
+    using the same law as VORTON_ACCUMULATE_VELOCITY.
+    Within the packet that contains the target, only sources after the target contribute,
+    so that the caller can visit each pair once by visiting, for each target,
+    only packets from the target's own packet onward.
+
+    The Jacobian of the velocity that vorton j induces at vorton i, with d = x_i - x_j,
+    strength c_j and distance law f(r) which equals 1/(r R^2) inside the core and 1/r^3 outside, has rows
+        c_j ( f (w_j ^ e_a) + (f'/r) (w_j ^ d) d.a )
+    where f'/r equals -f/r^2 inside the core and -3f/r^2 outside.
+    The same expression with i and j swapped gives the Jacobian at vorton j, since the sign of d cancels.
+*/
+template< bool bJacobian > static void AccumulateDirectPairs( float * pSums , const float * pSources , unsigned iTarget , size_t iPacketBegin , size_t iPacketEnd )
+{
+    const unsigned      numLanes        = FloatNative::NumLanes ;
+    const unsigned      iTargetPacket   = iTarget / numLanes ;
+    const unsigned      iTargetLane     = iTarget % numLanes ;
+    const float *       pTarget         = pSources + iTargetPacket * sLeafBucketChannels * numLanes + iTargetLane ;
+    const Vec3xNative   vPosTarget( Vec3( pTarget[ 0 * numLanes ] , pTarget[ 1 * numLanes ] , pTarget[ 2 * numLanes ] ) ) ;
+    const Vec3xNative   vVortTarget( Vec3( pTarget[ 3 * numLanes ] , pTarget[ 4 * numLanes ] , pTarget[ 5 * numLanes ] ) ) ;
+    const FloatNative   radius2Target( pTarget[ 6 * numLanes ] ) ;
+    const FloatNative   oneOverRadius2Target( 1.0f / pTarget[ 6 * numLanes ] ) ;
+    const FloatNative   strengthTarget( pTarget[ 7 * numLanes ] ) ;
+    const FloatNative   avoidSingularity( sAvoidSingularity ) ;
+    const FloatNative   zero( 0.0f ) ;
+    const FloatNative   one( 1.0f ) ;
+    const FloatNative   three( 3.0f ) ;
+    FloatNative         laneIndex ;
+    for( unsigned iLane = 0 ; iLane < numLanes ; ++ iLane )
+    {
+        laneIndex.SetLane( iLane , float( iLane ) ) ;
+    }
+    const Vec3          vZero( 0.0f , 0.0f , 0.0f ) ;
+    Vec3xNative         velTarget( vZero ) ;
+    Vec3xNative         jacTarget[3] = { Vec3xNative( vZero ) , Vec3xNative( vZero ) , Vec3xNative( vZero ) } ;
+    for( size_t iPacket = iPacketBegin ; iPacket < iPacketEnd ; ++ iPacket )
+    {   // For each packet of sources...
+        const float *       pPacket         = pSources + iPacket * sLeafBucketChannels * numLanes ;
+        float *             pPacketSums     = pSums + iPacket * sDirectSumChannels * numLanes ;
+        const Vec3xNative   vPosSource( FloatNative::Load( pPacket + 0 * numLanes ) , FloatNative::Load( pPacket + 1 * numLanes ) , FloatNative::Load( pPacket + 2 * numLanes ) ) ;
+        const Vec3xNative   vVortSource( FloatNative::Load( pPacket + 3 * numLanes ) , FloatNative::Load( pPacket + 4 * numLanes ) , FloatNative::Load( pPacket + 5 * numLanes ) ) ;
+        const FloatNative   radius2Source   = FloatNative::Load( pPacket + 6 * numLanes ) ;
+        const FloatNative   strengthSource  = FloatNative::Load( pPacket + 7 * numLanes ) ;
+        const Vec3xNative   vSourceToTarget = vPosTarget - vPosSource ;
+        const FloatNative   dist2           = vSourceToTarget.Mag2() + avoidSingularity ;
+        const FloatNative   oneOverDist     = finvsqrtf( dist2 ) ;
+        const FloatNative   oneOverDist2    = oneOverDist * oneOverDist ;
+        const FloatNative   oneOverDist3    = oneOverDist * oneOverDist2 ;
+        const FloatNative::Mask insideSource = dist2 < radius2Source ;
+        const FloatNative::Mask insideTarget = dist2 < radius2Target ;
+        // Use linear law inside vortex core and reciprocal law outside it.  See VORTON_ACCUMULATE_VELOCITY.
+        FloatNative         lawSource       = strengthSource * Select( insideSource , oneOverDist / radius2Source , oneOverDist3 ) ;
+        FloatNative         lawTarget       = strengthTarget * Select( insideTarget , oneOverDist * oneOverRadius2Target , oneOverDist3 ) ;
+        if( iPacket == iTargetPacket )
+        {   // Packet contains target, so omit the target itself and sources before it, whose pairs their own visits cover.
+            const FloatNative::Mask after = laneIndex > FloatNative( float( iTargetLane ) ) ;
+            lawSource = Select( after , lawSource , zero ) ;
+            lawTarget = Select( after , lawTarget , zero ) ;
+        }
+        const Vec3xNative   vSourceCross    = vVortSource ^ vSourceToTarget ;
+        const Vec3xNative   vTargetCross    = vVortTarget ^ vSourceToTarget ;
+        velTarget += vSourceCross * lawSource ;
+        Vec3xNative         velSource( FloatNative::Load( pPacketSums + 0 * numLanes ) , FloatNative::Load( pPacketSums + 1 * numLanes ) , FloatNative::Load( pPacketSums + 2 * numLanes ) ) ;
+        velSource -= vTargetCross * lawTarget ;
+        velSource.x.Store( pPacketSums + 0 * numLanes ) ;
+        velSource.y.Store( pPacketSums + 1 * numLanes ) ;
+        velSource.z.Store( pPacketSums + 2 * numLanes ) ;
+        if( bJacobian )
+        {
+            const Vec3xNative   vSourceGrad     = vSourceCross * ( - lawSource * oneOverDist2 * Select( insideSource , one , three ) ) ;
+            const Vec3xNative   vTargetGrad     = vTargetCross * ( - lawTarget * oneOverDist2 * Select( insideTarget , one , three ) ) ;
+            // Rows of the Jacobian of w ^ d with respect to d, i.e. w ^ e_x , w ^ e_y , w ^ e_z.
+            const Vec3xNative   wSourceCrossE[3] =  {   Vec3xNative( zero , vVortSource.z , - vVortSource.y )
+                                                    ,   Vec3xNative( - vVortSource.z , zero , vVortSource.x )
+                                                    ,   Vec3xNative( vVortSource.y , - vVortSource.x , zero ) } ;
+            const Vec3xNative   wTargetCrossE[3] =  {   Vec3xNative( zero , vVortTarget.z , - vVortTarget.y )
+                                                    ,   Vec3xNative( - vVortTarget.z , zero , vVortTarget.x )
+                                                    ,   Vec3xNative( vVortTarget.y , - vVortTarget.x , zero ) } ;
+            const FloatNative   dComponents[3]  = { vSourceToTarget.x , vSourceToTarget.y , vSourceToTarget.z } ;
+            for( unsigned iRow = 0 ; iRow < 3 ; ++ iRow )
+            {   // For each row of the Jacobian...
+                float *     pRowSums    = pPacketSums + ( 3 + 3 * iRow ) * numLanes ;
+                jacTarget[ iRow ] += wSourceCrossE[ iRow ] * lawSource + vSourceGrad * dComponents[ iRow ] ;
+                Vec3xNative jacSource( FloatNative::Load( pRowSums + 0 * numLanes ) , FloatNative::Load( pRowSums + 1 * numLanes ) , FloatNative::Load( pRowSums + 2 * numLanes ) ) ;
+                jacSource += wTargetCrossE[ iRow ] * lawTarget + vTargetGrad * dComponents[ iRow ] ;
+                jacSource.x.Store( pRowSums + 0 * numLanes ) ;
+                jacSource.y.Store( pRowSums + 1 * numLanes ) ;
+                jacSource.z.Store( pRowSums + 2 * numLanes ) ;
+            }
+        }
+    }
+    // Add target's sums to its own lane.
+    float *     pTargetSums = pSums + iTargetPacket * sDirectSumChannels * numLanes + iTargetLane ;
+    const Vec3  vVelTarget  = velTarget.HorizontalSum() ;
+    pTargetSums[ 0 * numLanes ] += vVelTarget.x ;
+    pTargetSums[ 1 * numLanes ] += vVelTarget.y ;
+    pTargetSums[ 2 * numLanes ] += vVelTarget.z ;
+    if( bJacobian )
+    {
+        for( unsigned iRow = 0 ; iRow < 3 ; ++ iRow )
+        {   // For each row of the Jacobian...
+            const Vec3 vRow = jacTarget[ iRow ].HorizontalSum() ;
+            pTargetSums[ ( 3 + 3 * iRow + 0 ) * numLanes ] += vRow.x ;
+            pTargetSums[ ( 3 + 3 * iRow + 1 ) * numLanes ] += vRow.y ;
+            pTargetSums[ ( 3 + 3 * iRow + 2 ) * numLanes ] += vRow.z ;
+        }
+    }
+}
+
+
+
+
+/*! \brief Sum influences between vortons directly, for a subset of chunks
+
+    \param icStart - index of first chunk to process
+
+    \param icEnd - one past index of last chunk to process
+
+    Each chunk accumulates into its own element of mDirectSums, so chunks
+    can run concurrently even though each pair contributes to both of its vortons.
+    Chunk c takes target tiles c, c + numChunks, c + 2 numChunks and so on,
+    and pairs each with itself and every later tile, so each pair of vortons
+    occurs in exactly one chunk.  Interleaving tiles this way gives each chunk
+    a similar mix of short and long rows of the triangle of tile pairs.
+
+    \see ComputeVelocityDirect
+*/
+void VortonSim::ComputeVelocityDirectChunks( size_t icStart , size_t icEnd )
+{
+    const unsigned  numLanes        = FloatNative::NumLanes ;
+    const size_t    numChunks       = mDirectSums.Size() ;
+    const size_t    numVortons      = mVortons.Size() ;
+    const size_t    numPackets      = ( numVortons + numLanes - 1 ) / numLanes ;
+    const size_t    packetsPerTile  = sDirectTileSize / numLanes ;
+    const size_t    numTiles        = ( numVortons + sDirectTileSize - 1 ) / sDirectTileSize ;
+    const float *   pSources        = & mDirectSources[ 0 ] ;
+
+    for( size_t iChunk = icStart ; iChunk < icEnd ; ++ iChunk )
+    {   // For each chunk...
+        AlignedVector< float > & rSums = mDirectSums[ iChunk ] ;
+        rSums.ResizeUninitialized( numPackets * sDirectSumChannels * numLanes ) ;
+        rSums.Fill( 0.0f ) ;
+        float * pSums = & rSums[ 0 ] ;
+        for( size_t iTileTarget = iChunk ; iTileTarget < numTiles ; iTileTarget += numChunks )
+        {   // For each tile of targets this chunk takes...
+            const size_t iTargetBegin   = iTileTarget * sDirectTileSize ;
+            const size_t iTargetEnd     = MIN2( iTargetBegin + sDirectTileSize , numVortons ) ;
+            for( size_t iTileSource = iTileTarget ; iTileSource < numTiles ; ++ iTileSource )
+            {   // For each tile of sources at or after the target tile...
+                const size_t iPacketBegin   = iTileSource * packetsPerTile ;
+                const size_t iPacketEnd     = MIN2( iPacketBegin + packetsPerTile , numPackets ) ;
+                for( size_t iTarget = iTargetBegin ; iTarget < iTargetEnd ; ++ iTarget )
+                {   // For each target in tile...
+                    // Within the target's own tile, sources before the target's packet paired with it when they were targets.
+                    const size_t iFirstPacket = ( iTileSource == iTileTarget ) ? ( iTarget / numLanes ) : iPacketBegin ;
+                    if( mDirectSummationJacobians )
+                    {
+                        AccumulateDirectPairs< true >( pSums , pSources , unsigned( iTarget ) , iFirstPacket , iPacketEnd ) ;
+                    }
+                    else
+                    {
+                        AccumulateDirectPairs< false >( pSums , pSources , unsigned( iTarget ) , iFirstPacket , iPacketEnd ) ;
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+
+
+/*! \brief Combine sums that each chunk of direct summation accumulated, for a subset of vortons
+
+    \param ivStart - index of first vorton to process
+
+    \param ivEnd - one past index of last vorton to process
+
+    \see ComputeVelocityDirect
+*/
+void VortonSim::ReduceVelocityDirectSlice( size_t ivStart , size_t ivEnd )
+{
+    const unsigned  numLanes    = FloatNative::NumLanes ;
+    const size_t    numChunks   = mDirectSums.Size() ;
+
+    for( size_t iVorton = ivStart ; iVorton < ivEnd ; ++ iVorton )
+    {   // For each vorton in this slice...
+        const size_t    iFirst  = ( iVorton / numLanes ) * sDirectSumChannels * numLanes + iVorton % numLanes ;
+        float           sums[ sDirectSumChannels ] = { 0.0f } ;
+        const unsigned  numSums = mDirectSummationJacobians ? sDirectSumChannels : 3 ;
+        for( size_t iChunk = 0 ; iChunk < numChunks ; ++ iChunk )
+        {   // For each chunk...
+            const float * pChunkSums = & mDirectSums[ iChunk ][ iFirst ] ;
+            for( unsigned iChannel = 0 ; iChannel < numSums ; ++ iChannel )
+            {
+                sums[ iChannel ] += pChunkSums[ iChannel * numLanes ] ;
+            }
+        }
+        mVortonVelocities[ iVorton ] = Vec3( sums[ 0 ] , sums[ 1 ] , sums[ 2 ] ) ;
+        if( mDirectSummationJacobians )
+        {
+            mVortonJacobians[ iVorton ] = Mat33( Vec3( sums[ 3 ] , sums[ 4 ] , sums[ 5 ] )
+                                               , Vec3( sums[ 6 ] , sums[ 7 ] , sums[ 8 ] )
+                                               , Vec3( sums[ 9 ] , sums[ 10 ] , sums[ 11 ] ) ) ;
+        }
+    }
+}
+
+
+
+
+/*! \brief Return whether ComputeVelocityDirect should sum velocity at vortons directly
+
+    Direct summation applies only when vortons exist, when they number no
+    more than mDirectSummationLimit, and when no filaments exist (since
+    direct summation visits only vortons).
+
+    \see SetDirectSummationLimit
+*/
+bool VortonSim::UsesDirectSummation( void ) const
+{
+    const size_t numVortons = mVortons.Size() ;
+    return ( numVortons > 0 ) && ( numVortons <= mDirectSummationLimit ) && ( 0 == mFilaments.Size() ) ;
+}
+
+
+
+
+/*! \brief Return whether direct summation supplies everything vortons need from the velocity field
+
+    Vortons then read neither the velocity grid nor fields derived from it:
+    direct summation supplies velocity and its Jacobian at every vorton, and
+    block time-stepping, whose sub-steps interpolate the velocity Jacobian grid,
+    is disabled.
+
+    \see UsesDirectSummation, NeedsVelocityGrid
+*/
+bool VortonSim::DirectSummationSuffices( void ) const
+{
+    return UsesDirectSummation() && mDirectSummationJacobians && ( 0 == mMaxTimeStepLevel ) ;
+}
+
+
+
+
+/*! \brief Return whether this update must build the influence tree and compute the velocity grid
+
+    The velocity grid is unnecessary only when direct summation suffices
+    for vortons, and no tracers or bodies need it.  Bodies request
+    velocity refinement regions, so their presence indicates bodies.
+
+    \see DirectSummationSuffices, CreateInfluenceTree, BeginVelocityGrid
+*/
+bool VortonSim::NeedsVelocityGrid( void ) const
+{
+    return ! DirectSummationSuffices() || ( mTracers.Size() > 0 ) || ( mVelRefinementRegions.Size() > 0 ) ;
+}
+
+
+
+
+/*! \brief Compute velocity, and optionally its Jacobian, at each vorton by summing the influence of every other vorton
+
+    This has time complexity O(N^2) but no approximation error, and no
+    per-query traversal or interpolation, so for small numbers of vortons
+    it is both more accurate and faster than interpolating velocity grids
+    that the influence tree populates.
+
+    Each pair of vortons is visited once, and contributes equal-and-opposite
+    influences to both of its vortons.  Vortons lie in packets, one per SIMD lane,
+    and pairs are visited tile by tile so that sources stay in L1 cache.
+
+    This populates mVortonVelocities, and mVortonJacobians when mDirectSummationJacobians is set,
+    when the number of vortons lies within mDirectSummationLimit and no filaments exist.
+    Otherwise it leaves them as ComputeVelocityGrid left them: populated by P3M,
+    or empty, in which case vortons use the velocity grids instead.
+
+    \see SetDirectSummationLimit, StretchAndTiltVortons, AdvectVortons
+*/
+void VortonSim::ComputeVelocityDirect( void )
+{
+    const ChunkedVector< Vorton > &    rVortons    = mVortons ;
+    const size_t numVortons = mVortons.Size() ;
+
+    if( ! UsesDirectSummation() )
+    {   // Direct summation does not apply.  Keep any velocities P3M computed.
+        mDirectSources.Clear() ;
+        mDirectSums.Clear() ;
+        return ;
+    }
+
+    // Copy vortons into packets.
+    const unsigned  numLanes    = FloatNative::NumLanes ;
+    const size_t    numPackets  = ( numVortons + numLanes - 1 ) / numLanes ;
+    mDirectSources.ResizeUninitialized( numPackets * sLeafBucketChannels * numLanes ) ;
+    for( size_t iVorton = 0 ; iVorton < numVortons ; ++ iVorton )
+    {   // For each vorton...
+        StoreVortonInPacket( & mDirectSources[ ( iVorton / numLanes ) * sLeafBucketChannels * numLanes ] , unsigned( iVorton % numLanes ) , rVortons[ iVorton ] ) ;
+    }
+    if( numVortons % numLanes != 0 )
+    {   // Last packet is partially full.
+        PadPacket( & mDirectSources[ ( numPackets - 1 ) * sLeafBucketChannels * numLanes ] , unsigned( numVortons % numLanes ) ) ;
+    }
+
+    mVortonVelocities.Resize( numVortons ) ;
+    if( mDirectSummationJacobians )
+    {
+        mVortonJacobians.Resize( numVortons ) ;
+    }
+
+#if USE_TBB
+    const size_t numTiles   = ( numVortons + sDirectTileSize - 1 ) / sDirectTileSize ;
+    const size_t numChunks  = MAX2( 1 , MIN2( gNumberOfProcessors , numTiles ) ) ;
+    mDirectSums.Resize( numChunks ) ;
+    // Sum influences using multiple threads, one chunk per task.
+    parallel_for( tbb::blocked_range<size_t>( 0 , numChunks , 1 ) , VortonSim_ComputeVelocityDirect_TBB( this ) ) ;
+    // Estimate grain size based on size of problem and number of processors.
+    const size_t grainSize =  MAX2( 1 , numVortons / gNumberOfProcessors ) ;
+    // Combine sums using multiple threads.
+    parallel_for( tbb::blocked_range<size_t>( 0 , numVortons , grainSize ) , VortonSim_ReduceVelocityDirect_TBB( this ) ) ;
+#else
+    mDirectSums.Resize( 1 ) ;
+    ComputeVelocityDirectChunks( 0 , 1 ) ;
+    ReduceVelocityDirectSlice( 0 , numVortons ) ;
+#endif
+}
+
+
+
+
+/*! \brief Compute velocity at a given point in space, due to influence of vortons
+
+    \param vPosition - point in space whose velocity to evaluate
+
+    \param indices - indices of cell to visit in the given layer
+
+    \param iLayer - which layer to process
+
+    \param iPackedLayerBegin - finest layer to read from mPackedTree instead of mInfluenceTree.
+        Pass mPackedLayerBegin to use whatever PackInfluenceTree populated,
+        or the depth of the tree to read only full-precision layers.
+
+    \return velocity at vPosition, due to influence of vortons
+
+    \note This is a recursive algorithm with time complexity O(log(N)). 
+            The outermost caller should pass in mInfluenceTree.GetDepth().
+
+    When leaf buckets exist, recursion stops at layer mLeafBucketLayer,
+    and each bucket there contributes the influence of each of its vortons.
+
+*/
+Vec3 VortonSim::ComputeVelocity( const Vec3 & vPosition , const unsigned indices[3] , size_t iLayer , size_t iPackedLayerBegin )
+{
+    UniformGrid< Vorton > & rChildLayer             = mInfluenceTree[ iLayer - 1 ] ;
+    const bool              bChildLayerPacked       = ( iLayer - 1 >= iPackedLayerBegin ) ;
+    unsigned                clusterMinIndices[3] ;
+    const unsigned *        pClusterDims             = mInfluenceTree.GetDecimations( iLayer ) ;
+    mInfluenceTree.GetChildClusterMinCornerIndex( clusterMinIndices , pClusterDims , indices ) ;
+
+    const Vec3 &            vGridMinCorner          = rChildLayer.GetMinCorner() ;
+    const Vec3              vSpacing                = rChildLayer.GetCellSpacing() ;
+    unsigned                increment[3]            ;
+    const unsigned &        numXchild               = rChildLayer.GetNumPoints( 0 ) ;
+    const unsigned          numXYchild              = numXchild * rChildLayer.GetNumPoints( 1 ) ;
+    Vec3                    velocityAccumulator( 0.0f , 0.0f , 0.0f ) ;
+
+    // When domain is 2D in XY plane, min.z==max.z so vPos.z test below would fail unless margin.z!=0.
+    const Vec3          margin          = sTreeMarginFactor * vSpacing + ( 0.0f == vSpacing.z ? Vec3(0,0,FLT_MIN) : Vec3(0,0,0) );
+
+    // For each cell of child layer in this grid cluster...
+    for( increment[2] = 0 ; increment[2] < pClusterDims[2] ; ++ increment[2] )
+    {
+        unsigned idxChild[3] ;
+        idxChild[2] = clusterMinIndices[2] + increment[2] ;
+        Vec3 vCellMinCorner , vCellMaxCorner ;
+        vCellMinCorner.z = vGridMinCorner.z + float( idxChild[2]     ) * vSpacing.z ;
+        vCellMaxCorner.z = vGridMinCorner.z + float( idxChild[2] + 1 ) * vSpacing.z ;
+        const unsigned offsetZ = idxChild[2] * numXYchild ;
+        for( increment[1] = 0 ; increment[1] < pClusterDims[1] ; ++ increment[1] )
+        {
+            idxChild[1] = clusterMinIndices[1] + increment[1] ;
+            vCellMinCorner.y = vGridMinCorner.y + float( idxChild[1]     ) * vSpacing.y ;
+            vCellMaxCorner.y = vGridMinCorner.y + float( idxChild[1] + 1 ) * vSpacing.y ;
+            const unsigned offsetYZ = idxChild[1] * numXchild + offsetZ ;
+            for( increment[0] = 0 ; increment[0] < pClusterDims[0] ; ++ increment[0] )
+            {
+                idxChild[0] = clusterMinIndices[0] + increment[0] ;
+                vCellMinCorner.x = vGridMinCorner.x + float( idxChild[0]     ) * vSpacing.x ;
+                vCellMaxCorner.x = vGridMinCorner.x + float( idxChild[0] + 1 ) * vSpacing.x ;
+                if(
+                        ( iLayer - 1 > mLeafBucketLayer )
+                    &&  ( vPosition.x >= vCellMinCorner.x - margin.x )
+                    &&  ( vPosition.y >= vCellMinCorner.y - margin.y )
+                    &&  ( vPosition.z >= vCellMinCorner.z - margin.z )
+                    &&  ( vPosition.x <  vCellMaxCorner.x + margin.x )
+                    &&  ( vPosition.y <  vCellMaxCorner.y + margin.y )
+                    &&  ( vPosition.z <  vCellMaxCorner.z + margin.z )
+                  )
+                {   // Test position is inside childCell and currentLayer > 0...
+                    // Recurse child layer.
+                    velocityAccumulator += ComputeVelocity( vPosition , idxChild , iLayer - 1 , iPackedLayerBegin ) ;
+                }
+                else if( iLayer - 1 == mLeafBucketLayer && mLeafBucketLayer > 0 )
+                {   // Reached leaf bucket.  Sum influence of each vorton it holds.
+                    AccumulateVelocityFromBucket( velocityAccumulator , vPosition , idxChild[0] + offsetYZ ) ;
+                }
+                else if( bChildLayerPacked )
+                {   // Test position is outside childCell, whose layer has a reduced-precision copy.
+                    //    Unpack cell, then accumulate its influence at full precision.
+                    const unsigned          offsetXYZ       = idxChild[0] + offsetYZ ;
+                    const PackedVorton &    rPackedChild    = mPackedTree[ iLayer - 1 ][ offsetXYZ ] ;
+                    const Float4            positionRadius  = Unpack( rPackedChild.mPositionRadius , mTreePrecision ) ;
+                    const Float4            vorticity       = Unpack( rPackedChild.mVorticity , mTreePrecision ) ;
+                    const Vec3              vPosChild       = vCellMinCorner + Vec3( positionRadius[0] , positionRadius[1] , positionRadius[2] ) ;
+                    const Vec3              vVortChild      = mPackedTreeScales[ iLayer - 1 ] * Vec3( vorticity[0] , vorticity[1] , vorticity[2] ) ;
+                    const float             radiusChild     = positionRadius[3] ;
+                    VORTON_ACCUMULATE_VELOCITY_private( velocityAccumulator , vPosition , vPosChild , vVortChild , radiusChild ) ;
+                }
+                else
+                {   // Test position is outside childCell, or reached leaf node.
+                    //    Compute velocity induced by cell at corner point x.
+                    //    Accumulate influence, storing in velocityAccumulator.
+                    const unsigned  offsetXYZ       = idxChild[0] + offsetYZ ;
+                    const Vorton &  rVortonChild    = rChildLayer[ offsetXYZ ] ;
+                    VORTON_ACCUMULATE_VELOCITY( velocityAccumulator , vPosition , rVortonChild ) ;
+                }
+            }
+        }
+    }
+
+    return velocityAccumulator ;
+}
+
+
+
+
+/*! \brief Compute velocity at a given point in space, due to influence of vortons
+
+    \param vPosition - point in space
+
+    \return velocity at vPosition, due to influence of vortons
+
+    \note This is a brute-force algorithm with time complexity O(N)
+            where N is the number of vortons.  This is too slow
+            for regular use but it is useful for comparisons.
+
+*/
+Vec3 VortonSim::ComputeVelocityBruteForce( const Vec3 & vPosition )
+{
+    const ChunkedVector< Vorton > &    rVortons    = mVortons ;
+    const size_t  numVortons          = mVortons.Size() ;
+    Vec3            velocityAccumulator( 0.0f , 0.0f , 0.0f ) ;
+
+    for( unsigned iVorton = 0 ; iVorton < numVortons ; ++ iVorton )
+    {   // For each vorton...
+        const Vorton &  rVorton = rVortons[ iVorton ] ;
+        VORTON_ACCUMULATE_VELOCITY( velocityAccumulator , vPosition , rVorton ) ;
+    }
+
+    const size_t numFilaments = mFilaments.Size() ;
+    for( unsigned iFilament = 0 ; iFilament < numFilaments ; ++ iFilament )
+    {   // For each vortex filament...
+        mFilaments[ iFilament ].AccumulateVelocity( velocityAccumulator , vPosition ) ;
+    }
+
+    return velocityAccumulator ;
+}
+
+
+
+
+/*! \brief Compute velocity at a given point in space, due to influence of vortons
+
+    \param vPosition - point in space.  It can lie outside the influence tree.
+
+    \return velocity at vPosition, due to influence of vortons
+
+    This uses whichever influence tree CreateInfluenceTree built.
+
+    \note This routine assumes CreateInfluenceTree has already executed.
+
+*/
+Vec3 VortonSim::ComputeVelocityFromVortons( const Vec3 & vPosition )
+{
+#if VELOCITY_FROM_TREE
+    const size_t numLevels = mInfluenceOctree.GetDepth() ;
+    if( numLevels > 0 )
+    {   // Influence tree is a linear octree.  Start at its root, which is the only cell in the top level.
+        return ComputeVelocityOctree( vPosition , numLevels - 1 , 0 ) ;
+    }
+    // Influence tree is a nested grid.
+    static const unsigned zeros[3] = { 0 , 0 , 0 } ; // Starter indices for recursive algorithm
+    return ComputeVelocity( vPosition , zeros , mInfluenceTree.GetDepth() - 1 , mPackedLayerBegin ) ;
+#else   // Slow accurate dirrect summation algorithm
+    return ComputeVelocityBruteForce( vPosition ) ;
+#endif
+}
+
+
+
+
+/*! \brief Find which clusters of the influence tree gridpoints within a box visit
+
+    \param rCut - (out) cut to which to append cells
+
+    \param vTileMinCorner, vTileMaxCorner - minimal and maximal gridpoints of tile
+
+    \param indices - indices of cell to visit in the given layer
+
+    \param iLayer - which layer to process
+
+    This mirrors ComputeVelocity, but applies its descent test to a whole
+    tile at once.  When every gridpoint in the tile would descend into
+    a cell, this descends into it too.  When no gridpoint would, the cell
+    is accepted.  Otherwise the cell is open, and each gridpoint makes
+    its own decision in ComputeVelocityFromCut.
+
+    \note The outermost caller should pass in mInfluenceTree.GetDepth()-1.
+
+*/
+void VortonSim::BuildTraversalCut( TraversalCut & rCut , const Vec3 & vTileMinCorner , const Vec3 & vTileMaxCorner , const unsigned indices[3] , size_t iLayer ) const
+{
+    const UniformGrid< Vorton > &   rChildLayer         = mInfluenceTree[ iLayer - 1 ] ;
+    unsigned                        clusterMinIndices[3] ;
+    const unsigned *                pClusterDims        = mInfluenceTree.GetDecimations( iLayer ) ;
+    mInfluenceTree.GetChildClusterMinCornerIndex( clusterMinIndices , pClusterDims , indices ) ;
+
+    const Vec3 &            vGridMinCorner  = rChildLayer.GetMinCorner() ;
+    const Vec3              vSpacing        = rChildLayer.GetCellSpacing() ;
+    // Use the same margin as ComputeVelocity, so decisions match.
+    const Vec3              margin          = sTreeMarginFactor * vSpacing + ( 0.0f == vSpacing.z ? Vec3(0,0,FLT_MIN) : Vec3(0,0,0) );
+    TreeCell                child ;
+    child.mLayer = unsigned( iLayer - 1 ) ;
+
+    unsigned increment[3] ;
+    for( increment[2] = 0 ; increment[2] < pClusterDims[2] ; ++ increment[2] )
+    {
+        child.mIndices[2] = clusterMinIndices[2] + increment[2] ;
+        for( increment[1] = 0 ; increment[1] < pClusterDims[1] ; ++ increment[1] )
+        {
+            child.mIndices[1] = clusterMinIndices[1] + increment[1] ;
+            for( increment[0] = 0 ; increment[0] < pClusterDims[0] ; ++ increment[0] )
+            {   // For each cell of child layer in this grid cluster...
+                child.mIndices[0] = clusterMinIndices[0] + increment[0] ;
+                if( iLayer - 1 <= mLeafBucketLayer )
+                {   // Child is a leaf or leaf bucket, which every gridpoint accumulates.
+                    rCut.mAccepted.PushBack( child ) ;
+                    continue ;
+                }
+                Vec3 vCellMinCorner , vCellMaxCorner ;
+                vCellMinCorner.x = vGridMinCorner.x + float( child.mIndices[0]     ) * vSpacing.x ;
+                vCellMinCorner.y = vGridMinCorner.y + float( child.mIndices[1]     ) * vSpacing.y ;
+                vCellMinCorner.z = vGridMinCorner.z + float( child.mIndices[2]     ) * vSpacing.z ;
+                vCellMaxCorner.x = vGridMinCorner.x + float( child.mIndices[0] + 1 ) * vSpacing.x ;
+                vCellMaxCorner.y = vGridMinCorner.y + float( child.mIndices[1] + 1 ) * vSpacing.y ;
+                vCellMaxCorner.z = vGridMinCorner.z + float( child.mIndices[2] + 1 ) * vSpacing.z ;
+                const Vec3 vLower = vCellMinCorner - margin ;
+                const Vec3 vUpper = vCellMaxCorner + margin ;
+                if(     ( vTileMinCorner.x >= vLower.x ) && ( vTileMinCorner.y >= vLower.y ) && ( vTileMinCorner.z >= vLower.z )
+                    &&  ( vTileMaxCorner.x <  vUpper.x ) && ( vTileMaxCorner.y <  vUpper.y ) && ( vTileMaxCorner.z <  vUpper.z ) )
+                {   // Every gridpoint in tile lies inside child cell, so every one descends into it.
+                    BuildTraversalCut( rCut , vTileMinCorner , vTileMaxCorner , child.mIndices , iLayer - 1 ) ;
+                }
+                else if(    ( vTileMaxCorner.x >= vLower.x ) && ( vTileMaxCorner.y >= vLower.y ) && ( vTileMaxCorner.z >= vLower.z )
+                        &&  ( vTileMinCorner.x <  vUpper.x ) && ( vTileMinCorner.y <  vUpper.y ) && ( vTileMinCorner.z <  vUpper.z ) )
+                {   // Tile straddles child cell, so each gridpoint must decide.
+                    rCut.mOpen.PushBack( child ) ;
+                }
+                else
+                {   // Every gridpoint in tile lies outside child cell, so every one accumulates its aggregate influence.
+                    rCut.mAccepted.PushBack( child ) ;
+                }
+            }
+        }
+    }
+}
+
+
+
+
+/*! \brief Find which clusters of the influence tree a subset of tiles of the velocity grid visit
+
+    \param iTileStart - index of first tile to process
+
+    \param iTileEnd - index of last tile to process, plus one
+
+    \see BuildTraversalCuts
+
+*/
+void VortonSim::BuildTraversalCutsSlice( size_t iTileStart , size_t iTileEnd )
+{
+    static const unsigned zeros[3] = { 0 , 0 , 0 } ; // Starter indices for recursive algorithm
+    // Compute gridpoint positions exactly as ComputeVelocityGridTiles does.
+    const Vec3 &        vMinCorner  = mVelGrid.GetMinCorner() ;
+    static const float  nudge       = 1.0f - 2.0f * FLT_EPSILON ;
+    const Vec3          vSpacing    = mVelGrid.GetCellSpacing() * nudge ;
+    const unsigned      dims[3]     =   { mVelGrid.GetNumPoints( 0 )
+                                        , mVelGrid.GetNumPoints( 1 )
+                                        , mVelGrid.GetNumPoints( 2 ) } ;
+    const size_t        numLayers   = mInfluenceTree.GetDepth() ;
+    for( size_t iTile = iTileStart ; iTile < iTileEnd ; ++ iTile )
+    {   // For each tile in this subset...
+        unsigned idxMin[3] , idxEnd[3] ;
+        VelocityTileBounds( idxMin , idxEnd , iTile , mNumVelocityTiles , dims ) ;
+        const Vec3 vTileMinCorner( vMinCorner.x + float( idxMin[0] ) * vSpacing.x
+                                 , vMinCorner.y + float( idxMin[1] ) * vSpacing.y
+                                 , vMinCorner.z + float( idxMin[2] ) * vSpacing.z ) ;
+        const Vec3 vTileMaxCorner( vMinCorner.x + float( idxEnd[0] - 1 ) * vSpacing.x
+                                 , vMinCorner.y + float( idxEnd[1] - 1 ) * vSpacing.y
+                                 , vMinCorner.z + float( idxEnd[2] - 1 ) * vSpacing.z ) ;
+        TraversalCut & rCut = mTraversalCuts[ iTile ] ;
+        rCut.mAccepted.Clear() ;
+        rCut.mOpen.Clear() ;
+        BuildTraversalCut( rCut , vTileMinCorner , vTileMaxCorner , zeros , numLayers - 1 ) ;
+    }
+}
+
+
+
+
+/*! \brief Find which clusters of the influence tree each tile of the velocity grid visits
+
+    This traverses the influence tree once per tile of the velocity grid,
+    instead of once per gridpoint.  The result remains valid until the geometry of the tree
+    changes, which only CreateInfluenceTree does, and it empties
+    mTraversalCuts when it does.
+
+    \see ComputeVelocityFromCut, SetTraversalCutCaching
+
+    \note This routine assumes CreateInfluenceTree has already executed,
+            built a nested grid, and that UpdateVelocityTiles has already executed.
+
+*/
+void VortonSim::BuildTraversalCuts( void )
+{
+    const size_t numTiles = mVelocityTileOrder.Size() ;
+    mTraversalCuts.Resize( numTiles ) ;
+
+#if USE_TBB
+    // Estimate grain size based on size of problem and number of processors.
+    const size_t grainSize =  MAX2( 1 , numTiles / gNumberOfProcessors ) ;
+    // Build cuts using multiple threads.
+    parallel_for( tbb::blocked_range<size_t>( 0 , numTiles , grainSize ) , VortonSim_BuildTraversalCuts_TBB( this ) ) ;
+#else
+    BuildTraversalCutsSlice( 0 , numTiles ) ;
+#endif
+}
+
+
+
+
+/*! \brief Accumulate velocity induced by the aggregate vorton of one cell of the influence tree
+
+    \param vVelocity - (in/out) velocity to which to add influence
+
+    \param vPosition - point in space at which to evaluate velocity
+
+    \param cell - cell whose influence to accumulate.  It reads from
+        mPackedTree if PackInfluenceTree packed the cell's layer,
+        and from mLeafBuckets if the cell is a leaf bucket.
+
+    \see ComputeVelocity
+*/
+void VortonSim::AccumulateVelocityFromCell( Vec3 & vVelocity , const Vec3 & vPosition , const TreeCell & cell ) const
+{
+    const UniformGrid< Vorton > &   rLayer      = mInfluenceTree[ cell.mLayer ] ;
+    const unsigned                  offsetXYZ   = cell.mIndices[0] + rLayer.GetNumPoints( 0 ) * ( cell.mIndices[1] + rLayer.GetNumPoints( 1 ) * cell.mIndices[2] ) ;
+    if( ( cell.mLayer == mLeafBucketLayer ) && ( mLeafBucketLayer > 0 ) )
+    {   // Cell is a leaf bucket.  Sum influence of each vorton it holds.
+        AccumulateVelocityFromBucket( vVelocity , vPosition , offsetXYZ ) ;
+    }
+    else if( cell.mLayer >= mPackedLayerBegin )
+    {   // Layer has a reduced-precision copy.  Unpack cell, then accumulate its influence at full precision.
+        const Vec3 &            vGridMinCorner  = rLayer.GetMinCorner() ;
+        const Vec3              vSpacing        = rLayer.GetCellSpacing() ;
+        const Vec3              vCellMinCorner( vGridMinCorner.x + float( cell.mIndices[0] ) * vSpacing.x
+                                              , vGridMinCorner.y + float( cell.mIndices[1] ) * vSpacing.y
+                                              , vGridMinCorner.z + float( cell.mIndices[2] ) * vSpacing.z ) ;
+        const PackedVorton &    rPacked         = mPackedTree[ cell.mLayer ][ offsetXYZ ] ;
+        const Float4            positionRadius  = Unpack( rPacked.mPositionRadius , mTreePrecision ) ;
+        const Float4            vorticity       = Unpack( rPacked.mVorticity , mTreePrecision ) ;
+        const Vec3              vPosCell        = vCellMinCorner + Vec3( positionRadius[0] , positionRadius[1] , positionRadius[2] ) ;
+        const Vec3              vVortCell       = mPackedTreeScales[ cell.mLayer ] * Vec3( vorticity[0] , vorticity[1] , vorticity[2] ) ;
+        const float             radiusCell      = positionRadius[3] ;
+        VORTON_ACCUMULATE_VELOCITY_private( vVelocity , vPosition , vPosCell , vVortCell , radiusCell ) ;
+    }
+    else
+    {
+        const Vorton & rVorton = rLayer[ offsetXYZ ] ;
+        VORTON_ACCUMULATE_VELOCITY( vVelocity , vPosition , rVorton ) ;
+    }
+}
+
+
+
+
+/*! \brief Compute velocity at a given point in space, starting from a cached traversal cut
+
+    \param vPosition - point in space, which must lie within the tile for which cut was built
+
+    \param cut - clusters that every gridpoint in the tile visits
+
+    \return velocity at vPosition, due to influence of vortons
+
+    This visits the same clusters ComputeVelocity would, but only has to
+    decide whether to descend into open cells.
+
+    \see BuildTraversalCuts
+*/
+Vec3 VortonSim::ComputeVelocityFromCut( const Vec3 & vPosition , const TraversalCut & cut )
+{
+    Vec3 velocityAccumulator( 0.0f , 0.0f , 0.0f ) ;
+
+    const size_t numAccepted = cut.mAccepted.Size() ;
+    for( size_t iCell = 0 ; iCell < numAccepted ; ++ iCell )
+    {   // For each cell that every gridpoint in the tile accepts...
+        AccumulateVelocityFromCell( velocityAccumulator , vPosition , cut.mAccepted[ iCell ] ) ;
+    }
+
+    const size_t numOpen = cut.mOpen.Size() ;
+    for( size_t iCell = 0 ; iCell < numOpen ; ++ iCell )
+    {   // For each cell that the tile straddles...
+        const TreeCell &                rCell           = cut.mOpen[ iCell ] ;
+        const UniformGrid< Vorton > &   rLayer          = mInfluenceTree[ rCell.mLayer ] ;
+        const Vec3 &                    vGridMinCorner  = rLayer.GetMinCorner() ;
+        const Vec3                      vSpacing        = rLayer.GetCellSpacing() ;
+        const Vec3                      margin          = sTreeMarginFactor * vSpacing + ( 0.0f == vSpacing.z ? Vec3(0,0,FLT_MIN) : Vec3(0,0,0) );
+        Vec3 vCellMinCorner , vCellMaxCorner ;
+        vCellMinCorner.x = vGridMinCorner.x + float( rCell.mIndices[0]     ) * vSpacing.x ;
+        vCellMinCorner.y = vGridMinCorner.y + float( rCell.mIndices[1]     ) * vSpacing.y ;
+        vCellMinCorner.z = vGridMinCorner.z + float( rCell.mIndices[2]     ) * vSpacing.z ;
+        vCellMaxCorner.x = vGridMinCorner.x + float( rCell.mIndices[0] + 1 ) * vSpacing.x ;
+        vCellMaxCorner.y = vGridMinCorner.y + float( rCell.mIndices[1] + 1 ) * vSpacing.y ;
+        vCellMaxCorner.z = vGridMinCorner.z + float( rCell.mIndices[2] + 1 ) * vSpacing.z ;
+        if(
+                ( vPosition.x >= vCellMinCorner.x - margin.x )
+            &&  ( vPosition.y >= vCellMinCorner.y - margin.y )
+            &&  ( vPosition.z >= vCellMinCorner.z - margin.z )
+            &&  ( vPosition.x <  vCellMaxCorner.x + margin.x )
+            &&  ( vPosition.y <  vCellMaxCorner.y + margin.y )
+            &&  ( vPosition.z <  vCellMaxCorner.z + margin.z )
+          )
+        {   // Position is inside cell.  Descend into it.
+            velocityAccumulator += ComputeVelocity( vPosition , rCell.mIndices , rCell.mLayer , mPackedLayerBegin ) ;
+        }
+        else
+        {   // Position is outside cell.  Accumulate its aggregate influence.
+            AccumulateVelocityFromCell( velocityAccumulator , vPosition , rCell ) ;
+        }
+    }
+
+    return velocityAccumulator ;
+}
+
+
+
+
+/*! \brief Divide the velocity grid into tiles, and order them along a Hilbert curve
+
+    Consecutive tiles along the curve lie next to each other, so queries
+    that run close together in time visit nearly the same clusters of the
+    influence tree, which therefore tend to remain in cache.  Giving each
+    thread a contiguous range of the curve also gives it a compact region,
+    so threads contend less for the same clusters.
+
+    This only recomputes the order when the shape of the velocity grid changes.
+
+    \see ComputeVelocityGridTiles, HilbertKey
+
+*/
+void VortonSim::UpdateVelocityTiles( void )
+{
+    unsigned numTiles[3] ;
+    unsigned maxNumTiles = 1 ;
+    for( unsigned i = 0 ; i < 3 ; ++ i )
+    {
+        numTiles[ i ] = ( mVelGrid.GetNumPoints( i ) + sVelocityTileSize - 1 ) / sVelocityTileSize ;
+        maxNumTiles = MAX2( maxNumTiles , numTiles[ i ] ) ;
+    }
+    const size_t numTilesTotal = size_t( numTiles[0] ) * numTiles[1] * numTiles[2] ;
+    if(     ( numTiles[0] == mNumVelocityTiles[0] ) && ( numTiles[1] == mNumVelocityTiles[1] ) && ( numTiles[2] == mNumVelocityTiles[2] )
+        &&  ( mVelocityTileOrder.Size() == numTilesTotal ) )
+    {   // Grid has the same shape as before, so the same order still applies.
+        return ;
+    }
+    mNumVelocityTiles[0] = numTiles[0] ;
+    mNumVelocityTiles[1] = numTiles[1] ;
+    mNumVelocityTiles[2] = numTiles[2] ;
+    mTraversalCuts.Clear() ;    // Cuts belong to tiles of the old grid.
+
+    // Find how many bits the Hilbert curve needs, to span the longest axis.
+    unsigned numBits = 1 ;
+    while( ( 1u << numBits ) < maxNumTiles )
+    {
+        ++ numBits ;
+    }
+
+    mVelocityTileOrder.Resize( numTilesTotal ) ;
+    if( numBits > MORTON_BITS_PER_AXIS )
+    {   // Grid is too large for 32-bit keys, so keep tiles in x-fastest order.
+        for( unsigned iTile = 0 ; iTile < numTilesTotal ; ++ iTile )
+        {
+            mVelocityTileOrder[ iTile ] = iTile ;
+        }
+        return ;
+    }
+
+    Vector< VelocityTileKey > tileKeys ;
+    tileKeys.Resize( numTilesTotal ) ;
+    unsigned idx[3] ;
+    unsigned iTile = 0 ;
+    for( idx[2] = 0 ; idx[2] < numTiles[2] ; ++ idx[2] )
+    {
+        for( idx[1] = 0 ; idx[1] < numTiles[1] ; ++ idx[1] )
+        {
+            for( idx[0] = 0 ; idx[0] < numTiles[0] ; ++ idx[0] , ++ iTile )
+            {   // For each tile...
+                tileKeys[ iTile ].mKey  = HilbertKey( idx , numBits ) ;
+                tileKeys[ iTile ].mTile = iTile ;
+            }
+        }
+    }
+    sort( tileKeys.Begin() , tileKeys.End() ) ;
+    for( iTile = 0 ; iTile < numTilesTotal ; ++ iTile )
+    {
+        mVelocityTileOrder[ iTile ] = tileKeys[ iTile ].mTile ;
+    }
+}
+
+
+
+
+/*! \brief Compute velocity due to vortons, for a subset of tiles of the velocity grid
+
+    \param iOrderStart - index, into mVelocityTileOrder, of first tile to process
+
+    \param iOrderEnd - index, into mVelocityTileOrder, of last tile to process, plus one
+
+    \see CreateInfluenceTree, ComputeVelocityGrid, UpdateVelocityTiles
+
+    \note This routine assumes CreateInfluenceTree has already executed,
+            that the velocity grid has been allocated, and that
+            UpdateVelocityTiles has already executed.
+
+*/
+void VortonSim::ComputeVelocityGridTiles( size_t iOrderStart , size_t iOrderEnd )
+{
+    const Vec3 &        vMinCorner  = mVelGrid.GetMinCorner() ;
+    static const float  nudge       = 1.0f - 2.0f * FLT_EPSILON ;
+    const Vec3          vSpacing    = mVelGrid.GetCellSpacing() * nudge ;
+    const unsigned      dims[3]     =   { mVelGrid.GetNumPoints( 0 )
+                                        , mVelGrid.GetNumPoints( 1 )
+                                        , mVelGrid.GetNumPoints( 2 ) } ;
+    const unsigned      numXY       = dims[0] * dims[1] ;
+    const bool          bPack       = mPackedVelGrid.Size() > 0 ;
+    const bool          bUseCuts    = mTraversalCuts.Size() > 0 ;
+    for( size_t iOrder = iOrderStart ; iOrder < iOrderEnd ; ++ iOrder )
+    {   // For each tile in this subset, in Hilbert order...
+        const unsigned iTile = mVelocityTileOrder[ iOrder ] ;
+        unsigned idxMin[3] , idxEnd[3] ;
+        VelocityTileBounds( idxMin , idxEnd , iTile , mNumVelocityTiles , dims ) ;
+        unsigned idx[ 3 ] ;
+        for( idx[2] = idxMin[2] ; idx[2] < idxEnd[2] ; ++ idx[2] )
+        {   // For every gridpoint in this tile along the z-axis...
+            Vec3 vPosition ;
+            // Compute the z-coordinate of the world-space position of this gridpoint.
+            vPosition.z = vMinCorner.z + float( idx[2] ) * vSpacing.z ;
+            // Precompute the z contribution to the offset into the velocity grid.
+            const unsigned offsetZ = idx[2] * numXY ;
+            for( idx[1] = idxMin[1] ; idx[1] < idxEnd[1] ; ++ idx[1] )
+            {   // For every gridpoint in this tile along the y-axis...
+                // Compute the y-coordinate of the world-space position of this gridpoint.
+                vPosition.y = vMinCorner.y + float( idx[1] ) * vSpacing.y ;
+                // Precompute the y contribution to the offset into the velocity grid.
+                const unsigned offsetYZ = idx[1] * dims[0] + offsetZ ;
+                for( idx[0] = idxMin[0] ; idx[0] < idxEnd[0] ; ++ idx[0] )
+                {   // For every gridpoint in this tile along the x-axis...
+                    // Compute the x-coordinate of the world-space position of this gridpoint.
+                    vPosition.x = vMinCorner.x + float( idx[0] ) * vSpacing.x ;
+                    // Compute the offset into the velocity grid.
+                    const unsigned offsetXYZ = idx[0] + offsetYZ ;
+
+                    // Compute the fluid flow velocity at this gridpoint, due to all vortons.
+                    if( bUseCuts )
+                    {   // Start from clusters that this tile visits.
+                        mVelGrid[ offsetXYZ ] = ComputeVelocityFromCut( vPosition , mTraversalCuts[ iTile ] ) ;
+                    }
+                    else
+                    {
+                        mVelGrid[ offsetXYZ ] = ComputeVelocityFromVortons( vPosition ) ;
+                    }
+                    if( bPack )
+                    {   // Tracers read velocity at reduced precision.
+                        const Vec3 & rVelocity = mVelGrid[ offsetXYZ ] ;
+                        Pack( mPackedVelGrid[ offsetXYZ ] , rVelocity.x , rVelocity.y , rVelocity.z , 0.0f , mVelGridPrecision ) ;
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+
+
+/*! \brief Compute velocity due to vortons, for every point in a uniform grid
+
+    \see CreateInfluenceTree
+
+    \note This routine assumes CreateInfluenceTree has already executed.
+
+*/
+void VortonSim::ComputeVelocityGrid( void )
+{
+    if( BeginVelocityGrid() )
+    {   // Tiles remain to compute.
+        ComputeVelocityGridBatch( 0 , mVelocityTileOrder.Size() ) ;
+    }
+}
+
+
+
+
+/*! \brief Prepare to compute the velocity grid, and compute it entirely if P3M applies
+
+    \return whether ComputeVelocityGridBatch must still compute velocity at tiles in mVelocityTileOrder.
+
+    When CreateInfluenceTree found this update needs no velocity grid, this
+    gives mVelGrid its shape, which still describes the domain, but no contents.
+
+    \see ComputeVelocityGrid, NeedsVelocityGrid
+*/
+bool VortonSim::BeginVelocityGrid( void )
+{
+    // Measure how far vortons moved since they were indexed, while the old velocity grid still exists.
+    const float maxDisplacement = ( VELOCITY_SOLVER_P3M == mVelocitySolver ) ? ComputeMaxDisplacementSinceIndex() : 0.0f ;
+
+    InvalidateDerivedFields() ;                         // Fields derived from the old velocity grid are now stale.
+    mVortonVelocities.Clear() ;                         // Velocities at vortons are stale.  P3M or direct summation might repopulate them.
+    mVortonJacobians.Clear() ;
+    const Vec3 vSpacingPrev = mVelGrid.GetCellSpacing() ;
+    // When direct summation suffices for vortons, only tracers and bodies read the velocity grid, so a coarser one serves.
+    const unsigned decimation = DirectSummationSuffices() ? MAX2( mVelGridDecimation , sDirectSummationVelGridDecimation ) : mVelGridDecimation ;
+    mVelGrid.Clear() ;                                  // Clear any stale velocity information
+    mVelGrid.Decimate( mGridGeometry , decimation ) ;   // Use same shape as base vorticity grid, or a coarser one.
+    if( mVelGrid.GetCellSpacing() != vSpacingPrev )
+    {   // Decimation changed while the tree was refit, so cached cuts belong to tiles of another shape.
+        mTraversalCuts.Clear() ;
+    }
+    mPackedVelGrid.Clear() ;
+    if( ! mVelGridRequired )
+    {   // Nothing reads velocity grid this update.
+        mVelPatches.Clear() ;
+        mFarVelGrid.Clear() ;
+        return false ;
+    }
+    mVelGrid.Init() ;                                   // Reserve memory for velocity grid.  ComputeVelocityGridTiles overwrites every point.
+    if( mVelGridPrecision != STORAGE_FLOAT32 )
+    {   // Also store velocity at reduced precision.
+        mPackedVelGrid.CopyShape( mVelGrid ) ;
+        mPackedVelGrid.InitUninitialized() ;
+    }
+
+    if( UsesP3M() )
+    {   // Mesh, rather than influence tree, provides the velocity grid.
+        ComputeVelocityP3M( maxDisplacement ) ;
+        return false ;
+    }
+
+    UpdateVelocityTiles() ;
+
+    if( ! mCacheTraversalCuts || ! VELOCITY_FROM_TREE || ( mInfluenceTree.GetDepth() < 2 ) )
+    {   // Traverse from the root for every gridpoint.
+        mTraversalCuts.Clear() ;
+    }
+    else if( mTraversalCuts.Size() != mVelocityTileOrder.Size() )
+    {   // Tree or velocity grid geometry changed since cuts were last built, or they never were.
+        QUERY_PERFORMANCE_ENTER ;
+        BuildTraversalCuts() ;
+        QUERY_PERFORMANCE_EXIT( VortonSim_BuildTraversalCuts ) ;
+    }
+    return true ;
+}
+
+
+
+
+/*! \brief Compute velocity grid at a contiguous range of tiles along the Hilbert curve
+
+    \param iOrderBegin - index into mVelocityTileOrder of first tile to compute
+
+    \param iOrderEnd - index into mVelocityTileOrder of one past last tile to compute
+
+    \note This routine assumes BeginVelocityGrid has already executed and returned true.
+
+*/
+void VortonSim::ComputeVelocityGridBatch( size_t iOrderBegin , size_t iOrderEnd )
+{
+#if USE_TBB
+    // Estimate grain size based on size of problem and number of processors.
+    const size_t grainSize =  MAX2( 1 , ( iOrderEnd - iOrderBegin ) / gNumberOfProcessors ) ;
+    // Compute velocity grid using multiple threads, each taking a contiguous range of the Hilbert curve.
+    parallel_for( tbb::blocked_range<size_t>( iOrderBegin , iOrderEnd , grainSize ) , VortonSim_ComputeVelocityGrid_TBB( this ) ) ;
+#else
+    ComputeVelocityGridTiles( iOrderBegin , iOrderEnd ) ;
+#endif
+}
+
+
+
+/*! \brief Return whether ComputeVelocityGrid should use P3M
+
+    P3M applies only when requested, when vortons exist, when no filaments exist
+    (since filaments have no representation on the mesh) and when the
+    velocity grid spans a volume along every axis.
+
+    \see SetVelocitySolver
+*/
+bool VortonSim::UsesP3M( void ) const
+{
+    return  ( VELOCITY_SOLVER_P3M == mVelocitySolver )
+        &&  ( mVortons.Size() > 0 ) && ( 0 == mFilaments.Size() )
+        &&  ( mVelGrid.GetNumCells( 0 ) > 0 ) && ( mVelGrid.GetNumCells( 1 ) > 0 ) && ( mVelGrid.GetNumCells( 2 ) > 0 ) ;
+}
+
+
+
+
+/*! \brief Define the levels of the P3M mesh, and zero the vector potential and right-hand side on each
+
+    The finest level has the spacing of mVelGrid, and every gridpoint of
+    mVelGrid coincides with a gridpoint of the mesh.  The mesh extends
+    beyond mVelGrid by the blob radius plus sP3MMarginCells, so the blob of
+    every vorton lies well inside the mesh.  Each axis has a number of cells
+    divisible by 2^(L-1), where L is the number of levels, so each
+    coarser level has half as many cells along each axis, down to a
+    coarsest level with 2 or 3 cells along its shortest axis.
+
+    \note This routine assumes mVelGrid has its shape for this update.
+
+*/
+void VortonSim::DefineP3MMesh( void )
+{
+    const Vec3 &    vSpacing    = mVelGrid.GetCellSpacing() ;
+    const float     spacing[3]  = { vSpacing.x , vSpacing.y , vSpacing.z } ;
+    mP3MRadius = mP3MSmoothing * MAX2( MAX2( vSpacing.x , vSpacing.y ) , vSpacing.z ) ;
+
+    unsigned numCells[3] ;
+    for( unsigned axis = 0 ; axis < 3 ; ++ axis )
+    {   // For each axis, add margin on both sides of velocity grid.
+        mP3MMargin[ axis ]  = unsigned( ceilf( mP3MRadius / spacing[ axis ] ) ) + sP3MMarginCells ;
+        numCells[ axis ]    = mVelGrid.GetNumCells( axis ) + 2 * mP3MMargin[ axis ] ;
+    }
+    const unsigned minNumCells = MIN2( MIN2( numCells[0] , numCells[1] ) , numCells[2] ) ;
+
+    // Coarsen until the coarsest level has fewer than 4 cells along its shortest axis.
+    unsigned numLevels = 1 ;
+    while( ( 2u << numLevels ) <= minNumCells )
+    {
+        ++ numLevels ;
+    }
+    const unsigned coarsening = 1u << ( numLevels - 1 ) ;
+    for( unsigned axis = 0 ; axis < 3 ; ++ axis )
+    {   // For each axis, round up number of cells so each level halves it exactly.  Extra cells go on the high side.
+        numCells[ axis ] = ( numCells[ axis ] + coarsening - 1 ) / coarsening * coarsening ;
+    }
+
+    UniformGridGeometry mesh ;
+    mesh.Expand( mVelGrid , mP3MMargin , numCells ) ;
+
+    mP3MStreamFunction.Resize( numLevels ) ;
+    mP3MRhs.Resize( numLevels ) ;
+    mP3MResidual.Resize( numLevels ) ;
+    for( unsigned iLevel = 0 ; iLevel < numLevels ; ++ iLevel )
+    {   // For each level of the mesh...
+        mP3MStreamFunction[ iLevel ].Decimate( mesh , 1 << iLevel ) ;
+        mP3MStreamFunction[ iLevel ].Init( Vec3( 0.0f , 0.0f , 0.0f ) ) ;
+        mP3MRhs[ iLevel ].Decimate( mesh , 1 << iLevel ) ;
+        mP3MRhs[ iLevel ].Init( Vec3( 0.0f , 0.0f , 0.0f ) ) ;
+        mP3MResidual[ iLevel ].Decimate( mesh , 1 << iLevel ) ;
+        mP3MResidual[ iLevel ].Init() ;                // P3M_RESIDUAL overwrites every point.
+    }
+}
+
+
+
+
+/*! \brief Spread the vorticity of each vorton onto the finest P3M mesh, as the right-hand side of a Poisson equation
+
+    Each vorton spreads its strength, 8 r^3 w for radius r and vorticity w,
+    over gridpoints within the blob radius a, weighted by (1-|x|^2/a^2)^2
+    normalized to sum to 1.  Dividing by cell volume converts strength to
+    vorticity, and the vector potential satisfies Laplacian(psi) = -vorticity,
+    so this accumulates negative vorticity.
+
+    \see ComputeP3MNearVelocity, which uses the velocity law of the continuous blob with the same profile.
+*/
+void VortonSim::SplatP3MVorticity( void )
+{
+    const ChunkedVector< Vorton > &    rVortons    = mVortons ;
+    UniformGrid< Vec3 > &   rRhs                    = mP3MRhs[ 0 ] ;
+    const Vec3 &            vMinCorner              = rRhs.GetMinCorner() ;
+    const Vec3 &            vSpacing                = rRhs.GetCellSpacing() ;
+    const float             oneOverCellVolume       = 1.0f / ( vSpacing.x * vSpacing.y * vSpacing.z ) ;
+    const float             oneOverRadius2          = 1.0f / POW2( mP3MRadius ) ;
+    const unsigned          numXY                   = rRhs.GetNumPoints( 0 ) * rRhs.GetNumPoints( 1 ) ;
+    const size_t            numVortons              = mVortons.Size() ;
+
+    for( size_t iVorton = 0 ; iVorton < numVortons ; ++ iVorton )
+    {   // For each vorton...
+        const Vorton &  rVorton     = rVortons[ iVorton ] ;
+        const Vec3      vMinRel     = rVorton.mPosition - Vec3( mP3MRadius , mP3MRadius , mP3MRadius ) - vMinCorner ;
+        const Vec3      vMaxRel     = rVorton.mPosition + Vec3( mP3MRadius , mP3MRadius , mP3MRadius ) - vMinCorner ;
+        // Gridpoints strictly within the blob radius.  DefineP3MMesh made the mesh large enough to contain them.
+        const unsigned  idxMin[3]   = { unsigned( vMinRel.x / vSpacing.x ) + 1 , unsigned( vMinRel.y / vSpacing.y ) + 1 , unsigned( vMinRel.z / vSpacing.z ) + 1 } ;
+        const unsigned  idxMax[3]   = { unsigned( vMaxRel.x / vSpacing.x )     , unsigned( vMaxRel.y / vSpacing.y )     , unsigned( vMaxRel.z / vSpacing.z )     } ;
+        unsigned        idx[3] ;
+
+        // Sum weights so that the blob conveys exactly the strength of the vorton.
+        float weightSum = 0.0f ;
+        for( idx[2] = idxMin[2] ; idx[2] <= idxMax[2] ; ++ idx[2] )
+        {
+            for( idx[1] = idxMin[1] ; idx[1] <= idxMax[1] ; ++ idx[1] )
+            {
+                for( idx[0] = idxMin[0] ; idx[0] <= idxMax[0] ; ++ idx[0] )
+                {   // For each gridpoint in the bounding box of the blob...
+                    Vec3 vPoint ;
+                    rRhs.PositionFromIndices( vPoint , idx ) ;
+                    const float x2 = ( vPoint - rVorton.mPosition ).Mag2() * oneOverRadius2 ;
+                    weightSum += ( x2 < 1.0f ) ? POW2( 1.0f - x2 ) : 0.0f ;
+                }
+            }
+        }
+        if( 0.0f == weightSum )
+        {   // Blob covers no gridpoints.
+            continue ;
+        }
+
+        const Vec3 vScaledStrength = - 8.0f * POW3( rVorton.mRadius ) * oneOverCellVolume / weightSum * rVorton.mVorticity ;
+        for( idx[2] = idxMin[2] ; idx[2] <= idxMax[2] ; ++ idx[2] )
+        {
+            for( idx[1] = idxMin[1] ; idx[1] <= idxMax[1] ; ++ idx[1] )
+            {
+                for( idx[0] = idxMin[0] ; idx[0] <= idxMax[0] ; ++ idx[0] )
+                {   // For each gridpoint in the bounding box of the blob...
+                    Vec3 vPoint ;
+                    rRhs.PositionFromIndices( vPoint , idx ) ;
+                    const float x2 = ( vPoint - rVorton.mPosition ).Mag2() * oneOverRadius2 ;
+                    if( x2 < 1.0f )
+                    {   // Gridpoint lies within blob.
+                        rRhs[ idx[0] + rRhs.GetNumPoints( 0 ) * idx[1] + numXY * idx[2] ] += POW2( 1.0f - x2 ) * vScaledStrength ;
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+
+
+/*! \brief Gather gridpoints of a level of the P3M mesh that hold vorticity, as sources of the vector potential on the boundary
+
+    \param iLevel - level of the mesh whose right-hand side holds restricted vorticity.
+
+    Each gridpoint with nonzero vorticity acts as a point source whose strength
+    is its vorticity times its cell volume.  Coarser levels have fewer sources,
+    so the boundary costs less, but represent vorticity near the boundary less
+    accurately.  The mesh margin keeps vorticity far enough from the boundary
+    that sources at level sP3MBoundarySourceLevel suffice.
+
+    \see P3MSlices for P3M_BOUNDARY_SOURCES
+*/
+void VortonSim::GatherP3MBoundarySources( size_t iLevel )
+{
+    const UniformGrid< Vec3 > & rRhs        = mP3MRhs[ iLevel ] ;
+    const Vec3 &                vSpacing    = rRhs.GetCellSpacing() ;
+    const float                 cellVolume  = vSpacing.x * vSpacing.y * vSpacing.z ;
+    const unsigned              numPoints   = unsigned( rRhs.Size() ) ;
+
+    mP3MBoundarySourcePositions.Clear() ;
+    mP3MBoundarySourceStrengths.Clear() ;
+    for( unsigned offset = 0 ; offset < numPoints ; ++ offset )
+    {   // For each gridpoint at this level...
+        if( rRhs[ offset ].Mag2() > 0.0f )
+        {   // Gridpoint holds vorticity.
+            Vec3 vPosition ;
+            rRhs.PositionFromOffset( vPosition , offset ) ;
+            mP3MBoundarySourcePositions.PushBack( vPosition ) ;
+            mP3MBoundarySourceStrengths.PushBack( - cellVolume * rRhs[ offset ] ) ;
+        }
+    }
+}
+
+
+
+
+/*! \brief Perform a step of the P3M mesh solve, for a subset of z-slices
+
+    \param step - operation to perform
+
+    \param iLevel - level of the mesh on which to operate.  Restriction
+        writes to the next coarser level and prolongation reads from it.
+
+    \param izStart - first z index to process.  For restriction, this
+        indexes the next coarser level, and for P3M_VELOCITY_GRID, mVelGrid.
+
+    \param izEnd - one past the last z index to process
+
+    \see RunP3MStep
+*/
+void VortonSim::P3MSlices( P3MStep step , size_t iLevel , size_t izStart , size_t izEnd )
+{
+    switch( step )
+    {
+        case P3M_SMOOTH_RED         : SolvePoissonRedBlack( mP3MStreamFunction[ iLevel ] , mP3MRhs[ iLevel ] , 0 , izStart , izEnd ) ; break ;
+        case P3M_SMOOTH_BLACK       : SolvePoissonRedBlack( mP3MStreamFunction[ iLevel ] , mP3MRhs[ iLevel ] , 1 , izStart , izEnd ) ; break ;
+        case P3M_RESIDUAL           : ComputePoissonResidual( mP3MResidual[ iLevel ] , mP3MStreamFunction[ iLevel ] , mP3MRhs[ iLevel ] , izStart , izEnd ) ; break ;
+        case P3M_RESTRICT_RHS       : RestrictFullWeighting( mP3MRhs[ iLevel + 1 ] , mP3MRhs[ iLevel ] , izStart , izEnd ) ; break ;
+        case P3M_RESTRICT_RESIDUAL  : RestrictFullWeighting( mP3MRhs[ iLevel + 1 ] , mP3MResidual[ iLevel ] , izStart , izEnd ) ; break ;
+        case P3M_PROLONGATE         : ProlongateAndAdd( mP3MStreamFunction[ iLevel ] , mP3MStreamFunction[ iLevel + 1 ] , izStart , izEnd ) ; break ;
+
+        case P3M_BOUNDARY_SOURCES:
+        case P3M_BOUNDARY:
+        {   // Assign vector potential to boundary gridpoints, either by summing boundary sources or by interpolating a coarser level.
+            const UniformGrid< Vec3 > & rCoarse     = mP3MStreamFunction[ iLevel ] ;
+            UniformGrid< Vec3 > &       rStream     = ( P3M_BOUNDARY_SOURCES == step ) ? mP3MStreamFunction[ iLevel ] : mP3MStreamFunction[ 0 ] ;
+            const unsigned              dims[3]     = { rStream.GetNumPoints( 0 ) , rStream.GetNumPoints( 1 ) , rStream.GetNumPoints( 2 ) } ;
+            const size_t            numSources  = mP3MBoundarySourcePositions.Size() ;
+            unsigned                idx[3] ;
+            for( idx[2] = unsigned( izStart ) ; idx[2] < izEnd ; ++ idx[2] )
+            {
+                const bool bBoundaryZ = ( 0 == idx[2] ) || ( dims[2] - 1 == idx[2] ) ;
+                for( idx[1] = 0 ; idx[1] < dims[1] ; ++ idx[1] )
+                {
+                    const bool      bBoundaryYZ = bBoundaryZ || ( 0 == idx[1] ) || ( dims[1] - 1 == idx[1] ) ;
+                    // Interior rows have boundary gridpoints only at each end.
+                    const unsigned  ixStride    = bBoundaryYZ ? 1 : dims[0] - 1 ;
+                    for( idx[0] = 0 ; idx[0] < dims[0] ; idx[0] += ixStride )
+                    {   // For each boundary gridpoint in this row...
+                        Vec3 vPosition ;
+                        rStream.PositionFromIndices( vPosition , idx ) ;
+                        Vec3 & rValue = rStream[ idx[0] + dims[0] * ( idx[1] + dims[1] * idx[2] ) ] ;
+                        if( P3M_BOUNDARY == step )
+                        {   // Vector potential varies smoothly along the boundary, far from vorticity, so interpolate it.
+                            rCoarse.Interpolate( rValue , ClampToGrid( vPosition , rCoarse ) ) ;
+                            continue ;
+                        }
+                        Vec3 vStream( 0.0f , 0.0f , 0.0f ) ;
+                        for( size_t iSource = 0 ; iSource < numSources ; ++ iSource )
+                        {   // For each source...
+                            vStream += mP3MBoundarySourceStrengths[ iSource ] * finvsqrtf( ( vPosition - mP3MBoundarySourcePositions[ iSource ] ).Mag2() ) ;
+                        }
+                        rValue = OneOverFourPi * vStream ;
+                    }
+                }
+            }
+        }
+        break ;
+
+        case P3M_VELOCITY_GRID:
+        {   // Velocity is the curl of the vector potential, from central differences.
+            const UniformGrid< Vec3 > & rStream             = mP3MStreamFunction[ iLevel ] ;
+            const Vec3 &                vSpacing            = rStream.GetCellSpacing() ;
+            const Vec3                  vHalfOverSpacing( 0.5f / vSpacing.x , 0.5f / vSpacing.y , 0.5f / vSpacing.z ) ;
+            const unsigned              numX                = rStream.GetNumPoints( 0 ) ;
+            const unsigned              numXY               = numX * rStream.GetNumPoints( 1 ) ;
+            const unsigned              dims[3]             = { mVelGrid.GetNumPoints( 0 ) , mVelGrid.GetNumPoints( 1 ) , mVelGrid.GetNumPoints( 2 ) } ;
+            unsigned                    idx[3] ;
+            for( idx[2] = unsigned( izStart ) ; idx[2] < izEnd ; ++ idx[2] )
+            {
+                for( idx[1] = 0 ; idx[1] < dims[1] ; ++ idx[1] )
+                {
+                    for( idx[0] = 0 ; idx[0] < dims[0] ; ++ idx[0] )
+                    {   // For each gridpoint in the velocity grid...
+                        const unsigned  offsetMesh  = ( idx[0] + mP3MMargin[0] ) + numX * ( idx[1] + mP3MMargin[1] ) + numXY * ( idx[2] + mP3MMargin[2] ) ;
+                        const Vec3      dStream_dx  = ( rStream[ offsetMesh + 1     ] - rStream[ offsetMesh - 1     ] ) * vHalfOverSpacing.x ;
+                        const Vec3      dStream_dy  = ( rStream[ offsetMesh + numX  ] - rStream[ offsetMesh - numX  ] ) * vHalfOverSpacing.y ;
+                        const Vec3      dStream_dz  = ( rStream[ offsetMesh + numXY ] - rStream[ offsetMesh - numXY ] ) * vHalfOverSpacing.z ;
+                        mVelGrid[ idx[0] + dims[0] * ( idx[1] + dims[1] * idx[2] ) ] = Vec3( dStream_dy.z - dStream_dz.y
+                                                                                           , dStream_dz.x - dStream_dx.z
+                                                                                           , dStream_dx.y - dStream_dy.x ) ;
+                    }
+                }
+            }
+        }
+        break ;
+    }
+}
+
+
+
+
+/*! \brief Perform a step of the P3M mesh solve over all z-slices it applies to, using multiple threads when available
+
+    \param step - operation to perform
+
+    \param iLevel - level of the mesh on which to operate
+
+    \see P3MSlices
+*/
+void VortonSim::RunP3MStep( P3MStep step , size_t iLevel )
+{
+    size_t numZ ;
+    switch( step )
+    {
+        case P3M_RESTRICT_RHS       :
+        case P3M_RESTRICT_RESIDUAL  : numZ = mP3MRhs[ iLevel + 1 ].GetNumPoints( 2 ) ; break ;
+        case P3M_BOUNDARY           : numZ = mP3MRhs[ 0 ].GetNumPoints( 2 ) ;          break ;
+        case P3M_VELOCITY_GRID      : numZ = mVelGrid.GetNumPoints( 2 ) ;             break ;
+        default                     : numZ = mP3MRhs[ iLevel ].GetNumPoints( 2 ) ;     break ;
+    }
+#if USE_TBB
+    // Estimate grain size based on size of problem and number of processors.
+    const size_t grainSize =  MAX2( 1 , numZ / gNumberOfProcessors ) ;
+    // Perform step using multiple threads.
+    parallel_for( tbb::blocked_range<size_t>( 0 , numZ , grainSize ) , VortonSim_P3MSlices_TBB( this , step , iLevel ) ) ;
+#else
+    P3MSlices( step , iLevel , 0 , numZ ) ;
+#endif
+}
+
+
+
+
+/*! \brief Reduce error of the vector potential on a level of the P3M mesh, and every coarser level, with a multigrid V-cycle
+
+    \param iLevel - level of the mesh to solve.  Its right-hand side must
+        already hold vorticity (at level 0) or a restricted residual.
+
+    Smoothing damps error that varies rapidly across the gridpoints of this level.
+    The coarser level then solves for the remaining smooth error, using a
+    quarter of the cells, and this level adds the resulting correction.
+    The coarsest level has so few gridpoints that smoothing alone solves it.
+*/
+void VortonSim::VCycleP3M( size_t iLevel )
+{
+    if( iLevel + 1 == mP3MStreamFunction.Size() )
+    {   // Coarsest level.  Smooth until error propagates across the whole grid.
+        const unsigned numZ         = mP3MStreamFunction[ iLevel ].GetNumPoints( 2 ) ;
+        const unsigned maxNumPoints = MAX2( MAX2( mP3MStreamFunction[ iLevel ].GetNumPoints( 0 ) , mP3MStreamFunction[ iLevel ].GetNumPoints( 1 ) ) , numZ ) ;
+        const unsigned numSweeps    = POW2( maxNumPoints ) ;
+        for( unsigned iSweep = 0 ; iSweep < numSweeps ; ++ iSweep )
+        {
+            P3MSlices( P3M_SMOOTH_RED   , iLevel , 0 , numZ ) ;
+            P3MSlices( P3M_SMOOTH_BLACK , iLevel , 0 , numZ ) ;
+        }
+        return ;
+    }
+
+    for( unsigned iSweep = 0 ; iSweep < sP3MNumSmoothingSweeps ; ++ iSweep )
+    {
+        RunP3MStep( P3M_SMOOTH_RED   , iLevel ) ;
+        RunP3MStep( P3M_SMOOTH_BLACK , iLevel ) ;
+    }
+    RunP3MStep( P3M_RESIDUAL , iLevel ) ;
+    RunP3MStep( P3M_RESTRICT_RESIDUAL , iLevel ) ;
+    mP3MStreamFunction[ iLevel + 1 ].Init( Vec3( 0.0f , 0.0f , 0.0f ) ) ;    // Correction is zero on the boundary, and zero is the initial guess.
+    VCycleP3M( iLevel + 1 ) ;
+    RunP3MStep( P3M_PROLONGATE , iLevel ) ;
+    for( unsigned iSweep = 0 ; iSweep < sP3MNumSmoothingSweeps ; ++ iSweep )
+    {
+        RunP3MStep( P3M_SMOOTH_RED   , iLevel ) ;
+        RunP3MStep( P3M_SMOOTH_BLACK , iLevel ) ;
+    }
+}
+
+
+
+
+/*! \brief Return the difference between the velocity that nearby vortons induce and the velocity that their P3M blobs induce
+
+    \param vPosition - point at which to evaluate velocity
+
+    \param reach - distance beyond which to ignore vortons.  This must be at
+        least the larger of the blob radius and the largest vorton radius,
+        plus how far any vorton moved since IndexParticles.
+
+    Beyond both the blob radius and the vorton radius, the blob and the vorton
+    induce the same velocity, so the difference vanishes.  Within the blob
+    radius a, the blob with profile (1-r^2/a^2)^2 that SplatP3MVorticity spreads
+    induces velocity as though only the fraction of its strength within
+    r=|x|, namely (35 x^3 - 42 x^5 + 15 x^7)/8 for x=r/a, lay at its center.
+
+    \see ComputeVelocityP3M
+*/
+Vec3 VortonSim::ComputeP3MNearVelocity( const Vec3 & vPosition , float reach ) const
+{
+    const UniformGridGeometry & rCells          = mVortonCells.GetGeometry() ;
+    const Vec3                  vMinRel         = vPosition - Vec3( reach , reach , reach ) - rCells.GetMinCorner() ;
+    const Vec3                  vMaxRel         = vPosition + Vec3( reach , reach , reach ) - rCells.GetMinCorner() ;
+    const Vec3 &                rCellsPerExtent = rCells.GetCellsPerExtent() ;
+    const float                 fIdxMin[3]      = { vMinRel.x * rCellsPerExtent.x , vMinRel.y * rCellsPerExtent.y , vMinRel.z * rCellsPerExtent.z } ;
+    const float                 fIdxMax[3]      = { vMaxRel.x * rCellsPerExtent.x , vMaxRel.y * rCellsPerExtent.y , vMaxRel.z * rCellsPerExtent.z } ;
+    unsigned                    idxMin[3] ;
+    unsigned                    idxMax[3] ;
+    for( unsigned axis = 0 ; axis < 3 ; ++ axis )
+    {   // For each axis, find range of cells the query box overlaps.  Cells at the edge also hold vortons beyond it.
+        const float maxIdx = float( rCells.GetNumCells( axis ) - 1 ) ;
+        idxMin[ axis ] = unsigned( CLAMP( fIdxMin[ axis ] , 0.0f , maxIdx ) ) ;
+        idxMax[ axis ] = unsigned( CLAMP( fIdxMax[ axis ] , 0.0f , maxIdx ) ) ;
+    }
+
+    const float     blobRadius2         = POW2( mP3MRadius ) ;
+    const float     oneOverBlobRadius2  = 1.0f / blobRadius2 ;
+    const float     blobLawScale        = 1.0f / ( 8.0f * POW3( mP3MRadius ) ) ;
+    const unsigned  nx                  = rCells.GetNumPoints( 0 ) ;
+    const unsigned  nxy                 = nx * rCells.GetNumPoints( 1 ) ;
+    Vec3            velocity( 0.0f , 0.0f , 0.0f ) ;
+    unsigned        idx[3] ;
+    for( idx[2] = idxMin[2] ; idx[2] <= idxMax[2] ; ++ idx[2] )
+    {
+        for( idx[1] = idxMin[1] ; idx[1] <= idxMax[1] ; ++ idx[1] )
+        {
+            for( idx[0] = idxMin[0] ; idx[0] <= idxMax[0] ; ++ idx[0] )
+            {   // For each cell overlapping the query box...
+                const unsigned cell = idx[0] + idx[1] * nx + idx[2] * nxy ;
+                for( unsigned iSorted = mVortonCells.GetCellBegin( cell ) ; iSorted < mVortonCells.GetCellEnd( cell ) ; ++ iSorted )
+                {   // For each vorton in this cell...
+                    const Vorton &  rVorton         = mVortons[ mVortonCells.GetParticle( iSorted ) ] ;
+                    const Vec3      vNeighborToSelf = vPosition - rVorton.mPosition ;
+                    const float     radius2         = rVorton.mRadius * rVorton.mRadius ;
+                    const float     dist2           = vNeighborToSelf.Mag2() + sAvoidSingularity ;
+                    if( ( dist2 >= radius2 ) && ( dist2 >= blobRadius2 ) )
+                    {   // Vorton and blob induce the same velocity here.
+                        continue ;
+                    }
+                    const float     oneOverDist     = finvsqrtf( dist2 ) ;
+                    const float     farLaw          = oneOverDist / dist2 ;
+                    const float     vortonLaw       = ( dist2 < radius2 ) ? ( oneOverDist / radius2 ) : farLaw ;
+                    const float     x2              = dist2 * oneOverBlobRadius2 ;
+                    const float     blobLaw         = ( dist2 < blobRadius2 ) ? ( ( 35.0f - 42.0f * x2 + 15.0f * x2 * x2 ) * blobLawScale ) : farLaw ;
+                    velocity += ( OneOverFourPi * ( 8.0f * radius2 * rVorton.mRadius ) * ( vortonLaw - blobLaw ) ) * ( rVorton.mVorticity ^ vNeighborToSelf ) ;
+                }
+            }
+        }
+    }
+    return velocity ;
+}
+
+
+
+
+/*! \brief Add the P3M near field to (a subset of) the velocity grid
+
+    \param reach - distance beyond which vortons contribute no near field
+
+    \param izStart - first z index of mVelGrid to process
+
+    \param izEnd - one past the last z index of mVelGrid to process
+
+    \see ComputeP3MNearVelocity
+*/
+void VortonSim::ComputeP3MNearVelocityGridSlice( float reach , size_t izStart , size_t izEnd )
+{
+    const unsigned  dims[3]     = { mVelGrid.GetNumPoints( 0 ) , mVelGrid.GetNumPoints( 1 ) , mVelGrid.GetNumPoints( 2 ) } ;
+    const bool      bPacked     = mPackedVelGrid.Size() > 0 ;
+    unsigned        idx[3] ;
+    for( idx[2] = unsigned( izStart ) ; idx[2] < izEnd ; ++ idx[2] )
+    {
+        for( idx[1] = 0 ; idx[1] < dims[1] ; ++ idx[1] )
+        {
+            for( idx[0] = 0 ; idx[0] < dims[0] ; ++ idx[0] )
+            {   // For each gridpoint in the velocity grid...
+                const unsigned  offsetXYZ   = idx[0] + dims[0] * ( idx[1] + dims[1] * idx[2] ) ;
+                Vec3            vPosition ;
+                mVelGrid.PositionFromIndices( vPosition , idx ) ;
+                Vec3 & rVelocity = mVelGrid[ offsetXYZ ] ;
+                rVelocity += ComputeP3MNearVelocity( vPosition , reach ) ;
+                if( bPacked )
+                {   // Also store velocity at reduced precision.
+                    Pack( mPackedVelGrid[ offsetXYZ ] , rVelocity.x , rVelocity.y , rVelocity.z , 0.0f , mVelGridPrecision ) ;
+                }
+            }
+        }
+    }
+}
+
+
+
+
+/*! \brief Compute velocity at (a subset of) vortons, from the P3M far field plus near field
+
+    \param reach - distance beyond which vortons contribute no near field
+
+    \param ivStart - index of first vorton to process
+
+    \param ivEnd - one past the index of the last vorton to process
+
+    \note This routine assumes mVelGrid holds only the far field, i.e. that
+            ComputeP3MNearVelocityGridSlice has not yet executed.
+*/
+void VortonSim::ComputeP3MVortonVelocitiesSlice( float reach , size_t ivStart , size_t ivEnd )
+{
+    const ChunkedVector< Vorton > &    rVortons    = mVortons ;
+    for( size_t iVorton = ivStart ; iVorton < ivEnd ; ++ iVorton )
+    {   // For each vorton in this slice...
+        const Vec3 & vPosition = rVortons[ iVorton ].mPosition ;
+        Vec3 velocity ;
+        mVelGrid.Interpolate( velocity , ClampToGrid( vPosition , mVelGrid ) ) ;
+        mVortonVelocities[ iVorton ] = velocity + ComputeP3MNearVelocity( vPosition , reach ) ;
+    }
+}
+
+
+
+
+/*! \brief Compute velocity grid, and velocity at each vorton, with the particle-particle/particle-mesh (P3M) method
+
+    \param maxDisplacement - how far any vorton could have moved since IndexParticles,
+        so the near field can find every vorton near each query point.
+
+    The far field comes from a mesh: each vorton spreads its vorticity over a
+    smooth blob, a multigrid solver finds the vector potential psi that
+    satisfies Laplacian(psi) = -vorticity, and velocity is the curl of psi.
+    The boundary of the mesh holds the vector potential of coarse mesh
+    vorticity, so the mesh need only span the vortons, not all space.
+    The near field corrects the mesh velocity by the difference between the
+    velocity each nearby vorton induces and that its blob induces.
+
+    This has cost proportional to the number of vortons plus the number of
+    mesh gridpoints, unlike the influence tree, whose cost grows with the
+    logarithm of the number of vortons per query.
+
+    This populates mVortonVelocities, so vortons advect with velocity
+    evaluated exactly where they lie, and mVelGrid, which includes the near
+    field at its gridpoints, for tracers and the velocity Jacobian.
+
+    \see SetVelocitySolver
+*/
+void VortonSim::ComputeVelocityP3M( float maxDisplacement )
+{
+    QUERY_PERFORMANCE_ENTER ;
+    DefineP3MMesh() ;
+    SplatP3MVorticity() ;
+    QUERY_PERFORMANCE_EXIT( VortonSim_ComputeVelocityP3M_Splat ) ;
+
+    QUERY_PERFORMANCE_ENTER ;
+    const size_t numLevels      = mP3MStreamFunction.Size() ;
+    const size_t boundaryLevel  = MIN2( sP3MBoundarySourceLevel , numLevels - 1 ) ;
+    for( size_t iLevel = 0 ; iLevel < boundaryLevel ; ++ iLevel )
+    {   // Restrict vorticity to level whose gridpoints act as boundary sources.
+        RunP3MStep( P3M_RESTRICT_RHS , iLevel ) ;
+    }
+    GatherP3MBoundarySources( boundaryLevel ) ;
+    RunP3MStep( P3M_BOUNDARY_SOURCES , boundaryLevel ) ;
+    if( boundaryLevel > 0 )
+    {   // Sources assigned the boundary of a coarser level.  Interpolate it onto the finest level.
+        RunP3MStep( P3M_BOUNDARY , boundaryLevel ) ;
+    }
+    QUERY_PERFORMANCE_EXIT( VortonSim_ComputeVelocityP3M_Boundary ) ;
+
+    QUERY_PERFORMANCE_ENTER ;
+    for( unsigned iCycle = 0 ; iCycle < sP3MNumVCycles ; ++ iCycle )
+    {
+        VCycleP3M( 0 ) ;
+    }
+    RunP3MStep( P3M_VELOCITY_GRID , 0 ) ;
+    QUERY_PERFORMANCE_EXIT( VortonSim_ComputeVelocityP3M_Solve ) ;
+
+    QUERY_PERFORMANCE_ENTER ;
+    const float     reach       = MAX2( mP3MRadius , mVortonCells.GetMaxParticleSize() ) + maxDisplacement ;
+    const size_t    numVortons  = mVortons.Size() ;
+    const size_t    numZ        = mVelGrid.GetNumPoints( 2 ) ;
+    mVortonVelocities.Resize( numVortons ) ;
+#if USE_TBB
+    {
+        // Estimate grain size based on size of problem and number of processors.
+        const size_t grainSize =  MAX2( 1 , numVortons / gNumberOfProcessors ) ;
+        // Compute velocity at vortons using multiple threads.  This must precede adding the near field to the grid.
+        parallel_for( tbb::blocked_range<size_t>( 0 , numVortons , grainSize ) , VortonSim_ComputeP3MVortonVelocities_TBB( this , reach ) ) ;
+    }
+    {
+        // Estimate grain size based on size of problem and number of processors.
+        const size_t grainSize =  MAX2( 1 , numZ / gNumberOfProcessors ) ;
+        // Add near field to velocity grid using multiple threads.
+        parallel_for( tbb::blocked_range<size_t>( 0 , numZ , grainSize ) , VortonSim_ComputeP3MNearVelocityGrid_TBB( this , reach ) ) ;
+    }
+#else
+    ComputeP3MVortonVelocitiesSlice( reach , 0 , numVortons ) ;
+    ComputeP3MNearVelocityGridSlice( reach , 0 , numZ ) ;
+#endif
+    QUERY_PERFORMANCE_EXIT( VortonSim_ComputeVelocityP3M_Near ) ;
+}
+
+
+
+
+/*! \brief Mark every field derived from the velocity grid as stale
+
+    Call this whenever mVelGrid changes.  This does not free memory;
+    the next request for each field reuses or reallocates its grid.
+
+    \see UpdateDerivedField
+*/
+void VortonSim::InvalidateDerivedFields( void )
+{
+    for( unsigned field = 0 ; field < NUM_DERIVED_FIELDS ; ++ field )
+    {
+        mDerivedSliceValid[ field ].Clear() ;
+    }
+}
+
+
+
+
+/*! \brief Compute a field derived from the velocity grid, for a subset of z-slices
+
+    \param field - which field to compute
+
+    \param izStart - first z index to compute
+
+    \param izEnd - one past the last z index to compute
+
+    \note Every field other than DERIVED_VELOCITY_JACOBIAN derives from the
+            velocity Jacobian, which must already be valid in the given slices.
+
+    \see UpdateDerivedField
+*/
+void VortonSim::ComputeDerivedFieldSlice( DerivedField field , size_t izStart , size_t izEnd )
+{
+    switch( field )
+    {
+        case DERIVED_VELOCITY_JACOBIAN:
+            ComputeJacobian( mVelocityJacobianGrid , mVelGrid , izStart , izEnd , mFiniteDifferenceScheme ) ;
+            break ;
+        case DERIVED_VORTICITY:
+            ComputeCurlFromJacobian( mVorticityGrid , mVelocityJacobianGrid , izStart , izEnd ) ;
+            break ;
+        case DERIVED_DIVERGENCE:
+            ComputeDivergenceFromJacobian( mDivergenceGrid , mVelocityJacobianGrid , izStart , izEnd ) ;
+            break ;
+        case DERIVED_STRAIN_RATE:
+        {
+            const unsigned  numXY       = mVelGrid.GetNumPoints( 0 ) * mVelGrid.GetNumPoints( 1 ) ;
+            const unsigned  offsetEnd   = unsigned( izEnd ) * numXY ;
+            for( unsigned offset = unsigned( izStart ) * numXY ; offset < offsetEnd ; ++ offset )
+            {
+                mStrainRateGrid[ offset ] = StrainRate( mVelocityJacobianGrid[ offset ] ) ;
+            }
+        }
+            break ;
+        default:
+            break ;
+    }
+}
+
+
+
+
+/*! \brief Ensure a field derived from the velocity grid is current, within a subset of z-slices
+
+    \param field - which field to compute
+
+    \param izStart - first z index to make current
+
+    \param izEnd - one past the last z index to make current
+
+    This computes only slices not already computed since the velocity grid
+    last changed, so repeated requests for the same field cost nothing.
+
+    \see InvalidateDerivedFields, DerivedField
+
+    \note This routine assumes ComputeVelocityGrid has already executed.
+*/
+void VortonSim::UpdateDerivedField( DerivedField field , size_t izStart , size_t izEnd )
+{
+    const size_t numZ = mVelGrid.GetNumPoints( 2 ) ;
+    izEnd = MIN2( izEnd , numZ ) ;
+    if( ( izStart >= izEnd ) || ( 0 == mVelGrid.Size() ) )
+    {   // Nothing to compute, or velocity grid has no contents because this update needed none.
+        return ;
+    }
+
+    // Compact stencils solve whole lines along z, so any slice costs nearly as much as all of them,
+    // and splitting slices among threads would only repeat that work.
+    const bool bCoupledSlices = ( DERIVED_VELOCITY_JACOBIAN == field ) && ( FINITE_DIFFERENCE_COMPACT4 == mFiniteDifferenceScheme ) ;
+    if( bCoupledSlices )
+    {
+        izStart = 0 ;
+        izEnd   = numZ ;
+    }
+
+    if( field != DERIVED_VELOCITY_JACOBIAN )
+    {   // Field derives from the velocity Jacobian, which must therefore be current in the same slices.
+        UpdateDerivedField( DERIVED_VELOCITY_JACOBIAN , izStart , izEnd ) ;
+    }
+
+    Vector< unsigned char > & rSliceValid = mDerivedSliceValid[ field ] ;
+    if( 0 == rSliceValid.Size() )
+    {   // Field is stale, so reshape it to match the velocity grid.
+        switch( field )
+        {
+            case DERIVED_VELOCITY_JACOBIAN:
+                mVelocityJacobianGrid.Clear() ; mVelocityJacobianGrid.CopyShape( mVelGrid ) ; mVelocityJacobianGrid.Init() ;
+                break ;
+            case DERIVED_VORTICITY:
+                mVorticityGrid.Clear() ; mVorticityGrid.CopyShape( mVelGrid ) ; mVorticityGrid.Init() ;
+                break ;
+            case DERIVED_DIVERGENCE:
+                mDivergenceGrid.Clear() ; mDivergenceGrid.CopyShape( mVelGrid ) ; mDivergenceGrid.InitUninitialized() ;
+                break ;
+            case DERIVED_STRAIN_RATE:
+                mStrainRateGrid.Clear() ; mStrainRateGrid.CopyShape( mVelGrid ) ; mStrainRateGrid.InitUninitialized() ;
+                break ;
+            default:
+                break ;
+        }
+        rSliceValid.Resize( numZ , 0 ) ;
+    }
+
+    size_t izRunStart = izStart ;
+    while( izRunStart < izEnd )
+    {   // For each run of consecutive stale slices...
+        if( rSliceValid[ izRunStart ] )
+        {   // Slice is current, so skip it.
+            ++ izRunStart ;
+            continue ;
+        }
+        size_t izRunEnd = izRunStart + 1 ;
+        while( ( izRunEnd < izEnd ) && ! rSliceValid[ izRunEnd ] )
+        {
+            ++ izRunEnd ;
+        }
+
+    #if USE_TBB
+        // Estimate grain size based on size of problem and number of processors.
+        const size_t grainSize =  bCoupledSlices ? ( izRunEnd - izRunStart ) : MAX2( 1 , ( izRunEnd - izRunStart ) / gNumberOfProcessors ) ;
+        // Compute run of slices using multiple threads.
+        parallel_for( tbb::blocked_range<size_t>( izRunStart , izRunEnd , grainSize ) , VortonSim_ComputeDerivedField_TBB( this , field ) ) ;
+    #else
+        ComputeDerivedFieldSlice( field , izRunStart , izRunEnd ) ;
+    #endif
+
+        for( size_t iz = izRunStart ; iz < izRunEnd ; ++ iz )
+        {
+            rSliceValid[ iz ] = 1 ;
+        }
+        izRunStart = izRunEnd ;
+    }
+}
+
+
+
+
+/*! \brief Ensure a field derived from the velocity grid is current, within a region
+
+    \param field - which field to compute
+
+    \param vMinCorner - minimal corner of region in which caller will interpolate the field
+
+    \param vMaxCorner - maximal corner of region in which caller will interpolate the field
+
+    Interpolating within a cell reads the gridpoints on both of its z-faces,
+    so this computes every slice that bounds a cell overlapping the region.
+*/
+void VortonSim::UpdateDerivedField( DerivedField field , const Vec3 & vMinCorner , const Vec3 & vMaxCorner )
+{
+    if( 0 == mVelGrid.GetNumPoints( 2 ) )
+    {   // Velocity grid does not exist yet.
+        return ;
+    }
+    unsigned idxMin[3] ;
+    unsigned idxMax[3] ;
+    mVelGrid.IndicesOfPosition( idxMin , ClampToGrid( vMinCorner , mVelGrid ) ) ;
+    mVelGrid.IndicesOfPosition( idxMax , ClampToGrid( vMaxCorner , mVelGrid ) ) ;
+    UpdateDerivedField( field , idxMin[2] , idxMax[2] + 2 ) ;
+}
+
+
+
+
+/*! \brief Compute velocity due to vortons, for every point in a subset of blocks of the sparse velocity grid
+
+    \param iBlockStart - index of first block to process
+
+    \param iBlockEnd - one past index of last block to process
+
+    \see ComputeFarVelocityGrid
+
+*/
+void VortonSim::ComputeFarVelocityGridSlice( size_t iBlockStart , size_t iBlockEnd )
+{
+    for( size_t iBlock = iBlockStart ; iBlock < iBlockEnd ; ++ iBlock )
+    {   // For each block in this slice...
+        SparseUniformGrid< Vec3 >::Block & rBlock = mFarVelGrid.GetBlock( iBlock ) ;
+        for( unsigned offset = 0 ; offset < SparseUniformGrid< Vec3 >::NUM_POINTS_PER_BLOCK ; ++ offset )
+        {   // For each point in this block...
+            Vec3 vPosition ;
+            mFarVelGrid.PositionFromBlockOffset( vPosition , rBlock , offset ) ;
+            rBlock.mPoints[ offset ] = ComputeVelocityFromVortons( vPosition ) ;
+        }
+    }
+}
+
+
+
+
+/*! \brief Compute velocity due to vortons near tracers that lie outside the velocity grid
+
+    When tracers are unbounded, the domain contains only vortons, so tracers
+    can drift outside mVelGrid.  This populates a sparse grid, which shares
+    the lattice of mVelGrid, only in blocks around those tracers.  Memory
+    and cost are proportional to the number of regions that stray tracers
+    occupy, rather than to the volume that contains them.
+
+    \note This routine assumes ComputeVelocityGrid has already executed.
+
+*/
+void VortonSim::ComputeFarVelocityGrid( void )
+{
+    const ChunkedVector< Particle > &  rTracers    = mTracers ;
+    mFarVelGrid.DefineShape( mVelGrid , Vec3( 0.0f , 0.0f , 0.0f ) ) ;
+
+    const size_t numTracers = mTracers.Size() ;
+    for( size_t iTracer = 0 ; iTracer < numTracers ; ++ iTracer )
+    {   // For each passive tracer particle...
+        const Vec3 & rPosition = rTracers[ iTracer ].mPosition ;
+        if( ! IsInsideGrid( rPosition , mVelGrid ) )
+        {   // Tracer lies outside velocity grid.
+            mFarVelGrid.AllocateCell( rPosition ) ;
+        }
+    }
+
+    const size_t numBlocks = mFarVelGrid.GetNumBlocks() ;
+#if USE_TBB
+    // Estimate grain size based on size of problem and number of processors.
+    const size_t grainSize =  MAX2( 1 , numBlocks / gNumberOfProcessors ) ;
+    // Compute velocity in blocks using multiple threads.
+    parallel_for( tbb::blocked_range<size_t>( 0 , numBlocks , grainSize ) , VortonSim_ComputeFarVelocityGrid_TBB( this ) ) ;
+#else
+    ComputeFarVelocityGridSlice( 0 , numBlocks ) ;
+#endif
+}
+
+
+
+
+/*! \brief Mark cells of a grid, within a box of cell indices
+
+    \param cellMarks - grid whose gridpoints represent the cells for which they are the minimal corner
+
+    \param idxMin - indices of minimal cell to mark
+
+    \param idxMax - indices of maximal cell to mark.  This clamps them to the last cell.
+*/
+static void MarkCells( UniformGrid< unsigned > & cellMarks , const unsigned idxMin[3] , const unsigned idxMax[3] )
+{
+    const unsigned  dims[3]     = { cellMarks.GetNumPoints( 0 ) , cellMarks.GetNumPoints( 1 ) , cellMarks.GetNumPoints( 2 ) } ;
+    const unsigned  idxEnd[3]   = { MIN2( idxMax[0] + 1 , cellMarks.GetNumCells( 0 ) )
+                                  , MIN2( idxMax[1] + 1 , cellMarks.GetNumCells( 1 ) )
+                                  , MIN2( idxMax[2] + 1 , cellMarks.GetNumCells( 2 ) ) } ;
+    unsigned        idx[3] ;
+    for( idx[2] = idxMin[2] ; idx[2] < idxEnd[2] ; ++ idx[2] )
+    for( idx[1] = idxMin[1] ; idx[1] < idxEnd[1] ; ++ idx[1] )
+    for( idx[0] = idxMin[0] ; idx[0] < idxEnd[0] ; ++ idx[0] )
+    {   // For each cell in box...
+        cellMarks[ idx[0] + dims[0] * ( idx[1] + dims[1] * idx[2] ) ] = 1 ;
+    }
+}
+
+
+
+
+/*! \brief Choose where to nest velocity patches within the velocity grid, and shape them
+
+    This marks cells of mVelGrid that lie within regions callers requested,
+    and cells around vortons with intense vorticity.  Then, within each block
+    of sVelocityPatchBlockSize cells along each side, a single patch covers the
+    bounding box of marked cells.  So patches never overlap, and adjacent
+    patches share gridpoints on their common faces.
+
+    This also assigns the weights with which BlendVelocityPatch blends patches
+    into mVelGrid: Weights are 1 at gridpoints whose every adjacent cell
+    has a patch, and 0 elsewhere, so patches fade out across the cells along
+    their boundaries, and velocity remains continuous.
+
+    \see ComputeVelocityPatches
+*/
+void VortonSim::DefineVelocityPatches( void )
+{
+    const ChunkedVector< Vorton > &    rVortons    = mVortons ;
+    const unsigned  dims[3]     = { mVelGrid.GetNumPoints( 0 ) , mVelGrid.GetNumPoints( 1 ) , mVelGrid.GetNumPoints( 2 ) } ;
+    const unsigned  numCells[3] = { mVelGrid.GetNumCells( 0 )  , mVelGrid.GetNumCells( 1 )  , mVelGrid.GetNumCells( 2 )  } ;
+    const Vec3 &    vGridMin    = mVelGrid.GetMinCorner() ;
+    const Vec3      vGridMax    = vGridMin + mVelGrid.GetExtent() ;
+    unsigned        idxMin[3] ;
+    unsigned        idxMax[3] ;
+
+    // Mark cells to refine.
+    mVelPatchOfCell.Clear() ;
+    mVelPatchOfCell.CopyShape( mVelGrid ) ;
+    mVelPatchOfCell.Init( 0u ) ;
+    const size_t numRegions = mVelRefinementRegions.Size() ;
+    for( size_t iRegion = 0 ; iRegion < numRegions ; ++ iRegion )
+    {   // For each region callers requested...
+        const RefinementRegion & rRegion = mVelRefinementRegions[ iRegion ] ;
+        if(     ( rRegion.mMaxCorner.x < vGridMin.x ) || ( rRegion.mMinCorner.x > vGridMax.x )
+            ||  ( rRegion.mMaxCorner.y < vGridMin.y ) || ( rRegion.mMinCorner.y > vGridMax.y )
+            ||  ( rRegion.mMaxCorner.z < vGridMin.z ) || ( rRegion.mMinCorner.z > vGridMax.z ) )
+        {   // Region lies outside velocity grid.
+            continue ;
+        }
+        mVelGrid.IndicesOfPosition( idxMin , ClampToGrid( rRegion.mMinCorner , mVelGrid ) ) ;
+        mVelGrid.IndicesOfPosition( idxMax , ClampToGrid( rRegion.mMaxCorner , mVelGrid ) ) ;
+        MarkCells( mVelPatchOfCell , idxMin , idxMax ) ;
+    }
+    if( mVelRefinementVorticityFraction < 1.0f )
+    {   // Refine around vortons with intense vorticity.
+        const size_t numVortons = mVortons.Size() ;
+        float maxVorticity2 = 0.0f ;
+        for( size_t iVorton = 0 ; iVorton < numVortons ; ++ iVorton )
+        {   // For each vorton...
+            maxVorticity2 = MAX2( maxVorticity2 , rVortons[ iVorton ].mVorticity.Mag2() ) ;
+        }
+        const float thresholdVorticity2 = POW2( mVelRefinementVorticityFraction ) * maxVorticity2 ;
+        for( size_t iVorton = 0 ; ( maxVorticity2 > 0.0f ) && ( iVorton < numVortons ) ; ++ iVorton )
+        {   // For each vorton...
+            const Vorton & rVorton = rVortons[ iVorton ] ;
+            if( rVorton.mVorticity.Mag2() >= thresholdVorticity2 )
+            {   // Vorticity is intense here, so refine this cell and its neighbors, so patches fade out away from the vorton.
+                unsigned idx[3] ;
+                mVelGrid.IndicesOfPosition( idx , ClampToGrid( rVorton.mPosition , mVelGrid ) ) ;
+                for( unsigned i = 0 ; i < 3 ; ++ i )
+                {
+                    idxMin[ i ] = ( idx[ i ] > 0 ) ? idx[ i ] - 1 : 0 ;
+                    idxMax[ i ] = idx[ i ] + 1 ;
+                }
+                MarkCells( mVelPatchOfCell , idxMin , idxMax ) ;
+            }
+        }
+    }
+
+    // Cover marked cells in each block with a patch.
+    Vector< unsigned > patchCells ; // Minimal and one-past-maximal cell indices of each patch, 6 per patch.
+    const unsigned  numBlocks[3]    = { ( numCells[0] + sVelocityPatchBlockSize - 1 ) / sVelocityPatchBlockSize
+                                      , ( numCells[1] + sVelocityPatchBlockSize - 1 ) / sVelocityPatchBlockSize
+                                      , ( numCells[2] + sVelocityPatchBlockSize - 1 ) / sVelocityPatchBlockSize } ;
+    unsigned        iBlock[3] ;
+    for( iBlock[2] = 0 ; iBlock[2] < numBlocks[2] ; ++ iBlock[2] )
+    for( iBlock[1] = 0 ; iBlock[1] < numBlocks[1] ; ++ iBlock[1] )
+    for( iBlock[0] = 0 ; iBlock[0] < numBlocks[0] ; ++ iBlock[0] )
+    {   // For each block of cells...
+        unsigned blockBegin[3] ;
+        unsigned blockEnd[3] ;
+        for( unsigned i = 0 ; i < 3 ; ++ i )
+        {
+            blockBegin[ i ] = iBlock[ i ] * sVelocityPatchBlockSize ;
+            blockEnd[ i ]   = MIN2( blockBegin[ i ] + sVelocityPatchBlockSize , numCells[ i ] ) ;
+            idxMin[ i ]     = blockEnd[ i ] ;
+            idxMax[ i ]     = 0 ;
+        }
+        bool bAnyMarked = false ;
+        unsigned idx[3] ;
+        for( idx[2] = blockBegin[2] ; idx[2] < blockEnd[2] ; ++ idx[2] )
+        for( idx[1] = blockBegin[1] ; idx[1] < blockEnd[1] ; ++ idx[1] )
+        for( idx[0] = blockBegin[0] ; idx[0] < blockEnd[0] ; ++ idx[0] )
+        {   // For each cell in block...
+            if( mVelPatchOfCell[ idx[0] + dims[0] * ( idx[1] + dims[1] * idx[2] ) ] )
+            {   // Cell is marked, so grow bounding box to include it.
+                bAnyMarked = true ;
+                for( unsigned i = 0 ; i < 3 ; ++ i )
+                {
+                    idxMin[ i ] = MIN2( idxMin[ i ] , idx[ i ] ) ;
+                    idxMax[ i ] = MAX2( idxMax[ i ] , idx[ i ] ) ;
+                }
+            }
+        }
+        if( bAnyMarked )
+        {
+            for( unsigned i = 0 ; i < 3 ; ++ i ) patchCells.PushBack( idxMin[ i ] ) ;
+            for( unsigned i = 0 ; i < 3 ; ++ i ) patchCells.PushBack( idxMax[ i ] + 1 ) ;
+        }
+    }
+
+    // Shape patches and record which patch covers each cell.
+    const size_t numPatches = patchCells.Size() / 6 ;
+    mVelPatches.Clear() ;
+    mVelPatches.Resize( numPatches ) ;  // Resize before populating, since copying UniformGrids does not copy their contents.
+    mVelPatchSliceBegin.Resize( numPatches + 1 ) ;
+    mVelPatchSliceBegin[ 0 ] = 0 ;
+    mVelPatchOfCell.Init( ~ 0u ) ;
+    for( size_t iPatch = 0 ; iPatch < numPatches ; ++ iPatch )
+    {   // For each patch...
+        const unsigned *        cellMin = & patchCells[ 6 * iPatch ] ;
+        const unsigned *        cellEnd = & patchCells[ 6 * iPatch + 3 ] ;
+        UniformGrid< Vec3 > &   rPatch  = mVelPatches[ iPatch ] ;
+        rPatch.Refine( mVelGrid , cellMin , cellEnd , mVelRefinement ) ;
+        rPatch.Init() ;                 // ComputeVelocityPatchSlices overwrites every point.
+        mVelPatchSliceBegin[ iPatch + 1 ] = mVelPatchSliceBegin[ iPatch ] + rPatch.GetNumPoints( 2 ) ;
+        unsigned idx[3] ;
+        for( idx[2] = cellMin[2] ; idx[2] < cellEnd[2] ; ++ idx[2] )
+        for( idx[1] = cellMin[1] ; idx[1] < cellEnd[1] ; ++ idx[1] )
+        for( idx[0] = cellMin[0] ; idx[0] < cellEnd[0] ; ++ idx[0] )
+        {   // For each cell this patch covers...
+            mVelPatchOfCell[ idx[0] + dims[0] * ( idx[1] + dims[1] * idx[2] ) ] = unsigned( iPatch ) ;
+        }
+    }
+
+    // Assign weight of patches at each gridpoint.
+    mVelPatchWeight.Clear() ;
+    mVelPatchWeight.CopyShape( mVelGrid ) ;
+    mVelPatchWeight.InitUninitialized() ;
+    unsigned idx[3] ;
+    for( idx[2] = 0 ; idx[2] < dims[2] ; ++ idx[2] )
+    for( idx[1] = 0 ; idx[1] < dims[1] ; ++ idx[1] )
+    for( idx[0] = 0 ; idx[0] < dims[0] ; ++ idx[0] )
+    {   // For each gridpoint...
+        float weight = 1.0f ;
+        unsigned idxCell[3] ;
+        for( idxCell[2] = MAX2( idx[2] , 1u ) - 1 ; idxCell[2] <= MIN2( idx[2] , numCells[2] - 1 ) ; ++ idxCell[2] )
+        for( idxCell[1] = MAX2( idx[1] , 1u ) - 1 ; idxCell[1] <= MIN2( idx[1] , numCells[1] - 1 ) ; ++ idxCell[1] )
+        for( idxCell[0] = MAX2( idx[0] , 1u ) - 1 ; idxCell[0] <= MIN2( idx[0] , numCells[0] - 1 ) ; ++ idxCell[0] )
+        {   // For each cell adjacent to gridpoint...
+            if( ~ 0u == mVelPatchOfCell[ idxCell[0] + dims[0] * ( idxCell[1] + dims[1] * idxCell[2] ) ] )
+            {   // No patch covers this cell.
+                weight = 0.0f ;
+            }
+        }
+        mVelPatchWeight[ idx[0] + dims[0] * ( idx[1] + dims[1] * idx[2] ) ] = weight ;
+    }
+}
+
+
+
+
+/*! \brief Compute velocity due to vortons, for a subset of z-slices of velocity patches
+
+    \param isStart - index, among z-slices of all patches, of first slice to compute
+
+    \param isEnd - one past index of last slice to compute
+
+    \see ComputeVelocityPatches
+*/
+void VortonSim::ComputeVelocityPatchSlices( size_t isStart , size_t isEnd )
+{
+    size_t iPatch = 0 ;
+    for( size_t iSlice = isStart ; iSlice < isEnd ; ++ iSlice )
+    {   // For each z-slice in this subset...
+        while( mVelPatchSliceBegin[ iPatch + 1 ] <= iSlice )
+        {   // Slice belongs to a later patch.
+            ++ iPatch ;
+        }
+        UniformGrid< Vec3 > &   rPatch  = mVelPatches[ iPatch ] ;
+        const unsigned          dims[2] = { rPatch.GetNumPoints( 0 ) , rPatch.GetNumPoints( 1 ) } ;
+        unsigned                idx[3] ;
+        idx[2] = unsigned( iSlice - mVelPatchSliceBegin[ iPatch ] ) ;
+        unsigned offset = dims[0] * dims[1] * idx[2] ;
+        for( idx[1] = 0 ; idx[1] < dims[1] ; ++ idx[1] )
+        for( idx[0] = 0 ; idx[0] < dims[0] ; ++ idx[0] )
+        {   // For each point in this slice...
+            Vec3 vPosition ;
+            rPatch.PositionFromIndices( vPosition , idx ) ;
+            rPatch[ offset ] = ComputeVelocityFromVortons( vPosition ) ;
+            ++ offset ;
+        }
+    }
+}
+
+
+
+
+/*! \brief Compute velocity in patches that refine the velocity grid where it needs finer resolution
+
+    \see SetVelocityRefinement, DefineVelocityPatches, InterpolateVelocity
+
+    \note This routine assumes ComputeVelocityGrid has already executed.
+*/
+void VortonSim::ComputeVelocityPatches( void )
+{
+    if( mVelRefinement <= 1 )
+    {   // Refinement is disabled.
+        mVelPatches.Clear() ;
+        return ;
+    }
+
+    DefineVelocityPatches() ;
+
+    const size_t numSlices = mVelPatchSliceBegin[ mVelPatches.Size() ] ;
+#if USE_TBB
+    // Estimate grain size based on size of problem and number of processors.
+    const size_t grainSize =  MAX2( 1 , numSlices / gNumberOfProcessors ) ;
+    // Compute velocity in patches using multiple threads.
+    parallel_for( tbb::blocked_range<size_t>( 0 , numSlices , grainSize ) , VortonSim_ComputeVelocityPatches_TBB( this ) ) ;
+#else
+    ComputeVelocityPatchSlices( 0 , numSlices ) ;
+#endif
+}
+
+
+
+
+/*! \brief Blend velocity from the patch covering the given position into velocity interpolated from the velocity grid
+
+    \param velocity - (in) velocity interpolated from mVelGrid, or its packed copy.
+        (out) that velocity blended with the finer velocity of the patch, if any, that covers vPosition.
+
+    \param vPosition - position at which velocity was interpolated
+
+    \see DefineVelocityPatches
+*/
+void VortonSim::BlendVelocityPatch( Vec3 & velocity , const Vec3 & vPosition ) const
+{
+    if( ( 0 == mVelPatches.Size() ) || ! IsInsideGrid( vPosition , mVelGrid ) )
+    {   // No patch covers this position.
+        return ;
+    }
+    unsigned idx[3] ;
+    mVelGrid.IndicesOfPosition( idx , vPosition ) ;
+    const unsigned iPatch = mVelPatchOfCell[ idx[0] + mVelGrid.GetNumPoints( 0 ) * ( idx[1] + mVelGrid.GetNumPoints( 1 ) * idx[2] ) ] ;
+    if( ~ 0u == iPatch )
+    {   // No patch covers this cell.
+        return ;
+    }
+    float weight ;
+    mVelPatchWeight.Interpolate( weight , vPosition ) ;
+    if( weight > 0.0f )
+    {   // Patch contributes here.
+        const UniformGrid< Vec3 > & rPatch = mVelPatches[ iPatch ] ;
+        Vec3 vFineVelocity ;
+        rPatch.Interpolate( vFineVelocity , ClampToGrid( vPosition , rPatch ) ) ;
+        velocity += weight * ( vFineVelocity - velocity ) ;
+    }
+}
+
+
+
+
+/*! \brief Interpolate velocity at the given position, from the velocity grid and the finest patch that covers the position
+
+    \param velocity - (out) velocity at vPosition
+
+    \param vPosition - position at which to interpolate velocity.  Must lie within the velocity grid.
+
+    \see SetVelocityRefinement
+*/
+void VortonSim::InterpolateVelocity( Vec3 & velocity , const Vec3 & vPosition ) const
+{
+    mVelGrid.Interpolate( velocity , vPosition ) ;
+    BlendVelocityPatch( velocity , vPosition ) ;
+    AccumulatePotentialFlow( velocity , vPosition ) ;
+}
+
+
+
+
+/*! \brief Add the potential flow of translating spheres to the given velocity
+
+    \param velocity - (in) velocity due to vortons.  (out) that plus velocity due to spheres.
+
+    \param vPosition - position at which to evaluate velocity
+
+    A sphere of radius a translating with velocity U through fluid otherwise
+    at rest induces the flow of a doublet at its center,
+        u(r) = a^3 / (2 |r|^3) ( 3 (U.r^) r^ - U )
+    where r is the displacement from the center and r^ its direction.
+    At the surface, u.r^ = U.r^, so no fluid flows through the surface,
+    and the flow is irrotational, so it adds no vorticity.
+    Rotation of a sphere induces no potential flow, so only vortons can
+    convey the tangential slip that rotation causes.
+
+    Inside the sphere, where the doublet is singular, this uses the
+    sphere's velocity, which has the same normal component at the surface.
+*/
+void VortonSim::AccumulatePotentialFlow( Vec3 & velocity , const Vec3 & vPosition ) const
+{
+    const size_t numSpheres = mPotentialFlowSpheres.Size() ;
+    for( size_t iSphere = 0 ; iSphere < numSpheres ; ++ iSphere )
+    {   // For each sphere...
+        const PotentialFlowSphere & rSphere     = mPotentialFlowSpheres[ iSphere ] ;
+        const Vec3                  vDisp       = vPosition - rSphere.mCenter ;
+        const float                 dist2       = vDisp.Mag2() ;
+        const float                 radius2     = rSphere.mRadius * rSphere.mRadius ;
+        if( dist2 <= radius2 )
+        {   // Position lies inside sphere.
+            velocity += rSphere.mVelocity ;
+        }
+        else
+        {   // Position lies outside sphere.
+            const float oneOverDist2    = 1.0f / dist2 ;
+            const float ratio3          = radius2 * rSphere.mRadius * oneOverDist2 * sqrtf( oneOverDist2 ) ;   // (a/|r|)^3
+            const float velDotDisp      = rSphere.mVelocity * vDisp ;
+            velocity += 0.5f * ratio3 * ( 3.0f * velDotDisp * oneOverDist2 * vDisp - rSphere.mVelocity ) ;
+        }
+    }
+}
+
+
+
+
+/*! \brief Add the gradient of the potential flow of translating spheres to the given velocity Jacobian
+
+    \param velJac - (in) velocity Jacobian due to vortons.  (out) that plus the Jacobian of velocity due to spheres.
+
+    \param vPosition - position at which to evaluate the Jacobian
+
+    Differentiating the doublet flow that AccumulatePotentialFlow adds gives
+        du_j/dr_i = 3 a^3 / (2 |r|^5) ( U_i r_j + U_j r_i + (U.r) ( delta_ij - 5 r_i r_j / |r|^2 ) )
+    which is symmetric, since the flow is irrotational, and traceless,
+    since it is divergence-free.  So it strains, and therefore stretches
+    and tilts, vortons near a sphere without adding vorticity.
+    Inside the sphere, velocity is uniform, so its gradient is zero.
+
+    \see AccumulatePotentialFlow, StretchAndTiltVortons
+*/
+void VortonSim::AccumulatePotentialFlowJacobian( Mat33 & velJac , const Vec3 & vPosition ) const
+{
+    const size_t numSpheres = mPotentialFlowSpheres.Size() ;
+    for( size_t iSphere = 0 ; iSphere < numSpheres ; ++ iSphere )
+    {   // For each sphere...
+        const PotentialFlowSphere & rSphere     = mPotentialFlowSpheres[ iSphere ] ;
+        const Vec3                  vDisp       = vPosition - rSphere.mCenter ;
+        const float                 dist2       = vDisp.Mag2() ;
+        const float                 radius2     = rSphere.mRadius * rSphere.mRadius ;
+        if( dist2 > radius2 )
+        {   // Position lies outside sphere.
+            const float oneOverDist2    = 1.0f / dist2 ;
+            const float ratio3          = radius2 * rSphere.mRadius * oneOverDist2 * sqrtf( oneOverDist2 ) ;   // (a/|r|)^3
+            const float scale           = 1.5f * ratio3 * oneOverDist2 ;
+            const Vec3 & vel            = rSphere.mVelocity ;
+            const float velDotDisp      = vel * vDisp ;
+            const Vec3  vDispScaled     = 5.0f * velDotDisp * oneOverDist2 * vDisp ;    // Last term, before row i scales it by r_i
+            velJac.x += scale * ( vel.x * vDisp + vDisp.x * vel - vDisp.x * vDispScaled + Vec3( velDotDisp , 0.0f , 0.0f ) ) ;
+            velJac.y += scale * ( vel.y * vDisp + vDisp.y * vel - vDisp.y * vDispScaled + Vec3( 0.0f , velDotDisp , 0.0f ) ) ;
+            velJac.z += scale * ( vel.z * vDisp + vDisp.z * vel - vDisp.z * vDispScaled + Vec3( 0.0f , 0.0f , velDotDisp ) ) ;
+        }
+    }
+}
+
+
+
+
+/*! \brief Stretch and tilt vortons using velocity field
+
+    \param timeStep - amount of time by which to advance simulation
+
+    \param iStart - index of first vorton to process.  When zero, this
+        first prepares the velocity Jacobian grid and time-step bins.
+
+    \param iEnd - one past index of last vorton to process
+
+    UpdateSliced can yield between batches of vortons, so calls with
+    consecutive ranges, starting at zero, stretch and tilt every vorton.
+
+    \see AdvectVortons
+
+    \see J. T. Beale, A convergent three-dimensional vortex method with
+            grid-free stretching, Math. Comp. 46 (1986), 401-24, April.
+
+    \note This routine assumes CreateInfluenceTree has already executed.
+
+    \note When block time-stepping is enabled, this also assigns each vorton
+            whose bin is active to a new time-step bin, based on the local
+            strain rate.  It defers stretching vortons in bins finer than 0
+            to AdvectVortonsInBlockSteps.  Vortons in inactive coarse bins
+            skip evaluating the velocity gradient, and instead continue
+            the step they began when their bin was last active.
+
+    \note When ComputeVelocityDirect populated mVortonJacobians, this uses those
+            instead of interpolating the Jacobian grid.  Either way, the
+            gradient of the potential flow around spheres adds to it,
+            the same way InterpolateVelocity adds that flow to velocity.
+
+*/
+void VortonSim::StretchAndTiltVortons( const float & timeStep , size_t iStart , size_t iEnd )
+{
+    const size_t numVortons = mVortons.Size() ;
+    const bool   bDirectJacobians = ( numVortons > 0 ) && ( mVortonJacobians.Size() == numVortons ) ;
+
+    const bool is2D =   ( 0.0f == mVelGrid.GetExtent().x )
+                    ||  ( 0.0f == mVelGrid.GetExtent().y )
+                    ||  ( 0.0f == mVelGrid.GetExtent().z ) ;
+
+    if( 0 == iStart )
+    {   // First batch of this update, so prepare what every batch uses.
+        if( ! bDirectJacobians || ( mMaxTimeStepLevel > 0 ) )
+        {   // Obtain all gradients of all components of velocity.  Sub-steps of block time-stepping use the grid too.
+            GetVelocityJacobianGrid() ;
+        }
+
+        mBlockStepVortons.Clear() ;
+        mBlockStepMaxSpeed = 0.0f ;
+        if( ( mTimeStepLevels.Size() != numVortons ) || ( 0 == mMaxTimeStepLevel ) )
+        {   // Vortons were added or removed, or block time-stepping is disabled, so previous bins no longer apply.  Start over with every vorton in bin 0.
+            mTimeStepLevels.Clear() ;
+            mTimeStepLevels.Resize( numVortons , 0 ) ;
+            mStretchRates.Clear() ;
+            mStretchRates.Resize( numVortons , Vec3( 0.0f , 0.0f , 0.0f ) ) ;
+            mDriftVelocities.Clear() ;
+            mDriftVelocities.Resize( numVortons , Vec3( 0.0f , 0.0f , 0.0f ) ) ;
+            mBlockStepFrame = 0 ;
+        }
+    }
+
+    if( is2D && ( 0 == mMaxTimeStepLevel ) )
+    {   // Domain is 2D, so stretching & tilting does not occur, and all vortons take a single step.
+        return ;
+    }
+
+    mVortons.Unshare( iStart , iEnd ) ;
+    for( size_t offset = iStart ; offset < iEnd ; ++ offset )
+    {   // For each vorton in this batch...
+        Vorton &    rVorton     = mVortons.GetUnshared( offset ) ;
+        if( ! IsTimeStepBinActive( mTimeStepLevels[ offset ] ) )
+        {   // Vorton is in a coarse bin which is inactive this frame, so continue its step at the rate it had when its bin was last active.
+            rVorton.mVorticity += /* fudge factor for stability */ 0.5f * mStretchRates[ offset ] * timeStep ;
+            continue ;
+        }
+
+        Mat33       velJac      ;
+        if( bDirectJacobians )
+        {
+            velJac = mVortonJacobians[ offset ] ;
+        }
+        else
+        {
+            mVelocityJacobianGrid.Interpolate( velJac , rVorton.mPosition ) ;
+        }
+        AccumulatePotentialFlowJacobian( velJac , rVorton.mPosition ) ;
+
+        if( mMaxTimeStepLevel > 0 )
+        {   // Using block time steps, so assign vorton to a time-step bin.
+            float       strainPerStep   = timeStep * StrainRate( velJac ) ;
+            unsigned    level           = 0 ;
+            while( ( strainPerStep > sMaxStrainPerStep ) && ( level < mMaxTimeStepLevel ) )
+            {   // Step is too large for local strain rate, so try the next finer bin.
+                strainPerStep *= 0.5f ;
+                ++ level ;
+            }
+            if( level > 0 )
+            {   // Vorton needs sub-steps so defer stretching to AdvectVortonsInBlockSteps.
+                mTimeStepLevels[ offset ] = static_cast< signed char >( level ) ;
+                mBlockStepVortons.PushBack( unsigned( offset ) ) ;
+                continue ;
+            }
+            // A vorton may join a coarse bin only in a frame where that bin is active, so each bin steps in unison.
+            while(      ( 2.0f * strainPerStep <= sMaxStrainPerStep ) && ( level < mMaxTimeStepLevel )
+                    &&  ( 0 == ( mBlockStepFrame & ( ( 2u << level ) - 1 ) ) ) )
+            {   // Step is small enough for local strain rate, so try the next coarser bin.
+                strainPerStep *= 2.0f ;
+                ++ level ;
+            }
+            mTimeStepLevels[ offset ] = static_cast< signed char >( - int( level ) ) ;
+        }
+
+        if( ! is2D )
+        {
+            const Vec3  stretchTilt = rVorton.mVorticity * velJac ;    // Usual way to compute stretching & tilting
+            rVorton.mVorticity += /* fudge factor for stability */ 0.5f * stretchTilt * timeStep ;
+            mStretchRates[ offset ] = stretchTilt ;
+        }
+    }
+}
+
+
+
+
+/*! \brief Diffuse vorticity globally
+
+    This uses an extremely crude approximation of viscous diffusion
+
+    \param timeStep - amount of time by which to advance simulation
+
+    \see StretchAndTiltVortons, AdvectVortons
+
+    \note This routine assumes CreateInfluenceTree has already executed.
+
+*/
+void VortonSim::DiffuseVorticityGlobally( const float & timeStep )
+{
+    const Vec3 vAvgVorticity = mAverageVorticity ;
+    mAverageVorticity = Vec3( 0.0f , 0.0f , 0.0f ) ; // Zero this, which will be used as an accumulator.
+
+    const size_t numVortons = mVortons.Size() ;
+
+    mVortons.Unshare( 0 , numVortons ) ;
+    for( unsigned offset = 0 /* Start at 0th vorton */ ; offset < numVortons ; ++ offset )
+    {   // For each vorton...
+        Vorton &    rVorton         = mVortons.GetUnshared( offset ) ;
+        Vec3 &      rVorticitySelf  = rVorton.mVorticity ;
+        // Recompute average vorticity, by summing here, then dividing after loop.
+        mAverageVorticity += rVorticitySelf ;
+        // Bring this vorton's vorticity closer to the average.
+        // This effectively exchange vorticity between vortons.
+        // This is a non-physical HACK because the exchange occuring
+        // here little bearing to physical reality.
+        // A more realistic diffusion would exchange vorticity between
+        // physically adjacent vortices in proportion to their separation.
+        // But this scheme will diffuse vorticity, and this routine does not require adjacency information.
+        const Vec3  vortDiff        = rVorticitySelf - vAvgVorticity ;
+        const Vec3  exchange        = mViscosity * timeStep * vortDiff ;    // Amount of vorticity to exchange between particles.
+        rVorticitySelf -= exchange ;    // Make "self" vorticity a little closer to "prev".
+    }
+
+    mAverageVorticity /= float( numVortons ) ; // Normalize sum to yield an average, to use in next iteration.
+}
+
+
+
+
+/*! \brief Diffuse vorticity using a particle strength exchange method.
+
+    This routine partitions space into cells using the same grid
+    as the "base vorton" grid.  Each vorton gets assigned to the
+    cell that contains it.  Then, each vorton exchanges some
+    of its vorticity with its neighbors in adjacent cells.
+
+    This routine makes some simplifying assumptions to speed execution:
+
+        -   Distance does not influence the amount of vorticity exchanged,
+            except in as much as only vortons within a certain region of
+            each other exchange vorticity.  This amounts to saying our kernel,
+            eta, is a top-hat function.
+
+        -   Theoretically, if an adjacent cell contains no vortons
+            then this simulation should generate vorticity within
+            that cell, e.g. by creating a new vorton in the adjacent cell.
+
+        -   This simulation reduces the vorticity of each vorton, alleging
+            that this vorticity is dissipated analogously to how energy
+            dissipates at Kolmogorov microscales.  This treatment is not
+            realistic but it retains qualitative characteristics that we
+            want, e.g. that the flow dissipates at a rate related to viscosity.
+            Dissipation in real flows is a more complicated phenomenon.
+
+    \see Degond & Mas-Gallic (1989): The weighted particle method for
+        convection-diffusion equations, part 1: the case of an isotropic viscosity.
+        Math. Comput., v. 53, n. 188, pp. 485-507, October.
+
+    \param timeStep - amount of time by which to advance simulation
+
+    \see StretchAndTiltVortons, AdvectVortons
+
+    \note This routine assumes CreateInfluenceTree has already executed.
+
+*/
+void VortonSim::DiffuseVorticityPSE( const float & timeStep )
+{
+    // Phase 1: Partition vortons
+
+    // IndexParticles already partitioned vortons by cell,
+    // so each cell has a range of offsets into mVortons.
+    const ParticleCellIndex & vortRef = mVortonCells ;
+
+    // Phase 2: Exchange vorticity with nearest neighbors
+
+    mVortons.Unshare( 0 , mVortons.Size() ) ;
+    const unsigned & nx     = vortRef.GetGeometry().GetNumPoints( 0 ) ;
+    const unsigned   nxm1   = nx - 1 ;
+    const unsigned & ny     = vortRef.GetGeometry().GetNumPoints( 1 ) ;
+    const unsigned   nym1   = ny - 1 ;
+    const unsigned   nxy    = nx * ny ;
+    const unsigned & nz     = vortRef.GetGeometry().GetNumPoints( 2 ) ;
+    const unsigned   nzm1   = nz - 1 ;
+    unsigned idx[3] ;
+    for( idx[2] = 0 ; idx[2] < nzm1 ; ++ idx[2] )
+    {   // For all points along z except the last...
+        const unsigned offsetZ0 = idx[2]         * nxy ;
+        const unsigned offsetZp = ( idx[2] + 1 ) * nxy ;
+        for( idx[1] = 0 ; idx[1] < nym1 ; ++ idx[1] )
+        {   // For all points along y except the last...
+            const unsigned offsetY0Z0 =   idx[1]       * nx + offsetZ0 ;
+            const unsigned offsetYpZ0 = ( idx[1] + 1 ) * nx + offsetZ0 ;
+            const unsigned offsetY0Zp =   idx[1]       * nx + offsetZp ;
+            for( idx[0] = 0 ; idx[0] < nxm1 ; ++ idx[0] )
+            {   // For all points along x except the last...
+                const unsigned offsetX0Y0Z0 = idx[0]     + offsetY0Z0 ;
+                for( unsigned ivHere = vortRef.GetCellBegin( offsetX0Y0Z0 ) ; ivHere < vortRef.GetCellEnd( offsetX0Y0Z0 ) ; ++ ivHere )
+                {   // For each vorton in this gridcell...
+                    const unsigned      vortIdxHere     = vortRef.GetParticle( ivHere ) ;
+                    Vorton &            rVortonHere     = mVortons.GetUnshared( vortIdxHere  ) ;
+                    Vec3 &              rVorticityHere  = rVortonHere.mVorticity ;
+
+                    // Diffuse vorticity with other vortons in this same cell:
+                    for( unsigned ivThere = ivHere + 1 ; ivThere < vortRef.GetCellEnd( offsetX0Y0Z0 ) ; ++ ivThere )
+                    {   // For each OTHER vorton within this same cell...
+                        const unsigned      vortIdxThere    = vortRef.GetParticle( ivThere ) ;
+                        Vorton &            rVortonThere    = mVortons.GetUnshared( vortIdxThere  ) ;
+                        Vec3 &              rVorticityThere = rVortonThere.mVorticity ;
+                        const Vec3          vortDiff        = rVorticityHere - rVorticityThere ;
+                        const Vec3          exchange        = 2.0f * mViscosity * timeStep * vortDiff ;    // Amount of vorticity to exchange between particles.
+                        rVorticityHere  -= exchange ;   // Make "here" vorticity a little closer to "there".
+                        rVorticityThere += exchange ;   // Make "there" vorticity a little closer to "here".
+                    }
+
+                    // Diffuse vorticity with vortons in adjacent cells:
+                    {
+                        const unsigned offsetXpY0Z0 = idx[0] + 1 + offsetY0Z0 ; // offset of adjacent cell in +X direction
+                        for( unsigned ivThere = vortRef.GetCellBegin( offsetXpY0Z0 ) ; ivThere < vortRef.GetCellEnd( offsetXpY0Z0 ) ; ++ ivThere )
+                        {   // For each vorton in the adjacent cell in +X direction...
+                            const unsigned      vortIdxThere    = vortRef.GetParticle( ivThere ) ;
+                            Vorton &            rVortonThere    = mVortons.GetUnshared( vortIdxThere  ) ;
+                            Vec3 &              rVorticityThere = rVortonThere.mVorticity ;
+                            const Vec3          vortDiff        = rVorticityHere - rVorticityThere ;
+                            const Vec3          exchange        = mViscosity * timeStep * vortDiff ;    // Amount of vorticity to exchange between particles.
+                            rVorticityHere  -= exchange ;   // Make "here" vorticity a little closer to "there".
+                            rVorticityThere += exchange ;   // Make "there" vorticity a little closer to "here".
+                        }
+                    }
+
+                    {
+                        const unsigned offsetX0YpZ0 = idx[0]     + offsetYpZ0 ; // offset of adjacent cell in +Y direction
+                        for( unsigned ivThere = vortRef.GetCellBegin( offsetX0YpZ0 ) ; ivThere < vortRef.GetCellEnd( offsetX0YpZ0 ) ; ++ ivThere )
+                        {   // For each vorton in the adjacent cell in +Y direction...
+                            const unsigned      vortIdxThere    = vortRef.GetParticle( ivThere ) ;
+                            Vorton &            rVortonThere    = mVortons.GetUnshared( vortIdxThere  ) ;
+                            Vec3 &              rVorticityThere = rVortonThere.mVorticity ;
+                            const Vec3          vortDiff        = rVorticityHere - rVorticityThere ;
+                            const Vec3          exchange        = mViscosity * timeStep * vortDiff ;    // Amount of vorticity to exchange between particles.
+                            rVorticityHere  -= exchange ;   // Make "here" vorticity a little closer to "there".
+                            rVorticityThere += exchange ;   // Make "there" vorticity a little closer to "here".
+                        }
+                    }
+
                     {
-                        const unsigned offsetYZ = ( clusterMinIndices[1] + increment[1] ) * numXchild + offsetZ ;
-                        for( increment[0] = 0 ; increment[0] < pClusterDims[0] ; ++ increment[0] )
-                        {
-                            const unsigned  offsetXYZ       = ( clusterMinIndices[0] + increment[0] ) + offsetYZ ;
-                            Vorton &        rVortonChild    = rChildLayer[ offsetXYZ ] ;
-                            const float     vortMag         = rVortonChild.mVorticity.Magnitude() ;
-
-                            // Aggregate vorton cluster from child layer into parent layer:
-                            rVortonParent.mPosition  += rVortonChild.mPosition * vortMag ;
-                            rVortonParent.mVorticity += rVortonChild.mVorticity ;
-                            vortAux.mVortNormSum     += vortMag ;
-                            if( rVortonChild.mRadius != 0.0f )
-                            {
-                                rVortonParent.mRadius  = rVortonChild.mRadius ;
-                            }
+                        const unsigned offsetX0Y0Zp = idx[0]     + offsetY0Zp ; // offset of adjacent cell in +Z direction
+                        for( unsigned ivThere = vortRef.GetCellBegin( offsetX0Y0Zp ) ; ivThere < vortRef.GetCellEnd( offsetX0Y0Zp ) ; ++ ivThere )
+                        {   // For each vorton in the adjacent cell in +Z direction...
+                            const unsigned      vortIdxThere    = vortRef.GetParticle( ivThere ) ;
+                            Vorton &            rVortonThere    = mVortons.GetUnshared( vortIdxThere  ) ;
+                            Vec3 &              rVorticityThere = rVortonThere.mVorticity ;
+                            const Vec3          vortDiff        = rVorticityHere - rVorticityThere ;
+                            const Vec3          exchange        = mViscosity * timeStep * vortDiff ;    // Amount of vorticity to exchange between particles.
+                            rVorticityHere  -= exchange ;   // Make "here" vorticity a little closer to "there".
+                            rVorticityThere += exchange ;   // Make "there" vorticity a little closer to "here".
                         }
                     }
+
+                    // Dissipate vorticity.  See notes in header comment.
+                    rVorticityHere  -= mViscosity * timeStep * rVorticityHere ;   // Reduce "here" vorticity.
                 }
-                // Normalize weighted position sum to obtain center-of-vorticity.
-                // (See analogous code in MakeBaseVortonGrid.)
-                rVortonParent.mPosition /= vortAux.mVortNormSum ;
             }
         }
     }
@@ -408,528 +5344,593 @@ void VortonSim::AggregateClusters( unsigned uParentLayer )
 
 
 
-/*! \brief Create nested grid vorticity influence tree
-
-    Each layer of this tree represents a simplified, aggregated version of
-    all of the information in its "child" layer, where each
-    "child" has higher resolution than its "parent".
-
-    \see MakeBaseVortonGrid, AggregateClusters
+/*! \brief Splat vorticity of vortons onto grids, one grid per chunk of vortons
 
-    Derivation:
+    \param vortGrids - (output) grids of vorticity sums, weighted by trilinear interpolation weights.
+        Each grid must have the shape of the base influence tree layer, with no contents yet.
 
-    Using conservation properties, I_0 = I_0' , I_1 = I_1' , I_2 = I_2'
+    \param weightGrids - (output) grids of sums of interpolation weights.
 
-    I_0 : wx d = w1x d1 + w2x d2
-        : wy d = w1y d1 + w2y d2
-        : wz d = w1z d1 + w2z d2
+    \param icStart - index of first chunk to splat
 
-        These 3 are not linearly independent:
-    I_1 : ( y wz - z wy ) d = ( y1 wz1 - z1 wy1 ) d1 + ( y2 wz2 - z2 wy2 ) d2
-        : ( z wx - x wz ) d = ( z1 wx1 - x1 wz1 ) d1 + ( z2 wx2 - x2 wz2 ) d2
-        : ( x wy - y wx ) d = ( x1 wy1 - y1 wx1 ) d1 + ( x2 wy2 - y2 wx2 ) d2
+    \param icEnd - one past the index of the last chunk to splat
 
-    I_2 : ( x^2 + y^2 + z^2 ) wx d = (x1^2 + y1^2 + z1^2 ) wx1 d1 + ( x2^2 + y2^2 + z2^2 ) wx2 d2
-        : ( x^2 + y^2 + z^2 ) wy d = (x1^2 + y1^2 + z1^2 ) wy1 d1 + ( x2^2 + y2^2 + z2^2 ) wy2 d2
-        : ( x^2 + y^2 + z^2 ) wz d = (x1^2 + y1^2 + z1^2 ) wz1 d1 + ( x2^2 + y2^2 + z2^2 ) wz2 d2
+    Chunk i contains the vortons in the i'th contiguous subrange of cells of mVortonCells, out of vortGrids.Size() subranges.
+    Each chunk writes only to its own grids, so chunks can splat concurrently without contention.
 
-    Can replace I_2 with its magnitude:
-              ( x^2  + y^2  + z^2  ) ( wx^2  + wy^2  + wz^2  )^(1/2) d
-            = ( x1^2 + y1^2 + z1^2 ) ( wx1^2 + w1y^2 + w1z^2 )^(1/2) d1
-            + ( x2^2 + y2^2 + z2^2 ) ( wx2^2 + w2y^2 + w2z^2 )^(1/2) d2
+    \see DiffuseVorticityGrid
 
 */
-void VortonSim::CreateInfluenceTree( void )
+void VortonSim::SplatVorticityChunks( Vector< UniformGrid< Vec3 > > & vortGrids , Vector< UniformGrid< float > > & weightGrids , size_t icStart , size_t icEnd ) const
 {
-    QUERY_PERFORMANCE_ENTER ;
-    FindBoundingBox() ; // Find axis-aligned bounding box that encloses all vortons.
-    QUERY_PERFORMANCE_EXIT( VortonSim_CreateInfluenceTree_FindBoundingBox ) ;
-
-    // Create skeletal nested grid for influence tree.
-    const size_t numVortons = mVortons.Size() ;
-    {
-        UniformGrid< Vorton >   ugSkeleton ;   ///< Uniform grid with the same size & shape as the one holding aggregated information about mVortons.
-        ugSkeleton.DefineShape( numVortons , mMinCorner , mMaxCorner , true ) ;
-        mInfluenceTree.Initialize( ugSkeleton ) ; // Create skeleton of influence tree.
-    }
-
-    QUERY_PERFORMANCE_ENTER ;
-    MakeBaseVortonGrid() ;
-    QUERY_PERFORMANCE_EXIT( VortonSim_CreateInfluenceTree_MakeBaseVortonGrid ) ;
-
-    QUERY_PERFORMANCE_ENTER ;
-    const size_t numLayers = mInfluenceTree.GetDepth() ;
-    for( unsigned int uParentLayer = 1 ; uParentLayer < numLayers ; ++ uParentLayer )
-    {   // For each layer in the influence tree...
-        AggregateClusters( uParentLayer ) ;
+    const unsigned  numCells    = unsigned( mVortonCells.GetGeometry().GetGridCapacity() ) ;
+    const size_t    numChunks   = vortGrids.Size() ;
+    for( size_t iChunk = icStart ; iChunk < icEnd ; ++ iChunk )
+    {   // For each chunk of vortons in this subset...
+        UniformGrid< Vec3 > &   rVortGrid   = vortGrids[ iChunk ] ;
+        UniformGrid< float > &  rWeightGrid = weightGrids[ iChunk ] ;
+        // Allocate and zero grids here so that happens in parallel too.
+        rVortGrid.Init( Vec3( 0.0f , 0.0f , 0.0f ) ) ;
+        rWeightGrid.Init( 0.0f ) ;
+
+        // Visit vortons in order of the cells that contain them, so consecutive vortons splat onto nearby grid points.
+        const unsigned cellStart    = unsigned( numCells *   iChunk       / numChunks ) ;
+        const unsigned cellEnd      = unsigned( numCells * ( iChunk + 1 ) / numChunks ) ;
+        for( unsigned cell = cellStart ; cell < cellEnd ; ++ cell )
+        {   // For each cell in this chunk...
+            for( unsigned iSorted = mVortonCells.GetCellBegin( cell ) ; iSorted < mVortonCells.GetCellEnd( cell ) ; ++ iSorted )
+            {   // For each vorton in this cell...
+                const Vorton & rVorton = mVortons[ mVortonCells.GetParticle( iSorted ) ] ;
+                rVortGrid.Insert( rVorton.mPosition , rVorton.mVorticity ) ;
+                rWeightGrid.Insert( rVorton.mPosition , 1.0f ) ;
+            }
+        }
     }
-    QUERY_PERFORMANCE_EXIT( VortonSim_CreateInfluenceTree_AggregateClusters ) ;
 }
 
 
 
 
-/*! \brief Compute velocity at a given point in space, due to influence of vortons
+/*! \brief Add interpolated vorticity change to (subset of) vortons
 
-    \param vPosition - point in space whose velocity to evaluate
+    \param vortChange - grid of vorticity change
 
-    \param indices - indices of cell to visit in the given layer
+    \param scale - factor by which to multiply vortChange
 
-    \param iLayer - which layer to process
+    \param ivStart - index of first vorton to update
 
-    \return velocity at vPosition, due to influence of vortons
+    \param ivEnd - one past the index of the last vorton to update
 
-    \note This is a recursive algorithm with time complexity O(log(N)). 
-            The outermost caller should pass in mInfluenceTree.GetDepth().
+    \see DiffuseVorticityGrid
 
 */
-Vec3 VortonSim::ComputeVelocity( const Vec3 & vPosition , const unsigned indices[3] , size_t iLayer )
+void VortonSim::GatherVorticitySlice( const UniformGrid< Vec3 > & vortChange , float scale , size_t ivStart , size_t ivEnd )
 {
-    UniformGrid< Vorton > & rChildLayer             = mInfluenceTree[ iLayer - 1 ] ;
-    unsigned                clusterMinIndices[3] ;
-    const unsigned *        pClusterDims             = mInfluenceTree.GetDecimations( iLayer ) ;
-    mInfluenceTree.GetChildClusterMinCornerIndex( clusterMinIndices , pClusterDims , indices ) ;
-
-    const Vec3 &            vGridMinCorner          = rChildLayer.GetMinCorner() ;
-    const Vec3              vSpacing                = rChildLayer.GetCellSpacing() ;
-    unsigned                increment[3]            ;
-    const unsigned &        numXchild               = rChildLayer.GetNumPoints( 0 ) ;
-    const unsigned          numXYchild              = numXchild * rChildLayer.GetNumPoints( 1 ) ;
-    Vec3                    velocityAccumulator( 0.0f , 0.0f , 0.0f ) ;
+    for( size_t iVorton = ivStart ; iVorton < ivEnd ; ++ iVorton )
+    {   // For each vorton in this slice...
+        Vorton & rVorton = mVortons.GetUnshared( iVorton ) ;
+        Vec3 vVortChange ;
+        vortChange.Interpolate( vVortChange , rVorton.mPosition ) ;
+        rVorton.mVorticity += scale * vVortChange ;
+    }
+}
 
-    // The larger this is, the more accurate (and slower) the evaluation.
-    // Reasonable values lie in [0.00001,4.0].
-    // Setting this to 0 leads to very bad errors, but values greater than (tiny) lead to drastic improvements.
-    // Changes in margin have a quantized effect since they effectively indicate how many additional
-    // cluster subdivisions to visit.
-    static const float  marginFactor    = 0.0001f ; // 0.4f ; // ship with this number: 0.0001f ; test with 0.4
-    // When domain is 2D in XY plane, min.z==max.z so vPos.z test below would fail unless margin.z!=0.
-    const Vec3          margin          = marginFactor * vSpacing + ( 0.0f == vSpacing.z ? Vec3(0,0,FLT_MIN) : Vec3(0,0,0) );
 
-    // For each cell of child layer in this grid cluster...
-    for( increment[2] = 0 ; increment[2] < pClusterDims[2] ; ++ increment[2] )
-    {
-        unsigned idxChild[3] ;
-        idxChild[2] = clusterMinIndices[2] + increment[2] ;
-        Vec3 vCellMinCorner , vCellMaxCorner ;
-        vCellMinCorner.z = vGridMinCorner.z + float( idxChild[2]     ) * vSpacing.z ;
-        vCellMaxCorner.z = vGridMinCorner.z + float( idxChild[2] + 1 ) * vSpacing.z ;
-        const unsigned offsetZ = idxChild[2] * numXYchild ;
-        for( increment[1] = 0 ; increment[1] < pClusterDims[1] ; ++ increment[1] )
-        {
-            idxChild[1] = clusterMinIndices[1] + increment[1] ;
-            vCellMinCorner.y = vGridMinCorner.y + float( idxChild[1]     ) * vSpacing.y ;
-            vCellMaxCorner.y = vGridMinCorner.y + float( idxChild[1] + 1 ) * vSpacing.y ;
-            const unsigned offsetYZ = idxChild[1] * numXchild + offsetZ ;
-            for( increment[0] = 0 ; increment[0] < pClusterDims[0] ; ++ increment[0] )
-            {
-                idxChild[0] = clusterMinIndices[0] + increment[0] ;
-                vCellMinCorner.x = vGridMinCorner.x + float( idxChild[0]     ) * vSpacing.x ;
-                vCellMaxCorner.x = vGridMinCorner.x + float( idxChild[0] + 1 ) * vSpacing.x ;
-                if(
-                        ( iLayer > 1 )
-                    &&  ( vPosition.x >= vCellMinCorner.x - margin.x )
-                    &&  ( vPosition.y >= vCellMinCorner.y - margin.y )
-                    &&  ( vPosition.z >= vCellMinCorner.z - margin.z )
-                    &&  ( vPosition.x <  vCellMaxCorner.x + margin.x )
-                    &&  ( vPosition.y <  vCellMaxCorner.y + margin.y )
-                    &&  ( vPosition.z <  vCellMaxCorner.z + margin.z )
-                  )
-                {   // Test position is inside childCell and currentLayer > 0...
-                    // Recurse child layer.
-                    velocityAccumulator += ComputeVelocity( vPosition , idxChild , iLayer - 1 ) ;
-                }
-                else
-                {   // Test position is outside childCell, or reached leaf node.
-                    //    Compute velocity induced by cell at corner point x.
-                    //    Accumulate influence, storing in velocityAccumulator.
-                    const unsigned  offsetXYZ       = idxChild[0] + offsetYZ ;
-                    const Vorton &  rVortonChild    = rChildLayer[ offsetXYZ ] ;
-                    VORTON_ACCUMULATE_VELOCITY( velocityAccumulator , vPosition , rVortonChild ) ;
-                }
-            }
-        }
-    }
 
-    return velocityAccumulator ;
-}
 
+/*! \brief Solve the implicit (backward Euler) diffusion equation on a grid, using conjugate gradients
 
+    \param soln - (output) solution of ( 1 - diffusivityTimesStep * Laplacian ) soln = rhs.
+        Caller must have initialized it to the same shape as rhs.
 
+    \param rhs - (in/out) right-hand side.  Upon return, this contains the residual of soln.
 
-/*! \brief Compute velocity at a given point in space, due to influence of vortons
+    \param diffusivityTimesStep - product of diffusivity (e.g. viscosity) and time step
 
-    \param vPosition - point in space
+    \return number of iterations performed
 
-    \return velocity at vPosition, due to influence of vortons
+    This starts from soln = 0 and stops once the residual norm falls by sDiffusionTolerance,
+    or after sMaxDiffusionIterations.  The operator is symmetric and positive definite,
+    so each iteration reduces the error in the norm that operator induces.  The estimate
+    therefore never grows, even when the solve stops early, which keeps diffusion stable for
+    any viscosity and time step.
 
-    \note This is a brute-force algorithm with time complexity O(N)
-            where N is the number of vortons.  This is too slow
-            for regular use but it is useful for comparisons.
+    \see DiffuseVorticityGrid, ApplyDiffusionOperator
 
 */
-Vec3 VortonSim::ComputeVelocityBruteForce( const Vec3 & vPosition )
+unsigned VortonSim::SolveDiffusionConjugateGradient( UniformGrid< Vec3 > & soln , UniformGrid< Vec3 > & rhs , float diffusivityTimesStep )
 {
-    const size_t  numVortons          = mVortons.Size() ;
-    Vec3            velocityAccumulator( 0.0f , 0.0f , 0.0f ) ;
+    const unsigned      numZ        = rhs.GetNumPoints( 2 ) ;
+    UniformGrid< Vec3 > & residual  = rhs ;
+    UniformGrid< Vec3 > direction( rhs ) ;
+    UniformGrid< Vec3 > operatorTimesDirection( rhs ) ;
+    Vector< double >    sliceDots( numZ ) ;
+    soln.Init( Vec3( 0.0f , 0.0f , 0.0f ) ) ;
+    direction.Init( Vec3( 0.0f , 0.0f , 0.0f ) ) ;
+    operatorTimesDirection.Init() ;
 
-    for( unsigned iVorton = 0 ; iVorton < numVortons ; ++ iVorton )
-    {   // For each vorton...
-        const Vorton &  rVorton = mVortons[ iVorton ] ;
-        VORTON_ACCUMULATE_VELOCITY( velocityAccumulator , vPosition , rVorton ) ;
+#if USE_TBB
+    const size_t grainSize =  MAX2( 1 , numZ / gNumberOfProcessors ) ;
+#endif
+
+    // Residual of soln = 0 is rhs, so first search along rhs.
+    double residual2 = 0.0 ;
+    for( unsigned offset = 0 ; offset < residual.Size() ; ++ offset )
+    {
+        residual2 += residual[ offset ] * residual[ offset ] ;
     }
+    const double residual2Target = POW2( sDiffusionTolerance ) * residual2 ;
+
+    double      residual2Previous   = residual2 ;
+    unsigned    iter                = 0 ;
+    for( ; ( iter < sMaxDiffusionIterations ) && ( residual2 > residual2Target ) ; ++ iter )
+    {   // For each conjugate-gradient iteration...
+        // Search along residual, made conjugate to previous search directions.
+        const float beta = float( residual2 / residual2Previous ) * ( iter > 0 ? 1.0f : 0.0f ) ;
+#if USE_TBB
+        parallel_for( tbb::blocked_range<size_t>( 0 , numZ , grainSize ) , VortonSim_UpdateConjugateGradientDirection_TBB( direction , residual , beta ) ) ;
+        parallel_for( tbb::blocked_range<size_t>( 0 , numZ , grainSize ) , VortonSim_ApplyDiffusionOperator_TBB( operatorTimesDirection , direction , diffusivityTimesStep , sliceDots ) ) ;
+#else
+        UpdateConjugateGradientDirection( direction , residual , beta , 0 , numZ ) ;
+        ApplyDiffusionOperator( operatorTimesDirection , direction , diffusivityTimesStep , sliceDots , 0 , numZ ) ;
+#endif
+        const double directionDotOperator = SumOfSlices( sliceDots ) ;
+        if( directionDotOperator <= 0.0 )
+        {   // Direction vanished, which happens only when round-off already exhausted the residual.
+            break ;
+        }
 
-    return velocityAccumulator ;
+        // Move soln to the minimum along direction.
+        const float alpha = float( residual2 / directionDotOperator ) ;
+#if USE_TBB
+        parallel_for( tbb::blocked_range<size_t>( 0 , numZ , grainSize ) , VortonSim_UpdateConjugateGradientSolution_TBB( soln , residual , direction , operatorTimesDirection , alpha , sliceDots ) ) ;
+#else
+        UpdateConjugateGradientSolution( soln , residual , direction , operatorTimesDirection , alpha , sliceDots , 0 , numZ ) ;
+#endif
+        residual2Previous   = residual2 ;
+        residual2           = SumOfSlices( sliceDots ) ;
+    }
+    return iter ;
 }
 
 
 
 
-/*! \brief Compute velocity due to vortons, for a subset of points in a uniform grid
-
-    \param izStart - starting value for z index
-
-    \param izEnd - ending value for z index
-
-    \see CreateInfluenceTree, ComputeVelocityGrid
-
-    \note This routine assumes CreateInfluenceTree has already executed,
-            and that the velocity grid has been allocated.
-
-*/
-void VortonSim::ComputeVelocityGridSlice( unsigned izStart , unsigned izEnd )
-{
-#if VELOCITY_FROM_TREE
-    const size_t        numLayers   = mInfluenceTree.GetDepth() ;
-#endif
+/*! \brief Diffuse vorticity by solving the diffusion equation on a grid.
 
-    const Vec3 &        vMinCorner  = mVelGrid.GetMinCorner() ;
-    static const float  nudge       = 1.0f - 2.0f * FLT_EPSILON ;
-    const Vec3          vSpacing    = mVelGrid.GetCellSpacing() * nudge ;
-    const unsigned      dims[3]     =   { mVelGrid.GetNumPoints( 0 )
-                                        , mVelGrid.GetNumPoints( 1 )
-                                        , mVelGrid.GetNumPoints( 2 ) } ;
-    const unsigned      numXY       = dims[0] * dims[1] ;
-    unsigned            idx[ 3 ] ;
-    for( idx[2] = izStart ; idx[2] < izEnd ; ++ idx[2] )
-    {   // For subset of z index values...
-        Vec3 vPosition ;
-        // Compute the z-coordinate of the world-space position of this gridpoint.
-        vPosition.z = vMinCorner.z + float( idx[2] ) * vSpacing.z ;
-        // Precompute the z contribution to the offset into the velocity grid.
-        const unsigned offsetZ = idx[2] * numXY ;
-        for( idx[1] = 0 ; idx[1] < dims[1] ; ++ idx[1] )
-        {   // For every gridpoint along the y-axis...
-            // Compute the y-coordinate of the world-space position of this gridpoint.
-            vPosition.y = vMinCorner.y + float( idx[1] ) * vSpacing.y ;
-            // Precompute the y contribution to the offset into the velocity grid.
-            const unsigned offsetYZ = idx[1] * dims[0] + offsetZ ;
-            for( idx[0] = 0 ; idx[0] < dims[0] ; ++ idx[0] )
-            {   // For every gridpoint along the x-axis...
-                // Compute the x-coordinate of the world-space position of this gridpoint.
-                vPosition.x = vMinCorner.x + float( idx[0] ) * vSpacing.x ;
-                // Compute the offset into the velocity grid.
-                const unsigned offsetXYZ = idx[0] + offsetYZ ;
+    This routine proceeds in phases, each of which is a regular
+    pass over either vortons or gridpoints, so each parallelizes
+    without contention:
 
-                // Compute the fluid flow velocity at this gridpoint, due to all vortons.
-            #if VELOCITY_FROM_TREE
-                static const unsigned zeros[3] = { 0 , 0 , 0 } ; // Starter indices for recursive algorithm
-                mVelGrid[ offsetXYZ ] = ComputeVelocity( vPosition , zeros , numLayers - 1  ) ;
-            #else   // Slow accurate dirrect summation algorithm
-                mVelGrid[ offsetXYZ ] = ComputeVelocityBruteForce( vPosition ) ;
-            #endif
-            }
-        }
-    }
-}
+        -   Splat: Each chunk of vortons splats its vorticity onto its own
+            grid, using trilinear weights.  Then the chunk grids get summed,
+            and normalized by the sum of weights, so each gridpoint contains
+            a local weighted average of vorton vorticity.  Gridpoints that
+            no vorton touches contain zero, i.e. irrotational fluid.
 
+        -   Diffuse: Compute the Laplacian of the vorticity grid.
+            The explicit (forward Euler) change is viscosity*timeStep times that.
+            When viscosity*timeStep is too large relative to the grid spacing,
+            the explicit step would be unstable, so this instead solves the
+            implicit (backward Euler) equation for the change, using
+            SolveDiffusionConjugateGradient.
 
+        -   Gather: Interpolate the change in vorticity at each vorton
+            and add it to that vorton.
 
+    Like DiffuseVorticityPSE, this does not create new vortons where vorticity
+    diffuses into empty regions; vorticity that diffuses toward empty regions
+    is lost from the vortons at the edge.
 
-/*! \brief Compute velocity due to vortons, for every point in a uniform grid
+    \param timeStep - amount of time by which to advance simulation
 
-    \see CreateInfluenceTree
+    \see StretchAndTiltVortons, AdvectVortons, DiffuseVorticityPSE
 
     \note This routine assumes CreateInfluenceTree has already executed.
 
 */
-void VortonSim::ComputeVelocityGrid( void )
+void VortonSim::DiffuseVorticityGrid( const float & timeStep )
 {
-    mVelGrid.Clear() ;                                  // Clear any stale velocity information
-    mVelGrid.CopyShape( mInfluenceTree[0] ) ;           // Use same shape as base vorticity grid. (Note: could differ if you want.)
-    mVelGrid.Init() ;                                   // Reserve memory for velocity grid.
+    const size_t numVortons = mVortons.Size() ;
+    if( 0 == numVortons )
+    {   // No vortons so nothing to diffuse.
+        return ;
+    }
 
-    const unsigned numZ = mVelGrid.GetNumPoints( 2 ) ;
+    // Phase 1: Splat vorticity onto grid.
 
 #if USE_TBB
-    // Estimate grain size based on size of problem and number of processors.
-    const unsigned grainSize =  MAX2( 1 , numZ / gNumberOfProcessors ) ;
-    // Compute velocity grid using multiple threads.
-    parallel_for( tbb::blocked_range<size_t>( 0 , numZ , grainSize ) , VortonSim_ComputeVelocityGrid_TBB( this ) ) ;
+    // Use a chunk per processor.  More chunks would cost memory and reduction time for no gain.
+    const size_t numChunks = MAX2( 1 , MIN2( gNumberOfProcessors , numVortons ) ) ;
 #else
-    ComputeVelocityGridSlice( 0 , numZ ) ;
+    const size_t numChunks = 1 ;
 #endif
-}
+    Vector< UniformGrid< Vec3 > >   vortGrids   ( numChunks , UniformGrid< Vec3 >( mGridGeometry ) ) ;
+    Vector< UniformGrid< float > >  weightGrids ( numChunks , UniformGrid< float >( mGridGeometry ) ) ;
+    UniformGrid< Vec3 > &           vortGrid    = vortGrids[ 0 ] ;
+    const unsigned                  numZ        = vortGrid.GetNumPoints( 2 ) ;
 
+#if USE_TBB
+    {
+        // Estimate grain size based on size of problem and number of processors.
+        const size_t grainSize =  MAX2( 1 , numZ / gNumberOfProcessors ) ;
+        parallel_for( tbb::blocked_range<size_t>( 0 , numChunks , 1 ) , VortonSim_SplatVorticity_TBB( this , vortGrids , weightGrids ) ) ;
+        parallel_for( tbb::blocked_range<size_t>( 0 , numZ , grainSize ) , VortonSim_ReduceVorticitySplats_TBB( vortGrids , weightGrids ) ) ;
+    }
+#else
+    SplatVorticityChunks( vortGrids , weightGrids , 0 , numChunks ) ;
+    ReduceVorticitySplatsSlice( vortGrids , weightGrids , 0 , numZ ) ;
+#endif
 
+    // Phase 2: Diffuse vorticity on grid.
 
+    const float             diffusivityTimesStep    = mViscosity * timeStep ;
+    const Vec3 &            vSpacing                = vortGrid.GetCellSpacing() ;
+    const float             stabilityNumber         = diffusivityTimesStep * ( ( vSpacing.x > FLT_EPSILON ? 1.0f / POW2( vSpacing.x ) : 0.0f )
+                                                                             + ( vSpacing.y > FLT_EPSILON ? 1.0f / POW2( vSpacing.y ) : 0.0f )
+                                                                             + ( vSpacing.z > FLT_EPSILON ? 1.0f / POW2( vSpacing.z ) : 0.0f ) ) ;
 
-/*! \brief Stretch and tilt vortons using velocity field
+    // The change in vorticity is diffusivityTimesStep * e, where e solves ( 1 - diffusivityTimesStep * Laplacian ) e = Laplacian( vorticity ).
+    // The explicit step is e = Laplacian( vorticity ).
+    UniformGrid< Vec3 > laplacian( vortGrid ) ;
+    laplacian.Init() ;
+#if USE_TBB
+    {
+        const size_t grainSize =  MAX2( 1 , numZ / gNumberOfProcessors ) ;
+        parallel_for( tbb::blocked_range<size_t>( 0 , numZ , grainSize ) , VortonSim_ComputeLaplacian_TBB( laplacian , vortGrid ) ) ;
+    }
+#else
+    ComputeLaplacian( laplacian , vortGrid , 0 , numZ ) ;
+#endif
 
-    \param timeStep - amount of time by which to advance simulation
+    UniformGrid< Vec3 >         implicitChange( vortGrid ) ;
+    const UniformGrid< Vec3 > * pChange = & laplacian ;
+    // Forward Euler with the 7-point Laplacian is stable when the stability number is at most 1/2.
+    if( stabilityNumber > 0.5f )
+    {   // Explicit step would be unstable, so solve the implicit equation instead.  That consumes laplacian.
+        SolveDiffusionConjugateGradient( implicitChange , laplacian , diffusivityTimesStep ) ;
+        pChange = & implicitChange ;
+    }
 
-    \param uFrame - frame counter
+    // Phase 3: Gather vorticity change back to vortons.
 
-    \see AdvectVortons
+    mVortons.Unshare( 0 , numVortons ) ;
+#if USE_TBB
+    {
+        const size_t grainSize =  MAX2( 1 , numVortons / gNumberOfProcessors ) ;
+        parallel_for( tbb::blocked_range<size_t>( 0 , numVortons , grainSize ) , VortonSim_GatherVorticity_TBB( this , * pChange , diffusivityTimesStep ) ) ;
+    }
+#else
+    GatherVorticitySlice( * pChange , diffusivityTimesStep , 0 , numVortons ) ;
+#endif
+}
 
-    \see J. T. Beale, A convergent three-dimensional vortex method with
-            grid-free stretching, Math. Comp. 46 (1986), 401-24, April.
 
-    \note This routine assumes CreateInfluenceTree has already executed.
 
-*/
-void VortonSim::StretchAndTiltVortons( const float & timeStep , const unsigned & uFrame )
-{
-    // Compute all gradients of all components of velocity.
-    UniformGrid< Mat33 > velocityJacobianGrid( mVelGrid ) ;
-    velocityJacobianGrid.Init() ;
-    ComputeJacobian( velocityJacobianGrid , mVelGrid ) ;
 
-    if(     ( 0.0f == mVelGrid.GetExtent().x )
-        ||  ( 0.0f == mVelGrid.GetExtent().y )
-        ||  ( 0.0f == mVelGrid.GetExtent().z ) )
-    {   // Domain is 2D, so stretching & tilting does not occur.
-        return ;
-    }
+/*! \brief Return whether vortons in the given time-step bin evaluate velocity this frame
 
-    const size_t numVortons = mVortons.Size() ;
+    \param level - time-step bin.  Vortons in bin -L take one step every 2^L frames.
+        Bins 0 and finer are active every frame.
 
-    for( unsigned offset = 0 ; offset < numVortons ; ++ offset )
-    {   // For each vorton...
-        Vorton &    rVorton     = mVortons[ offset ] ;
-        Mat33       velJac      ;
-        velocityJacobianGrid.Interpolate( velJac , rVorton.mPosition ) ;
-        const Vec3  stretchTilt = rVorton.mVorticity * velJac ;    // Usual way to compute stretching & tilting
-        rVorton.mVorticity += /* fudge factor for stability */ 0.5f * stretchTilt * timeStep ;
+    \see StretchAndTiltVortons, AdvectVortons
+*/
+bool VortonSim::IsTimeStepBinActive( int level ) const
+{
+    if( ( level >= 0 ) || ( unsigned( - level ) > mMaxTimeStepLevel ) )
+    {   // Vorton takes at least one step per frame, or its bin became coarser than allowed.
+        return true ;
     }
+    return 0 == ( mBlockStepFrame & ( ( 1u << - level ) - 1 ) ) ;
 }
 
 
 
 
-/*! \brief Diffuse vorticity globally
-
-    This uses an extremely crude approximation of viscous diffusion
+/*! \brief Advect vortons using velocity field
 
     \param timeStep - amount of time by which to advance simulation
 
-    \param uFrame - frame counter
+    \param iStart - index of first vorton to process
 
-    \see StretchAndTiltVortons, AdvectVortons
+    \param iEnd - one past index of last vorton to process.  When this is
+        the number of vortons, this also advances the block-step frame.
 
-    \note This routine assumes CreateInfluenceTree has already executed.
+    Vortons in inactive coarse time-step bins move with the velocity they
+    had when their bin was last active, rather than evaluating it anew.
+
+    \see ComputeVelocityGrid
 
 */
-void VortonSim::DiffuseVorticityGlobally( const float & timeStep , const unsigned & uFrame )
+void VortonSim::AdvectVortons( const float & timeStep , size_t iStart , size_t iEnd )
 {
-    const Vec3 vAvgVorticity = mAverageVorticity ;
-    mAverageVorticity = Vec3( 0.0f , 0.0f , 0.0f ) ; // Zero this, which will be used as an accumulator.
-
-    const size_t numVortons = mVortons.Size() ;
-
-    for( unsigned offset = 0 /* Start at 0th vorton */ ; offset < numVortons ; ++ offset )
-    {   // For each vorton...
-        Vorton &    rVorton         = mVortons[ offset ] ;
-        Vec3 &      rVorticitySelf  = rVorton.mVorticity ;
-        // Recompute average vorticity, by summing here, then dividing after loop.
-        mAverageVorticity += rVorticitySelf ;
-        // Bring this vorton's vorticity closer to the average.
-        // This effectively exchange vorticity between vortons.
-        // This is a non-physical HACK because the exchange occuring
-        // here little bearing to physical reality.
-        // A more realistic diffusion would exchange vorticity between
-        // physically adjacent vortices in proportion to their separation.
-        // But this scheme will diffuse vorticity, and this routine does not require adjacency information.
-        const Vec3  vortDiff        = rVorticitySelf - vAvgVorticity ;
-        const Vec3  exchange        = mViscosity * timeStep * vortDiff ;    // Amount of vorticity to exchange between particles.
-        rVorticitySelf -= exchange ;    // Make "self" vorticity a little closer to "prev".
+    const size_t numVortons         = mVortons.Size() ;
+    const bool   bVortonVelocities  = ( numVortons > 0 ) && ( mVortonVelocities.Size() == numVortons ) ;
+
+    mVortons.Unshare( iStart , iEnd ) ;
+    for( size_t offset = iStart ; offset < iEnd ; ++ offset )
+    {   // For each vorton in this batch...
+        const int level = mTimeStepLevels[ offset ] ;
+        if( level > 0 )
+        {   // Vorton takes sub-steps in AdvectVortonsInBlockSteps instead.
+            continue ;
+        }
+        Vorton & rVorton = mVortons.GetUnshared( offset ) ;
+        Vec3 velocity ;
+        if( ! IsTimeStepBinActive( level ) )
+        {   // Vorton is in a coarse bin which is inactive this frame, so continue its step.
+            velocity = mDriftVelocities[ offset ] ;
+        }
+        else if( bVortonVelocities )
+        {   // Use velocity from direct summation or P3M, plus potential flow that InterpolateVelocity would also add.
+            velocity = mVortonVelocities[ offset ] ;
+            AccumulatePotentialFlow( velocity , rVorton.mPosition ) ;
+        }
+        else
+        {
+            InterpolateVelocity( velocity , rVorton.mPosition ) ;
+        }
+        rVorton.mPosition += velocity * timeStep ;
+        rVorton.mVelocity = velocity ;  // Cache this for use in collisions with rigid bodies.
+        mDriftVelocities[ offset ] = velocity ;
     }
 
-    mAverageVorticity /= float( numVortons ) ; // Normalize sum to yield an average, to use in next iteration.
+    if( iEnd == numVortons )
+    {   // Advected last batch of vortons.
+        ++ mBlockStepFrame ;
+    }
 }
 
 
 
 
-/*! \brief Diffuse vorticity using a particle strength exchange method.
+/*! \brief Stretch, tilt and advect (subset of) vortons in fine time-step bins that are active in a given sub-step
 
-    This routine partitions space into cells using the same grid
-    as the "base vorton" grid.  Each vorton gets assigned to the
-    cell that contains it.  Then, each vorton exchanges some
-    of its vorticity with its neighbors in adjacent cells.
+    \param tickStep - duration of a sub-step of the finest bin
 
-    This routine makes some simplifying assumptions to speed execution:
+    \param iTick - index of current sub-step of the finest bin
 
-        -   Distance does not influence the amount of vorticity exchanged,
-            except in as much as only vortons within a certain region of
-            each other exchange vorticity.  This amounts to saying our kernel,
-            eta, is a top-hat function.
+    \param finestLevel - finest bin any vorton occupies this frame
 
-        -   Theoretically, if an adjacent cell contains no vortons
-            then this simulation should generate vorticity within
-            that cell, e.g. by creating a new vorton in the adjacent cell.
+    \param iStart - index into mBlockStepVortons of first vorton to process
 
-        -   This simulation reduces the vorticity of each vorton, alleging
-            that this vorticity is dissipated analogously to how energy
-            dissipates at Kolmogorov microscales.  This treatment is not
-            realistic but it retains qualitative characteristics that we
-            want, e.g. that the flow dissipates at a rate related to viscosity.
-            Dissipation in real flows is a more complicated phenomenon.
+    \param iEnd - one past the index into mBlockStepVortons of last vorton to process
 
-    \see Degond & Mas-Gallic (1989): The weighted particle method for
-        convection-diffusion equations, part 1: the case of an isotropic viscosity.
-        Math. Comput., v. 53, n. 188, pp. 485-507, October.
+    \see AdvectVortonsInBlockSteps
 
-    \param timeStep - amount of time by which to advance simulation
+*/
+void VortonSim::AdvectVortonsInBlockStepsSlice( const float & tickStep , unsigned iTick , unsigned finestLevel , size_t iStart , size_t iEnd )
+{
+    const bool          is2D            =   ( 0.0f == mVelGrid.GetExtent().x )
+                                        ||  ( 0.0f == mVelGrid.GetExtent().y )
+                                        ||  ( 0.0f == mVelGrid.GetExtent().z ) ;
+    const size_t        numInteractions = mBlockStepCurrent.Size() ;
+
+    for( size_t iBlockStep = iStart ; iBlockStep < iEnd ; ++ iBlockStep )
+    {   // For each vorton in this slice...
+        const unsigned  offset          = mBlockStepVortons[ iBlockStep ] ;
+        const unsigned  ticksPerStep    = 1u << ( finestLevel - mTimeStepLevels[ offset ] ) ;
+        if( ( iTick % ticksPerStep ) != 0 )
+        {   // Vorton's bin is inactive this sub-step.
+            continue ;
+        }
+        Vorton &        rVorton         = mVortons.GetUnshared( offset ) ;
+        const float     subStep         = tickStep * float( ticksPerStep ) ;
+        // The vorton can leave the grid during sub-steps, so clamp the position used to look up grids.
+        const Vec3      vPosInGrid      = ClampToGrid( rVorton.mPosition , mVelocityJacobianGrid ) ;
+        if( ! is2D )
+        {
+            Mat33 velJac ;
+            mVelocityJacobianGrid.Interpolate( velJac , vPosInGrid ) ;
+            AccumulatePotentialFlowJacobian( velJac , rVorton.mPosition ) ;
+            const Vec3 stretchTilt = rVorton.mVorticity * velJac ;
+            rVorton.mVorticity += /* fudge factor for stability */ 0.5f * stretchTilt * subStep ;
+        }
+        Vec3 velocity ;
+        InterpolateVelocity( velocity , vPosInGrid ) ;
+        Vec3 velocityNow ( 0.0f , 0.0f , 0.0f ) ;
+        Vec3 velocityThen( 0.0f , 0.0f , 0.0f ) ;
+        for( size_t iOther = 0 ; iOther < numInteractions ; ++ iOther )
+        {   // For each other sub-stepping vorton, replace its contribution to the grid with that from its current state.
+            if( iOther != iBlockStep )
+            {
+                VORTON_ACCUMULATE_VELOCITY( velocityNow  , rVorton.mPosition , mBlockStepCurrent[ iOther ] ) ;
+                VORTON_ACCUMULATE_VELOCITY( velocityThen , rVorton.mPosition , mBlockStepStart[ iOther ] ) ;
+            }
+        }
+        velocity += velocityNow - velocityThen ;
+        rVorton.mPosition += velocity * subStep ;
+        rVorton.mVelocity = velocity ;  // Cache this for use in collisions with rigid bodies.
+    }
+}
 
-    \param uFrame - frame counter
 
-    \see StretchAndTiltVortons, AdvectVortons
 
-    \note This routine assumes CreateInfluenceTree has already executed.
+
+/*! \brief Stretch, tilt and advect vortons in fine time-step bins
+
+    This implements hierarchical block time-stepping, where each vorton
+    belongs to a bin L and takes 2^L sub-steps of timeStep/2^L each.
+    StretchAndTiltVortons assigned the bins, from the local strain rate,
+    and AdvectVortons advanced vortons in bin 0 and coarser.
+
+    Bins advance in lockstep, in ticks of the finest bin.  Each tick, only
+    vortons in bins active that tick evaluate velocity, at their current
+    positions.  That velocity interpolates the velocity grid, which sampled
+    every vorton at the start of the frame, then replaces the contribution
+    of each other sub-stepping vorton with that of its current state, so
+    fast vortons see each other move.  Vortons in inactive bins contribute
+    from positions extrapolated along their latest velocity.  Vortons in
+    bin 0 and coarser remain where the grid sampled them, i.e. they are
+    extrapolated with zero velocity, since they move little over a frame.
+
+    \note Stretching and the choice of bin use the frame's velocity Jacobian
+            grid, without the correction that velocity gets.
+
+    \note When more than sMaxBlockStepInteractions vortons sub-step,
+            the correction would cost more than it is worth, so sub-steps
+            use the velocity grid alone.
+
+    \param timeStep - amount of time by which to advance simulation
+
+    \see StretchAndTiltVortons, AdvectVortons
 
 */
-void VortonSim::DiffuseVorticityPSE( const float & timeStep , const unsigned & uFrame )
+void VortonSim::AdvectVortonsInBlockSteps( const float & timeStep )
 {
-    // Phase 1: Partition vortons
+    const size_t    numBlockStepVortons = mBlockStepVortons.Size() ;
+    const bool      bInteract           = numBlockStepVortons <= sMaxBlockStepInteractions ;
+    unsigned        finestLevel         = 0 ;
+    const ChunkedVector< Vorton > & rVortons = mVortons ;
+
+    mBlockStepStart.Clear() ;
+    mBlockStepCurrent.Clear() ;
+    for( size_t iBlockStep = 0 ; iBlockStep < numBlockStepVortons ; ++ iBlockStep )
+    {   // For each sub-stepping vorton, find the finest bin and remember the state the velocity grid sampled.
+        const unsigned offset = mBlockStepVortons[ iBlockStep ] ;
+        finestLevel = MAX2( finestLevel , unsigned( mTimeStepLevels[ offset ] ) ) ;
+        if( bInteract )
+        {
+            mBlockStepStart.PushBack( rVortons[ offset ] ) ;
+        }
+        mVortons.Unshare( offset , offset + 1 ) ;   // Copy only the chunks that hold sub-stepping vortons, if a fork shares them.
+    }
+    mBlockStepCurrent = mBlockStepStart ;
+
+    const unsigned                  numTicks    = 1u << finestLevel ;
+    const float                     tickStep    = timeStep / float( numTicks ) ;
+    float                           maxSpeed2   = 0.0f ;
+    for( unsigned iTick = 0 ; iTick < numTicks ; ++ iTick )
+    {   // For each sub-step of the finest bin...
+        if( bInteract && ( iTick > 0 ) )
+        {   // Snapshot current state of sub-stepping vortons, so each thread reads the same values.
+            for( size_t iBlockStep = 0 ; iBlockStep < numBlockStepVortons ; ++ iBlockStep )
+            {
+                const unsigned  offset          = mBlockStepVortons[ iBlockStep ] ;
+                const Vorton &  rVorton         = rVortons[ offset ] ;
+                const unsigned  ticksPerStep    = 1u << ( finestLevel - mTimeStepLevels[ offset ] ) ;
+                const float     timeSinceStep   = tickStep * float( iTick % ticksPerStep ) ;
+                mBlockStepCurrent[ iBlockStep ].mPosition  = rVorton.mPosition + rVorton.mVelocity * timeSinceStep ;
+                mBlockStepCurrent[ iBlockStep ].mVorticity = rVorton.mVorticity ;
+            }
+        }
+#if USE_TBB
+        // Estimate grain size based on size of problem and number of processors.
+        const size_t grainSize =  MAX2( 1 , numBlockStepVortons / gNumberOfProcessors ) ;
+        // Sub-step vortons using multiple threads.
+        parallel_for( tbb::blocked_range<size_t>( 0 , numBlockStepVortons , grainSize ) , VortonSim_AdvectVortonsInBlockSteps_TBB( this , tickStep , iTick , finestLevel ) ) ;
+#else
+        AdvectVortonsInBlockStepsSlice( tickStep , iTick , finestLevel , 0 , numBlockStepVortons ) ;
+#endif
+        for( size_t iBlockStep = 0 ; iBlockStep < numBlockStepVortons ; ++ iBlockStep )
+        {   // For each sub-stepping vorton, track the fastest speed of any sub-step, so ComputeMaxDisplacementSinceIndex can bound it.
+            maxSpeed2 = MAX2( maxSpeed2 , rVortons[ mBlockStepVortons[ iBlockStep ] ].mVelocity.Mag2() ) ;
+        }
+    }
+    mBlockStepMaxSpeed = sqrtf( maxSpeed2 ) ;
 
-    // Create a spatial partition for the vortons.
-    // Each cell contains a dynamic array of integers
-    // whose values are offsets into mVortons.
-    UniformGrid< Vector< unsigned > > ugVortRef( mInfluenceTree[0] ) ;
-    ugVortRef.Init() ;
+    for( size_t iBlockStep = 0 ; iBlockStep < numBlockStepVortons ; ++ iBlockStep )
+    {   // For each sub-stepping vorton, record its latest velocity, in case it joins a coarse bin next frame.
+        const unsigned offset = mBlockStepVortons[ iBlockStep ] ;
+        mDriftVelocities[ offset ] = rVortons[ offset ].mVelocity ;
+    }
+}
 
-    const size_t numVortons = mVortons.Size() ;
 
-    for( unsigned offset = 0 /* Start at 0th vorton */ ; offset < numVortons ; ++ offset )
-    {   // For each vorton...
-        Vorton &    rVorton         = mVortons[ offset ] ;
-        // Insert the vorton's offset into the spatial partition.
-        ugVortRef[ rVorton.mPosition ].PushBack( offset ) ;
-    }
 
-    // Phase 2: Exchange vorticity with nearest neighbors
 
-    const unsigned & nx     = ugVortRef.GetNumPoints( 0 ) ;
-    const unsigned   nxm1   = nx - 1 ;
-    const unsigned & ny     = ugVortRef.GetNumPoints( 1 ) ;
-    const unsigned   nym1   = ny - 1 ;
-    const unsigned   nxy    = nx * ny ;
-    const unsigned & nz     = ugVortRef.GetNumPoints( 2 ) ;
-    const unsigned   nzm1   = nz - 1 ;
-    unsigned idx[3] ;
-    for( idx[2] = 0 ; idx[2] < nzm1 ; ++ idx[2] )
-    {   // For all points along z except the last...
-        const unsigned offsetZ0 = idx[2]         * nxy ;
-        const unsigned offsetZp = ( idx[2] + 1 ) * nxy ;
-        for( idx[1] = 0 ; idx[1] < nym1 ; ++ idx[1] )
-        {   // For all points along y except the last...
-            const unsigned offsetY0Z0 =   idx[1]       * nx + offsetZ0 ;
-            const unsigned offsetYpZ0 = ( idx[1] + 1 ) * nx + offsetZ0 ;
-            const unsigned offsetY0Zp =   idx[1]       * nx + offsetZp ;
-            for( idx[0] = 0 ; idx[0] < nxm1 ; ++ idx[0] )
-            {   // For all points along x except the last...
-                const unsigned offsetX0Y0Z0 = idx[0]     + offsetY0Z0 ;
-                for( unsigned ivHere = 0 ; ivHere < ugVortRef[ offsetX0Y0Z0 ].Size() ; ++ ivHere )
-                {   // For each vorton in this gridcell...
-                    const unsigned &    rVortIdxHere    = ugVortRef[ offsetX0Y0Z0 ][ ivHere ] ;
-                    Vorton &            rVortonHere     = mVortons[ rVortIdxHere ] ;
-                    Vec3 &              rVorticityHere  = rVortonHere.mVorticity ;
+/*! \brief Compute velocity at a subset of filament nodes, by direct summation
 
-                    // Diffuse vorticity with other vortons in this same cell:
-                    for( unsigned ivThere = ivHere + 1 ; ivThere < ugVortRef[ offsetX0Y0Z0 ].Size() ; ++ ivThere )
-                    {   // For each OTHER vorton within this same cell...
-                        const unsigned &    rVortIdxThere   = ugVortRef[ offsetX0Y0Z0 ][ ivThere ] ;
-                        Vorton &            rVortonThere    = mVortons[ rVortIdxThere ] ;
-                        Vec3 &              rVorticityThere = rVortonThere.mVorticity ;
-                        const Vec3          vortDiff        = rVorticityHere - rVorticityThere ;
-                        const Vec3          exchange        = 2.0f * mViscosity * timeStep * vortDiff ;    // Amount of vorticity to exchange between particles.
-                        rVorticityHere  -= exchange ;   // Make "here" vorticity a little closer to "there".
-                        rVorticityThere += exchange ;   // Make "there" vorticity a little closer to "here".
-                    }
+    \param nodePositions - positions of nodes of all filaments
 
-                    // Diffuse vorticity with vortons in adjacent cells:
-                    {
-                        const unsigned offsetXpY0Z0 = idx[0] + 1 + offsetY0Z0 ; // offset of adjacent cell in +X direction
-                        for( unsigned ivThere = 0 ; ivThere < ugVortRef[ offsetXpY0Z0 ].Size() ; ++ ivThere )
-                        {   // For each vorton in the adjacent cell in +X direction...
-                            const unsigned &    rVortIdxThere   = ugVortRef[ offsetXpY0Z0 ][ ivThere ] ;
-                            Vorton &            rVortonThere    = mVortons[ rVortIdxThere ] ;
-                            Vec3 &              rVorticityThere = rVortonThere.mVorticity ;
-                            const Vec3          vortDiff        = rVorticityHere - rVorticityThere ;
-                            const Vec3          exchange        = mViscosity * timeStep * vortDiff ;    // Amount of vorticity to exchange between particles.
-                            rVorticityHere  -= exchange ;   // Make "here" vorticity a little closer to "there".
-                            rVorticityThere += exchange ;   // Make "there" vorticity a little closer to "here".
-                        }
-                    }
+    \param nodeVelocities - (out) velocity at each node.  Caller must size this to match nodePositions.
 
-                    {
-                        const unsigned offsetX0YpZ0 = idx[0]     + offsetYpZ0 ; // offset of adjacent cell in +Y direction
-                        for( unsigned ivThere = 0 ; ivThere < ugVortRef[ offsetX0YpZ0 ].Size() ; ++ ivThere )
-                        {   // For each vorton in the adjacent cell in +Y direction...
-                            const unsigned &    rVortIdxThere   = ugVortRef[ offsetX0YpZ0 ][ ivThere ] ;
-                            Vorton &            rVortonThere    = mVortons[ rVortIdxThere ] ;
-                            Vec3 &              rVorticityThere = rVortonThere.mVorticity ;
-                            const Vec3          vortDiff        = rVorticityHere - rVorticityThere ;
-                            const Vec3          exchange        = mViscosity * timeStep * vortDiff ;    // Amount of vorticity to exchange between particles.
-                            rVorticityHere  -= exchange ;   // Make "here" vorticity a little closer to "there".
-                            rVorticityThere += exchange ;   // Make "there" vorticity a little closer to "here".
-                        }
-                    }
+    \param iStart - index of first node to process
 
-                    {
-                        const unsigned offsetX0Y0Zp = idx[0]     + offsetY0Zp ; // offset of adjacent cell in +Z direction
-                        for( unsigned ivThere = 0 ; ivThere < ugVortRef[ offsetX0Y0Zp ].Size() ; ++ ivThere )
-                        {   // For each vorton in the adjacent cell in +Z direction...
-                            const unsigned &    rVortIdxThere   = ugVortRef[ offsetX0Y0Zp ][ ivThere ] ;
-                            Vorton &            rVortonThere    = mVortons[ rVortIdxThere ] ;
-                            Vec3 &              rVorticityThere = rVortonThere.mVorticity ;
-                            const Vec3          vortDiff        = rVorticityHere - rVorticityThere ;
-                            const Vec3          exchange        = mViscosity * timeStep * vortDiff ;    // Amount of vorticity to exchange between particles.
-                            rVorticityHere  -= exchange ;   // Make "here" vorticity a little closer to "there".
-                            rVorticityThere += exchange ;   // Make "there" vorticity a little closer to "here".
-                        }
-                    }
+    \param iEnd - one past index of last node to process
 
-                    // Dissipate vorticity.  See notes in header comment.
-                    rVorticityHere  -= mViscosity * timeStep * rVorticityHere ;   // Reduce "here" vorticity.
-                }
-            }
-        }
+    \see AdvectFilaments
+
+*/
+void VortonSim::ComputeFilamentVelocitiesSlice( const Vector< Vec3 > & nodePositions , Vector< Vec3 > & nodeVelocities , size_t iStart , size_t iEnd )
+{
+    for( size_t iNode = iStart ; iNode < iEnd ; ++ iNode )
+    {   // For each node in this subset...
+        nodeVelocities[ iNode ] = ComputeVelocityBruteForce( nodePositions[ iNode ] ) ;
     }
 }
 
 
 
 
-/*! \brief Advect vortons using velocity field
+/*! \brief Advect vortex filaments, then refine them
 
     \param timeStep - amount of time by which to advance simulation
 
-    \see ComputeVelocityGrid
+    Advecting nodes stretches and tilts segments, so filaments need no
+    counterpart to StretchAndTiltVortons.  Viscosity spreads each core
+    as it would spread a Lamb-Oseen vortex.  Refining afterwards keeps
+    segment lengths bounded, and this discards filaments that collapse.
+
+    Unlike vortons and tracers, nodes do not sample the velocity grid.
+    Interpolating a Cartesian grid makes the self-induced speed of a ring
+    vary around its circumference by several percent, and since filaments
+    neither diffuse nor exchange vorticity, that variation would grow into
+    kinks which stretching then amplifies.  Instead, nodes sum influence
+    directly, using the segment kernel for filaments.  That costs time
+    proportional to the number of nodes times the number of sources,
+    which is affordable because filaments need so few nodes.
+
+    \see ComputeVelocityBruteForce, VortexFilament::Refine
 
 */
-void VortonSim::AdvectVortons( const float & timeStep )
+void VortonSim::AdvectFilaments( const float & timeStep )
 {
-    const size_t numVortons = mVortons.Size() ;
+    // Gather all nodes, so every node samples velocity before any node moves.
+    Vector< Vec3 > nodePositions ;
+    const size_t numFilaments = mFilaments.Size() ;
+    for( size_t iFilament = 0 ; iFilament < numFilaments ; ++ iFilament )
+    {   // For each vortex filament...
+        const Vector< Vec3 > &  rNodes      = mFilaments[ iFilament ].mNodes ;
+        const size_t            numFilNodes = rNodes.Size() ;
+        for( size_t iNode = 0 ; iNode < numFilNodes ; ++ iNode )
+        {   // For each node of filament...
+            nodePositions.PushBack( rNodes[ iNode ] ) ;
+        }
+    }
+    const size_t numNodes = nodePositions.Size() ;
+    Vector< Vec3 > nodeVelocities ;
+    nodeVelocities.Resize( numNodes ) ;
 
-    for( unsigned offset = 0 ; offset < numVortons ; ++ offset )
-    {   // For each vorton...
-        Vorton & rVorton = mVortons[ offset ] ;
-        Vec3 velocity ;
-        mVelGrid.Interpolate( velocity , rVorton.mPosition ) ;
-        rVorton.mPosition += velocity * timeStep ;
-        rVorton.mVelocity = velocity ;  // Cache this for use in collisions with rigid bodies.
+#if USE_TBB
+    // Estimate grain size based on size of problem and number of processors.
+    const size_t grainSize =  MAX2( 1 , numNodes / gNumberOfProcessors ) ;
+    // Compute node velocities using multiple threads.
+    parallel_for( tbb::blocked_range<size_t>( 0 , numNodes , grainSize ) , VortonSim_ComputeFilamentVelocities_TBB( this , nodePositions , nodeVelocities ) ) ;
+#else
+    ComputeFilamentVelocitiesSlice( nodePositions , nodeVelocities , 0 , numNodes ) ;
+#endif
+
+    size_t iNodeAll = 0 ;
+    for( size_t iFilament = 0 ; iFilament < mFilaments.Size() ; )
+    {   // For each vortex filament...
+        VortexFilament &    rFilament       = mFilaments[ iFilament ] ;
+        const size_t        numFilNodes     = rFilament.mNodes.Size() ;
+        for( size_t iNode = 0 ; iNode < numFilNodes ; ++ iNode , ++ iNodeAll )
+        {   // For each node of filament...
+            rFilament.mNodes[ iNode ] += nodeVelocities[ iNodeAll ] * timeStep ;
+        }
+        rFilament.mCoreRadius = sqrtf( POW2( rFilament.mCoreRadius ) + 4.0f * mViscosity * timeStep ) ;
+        if( rFilament.Refine() )
+        {   // Filament survived refinement.
+            ++ iFilament ;
+        }
+        else
+        {   // Filament collapsed, so discard it.
+            // Moving the last filament into this slot is safe because its nodes have already moved.
+            mFilaments[ iFilament ] = mFilaments[ mFilaments.Size() - 1 ] ;
+            mFilaments.PopBack() ;
+        }
     }
 }
 
@@ -951,11 +5952,30 @@ void VortonSim::AdvectVortons( const float & timeStep )
 */
 void VortonSim::AdvectTracersSlice( const float & timeStep , const unsigned & uFrame ,  unsigned itStart , unsigned itEnd )
 {
+    SparseUniformGrid< Vec3 >::BlockCache farVelCache ;   // Tracers near each other often share a block.
+    const bool          bPacked = mPackedVelGrid.Size() > 0 ;
+    const UnpackFloat4  unpack( mVelGridPrecision ) ;
     for( unsigned offset = itStart ; offset < itEnd ; ++ offset )
     {   // For each passive tracer in this slice...
-        Particle & rTracer = mTracers[ offset ] ;
+        Particle & rTracer = mTracers.GetUnshared( offset ) ;
         Vec3 velocity ;
-        mVelGrid.Interpolate( velocity , rTracer.mPosition ) ;
+        if( mTracersUnbounded && ! IsInsideGrid( rTracer.mPosition , mVelGrid ) )
+        {   // Tracer lies outside domain.
+            mFarVelGrid.Interpolate( velocity , rTracer.mPosition , farVelCache ) ;
+            AccumulatePotentialFlow( velocity , rTracer.mPosition ) ;
+        }
+        else if( bPacked )
+        {   // Read reduced-precision velocity, but blend it at full precision.
+            Float4 packet ;
+            mPackedVelGrid.InterpolateConverted( packet , rTracer.mPosition , unpack ) ;
+            velocity = Vec3( packet[0] , packet[1] , packet[2] ) ;
+            BlendVelocityPatch( velocity , rTracer.mPosition ) ;
+            AccumulatePotentialFlow( velocity , rTracer.mPosition ) ;
+        }
+        else
+        {
+            InterpolateVelocity( velocity , rTracer.mPosition ) ;
+        }
         rTracer.mPosition += velocity * timeStep ;
         rTracer.mVelocity  = velocity ; // Cache for use in collisions
     }
@@ -970,59 +5990,338 @@ void VortonSim::AdvectTracersSlice( const float & timeStep , const unsigned & uF
 
     \param uFrame - frame counter
 
+    \param iStart - index of first tracer to process
+
+    \param iEnd - one past index of last tracer to process
+
     \see AdvectVortons
 
 */
-void VortonSim::AdvectTracers( const float & timeStep , const unsigned & uFrame )
+void VortonSim::AdvectTracers( const float & timeStep , const unsigned & uFrame , size_t iStart , size_t iEnd )
 {
-    const size_t numTracers = mTracers.Size() ;
-
+    mTracers.Unshare( iStart , iEnd ) ;
 #if USE_TBB
     // Estimate grain size based on size of problem and number of processors.
-    const size_t grainSize =  MAX2( 1 , numTracers / gNumberOfProcessors ) ;
+    const size_t grainSize =  MAX2( 1 , ( iEnd - iStart ) / gNumberOfProcessors ) ;
     // Advect tracers using multiple threads.
-    parallel_for( tbb::blocked_range<size_t>( 0 , numTracers , grainSize ) , VortonSim_AdvectTracers_TBB( this , timeStep , uFrame ) ) ;
+    parallel_for( tbb::blocked_range<size_t>( iStart , iEnd , grainSize ) , VortonSim_AdvectTracers_TBB( this , timeStep , uFrame ) ) ;
 #else
-    AdvectTracersSlice( timeStep , uFrame , 0 , numTracers ) ;
+    AdvectTracersSlice( timeStep , uFrame , iStart , iEnd ) ;
 #endif
 }
 
 
 
 
+/*! \brief Return one past the index of the last particle in the next batch of a stage that visits each particle
+
+    \param numParticles - number of vortons or tracers the stage visits
+
+    Each batch starts at mUpdateParticleNext and spans whole chunks,
+    enough that the stage takes about sNumParticleBatches batches.
+
+    \see FinishParticleBatch, UpdateSliced
+*/
+size_t VortonSim::GetParticleBatchEnd( size_t numParticles ) const
+{
+    static const size_t sChunkShift = ChunkedVector< Particle >::CHUNK_SHIFT ;  // Vortons and tracers have the same chunk size.
+    const size_t numChunks      = ( numParticles + ( size_t( 1 ) << sChunkShift ) - 1 ) >> sChunkShift ;
+    const size_t chunksPerBatch = MAX2( size_t( 1 ) , ( numChunks + sNumParticleBatches - 1 ) / sNumParticleBatches ) ;
+    return MIN2( numParticles , mUpdateParticleNext + ( chunksPerBatch << sChunkShift ) ) ;
+}
+
+
+
+
+/*! \brief Record that a stage that visits each particle finished a batch
+
+    \param iEnd - one past the index of the last particle the batch processed
+
+    \param numParticles - number of vortons or tracers the stage visits
+
+    \return whether the stage finished
+*/
+bool VortonSim::FinishParticleBatch( size_t iEnd , size_t numParticles )
+{
+    if( iEnd < numParticles )
+    {   // More batches remain.
+        mUpdateParticleNext = iEnd ;
+        return false ;
+    }
+    mUpdateParticleNext = 0 ;
+    return true ;
+}
+
+
+
+
+/*! \brief Perform the current stage of an update, or part of it
+
+    \param timeStep - incremental amount of time to step forward
+
+    \param uFrame - frame counter, used to generate files
+
+    \return whether the stage in mUpdateStage finished.
+        Only UPDATE_VELOCITY_GRID_TILES, and stages that visit
+        each vorton or tracer in batches, span multiple calls.
+
+    \see UpdateSliced
+*/
+bool VortonSim::RunUpdateStage( float timeStep , unsigned uFrame )
+{
+    switch( mUpdateStage )
+    {
+        case UPDATE_CREATE_INFLUENCE_TREE:
+            QUERY_PERFORMANCE_ENTER ;
+            CreateInfluenceTree() ;
+            QUERY_PERFORMANCE_EXIT( VortonSim_CreateInfluenceTree ) ;
+            break ;
+
+        case UPDATE_PACK_INFLUENCE_TREE:
+            QUERY_PERFORMANCE_ENTER ;
+            PackInfluenceTree() ;
+            QUERY_PERFORMANCE_EXIT( VortonSim_PackInfluenceTree ) ;
+            break ;
+
+        case UPDATE_BEGIN_VELOCITY_GRID:
+            QUERY_PERFORMANCE_ENTER ;
+            mUpdateTileNext = 0 ;
+            mUpdateNumTiles = BeginVelocityGrid() ? mVelocityTileOrder.Size() : 0 ;
+            QUERY_PERFORMANCE_EXIT( VortonSim_ComputeVelocityGrid ) ;
+            break ;
+
+        case UPDATE_VELOCITY_GRID_TILES:
+        {   // Compute one batch of tiles.
+            const size_t batchSize  = ( mUpdateNumTiles + sNumVelocityGridBatches - 1 ) / sNumVelocityGridBatches ;
+            const size_t iOrderEnd  = MIN2( mUpdateNumTiles , mUpdateTileNext + batchSize ) ;
+            if( mUpdateTileNext < iOrderEnd )
+            {
+                QUERY_PERFORMANCE_ENTER ;
+                ComputeVelocityGridBatch( mUpdateTileNext , iOrderEnd ) ;
+                QUERY_PERFORMANCE_EXIT( VortonSim_ComputeVelocityGrid ) ;
+            }
+            mUpdateTileNext = iOrderEnd ;
+            return mUpdateTileNext >= mUpdateNumTiles ;
+        }
+
+        case UPDATE_VELOCITY_PATCHES:
+            if( mVelGridRequired )
+            {   // Bodies or tracers read velocity, so refine it.
+                QUERY_PERFORMANCE_ENTER ;
+                ComputeVelocityPatches() ;
+                QUERY_PERFORMANCE_EXIT( VortonSim_ComputeVelocityPatches ) ;
+            }
+            break ;
+
+        case UPDATE_FAR_VELOCITY_GRID:
+            if( mTracersUnbounded && mVelGridRequired )
+            {   // Some tracers might lie outside velocity grid.
+                QUERY_PERFORMANCE_ENTER ;
+                ComputeFarVelocityGrid() ;
+                QUERY_PERFORMANCE_EXIT( VortonSim_ComputeFarVelocityGrid ) ;
+            }
+            break ;
+
+        case UPDATE_VELOCITY_DIRECT:
+            QUERY_PERFORMANCE_ENTER ;
+            ComputeVelocityDirect() ;
+            QUERY_PERFORMANCE_EXIT( VortonSim_ComputeVelocityDirect ) ;
+            break ;
+
+        case UPDATE_STRETCH_AND_TILT:
+        {   // Stretch and tilt one batch of vortons.
+            const size_t numVortons = mVortons.Size() ;
+            const size_t iEnd       = GetParticleBatchEnd( numVortons ) ;
+            QUERY_PERFORMANCE_ENTER ;
+            StretchAndTiltVortons( timeStep , mUpdateParticleNext , iEnd ) ;
+            QUERY_PERFORMANCE_EXIT( VortonSim_StretchAndTiltVortons ) ;
+            return FinishParticleBatch( iEnd , numVortons ) ;
+        }
+
+        case UPDATE_DIFFUSE:
+            QUERY_PERFORMANCE_ENTER ;
+            switch( mDiffusionScheme )
+            {
+                case DIFFUSION_GLOBAL   : DiffuseVorticityGlobally( timeStep ) ; break ;
+                case DIFFUSION_PSE      : DiffuseVorticityPSE( timeStep ) ;      break ;
+                case DIFFUSION_GRID     : DiffuseVorticityGrid( timeStep ) ;     break ;
+            }
+            QUERY_PERFORMANCE_EXIT( VortonSim_DiffuseVorticity ) ;
+            break ;
+
+        case UPDATE_ADVECT_VORTONS:
+        {   // Advect one batch of vortons.
+            const size_t numVortons = mVortons.Size() ;
+            const size_t iEnd       = GetParticleBatchEnd( numVortons ) ;
+            QUERY_PERFORMANCE_ENTER ;
+            AdvectVortons( timeStep , mUpdateParticleNext , iEnd ) ;
+            QUERY_PERFORMANCE_EXIT( VortonSim_AdvectVortons ) ;
+            return FinishParticleBatch( iEnd , numVortons ) ;
+        }
+
+        case UPDATE_ADVECT_VORTONS_IN_BLOCK_STEPS:
+            if( mBlockStepVortons.Size() > 0 )
+            {   // Some vortons need sub-steps.
+                QUERY_PERFORMANCE_ENTER ;
+                AdvectVortonsInBlockSteps( timeStep ) ;
+                QUERY_PERFORMANCE_EXIT( VortonSim_AdvectVortonsInBlockSteps ) ;
+            }
+            break ;
+
+        case UPDATE_ADVECT_FILAMENTS:
+            if( mFilaments.Size() > 0 )
+            {
+                QUERY_PERFORMANCE_ENTER ;
+                AdvectFilaments( timeStep ) ;
+                QUERY_PERFORMANCE_EXIT( VortonSim_AdvectFilaments ) ;
+            }
+            break ;
+
+        case UPDATE_ADVECT_TRACERS:
+        {   // Advect one batch of tracers.
+            const size_t numTracers = mTracers.Size() ;
+            const size_t iEnd       = GetParticleBatchEnd( numTracers ) ;
+            QUERY_PERFORMANCE_ENTER ;
+            AdvectTracers( timeStep , uFrame , mUpdateParticleNext , iEnd ) ;
+            QUERY_PERFORMANCE_EXIT( VortonSim_AdvectTracers ) ;
+            return FinishParticleBatch( iEnd , numTracers ) ;
+        }
+
+        case UPDATE_NUM_STAGES:
+            break ;
+    }
+    return true ;
+}
+
+
+
+
+/*! \brief Advance an update of the vortex particle fluid simulation, stopping early if a deadline passes
+
+    \param timeStep - incremental amount of time to step forward
+
+    \param uFrame - frame counter, used to generate files
+
+    \param deadlineSeconds - wall-clock time, as QueryPerformanceSeconds reports it,
+        after which to yield rather than start more work.
+
+    \return whether the update finished.  If not, call again, with the same
+        timeStep and uFrame, to resume it where it left off.
+
+    An update consists of stages (see UpdateStage).  Computing the velocity
+    grid further divides into batches of tiles, and stretching, tilting and
+    advecting particles divide into batches of particle chunks.  This checks
+    the deadline between those pieces of work, and never interrupts one, so
+    it can overrun the deadline by as long as the longest piece takes.  Each
+    call performs at least one piece, so repeated calls always finish the update.
+
+    Stages before UPDATE_STRETCH_AND_TILT only read particles, and write
+    the influence tree, velocity grids and other derived data, so until
+    then, vortons and tracers hold the result of the last complete update.
+    Later stages write vortons and tracers, so while they remain in
+    progress, some particles have advanced and others have not.  Clients
+    can keep rendering them, but should checkpoint or fork only when
+    IsUpdating returns false.
+
+    \see Update, IsUpdating
+*/
+bool VortonSim::UpdateSliced( float timeStep , unsigned uFrame , double deadlineSeconds )
+{
+    do
+    {
+        if( RunUpdateStage( timeStep , uFrame ) )
+        {   // Stage finished, so move to the next one.
+            mUpdateStage = UpdateStage( mUpdateStage + 1 ) ;
+        }
+    }
+    while( ( mUpdateStage != UPDATE_NUM_STAGES ) && ( QueryPerformanceSeconds() < deadlineSeconds ) ) ;
+
+    if( mUpdateStage != UPDATE_NUM_STAGES )
+    {   // Deadline passed before update finished.
+        return false ;
+    }
+
+    mTimeSinceIndex += timeStep ;
+    mUpdateStage = UPDATE_CREATE_INFLUENCE_TREE ;
+    return true ;
+}
+
+
+
+
 /*! \brief Update vortex particle fluid simulation to next time.
 
     \param timeStep - incremental amount of time to step forward
 
     \param uFrame - frame counter, used to generate files
 
+    If UpdateSliced has an update in progress, this finishes that one.
+
 */
 void VortonSim::Update( float timeStep , unsigned uFrame )
 {
-    QUERY_PERFORMANCE_ENTER ;
-    CreateInfluenceTree() ;
-    QUERY_PERFORMANCE_EXIT( VortonSim_CreateInfluenceTree ) ;
+    UpdateSliced( timeStep , uFrame , DBL_MAX ) ;
+}
 
 
-    QUERY_PERFORMANCE_ENTER ;
-    ComputeVelocityGrid() ;
-    QUERY_PERFORMANCE_EXIT( VortonSim_ComputeVelocityGrid ) ;
 
-    QUERY_PERFORMANCE_ENTER ;
-    StretchAndTiltVortons( timeStep , uFrame ) ;
-    QUERY_PERFORMANCE_EXIT( VortonSim_StretchAndTiltVortons ) ;
 
-    QUERY_PERFORMANCE_ENTER ;
-    DiffuseVorticityPSE( timeStep , uFrame ) ;
-    QUERY_PERFORMANCE_EXIT( VortonSim_DiffuseVorticityPSE ) ;
+/*! \brief Measure how much reduced-precision storage changes velocity, relative to float32 storage
 
-    QUERY_PERFORMANCE_ENTER ;
-    AdvectVortons( timeStep ) ;
-    QUERY_PERFORMANCE_EXIT( VortonSim_AdvectVortons ) ;
+    \param rError - (out) velocity discrepancies.
 
-    QUERY_PERFORMANCE_ENTER ;
-    AdvectTracers( timeStep , uFrame ) ;
-    QUERY_PERFORMANCE_EXIT( VortonSim_AdvectTracers ) ;
+    This evaluates velocity at every gridpoint of the velocity grid twice,
+    by traversing the influence tree once reading packed layers, as
+    ComputeVelocityGrid does, and once reading only full-precision layers.
+    It also compares each gridpoint of the velocity grid with its packed copy.
+    So it costs more than ComputeVelocityGrid, and is meant for diagnostics,
+    for example to choose which layers to pack, not for every frame.
+
+    \note This routine assumes Update has already executed.  The linear
+            octree has no packed layers, so with it, tree error is zero.
+
+*/
+void VortonSim::ComputePrecisionError( PrecisionError & rError )
+{
+    static const unsigned zeros[3] = { 0 , 0 , 0 } ; // Starter indices for recursive algorithm
+    const size_t    numLayers       = mInfluenceTree.GetDepth() ;
+    const unsigned  numPoints       = unsigned( mVelGrid.Size() ) ;
+    const bool      bTreePacked     = ( numLayers > 0 ) && ( mPackedLayerBegin + 1 < numLayers ) ;
+    const bool      bGridPacked     = mPackedVelGrid.Size() > 0 ;
+    float           treeErrorSum2   = 0.0f ;
+    float           gridErrorSum2   = 0.0f ;
+    float           speedSum2       = 0.0f ;
+    rError.mTreeMax = 0.0f ;
+    rError.mGridMax = 0.0f ;
+    for( unsigned offset = 0 ; offset < numPoints ; ++ offset )
+    {   // For each gridpoint in the velocity grid...
+        const Vec3 & rVelocity = mVelGrid[ offset ] ;
+        Vec3 velFull = rVelocity ;
+        if( bTreePacked )
+        {   // Velocity grid came from packed layers.  Recompute it from full-precision layers.
+            Vec3 vPosition ;
+            mVelGrid.PositionFromOffset( vPosition , offset ) ;
+            velFull = ComputeVelocity( vPosition , zeros , numLayers - 1 , numLayers ) ;
+            const Vec3  velPacked   = ComputeVelocity( vPosition , zeros , numLayers - 1 , mPackedLayerBegin ) ;
+            const float treeError2  = ( velPacked - velFull ).Mag2() ;
+            treeErrorSum2 += treeError2 ;
+            rError.mTreeMax = MAX2( rError.mTreeMax , treeError2 ) ;
+        }
+        if( bGridPacked )
+        {   // Compare velocity grid with its packed copy.
+            const Float4 packet     = Unpack( mPackedVelGrid[ offset ] , mVelGridPrecision ) ;
+            const float  gridError2 = ( Vec3( packet[0] , packet[1] , packet[2] ) - rVelocity ).Mag2() ;
+            gridErrorSum2 += gridError2 ;
+            rError.mGridMax = MAX2( rError.mGridMax , gridError2 ) ;
+        }
+        speedSum2 += velFull.Mag2() ;
+    }
+    const float oneOverNumPoints = ( numPoints > 0 ) ? 1.0f / float( numPoints ) : 0.0f ;
+    rError.mTreeMax     = sqrtf( rError.mTreeMax ) ;
+    rError.mTreeRms     = sqrtf( treeErrorSum2 * oneOverNumPoints ) ;
+    rError.mGridMax     = sqrtf( rError.mGridMax ) ;
+    rError.mGridRms     = sqrtf( gridErrorSum2 * oneOverNumPoints ) ;
+    rError.mSpeedRms    = sqrtf( speedSum2 * oneOverNumPoints ) ;
 }
 
 
@@ -1032,14 +6331,14 @@ void VortonSim::Update( float timeStep , unsigned uFrame )
 
     \note This method assumes the influence tree skeleton has already been created,
             and the leaf layer initialized to all "zeros", meaning it contains no
-            vortons.
+            vortons.  It also assumes IndexParticles has already executed.
 */
 void VortonSim::InitializePassiveTracers( unsigned multiplier )
 {
-    const Vec3      vSpacing        = mInfluenceTree[0].GetCellSpacing() ;
+    const Vec3      vSpacing        = mGridGeometry.GetCellSpacing() ;
     // Must keep tracers away from maximal boundary by at least cell.  Note the +vHalfSpacing in loop.
-    const unsigned  begin[3]        = { 1*mInfluenceTree[0].GetNumCells(0)/8 , 1*mInfluenceTree[0].GetNumCells(1)/8 , 1*mInfluenceTree[0].GetNumCells(2)/8 } ;
-    const unsigned  end[3]          = { 7*mInfluenceTree[0].GetNumCells(0)/8 , 7*mInfluenceTree[0].GetNumCells(1)/8 , 7*mInfluenceTree[0].GetNumCells(2)/8 } ;
+    const unsigned  begin[3]        = { 1*mGridGeometry.GetNumCells(0)/8 , 1*mGridGeometry.GetNumCells(1)/8 , 1*mGridGeometry.GetNumCells(2)/8 } ;
+    const unsigned  end[3]          = { 7*mGridGeometry.GetNumCells(0)/8 , 7*mGridGeometry.GetNumCells(1)/8 , 7*mGridGeometry.GetNumCells(2)/8 } ;
     const float     pclSize         = 2.0f * powf( vSpacing.x * vSpacing.y * vSpacing.z , 2.0f / 3.0f ) / float( multiplier ) ;
     const Vec3      noise           = vSpacing / float( multiplier ) ;
     unsigned        idx[3]          ;
@@ -1051,7 +6350,7 @@ void VortonSim::InitializePassiveTracers( unsigned multiplier )
     for( idx[0] = begin[0] ; idx[0] <= end[0] ; ++ idx[0] )
     {   // For each interior grid cell...
         Vec3 vPosMinCorner ;
-        mInfluenceTree[0].PositionFromIndices( vPosMinCorner , idx ) ;
+        mGridGeometry.PositionFromIndices( vPosMinCorner , idx ) ;
         Particle pcl ;
         pcl.mVelocity	        = Vec3( 0.0f , 0.0f , 0.0f ) ;
         pcl.mOrientation	    = Vec3( 0.0f , 0.0f , 0.0f ) ;
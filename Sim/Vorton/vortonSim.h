@@ -11,11 +11,20 @@
 #define VORTON_SIM_H
 
 #include <math.h>
+#include <stdio.h>
 
 #include "useTbb.h"
 
+#include "Core/Math/mat33.h"
+#include "Core/Memory/chunkedVector.h"
 #include "Space/nestedGrid.h"
+#include "Space/linearOctree.h"
+#include "Space/sparseUniformGrid.h"
+#include "Space/particleCellIndex.h"
+#include "Space/uniformGridMath.h"
 #include "vorton.h"
+#include "vortexFilament.h"
+#include "vortonClusterAux.h"
 #include "particle.h"
 
 // Macros --------------------------------------------------------------
@@ -33,24 +42,189 @@
 class VortonSim
 {
     public:
+        static const unsigned MAX_TIME_STEP_LEVEL = 7 ;   ///< Largest magnitude of time-step bin, so 2^level fits the signed char that holds each vorton's bin
+
+        /*! \brief Method used to approximate viscous diffusion of vorticity
+
+            \see DiffuseVorticityGlobally, DiffuseVorticityPSE, DiffuseVorticityGrid
+        */
+        enum DiffusionScheme
+        {
+            DIFFUSION_GLOBAL    ,   ///< Relax each vorton toward the global average vorticity.  Cheap but non-physical.
+            DIFFUSION_PSE       ,   ///< Exchange vorticity between vortons in adjacent cells (particle strength exchange).
+            DIFFUSION_GRID          ///< Splat vorticity onto a grid, diffuse it there, and gather the change back to vortons.
+        } ;
+
+        /*! \brief Spatial partition used to aggregate vortons and compute velocity from them
+
+            \see CreateInfluenceTree, CreateInfluenceOctree
+        */
+        enum InfluenceStructure
+        {
+            INFLUENCE_NESTED_GRID   ,   ///< Dense nested grid.  Every cell of every layer exists, occupied or not.
+            INFLUENCE_LINEAR_OCTREE     ///< Sparse linear octree.  Only occupied cells exist, so cost scales with occupied volume.
+        } ;
+
+        /*! \brief Method used to compute the velocity grid and the velocity at each vorton
+
+            \see ComputeVelocityGrid, ComputeVelocityP3M
+        */
+        enum VelocitySolver
+        {
+            VELOCITY_SOLVER_TREE    ,   ///< Traverse the influence tree for each gridpoint, and interpolate the grid at each vorton.
+            VELOCITY_SOLVER_P3M         ///< Particle-particle/particle-mesh: solve a Poisson equation on a mesh for the far field, and sum nearby vortons for the near field.
+        } ;
+
+        /*! \brief Quantity derived from the velocity grid
+
+            VortonSim computes each derived field only when something requests
+            it, and only for the z-slices requested, then keeps it until the
+            velocity grid changes.  So every consumer within a frame shares
+            one copy, and no field gets computed that nobody reads.
+
+            \see UpdateDerivedField, GetVelocityJacobianGrid, GetVorticityGrid, GetDivergenceGrid, GetStrainRateGrid
+        */
+        enum DerivedField
+        {
+            DERIVED_VELOCITY_JACOBIAN   ,   ///< Velocity gradient, where element a.b = d v.b / d a.  Other fields derive from this.
+            DERIVED_VORTICITY           ,   ///< Curl of velocity
+            DERIVED_DIVERGENCE          ,   ///< Divergence of velocity
+            DERIVED_STRAIN_RATE         ,   ///< Magnitude of the rate-of-strain tensor
+            NUM_DERIVED_FIELDS
+        } ;
+
+        /*! \brief Discrepancy between velocity computed with reduced-precision storage and with float32 storage
+
+            \see ComputePrecisionError
+        */
+        struct PrecisionError
+        {
+            float   mTreeMax    ;   ///< Largest magnitude of velocity error due to packed influence tree layers
+            float   mTreeRms    ;   ///< Root-mean-square magnitude of velocity error due to packed influence tree layers
+            float   mGridMax    ;   ///< Largest magnitude of velocity error due to packed velocity grid
+            float   mGridRms    ;   ///< Root-mean-square magnitude of velocity error due to packed velocity grid
+            float   mSpeedRms   ;   ///< Root-mean-square speed, computed at float32 precision, to which to compare errors
+        } ;
+
+        /*! \brief Cell in a layer of the nested-grid influence tree
+        */
+        struct TreeCell
+        {
+            unsigned    mLayer          ;   ///< Layer of influence tree.  Zero means leaves.
+            unsigned    mIndices[ 3 ]   ;   ///< Indices of cell within that layer
+        } ;
+
+        /*! \brief Clusters of the influence tree that every gridpoint in a tile of the velocity grid visits
+
+            Every gridpoint in the tile accumulates the influence of each
+            accepted cell directly.  Each open cell overlaps the tile, so each
+            gridpoint decides for itself whether to descend into it.
+
+            \see BuildTraversalCut, ComputeVelocityFromCut
+        */
+        struct TraversalCut
+        {
+            Vector< TreeCell >  mAccepted   ;   ///< Cells whose aggregate influence every gridpoint in the tile accumulates
+            Vector< TreeCell >  mOpen       ;   ///< Cells into which some, but not all, gridpoints in the tile descend
+        } ;
+
+        /*! \brief Axis-aligned box in which to refine velocity
+
+            \see AddVelocityRefinementRegion
+        */
+        struct RefinementRegion
+        {
+            Vec3    mMinCorner  ;   ///< Minimal corner of box
+            Vec3    mMaxCorner  ;   ///< Maximal corner of box
+        } ;
+
+        /*! \brief Sphere translating through the fluid, whose potential flow adds to the velocity vortons induce
+
+            \see AddPotentialFlowSphere
+        */
+        struct PotentialFlowSphere
+        {
+            Vec3    mCenter     ;   ///< Position of sphere center
+            float   mRadius     ;   ///< Sphere radius
+            Vec3    mVelocity   ;   ///< Linear velocity of sphere
+        } ;
+
         /*! \brief Construct a vorton simulation
         */
         VortonSim( float viscosity = 0.0f , float density = 1.0f )
-            : mMinCorner(FLT_MAX,FLT_MAX,FLT_MAX)
+            : mTimeSinceIndex( 0.0f )
+            , mUpdateStage( UPDATE_CREATE_INFLUENCE_TREE )
+            , mUpdateTileNext( 0 )
+            , mUpdateNumTiles( 0 )
+            , mUpdateParticleNext( 0 )
+            , mRefitTolerance( 0.0f )
+            , mRefitExtent( 0.0f , 0.0f , 0.0f )
+            , mNumRefits( 0 )
+            , mLeafCapacity( 1 )
+            , mLeafBucketLayer( 0 )
+            , mDirectSummationLimit( 0 )
+            , mDirectSummationJacobians( true )
+            , mVelGridRequired( true )
+            , mVelocitySolver( VELOCITY_SOLVER_TREE )
+            , mP3MSmoothing( 2.0f )
+            , mP3MRadius( 0.0f )
+            , mInfluenceStructure( INFLUENCE_NESTED_GRID )
+            , mTracersUnbounded( false )
+            , mTreePrecision( STORAGE_FLOAT32 )
+            , mPackedTreeMinLayer( 1 )
+            , mPackedLayerBegin( ~ size_t( 0 ) )
+            , mCacheTraversalCuts( false )
+            , mVelGridDecimation( 1 )
+            , mFiniteDifferenceScheme( FINITE_DIFFERENCE_CENTRAL2 )
+            , mVelGridPrecision( STORAGE_FLOAT32 )
+            , mVelRefinement( 1 )
+            , mVelRefinementVorticityFraction( 0.5f )
+            , mMinCorner(FLT_MAX,FLT_MAX,FLT_MAX)
             , mMaxCorner( -mMinCorner )
             , mViscosity( viscosity )
             , mCirculationInitial( 0.0f , 0.0f , 0.0f )
             , mLinearImpulseInitial( 0.0f , 0.0f , 0.0f )
             , mAverageVorticity( 0.0f , 0.0f , 0.0f )
             , mFluidDensity( density )
-            , mMassPerParticle( 0.0f )
-        {}
+            , mMassPerVorton( 0.0f )
+            , mMassPerTracer( 0.0f )
+            , mDiffusionScheme( DIFFUSION_PSE )
+            , mMaxTimeStepLevel( 0 )
+            , mBlockStepFrame( 0 )
+            , mBlockStepMaxSpeed( 0.0f )
+        {
+        }
 
         void                        Initialize( unsigned numTracersPerCellCubeRoot ) ;
-              Vector< Vorton >  &   GetVortons( void )                  { return mVortons ; }
-        const Vector< Vorton >  &   GetVortons( void ) const            { return mVortons ; }
-              Vector< Particle > &  GetTracers( void )                  { return mTracers ; }
-        const Vector< Particle > &  GetTracers( void ) const            { return mTracers ; }
+        bool                        WriteCheckpoint( FILE * pFile ) const ;
+        bool                        ReadCheckpoint( FILE * pFile ) ;
+        void                        Upsample( unsigned vortonRefinement , unsigned tracerRefinement , float perturbation , unsigned randomSeed ) ;
+        void                        Fork( VortonSim & branch ) const ;
+
+        /*! \brief Return vortons or tracers
+
+            Forks share chunks of these arrays until one writes them,
+            so non-const access to an element copies its chunk if shared.
+            Read through the const overloads to avoid that.
+
+            \see Fork, ChunkedVector
+        */
+              ChunkedVector< Vorton >   &   GetVortons( void )          { return mVortons ; }
+        const ChunkedVector< Vorton >   &   GetVortons( void ) const    { return mVortons ; }
+              ChunkedVector< Particle > &   GetTracers( void )          { return mTracers ; }
+        const ChunkedVector< Particle > &   GetTracers( void ) const    { return mTracers ; }
+
+        /*! \brief Return vortex filaments, which coexist with vortons
+
+            Segments of filaments aggregate into the influence tree alongside
+            vortons, so each influences vortons, tracers and other filaments.
+            While filaments exist, CreateInfluenceTree always rebuilds a nested
+            grid, since both the octree and refitting track only vortons.
+
+            \see AdvectFilaments, VortexFilament
+        */
+              Vector< VortexFilament > & GetFilaments( void )           { return mFilaments ; }
+        const Vector< VortexFilament > & GetFilaments( void ) const     { return mFilaments ; }
 
         /*! \brief Kill the tracer at the given index
         */
@@ -63,40 +237,522 @@ class VortonSim
         const Vec3 GetTracerCenterOfMass( void ) const ;
 
         const UniformGrid< Vec3 > & GetVelocityGrid( void ) const       { return mVelGrid ; }
-        const float &               GetMassPerParticle( void ) const    { return mMassPerParticle ; }
+        const Vector< UniformGrid< Vec3 > > & GetVelocityPatches( void ) const { return mVelPatches ; }
+        void                        InterpolateVelocity( Vec3 & velocity , const Vec3 & vPosition ) const ;
+
+        /*! \brief Return fields derived from the velocity grid, computing them first if necessary
+
+            Overloads which take a region compute only the z-slices of the
+            field that interpolating within that region reads.  Values outside
+            those slices are undefined.
+
+            \see DerivedField
+        */
+        const UniformGrid< Mat33 > & GetVelocityJacobianGrid( void )   { UpdateDerivedField( DERIVED_VELOCITY_JACOBIAN , 0 , mVelGrid.GetNumPoints( 2 ) ) ; return mVelocityJacobianGrid ; }
+        const UniformGrid< Mat33 > & GetVelocityJacobianGrid( const Vec3 & vMinCorner , const Vec3 & vMaxCorner ) { UpdateDerivedField( DERIVED_VELOCITY_JACOBIAN , vMinCorner , vMaxCorner ) ; return mVelocityJacobianGrid ; }
+        const UniformGrid< Vec3 > &  GetVorticityGrid( void )          { UpdateDerivedField( DERIVED_VORTICITY , 0 , mVelGrid.GetNumPoints( 2 ) ) ; return mVorticityGrid ; }
+        const UniformGrid< Vec3 > &  GetVorticityGrid( const Vec3 & vMinCorner , const Vec3 & vMaxCorner ) { UpdateDerivedField( DERIVED_VORTICITY , vMinCorner , vMaxCorner ) ; return mVorticityGrid ; }
+        const UniformGrid< float > & GetDivergenceGrid( void )         { UpdateDerivedField( DERIVED_DIVERGENCE , 0 , mVelGrid.GetNumPoints( 2 ) ) ; return mDivergenceGrid ; }
+        const UniformGrid< float > & GetDivergenceGrid( const Vec3 & vMinCorner , const Vec3 & vMaxCorner ) { UpdateDerivedField( DERIVED_DIVERGENCE , vMinCorner , vMaxCorner ) ; return mDivergenceGrid ; }
+        const UniformGrid< float > & GetStrainRateGrid( void )         { UpdateDerivedField( DERIVED_STRAIN_RATE , 0 , mVelGrid.GetNumPoints( 2 ) ) ; return mStrainRateGrid ; }
+        const UniformGrid< float > & GetStrainRateGrid( const Vec3 & vMinCorner , const Vec3 & vMaxCorner ) { UpdateDerivedField( DERIVED_STRAIN_RATE , vMinCorner , vMaxCorner ) ; return mStrainRateGrid ; }
+
+        /*! \brief Return index of which cell of the influence tree leaf layer contains each vorton
+
+            Update builds this index once, before anything else, and every stage
+            that needs to find vortons by location shares it.  Vortons advect
+            afterwards, so by the end of Update, each could lie as far as
+            ComputeMaxDisplacementSinceIndex from the cell this index records.
+
+            \see IndexParticles
+        */
+        const ParticleCellIndex &   GetVortonCellIndex( void ) const    { return mVortonCells ; }
+        const ParticleCellIndex &   GetTracerCellIndex( void ) const    { return mTracerCells ; }
+        float                       ComputeMaxDisplacementSinceIndex( void ) const ;
+        const float &               GetMassPerVorton( void ) const      { return mMassPerVorton ; }
+        const float &               GetMassPerTracer( void ) const      { return mMassPerTracer ; }
+        void                        SetDiffusionScheme( DiffusionScheme scheme ) { mDiffusionScheme = scheme ; }
+        DiffusionScheme             GetDiffusionScheme( void ) const    { return mDiffusionScheme ; }
+
+        /*! \brief Set the finest and coarsest time-step bins into which vortons may go
+
+            Vortons in bin L take 2^L sub-steps per frame, and vortons in
+            bin -L take one step every 2^L frames.  Zero disables block
+            time-stepping, so every vorton takes a single step per frame.
+            Levels above MAX_TIME_STEP_LEVEL clamp to it.
+
+            \see StretchAndTiltVortons, AdvectVortonsInBlockSteps
+        */
+        void                        SetMaxTimeStepLevel( unsigned maxLevel ) { mMaxTimeStepLevel = MIN2( maxLevel , MAX_TIME_STEP_LEVEL ) ; }
+        unsigned                    GetMaxTimeStepLevel( void ) const   { return mMaxTimeStepLevel ; }
+        void                        SetInfluenceStructure( InfluenceStructure structure ) { mInfluenceStructure = structure ; }
+        InfluenceStructure          GetInfluenceStructure( void ) const { return mInfluenceStructure ; }
+
+        /*! \brief Set the method with which to compute the velocity grid and the velocity at each vorton
+
+            \param solver - method to use
+
+            \param smoothing - for VELOCITY_SOLVER_P3M, radius, in velocity grid cells, of the blob
+                into which the mesh spreads each vorton.  Vortons nearer than this to each other,
+                or to a gridpoint, interact directly.  Larger values cost more but resolve the
+                blobs better, so the mesh better matches the smoothed law that the near field corrects.
+                Typical values lie in [1.5,4].
+
+            VELOCITY_SOLVER_P3M applies only to 3D domains without filaments; otherwise the tree applies.
+            Velocity patches and the far velocity grid still traverse the influence tree.
+
+            \see ComputeVelocityP3M
+        */
+        void                        SetVelocitySolver( VelocitySolver solver , float smoothing = 2.0f ) { mVelocitySolver = solver ; mP3MSmoothing = MAX2( 1.0f , smoothing ) ; }
+        VelocitySolver              GetVelocitySolver( void ) const     { return mVelocitySolver ; }
+        float                       GetP3MSmoothing( void ) const       { return mP3MSmoothing ; }
+
+        /*! \brief Set whether tracers may leave the region that vortons occupy
+
+            When false, the simulation domain grows to contain every tracer.
+            When true, the domain contains only vortons, and tracers outside it
+            obtain velocity from a sparse grid that exists only near them, so
+            neither domain nor memory grows as tracers drift away.
+
+            \see ComputeFarVelocityGrid
+        */
+        void                        SetTracersUnbounded( bool unbounded ) { mTracersUnbounded = unbounded ; }
+        bool                        GetTracersUnbounded( void ) const   { return mTracersUnbounded ; }
+
+        /*! \brief Set how far vortons may spread before the influence tree must be rebuilt
+
+            Zero rebuilds the influence tree from scratch every frame.
+            A positive value pads the tree by that fraction of its extent
+            on each side, and later frames refit the existing tree as long
+            as the bounding box stays inside it, so they re-bin only vortons
+            that changed cells and re-aggregate only clusters that changed.
+
+            \see RefitInfluenceTree
+        */
+        void                        SetRefitTolerance( float tolerance ) { mRefitTolerance = tolerance ; }
+        float                       GetRefitTolerance( void ) const     { return mRefitTolerance ; }
+
+        /*! \brief Request that the velocity and velocity-Jacobian grids reside in large pages, when the platform provides them
+
+            Each frame streams through these grids, which are the largest,
+            so large pages spare them TLB misses.  But large pages can take
+            longer to fault in, and some platforms grant them only to
+            privileged processes, so this is off by default.
+
+            \see UniformGrid::SetLargePages
+        */
+        void                        SetLargePages( bool bUseLargePages ) { mVelGrid.SetLargePages( bUseLargePages ) ; mVelocityJacobianGrid.SetLargePages( bUseLargePages ) ; }
+        bool                        GetLargePages( void ) const         { return mVelGrid.GetLargePages() ; }
+
+        /*! \brief Set how many vortons each leaf of the influence tree should hold
+
+            With 1, each leaf cell merges its vortons into one supervorton, so
+            even the nearest vortons influence a query point only through that
+            aggregate.  A larger capacity makes traversals stop at the coarsest
+            layer whose cells hold, on average, no more than that many vortons,
+            and sum the influence of each vorton in those cells directly,
+            so only interior cells of the tree use aggregates.
+
+            Each layer has about 8 times fewer cells than the one below it,
+            so the capacity takes effect in steps: 8 to 63 stop one layer
+            above the finest, 64 to 511 two layers above, and so on.
+            Typical values lie in [8,64].
+
+            This applies only to INFLUENCE_NESTED_GRID, and only while no filaments exist.
+
+            \see GatherLeafBuckets, ComputeVelocity
+        */
+        void                        SetLeafCapacity( unsigned capacity ) { mLeafCapacity = MAX2( 1u , capacity ) ; }
+        unsigned                    GetLeafCapacity( void ) const       { return mLeafCapacity ; }
+
+        /*! \brief Set the largest number of vortons for which to compute vorton velocities by direct summation
+
+            \param maxVortons - largest number of vortons for which to sum the influence of
+                every vorton on every other vorton directly, instead of interpolating
+                velocity from grids that the influence tree populates.  0 disables direct summation.
+
+            \param bJacobians - whether direct summation also computes the velocity Jacobian at each vorton,
+                for stretching and tilting.  Otherwise stretching interpolates the Jacobian grid.
+
+            Direct summation costs O(N^2) but has no approximation error,
+            and for a few thousand vortons or fewer it takes less time than
+            traversing the tree for each point of the velocity grid.
+            When direct summation also supplies Jacobians, and block time-stepping
+            is disabled, vortons need nothing else, so updates skip the influence
+            tree and velocity grid entirely, unless tracers or bodies (which
+            request velocity refinement regions) need a velocity grid, in which
+            case they compute a coarser one.
+
+            This applies only while no filaments exist.
+
+            \see ComputeVelocityDirect
+        */
+        void                        SetDirectSummationLimit( unsigned maxVortons , bool bJacobians = true ) { mDirectSummationLimit = maxVortons ; mDirectSummationJacobians = bJacobians ; }
+        unsigned                    GetDirectSummationLimit( void ) const       { return mDirectSummationLimit ; }
+        bool                        GetDirectSummationJacobians( void ) const   { return mDirectSummationJacobians ; }
+
+        /*! \brief Set how to store coarse layers of the influence tree, for reading while computing velocity
+
+            \param precision - format in which to store layers.  STORAGE_FLOAT32 disables packing.
+
+            \param minLayer - finest layer to pack.  Layer 0 holds leaves, which
+                dominate near-field influence, so packing only coarser layers,
+                which contribute only far-field influence, limits the error.
+
+            Packed layers occupy 16 bytes per cell instead of 40, so traversals
+            stream less memory.  Arithmetic remains float32.  This applies only
+            to INFLUENCE_NESTED_GRID.
+
+            \see PackInfluenceTree, ComputePrecisionError
+        */
+        void                        SetTreePrecision( StoragePrecision precision , unsigned minLayer = 1 ) { mTreePrecision = precision ; mPackedTreeMinLayer = minLayer ; }
+        StoragePrecision            GetTreePrecision( void ) const      { return mTreePrecision ; }
+
+        /*! \brief Set how to store the velocity grid from which tracers advect
+
+            Packed velocity occupies 8 bytes per gridpoint instead of 12.
+            Only tracers read the packed grid; vortons, whose stretching and
+            advection feed back into the flow, read the float32 grid.
+
+            \see ComputePrecisionError
+        */
+        void                        SetVelocityGridPrecision( StoragePrecision precision ) { mVelGridPrecision = precision ; }
+        StoragePrecision            GetVelocityGridPrecision( void ) const { return mVelGridPrecision ; }
+
+        /*! \brief Set whether to remember which clusters each tile of the velocity grid visits
+
+            Whether ComputeVelocity descends into a cell depends only on where
+            the cell lies, not on what it contains.  So while refitting keeps
+            the geometry of the influence tree, the set of clusters each
+            gridpoint visits stays the same from frame to frame.  Caching that
+            set per tile of gridpoints lets later frames skip the decisions
+            that lead to it.  Whenever CreateInfluenceTree rebuilds the tree,
+            the next velocity grid traverses from the root again.
+
+            This applies only to INFLUENCE_NESTED_GRID, and only pays off with
+            a positive refit tolerance.
+
+            \see BuildTraversalCuts, SetRefitTolerance
+        */
+        void                        SetTraversalCutCaching( bool cache ) { mCacheTraversalCuts = cache ; }
+        bool                        GetTraversalCutCaching( void ) const { return mCacheTraversalCuts ; }
+
+        /*! \brief Set how much coarser than the leaf layer of the influence tree to make the velocity grid
+
+            Every velocity gridpoint costs a traversal of the influence tree,
+            so decimating by 2 cuts the cost of computing velocity by about 8.
+            Pair a coarser grid with a higher-order finite difference scheme
+            so stretching remains accurate.
+
+            Changing decimation changes the shape of the velocity grid,
+            so this discards its tile order and any cached traversal cuts.
+
+            \see SetFiniteDifferenceScheme, ComputeVelocityGrid
+        */
+        void                        SetVelocityGridDecimation( unsigned decimation )
+        {
+            mVelGridDecimation = MAX2( 1u , decimation ) ;
+            mVelocityTileOrder.Clear() ;
+            mTraversalCuts.Clear() ;
+        }
+        unsigned                    GetVelocityGridDecimation( void ) const { return mVelGridDecimation ; }
+
+        /*! \brief Set stencil with which to differentiate the velocity grid
+
+            This affects the velocity Jacobian, and therefore vortex stretching
+            and every other derived field.
+
+            \see FiniteDifferenceScheme, DerivedField
+        */
+        void                        SetFiniteDifferenceScheme( FiniteDifferenceScheme scheme ) { mFiniteDifferenceScheme = scheme ; InvalidateDerivedFields() ; }
+        FiniteDifferenceScheme      GetFiniteDifferenceScheme( void ) const { return mFiniteDifferenceScheme ; }
+
+        /*! \brief Set how finely to resolve velocity in patches nested within the velocity grid
+
+            Resolving thin features, such as the boundary layer around a body or
+            an intense vortex core, on the velocity grid would require refining it
+            everywhere.  Instead, patches refine it only in regions that callers
+            request with AddVelocityRefinementRegion, and around vortons whose
+            vorticity is intense.  Patches evaluate velocity from the same
+            influence tree as the velocity grid, and InterpolateVelocity blends
+            them into the velocity grid.
+
+            \param refinement - number of patch cells per velocity grid cell, along each axis.  1 disables patches.
+
+            \param vorticityFraction - fraction of the largest vorticity magnitude, above which to refine around vortons.
+                Use 1 or more to refine only requested regions.
+
+            \see ComputeVelocityPatches, InterpolateVelocity
+        */
+        void                        SetVelocityRefinement( unsigned refinement , float vorticityFraction ) { mVelRefinement = MAX2( 1u , refinement ) ; mVelRefinementVorticityFraction = vorticityFraction ; }
+        unsigned                    GetVelocityRefinement( void ) const { return mVelRefinement ; }
+
+        /*! \brief Request that subsequent updates refine velocity within the given box
+
+            Regions persist until ClearVelocityRefinementRegions, so callers
+            whose regions move, such as those following bodies, should clear
+            and add them before each update.
+        */
+        void                        AddVelocityRefinementRegion( const Vec3 & vMinCorner , const Vec3 & vMaxCorner ) { RefinementRegion region = { vMinCorner , vMaxCorner } ; mVelRefinementRegions.PushBack( region ) ; }
+        void                        ClearVelocityRefinementRegions( void ) { mVelRefinementRegions.Clear() ; }
+
+        /*! \brief Add the potential flow of a sphere translating through the fluid to subsequent velocity evaluations
+
+            InterpolateVelocity, and the advection of vortons and tracers,
+            add the flow of a doublet at the sphere center, which displaces
+            fluid around the sphere so that no fluid flows through its surface.
+            That leaves only the tangential slip at the surface for callers
+            to cancel by shedding vorticity.
+
+            Spheres persist until ClearPotentialFlowSpheres, so callers whose
+            spheres move should clear and add them before each update.
+
+            \see AccumulatePotentialFlow
+        */
+        void                        AddPotentialFlowSphere( const Vec3 & vCenter , float radius , const Vec3 & vVelocity ) { PotentialFlowSphere sphere = { vCenter , radius , vVelocity } ; mPotentialFlowSpheres.PushBack( sphere ) ; }
+        void                        ClearPotentialFlowSpheres( void ) { mPotentialFlowSpheres.Clear() ; }
+        void                        ComputePrecisionError( PrecisionError & rError ) ;
         void                        Update( float timeStep , unsigned uFrame ) ;
+        bool                        UpdateSliced( float timeStep , unsigned uFrame , double deadlineSeconds ) ;
+
+        /*! \brief Return whether UpdateSliced yielded partway through an update, which remains to finish
+        */
+        bool                        IsUpdating( void ) const { return mUpdateStage != UPDATE_CREATE_INFLUENCE_TREE ; }
         void                        Clear( void )
         {
+            mUpdateStage = UPDATE_CREATE_INFLUENCE_TREE ;
+            mUpdateParticleNext = 0 ;
             mVortons.Clear() ;
+            mFilaments.Clear() ;
+            mVortonCells.Clear() ;
+            mTracerCells.Clear() ;
             mInfluenceTree.Clear() ;
+            mInfluenceOctree.Clear() ;
+            mVortonKeys.Clear() ;
+            mPackedTree.Clear() ;
+            mPackedTreeScales.Clear() ;
+            mLeafBucketLayer = 0 ;
+            mLeafBucketBegin.Clear() ;
+            mLeafBuckets.Clear() ;
+            mDirectSources.Clear() ;
+            mDirectSums.Clear() ;
+            mVortonVelocities.Clear() ;
+            mVortonJacobians.Clear() ;
+            mP3MStreamFunction.Clear() ;
+            mP3MRhs.Clear() ;
+            mP3MResidual.Clear() ;
+            mP3MBoundarySourcePositions.Clear() ;
+            mP3MBoundarySourceStrengths.Clear() ;
+            mTraversalCuts.Clear() ;
             mVelGrid.Clear() ;
+            mPackedVelGrid.Clear() ;
+            mVelPatches.Clear() ;
+            mVelPatchOfCell.Clear() ;
+            mVelPatchWeight.Clear() ;
+            mVelRefinementRegions.Clear() ;
+            mPotentialFlowSpheres.Clear() ;
+            InvalidateDerivedFields() ;
+            mFarVelGrid.Clear() ;
             mTracers.Clear() ;
         }
 
+        static void UnitTest( void ) ;
+
     private:
+        void    CountVortonsFromVorticitySlice( const UniformGrid< Vec3 > & vortGrid , Vector< unsigned > & numVortonsPerSlice , size_t izStart , size_t izEnd ) const ;
+        void    AssignVortonsFromVorticitySlice( const UniformGrid< Vec3 > & vortGrid , const Vector< unsigned > & firstVortonPerSlice , size_t izStart , size_t izEnd ) ;
         void    AssignVortonsFromVorticity( UniformGrid< Vec3 > & vortGrid ) ;
         void    ConservedQuantities( Vec3 & vCirculation , Vec3 & vLinearImpulse ) const ;
+        size_t  CountFilamentEquivalentVortons( void ) const ;
         void    FindBoundingBox( void ) ;
+        void    IndexParticlesChunks( size_t icStart , size_t icEnd ) ;
+        void    CountParticlesChunks( size_t icStart , size_t icEnd ) ;
+        void    ScatterParticlesChunks( size_t icStart , size_t icEnd ) ;
+        void    IndexParticles( void ) ;
         void    MakeBaseVortonGrid( void ) ;
+        void    AggregateCluster( unsigned uParentLayer , const unsigned idxParent[3] ) ;
         void    AggregateClusters( unsigned uParentLayer ) ;
+        bool    CanRefitInfluenceTree( void ) const ;
+        void    RefitLeafSlices( Vector< unsigned char > & leafDirty , size_t izStart , size_t izEnd ) ;
+        void    RefitClusterSlices( unsigned uParentLayer , const Vector< unsigned char > & childDirty , Vector< unsigned char > & parentDirty , size_t izStart , size_t izEnd ) ;
+        void    RefitInfluenceTree( void ) ;
+        void    ComputeVortonKeysSlice( size_t iStart , size_t iEnd ) ;
+        void    MakeBaseVortonOctreeSlice( size_t iStart , size_t iEnd ) ;
+        void    AggregateOctreeClustersSlice( size_t iParentLevel , size_t iStart , size_t iEnd ) ;
+        void    CreateInfluenceOctree( void ) ;
         void    CreateInfluenceTree( void ) ;
-        Vec3    ComputeVelocity( const Vec3 & vPosition , const unsigned idxParent[3] , size_t iLayer ) ;
+        void    PackInfluenceTree( void ) ;
+        void    GatherLeafBucketsSlice( size_t izStart , size_t izEnd ) ;
+        void    GatherLeafBuckets( void ) ;
+        void    AccumulateVelocityFromBucket( Vec3 & vVelocity , const Vec3 & vPosition , unsigned offset ) const ;
+        void    ComputeVelocityDirectChunks( size_t icStart , size_t icEnd ) ;
+        void    ReduceVelocityDirectSlice( size_t ivStart , size_t ivEnd ) ;
+        bool    UsesDirectSummation( void ) const ;
+        bool    DirectSummationSuffices( void ) const ;
+        bool    NeedsVelocityGrid( void ) const ;
+        void    ComputeVelocityDirect( void ) ;
+        Vec3    ComputeVelocity( const Vec3 & vPosition , const unsigned idxParent[3] , size_t iLayer , size_t iPackedLayerBegin ) ;
+        Vec3    ComputeVelocityOctree( const Vec3 & vPosition , size_t iLevel , size_t iNode ) const ;
         Vec3    ComputeVelocityBruteForce( const Vec3 & vPosition ) ;
-        void    ComputeVelocityGridSlice( size_t izStart , size_t izEnd ) ;
+        Vec3    ComputeVelocityFromVortons( const Vec3 & vPosition ) ;
+        void    BuildTraversalCut( TraversalCut & rCut , const Vec3 & vTileMinCorner , const Vec3 & vTileMaxCorner , const unsigned indices[3] , size_t iLayer ) const ;
+        void    BuildTraversalCutsSlice( size_t iTileStart , size_t iTileEnd ) ;
+        void    BuildTraversalCuts( void ) ;
+        void    AccumulateVelocityFromCell( Vec3 & vVelocity , const Vec3 & vPosition , const TreeCell & cell ) const ;
+        Vec3    ComputeVelocityFromCut( const Vec3 & vPosition , const TraversalCut & cut ) ;
+        void    UpdateVelocityTiles( void ) ;
+        void    ComputeVelocityGridTiles( size_t iOrderStart , size_t iOrderEnd ) ;
+        bool    BeginVelocityGrid( void ) ;
+        void    ComputeVelocityGridBatch( size_t iOrderBegin , size_t iOrderEnd ) ;
         void    ComputeVelocityGrid( void ) ;
-        void    StretchAndTiltVortons( const float & timeStep , const unsigned & uFrame ) ;
+
+        /*! \brief Operation on a level of the P3M mesh, which P3MSlices performs for a subset of z-slices
+        */
+        enum P3MStep
+        {
+            P3M_SMOOTH_RED          ,   ///< Relax Poisson equation at gridpoints whose index sum is even
+            P3M_SMOOTH_BLACK        ,   ///< Relax Poisson equation at gridpoints whose index sum is odd
+            P3M_RESIDUAL            ,   ///< Compute residual of Poisson equation
+            P3M_RESTRICT_RHS        ,   ///< Transfer right-hand side to next coarser level
+            P3M_RESTRICT_RESIDUAL   ,   ///< Transfer residual to right-hand side of next coarser level
+            P3M_PROLONGATE          ,   ///< Add correction from next coarser level
+            P3M_BOUNDARY_SOURCES    ,   ///< Assign vector potential on boundary, from mP3MBoundarySourcePositions and mP3MBoundarySourceStrengths
+            P3M_BOUNDARY            ,   ///< Assign vector potential on boundary of the finest level, by interpolating the boundary of this level
+            P3M_VELOCITY_GRID           ///< Assign mVelGrid the curl of the vector potential
+        } ;
+
+        bool    UsesP3M( void ) const ;
+        void    DefineP3MMesh( void ) ;
+        void    SplatP3MVorticity( void ) ;
+        void    GatherP3MBoundarySources( size_t iLevel ) ;
+        void    P3MSlices( P3MStep step , size_t iLevel , size_t izStart , size_t izEnd ) ;
+        void    RunP3MStep( P3MStep step , size_t iLevel ) ;
+        void    VCycleP3M( size_t iLevel ) ;
+        Vec3    ComputeP3MNearVelocity( const Vec3 & vPosition , float reach ) const ;
+        void    ComputeP3MNearVelocityGridSlice( float reach , size_t izStart , size_t izEnd ) ;
+        void    ComputeP3MVortonVelocitiesSlice( float reach , size_t ivStart , size_t ivEnd ) ;
+        void    ComputeVelocityP3M( float maxDisplacement ) ;
+        void    InvalidateDerivedFields( void ) ;
+        void    ComputeDerivedFieldSlice( DerivedField field , size_t izStart , size_t izEnd ) ;
+        void    UpdateDerivedField( DerivedField field , size_t izStart , size_t izEnd ) ;
+        void    UpdateDerivedField( DerivedField field , const Vec3 & vMinCorner , const Vec3 & vMaxCorner ) ;
+        void    ComputeFarVelocityGridSlice( size_t iBlockStart , size_t iBlockEnd ) ;
+        void    ComputeFarVelocityGrid( void ) ;
+        void    DefineVelocityPatches( void ) ;
+        void    ComputeVelocityPatchSlices( size_t isStart , size_t isEnd ) ;
+        void    ComputeVelocityPatches( void ) ;
+        void    BlendVelocityPatch( Vec3 & velocity , const Vec3 & vPosition ) const ;
+        void    AccumulatePotentialFlow( Vec3 & velocity , const Vec3 & vPosition ) const ;
+        void    AccumulatePotentialFlowJacobian( Mat33 & velJac , const Vec3 & vPosition ) const ;
+        void    StretchAndTiltVortons( const float & timeStep , size_t iStart , size_t iEnd ) ;
         void    ComputeAverageVorticity( void ) ;
-        void    DiffuseVorticityGlobally( const float & timeStep , const unsigned & uFrame ) ;
-        void    DiffuseVorticityPSE( const float & timeStep , const unsigned & uFrame ) ;
-        void    AdvectVortons( const float & timeStep ) ;
+        void    DiffuseVorticityGlobally( const float & timeStep ) ;
+        void    DiffuseVorticityPSE( const float & timeStep ) ;
+        void    SplatVorticityChunks( Vector< UniformGrid< Vec3 > > & vortGrids , Vector< UniformGrid< float > > & weightGrids , size_t icStart , size_t icEnd ) const ;
+        void    GatherVorticitySlice( const UniformGrid< Vec3 > & vortChange , float scale , size_t ivStart , size_t ivEnd ) ;
+        unsigned SolveDiffusionConjugateGradient( UniformGrid< Vec3 > & soln , UniformGrid< Vec3 > & rhs , float diffusivityTimesStep ) ;
+        void    DiffuseVorticityGrid( const float & timeStep ) ;
+        void    AdvectVortons( const float & timeStep , size_t iStart , size_t iEnd ) ;
+        bool    IsTimeStepBinActive( int level ) const ;
+        void    AdvectVortonsInBlockStepsSlice( const float & tickStep , unsigned iTick , unsigned finestLevel , size_t iStart , size_t iEnd ) ;
+        void    AdvectVortonsInBlockSteps( const float & timeStep ) ;
+        void    ComputeFilamentVelocitiesSlice( const Vector< Vec3 > & nodePositions , Vector< Vec3 > & nodeVelocities , size_t iStart , size_t iEnd ) ;
+        void    AdvectFilaments( const float & timeStep ) ;
 
         void    InitializePassiveTracers( unsigned multiplier ) ;
         void    AdvectTracersSlice( const float & timeStep , const unsigned & uFrame , size_t izStart , size_t izEnd ) ;
-        void    AdvectTracers( const float & timeStep , const unsigned & uFrame ) ;
+        void    AdvectTracers( const float & timeStep , const unsigned & uFrame , size_t iStart , size_t iEnd ) ;
+
+        /*! \brief Stage of an update, in the order Update performs them
+
+            UpdateSliced can yield between stages, within UPDATE_VELOCITY_GRID_TILES
+            between batches of tiles, and within UPDATE_STRETCH_AND_TILT,
+            UPDATE_ADVECT_VORTONS and UPDATE_ADVECT_TRACERS between batches of
+            particle chunks.
+        */
+        enum UpdateStage
+        {
+            UPDATE_CREATE_INFLUENCE_TREE            ,   ///< Index particles and build influence tree.  Also denotes no update in progress.
+            UPDATE_PACK_INFLUENCE_TREE              ,   ///< Store influence tree at reduced precision
+            UPDATE_BEGIN_VELOCITY_GRID              ,   ///< Prepare velocity grid, or compute it entirely, using P3M
+            UPDATE_VELOCITY_GRID_TILES              ,   ///< Compute velocity grid, a batch of tiles at a time
+            UPDATE_VELOCITY_PATCHES                 ,   ///< Compute refined velocity patches
+            UPDATE_FAR_VELOCITY_GRID                ,   ///< Compute velocity grid beyond the domain, for unbounded tracers
+            UPDATE_VELOCITY_DIRECT                  ,   ///< Sum velocity directly at vortons
+            UPDATE_STRETCH_AND_TILT                 ,   ///< Stretch and tilt vortons
+            UPDATE_DIFFUSE                          ,   ///< Diffuse vorticity
+            UPDATE_ADVECT_VORTONS                   ,   ///< Advect vortons
+            UPDATE_ADVECT_VORTONS_IN_BLOCK_STEPS    ,   ///< Sub-step vortons that need it
+            UPDATE_ADVECT_FILAMENTS                 ,   ///< Advect vortex filaments
+            UPDATE_ADVECT_TRACERS                   ,   ///< Advect passive tracers
+            UPDATE_NUM_STAGES                           ///< Number of stages.  Denotes update finished.
+        } ;
+
+        size_t  GetParticleBatchEnd( size_t numParticles ) const ;
+        bool    FinishParticleBatch( size_t iEnd , size_t numParticles ) ;
+        bool    RunUpdateStage( float timeStep , unsigned uFrame ) ;
 
-        Vector< Vorton >        mVortons                ;   ///< Dynamic array of tiny vortex elements
+        ChunkedVector< Vorton > mVortons                ;   ///< Dynamic array of tiny vortex elements, in chunks that forks share until they write
+        Vector< VortexFilament > mFilaments             ;   ///< Vortex filaments, whose segments aggregate into the influence tree alongside vortons
+        ParticleCellIndex       mVortonCells            ;   ///< Which leaf cell of the influence tree contains each vorton
+        ParticleCellIndex       mTracerCells            ;   ///< Which leaf cell of the influence tree contains each tracer
+        float                   mTimeSinceIndex         ;   ///< Virtual time particles have advected since IndexParticles last executed
+        UpdateStage             mUpdateStage            ;   ///< Stage UpdateSliced performs next
+        size_t                  mUpdateTileNext         ;   ///< Index into mVelocityTileOrder of next tile UPDATE_VELOCITY_GRID_TILES computes
+        size_t                  mUpdateNumTiles         ;   ///< Number of tiles UPDATE_VELOCITY_GRID_TILES computes.  Zero when P3M computed the velocity grid.
+        size_t                  mUpdateParticleNext     ;   ///< Index of next vorton or tracer that a stage which visits each particle processes
         NestedGrid< Vorton >    mInfluenceTree          ;   ///< Influence tree
+        float                   mRefitTolerance         ;   ///< Fraction of extent by which to pad the influence tree so later frames can refit it.  Zero disables refitting.
+        Vec3                    mRefitExtent            ;   ///< Extent of bounding box when influence tree was last rebuilt
+        unsigned                mNumRefits              ;   ///< Number of consecutive frames that refit, rather than rebuilt, the influence tree
+        unsigned                mLeafCapacity           ;   ///< Desired number of vortons per leaf of the influence tree.  1 makes each leaf a single supervorton.
+        size_t                  mLeafBucketLayer        ;   ///< Layer of mInfluenceTree whose cells traversals sum vorton by vorton.  0 when leaves are supervortons.
+        Vector< unsigned >      mLeafBucketBegin        ;   ///< Index of the first packet in mLeafBuckets for each cell of layer mLeafBucketLayer, followed by the total
+        AlignedVector< float >  mLeafBuckets            ;   ///< Vortons in each cell of layer mLeafBucketLayer, as packets of one vorton per SIMD lane.  Populated only when mLeafBucketLayer > 0.
+        unsigned                mDirectSummationLimit   ;   ///< Largest number of vortons for which to compute vorton velocities by direct summation.  0 disables it.
+        bool                    mDirectSummationJacobians ; ///< Whether direct summation also computes velocity Jacobians
+        bool                    mVelGridRequired        ;   ///< Whether the current update builds the influence tree and computes mVelGrid.  CreateInfluenceTree sets this.
+        AlignedVector< float >  mDirectSources          ;   ///< All vortons, in the same packet layout as mLeafBuckets, for direct summation
+        Vector< AlignedVector< float > > mDirectSums    ;   ///< Velocity and Jacobian sums each chunk of direct summation accumulated, as packets of one vorton per SIMD lane
+        Vector< Vec3 >          mVortonVelocities       ;   ///< Velocity at each vorton, from direct summation or P3M.  Populated only when either applies.  Otherwise vortons interpolate the velocity grid.
+        Vector< Mat33 >         mVortonJacobians        ;   ///< Velocity Jacobian at each vorton, from direct summation.  Populated only when direct summation applies and computes Jacobians.
+        VelocitySolver          mVelocitySolver         ;   ///< Method with which to compute the velocity grid and the velocity at each vorton
+        float                   mP3MSmoothing           ;   ///< Radius, in velocity grid cells, of the blob into which the P3M mesh spreads each vorton
+        float                   mP3MRadius              ;   ///< Radius, in world units, of the blob into which the P3M mesh spreads each vorton
+        unsigned                mP3MMargin[3]           ;   ///< Number of P3M mesh cells below the minimal corner of mVelGrid, along each axis
+        Vector< UniformGrid< Vec3 > > mP3MStreamFunction ;  ///< Vector potential on the P3M mesh, finest level first.  Coarser levels hold multigrid corrections.
+        Vector< UniformGrid< Vec3 > > mP3MRhs           ;   ///< Right-hand side of the Poisson equation on each level of the P3M mesh: negative vorticity on the finest, restricted residual on coarser ones
+        Vector< UniformGrid< Vec3 > > mP3MResidual      ;   ///< Residual of the Poisson equation on each level of the P3M mesh
+        Vector< Vec3 >          mP3MBoundarySourcePositions ;   ///< Positions of coarse mesh points whose vorticity determines the vector potential on the boundary of the P3M mesh
+        Vector< Vec3 >          mP3MBoundarySourceStrengths ;   ///< Vorticity times volume of coarse mesh points whose vorticity determines the vector potential on the boundary of the P3M mesh
+        LinearOctree< Vorton >  mInfluenceOctree        ;   ///< Influence tree, sparse alternative to mInfluenceTree.  Populated only when using INFLUENCE_LINEAR_OCTREE.
+        Vector< LinearOctree< Vorton >::KeyIndexPair > mVortonKeys ;   ///< Indices of vortons, sorted by key of the octree leaf that contains them
+        UniformGridGeometry     mGridGeometry           ;   ///< Shape of leaf layer of influence tree, which other grids spanning the vortons share
+        InfluenceStructure      mInfluenceStructure     ;   ///< Spatial partition to use for the influence tree
+        bool                    mTracersUnbounded       ;   ///< Whether tracers may leave the domain, which then contains only vortons
+        SparseUniformGrid< Vec3 > mFarVelGrid           ;   ///< Velocity near tracers outside mVelGrid.  Populated only when tracers are unbounded.
+        StoragePrecision        mTreePrecision          ;   ///< Format of packed influence tree layers
+        unsigned                mPackedTreeMinLayer     ;   ///< Finest influence tree layer to pack, when mTreePrecision is reduced
+        size_t                  mPackedLayerBegin       ;   ///< Finest layer of mPackedTree populated this frame.  Traversals read layers at or above this from mPackedTree.
+        Vector< Vector< PackedVorton > > mPackedTree    ;   ///< Copy of coarse layers of mInfluenceTree at reduced precision.  Populated only when mTreePrecision is reduced.
+        Vector< float >         mPackedTreeScales       ;   ///< Factor by which to multiply vorticity unpacked from each layer of mPackedTree
+        bool                    mCacheTraversalCuts     ;   ///< Whether to reuse mTraversalCuts across frames that refit the influence tree
+        Vector< TraversalCut >  mTraversalCuts          ;   ///< Clusters each tile of the velocity grid visits, indexed like mVelocityTileOrder entries.  Empty when stale.
         UniformGrid< Vec3 >     mVelGrid                ;   ///< Uniform grid of velocity values
+        unsigned                mVelGridDecimation      ;   ///< Factor by which mVelGrid has fewer cells per axis than mGridGeometry
+        FiniteDifferenceScheme  mFiniteDifferenceScheme ;   ///< Stencil with which to compute mVelocityJacobianGrid
+        unsigned                mNumVelocityTiles[ 3 ]  ;   ///< Number of tiles along each axis of mVelGrid
+        Vector< unsigned >      mVelocityTileOrder      ;   ///< Indices of tiles of mVelGrid, in the order of a Hilbert curve through them
+        StoragePrecision        mVelGridPrecision       ;   ///< Format of packed velocity grid
+        UniformGrid< PackedFloat4 > mPackedVelGrid      ;   ///< Copy of mVelGrid at reduced precision, from which tracers advect.  Populated only when mVelGridPrecision is reduced.
+        unsigned                mVelRefinement          ;   ///< Number of cells of each patch per cell of mVelGrid, along each axis.  1 disables patches.
+        float                   mVelRefinementVorticityFraction ;   ///< Fraction of largest vorticity magnitude above which to refine velocity around vortons
+        Vector< RefinementRegion > mVelRefinementRegions ;  ///< Boxes in which callers requested refined velocity
+        Vector< UniformGrid< Vec3 > > mVelPatches       ;   ///< Finer velocity grids nested within mVelGrid.  Empty when refinement is disabled.
+        Vector< size_t >        mVelPatchSliceBegin     ;   ///< Index, among z-slices of all patches, of the first z-slice of each patch, followed by the total
+        UniformGrid< unsigned > mVelPatchOfCell         ;   ///< Index of the patch covering each cell of mVelGrid, addressed by the cell's minimal corner, or ~0 for none
+        UniformGrid< float >    mVelPatchWeight         ;   ///< Weight of patches at each point of mVelGrid: 1 where patches cover every adjacent cell, else 0
+        Vector< PotentialFlowSphere > mPotentialFlowSpheres ;   ///< Spheres whose potential flow adds to velocity interpolated from grids
         Vec3                    mMinCorner              ;   ///< Minimal corner of axis-aligned bounding box
         Vec3                    mMaxCorner              ;   ///< Maximal corner of axis-aligned bounding box
         float                   mViscosity              ;   ///< Viscosity.  Used to compute viscous diffusion.
@@ -104,12 +760,52 @@ class VortonSim
         Vec3                    mLinearImpulseInitial   ;   ///< Initial linear impulse, which should be conserved when viscosity is zero.
         Vec3                    mAverageVorticity       ;   ///< Hack, average vorticity used to compute a kind of viscous vortex diffusion.
         float                   mFluidDensity           ;   ///< Uniform density of fluid.
-        float                   mMassPerParticle        ;   ///< Mass of each fluid particle (vorton or tracer).
-        Vector< Particle >      mTracers                ;   ///< Passive tracer particles
+        float                   mMassPerVorton          ;   ///< Mass of fluid that each vorton carries, when it collides with bodies.
+        float                   mMassPerTracer          ;   ///< Mass of fluid that each tracer carries, when it collides with bodies.
+        ChunkedVector< Particle > mTracers              ;   ///< Passive tracer particles, in chunks that forks share until they write
+        DiffusionScheme         mDiffusionScheme        ;   ///< Method used to approximate viscous diffusion of vorticity
+        UniformGrid< Mat33 >    mVelocityJacobianGrid   ;   ///< Uniform grid of velocity gradients.  Derived field; valid only in slices mDerivedSliceValid marks.
+        UniformGrid< Vec3 >     mVorticityGrid          ;   ///< Curl of mVelGrid.  Derived field.
+        UniformGrid< float >    mDivergenceGrid         ;   ///< Divergence of mVelGrid.  Derived field.
+        UniformGrid< float >    mStrainRateGrid         ;   ///< Strain rate of mVelGrid.  Derived field.
+        Vector< unsigned char > mDerivedSliceValid[ NUM_DERIVED_FIELDS ] ;  ///< Whether each z-slice of each derived field is current.  Empty when the field is stale.
+        unsigned                mMaxTimeStepLevel       ;   ///< Finest and coarsest time-step bin.  Vortons in bin L take 2^L sub-steps per frame; vortons in bin -L take one step per 2^L frames.
+        unsigned                mBlockStepFrame         ;   ///< Frame counter that determines which coarse time-step bins are active
+        Vector< signed char >   mTimeStepLevels         ;   ///< Time-step bin of each vorton, assigned from local strain rate whenever its bin is active
+        Vector< Vec3 >          mStretchRates           ;   ///< Rate of change of each vorton's vorticity due to stretching and tilting, from when its bin was last active
+        Vector< Vec3 >          mDriftVelocities        ;   ///< Velocity of each vorton, from when its bin was last active.  Vortons in inactive coarse bins move with this.
+        Vector< unsigned >      mBlockStepVortons       ;   ///< Indices of vortons in bins finer than 0, which take sub-steps
+        Vector< Vorton >        mBlockStepStart         ;   ///< State of each vorton in mBlockStepVortons at the start of the frame, when the velocity grid sampled it
+        Vector< Vorton >        mBlockStepCurrent       ;   ///< State of each vorton in mBlockStepVortons at the current sub-step, with positions of inactive vortons extrapolated
+        float                   mBlockStepMaxSpeed      ;   ///< Fastest speed at which any vorton took a sub-step this frame, including the correction for other sub-stepping vortons
 
     #if USE_TBB
         friend class VortonSim_ComputeVelocityGrid_TBB ;
         friend class VortonSim_AdvectTracers_TBB ;
+        friend class VortonSim_SplatVorticity_TBB ;
+        friend class VortonSim_GatherVorticity_TBB ;
+        friend class VortonSim_AdvectVortonsInBlockSteps_TBB ;
+        friend class VortonSim_ComputeVortonKeys_TBB ;
+        friend class VortonSim_MakeBaseVortonOctree_TBB ;
+        friend class VortonSim_AggregateOctreeClusters_TBB ;
+        friend class VortonSim_ComputeFarVelocityGrid_TBB ;
+        friend class VortonSim_IndexParticles_TBB ;
+        friend class VortonSim_CountParticles_TBB ;
+        friend class VortonSim_ScatterParticles_TBB ;
+        friend class VortonSim_RefitLeaves_TBB ;
+        friend class VortonSim_RefitClusters_TBB ;
+        friend class VortonSim_CountVortonsFromVorticity_TBB ;
+        friend class VortonSim_AssignVortonsFromVorticity_TBB ;
+        friend class VortonSim_ComputeDerivedField_TBB ;
+        friend class VortonSim_ComputeFilamentVelocities_TBB ;
+        friend class VortonSim_BuildTraversalCuts_TBB ;
+        friend class VortonSim_ComputeVelocityPatches_TBB ;
+        friend class VortonSim_GatherLeafBuckets_TBB ;
+        friend class VortonSim_ComputeVelocityDirect_TBB ;
+        friend class VortonSim_ReduceVelocityDirect_TBB ;
+        friend class VortonSim_P3MSlices_TBB ;
+        friend class VortonSim_ComputeP3MVortonVelocities_TBB ;
+        friend class VortonSim_ComputeP3MNearVelocityGrid_TBB ;
     #endif
 } ;
 
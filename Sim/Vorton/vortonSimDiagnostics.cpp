@@ -0,0 +1,1445 @@
+/*! \file vortonSimDiagnostics.cpp
+
+    \brief Dynamic simulation of a fluid, using tiny vortex elements, diagnostic routines
+
+    \author Copyright 2009 Dr. Michael Jason Gourlay; All rights reserved.
+*/
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "Core/Math/mat33x.h"
+#include "Core/Performance/perf.h"
+#include "Space/uniformGridMath.h"
+
+#include "vorticityDistribution.h"
+#include "vortonSim.h"
+
+
+
+
+/*! \brief Return a pseudo-random value in [-4,4] that depends only on the given index
+
+    Tests use this rather than rand so they leave the pseudo-random sequence of the application undisturbed.
+*/
+static float PseudoRandom( unsigned index )
+{
+    return 4.0f * sinf( 12.9898f * float( index ) + 78.233f ) ;
+}
+
+
+
+
+/*! \brief Return largest difference, relative to magnitude, between each lane of packet math and the same math on Vec3 and Mat33
+
+    \param seed - first index of the pseudo-random sequence that fills the lanes
+
+*/
+template< class FloatT > static float ComparePacketMathToScalar( unsigned seed )
+{
+    typedef Vec3xN< FloatT >    Vec3x ;
+    typedef Mat33xN< FloatT >   Mat33x ;
+    static const unsigned       numLanes = FloatT::NumLanes ;
+    Vec3    a[ numLanes ] , b[ numLanes ] ;
+    Mat33   m[ numLanes ] , n[ numLanes ] ;
+    Vec3x   ax , bx ;
+    Mat33x  mx , nx ;
+    for( unsigned iLane = 0 ; iLane < numLanes ; ++ iLane )
+    {   // For each lane, fill scalars and packets with the same values.
+        const unsigned i = seed + 30 * iLane ;
+        a[ iLane ] = Vec3( PseudoRandom( i +  0 ) , PseudoRandom( i +  1 ) , PseudoRandom( i +  2 ) ) ;
+        b[ iLane ] = Vec3( PseudoRandom( i +  3 ) , PseudoRandom( i +  4 ) , PseudoRandom( i +  5 ) ) ;
+        m[ iLane ] = Mat33( Vec3( PseudoRandom( i +  6 ) , PseudoRandom( i +  7 ) , PseudoRandom( i +  8 ) ) ,
+                            Vec3( PseudoRandom( i +  9 ) , PseudoRandom( i + 10 ) , PseudoRandom( i + 11 ) ) ,
+                            Vec3( PseudoRandom( i + 12 ) , PseudoRandom( i + 13 ) , PseudoRandom( i + 14 ) ) ) ;
+        n[ iLane ] = Mat33( Vec3( PseudoRandom( i + 15 ) , PseudoRandom( i + 16 ) , PseudoRandom( i + 17 ) ) ,
+                            Vec3( PseudoRandom( i + 18 ) , PseudoRandom( i + 19 ) , PseudoRandom( i + 20 ) ) ,
+                            Vec3( PseudoRandom( i + 21 ) , PseudoRandom( i + 22 ) , PseudoRandom( i + 23 ) ) ) ;
+        ax.SetLane( iLane , a[ iLane ] ) ;
+        bx.SetLane( iLane , b[ iLane ] ) ;
+        mx.SetLane( iLane , m[ iLane ] ) ;
+        nx.SetLane( iLane , n[ iLane ] ) ;
+    }
+
+    const Vec3x     sum         = ax + bx ;
+    const Vec3x     cross       = ax ^ bx ;
+    const FloatT    dot         = ax * bx ;
+    const FloatT    mag2        = ax.Mag2() ;
+    const Vec3x     dir         = ax.GetDir() ;
+    const Vec3x     matVec      = mx * ax ;
+    const Vec3x     vecMat      = ax * mx ;
+    const Mat33x    matMat      = mx * nx ;
+    const Vec3x     selected    = Select( ax.x < bx.x , ax , bx ) ;
+    float           maxDiff     = 0.0f ;
+    for( unsigned iLane = 0 ; iLane < numLanes ; ++ iLane )
+    {   // For each lane, compare packet results with scalar results.
+        const Mat33 mn = m[ iLane ] * n[ iLane ] ;
+        maxDiff = MAX2( maxDiff , ( sum.GetLane( iLane ) - ( a[ iLane ] + b[ iLane ] ) ).Magnitude() / ( 1.0f + ( a[ iLane ] + b[ iLane ] ).Magnitude() ) ) ;
+        maxDiff = MAX2( maxDiff , ( cross.GetLane( iLane ) - ( a[ iLane ] ^ b[ iLane ] ) ).Magnitude() / ( 1.0f + ( a[ iLane ] ^ b[ iLane ] ).Magnitude() ) ) ;
+        maxDiff = MAX2( maxDiff , fabsf( dot[ iLane ] - a[ iLane ] * b[ iLane ] ) / ( 1.0f + fabsf( a[ iLane ] * b[ iLane ] ) ) ) ;
+        maxDiff = MAX2( maxDiff , fabsf( mag2[ iLane ] - a[ iLane ].Mag2() ) / ( 1.0f + a[ iLane ].Mag2() ) ) ;
+        maxDiff = MAX2( maxDiff , ( dir.GetLane( iLane ) - a[ iLane ].GetDir() ).Magnitude() ) ;
+        maxDiff = MAX2( maxDiff , ( matVec.GetLane( iLane ) - m[ iLane ] * a[ iLane ] ).Magnitude() / ( 1.0f + ( m[ iLane ] * a[ iLane ] ).Magnitude() ) ) ;
+        maxDiff = MAX2( maxDiff , ( vecMat.GetLane( iLane ) - a[ iLane ] * m[ iLane ] ).Magnitude() / ( 1.0f + ( a[ iLane ] * m[ iLane ] ).Magnitude() ) ) ;
+        const Mat33 mnPacket = matMat.GetLane( iLane ) ;
+        maxDiff = MAX2( maxDiff , ( mnPacket.x - mn.x ).Magnitude() / ( 1.0f + mn.x.Magnitude() ) ) ;
+        maxDiff = MAX2( maxDiff , ( mnPacket.y - mn.y ).Magnitude() / ( 1.0f + mn.y.Magnitude() ) ) ;
+        maxDiff = MAX2( maxDiff , ( mnPacket.z - mn.z ).Magnitude() / ( 1.0f + mn.z.Magnitude() ) ) ;
+        const Vec3 & rSelectedScalar = ( a[ iLane ].x < b[ iLane ].x ) ? a[ iLane ] : b[ iLane ] ;
+        maxDiff = MAX2( maxDiff , ( selected.GetLane( iLane ) - rSelectedScalar ).Magnitude() ) ;
+    }
+    return maxDiff ;
+}
+
+
+
+
+/* static */ void VortonSim::UnitTest( void )
+{
+    fprintf( stderr , "VortonSim::UnitTest------------------------\n" ) ;
+
+    {   // Test that SIMD packets of Vec3 and Mat33 compute, lane by lane, what Vec3 and Mat33 compute.
+        const float diff4   = ComparePacketMathToScalar< Float4  >( 0 ) ;
+        const float diff8   = ComparePacketMathToScalar< Float8  >( 1000 ) ;
+        const float diff16  = ComparePacketMathToScalar< Float16 >( 2000 ) ;
+        fprintf( stderr , "packet math: native width=%u max relative difference 4 lanes=%g 8 lanes=%g 16 lanes=%g\n" , unsigned( FloatNative::NumLanes ) , diff4 , diff8 , diff16 ) ;
+        assert( diff4 < 1.0e-5f ) ;
+        assert( diff8 < 1.0e-5f ) ;
+        assert( diff16 < 1.0e-5f ) ;
+    }
+
+    {   // Test implicit grid diffusion on a checkerboard of vorticity.
+        // A checkerboard is the stiffest mode of the grid Laplacian, so it is the first to blow up
+        // when a diffusion step is unstable.  Test far beyond the explicit limit of 1/6 per axis.
+        static const float      stabilityNumbers[]  = { 1.0f , 3.0f , 30.0f } ;
+        static const unsigned   numCellsPerSide     = 15 ;
+        UniformGrid< Vec3 >     vorticity( POW3( numCellsPerSide ) , Vec3( 0.0f , 0.0f , 0.0f ) , Vec3( 1.0f , 1.0f , 1.0f ) , false ) ;
+        vorticity.Init() ;
+        const unsigned          dims[3]             = { vorticity.GetNumPoints( 0 ) , vorticity.GetNumPoints( 1 ) , vorticity.GetNumPoints( 2 ) } ;
+        unsigned                index[3] ;
+        for( index[2] = 0 ; index[2] < dims[2] ; ++ index[2] )
+        for( index[1] = 0 ; index[1] < dims[1] ; ++ index[1] )
+        for( index[0] = 0 ; index[0] < dims[0] ; ++ index[0] )
+        {   // For each gridpoint, alternate sign of vorticity.
+            const unsigned offset = index[0] + dims[0] * ( index[1] + dims[1] * index[2] ) ;
+            vorticity[ offset ] = Vec3( 0.0f , 0.0f , ( ( index[0] + index[1] + index[2] ) & 1 ) ? -1.0f : 1.0f ) ;
+        }
+
+        VortonSim vortonSim( 0.0f , 1.0f ) ;
+        for( unsigned iTest = 0 ; iTest < sizeof( stabilityNumbers ) / sizeof( stabilityNumbers[0] ) ; ++ iTest )
+        {   // For each ratio of viscosity * timeStep to spacing^2...
+            const float         stabilityNumber         = stabilityNumbers[ iTest ] ;
+            const float         diffusivityTimesStep    = stabilityNumber * POW2( vorticity.GetCellSpacing().x ) ;
+            UniformGrid< Vec3 > laplacian( vorticity ) ;
+            laplacian.Init() ;
+            ComputeLaplacian( laplacian , vorticity ) ;
+            double rhs2 = 0.0 ;
+            for( unsigned offset = 0 ; offset < laplacian.Size() ; ++ offset )
+            {
+                rhs2 += laplacian[ offset ] * laplacian[ offset ] ;
+            }
+            UniformGrid< Vec3 > change( vorticity ) ;
+            const unsigned      numIterations = vortonSim.SolveDiffusionConjugateGradient( change , laplacian , diffusivityTimesStep ) ;
+
+            float   vortMax     = 0.0f ;
+            double  residual2   = 0.0 ;
+            for( unsigned offset = 0 ; offset < vorticity.Size() ; ++ offset )
+            {
+                const Vec3 vortNew = vorticity[ offset ] + diffusivityTimesStep * change[ offset ] ;
+                vortMax     = MAX2( vortMax , vortNew.Magnitude() ) ;
+                residual2   += laplacian[ offset ] * laplacian[ offset ] ;
+            }
+            fprintf( stderr , "checkerboard s=%g: iterations=%u max vorticity=%g relative residual=%g\n" , stabilityNumber , numIterations , vortMax , sqrt( residual2 / rhs2 ) ) ;
+            assert( vortMax < 1.0f ) ;                                          // Diffusion damps, never amplifies.
+            assert( vortMax <= 1.0f / ( 1.0f + 2.0f * stabilityNumber ) ) ;     // Backward Euler damps a checkerboard by 1/(1+12s) in the interior, and less at faces and corners.
+            assert( residual2 <= POW2( 1.0e-4 ) * rhs2 ) ;                      // Solve converged to sDiffusionTolerance.
+        }
+    }
+
+    {   // Test that, with coarse and fine time-step bins active, a broad phase that widens its reach by ComputeMaxDisplacementSinceIndex finds every vorton.
+        static const unsigned   numVortonsPerSide   = 8 ;
+        VortonSim               vortonSim( 0.0f , 1.0f ) ;
+        const float             spacing             = 1.0f / float( numVortonsPerSide ) ;
+        unsigned                index[3] ;
+        for( index[2] = 0 ; index[2] < numVortonsPerSide ; ++ index[2] )
+        for( index[1] = 0 ; index[1] < numVortonsPerSide ; ++ index[1] )
+        for( index[0] = 0 ; index[0] < numVortonsPerSide ; ++ index[0] )
+        {   // For each vorton in a cube, with a strong core whose strain needs fine bins, amid weak vorticity that allows coarse bins...
+            const Vec3  vPosition( ( float( index[0] ) + 0.5f ) * spacing , ( float( index[1] ) + 0.5f ) * spacing , ( float( index[2] ) + 0.5f ) * spacing ) ;
+            const float coreStrength = 200.0f * expf( - ( vPosition - Vec3( 0.5f , 0.5f , 0.5f ) ).Mag2() / 0.02f ) ;
+            vortonSim.GetVortons().PushBack( Vorton( vPosition , Vec3( 0.1f * ( vPosition.y - 0.5f ) , coreStrength , 0.1f ) , 0.5f * spacing ) ) ;
+        }
+        vortonSim.SetMaxTimeStepLevel( 3 ) ;
+        vortonSim.Initialize( 1 ) ;
+
+        bool                bFineBins       = false ;
+        bool                bCoarseBins     = false ;
+        Vector< unsigned >  nearbyVortons ;
+        for( unsigned uFrame = 0 ; uFrame < 8 ; ++ uFrame )
+        {   // For each frame...
+            if( 5 == uFrame )
+            {   // Weaken vorticity, as bodies do when they absorb it, so the velocity grid becomes slower than vortons in inactive coarse bins.
+                for( unsigned iVorton = 0 ; iVorton < vortonSim.GetVortons().Size() ; ++ iVorton )
+                {
+                    vortonSim.GetVortons()[ iVorton ].mVorticity *= 0.01f ;
+                }
+            }
+            vortonSim.Update( 0.05f , uFrame ) ;
+            for( size_t iVorton = 0 ; iVorton < vortonSim.mTimeStepLevels.Size() ; ++ iVorton )
+            {   // For each vorton, note which kinds of bins it used.
+                bFineBins   = bFineBins   || ( vortonSim.mTimeStepLevels[ iVorton ] > 0 ) ;
+                bCoarseBins = bCoarseBins || ( vortonSim.mTimeStepLevels[ iVorton ] < 0 ) ;
+            }
+
+            // Query the cell index around each vorton, as FluidBodySim does around each body.
+            const ParticleCellIndex &       rVortonCells    = vortonSim.GetVortonCellIndex() ;
+            const ChunkedVector< Vorton > & rVortons        = static_cast< const VortonSim & >( vortonSim ).GetVortons() ;
+            const float                     maxDisplacement = vortonSim.ComputeMaxDisplacementSinceIndex() ;
+            const Vec3                      vReach( maxDisplacement , maxDisplacement , maxDisplacement ) ;
+            unsigned                        numMissed       = 0 ;
+            for( unsigned iVorton = 0 ; iVorton < rVortons.Size() ; ++ iVorton )
+            {   // For each vorton, gather vortons whose indexed cells lie within reach of where it is now.
+                nearbyVortons.Clear() ;
+                rVortonCells.GatherParticlesInBox( nearbyVortons , rVortons[ iVorton ].mPosition - vReach , rVortons[ iVorton ].mPosition + vReach ) ;
+                if( ! binary_search( nearbyVortons.Begin() , nearbyVortons.End() , iVorton ) )
+                {
+                    ++ numMissed ;
+                }
+            }
+            assert( 0 == numMissed ) ;
+        }
+        fprintf( stderr , "block time steps: fine bins=%d coarse bins=%d, broad phase found every vorton\n" , bFineBins , bCoarseBins ) ;
+        assert( bFineBins && bCoarseBins ) ;
+    }
+
+    {   // Test that a linear octree stores only occupied cells, and moves vortons as the nested grid does.
+        static const unsigned   numVortonsPerSide   = 12 ;
+        VortonSim               nested( 0.0f , 1.0f ) ;
+        VortonSim               octree( 0.0f , 1.0f ) ;
+        const float             spacing             = 2.0f / float( numVortonsPerSide ) ;
+        unsigned                index[3] ;
+        for( unsigned iClump = 0 ; iClump < 2 ; ++ iClump )
+        for( index[2] = 0 ; index[2] < numVortonsPerSide ; ++ index[2] )
+        for( index[1] = 0 ; index[1] < numVortonsPerSide ; ++ index[1] )
+        for( index[0] = 0 ; index[0] < numVortonsPerSide ; ++ index[0] )
+        {   // For each vorton in two small cubes at opposite corners of a large, mostly empty domain...
+            const Vec3  vCorner( 12.0f * float( iClump ) , 12.0f * float( iClump ) , 12.0f * float( iClump ) ) ;
+            const Vec3  vPosition( vCorner + Vec3( ( float( index[0] ) + 0.5f ) * spacing , ( float( index[1] ) + 0.5f ) * spacing , ( float( index[2] ) + 0.5f ) * spacing ) ) ;
+            const Vorton vorton( vPosition , Vec3( vPosition.y - vCorner.y - 1.0f , vCorner.x + 1.0f - vPosition.x , 1.0f ) , 0.5f * spacing ) ;
+            nested.GetVortons().PushBack( vorton ) ;
+            octree.GetVortons().PushBack( vorton ) ;
+        }
+        octree.SetInfluenceStructure( INFLUENCE_LINEAR_OCTREE ) ;
+
+        for( unsigned uFrame = 0 ; uFrame < 3 ; ++ uFrame )
+        {
+            nested.Update( 0.01f , uFrame ) ;
+            octree.Update( 0.01f , uFrame ) ;
+        }
+        assert( octree.mInfluenceOctree.GetDepth() == nested.mInfluenceTree.GetDepth() ) ;
+        const size_t numOccupiedLeaves  = octree.mInfluenceOctree[ 0 ].mKeys.Size() ;
+        const size_t numLeafCells       = nested.mInfluenceTree[ 0 ].GetGridCapacity() ;
+        float maxDifference = 0.0f ;
+        for( size_t iVorton = 0 ; iVorton < nested.GetVortons().Size() ; ++ iVorton )
+        {   // For each vorton, compare its evolution using each influence structure.
+            const Vorton & rVorton = nested.GetVortons()[ iVorton ] ;
+            const Vorton & rTwin   = octree.GetVortons()[ iVorton ] ;
+            maxDifference = MAX2( maxDifference , MAX2( ( rVorton.mPosition - rTwin.mPosition ).Magnitude() , ( rVorton.mVorticity - rTwin.mVorticity ).Magnitude() ) ) ;
+        }
+        fprintf( stderr , "linear octree: %u occupied leaves of %u, max difference=%g\n" , unsigned( numOccupiedLeaves ) , unsigned( numLeafCells ) , maxDifference ) ;
+        assert( numOccupiedLeaves <= nested.GetVortons().Size() ) ;  // Each occupied leaf holds at least one vorton...
+        assert( numOccupiedLeaves * 10 < numLeafCells ) ;           // ...so most of this sparse domain costs nothing.
+        assert( 0.0f == maxDifference ) ;
+    }
+
+    {   // Test that a sparse grid interpolates across blocks and negative indices, and that unbounded tracers far from vortons neither enlarge the domain nor lose velocity.
+        SparseUniformGrid< Vec3 >   sparse ;
+        UniformGridGeometry         reference( 1000 , Vec3( 0.0f , 0.0f , 0.0f ) , Vec3( 1.0f , 1.0f , 1.0f ) , false ) ;
+        sparse.DefineShape( reference , Vec3( 0.0f , 0.0f , 0.0f ) ) ;
+        int indices[3] ;
+        for( indices[2] = -10 ; indices[2] <= 10 ; ++ indices[2] )
+        for( indices[1] = -10 ; indices[1] <= 10 ; ++ indices[1] )
+        for( indices[0] = -10 ; indices[0] <= 10 ; ++ indices[0] )
+        {   // For each gridpoint in a region that straddles several blocks on each side of the origin, assign a linear function, which trilinear interpolation reproduces.
+            Vec3 vPosition ;
+            sparse.PositionFromIndices( vPosition , indices ) ;
+            sparse.GetOrCreatePoint( indices ) = Vec3( vPosition.x + 2.0f * vPosition.y , vPosition.z - vPosition.x , 3.0f ) ;
+        }
+        SparseUniformGrid< Vec3 >::BlockCache cache ;
+        float maxInterpolationError = 0.0f ;
+        for( unsigned iProbe = 0 ; iProbe < 1000 ; ++ iProbe )
+        {   // For each probe within the assigned region, which spans [-10,10] cells of 1/9 each...
+            const Vec3  vPosition( 0.25f * PseudoRandom( 3 * iProbe ) , 0.25f * PseudoRandom( 3 * iProbe + 1 ) , 0.25f * PseudoRandom( 3 * iProbe + 2 ) ) ;
+            Vec3        velocity ;
+            sparse.Interpolate( velocity , vPosition , cache ) ;
+            maxInterpolationError = MAX2( maxInterpolationError , ( velocity - Vec3( vPosition.x + 2.0f * vPosition.y , vPosition.z - vPosition.x , 3.0f ) ).Magnitude() ) ;
+        }
+
+        static const unsigned   numVortonsPerSide   = 6 ;
+        VortonSim               bounded( 0.0f , 1.0f ) ;
+        VortonSim               unbounded( 0.0f , 1.0f ) ;
+        const float             spacing             = 1.0f / float( numVortonsPerSide ) ;
+        unsigned                index[3] ;
+        for( index[2] = 0 ; index[2] < numVortonsPerSide ; ++ index[2] )
+        for( index[1] = 0 ; index[1] < numVortonsPerSide ; ++ index[1] )
+        for( index[0] = 0 ; index[0] < numVortonsPerSide ; ++ index[0] )
+        {   // For each vorton in a cube...
+            const Vec3 vPosition( ( float( index[0] ) + 0.5f ) * spacing , ( float( index[1] ) + 0.5f ) * spacing , ( float( index[2] ) + 0.5f ) * spacing ) ;
+            const Vorton vorton( vPosition , Vec3( 0.0f , 0.0f , 1.0f ) , 0.5f * spacing ) ;
+            bounded.GetVortons().PushBack( vorton ) ;
+            unbounded.GetVortons().PushBack( vorton ) ;
+        }
+        Particle tracer ;
+        tracer.mPosition = Vec3( 3.0f , 0.5f , 0.5f ) ;
+        bounded.GetTracers().PushBack( tracer ) ;
+        unbounded.GetTracers().PushBack( tracer ) ;
+        unbounded.SetTracersUnbounded( true ) ;
+        bounded.Update( 0.01f , 0 ) ;
+        unbounded.Update( 0.01f , 0 ) ;
+        const Vec3 & velBounded     = bounded.GetTracers()[ 0 ].mVelocity ;
+        const Vec3 & velUnbounded   = unbounded.GetTracers()[ 0 ].mVelocity ;
+        const float  relativeDiff   = ( velUnbounded - velBounded ).Magnitude() / velBounded.Magnitude() ;
+        fprintf( stderr , "sparse grid: interpolation error=%g, %u blocks; unbounded tracer: domain extent %g vs %g, relative velocity difference=%g\n"
+            , maxInterpolationError , unsigned( sparse.GetNumBlocks() ) , unbounded.GetVelocityGrid().GetExtent().x , bounded.GetVelocityGrid().GetExtent().x , relativeDiff ) ;
+        assert( maxInterpolationError < 1.0e-4f ) ;
+        assert( 64 == sparse.GetNumBlocks() ) ;                                                             // Indices -10..10 touch blocks -2..1 along each axis.
+        assert( unbounded.GetVelocityGrid().GetExtent().x < 0.5f * bounded.GetVelocityGrid().GetExtent().x ) ; // Domain fits vortons, not the far tracer...
+        assert( unbounded.mFarVelGrid.GetNumBlocks() > 0 ) ;                                               // ...which gets velocity from the sparse grid...
+        assert( relativeDiff < 0.1f ) ;                                                                     // ...that matches what it would get inside the domain.
+    }
+
+    {   // Test that refitting the influence tree gives the same clusters as aggregating it afresh on the same grid, and that vortons leaving the padded grid force a rebuild.
+        static const unsigned   numVortonsPerSide   = 8 ;
+        VortonSim               vortonSim( 0.0f , 1.0f ) ;
+        const float             spacing             = 1.0f / float( numVortonsPerSide ) ;
+        unsigned                index[3] ;
+        for( index[2] = 0 ; index[2] < numVortonsPerSide ; ++ index[2] )
+        for( index[1] = 0 ; index[1] < numVortonsPerSide ; ++ index[1] )
+        for( index[0] = 0 ; index[0] < numVortonsPerSide ; ++ index[0] )
+        {   // For each vorton in a cube, with vorticity that varies so that vortons stretch and tilt...
+            const Vec3 vPosition( ( float( index[0] ) + 0.5f ) * spacing , ( float( index[1] ) + 0.5f ) * spacing , ( float( index[2] ) + 0.5f ) * spacing ) ;
+            vortonSim.GetVortons().PushBack( Vorton( vPosition , Vec3( vPosition.y - 0.5f , 0.5f - vPosition.x , 1.0f ) , 0.5f * spacing ) ) ;
+        }
+        vortonSim.GetTracers().PushBack( Particle() ) ;    // Tracers need the velocity grid, and so the tree.
+        vortonSim.SetRefitTolerance( 0.25f ) ;
+        vortonSim.Initialize( 0 ) ;
+        for( unsigned uFrame = 0 ; uFrame < 3 ; ++ uFrame )
+        {
+            vortonSim.Update( 0.01f , uFrame ) ;
+        }
+        assert( vortonSim.mNumRefits > 0 ) ;
+
+        // Refit as the next frame would, then aggregate afresh on the same grid.
+        vortonSim.FindBoundingBox() ;
+        assert( vortonSim.CanRefitInfluenceTree() ) ;
+        vortonSim.IndexParticles() ;
+        vortonSim.RefitInfluenceTree() ;
+        const size_t        numLayers = vortonSim.mInfluenceTree.GetDepth() ;
+        Vector< Vorton >    refitClusters ;
+        for( size_t iLayer = 0 ; iLayer < numLayers ; ++ iLayer )
+        {   // For each layer, remember its refit clusters.
+            const UniformGrid< Vorton > & rLayer = vortonSim.mInfluenceTree[ iLayer ] ;
+            for( size_t offset = 0 ; offset < rLayer.Size() ; ++ offset ) refitClusters.PushBack( rLayer[ offset ] ) ;
+        }
+        vortonSim.mInfluenceTree[ 0 ].Init( Vorton() ) ;  // MakeBaseVortonGrid accumulates into leaves, as into a freshly built tree.
+        vortonSim.MakeBaseVortonGrid() ;
+        for( unsigned uParentLayer = 1 ; uParentLayer < numLayers ; ++ uParentLayer )
+        {
+            vortonSim.AggregateClusters( uParentLayer ) ;
+        }
+        float   maxDifference   = 0.0f ;
+        size_t  iCluster        = 0 ;
+        for( size_t iLayer = 0 ; iLayer < numLayers ; ++ iLayer )
+        {   // For each cluster of each layer, compare refit with fresh aggregation.
+            const UniformGrid< Vorton > & rLayer = vortonSim.mInfluenceTree[ iLayer ] ;
+            for( size_t offset = 0 ; offset < rLayer.Size() ; ++ offset , ++ iCluster )
+            {
+                maxDifference = MAX2( maxDifference , ( rLayer[ offset ].mVorticity - refitClusters[ iCluster ].mVorticity ).Magnitude() ) ;
+                if( rLayer[ offset ].mVorticity.Mag2() > 0.0f )
+                {   // Cluster is occupied, so its center means something.
+                    maxDifference = MAX2( maxDifference , ( rLayer[ offset ].mPosition - refitClusters[ iCluster ].mPosition ).Magnitude() ) ;
+                }
+            }
+        }
+
+        // Move one vorton beyond the padding, which a refit cannot represent.
+        vortonSim.GetVortons()[ 0 ].mPosition = Vec3( -2.0f , 0.5f , 0.5f ) ;
+        vortonSim.FindBoundingBox() ;
+        const bool bRefitAfterEscape = vortonSim.CanRefitInfluenceTree() ;
+        fprintf( stderr , "refit: %u consecutive refits, max difference from fresh aggregation=%g, refit after escape=%d\n" , vortonSim.mNumRefits , maxDifference , bRefitAfterEscape ) ;
+        assert( maxDifference < 1.0e-5f ) ;
+        assert( ! bRefitAfterEscape ) ;
+    }
+
+    {   // Test that the per-frame particle index lists each vorton and tracer once, in the leaf cell that contains it and in original order within each cell, and that leaves aggregate exactly the vortons it lists.
+        static const unsigned   numVortonsPerSide   = 7 ;
+        VortonSim               vortonSim( 0.0f , 1.0f ) ;
+        const float             spacing             = 1.0f / float( numVortonsPerSide ) ;
+        unsigned                index[3] ;
+        for( index[2] = 0 ; index[2] < numVortonsPerSide ; ++ index[2] )
+        for( index[1] = 0 ; index[1] < numVortonsPerSide ; ++ index[1] )
+        for( index[0] = 0 ; index[0] < numVortonsPerSide ; ++ index[0] )
+        {   // For each vorton in a cube, with vorticity that varies so that vortons stretch and tilt...
+            const Vec3 vPosition( ( float( index[0] ) + 0.5f ) * spacing , ( float( index[1] ) + 0.5f ) * spacing , ( float( index[2] ) + 0.5f ) * spacing ) ;
+            vortonSim.GetVortons().PushBack( Vorton( vPosition , Vec3( vPosition.y - 0.5f , 0.5f - vPosition.x , 1.0f ) , 0.5f * spacing ) ) ;
+        }
+        vortonSim.Initialize( 2 ) ;
+        for( unsigned uFrame = 0 ; uFrame < 2 ; ++ uFrame )
+        {
+            vortonSim.Update( 0.01f , uFrame ) ;
+        }
+        vortonSim.CreateInfluenceTree() ;   // Index particles where the next frame would.
+
+        UniformGrid< Vorton > &     rLeaves     = vortonSim.mInfluenceTree[ 0 ] ;
+        const ParticleCellIndex *   indices[2]  = { & vortonSim.mVortonCells , & vortonSim.mTracerCells } ;
+        unsigned                    numMisplaced = 0 ;
+        for( unsigned iKind = 0 ; iKind < 2 ; ++ iKind )
+        {   // For vortons, then tracers...
+            const ParticleCellIndex & rIndex        = * indices[ iKind ] ;
+            const size_t              numParticles  = iKind ? vortonSim.GetTracers().Size() : vortonSim.GetVortons().Size() ;
+            assert( rIndex.GetGeometry().GetGridCapacity() == rLeaves.GetGridCapacity() ) ;    // Index shares the leaf geometry.
+            assert( rIndex.GetNumParticles() == numParticles ) ;
+            Vector< unsigned > timesListed ;
+            timesListed.Resize( numParticles , 0 ) ;
+            for( unsigned cell = 0 ; cell < rLeaves.GetGridCapacity() ; ++ cell )
+            {   // For each cell, check the particles listed in it.
+                for( unsigned iSorted = rIndex.GetCellBegin( cell ) ; iSorted < rIndex.GetCellEnd( cell ) ; ++ iSorted )
+                {
+                    const unsigned  iParticle = rIndex.GetParticle( iSorted ) ;
+                    const Vec3 &    rPosition = iKind ? vortonSim.GetTracers()[ iParticle ].mPosition : vortonSim.GetVortons()[ iParticle ].mPosition ;
+                    ++ timesListed[ iParticle ] ;
+                    numMisplaced += ( rLeaves.OffsetOfPosition( rPosition ) != cell ) || ( rIndex.GetCellOfParticle( iParticle ) != cell ) ;
+                    assert( ( iSorted == rIndex.GetCellBegin( cell ) ) || ( rIndex.GetParticle( iSorted - 1 ) < iParticle ) ) ; // Stable within each cell.
+                }
+            }
+            for( size_t iParticle = 0 ; iParticle < numParticles ; ++ iParticle )
+            {
+                assert( 1 == timesListed[ iParticle ] ) ;
+            }
+        }
+
+        float maxLeafDifference = 0.0f ;
+        for( unsigned cell = 0 ; cell < rLeaves.GetGridCapacity() ; ++ cell )
+        {   // For each leaf, compare its vorticity with the sum over vortons the index lists in it.
+            Vec3 vortSum( 0.0f , 0.0f , 0.0f ) ;
+            for( unsigned iSorted = vortonSim.mVortonCells.GetCellBegin( cell ) ; iSorted < vortonSim.mVortonCells.GetCellEnd( cell ) ; ++ iSorted )
+            {
+                vortSum += vortonSim.GetVortons()[ vortonSim.mVortonCells.GetParticle( iSorted ) ].mVorticity ;
+            }
+            maxLeafDifference = MAX2( maxLeafDifference , ( rLeaves[ cell ].mVorticity - vortSum ).Magnitude() ) ;
+        }
+        fprintf( stderr , "particle index: %u vortons, %u tracers, %u misplaced, max leaf difference=%g\n" , unsigned( vortonSim.GetVortons().Size() ) , unsigned( vortonSim.GetTracers().Size() ) , numMisplaced , maxLeafDifference ) ;
+        assert( vortonSim.GetTracers().Size() > 0 ) ;
+        assert( 0 == numMisplaced ) ;
+        assert( maxLeafDifference < 1.0e-5f ) ;
+    }
+
+    {   // Test that updating a particle cell index matches rebuilding it, and costs time proportional to the number of particles that moved.
+        static const unsigned       numParticles    = 1u << 21 ;
+        static const unsigned       numMoversList[] = { 16 , 256 , 4096 } ;
+        const UniformGridGeometry   grid( numParticles , Vec3( 0.0f , 0.0f , 0.0f ) , Vec3( 1.0f , 1.0f , 1.0f ) , false ) ;
+        const Vec3                  vSpacing        = grid.GetCellSpacing() ;
+        Vector< Vec3 >              positions( numParticles ) ;
+        unsigned                    seed            = 1 ;
+        for( unsigned iParticle = 0 ; iParticle < numParticles ; ++ iParticle )
+        {   // For each particle, choose a pseudo-random position in the grid.
+            float coordinates[3] ;
+            for( unsigned axis = 0 ; axis < 3 ; ++ axis )
+            {
+                seed = seed * 1664525u + 1013904223u ;
+                coordinates[ axis ] = float( seed >> 8 ) / float( 1u << 24 ) ;
+            }
+            positions[ iParticle ] = Vec3( coordinates[0] , coordinates[1] , coordinates[2] ) ;
+        }
+
+        ParticleCellIndex   updated ;
+        ParticleCellIndex   rebuilt ;
+        double              rebuildSeconds  = 0.0 ;
+        double              updateSeconds[ sizeof( numMoversList ) / sizeof( numMoversList[0] ) ] ;
+        for( unsigned iTrial = 0 ; iTrial <= sizeof( numMoversList ) / sizeof( numMoversList[0] ) ; ++ iTrial )
+        {   // For each trial: first build, then update after moving successively more particles.
+            if( iTrial > 0 )
+            {   // Move some particles by one cell along x, wrapping around the grid.
+                const unsigned numMovers = numMoversList[ iTrial - 1 ] ;
+                for( unsigned iMover = 0 ; iMover < numMovers ; ++ iMover )
+                {
+                    Vec3 & rPosition = positions[ iMover * ( numParticles / numMovers ) ] ;
+                    rPosition.x = fmodf( rPosition.x + vSpacing.x , 1.0f ) ;
+                }
+                assert( updated.CanUpdate( grid , numParticles ) ) ;
+                updated.BeginUpdate( 1 ) ;
+            }
+            else
+            {
+                updated.Reset( grid , numParticles , 1 ) ;
+            }
+            for( unsigned iParticle = 0 ; iParticle < numParticles ; ++ iParticle )
+            {
+                updated.AddParticle( 0 , iParticle , positions[ iParticle ] , 0.0f ) ;
+            }
+            const double timeBegin  = QueryPerformanceSeconds() ;
+            const bool   bComplete  = updated.ApplyMoves( 0.25f ) ;
+            if( iTrial > 0 )
+            {   // ApplyMoves updated the index.
+                assert( bComplete ) ;
+                updateSeconds[ iTrial - 1 ] = QueryPerformanceSeconds() - timeBegin ;
+            }
+            else
+            {   // Rebuild.
+                assert( ! bComplete ) ;
+                updated.CountChunk( 0 ) ;
+                updated.AccumulateCounts() ;
+                updated.ScatterChunk( 0 ) ;
+                rebuildSeconds = QueryPerformanceSeconds() - timeBegin ;
+            }
+
+            // Compare with an index rebuilt from scratch.
+            rebuilt.Reset( grid , numParticles , 1 ) ;
+            for( unsigned iParticle = 0 ; iParticle < numParticles ; ++ iParticle )
+            {
+                rebuilt.AddParticle( 0 , iParticle , positions[ iParticle ] , 0.0f ) ;
+            }
+            rebuilt.AccumulateCounts() ;
+            rebuilt.ScatterChunk( 0 ) ;
+            for( unsigned cell = 0 ; cell < grid.GetGridCapacity() ; ++ cell )
+            {   // For each cell, check that both indices hold the same particles in the same order.
+                assert( updated.GetCellEnd( cell ) - updated.GetCellBegin( cell ) == rebuilt.GetCellEnd( cell ) - rebuilt.GetCellBegin( cell ) ) ;
+                for( unsigned iInCell = 0 ; iInCell < rebuilt.GetCellEnd( cell ) - rebuilt.GetCellBegin( cell ) ; ++ iInCell )
+                {
+                    assert( updated.GetParticle( updated.GetCellBegin( cell ) + iInCell ) == rebuilt.GetParticle( rebuilt.GetCellBegin( cell ) + iInCell ) ) ;
+                }
+            }
+        }
+        fprintf( stderr , "particle cell index of %u particles: rebuild %g s, update of %u/%u/%u movers %g/%g/%g s\n" , numParticles , rebuildSeconds
+            , numMoversList[0] , numMoversList[1] , numMoversList[2] , updateSeconds[0] , updateSeconds[1] , updateSeconds[2] ) ;
+        assert( updateSeconds[0] * 100.0 < rebuildSeconds ) ;   // Merging every cell, as a rebuild does, would take about as long as rebuilding.
+    }
+
+    {   // Test packing an influence tree at half precision when its clusters aggregate more vorticity than half precision can represent.
+        // Each vorton lies well within range, but coarse clusters sum so many that their vorticity exceeds 65504.
+        static const unsigned   numVortonsPerSide   = 10 ;
+        static const float      vortonVorticity     = 1000.0f ;
+        VortonSim               vortonSim( 0.0f , 1.0f ) ;
+        const float             spacing             = 1.0f / float( numVortonsPerSide ) ;
+        unsigned                index[3] ;
+        for( index[2] = 0 ; index[2] < numVortonsPerSide ; ++ index[2] )
+        for( index[1] = 0 ; index[1] < numVortonsPerSide ; ++ index[1] )
+        for( index[0] = 0 ; index[0] < numVortonsPerSide ; ++ index[0] )
+        {   // For each vorton in a cube, all spinning the same way...
+            const Vec3 vPosition( ( float( index[0] ) + 0.5f ) * spacing , ( float( index[1] ) + 0.5f ) * spacing , ( float( index[2] ) + 0.5f ) * spacing ) ;
+            vortonSim.GetVortons().PushBack( Vorton( vPosition , Vec3( 0.0f , 0.0f , vortonVorticity ) , 0.5f * spacing ) ) ;
+        }
+        vortonSim.CreateInfluenceTree() ;
+
+        const size_t numLayers = vortonSim.mInfluenceTree.GetDepth() ;
+        assert( numLayers >= 3 ) ;  // Need a packed layer above the leaves and below the root.
+        float vortMaxComponent = 0.0f ;
+        for( size_t offset = 0 ; offset < vortonSim.mInfluenceTree[ numLayers - 2 ].GetGridCapacity() ; ++ offset )
+        {
+            vortMaxComponent = MAX2( vortMaxComponent , fabsf( vortonSim.mInfluenceTree[ numLayers - 2 ][ offset ].mVorticity.z ) ) ;
+        }
+        assert( vortMaxComponent > 65504.0f ) ; // Test exercises values beyond half-precision range.
+
+        static const Vec3   probes[]    = { Vec3( 3.0f , 0.5f , 0.5f ) , Vec3( 0.5f , -2.0f , 0.25f ) , Vec3( -1.0f , 1.5f , 2.0f ) } ;
+        static const size_t numProbes   = sizeof( probes ) / sizeof( probes[0] ) ;
+        Vec3                reference[ numProbes ] ;
+        vortonSim.SetTreePrecision( STORAGE_FLOAT32 ) ;
+        vortonSim.PackInfluenceTree() ;
+        for( size_t iProbe = 0 ; iProbe < numProbes ; ++ iProbe )
+        {
+            reference[ iProbe ] = vortonSim.ComputeVelocityFromVortons( probes[ iProbe ] ) ;
+        }
+        vortonSim.SetTreePrecision( STORAGE_FLOAT16 ) ;
+        vortonSim.PackInfluenceTree() ;
+        for( size_t iProbe = 0 ; iProbe < numProbes ; ++ iProbe )
+        {   // For each point outside the cube, where velocity comes from coarse, packed clusters...
+            const Vec3  velocity        = vortonSim.ComputeVelocityFromVortons( probes[ iProbe ] ) ;
+            const float relativeError   = ( velocity - reference[ iProbe ] ).Magnitude() / reference[ iProbe ].Magnitude() ;
+            fprintf( stderr , "packed cluster vorticity %g: probe %u relative error=%g\n" , vortMaxComponent , unsigned( iProbe ) , relativeError ) ;
+            assert( relativeError < 1.0e-2f ) ; // Also fails if packing overflowed to infinity, which makes velocity infinite or NaN.
+        }
+    }
+
+    {   // Test that assigning vortons from a vorticity grid replaces existing vortons with one per significant gridpoint, in gridpoint order, across chunks.
+        UniformGrid< Vec3 > vortGrid( 8000 , Vec3( -1.0f , -1.0f , -1.0f ) , Vec3( 1.0f , 1.0f , 1.0f ) , false ) ;
+        vortGrid.Init( Vec3( 0.0f , 0.0f , 0.0f ) ) ;
+        for( unsigned offset = 0 ; offset < vortGrid.Size() ; ++ offset )
+        {   // For every fifth gridpoint, assign significant vorticity.
+            if( 0 == offset % 5 )
+            {
+                vortGrid[ offset ] = Vec3( 1.0f , float( offset ) , 0.0f ) ;
+            }
+        }
+        VortonSim vortonSim( 0.0f , 1.0f ) ;
+        for( unsigned iVorton = 0 ; iVorton < 3 ; ++ iVorton )
+        {   // For a few vortons, which assignment must discard...
+            vortonSim.GetVortons().PushBack( Vorton( Vec3( 5.0f , 5.0f , 5.0f ) , Vec3( 0.0f , 0.0f , 1.0f ) , 0.1f ) ) ;
+        }
+        vortonSim.AssignVortonsFromVorticity( vortGrid ) ;
+
+        const ChunkedVector< Vorton > & rVortons    = static_cast< const VortonSim & >( vortonSim ).GetVortons() ;
+        size_t                          iVorton     = 0 ;
+        float                           maxPosError = 0.0f ;
+        bool                            bOrdered    = true ;
+        for( unsigned offset = 0 ; offset < vortGrid.Size() ; ++ offset )
+        {   // For each significant gridpoint, expect the next vorton to lie there and carry its vorticity.
+            if( vortGrid[ offset ].Mag2() > 0.0f )
+            {
+                Vec3 vPosition ;
+                vortGrid.PositionFromOffset( vPosition , offset ) ;
+                if( iVorton < rVortons.Size() )
+                {
+                    bOrdered    = bOrdered && ( rVortons[ iVorton ].mVorticity == vortGrid[ offset ] ) ;
+                    maxPosError = MAX2( maxPosError , ( rVortons[ iVorton ].mPosition - vPosition ).Magnitude() ) ;
+                }
+                ++ iVorton ;
+            }
+        }
+        fprintf( stderr , "vortons from vorticity: %u vortons in %u chunks, ordered=%d, max position error=%g\n" , unsigned( rVortons.Size() ) , unsigned( rVortons.GetNumChunks() ) , bOrdered , maxPosError ) ;
+        assert( rVortons.Size() == iVorton ) ;
+        assert( rVortons.GetNumChunks() > 1 ) ;
+        assert( bOrdered ) ;
+        assert( maxPosError < 1.0e-5f ) ;
+    }
+
+    {   // Test that derived fields compute only the slices a region needs, match computing them outright, and go stale when the velocity grid changes.
+        static const unsigned   numVortonsPerSide   = 6 ;
+        VortonSim               vortonSim( 0.0f , 1.0f ) ;
+        const float             spacing             = 1.0f / float( numVortonsPerSide ) ;
+        unsigned                index[3] ;
+        for( index[2] = 0 ; index[2] < numVortonsPerSide ; ++ index[2] )
+        for( index[1] = 0 ; index[1] < numVortonsPerSide ; ++ index[1] )
+        for( index[0] = 0 ; index[0] < numVortonsPerSide ; ++ index[0] )
+        {   // For each vorton in a cube, with vorticity that varies so that vortons stretch and tilt...
+            const Vec3 vPosition( ( float( index[0] ) + 0.5f ) * spacing , ( float( index[1] ) + 0.5f ) * spacing , ( float( index[2] ) + 0.5f ) * spacing ) ;
+            vortonSim.GetVortons().PushBack( Vorton( vPosition , Vec3( vPosition.y - 0.5f , 0.5f - vPosition.x , 1.0f ) , 0.5f * spacing ) ) ;
+        }
+        vortonSim.GetTracers().PushBack( Particle() ) ;    // Tracers need the velocity grid.
+        vortonSim.Update( 0.01f , 0 ) ;
+
+        float maxDifference = 0.0f ;
+        for( unsigned uFrame = 1 ; uFrame < 3 ; ++ uFrame )
+        {   // For each of two frames, each with its own velocity grid...
+            const Vector< unsigned char > & rSliceValid = vortonSim.mDerivedSliceValid[ DERIVED_VORTICITY ] ;
+            const size_t                    numZ        = vortonSim.GetVelocityGrid().GetNumPoints( 2 ) ;
+            assert( 0 == rSliceValid.Size() ) ;    // Nothing has requested vorticity since the velocity grid changed.
+
+            // Request vorticity only near the bottom of the domain.
+            const Vec3 & vMin       = vortonSim.GetVelocityGrid().GetMinCorner() ;
+            const Vec3 & vExtent    = vortonSim.GetVelocityGrid().GetExtent() ;
+            vortonSim.GetVorticityGrid( vMin , vMin + Vec3( vExtent.x , vExtent.y , 0.1f * vExtent.z ) ) ;
+            size_t numValid = 0 ;
+            for( size_t iz = 0 ; iz < numZ ; ++ iz )
+            {
+                numValid += rSliceValid[ iz ] ;
+            }
+            assert( ( numValid > 0 ) && ( numValid < numZ ) ) ;
+
+            // Compute vorticity outright, and compare it with the cache, first where the regional request made it current, then everywhere.
+            UniformGrid< Mat33 >    jacobian( vortonSim.GetVelocityGrid() ) ;
+            UniformGrid< Vec3 >     vorticity( vortonSim.GetVelocityGrid() ) ;
+            jacobian.Init() ;
+            vorticity.Init() ;
+            ComputeJacobian( jacobian , vortonSim.GetVelocityGrid() , vortonSim.mFiniteDifferenceScheme ) ;
+            ComputeCurlFromJacobian( vorticity , jacobian ) ;
+            const size_t numXY = vortonSim.GetVelocityGrid().GetNumPoints( 0 ) * vortonSim.GetVelocityGrid().GetNumPoints( 1 ) ;
+            for( unsigned iPass = 0 ; iPass < 2 ; ++ iPass )
+            {
+                const UniformGrid< Vec3 > & rCached = iPass ? vortonSim.GetVorticityGrid() : vortonSim.mVorticityGrid ;
+                for( size_t offset = 0 ; offset < numValid * numXY ; ++ offset )
+                {
+                    maxDifference = MAX2( maxDifference , ( rCached[ unsigned( offset ) ] - vorticity[ unsigned( offset ) ] ).Magnitude() ) ;
+                }
+                numValid = numZ ;
+            }
+            vortonSim.Update( 0.01f , uFrame ) ;
+        }
+        fprintf( stderr , "derived fields: max difference from outright vorticity=%g\n" , maxDifference ) ;
+        assert( 0.0f == maxDifference ) ;
+    }
+
+    {   // Test that a vortex ring represented by a filament carries the impulse, induces the velocity and translates like the same ring represented by vortons.
+        VortonSim           vortons( 0.0f , 1.0f ) ;
+        VortonSim           filament( 0.0f , 1.0f ) ;
+        const VortexRing    ring( 1.0f , 0.5f , Vec3( 1.0f , 0.0f , 0.0f ) ) ;
+        AssignVorticity( vortons.GetVortons() , 20.0f , 4096 , ring ) ;
+        const bool bAssigned = AssignFilaments( filament.GetFilaments() , 20.0f , 64 , ring ) ;
+        assert( bAssigned ) ;
+        assert( ( 0 == filament.GetVortons().Size() ) && ( 1 == filament.GetFilaments().Size() ) ) ;
+
+        Vec3 vCirculation , vImpulseVortons , vImpulseFilament ;
+        vortons.ConservedQuantities( vCirculation , vImpulseVortons ) ;
+        filament.ConservedQuantities( vCirculation , vImpulseFilament ) ;
+        const float impulseError = ( vImpulseFilament - vImpulseVortons ).Magnitude() / vImpulseVortons.Magnitude() ;
+
+        const Vec3  vProbe( 2.0f , 0.0f , 0.5f ) ;
+        Vec3        velFilament( 0.0f , 0.0f , 0.0f ) ;
+        filament.GetFilaments()[ 0 ].AccumulateVelocity( velFilament , vProbe ) ;
+        const Vec3  velVortons      = vortons.ComputeVelocityBruteForce( vProbe ) ;
+        const float velocityError   = ( velFilament - velVortons ).Magnitude() / velVortons.Magnitude() ;
+
+        vortons.Initialize( 0 ) ;
+        filament.Initialize( 0 ) ;
+        for( unsigned uFrame = 0 ; uFrame < 10 ; ++ uFrame )
+        {
+            vortons.Update( 0.01f , uFrame ) ;
+            filament.Update( 0.01f , uFrame ) ;
+        }
+        Vec3    vCenterVortons( 0.0f , 0.0f , 0.0f ) ;
+        float   vortWeight = 0.0f ;
+        for( size_t iVorton = 0 ; iVorton < vortons.GetVortons().Size() ; ++ iVorton )
+        {   // For each vorton, accumulate center of vorticity.
+            const Vorton & rVorton = vortons.GetVortons()[ iVorton ] ;
+            vCenterVortons  += rVorton.mPosition * rVorton.mVorticity.Magnitude() ;
+            vortWeight      += rVorton.mVorticity.Magnitude() ;
+        }
+        vCenterVortons /= vortWeight ;
+        const VortexFilament &  rFilament       = filament.GetFilaments()[ 0 ] ;
+        Vec3                    vCenterFilament( 0.0f , 0.0f , 0.0f ) ;
+        for( size_t iSegment = 0 ; iSegment < rFilament.GetNumSegments() ; ++ iSegment )
+        {   // For each segment, accumulate center of filament.
+            vCenterFilament += rFilament.GetSegmentBegin( iSegment ) ;
+        }
+        vCenterFilament /= float( rFilament.GetNumSegments() ) ;
+        fprintf( stderr , "filament ring: impulse error=%g, velocity error=%g, advance vortons=%g filament=%g\n" , impulseError , velocityError , vCenterVortons.x , vCenterFilament.x ) ;
+        assert( impulseError < 0.1f ) ;
+        assert( velocityError < 0.1f ) ;
+        assert( vCenterFilament.x > 0.0f ) ;
+        assert( fabsf( vCenterFilament.x - vCenterVortons.x ) < 0.35f * vCenterVortons.x ) ;    // Core models differ, so speeds agree only roughly.
+    }
+
+    {   // Test that cached traversal cuts persist across frames that refit the influence tree, and give the velocity grid that traversing from the root gives.
+        static const unsigned   numVortonsPerSide   = 8 ;
+        VortonSim               uncached( 0.0f , 1.0f ) ;
+        VortonSim               cached( 0.0f , 1.0f ) ;
+        const float             spacing             = 1.0f / float( numVortonsPerSide ) ;
+        unsigned                index[3] ;
+        for( index[2] = 0 ; index[2] < numVortonsPerSide ; ++ index[2] )
+        for( index[1] = 0 ; index[1] < numVortonsPerSide ; ++ index[1] )
+        for( index[0] = 0 ; index[0] < numVortonsPerSide ; ++ index[0] )
+        {   // For each vorton in a cube, with vorticity that varies so that vortons stretch and tilt...
+            const Vec3 vPosition( ( float( index[0] ) + 0.5f ) * spacing , ( float( index[1] ) + 0.5f ) * spacing , ( float( index[2] ) + 0.5f ) * spacing ) ;
+            const Vorton vorton( vPosition , Vec3( vPosition.y - 0.5f , 0.5f - vPosition.x , 1.0f ) , 0.5f * spacing ) ;
+            uncached.GetVortons().PushBack( vorton ) ;
+            cached.GetVortons().PushBack( vorton ) ;
+        }
+        uncached.GetTracers().PushBack( Particle() ) ;  // Tracers need the velocity grid.
+        cached.GetTracers().PushBack( Particle() ) ;
+        uncached.SetRefitTolerance( 0.25f ) ;
+        cached.SetRefitTolerance( 0.25f ) ;
+        cached.SetTraversalCutCaching( true ) ;
+
+        float       maxRelativeDifference   = 0.0f ;
+        unsigned    numFramesReusingCuts    = 0 ;
+        for( unsigned uFrame = 0 ; uFrame < 4 ; ++ uFrame )
+        {   // For each frame...
+            static const size_t sentinelCapacity = 4096 ;  // Rebuilding cuts would give each a smaller capacity than this.
+            if( cached.mTraversalCuts.Size() > 0 )
+            {   // Mark a cut, without changing its contents, to tell whether the next frame keeps it.
+                cached.mTraversalCuts[ 0 ].mAccepted.Reserve( sentinelCapacity ) ;
+            }
+            uncached.Update( 0.01f , uFrame ) ;
+            cached.Update( 0.01f , uFrame ) ;
+            assert( 0 == uncached.mTraversalCuts.Size() ) ;
+            assert( cached.mTraversalCuts.Size() > 0 ) ;
+            numFramesReusingCuts += ( cached.mTraversalCuts[ 0 ].mAccepted.Capacity() >= sentinelCapacity ) ;
+
+            const UniformGrid< Vec3 > & rVelUncached    = uncached.GetVelocityGrid() ;
+            const UniformGrid< Vec3 > & rVelCached      = cached.GetVelocityGrid() ;
+            float                       velMax          = 0.0f ;
+            float                       diffMax         = 0.0f ;
+            assert( rVelUncached.Size() == rVelCached.Size() ) ;
+            for( unsigned offset = 0 ; offset < rVelCached.Size() ; ++ offset )
+            {   // For each gridpoint, compare velocity with and without cached cuts.
+                velMax  = MAX2( velMax  , rVelUncached[ offset ].Magnitude() ) ;
+                diffMax = MAX2( diffMax , ( rVelCached[ offset ] - rVelUncached[ offset ] ).Magnitude() ) ;
+            }
+            maxRelativeDifference = MAX2( maxRelativeDifference , diffMax / velMax ) ;
+        }
+        fprintf( stderr , "traversal cuts: %u cuts, reused in %u frames, max relative difference=%g\n" , unsigned( cached.mTraversalCuts.Size() ) , numFramesReusingCuts , maxRelativeDifference ) ;
+        assert( numFramesReusingCuts > 0 ) ;
+        assert( maxRelativeDifference < 1.0e-4f ) ;
+    }
+
+    {   // Test that the Hilbert curve visits every cell once, stepping between neighbors, and that velocity tiles follow it.
+        static const unsigned   numBits     = 3 ;
+        static const unsigned   numKeys     = 1u << ( 3 * numBits ) ;
+        unsigned                numBadSteps = 0 ;
+        unsigned                prevIndices[3] = { 0 , 0 , 0 } ;
+        for( unsigned key = 0 ; key < numKeys ; ++ key )
+        {   // For each key along the curve, decode its cell, re-encode it, and measure the step from the previous cell.
+            unsigned indices[3] ;
+            HilbertIndices( indices , key , numBits ) ;
+            assert( HilbertKey( indices , numBits ) == key ) ;    // Round trip, so each key has its own cell.
+            if( key > 0 )
+            {
+                const int step = abs( int( indices[0] ) - int( prevIndices[0] ) ) + abs( int( indices[1] ) - int( prevIndices[1] ) ) + abs( int( indices[2] ) - int( prevIndices[2] ) ) ;
+                numBadSteps += ( step != 1 ) ;
+            }
+            prevIndices[0] = indices[0] ; prevIndices[1] = indices[1] ; prevIndices[2] = indices[2] ;
+        }
+
+        static const unsigned   numVortonsPerSide   = 6 ;
+        VortonSim               vortonSim( 0.0f , 1.0f ) ;
+        const float             spacing             = 1.0f / float( numVortonsPerSide ) ;
+        unsigned                index[3] ;
+        for( index[2] = 0 ; index[2] < numVortonsPerSide ; ++ index[2] )
+        for( index[1] = 0 ; index[1] < numVortonsPerSide ; ++ index[1] )
+        for( index[0] = 0 ; index[0] < numVortonsPerSide ; ++ index[0] )
+        {   // For each vorton in a cube...
+            const Vec3 vPosition( ( float( index[0] ) + 0.5f ) * spacing , ( float( index[1] ) + 0.5f ) * spacing , ( float( index[2] ) + 0.5f ) * spacing ) ;
+            vortonSim.GetVortons().PushBack( Vorton( vPosition , Vec3( vPosition.y - 0.5f , 0.5f - vPosition.x , 1.0f ) , 0.5f * spacing ) ) ;
+        }
+        vortonSim.GetTracers().PushBack( Particle() ) ;    // Tracers need the velocity grid.
+        vortonSim.Update( 0.01f , 0 ) ;
+        const Vector< unsigned > &  rOrder      = vortonSim.mVelocityTileOrder ;
+        const unsigned * const      numTiles    = vortonSim.mNumVelocityTiles ;
+        Vector< unsigned >          timesVisited ;
+        timesVisited.Resize( rOrder.Size() , 0 ) ;
+        for( size_t iOrder = 0 ; iOrder < rOrder.Size() ; ++ iOrder )
+        {
+            ++ timesVisited[ rOrder[ iOrder ] ] ;
+        }
+        for( size_t iTile = 0 ; iTile < rOrder.Size() ; ++ iTile )
+        {
+            assert( 1 == timesVisited[ iTile ] ) ;
+        }
+        assert( ( numTiles[0] >= 2 ) && ( numTiles[1] >= 2 ) && ( numTiles[2] >= 2 ) ) ;
+        for( size_t iOrder = 0 ; iOrder < 8 ; ++ iOrder )
+        {   // For each of the first 8 tiles along the curve, expect it in the 2x2x2 block of tiles at the origin, as for any Hilbert curve.
+            const unsigned iTile = rOrder[ iOrder ] ;
+            assert( ( iTile % numTiles[0] < 2 ) && ( ( iTile / numTiles[0] ) % numTiles[1] < 2 ) && ( iTile / ( numTiles[0] * numTiles[1] ) < 2 ) ) ;
+        }
+        fprintf( stderr , "Hilbert curve: %u keys, %u non-adjacent steps; velocity grid has %u x %u x %u tiles\n" , numKeys , numBadSteps , numTiles[0] , numTiles[1] , numTiles[2] ) ;
+        assert( 0 == numBadSteps ) ;
+    }
+
+    {   // Test that fourth-order finite differences converge at fourth order, and central second-order at second order, away from faces.
+        static const FiniteDifferenceScheme schemes[]   = { FINITE_DIFFERENCE_CENTRAL2 , FINITE_DIFFERENCE_CENTRAL4 , FINITE_DIFFERENCE_COMPACT4 } ;
+        static const unsigned               numCells[]  = { 12 , 24 } ;
+        static const unsigned               numSchemes  = sizeof( schemes ) / sizeof( schemes[0] ) ;
+        float                               maxErrors[ numSchemes ][ 2 ] ;
+        for( unsigned iRes = 0 ; iRes < 2 ; ++ iRes )
+        {   // For each resolution...
+            const unsigned      numPoints = numCells[ iRes ] + 1 ;
+            UniformGrid< Vec3 > velocity( POW3( numCells[ iRes ] ) , Vec3( 0.0f , 0.0f , 0.0f ) , Vec3( 3.0f , 3.0f , 3.0f ) , false ) ;
+            velocity.Init() ;
+            assert( velocity.GetNumPoints( 0 ) == numPoints ) ;
+            for( unsigned offset = 0 ; offset < velocity.Size() ; ++ offset )
+            {   // For each gridpoint, assign a smooth field whose derivatives are known.
+                Vec3 vPosition ;
+                velocity.PositionFromOffset( vPosition , offset ) ;
+                velocity[ offset ] = Vec3( sinf( 2.0f * vPosition.y ) , sinf( 2.0f * vPosition.z ) , sinf( 2.0f * vPosition.x ) ) ;
+            }
+            for( unsigned iScheme = 0 ; iScheme < numSchemes ; ++ iScheme )
+            {   // For each scheme, compute the Jacobian and compare it, away from faces, with the exact one.
+                UniformGrid< Mat33 > jacobian( velocity ) ;
+                jacobian.Init() ;
+                ComputeJacobian( jacobian , velocity , schemes[ iScheme ] ) ;
+                float    maxError = 0.0f ;
+                unsigned indices[3] ;
+                for( indices[2] = 3 ; indices[2] + 3 < numPoints ; ++ indices[2] )
+                for( indices[1] = 3 ; indices[1] + 3 < numPoints ; ++ indices[1] )
+                for( indices[0] = 3 ; indices[0] + 3 < numPoints ; ++ indices[0] )
+                {   // For each gridpoint at least 3 cells from every face...
+                    const unsigned offset = indices[0] + numPoints * ( indices[1] + numPoints * indices[2] ) ;
+                    Vec3 vPosition ;
+                    velocity.PositionFromOffset( vPosition , offset ) ;
+                    const Mat33 exact( Vec3( 0.0f , 0.0f , 2.0f * cosf( 2.0f * vPosition.x ) ) , Vec3( 2.0f * cosf( 2.0f * vPosition.y ) , 0.0f , 0.0f ) , Vec3( 0.0f , 2.0f * cosf( 2.0f * vPosition.z ) , 0.0f ) ) ;
+                    maxError = MAX2( maxError , ( jacobian[ offset ].x - exact.x ).Magnitude() ) ;
+                    maxError = MAX2( maxError , ( jacobian[ offset ].y - exact.y ).Magnitude() ) ;
+                    maxError = MAX2( maxError , ( jacobian[ offset ].z - exact.z ).Magnitude() ) ;
+                }
+                maxErrors[ iScheme ][ iRes ] = maxError ;
+            }
+        }
+        const float ratioCentral2 = maxErrors[0][0] / maxErrors[0][1] ;
+        const float ratioCentral4 = maxErrors[1][0] / maxErrors[1][1] ;
+        const float ratioCompact4 = maxErrors[2][0] / maxErrors[2][1] ;
+        fprintf( stderr , "finite differences: error ratio on halving spacing central2=%g central4=%g compact4=%g; fine errors %g %g %g\n"
+            , ratioCentral2 , ratioCentral4 , ratioCompact4 , maxErrors[0][1] , maxErrors[1][1] , maxErrors[2][1] ) ;
+        assert( ( ratioCentral2 > 3.0f ) && ( ratioCentral2 < 6.0f ) ) ;   // 2^2
+        assert( ratioCentral4 > 10.0f ) ;                                   // 2^4
+        assert( ratioCompact4 > 6.0f ) ;                                    // Lower-order boundary closure leaks into the implicit solve.
+        assert( maxErrors[1][1] < maxErrors[0][1] ) ;
+        assert( maxErrors[2][1] < maxErrors[1][1] ) ;                       // Compact differences have the smaller error constant.
+    }
+
+    {   // Test that grid storage is cache-line aligned, that InitUninitialized reuses storage without the zeroing pass Init makes, and that large pages only change where storage comes from.
+        UniformGrid< float > grid( POW3( 8 ) , Vec3( 0.0f , 0.0f , 0.0f ) , Vec3( 1.0f , 1.0f , 1.0f ) , false ) ;
+        grid.Init() ;
+        const unsigned numPoints = grid.GetGridCapacity() ;
+        assert( 0 == ( reinterpret_cast< size_t >( & grid[ 0 ] ) % ALIGNED_ALLOCATION_ALIGNMENT ) ) ;
+        for( unsigned offset = 0 ; offset < numPoints ; ++ offset )
+        {
+            assert( 0.0f == grid[ offset ] ) ;
+            grid[ offset ] = float( offset + 1 ) ;
+        }
+        grid.Clear() ;              // As each frame does before redefining the velocity grid.
+        grid.DefineShape( POW3( 8 ) , Vec3( 0.0f , 0.0f , 0.0f ) , Vec3( 1.0f , 1.0f , 1.0f ) , false ) ;
+        assert( grid.GetGridCapacity() == numPoints ) ;
+        grid.InitUninitialized() ;  // Storage persists across Clear, and this should not touch it.
+        for( unsigned offset = 0 ; offset < numPoints ; ++ offset )
+        {
+            assert( float( offset + 1 ) == grid[ offset ] ) ;
+        }
+        grid.Clear() ;
+        grid.DefineShape( POW3( 8 ) , Vec3( 0.0f , 0.0f , 0.0f ) , Vec3( 1.0f , 1.0f , 1.0f ) , false ) ;
+        grid.Init() ;               // Whereas Init value-initializes, so accumulation grids start at zero.
+        for( unsigned offset = 0 ; offset < numPoints ; ++ offset )
+        {
+            assert( 0.0f == grid[ offset ] ) ;
+        }
+
+        // A grid larger than one large page, with large pages requested, should behave identically.
+        UniformGrid< Vec3 > largeGrid( POW3( 64 ) , Vec3( 0.0f , 0.0f , 0.0f ) , Vec3( 1.0f , 1.0f , 1.0f ) , false ) ;
+        largeGrid.SetLargePages( true ) ;
+        assert( largeGrid.GetLargePages() ) ;
+        largeGrid.Init( Vec3( 3.0f , 4.0f , 5.0f ) ) ;
+        assert( largeGrid.GetGridCapacity() * sizeof( Vec3 ) >= 2 * 1024 * 1024 ) ;
+        assert( 0 == ( reinterpret_cast< size_t >( & largeGrid[ 0 ] ) % ALIGNED_ALLOCATION_ALIGNMENT ) ) ;
+        assert( 0.0f == ( largeGrid[ 0 ] - Vec3( 3.0f , 4.0f , 5.0f ) ).Mag2() ) ;
+        assert( 0.0f == ( largeGrid[ largeGrid.GetGridCapacity() - 1 ] - Vec3( 3.0f , 4.0f , 5.0f ) ).Mag2() ) ;
+
+        // Growing keeps existing elements and keeps alignment; resize value-initializes new ones.
+        AlignedVector< float > values ;
+        values.resize( 3 ) ;
+        assert( ( 0.0f == values[ 0 ] ) && ( 0.0f == values[ 2 ] ) ) ;
+        values[ 1 ] = 7.0f ;
+        values.resize( 1000 ) ;
+        assert( ( 7.0f == values[ 1 ] ) && ( 0.0f == values[ 999 ] ) ) ;
+        assert( 0 == ( reinterpret_cast< size_t >( values.data() ) % ALIGNED_ALLOCATION_ALIGNMENT ) ) ;
+        fprintf( stderr , "aligned grid storage: %u points, large-page grid %u points, both %u-byte aligned\n" , numPoints , largeGrid.GetGridCapacity() , unsigned( ALIGNED_ALLOCATION_ALIGNMENT ) ) ;
+    }
+
+    {   // Test that velocity patches refine only requested regions and intense cores, resolve velocity more accurately there, and blend continuously into the velocity grid.
+        static const unsigned   numVortonsPerSide   = 8 ;
+        static const unsigned   refinement          = 4 ;
+        VortonSim               vortonSim( 0.0f , 1.0f ) ;
+        const float             spacing             = 1.0f / float( numVortonsPerSide ) ;
+        unsigned                index[3] ;
+        for( index[2] = 0 ; index[2] < numVortonsPerSide ; ++ index[2] )
+        for( index[1] = 0 ; index[1] < numVortonsPerSide ; ++ index[1] )
+        for( index[0] = 0 ; index[0] < numVortonsPerSide ; ++ index[0] )
+        {   // For each vorton in a cube, with one intense core near the maximal corner...
+            const Vec3  vPosition( ( float( index[0] ) + 0.5f ) * spacing , ( float( index[1] ) + 0.5f ) * spacing , ( float( index[2] ) + 0.5f ) * spacing ) ;
+            const bool  bCore = ( numVortonsPerSide - 2 == index[0] ) && ( numVortonsPerSide - 2 == index[1] ) && ( numVortonsPerSide - 2 == index[2] ) ;
+            vortonSim.GetVortons().PushBack( Vorton( vPosition , ( bCore ? 10.0f : 1.0f ) * Vec3( vPosition.y - 0.5f , 0.5f - vPosition.x , 1.0f ) , 0.5f * spacing ) ) ;
+        }
+        vortonSim.GetTracers().PushBack( Particle() ) ;    // Tracers need the velocity grid.
+        vortonSim.Update( 0.01f , 0 ) ;
+        assert( 0 == vortonSim.GetVelocityPatches().Size() ) ;     // Refinement is off by default.
+
+        const Vec3 vRegionMin( 0.0f , 0.0f , 0.0f ) ;
+        const Vec3 vRegionMax( 0.2f , 0.2f , 0.2f ) ;
+        vortonSim.SetVelocityRefinement( refinement , 0.5f ) ;
+        vortonSim.AddVelocityRefinementRegion( vRegionMin , vRegionMax ) ;
+        vortonSim.Update( 0.01f , 1 ) ;
+
+        const UniformGrid< Vec3 > &             rVelGrid    = vortonSim.GetVelocityGrid() ;
+        const Vector< UniformGrid< Vec3 > > &   rPatches    = vortonSim.GetVelocityPatches() ;
+        const Vec3                              vCore       = vortonSim.GetVortons()[ ( ( numVortonsPerSide - 2 ) * numVortonsPerSide + ( numVortonsPerSide - 2 ) ) * numVortonsPerSide + ( numVortonsPerSide - 2 ) ].mPosition ;
+        const Vec3                              vMiddle( 0.5f , 0.5f , 0.5f ) ;
+        unsigned                                numPatchesCoveringRegion = 0 ;
+        unsigned                                numPatchesCoveringCore   = 0 ;
+        unsigned                                numPatchesCoveringMiddle = 0 ;
+        size_t                                  iCorePatch               = 0 ;
+        assert( rPatches.Size() > 0 ) ;
+        for( size_t iPatch = 0 ; iPatch < rPatches.Size() ; ++ iPatch )
+        {   // For each patch...
+            const UniformGrid< Vec3 > & rPatch  = rPatches[ iPatch ] ;
+            const Vec3                  vMin    = rPatch.GetMinCorner() ;
+            const Vec3                  vMax    = vMin + rPatch.GetExtent() ;
+            assert( fabsf( rPatch.GetCellSpacing().x * float( refinement ) - rVelGrid.GetCellSpacing().x ) < 1.0e-5f ) ;
+            numPatchesCoveringRegion += ( vMin.x <= vRegionMax.x ) && ( vMin.y <= vRegionMax.y ) && ( vMin.z <= vRegionMax.z ) ;
+            const bool bCoversCore    = ( vMin.x <= vCore.x   ) && ( vCore.x   <= vMax.x ) && ( vMin.y <= vCore.y   ) && ( vCore.y   <= vMax.y ) && ( vMin.z <= vCore.z   ) && ( vCore.z   <= vMax.z ) ;
+            numPatchesCoveringCore   += bCoversCore ;
+            iCorePatch                = bCoversCore ? iPatch : iCorePatch ;
+            numPatchesCoveringMiddle += ( vMin.x <= vMiddle.x ) && ( vMiddle.x <= vMax.x ) && ( vMin.y <= vMiddle.y ) && ( vMiddle.y <= vMax.y ) && ( vMin.z <= vMiddle.z ) && ( vMiddle.z <= vMax.z ) ;
+
+            unsigned idx[3] ;
+            const unsigned dims[3] = { rPatch.GetNumPoints( 0 ) , rPatch.GetNumPoints( 1 ) , rPatch.GetNumPoints( 2 ) } ;
+            for( idx[2] = 0 ; idx[2] < dims[2] ; ++ idx[2] )
+            for( idx[1] = 0 ; idx[1] < dims[1] ; ++ idx[1] )
+            for( idx[0] = 0 ; idx[0] < dims[0] ; ++ idx[0] )
+            {   // For each patch point, check that the patch evaluated the same tree as the velocity grid.
+                Vec3 vPosition ;
+                rPatch.PositionFromIndices( vPosition , idx ) ;
+                assert( 0.0f == ( rPatch[ idx[0] + dims[0] * ( idx[1] + dims[1] * idx[2] ) ] - vortonSim.ComputeVelocityFromVortons( vPosition ) ).Mag2() ) ;
+            }
+        }
+        assert( numPatchesCoveringRegion > 0 ) ;
+        assert( numPatchesCoveringCore > 0 ) ;
+        assert( 0 == numPatchesCoveringMiddle ) ;  // Vorticity there is not intense, and nobody requested refinement there.
+
+        // Compare interpolated velocity with velocity evaluated directly from the tree, around the core, and far from patches.
+        float       coarseErrorNearCore = 0.0f ;
+        float       blendedErrorNearCore= 0.0f ;
+        float       maxDifferenceMiddle = 0.0f ;
+        const float reach               = 0.5f * rVelGrid.GetCellSpacing().x ;
+        for( unsigned iSample = 0 ; iSample < 64 ; ++ iSample )
+        {
+            const Vec3  vOffset( PseudoRandom( 3 * iSample ) , PseudoRandom( 3 * iSample + 1 ) , PseudoRandom( 3 * iSample + 2 ) ) ;
+            const Vec3  vNearCore   = vCore + 0.25f * reach * vOffset ;
+            const Vec3  vNearMiddle = vMiddle + 0.02f * reach * vOffset ;
+            const Vec3  vExact      = vortonSim.ComputeVelocityFromVortons( vNearCore ) ;
+            Vec3        vCoarse , vBlended ;
+            rVelGrid.Interpolate( vCoarse , vNearCore ) ;
+            vortonSim.InterpolateVelocity( vBlended , vNearCore ) ;
+            coarseErrorNearCore  += ( vCoarse  - vExact ).Magnitude() ;
+            blendedErrorNearCore += ( vBlended - vExact ).Magnitude() ;
+            rVelGrid.Interpolate( vCoarse , vNearMiddle ) ;
+            vortonSim.InterpolateVelocity( vBlended , vNearMiddle ) ;
+            maxDifferenceMiddle = MAX2( maxDifferenceMiddle , ( vBlended - vCoarse ).Magnitude() ) ;
+        }
+        assert( blendedErrorNearCore < 0.5f * coarseErrorNearCore ) ;
+        assert( 0.0f == maxDifferenceMiddle ) ;
+
+        // Sample just inside the face of the core patch that faces the middle, where the patch must fade out to meet the velocity grid.
+        const UniformGrid< Vec3 > & rCorePatch  = rPatches[ iCorePatch ] ;
+        const Vec3                  vFaceMin    = rCorePatch.GetMinCorner() ;
+        const Vec3                  vFaceExtent = rCorePatch.GetExtent() ;
+        assert( vFaceMin.x > rVelGrid.GetMinCorner().x ) ; // Face lies within velocity grid, so unpatched cells lie beyond it.
+        float maxEdgeDifference = 0.0f ;
+        float maxFineGap        = 0.0f ;
+        for( unsigned iSample = 0 ; iSample < 64 ; ++ iSample )
+        {
+            const Vec3 vPosition( vFaceMin.x + 1.0e-4f * rCorePatch.GetCellSpacing().x
+                                , vFaceMin.y + ( 0.5f + 0.1f * PseudoRandom( 2 * iSample     ) ) * vFaceExtent.y
+                                , vFaceMin.z + ( 0.5f + 0.1f * PseudoRandom( 2 * iSample + 1 ) ) * vFaceExtent.z ) ;
+            Vec3 vBlended , vCoarse , vFine ;
+            vortonSim.InterpolateVelocity( vBlended , vPosition ) ;
+            rVelGrid.Interpolate( vCoarse , vPosition ) ;
+            rCorePatch.Interpolate( vFine , vPosition ) ;
+            maxEdgeDifference   = MAX2( maxEdgeDifference , ( vBlended - vCoarse ).Magnitude() ) ;
+            maxFineGap          = MAX2( maxFineGap , ( vFine - vCoarse ).Magnitude() ) ;
+        }
+        fprintf( stderr , "velocity patches: %u patches, error near core coarse=%g blended=%g, at patch edge blended-coarse=%g vs fine-coarse=%g\n"
+            , (unsigned) rPatches.Size() , coarseErrorNearCore / 64.0f , blendedErrorNearCore / 64.0f , maxEdgeDifference , maxFineGap ) ;
+        assert( maxEdgeDifference < 0.01f * maxFineGap ) ;  // Otherwise velocity would jump where the patch ends.
+    }
+
+    {   // Test gradient of potential flow around a translating sphere against central differences of that flow.
+        VortonSim vortonSim( 0.0f , 1.0f ) ;
+        vortonSim.AddPotentialFlowSphere( Vec3( 0.1f , -0.2f , 0.3f ) , 0.5f , Vec3( 1.0f , -2.0f , 0.5f ) ) ;
+        static const Vec3   probes[]    = { Vec3( 1.0f , 0.0f , 0.0f ) , Vec3( 0.2f , 0.6f , -0.4f ) , Vec3( -0.7f , -0.9f , 1.1f ) } ;
+        static const float  delta       = 1.0e-3f ;
+        for( size_t iProbe = 0 ; iProbe < sizeof( probes ) / sizeof( probes[0] ) ; ++ iProbe )
+        {   // For each point outside the sphere...
+            Mat33 velJac( Vec3( 0.0f , 0.0f , 0.0f ) , Vec3( 0.0f , 0.0f , 0.0f ) , Vec3( 0.0f , 0.0f , 0.0f ) ) ;
+            vortonSim.AccumulatePotentialFlowJacobian( velJac , probes[ iProbe ] ) ;
+            const Vec3  axes[3]     = { Vec3( delta , 0.0f , 0.0f ) , Vec3( 0.0f , delta , 0.0f ) , Vec3( 0.0f , 0.0f , delta ) } ;
+            const Vec3  rows[3]     = { velJac.x , velJac.y , velJac.z } ;
+            float       maxError    = 0.0f ;
+            for( unsigned i = 0 ; i < 3 ; ++ i )
+            {   // For each direction of differentiation, compare row i, i.e. d v / d r_i.
+                Vec3 velPlus( 0.0f , 0.0f , 0.0f ) ;
+                Vec3 velMinus( 0.0f , 0.0f , 0.0f ) ;
+                vortonSim.AccumulatePotentialFlow( velPlus  , probes[ iProbe ] + axes[ i ] ) ;
+                vortonSim.AccumulatePotentialFlow( velMinus , probes[ iProbe ] - axes[ i ] ) ;
+                const Vec3 finiteDifference = ( velPlus - velMinus ) / ( 2.0f * delta ) ;
+                maxError = MAX2( maxError , ( finiteDifference - rows[ i ] ).Magnitude() ) ;
+            }
+            fprintf( stderr , "potential flow Jacobian: probe %u error=%g trace=%g\n" , unsigned( iProbe ) , maxError , velJac.x.x + velJac.y.y + velJac.z.z ) ;
+            assert( maxError < 1.0e-2f ) ;
+            assert( fabsf( velJac.x.x + velJac.y.y + velJac.z.z ) < 1.0e-5f ) ; // Doublet flow is divergence-free.
+        }
+    }
+
+    {   // Test that leaf buckets hold every vorton once, grow shallower as capacity grows, and give velocity at least as accurate as supervorton leaves.
+        static const unsigned   numVortonsPerSide   = 12 ;
+        static const unsigned   capacities[]        = { 1 , 8 , 64 } ;
+        static const unsigned   numCapacities       = sizeof( capacities ) / sizeof( capacities[ 0 ] ) ;
+        const float             spacing             = 1.0f / float( numVortonsPerSide ) ;
+        Vector< Vorton >        vortons ;
+        Vec3                    vorticitySum( 0.0f , 0.0f , 0.0f ) ;
+        unsigned                index[3] ;
+        for( index[2] = 0 ; index[2] < numVortonsPerSide ; ++ index[2] )
+        for( index[1] = 0 ; index[1] < numVortonsPerSide ; ++ index[1] )
+        for( index[0] = 0 ; index[0] < numVortonsPerSide ; ++ index[0] )
+        {   // For each vorton in a jittered lattice, with irregular vorticity so that aggregates lose information...
+            const unsigned  i = vortons.Size() ;
+            const Vec3      vPosition( ( float( index[0] ) + 0.5f + 0.1f * PseudoRandom( 6 * i     ) ) * spacing
+                                     , ( float( index[1] ) + 0.5f + 0.1f * PseudoRandom( 6 * i + 1 ) ) * spacing
+                                     , ( float( index[2] ) + 0.5f + 0.1f * PseudoRandom( 6 * i + 2 ) ) * spacing ) ;
+            const Vec3      vVorticity( PseudoRandom( 6 * i + 3 ) , PseudoRandom( 6 * i + 4 ) , PseudoRandom( 6 * i + 5 ) ) ;
+            vortons.PushBack( Vorton( vPosition , vVorticity , 0.5f * spacing ) ) ;
+            vorticitySum += vVorticity ;
+        }
+        const size_t numVortons = vortons.Size() ;
+
+        size_t  bucketLayers[ numCapacities ] ;
+        float   rmsErrors[ numCapacities ] ;
+        for( unsigned iCapacity = 0 ; iCapacity < numCapacities ; ++ iCapacity )
+        {   // For each leaf capacity...
+            VortonSim vortonSim( 0.0f , 1.0f ) ;
+            for( size_t iVorton = 0 ; iVorton < numVortons ; ++ iVorton )
+            {
+                vortonSim.GetVortons().PushBack( vortons[ iVorton ] ) ;
+            }
+            vortonSim.GetTracers().PushBack( Particle() ) ;    // Tracers need the velocity grid.
+            vortonSim.SetLeafCapacity( capacities[ iCapacity ] ) ;
+            vortonSim.Update( 0.01f , 0 ) ;
+            bucketLayers[ iCapacity ] = vortonSim.mLeafBucketLayer ;
+
+            if( 0 == vortonSim.mLeafBucketLayer )
+            {   // Leaves are supervortons.
+                assert( 0 == vortonSim.mLeafBuckets.size() ) ;
+            }
+            else
+            {   // Leaves are buckets, so each vorton must occupy exactly one lane, and unused lanes must carry no vorticity.
+                const unsigned  numLanes        = FloatNative::NumLanes ;
+                const unsigned  numPackets      = vortonSim.mLeafBucketBegin.Back() ;
+                const size_t    numChannels     = vortonSim.mLeafBuckets.size() / ( size_t( numPackets ) * numLanes ) ;
+                unsigned        numOccupied     = 0 ;
+                Vec3            bucketVorticity( 0.0f , 0.0f , 0.0f ) ;
+                assert( numChannels * numPackets * numLanes == vortonSim.mLeafBuckets.size() ) ;
+                for( unsigned iPacket = 0 ; iPacket < numPackets ; ++ iPacket )
+                {
+                    const float * pPacket = & vortonSim.mLeafBuckets[ iPacket * numChannels * numLanes ] ;
+                    for( unsigned iLane = 0 ; iLane < numLanes ; ++ iLane )
+                    {   // Vorticity occupies channels 3 to 5, after position.
+                        const Vec3 vVorticity( pPacket[ 3 * numLanes + iLane ] , pPacket[ 4 * numLanes + iLane ] , pPacket[ 5 * numLanes + iLane ] ) ;
+                        numOccupied     += vVorticity.Mag2() > 0.0f ;
+                        bucketVorticity += vVorticity ;
+                    }
+                }
+                assert( numVortons == numOccupied ) ;
+                assert( ( bucketVorticity - vorticitySum ).Magnitude() < 1.0e-3f * vorticitySum.Magnitude() + 1.0e-3f ) ;
+            }
+
+            // Compare velocity grid, which the tree computed from the vortons before they moved, with brute-force summation.
+            const UniformGrid< Vec3 > & rVelGrid    = vortonSim.GetVelocityGrid() ;
+            double                      errorSum2   = 0.0 ;
+            double                      exactSum2   = 0.0 ;
+            unsigned                    idx[3] ;
+            for( idx[2] = 0 ; idx[2] < rVelGrid.GetNumPoints( 2 ) ; ++ idx[2] )
+            for( idx[1] = 0 ; idx[1] < rVelGrid.GetNumPoints( 1 ) ; ++ idx[1] )
+            for( idx[0] = 0 ; idx[0] < rVelGrid.GetNumPoints( 0 ) ; ++ idx[0] )
+            {   // For each gridpoint...
+                Vec3 vPosition ;
+                rVelGrid.PositionFromIndices( vPosition , idx ) ;
+                Vec3 vExact( 0.0f , 0.0f , 0.0f ) ;
+                for( size_t iVorton = 0 ; iVorton < numVortons ; ++ iVorton )
+                {
+                    vortons[ iVorton ].AccumulateVelocity( vExact , vPosition ) ;
+                }
+                const unsigned offset = idx[0] + rVelGrid.GetNumPoints( 0 ) * ( idx[1] + rVelGrid.GetNumPoints( 1 ) * idx[2] ) ;
+                errorSum2 += ( rVelGrid[ offset ] - vExact ).Mag2() ;
+                exactSum2 += vExact.Mag2() ;
+            }
+            assert( exactSum2 > 0.0 ) ;
+            rmsErrors[ iCapacity ] = float( sqrt( errorSum2 / exactSum2 ) ) ;
+        }
+        fprintf( stderr , "leaf buckets: capacity %u %u %u use layers %u %u %u, relative rms velocity error %g %g %g\n"
+            , capacities[0] , capacities[1] , capacities[2] , unsigned( bucketLayers[0] ) , unsigned( bucketLayers[1] ) , unsigned( bucketLayers[2] )
+            , rmsErrors[0] , rmsErrors[1] , rmsErrors[2] ) ;
+        assert( 0 == bucketLayers[0] ) ;
+        assert( ( 0 < bucketLayers[1] ) && ( bucketLayers[1] < bucketLayers[2] ) ) ;   // Larger buckets stop traversal at coarser layers.
+        assert( rmsErrors[1] <= rmsErrors[0] ) ;
+        assert( rmsErrors[2] <= rmsErrors[1] ) ;
+    }
+
+    {   // Test that direct summation skips the influence tree and velocity grid when nothing else needs them, without changing how vortons evolve.
+        static const unsigned   numVortonsPerSide   = 6 ;
+        VortonSim               vortonsOnly( 0.0f , 1.0f ) ;
+        VortonSim               withTracer( 0.0f , 1.0f ) ;
+        const float             spacing             = 1.0f / float( numVortonsPerSide ) ;
+        unsigned                index[3] ;
+        for( index[2] = 0 ; index[2] < numVortonsPerSide ; ++ index[2] )
+        for( index[1] = 0 ; index[1] < numVortonsPerSide ; ++ index[1] )
+        for( index[0] = 0 ; index[0] < numVortonsPerSide ; ++ index[0] )
+        {   // For each vorton in a cube, with vorticity that varies so that vortons stretch and tilt...
+            const Vec3 vPosition( ( float( index[0] ) + 0.5f ) * spacing , ( float( index[1] ) + 0.5f ) * spacing , ( float( index[2] ) + 0.5f ) * spacing ) ;
+            const Vorton vorton( vPosition , Vec3( vPosition.y - 0.5f , 0.5f - vPosition.x , 1.0f ) , 0.5f * spacing ) ;
+            vortonsOnly.GetVortons().PushBack( vorton ) ;
+            withTracer.GetVortons().PushBack( vorton ) ;
+        }
+        withTracer.GetTracers().PushBack( Particle() ) ;
+        vortonsOnly.SetDirectSummationLimit( 1000 ) ;
+        withTracer.SetDirectSummationLimit( 1000 ) ;
+
+        for( unsigned uFrame = 0 ; uFrame < 3 ; ++ uFrame )
+        {
+            vortonsOnly.Update( 0.01f , uFrame ) ;
+            withTracer.Update( 0.01f , uFrame ) ;
+        }
+        assert( 0 == vortonsOnly.mInfluenceTree.GetDepth() ) ;     // Vortons alone needed no tree...
+        assert( 0 == vortonsOnly.GetVelocityGrid().Size() ) ;      // ...nor velocity grid...
+        assert( vortonsOnly.GetVelocityGrid().GetExtent().z > 0.0f ) ;   // ...which still describes the domain.
+        assert( withTracer.GetVelocityGrid().Size() > 0 ) ;         // Tracer needed a velocity grid...
+        assert( withTracer.GetVelocityGrid().GetNumPoints( 0 ) < withTracer.mGridGeometry.GetNumPoints( 0 ) ) ;   // ...but only a coarse one.
+        float maxDifference = 0.0f ;
+        for( size_t iVorton = 0 ; iVorton < vortonsOnly.GetVortons().Size() ; ++ iVorton )
+        {   // For each vorton, compare its evolution with and without the velocity grid.
+            const Vorton & rVorton = vortonsOnly.GetVortons()[ iVorton ] ;
+            const Vorton & rTwin   = withTracer.GetVortons()[ iVorton ] ;
+            maxDifference = MAX2( maxDifference , MAX2( ( rVorton.mPosition - rTwin.mPosition ).Magnitude() , ( rVorton.mVorticity - rTwin.mVorticity ).Magnitude() ) ) ;
+        }
+        fprintf( stderr , "direct summation without velocity grid: max difference=%g\n" , maxDifference ) ;
+        assert( 0.0f == maxDifference ) ;
+    }
+
+    {   // Test that P3M gives velocity, on the grid and at vortons, with accuracy comparable to the influence tree.
+        VortonSim   viaTree( 0.0f , 1.0f ) ;
+        VortonSim   viaP3M( 0.0f , 1.0f ) ;
+        const JetRing ring( 1.0f , 1.0f , Vec3( 1.0f , 0.0f , 0.0f ) ) ;
+        AssignVorticity( viaTree.GetVortons() , 20.0f , 16384 , ring ) ;
+        AssignVorticity( viaP3M.GetVortons()  , 20.0f , 16384 , ring ) ;
+        const size_t numVortons = viaTree.GetVortons().Size() ;
+        Vector< Vorton > vortons ;
+        for( size_t iVorton = 0 ; iVorton < numVortons ; ++ iVorton )
+        {   // Remember vortons before they move, to sum their velocity by brute force.
+            vortons.PushBack( viaTree.GetVortons()[ iVorton ] ) ;
+        }
+        viaTree.GetTracers().PushBack( Particle() ) ;   // Tracers need the velocity grid.
+        viaP3M.GetTracers().PushBack( Particle() ) ;
+        viaP3M.SetVelocitySolver( VELOCITY_SOLVER_P3M ) ;
+        viaTree.Update( 0.01f , 0 ) ;
+        viaP3M.Update( 0.01f , 0 ) ;
+        assert( viaP3M.UsesP3M() && ! viaTree.UsesP3M() ) ;
+        assert( 0 == viaTree.mVortonVelocities.Size() ) ;     // Tree interpolates velocity at vortons from the grid.
+        assert( numVortons == viaP3M.mVortonVelocities.Size() ) ;
+
+        // Compare velocity grids with brute-force summation.
+        const UniformGrid< Vec3 > & rTreeGrid   = viaTree.GetVelocityGrid() ;
+        const UniformGrid< Vec3 > & rP3MGrid    = viaP3M.GetVelocityGrid() ;
+        assert( rTreeGrid.GetGridCapacity() == rP3MGrid.GetGridCapacity() ) ;
+        double treeGridError2 = 0.0 , p3mGridError2 = 0.0 , exactGrid2 = 0.0 ;
+        unsigned idx[3] ;
+        for( idx[2] = 0 ; idx[2] < rTreeGrid.GetNumPoints( 2 ) ; ++ idx[2] )
+        for( idx[1] = 0 ; idx[1] < rTreeGrid.GetNumPoints( 1 ) ; ++ idx[1] )
+        for( idx[0] = 0 ; idx[0] < rTreeGrid.GetNumPoints( 0 ) ; ++ idx[0] )
+        {   // For each gridpoint...
+            Vec3 vPosition ;
+            rTreeGrid.PositionFromIndices( vPosition , idx ) ;
+            Vec3 vExact( 0.0f , 0.0f , 0.0f ) ;
+            for( size_t iVorton = 0 ; iVorton < numVortons ; ++ iVorton )
+            {
+                vortons[ iVorton ].AccumulateVelocity( vExact , vPosition ) ;
+            }
+            const unsigned offset = idx[0] + rTreeGrid.GetNumPoints( 0 ) * ( idx[1] + rTreeGrid.GetNumPoints( 1 ) * idx[2] ) ;
+            treeGridError2  += ( rTreeGrid[ offset ] - vExact ).Mag2() ;
+            p3mGridError2   += ( rP3MGrid[ offset ]  - vExact ).Mag2() ;
+            exactGrid2      += vExact.Mag2() ;
+        }
+
+        // Compare velocity at vortons with brute-force summation.
+        double treeVortonError2 = 0.0 , p3mVortonError2 = 0.0 , exactVorton2 = 0.0 ;
+        for( size_t iVorton = 0 ; iVorton < numVortons ; ++ iVorton )
+        {   // For each vorton...
+            const Vec3 & vPosition = vortons[ iVorton ].mPosition ;
+            Vec3 vExact( 0.0f , 0.0f , 0.0f ) ;
+            for( size_t iOther = 0 ; iOther < numVortons ; ++ iOther )
+            {
+                vortons[ iOther ].AccumulateVelocity( vExact , vPosition ) ;
+            }
+            Vec3 vTree ;
+            rTreeGrid.Interpolate( vTree , vPosition ) ;
+            treeVortonError2    += ( vTree - vExact ).Mag2() ;
+            p3mVortonError2     += ( viaP3M.mVortonVelocities[ iVorton ] - vExact ).Mag2() ;
+            exactVorton2        += vExact.Mag2() ;
+        }
+        const float treeGridError   = float( sqrt( treeGridError2   / exactGrid2   ) ) ;
+        const float p3mGridError    = float( sqrt( p3mGridError2    / exactGrid2   ) ) ;
+        const float treeVortonError = float( sqrt( treeVortonError2 / exactVorton2 ) ) ;
+        const float p3mVortonError  = float( sqrt( p3mVortonError2  / exactVorton2 ) ) ;
+        fprintf( stderr , "P3M: %u vortons, relative rms error on grid tree=%g p3m=%g, at vortons tree=%g p3m=%g\n"
+            , unsigned( numVortons ) , treeGridError , p3mGridError , treeVortonError , p3mVortonError ) ;
+        assert( p3mGridError < treeGridError ) ;
+        assert( p3mVortonError < treeVortonError ) ;
+    }
+
+    {   // Test that upsampling conserves circulation, impulse and the mass of each kind of particle, and leaves rand undisturbed.
+        static const unsigned   numVortonsPerSide   = 6 ;
+        VortonSim               coarse( 0.0f , 1.0f ) ;
+        VortonSim               twin( 0.0f , 1.0f ) ;
+        const float             spacing             = 1.0f / float( numVortonsPerSide ) ;
+        unsigned                index[3] ;
+        for( index[2] = 0 ; index[2] < numVortonsPerSide ; ++ index[2] )
+        for( index[1] = 0 ; index[1] < numVortonsPerSide ; ++ index[1] )
+        for( index[0] = 0 ; index[0] < numVortonsPerSide ; ++ index[0] )
+        {   // For each vorton in a cube...
+            const Vec3 vPosition( ( float( index[0] ) + 0.5f ) * spacing , ( float( index[1] ) + 0.5f ) * spacing , ( float( index[2] ) + 0.5f ) * spacing ) ;
+            coarse.GetVortons().PushBack( Vorton( vPosition , Vec3( vPosition.y - 0.5f , 0.5f - vPosition.x , 1.0f ) , 0.5f * spacing ) ) ;
+        }
+        coarse.Initialize( 1 ) ;
+        coarse.Fork( twin ) ;
+
+        const VortonSim &   rCoarse             = coarse ;
+        const size_t        numVortons          = rCoarse.GetVortons().Size() ;
+        const size_t        numTracers          = rCoarse.GetTracers().Size() ;
+        const float         vortonMass          = float( numVortons ) * coarse.GetMassPerVorton() ;
+        const float         tracerMass          = float( numTracers ) * coarse.GetMassPerTracer() ;
+        Vec3                vCirculation , vImpulse ;
+        coarse.ConservedQuantities( vCirculation , vImpulse ) ;
+
+        srand( 12345 ) ;
+        const int           randExpected        = rand() ;
+        srand( 12345 ) ;
+        coarse.Upsample( 2 , 3 , 0.1f , 7 ) ;
+        assert( rand() == randExpected ) ;   // Upsample used its own generator.
+        twin.Upsample( 2 , 3 , 0.1f , 7 ) ;
+
+        assert( rCoarse.GetVortons().Size() == 8 * numVortons ) ;
+        assert( rCoarse.GetTracers().Size() == 27 * numTracers ) ;
+        const float         vortonMassError     = fabsf( float( rCoarse.GetVortons().Size() ) * coarse.GetMassPerVorton() - vortonMass ) / vortonMass ;
+        const float         tracerMassError     = fabsf( float( rCoarse.GetTracers().Size() ) * coarse.GetMassPerTracer() - tracerMass ) / tracerMass ;
+        Vec3                vCirculationFine , vImpulseFine ;
+        coarse.ConservedQuantities( vCirculationFine , vImpulseFine ) ;
+        const float         circulationError    = ( vCirculationFine - vCirculation ).Magnitude() / vCirculation.Magnitude() ;
+        const float         impulseError        = ( vImpulseFine - vImpulse ).Magnitude() / vImpulse.Magnitude() ;
+        float               maxDifference       = 0.0f ;
+        for( size_t iVorton = 0 ; iVorton < rCoarse.GetVortons().Size() ; ++ iVorton )
+        {   // For each child vorton, compare it with its twin, which the same seed generated.
+            const Vorton & rVorton = rCoarse.GetVortons()[ iVorton ] ;
+            const Vorton & rTwin   = static_cast< const VortonSim & >( twin ).GetVortons()[ iVorton ] ;
+            maxDifference = MAX2( maxDifference , MAX2( ( rVorton.mPosition - rTwin.mPosition ).Magnitude() , ( rVorton.mVorticity - rTwin.mVorticity ).Magnitude() ) ) ;
+        }
+        fprintf( stderr , "upsample: mass error vortons=%g tracers=%g, circulation error=%g impulse error=%g, twin difference=%g\n" , vortonMassError , tracerMassError , circulationError , impulseError , maxDifference ) ;
+        assert( vortonMassError < 1.0e-5f ) ;
+        assert( tracerMassError < 1.0e-5f ) ;
+        assert( circulationError < 1.0e-4f ) ;
+        assert( impulseError < 1.0e-4f ) ;
+        assert( 0.0f == maxDifference ) ;
+    }
+
+    {   // Test that a fork shares particle chunks with its source until either writes them, and then evolves like its source.
+        static const unsigned   numVortonsPerSide   = 12 ;  // Enough vortons to span more than one chunk.
+        VortonSim               source( 0.0f , 1.0f ) ;
+        VortonSim               branch( 0.0f , 1.0f ) ;
+        const float             spacing             = 1.0f / float( numVortonsPerSide ) ;
+        unsigned                index[3] ;
+        for( index[2] = 0 ; index[2] < numVortonsPerSide ; ++ index[2] )
+        for( index[1] = 0 ; index[1] < numVortonsPerSide ; ++ index[1] )
+        for( index[0] = 0 ; index[0] < numVortonsPerSide ; ++ index[0] )
+        {   // For each vorton in a cube...
+            const Vec3 vPosition( ( float( index[0] ) + 0.5f ) * spacing , ( float( index[1] ) + 0.5f ) * spacing , ( float( index[2] ) + 0.5f ) * spacing ) ;
+            source.GetVortons().PushBack( Vorton( vPosition , Vec3( vPosition.y - 0.5f , 0.5f - vPosition.x , 1.0f ) , 0.5f * spacing ) ) ;
+        }
+        source.Initialize( 1 ) ;
+        source.Fork( branch ) ;
+
+        const VortonSim & rSource = source ;
+        const VortonSim & rBranch = branch ;
+        const ChunkedVector< Vorton > & rSourceVortons = rSource.GetVortons() ;
+        assert( rSourceVortons.GetNumChunks() > 1 ) ;
+        assert( rSourceVortons.IsChunkShared( 0 ) && rSourceVortons.IsChunkShared( 1 ) ) ;   // Fork copied no vortons...
+        const Vec3 vorticity = rSourceVortons[ 0 ].mVorticity ;
+        branch.GetVortons()[ 0 ].mVorticity = 2.0f * vorticity ;
+        assert( rSourceVortons[ 0 ].mVorticity == vorticity ) ;                             // ...writing the branch left its source intact...
+        assert( ! rSourceVortons.IsChunkShared( 0 ) && rSourceVortons.IsChunkShared( 1 ) ) ; // ...and copied only the chunk it wrote.
+        branch.GetVortons()[ 0 ].mVorticity = vorticity ;
+
+        while( source.mUpdateStage < UPDATE_VELOCITY_DIRECT )
+        {   // Run the stages that only read particles, one piece per call.
+            source.UpdateSliced( 0.01f , 0 , 0.0 ) ;
+        }
+        assert( rSourceVortons.IsChunkShared( 1 ) ) ;                                       // Reading particles copied no chunks.
+
+        for( unsigned uFrame = 0 ; uFrame < 3 ; ++ uFrame )
+        {
+            source.Update( 0.01f , uFrame ) ;
+            branch.Update( 0.01f , uFrame ) ;
+        }
+        assert( ! rSourceVortons.IsChunkShared( 1 ) ) ;
+        assert( rSourceVortons.Size() == rBranch.GetVortons().Size() ) ;
+        assert( rSource.GetTracers().Size() == rBranch.GetTracers().Size() ) ;
+        float maxDifference = 0.0f ;
+        for( size_t iVorton = 0 ; iVorton < rSourceVortons.Size() ; ++ iVorton )
+        {   // For each vorton, compare its evolution in the source and in the branch.
+            const Vorton & rVorton = rSourceVortons[ iVorton ] ;
+            const Vorton & rTwin   = rBranch.GetVortons()[ iVorton ] ;
+            maxDifference = MAX2( maxDifference , MAX2( ( rVorton.mPosition - rTwin.mPosition ).Magnitude() , ( rVorton.mVorticity - rTwin.mVorticity ).Magnitude() ) ) ;
+        }
+        for( size_t iTracer = 0 ; iTracer < rSource.GetTracers().Size() ; ++ iTracer )
+        {   // For each tracer, compare its evolution in the source and in the branch.
+            const Particle & rTracer = rSource.GetTracers()[ iTracer ] ;
+            const Particle & rTwin   = rBranch.GetTracers()[ iTracer ] ;
+            maxDifference = MAX2( maxDifference , ( rTracer.mPosition - rTwin.mPosition ).Magnitude() ) ;
+        }
+        fprintf( stderr , "fork: max difference=%g\n" , maxDifference ) ;
+        assert( 0.0f == maxDifference ) ;
+    }
+
+    {   // Test that a sliced update leaves particles intact until stages that write them, resumes those between chunks, and then matches an unsliced update.
+        static const unsigned   numVortonsPerSide   = 12 ;  // Enough vortons to span more than one chunk.
+        VortonSim               sliced( 0.0f , 1.0f ) ;
+        VortonSim               whole( 0.0f , 1.0f ) ;
+        VortonSim               midUpdate( 0.0f , 1.0f ) ;
+        const float             spacing             = 1.0f / float( numVortonsPerSide ) ;
+        unsigned                index[3] ;
+        for( index[2] = 0 ; index[2] < numVortonsPerSide ; ++ index[2] )
+        for( index[1] = 0 ; index[1] < numVortonsPerSide ; ++ index[1] )
+        for( index[0] = 0 ; index[0] < numVortonsPerSide ; ++ index[0] )
+        {   // For each vorton in a cube...
+            const Vec3 vPosition( ( float( index[0] ) + 0.5f ) * spacing , ( float( index[1] ) + 0.5f ) * spacing , ( float( index[2] ) + 0.5f ) * spacing ) ;
+            sliced.GetVortons().PushBack( Vorton( vPosition , Vec3( vPosition.y - 0.5f , 0.5f - vPosition.x , 1.0f ) , 0.5f * spacing ) ) ;
+        }
+        sliced.Initialize( 1 ) ;
+        sliced.Fork( whole ) ;
+
+        const VortonSim & rSliced       = sliced ;
+        const VortonSim & rWhole        = whole ;
+        const VortonSim & rMidUpdate    = midUpdate ;
+        assert( rSliced.GetVortons().GetNumChunks() > 1 ) ;
+        unsigned numSlices          = 1 ;
+        unsigned numParticleSlices  = 0 ;   // Calls that yielded partway through a stage that visits each particle
+        while( ! sliced.UpdateSliced( 0.01f , 0 , 0.0 ) )
+        {   // Deadline already passed, so each call performs as little as it can.
+            size_t iUnwritten = rSliced.GetVortons().Size() ;  // Index of first vorton that the update has not yet written
+            if( sliced.mUpdateStage < UPDATE_STRETCH_AND_TILT )
+            {   // Update has only read vortons.
+                iUnwritten = 0 ;
+            }
+            else if( UPDATE_STRETCH_AND_TILT == sliced.mUpdateStage )
+            {   // Update has stretched only vortons before the next batch.
+                iUnwritten = sliced.mUpdateParticleNext ;
+            }
+            if( sliced.mUpdateParticleNext > 0 )
+            {
+                ++ numParticleSlices ;
+            }
+            float maxDifference = 0.0f ;
+            for( size_t iVorton = iUnwritten ; iVorton < rSliced.GetVortons().Size() ; ++ iVorton )
+            {   // For each vorton the update has not yet written, compare it with its state before the update.
+                maxDifference = MAX2( maxDifference , ( rSliced.GetVortons()[ iVorton ].mPosition - rWhole.GetVortons()[ iVorton ].mPosition ).Magnitude() ) ;
+                maxDifference = MAX2( maxDifference , ( rSliced.GetVortons()[ iVorton ].mVorticity - rWhole.GetVortons()[ iVorton ].mVorticity ).Magnitude() ) ;
+            }
+            assert( 0.0f == maxDifference ) ;   // Update in progress has not yet written these vortons.
+            ++ numSlices ;
+        }
+        assert( numSlices > 2 ) ;
+        assert( numParticleSlices >= 2 ) ;      // Stretching and advecting vortons each yielded between chunks.
+
+        // Fork while an update remains in progress, then finish it.
+        assert( ! sliced.UpdateSliced( 0.01f , 1 , 0.0 ) ) ;
+        sliced.Fork( midUpdate ) ;
+        assert( ! midUpdate.IsUpdating() ) ;
+        sliced.Update( 0.01f , 1 ) ;
+
+        whole.Update( 0.01f , 0 ) ;
+        float maxDifference     = 0.0f ;    // Between sliced and unsliced updates
+        float maxForkDifference = 0.0f ;    // Between the fork taken partway through the second update, and the first update
+        for( size_t iVorton = 0 ; iVorton < rSliced.GetVortons().Size() ; ++ iVorton )
+        {   // For each vorton...
+            maxForkDifference = MAX2( maxForkDifference , ( rMidUpdate.GetVortons()[ iVorton ].mPosition - rWhole.GetVortons()[ iVorton ].mPosition ).Magnitude() ) ;
+        }
+        whole.Update( 0.01f , 1 ) ;
+        for( size_t iVorton = 0 ; iVorton < rSliced.GetVortons().Size() ; ++ iVorton )
+        {   // For each vorton, compare its evolution with and without slicing.
+            maxDifference = MAX2( maxDifference , ( rSliced.GetVortons()[ iVorton ].mPosition - rWhole.GetVortons()[ iVorton ].mPosition ).Magnitude() ) ;
+            maxDifference = MAX2( maxDifference , ( rSliced.GetVortons()[ iVorton ].mVorticity - rWhole.GetVortons()[ iVorton ].mVorticity ).Magnitude() ) ;
+        }
+        for( size_t iTracer = 0 ; iTracer < rSliced.GetTracers().Size() ; ++ iTracer )
+        {   // For each tracer, compare its evolution with and without slicing.
+            maxDifference = MAX2( maxDifference , ( rSliced.GetTracers()[ iTracer ].mPosition - rWhole.GetTracers()[ iTracer ].mPosition ).Magnitude() ) ;
+        }
+        fprintf( stderr , "sliced update: %u slices, %u within particle stages, max difference=%g, fork partway max difference=%g\n" , numSlices , numParticleSlices , maxDifference , maxForkDifference ) ;
+        assert( 0.0f == maxDifference ) ;
+        assert( 0.0f == maxForkDifference ) ;
+    }
+
+    fprintf( stderr , "VortonSim::UnitTest END ------------------------\n" ) ;
+}
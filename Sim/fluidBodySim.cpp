@@ -8,11 +8,39 @@
     \author Copyright 2009 Dr. Michael Jason Gourlay; All rights reserved.
 */
 
+#include <float.h>
+
+#include <algorithm>
+
 #include "Core/Performance/perf.h"
 #include "Sim/Vorton/vorticityDistribution.h"
 
 #include "fluidBodySim.h"
 
+#if USE_TBB
+    /*! \brief Function object to update independent branches of a simulation using Threading Building Blocks
+    */
+    class FluidBodySim_UpdateBranches_TBB
+    {
+            FluidBodySim * const *  mBranches   ;   ///< Addresses of branches to update
+            const float &           mTimeStep   ;   ///< Change in virtual time since last update
+            const unsigned &        mFrame      ;   ///< Frame counter
+        public:
+            void operator() ( const tbb::blocked_range<size_t> & r ) const
+            {   // Update subset of branches.
+                for( size_t iBranch = r.begin() ; iBranch < r.end() ; ++ iBranch )
+                {
+                    mBranches[ iBranch ]->Update( mTimeStep , mFrame ) ;
+                }
+            }
+            FluidBodySim_UpdateBranches_TBB( FluidBodySim * const * pBranches , const float & timeStep , const unsigned & uFrame )
+                : mBranches( pBranches )
+                , mTimeStep( timeStep )
+                , mFrame( uFrame )
+            {}
+    } ;
+#endif
+
 
 /*! \brief Select boundary condition handling scheme
 
@@ -64,6 +92,25 @@
 
 
 
+/*! \brief Whether the potential flow of each translating sphere adds to the fluid velocity
+
+    Without potential flow, vortons alone must keep fluid from flowing
+    through each body, so the body must disturb every vorton near it each
+    frame, and it needs a thick boundary layer of them.
+
+    With potential flow, each sphere adds the flow of a doublet, which
+    satisfies the no-through condition analytically, so advection carries
+    vortons and tracers around the body rather than into it.  Vortons then
+    need to cancel only the residual slip along the surface, and a thinner
+    boundary suffices.
+
+    \see VortonSim::AddPotentialFlowSphere
+*/
+#define BOUNDARY_POTENTIAL_FLOW 1
+
+
+
+
 /*! \brief Whether flow affects rigid bodies immersed in the fluid.
 
     Normally we will leave this enabled but for testing we can disable it.
@@ -73,6 +120,18 @@
 
 
 
+/*! \brief Half-width, relative to a sphere's radius, of the box around it in which to refine velocity
+
+    The boundary layer, where velocity varies most rapidly, lies near the
+    surface, but vorticity shed from it lingers in the wake nearby.
+
+    \see VortonSim::SetVelocityRefinement
+*/
+static const float sRefinementRadiusFactor = 2.0f ;
+
+
+
+
 /*! \brief Initialize a fluid-and-body simulation
 
     This routine will remove particles that are embedded
@@ -92,6 +151,118 @@ void FluidBodySim::Initialize( unsigned numTracersPerCellCubeRoot )
 
 
 
+/*! \brief Write the state of fluid and rigid bodies to a file
+
+    \param strFilename - name of file to write
+
+    \return whether writing succeeded
+
+    \see LoadCheckpoint, VortonSim::WriteCheckpoint
+*/
+bool FluidBodySim::SaveCheckpoint( const char * strFilename ) const
+{
+    FILE * pFile = fopen( strFilename , "wb" ) ;
+    if( 0 == pFile )
+    {
+        return false ;
+    }
+    const unsigned  numSpheres  = unsigned( mSpheres.Size() ) ;
+    bool            bOk         =   ( fwrite( & numSpheres , sizeof( numSpheres ) , 1 , pFile ) == 1 )
+                                &&  ( ( 0 == numSpheres ) || ( fwrite( & mSpheres[ 0 ] , sizeof( RbSphere ) , numSpheres , pFile ) == numSpheres ) ) ;
+    bOk = bOk && mVortonSim.WriteCheckpoint( pFile ) ;
+    bOk = ( 0 == fclose( pFile ) ) && bOk ;
+    return bOk ;
+}
+
+
+
+
+/*! \brief Replace the state of fluid and rigid bodies with that which SaveCheckpoint wrote
+
+    \param strFilename - name of file to read
+
+    \return whether the file held a valid checkpoint
+
+    This replaces Initialize, so the simulation can Update immediately afterward.
+    To restart at higher resolution, call VortonSim::Upsample next.
+*/
+bool FluidBodySim::LoadCheckpoint( const char * strFilename )
+{
+    FILE * pFile = fopen( strFilename , "rb" ) ;
+    if( 0 == pFile )
+    {
+        return false ;
+    }
+    Clear() ;
+    unsigned    numSpheres  = 0 ;
+    bool        bOk         = fread( & numSpheres , sizeof( numSpheres ) , 1 , pFile ) == 1 ;
+    mSpheres.Resize( bOk ? numSpheres : 0 ) ;
+    bOk = bOk && ( ( 0 == numSpheres ) || ( fread( & mSpheres[ 0 ] , sizeof( RbSphere ) , numSpheres , pFile ) == numSpheres ) ) ;
+    bOk = bOk && mVortonSim.ReadCheckpoint( pFile ) ;
+    fclose( pFile ) ;
+    if( ! bOk )
+    {
+        Clear() ;
+    }
+    return bOk ;
+}
+
+
+
+
+/*! \brief Make the given simulation a branch of this one, to explore a variation of it
+
+    \param branch - (out) simulation to replace with a copy of this one
+
+    Afterward, changing settings or bodies of the branch, then updating it,
+    shows what would have happened had this simulation changed the same way.
+
+    The branch shares particles with this simulation until either writes
+    them, so forking costs little.
+
+    \see VortonSim::Fork, UpdateBranches
+*/
+void FluidBodySim::Fork( FluidBodySim & branch ) const
+{
+    branch.mSpheres = mSpheres ;
+    mVortonSim.Fork( branch.mVortonSim ) ;
+}
+
+
+
+
+/*! \brief Update several independent simulations, such as branches that Fork made, concurrently
+
+    \param pBranches - addresses of simulations to update.  Each must be distinct.
+
+    \param numBranches - number of simulations
+
+    \param timeStep - change in virtual time since last update
+
+    \param uFrame - frame counter
+
+    Simulations share no mutable data, so each can update on its own thread
+    while its own parallel loops share the remaining processors.
+
+    \note Performance counters, in builds that query performance, accumulate
+        the durations of all branches, and might miscount them.
+*/
+/* static */ void FluidBodySim::UpdateBranches( FluidBodySim * const * pBranches , size_t numBranches , float timeStep , unsigned uFrame )
+{
+#if USE_TBB
+    // Each branch is a large task, so give each its own.
+    parallel_for( tbb::blocked_range<size_t>( 0 , numBranches , 1 ) , FluidBodySim_UpdateBranches_TBB( pBranches , timeStep , uFrame ) ) ;
+#else
+    for( size_t iBranch = 0 ; iBranch < numBranches ; ++ iBranch )
+    {
+        pBranches[ iBranch ]->Update( timeStep , uFrame ) ;
+    }
+#endif
+}
+
+
+
+
 /*! \brief Remove particles with rigid bodies
 
     This routine should only be called initially, to remove
@@ -109,25 +280,29 @@ void FluidBodySim::RemoveEmbeddedParticles( void )
     for( unsigned uBody = 0 ; uBody < numBodies ; ++ uBody )
     {   // For each sphere in the simulation...
         RbSphere &  rSphere         = mSpheres[ uBody ] ;
-        for( Vector<Vorton>::Iterator iVorton = mVortonSim.GetVortons().Begin() ; iVorton != mVortonSim.GetVortons().End() ; )
+        ChunkedVector< Vorton > &       rVortons        = mVortonSim.GetVortons() ;
+        const ChunkedVector< Vorton > & rVortonsRead    = rVortons ;   // Read without the write barrier, so chunks forks share stay shared unless a vorton moves.
+        const size_t                    numVortons      = rVortonsRead.Size() ;
+        size_t                          numKept         = 0 ;
+        for( size_t iVorton = 0 ; iVorton < numVortons ; ++ iVorton )
         {   // For each vorton in the simulation...
-            Vorton & rVorton = * iVorton ;
+            const Vorton & rVorton = rVortonsRead[ iVorton ] ;
             const Vec3  vSphereToVorton = rVorton.mPosition - rSphere.mPosition ;   // vector from sphere center to vorton
             const float fSphereToVorton = vSphereToVorton.Magnitude() ;
-            if( fSphereToVorton < ( rVorton.mRadius + rSphere.mRadius ) )
-            {   // Vorton is inside body.
-                // Delete vorton.
-                mVortonSim.GetVortons().Erase( iVorton ) ;
-                // Deleted vorton so now this same index contains a different vorton.
-            }
-            else
-            {   // Did not delete vorton so skip past it.
-                ++ iVorton ;
+            if( fSphereToVorton >= ( rVorton.mRadius + rSphere.mRadius ) )
+            {   // Vorton is outside body, so keep it.
+                if( numKept != iVorton )
+                {   // Vortons before this one were inside body, so move this one down to take the place of the first of them.
+                    rVortons[ numKept ] = rVorton ;
+                }
+                ++ numKept ;
             }
         }
-        for( size_t iTracer = 0 ; iTracer < mVortonSim.GetTracers().Size() ; )
+        rVortons.Resize( numKept ) ;   // Delete vortons inside body.
+        const ChunkedVector< Particle > & rTracers = mVortonSim.GetTracers() ;    // Read without the write barrier, as for vortons.
+        for( size_t iTracer = 0 ; iTracer < rTracers.Size() ; )
         {   // For each passive tracer particle in the simulation...
-            Particle & rTracer = mVortonSim.GetTracers()[ iTracer ] ;
+            const Particle & rTracer = rTracers[ iTracer ] ;
             const Vec3  vSphereToTracer = rTracer.mPosition - rSphere.mPosition ;   // vector from sphere center to tracer
             const float fSphereToTracer = vSphereToTracer.Magnitude() ;
             if( fSphereToTracer < ( rTracer.mSize + rSphere.mRadius ) )
@@ -147,6 +322,52 @@ void FluidBodySim::RemoveEmbeddedParticles( void )
 
 
 
+/*! \brief Find particles that might lie within a given distance of a point
+
+    \param particles - (out) indices of particles that might lie within reach of vCenter, in ascending order.
+
+    \param cellIndex - index of which cell contains each particle
+
+    \param numParticles - number of particles that currently exist
+
+    \param vCenter - point near which to find particles
+
+    \param reach - distance from vCenter within which to find particles
+
+    \param moved - indices of particles that moved since cellIndex was built,
+        other than by advection, so might not lie in the cells cellIndex records.
+
+    This is a conservative "broad phase": it can return particles which lie beyond
+    reach, but never omits particles within reach.
+
+*/
+static void GatherParticlesNear( Vector< unsigned > & particles , const ParticleCellIndex & cellIndex , size_t numParticles , const Vec3 & vCenter , float reach , const Vector< unsigned > & moved )
+{
+    particles.Clear() ;
+    if( cellIndex.GetNumParticles() != numParticles )
+    {   // Particles were added or removed since cellIndex was built, so consider every particle.
+        for( unsigned iParticle = 0 ; iParticle < numParticles ; ++ iParticle )
+        {
+            particles.PushBack( iParticle ) ;
+        }
+        return ;
+    }
+    const Vec3 vReach( reach , reach , reach ) ;
+    cellIndex.GatherParticlesInBox( particles , vCenter - vReach , vCenter + vReach ) ;
+    if( moved.Size() > 0 )
+    {   // Some particles might not lie where cellIndex says, so consider them too.
+        for( size_t iMoved = 0 ; iMoved < moved.Size() ; ++ iMoved )
+        {
+            particles.PushBack( moved[ iMoved ] ) ;
+        }
+        sort( particles.Begin() , particles.End() ) ;
+        particles.Erase( unique( particles.Begin() , particles.End() ) , particles.End() ) ;
+    }
+}
+
+
+
+
 /*! \brief Collide particles with rigid bodies
 
     This uses a simplified form of "penalty" scheme
@@ -194,40 +415,62 @@ void FluidBodySim::SolveBoundaryConditions( void )
     const size_t numTracers       = mVortonSim.GetTracers().Size() ;
 
 #if FLOW_AFFECTS_BODY
-    const float &  rMassPerParticle = mVortonSim.GetMassPerParticle() ;
+    const float &  rMassPerVorton   = mVortonSim.GetMassPerVorton() ;
+    const float &  rMassPerTracer   = mVortonSim.GetMassPerTracer() ;
+#endif
+
+    // This boundary thickness compensates for low discretization resolution,
+    // by spreading the influence of the body surface to just outside the body,
+    // deeper into the fluid.  This also has an effect somewhat like
+    // instantaneous viscous diffusion, in the immediate vicinity of
+    // the boundary.  It should be kept as small as possible,
+    // but must be at least 1.  A value of 1 means only vortons
+    // colliding with the body receive influence.  A value of 2 seems
+    // most appropriate since that is the size of a grid cell, so
+    // 2 essentially means vortons within a grid cell receive influence.
+    // So a value in [1,2] seems appropriate. But values over 1.2 trap
+    // vortons inside the body, because the "bend" can draw vortons back
+    // toward the body.
+    // Note, the larger fBndThkFactor is, the more vortons get influenced,
+    // which drives the simulation to instability and also costs more CPU
+    // time due to the increased number of vortons involved.
+    // Potential flow already keeps fluid from flowing through the body, so
+    // vortons only need to convey slip, and only colliding vortons need influence.
+#if BOUNDARY_POTENTIAL_FLOW
+    const float fBndThkFactor       = 1.0f ; // Thickness of boundary, in vorton radii.
+#else
+    const float fBndThkFactor       = 1.2f ; // Thickness of boundary, in vorton radii.
 #endif
 
+    // Use the per-frame cell index as a broad phase, to avoid testing every particle against every body.
+    // Particles advected since the index was built, so widen each query by how far they could have moved.
+    const ParticleCellIndex &   rVortonCells    = mVortonSim.GetVortonCellIndex() ;
+    const ParticleCellIndex &   rTracerCells    = mVortonSim.GetTracerCellIndex() ;
+    const float                 maxDisplacement = ( numBodies > 0 ) ? mVortonSim.ComputeMaxDisplacementSinceIndex() : 0.0f ;
+    Vector< unsigned >          nearbyParticles ;   // Indices of particles that might touch the current body
+    Vector< unsigned >          movedVortons ;      // Indices of vortons that a body moved, which might now touch a later body
+    Vector< unsigned >          movedTracers ;      // Indices of tracers that a body moved, which might now touch a later body
+
     for( unsigned uBody = 0 ; uBody < numBodies ; ++ uBody )
     {   // For each body in the simulation...
         RbSphere &  rSphere         = mSpheres[ uBody ] ;
 
         // Collide vortons with rigid body.
-        for( unsigned uVorton = 0 ; uVorton < numVortons ; ++ uVorton )
-        {   // For each vorton in the simulation...
+        const float vortonReach = rSphere.mRadius + fBndThkFactor * rVortonCells.GetMaxParticleSize() + maxDisplacement ;
+        GatherParticlesNear( nearbyParticles , rVortonCells , numVortons , rSphere.mPosition , vortonReach , movedVortons ) ;
+        const size_t numNearbyVortons = nearbyParticles.Size() ;
+        for( size_t iNearby = 0 ; iNearby < numNearbyVortons ; ++ iNearby )
+        {   // For each vorton near the body...
+            const unsigned uVorton = nearbyParticles[ iNearby ] ;
             Vorton & rVorton = mVortonSim.GetVortons()[ uVorton ] ;
             const Vec3  vSphereToVorton     = rVorton.mPosition - rSphere.mPosition ;   // vector from body center to vorton
             const float fSphereToVorton     = vSphereToVorton.Magnitude() ;
             const Vec3  vSphereToVortonDir  = vSphereToVorton / fSphereToVorton ;
-            // This boundary thickness compensates for low discretization resolution,
-            // by spreading the influence of the body surface to just outside the body,
-            // deeper into the fluid.  This also has an effect somewhat like
-            // instantaneous viscous diffusion, in the immediate vicinity of
-            // the boundary.  It should be kept as small as possible,
-            // but must be at least 1.  A value of 1 means only vortons
-            // colliding with the body receive influence.  A value of 2 seems
-            // most appropriate since that is the size of a grid cell, so
-            // 2 essentially means vortons within a grid cell receive influence.
-            // So a value in [1,2] seems appropriate. But values over 1.2 trap
-            // vortons inside the body, because the "bend" can draw vortons back
-            // toward the body.
-            // Note, the larger fBndThkFactor is, the more vortons get influenced,
-            // which drives the simulation to instability and also costs more CPU
-            // time due to the increased number of vortons involved.
-            const float fBndThkFactor       = 1.2f ; // Thickness of boundary, in vorton radii.
             const float fBoundaryThickness  = fBndThkFactor * rVorton.mRadius ; // Thickness of boundary, i.e. region within which body sheds vorticity into fluid.
 
             if( fSphereToVorton < ( rSphere.mRadius + fBoundaryThickness ) )
             {   // Vorton is interacting with body.
+                movedVortons.PushBack( uVorton ) ;
 
                 // Compute "contact" point, near where vorton touched body.
                 const Vec3 vContactPtRelBody        = vSphereToVortonDir * rSphere.mRadius ;
@@ -262,7 +505,7 @@ void FluidBodySim::SolveBoundaryConditions( void )
                 // due to "ambient" flow, to be zero.
                 // Interpolate ambient velocity at that point on the sphere.
                 Vec3 velAmbientAtContactPt ; // Velocity due to entire vorton field at collision point.
-                mVortonSim.GetVelocityGrid().Interpolate( velAmbientAtContactPt , vContactPtWorld ) ;
+                mVortonSim.InterpolateVelocity( velAmbientAtContactPt , vContactPtWorld ) ;
 
         #if ! BOUNDARY_AMBIENT_FLOW_OMITS_VORTON_OLD_POSITION
                 // Compute relative velocity between body (at contact point) and ambient flow.
@@ -361,7 +604,7 @@ void FluidBodySim::SolveBoundaryConditions( void )
                 // Unlike with the linear momentum exchange above, this
                 // exactly preserves angular momentum at each time step.
                 #if FLOW_AFFECTS_BODY
-                const float fMomentOfInertialVorton = 0.3f * rMassPerParticle ;
+                const float fMomentOfInertialVorton = 0.3f * rMassPerVorton ;
                 rSphere.ApplyImpulsiveTorque( vAngVelDiff * fMomentOfInertialVorton ) ;  // Apply angular impulse (impulsive torque) to body
                 #endif
 
@@ -378,7 +621,7 @@ void FluidBodySim::SolveBoundaryConditions( void )
                 {
                     const Vec3  vVelChange          = rVorton.mVelocity - vVelBodyAtConPt ; // (negative of) total linear velocity change applied to vorton
                     #if FLOW_AFFECTS_BODY
-                    rSphere.ApplyImpulse( vVelChange * rMassPerParticle ) ;                 // Apply linear impulse to body
+                    rSphere.ApplyImpulse( vVelChange * rMassPerVorton ) ;                   // Apply linear impulse to body
                     #endif
                     rVorton.mVelocity = vVelBodyAtConPt ;  // If same vorton is involved in another contact before advection, this will conserve linear momentum within this phase.
                 }
@@ -386,13 +629,18 @@ void FluidBodySim::SolveBoundaryConditions( void )
         }
 
         // Collide tracers with rigid body.
-        for( unsigned uTracer = 0 ; uTracer < numTracers ; ++ uTracer )
-        {   // For each tracer in the simulation...
+        const float tracerReach = rSphere.mRadius + rTracerCells.GetMaxParticleSize() + maxDisplacement ;
+        GatherParticlesNear( nearbyParticles , rTracerCells , numTracers , rSphere.mPosition , tracerReach , movedTracers ) ;
+        const size_t numNearbyTracers = nearbyParticles.Size() ;
+        for( size_t iNearby = 0 ; iNearby < numNearbyTracers ; ++ iNearby )
+        {   // For each tracer near the body...
+            const unsigned uTracer = nearbyParticles[ iNearby ] ;
             Particle & rTracer = mVortonSim.GetTracers()[ uTracer ] ;
             const Vec3  vSphereToTracer = rTracer.mPosition - rSphere.mPosition ;   // vector from body center to tracer
             const float fSphereToTracer = vSphereToTracer.Magnitude() ;
             if( fSphereToTracer < ( rTracer.mSize + rSphere.mRadius ) )
             {   // Tracer is colliding with body.
+                movedTracers.PushBack( uTracer ) ;
                 // Project tracer to outside of body.
                 // This places the particle on the body surface.
                 const float distRescale         = ( rSphere.mRadius + rTracer.mSize ) * ( 1.0f + FLT_EPSILON ) / fSphereToTracer ;
@@ -403,7 +651,7 @@ void FluidBodySim::SolveBoundaryConditions( void )
                 const Vec3  vVelNew             = rSphere.mVelocity + vVelDueToRotation ;   // Total linear velocity of vorton at its new position, due to sticking to body
                 const Vec3  vVelChange          = rTracer.mVelocity - vVelNew ;             // (negative of) total linear velocity change applied to vorton
                 #if FLOW_AFFECTS_BODY
-                rSphere.ApplyImpulse( vVelChange * rMassPerParticle ) ;                     // Apply linear impulse to body
+                rSphere.ApplyImpulse( vVelChange * rMassPerTracer ) ;                       // Apply linear impulse to body
                 #endif
                 rTracer.mVelocity = vVelNew ;   // If same tracer is involved in another contact before advection, this will conserve momentum.
             }
@@ -419,13 +667,52 @@ void FluidBodySim::SolveBoundaryConditions( void )
     \param timeStep - change in virtual time since last update
 
     \param uFrame - frame counter
+
+    If UpdateSliced has an update in progress, this finishes that one.
 */
 void FluidBodySim::Update( float timeStep , unsigned uFrame )
 {
+    UpdateSliced( timeStep , uFrame , DBL_MAX ) ;
+}
+
+
+
+
+/*! \brief Advance an update of the fluid and rigid bodies, stopping early if a deadline passes
+
+    \param timeStep - change in virtual time since last update
+
+    \param uFrame - frame counter
+
+    \param deadlineSeconds - wall-clock time, as QueryPerformanceSeconds reports it,
+        after which to yield rather than start more work.
+
+    \return whether the update finished.  If not, call again, with the same
+        timeStep and uFrame, to resume it where it left off.
+
+    Only the fluid update yields.  Boundary conditions and rigid bodies update
+    together after it finishes, so bodies always reflect the last complete
+    update.  Vortons and tracers do too, until the fluid update starts to
+    advance them, as VortonSim::UpdateSliced describes.
+
+    \see VortonSim::UpdateSliced
+*/
+bool FluidBodySim::UpdateSliced( float timeStep , unsigned uFrame , double deadlineSeconds )
+{
+    if( ! mVortonSim.IsUpdating() )
+    {   // Starting a new update, so describe bodies to the fluid.
+        SetUpBodiesInFluid() ;
+    }
+
     // Update fluid, temporarily ignoring rigid bodies and boundary conditions.
+    bool bFluidUpdated ;
     QUERY_PERFORMANCE_ENTER ;
-    mVortonSim.Update( timeStep , uFrame ) ;
+    bFluidUpdated = mVortonSim.UpdateSliced( timeStep , uFrame , deadlineSeconds ) ;
     QUERY_PERFORMANCE_EXIT( FluidBodySim_VortonSim_Update ) ;
+    if( ! bFluidUpdated )
+    {   // Deadline passed.  Resume on next call.
+        return false ;
+    }
 
     // Apply boundary conditions and calculate impulses to apply to rigid bodies.
     QUERY_PERFORMANCE_ENTER ;
@@ -436,4 +723,34 @@ void FluidBodySim::Update( float timeStep , unsigned uFrame )
     QUERY_PERFORMANCE_ENTER ;
     RbSphere::UpdateSystem( mSpheres , timeStep , uFrame ) ;
     QUERY_PERFORMANCE_EXIT( FluidBodySim_RbSphere_UpdateSystem ) ;
+    return true ;
+}
+
+
+
+
+/*! \brief Tell the fluid about rigid bodies, before it updates
+*/
+void FluidBodySim::SetUpBodiesInFluid( void )
+{
+    // Request finer velocity around each body, where its boundary layer lies.
+    mVortonSim.ClearVelocityRefinementRegions() ;
+    const size_t numSpheres = mSpheres.Size() ;
+    for( size_t iSphere = 0 ; iSphere < numSpheres ; ++ iSphere )
+    {   // For each sphere...
+        const RbSphere &    rSphere = mSpheres[ iSphere ] ;
+        const float         reach   = sRefinementRadiusFactor * rSphere.mRadius ;
+        const Vec3          vReach( reach , reach , reach ) ;
+        mVortonSim.AddVelocityRefinementRegion( rSphere.mPosition - vReach , rSphere.mPosition + vReach ) ;
+    }
+
+    // Represent translation of each sphere with potential flow, so vortons need only convey slip.
+    mVortonSim.ClearPotentialFlowSpheres() ;
+#if BOUNDARY_POTENTIAL_FLOW
+    for( size_t iSphere = 0 ; iSphere < numSpheres ; ++ iSphere )
+    {   // For each sphere...
+        const RbSphere & rSphere = mSpheres[ iSphere ] ;
+        mVortonSim.AddPotentialFlowSphere( rSphere.mPosition , rSphere.mRadius , rSphere.mVelocity ) ;
+    }
+#endif
 }
@@ -30,7 +30,13 @@ class FluidBodySim
         {}
 
         void                    Initialize( unsigned numTracersPerCellCubeRoot ) ;
+        bool                    SaveCheckpoint( const char * strFilename ) const ;
+        bool                    LoadCheckpoint( const char * strFilename ) ;
+        void                    Fork( FluidBodySim & branch ) const ;
+        static void             UpdateBranches( FluidBodySim * const * pBranches , size_t numBranches , float timeStep , unsigned uFrame ) ;
         void                    Update( float timeStep , unsigned uFrame ) ;
+        bool                    UpdateSliced( float timeStep , unsigned uFrame , double deadlineSeconds ) ;
+        bool                    IsUpdating( void ) const { return mVortonSim.IsUpdating() ; }
         VortonSim &             GetVortonSim( void )    { return mVortonSim ; }
         Vector< RbSphere > &    GetSpheres( void )      { return mSpheres ; }
         void                    Clear( void )
@@ -46,6 +52,7 @@ class FluidBodySim
         FluidBodySim & operator=( const FluidBodySim & that ) ; // Disallow assignment
 
         void RemoveEmbeddedParticles( void ) ;
+        void SetUpBodiesInFluid( void ) ;
         void SolveBoundaryConditions( void ) ;
 
         VortonSim           mVortonSim ;
@@ -8,6 +8,8 @@
     \author Copyright 2009 Dr. Michael Jason Gourlay; All rights reserved.
 */
 
+#include <assert.h>
+
 #include "Core/Performance/perf.h"
 #include "Sim/Vorton/vorticityDistribution.h"
 
@@ -16,6 +18,8 @@
 
 /* static */ void FluidBodySim::UnitTest( void )
 {
+    fprintf( stderr , "FluidBodySim::UnitTest------------------------\n" ) ;
+
 #if USE_TBB
     tbb::task_scheduler_init tbb_init ;
 #endif
@@ -30,7 +34,7 @@
     static const unsigned   numCellsPerDim  = 16 ;
     static const unsigned   numVortonsMax   = numCellsPerDim * numCellsPerDim * numCellsPerDim ;
 
-    Vector< Vorton > & vortons = fluidBodySim.GetVortonSim().GetVortons() ;
+    ChunkedVector< Vorton > & vortons = fluidBodySim.GetVortonSim().GetVortons() ;
 
 #if 0 // vortex ring -- vorticity in [0,1]
     AssignVorticity( vortons , fMagnitude , numVortonsMax , VortexRing( fRadius , fThickness , Vec3( 0.0f , 0.0f , 1.0f ) ) ) ;
@@ -65,9 +69,9 @@
 
     double timeNow = 0.0f ;
 
-    for( unsigned uFrame = 0 ; uFrame < 0 ; ++ uFrame )
+    static const unsigned numTimedFrames = 0 ; // Raise this to time the simulation.
+    for( unsigned uFrame = 0 ; uFrame < numTimedFrames ; ++ uFrame )
     {
-        DEBUG_ONLY( fprintf( stderr , "sim frame %u\n" , uFrame ) ) ;
         static const float  timeStep    = 1.0f / 30.0f ;
         fluidBodySim.Update( timeStep , uFrame ) ;
         timeNow += timeStep ;
@@ -78,4 +82,36 @@
     fprintf( stderr , "tbb duration=%g second\n" , (timeFinal - time0).seconds() ) ;
 #endif
 
+    {   // Test that branches which UpdateBranches updates concurrently evolve like their source, unless changed.
+        static const float  timeStep    = 1.0f / 30.0f ;
+        FluidBodySim        twin( viscosity , density ) ;
+        FluidBodySim        pushed( viscosity , density ) ;
+        fluidBodySim.Fork( twin ) ;
+        fluidBodySim.Fork( pushed ) ;
+        pushed.GetSpheres()[ 0 ].ApplyImpulse( Vec3( 0.0f , 0.1f , 0.0f ) ) ;   // Change what would have happened.
+        FluidBodySim * const branches[] = { & twin , & pushed } ;
+        for( unsigned uFrame = 0 ; uFrame < 2 ; ++ uFrame )
+        {
+            fluidBodySim.Update( timeStep , uFrame ) ;
+            UpdateBranches( branches , sizeof( branches ) / sizeof( branches[ 0 ] ) , timeStep , uFrame ) ;
+        }
+        const ChunkedVector< Vorton > & rVortons        = fluidBodySim.GetVortonSim().GetVortons() ;
+        const ChunkedVector< Vorton > & rTwinVortons    = twin.GetVortonSim().GetVortons() ;
+        const ChunkedVector< Vorton > & rPushedVortons  = pushed.GetVortonSim().GetVortons() ;
+        assert( rVortons.Size() == rTwinVortons.Size() ) ;
+        float twinDifference    = ( fluidBodySim.GetSpheres()[ 0 ].mPosition - twin.GetSpheres()[ 0 ].mPosition ).Magnitude() ;
+        float pushedDifference  = ( fluidBodySim.GetSpheres()[ 0 ].mPosition - pushed.GetSpheres()[ 0 ].mPosition ).Magnitude() ;
+        for( size_t iVorton = 0 ; iVorton < rVortons.Size() ; ++ iVorton )
+        {   // For each vorton, compare its evolution in the source and in the twin.
+            twinDifference = MAX2( twinDifference , ( rVortons[ iVorton ].mPosition - rTwinVortons[ iVorton ].mPosition ).Magnitude() ) ;
+            twinDifference = MAX2( twinDifference , ( rVortons[ iVorton ].mVorticity - rTwinVortons[ iVorton ].mVorticity ).Magnitude() ) ;
+        }
+        fprintf( stderr , "branches: twin difference=%g, pushed sphere difference=%g, vortons source=%u pushed=%u\n"
+            , twinDifference , pushedDifference , unsigned( rVortons.Size() ) , unsigned( rPushedVortons.Size() ) ) ;
+        assert( 0.0f == twinDifference ) ;
+        assert( pushedDifference > 0.0f ) ;
+    }
+
+    fprintf( stderr , "FluidBodySim::UnitTest END ------------------------\n" ) ;
+
 }
\ No newline at end of file
@@ -0,0 +1,230 @@
+/*! \file linearOctree.h
+
+    \brief Templated linear octree container, a sparse, hierarchical spatial partition keyed by Morton codes
+
+    \author Copyright 2009 Dr. Michael Jason Gourlay; All rights reserved.
+*/
+#ifndef LINEAR_OCTREE_H
+#define LINEAR_OCTREE_H
+
+#include <math.h>
+
+#include "Core/Math/vec3.h"
+
+#include "uniformGrid.h"
+#include "spaceFillingCurves.h"
+
+// Macros --------------------------------------------------------------
+// Types --------------------------------------------------------------
+
+/*! \brief Templated linear octree container, a sparse, hierarchical spatial partition
+
+    A LinearOctree partitions space the same way a NestedGrid does: level 0
+    (the leaf level) has the shape of a given UniformGridGeometry, and each
+    higher level decimates the level below it by 2 along each axis, until
+    the top level has a single cell.  Unlike NestedGrid, which allocates
+    every cell of every layer, LinearOctree stores only occupied cells,
+    i.e. only cells which contain at least one element.  So memory and the
+    time to aggregate the tree scale with the occupied volume rather than
+    with the volume of the bounding box.
+
+    Each level stores the Morton keys of its occupied cells in sorted order,
+    the items those cells hold, and, for each cell, the range of its children
+    in the level below.  Since a parent's key is its child's key shifted
+    right by 3 bits, children of a cell are contiguous and appear in the
+    same z,y,x order in which NestedGrid visits a grid cluster.
+
+    The children of leaf cells are entries in the sorted array of
+    (key,index) pairs given to BuildSkeleton, so the elements that
+    occupy leaf cell i have indices
+    sortedPairs[ [ level[0].mFirstChild[i] , level[0].mFirstChild[i+1] ) ].mIndex .
+
+    \see NestedGrid
+
+*/
+template <class ItemT> class LinearOctree
+{
+    public:
+        /*! \brief Morton key of the leaf cell containing an element, with the index of that element
+
+            Sorting an array of these groups elements by leaf cell.
+        */
+        struct KeyIndexPair
+        {
+            unsigned    mKey    ;   ///< Morton key of the leaf cell that contains this element
+            unsigned    mIndex  ;   ///< Index of this element in its original array
+
+            /*! \brief Order by key then by index, so elements within each cell retain their original order
+            */
+            bool operator<( const KeyIndexPair & that ) const
+            {
+                return ( mKey < that.mKey ) || ( ( mKey == that.mKey ) && ( mIndex < that.mIndex ) ) ;
+            }
+        } ;
+
+        /*! \brief Occupied cells at one depth of the octree
+        */
+        struct Level
+        {
+            UniformGridGeometry mGeometry   ;   ///< Shape of the dense grid of which this level stores the occupied cells
+            Vector< unsigned >  mKeys       ;   ///< Morton keys of occupied cells, in ascending order
+            Vector< ItemT >     mItems      ;   ///< Contents of each occupied cell
+            Vector< unsigned >  mFirstChild ;   ///< Index, into the level below, of the first child of each cell.  Has one extra element so children of cell i are [mFirstChild[i],mFirstChild[i+1]).
+        } ;
+
+        /*! \brief Construct a blank linear octree
+        */
+        LinearOctree()
+        {
+        }
+
+
+        /*! \brief Return whether Morton keys can address every leaf cell of the given geometry
+        */
+        static bool CanRepresent( const UniformGridGeometry & leafGeometry )
+        {
+            static const unsigned maxCellsPerAxis = 1 << MORTON_BITS_PER_AXIS ;
+            return  ( leafGeometry.GetNumCells( 0 ) <= maxCellsPerAxis )
+                &&  ( leafGeometry.GetNumCells( 1 ) <= maxCellsPerAxis )
+                &&  ( leafGeometry.GetNumCells( 2 ) <= maxCellsPerAxis ) ;
+        }
+
+
+        /*! \brief Initialize the shape of each level of an unpopulated linear octree
+
+            \param leafGeometry - shape of the leaf level.  The number of cells along
+                each axis should be a power of 2 and must satisfy CanRepresent.
+
+            This computes level shapes the same way NestedGrid::Initialize does,
+            so a LinearOctree and a NestedGrid initialized from the same geometry
+            have the same depth and cells of the same size.
+
+        */
+        void Initialize( const UniformGridGeometry & leafGeometry )
+        {
+            Clear() ;
+            mLevels.PushBack( Level() ) ;
+            mLevels.Back().mGeometry.CopyShape( leafGeometry ) ;
+            while( mLevels.Back().mGeometry.GetGridCapacity() > 8 /* a cell has 8 corners */ )
+            {   // Level to decimate has more than 1 cell.
+                const UniformGridGeometry childGeometry = mLevels.Back().mGeometry ;
+                mLevels.PushBack( Level() ) ;
+                mLevels.Back().mGeometry.Decimate( childGeometry , 2 ) ;
+            }
+        }
+
+
+        /*! \brief Compute the Morton key of the leaf cell that contains the given position
+
+            \param vPosition - position of a point.  It should lie within the region of the leaf level.
+
+            \return Morton key of the leaf cell containing vPosition.
+
+        */
+        unsigned KeyOfPosition( const Vec3 & vPosition ) const
+        {
+            const UniformGridGeometry & leafGeometry = mLevels[ 0 ].mGeometry ;
+            unsigned indices[3] ;
+            leafGeometry.IndicesOfPosition( indices , vPosition ) ;
+            // Positions on the maximal boundary belong to the last cell.
+            indices[0] = MIN2( indices[0] , leafGeometry.GetNumCells( 0 ) - 1 ) ;
+            indices[1] = MIN2( indices[1] , leafGeometry.GetNumCells( 1 ) - 1 ) ;
+            indices[2] = MIN2( indices[2] , leafGeometry.GetNumCells( 2 ) - 1 ) ;
+            return MortonKey( indices ) ;
+        }
+
+
+        /*! \brief Create the occupied cells of every level, from leaves to root
+
+            \param sortedPairs - (key,index) pairs for every element, sorted in ascending order.
+                Each key must come from KeyOfPosition.
+
+            This creates cells only where elements exist, and initializes their
+            contents to whatever the default constructor returns.  The caller
+            then populates leaf cells from their elements, and aggregates each
+            level from the one below it.
+
+            \note This method assumes Initialize has already executed.
+
+        */
+        void BuildSkeleton( const Vector< KeyIndexPair > & sortedPairs )
+        {
+            const size_t numPairs = sortedPairs.Size() ;
+            {   // Create leaf cells, each of which owns a run of pairs with the same key.
+                Level & rLeaves = mLevels[ 0 ] ;
+                ClearContents( rLeaves ) ;
+                for( unsigned iPair = 0 ; iPair < numPairs ; ++ iPair )
+                {   // For each element...
+                    const unsigned key = sortedPairs[ iPair ].mKey ;
+                    if( ( 0 == iPair ) || ( key != sortedPairs[ iPair - 1 ].mKey ) )
+                    {   // This element starts a new leaf cell.
+                        rLeaves.mKeys.PushBack( key ) ;
+                        rLeaves.mFirstChild.PushBack( iPair ) ;
+                    }
+                }
+                rLeaves.mFirstChild.PushBack( unsigned( numPairs ) ) ;
+                rLeaves.mItems.Resize( rLeaves.mKeys.Size() , ItemT() ) ;
+            }
+
+            const size_t numLevels = GetDepth() ;
+            for( size_t iParentLevel = 1 ; iParentLevel < numLevels ; ++ iParentLevel )
+            {   // For each level above the leaves...
+                const Level &   rChildLevel     = mLevels[ iParentLevel - 1 ] ;
+                Level &         rParentLevel    = mLevels[ iParentLevel ] ;
+                const size_t    numChildren     = rChildLevel.mKeys.Size() ;
+                ClearContents( rParentLevel ) ;
+                for( unsigned iChild = 0 ; iChild < numChildren ; ++ iChild )
+                {   // For each occupied cell in the child level...
+                    const unsigned parentKey = rChildLevel.mKeys[ iChild ] >> 3 ;
+                    if( ( 0 == iChild ) || ( parentKey != rParentLevel.mKeys.Back() ) )
+                    {   // This child starts a new parent cell.
+                        rParentLevel.mKeys.PushBack( parentKey ) ;
+                        rParentLevel.mFirstChild.PushBack( iChild ) ;
+                    }
+                }
+                rParentLevel.mFirstChild.PushBack( unsigned( numChildren ) ) ;
+                rParentLevel.mItems.Resize( rParentLevel.mKeys.Size() , ItemT() ) ;
+            }
+        }
+
+
+        /*! \brief Return number of levels in tree
+        */
+        size_t GetDepth( void ) const { return mLevels.Size() ; }
+
+
+        /*! \brief Get level at specified depth of this tree
+
+            \param index - depth of level to obtain, where 0 means leaf level and GetDepth()-1 means root level.
+        */
+              Level & operator[]( size_t index )       { return mLevels[ index ] ; }
+        const Level & operator[]( size_t index ) const { return mLevels[ index ] ; }
+
+
+        void Clear( void )
+        {
+            mLevels.Clear() ;
+        }
+
+    private:
+        LinearOctree( const LinearOctree & that ) ; // Disallow copy construction
+        LinearOctree & operator= ( const LinearOctree & that ) ; // Disallow copy
+
+
+        /*! \brief Remove all cells from the given level, retaining its geometry
+        */
+        static void ClearContents( Level & rLevel )
+        {
+            rLevel.mKeys.Clear() ;
+            rLevel.mItems.Clear() ;
+            rLevel.mFirstChild.Clear() ;
+        }
+
+
+        Vector< Level > mLevels ;   ///< Dynamic array of levels, from leaves to root.
+} ;
+
+// Public variables --------------------------------------------------------------
+// Public functions --------------------------------------------------------------
+
+#endif
@@ -161,7 +161,7 @@ template <class ItemT> class NestedGrid
             \see GetDecimations
 
         */
-        void GetChildClusterMinCornerIndex( unsigned clusterMinIndices[3] , const unsigned decimations[3] , const unsigned indicesOfParentCell[3] )
+        void GetChildClusterMinCornerIndex( unsigned clusterMinIndices[3] , const unsigned decimations[3] , const unsigned indicesOfParentCell[3] ) const
         {
             clusterMinIndices[ 0 ] = indicesOfParentCell[ 0 ] * decimations[ 0 ] ;
             clusterMinIndices[ 1 ] = indicesOfParentCell[ 1 ] * decimations[ 1 ] ;
@@ -0,0 +1,466 @@
+/*! \file particleCellIndex.h
+
+    \brief Index of which grid cell contains each particle, stored as contiguous ranges per cell
+
+    \author Copyright 2009 Dr. Michael Jason Gourlay; All rights reserved.
+*/
+#ifndef PARTICLE_CELL_INDEX_H
+#define PARTICLE_CELL_INDEX_H
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "Core/Math/vec3.h"
+
+#include "uniformGrid.h"
+
+// Macros --------------------------------------------------------------
+// Types --------------------------------------------------------------
+
+/*! \brief Index of which grid cell contains each particle, stored as contiguous ranges per cell
+
+    This is a counting sort of particle indices by cell, stored in
+    "compressed sparse row" form: particles in the cell with offset c
+    have indices GetParticle(i) for i in [GetCellBegin(c),GetCellEnd(c)).
+    Cell offsets are the same as those UniformGrid uses for the given
+    geometry, so a grid with that shape can use them directly.
+
+    Each cell's range has a few unused slots after it, so particles can
+    move between cells without shifting the ranges of other cells.
+    So visit particles cell by cell, never by a range of GetParticle
+    that spans cells.
+
+    Within each cell, particles appear in ascending order of their
+    original index, so visiting particles through this index visits
+    them in the same order as a loop over the particle array would.
+
+    Building happens in 3 phases so that phases 1 and 3 can run in parallel:
+    (1) for each chunk of particles, AddParticle computes cells and counts them,
+    (2) AccumulateCounts computes where each (cell,chunk) run starts,
+    (3) for each chunk, ScatterChunk writes particle indices into place.
+
+    From one frame to the next, most particles stay in the same cell,
+    so when neither the grid nor the number of particles changed, the
+    index can update instead of rebuilding.  Then phase 1 follows
+    BeginUpdate, AddParticle records only particles whose cell changed,
+    and ApplyMoves moves those from the range of the cell they left into
+    the slack of the cell they entered, at a cost proportional to the
+    number of particles that moved.  If too many particles moved, or a
+    cell ran out of slack, ApplyMoves declines, and the caller finishes
+    as though rebuilding, except that CountChunk counts cells AddParticle
+    already computed.
+
+    Particles outside the grid belong to the nearest cell, so a query
+    for the cells along the grid boundary finds particles beyond it too.
+
+*/
+class ParticleCellIndex
+{
+    public:
+        /*! \brief Construct an empty index
+        */
+        ParticleCellIndex()
+            : mNumChunks( 0 )
+            , mUpdating( false )
+            , mPendingCount( false )
+            , mNeedsScatter( false )
+        {
+        }
+
+
+        /*! \brief Prepare to index particles in the given grid
+
+            \param grid - shape of grid whose cells partition particles
+
+            \param numParticles - number of particles to index
+
+            \param numChunks - number of contiguous chunks of particles, each of which one thread could process
+        */
+        void Reset( const UniformGridGeometry & grid , size_t numParticles , size_t numChunks )
+        {
+            mGeometry.CopyShape( grid ) ;
+            mNumChunks      = MAX2( 1 , numChunks ) ;
+            mUpdating       = false ;
+            mPendingCount   = false ;
+            mNeedsScatter   = false ;
+            mMovedParticles.Clear() ;
+            const size_t numCells = mGeometry.GetGridCapacity() ;
+            mCellOfParticle.Resize( numParticles ) ;
+            mCellStart.Resize( numCells + 1 ) ;
+            mCellEnd.Resize( numCells ) ;
+            mChunkCounts.Clear() ;
+            mChunkCounts.Resize( numCells * mNumChunks , 0 ) ;
+            mChunkMaxSize.Clear() ;
+            mChunkMaxSize.Resize( mNumChunks , 0.0f ) ;
+        }
+
+
+        /*! \brief Return whether this index could update, rather than rebuild, to index particles in the given grid
+
+            \param grid - shape of grid whose cells partition particles
+
+            \param numParticles - number of particles to index
+        */
+        bool CanUpdate( const UniformGridGeometry & grid , size_t numParticles ) const
+        {
+            return  ( numParticles == GetNumParticles() )
+                &&  ( mCellStart.Size() == grid.GetGridCapacity() + 1 )
+                &&  ( grid.GetNumPoints( 0 ) == mGeometry.GetNumPoints( 0 ) )
+                &&  ( grid.GetNumPoints( 1 ) == mGeometry.GetNumPoints( 1 ) )
+                &&  ( grid.GetNumPoints( 2 ) == mGeometry.GetNumPoints( 2 ) )
+                &&  ( grid.GetMinCorner() == mGeometry.GetMinCorner() )
+                &&  ( grid.GetExtent() == mGeometry.GetExtent() ) ;
+        }
+
+
+        /*! \brief Prepare to update this index for particles that moved since it was last built
+
+            \param numChunks - number of contiguous chunks of particles, each of which one thread could process
+
+            \note This assumes CanUpdate returned true.
+
+            \see ApplyMoves
+        */
+        void BeginUpdate( size_t numChunks )
+        {
+            mNumChunks      = MAX2( 1 , numChunks ) ;
+            mUpdating       = true ;
+            mPendingCount   = false ;
+            mNeedsScatter   = false ;
+            mMovedParticles.Clear() ;
+            mMovedParticles.Resize( mNumChunks ) ;
+            mChunkMaxSize.Clear() ;
+            mChunkMaxSize.Resize( mNumChunks , 0.0f ) ;
+        }
+
+
+        /*! \brief Return index of first particle in the given chunk
+        */
+        size_t GetChunkBegin( size_t iChunk ) const
+        {
+            return GetNumParticles() * iChunk / mNumChunks ;
+        }
+
+
+        /*! \brief Return offset of cell that contains the given position, or the nearest cell if the position lies outside the grid
+        */
+        unsigned CellOfPosition( const Vec3 & vPosition ) const
+        {
+            const Vec3  vPosRel( vPosition - mGeometry.GetMinCorner() ) ;
+            const Vec3 & rCellsPerExtent = mGeometry.GetCellsPerExtent() ;
+            const unsigned indices[3] = { ClampIndex( vPosRel.x * rCellsPerExtent.x , 0 ) ,
+                                          ClampIndex( vPosRel.y * rCellsPerExtent.y , 1 ) ,
+                                          ClampIndex( vPosRel.z * rCellsPerExtent.z , 2 ) } ;
+            return indices[0] + mGeometry.GetNumPoints( 0 ) * ( indices[1] + mGeometry.GetNumPoints( 1 ) * indices[2] ) ;
+        }
+
+
+        /*! \brief Assign a particle to the cell containing it, and count it, or if updating, note whether it changed cells
+
+            \param iChunk - chunk to which this particle belongs.  Only one thread may process a chunk.
+
+            \param iParticle - index of particle
+
+            \param vPosition - position of particle
+
+            \param size - extent of particle, used to report the largest particle in the index
+
+            \see AccumulateCounts
+        */
+        void AddParticle( size_t iChunk , size_t iParticle , const Vec3 & vPosition , float size )
+        {
+            const unsigned cell = CellOfPosition( vPosition ) ;
+            if( ! mUpdating )
+            {   // Rebuilding, so count every particle.
+                mCellOfParticle[ iParticle ] = cell ;
+                ++ mChunkCounts[ cell * mNumChunks + iChunk ] ;
+            }
+            else if( cell != mCellOfParticle[ iParticle ] )
+            {   // Updating, and this particle changed cells.
+                const MovedParticle moved = { mCellOfParticle[ iParticle ] , cell , unsigned( iParticle ) } ;
+                mMovedParticles[ iChunk ].PushBack( moved ) ;
+                mCellOfParticle[ iParticle ] = cell ;
+            }
+            mChunkMaxSize[ iChunk ] = MAX2( mChunkMaxSize[ iChunk ] , size ) ;
+        }
+
+
+        /*! \brief Move particles that changed cells into the ranges of their new cells, after AddParticle has executed for every particle
+
+            \param maxMovedFraction - largest fraction of particles that may have moved for updating to proceed.
+                Beyond that, rebuilding costs less.
+
+            \return true if this index is complete.  If false, either this index
+                is rebuilding, too many particles moved, or a cell ran out of
+                slack, so the caller must call CountChunk for each chunk,
+                then AccumulateCounts, then ScatterChunk for each chunk.
+
+            This removes each moved particle from the range of the cell it
+            left, and inserts it into the range of the cell it entered, which
+            shifts only other particles in those 2 cells.  So this costs time
+            proportional to the number of particles that moved, times the
+            number of particles per cell, regardless of the number of cells.
+
+            This produces the same contents per cell that rebuilding would:
+            Within each cell, particles remain in ascending order of index.
+        */
+        bool ApplyMoves( float maxMovedFraction )
+        {
+            if( ! mUpdating )
+            {   // Rebuilding, so there is nothing to move.
+                return false ;
+            }
+            mUpdating = false ;
+
+            size_t numMoved = 0 ;
+            for( size_t iChunk = 0 ; iChunk < mNumChunks ; ++ iChunk )
+            {   // For each chunk, count particles that changed cells.
+                numMoved += mMovedParticles[ iChunk ].Size() ;
+            }
+            if( 0 == numMoved )
+            {   // No particle changed cells, so index is already correct.
+                return true ;
+            }
+            if( float( numMoved ) > maxMovedFraction * float( GetNumParticles() ) )
+            {   // Too many particles moved, so rebuild from cells AddParticle already computed.
+                return DeclineMoves() ;
+            }
+
+            for( size_t iChunk = 0 ; iChunk < mNumChunks ; ++ iChunk )
+            {   // For each chunk...
+                const Vector< MovedParticle > & rChunkMoved = mMovedParticles[ iChunk ] ;
+                for( size_t iMoved = 0 ; iMoved < rChunkMoved.Size() ; ++ iMoved )
+                {   // For each particle that changed cells, remove it from the cell it left, and close the gap.
+                    const MovedParticle & rMoved = rChunkMoved[ iMoved ] ;
+                    const unsigned  iEnd    = mCellEnd[ rMoved.mPrevCell ] ;
+                    unsigned        iSorted = mCellStart[ rMoved.mPrevCell ] ;
+                    while( mSortedParticles[ iSorted ] != rMoved.mIndex )
+                    {   // Find particle in the cell it left.
+                        ++ iSorted ;
+                    }
+                    for( ; iSorted + 1 < iEnd ; ++ iSorted )
+                    {   // Shift later particles in this cell down into the gap.
+                        mSortedParticles[ iSorted ] = mSortedParticles[ iSorted + 1 ] ;
+                    }
+                    -- mCellEnd[ rMoved.mPrevCell ] ;
+                }
+            }
+
+            for( size_t iChunk = 0 ; iChunk < mNumChunks ; ++ iChunk )
+            {   // For each chunk...
+                const Vector< MovedParticle > & rChunkMoved = mMovedParticles[ iChunk ] ;
+                for( size_t iMoved = 0 ; iMoved < rChunkMoved.Size() ; ++ iMoved )
+                {   // For each particle that changed cells, insert it into the cell it entered, in order of index.
+                    const MovedParticle & rMoved = rChunkMoved[ iMoved ] ;
+                    const unsigned  iBegin  = mCellStart[ rMoved.mCell ] ;
+                    unsigned        iSorted = mCellEnd[ rMoved.mCell ] ;
+                    if( iSorted == mCellStart[ rMoved.mCell + 1 ] )
+                    {   // Cell has no slack left, so rebuild, which replenishes slack.
+                        return DeclineMoves() ;
+                    }
+                    for( ; ( iSorted > iBegin ) && ( mSortedParticles[ iSorted - 1 ] > rMoved.mIndex ) ; -- iSorted )
+                    {   // Shift particles with greater indices up, to make room.
+                        mSortedParticles[ iSorted ] = mSortedParticles[ iSorted - 1 ] ;
+                    }
+                    mSortedParticles[ iSorted ] = rMoved.mIndex ;
+                    ++ mCellEnd[ rMoved.mCell ] ;
+                }
+            }
+            mMovedParticles.Clear() ;
+            return true ;
+        }
+
+
+        /*! \brief Count particles in the given chunk by the cells AddParticle assigned them, when ApplyMoves declined to update
+
+            This does nothing unless ApplyMoves fell back to rebuilding, since otherwise AddParticle already counted.
+        */
+        void CountChunk( size_t iChunk )
+        {
+            if( ! mPendingCount )
+            {   // AddParticle already counted, or ApplyMoves completed the index.
+                return ;
+            }
+            const size_t iEnd = GetChunkBegin( iChunk + 1 ) ;
+            for( size_t iParticle = GetChunkBegin( iChunk ) ; iParticle < iEnd ; ++ iParticle )
+            {   // For each particle in this chunk...
+                ++ mChunkCounts[ mCellOfParticle[ iParticle ] * mNumChunks + iChunk ] ;
+            }
+        }
+
+
+        /*! \brief Compute where particles in each cell start, after AddParticle has executed for every particle
+
+            This leaves slack after each cell, so ApplyMoves can insert particles that enter it.
+        */
+        void AccumulateCounts( void )
+        {
+            static const unsigned sSlackPerCell = 2 ;   // Unused slots after each cell.  Most cells gain at most a particle or two per update.
+
+            mPendingCount = false ;
+            mNeedsScatter = true ;
+            const size_t numCells = mGeometry.GetGridCapacity() ;
+            unsigned start = 0 ;
+            for( size_t cell = 0 ; cell < numCells ; ++ cell )
+            {   // For each cell...
+                mCellStart[ cell ] = start ;
+                for( size_t iChunk = 0 ; iChunk < mNumChunks ; ++ iChunk )
+                {   // For each chunk of particles, replace count with where that chunk's run starts.
+                    unsigned & rCount = mChunkCounts[ cell * mNumChunks + iChunk ] ;
+                    const unsigned count = rCount ;
+                    rCount = start ;
+                    start += count ;
+                }
+                mCellEnd[ cell ] = start ;
+                start += sSlackPerCell ;
+            }
+            mCellStart[ numCells ] = start ;
+            mSortedParticles.Resize( start ) ;
+        }
+
+
+        /*! \brief Write indices of particles in the given chunk into their cells, after AccumulateCounts has executed
+        */
+        void ScatterChunk( size_t iChunk )
+        {
+            const size_t iEnd = GetChunkBegin( iChunk + 1 ) ;
+            for( size_t iParticle = GetChunkBegin( iChunk ) ; iParticle < iEnd ; ++ iParticle )
+            {   // For each particle in this chunk...
+                const unsigned cell = mCellOfParticle[ iParticle ] ;
+                mSortedParticles[ mChunkCounts[ cell * mNumChunks + iChunk ] ++ ] = unsigned( iParticle ) ;
+            }
+        }
+
+
+        /*! \brief Append to the given array indices of particles in cells that overlap the given box, in ascending order
+
+            \param particles - (in/out) array to which to append particle indices
+
+            \param vMin - minimal corner of box
+
+            \param vMax - maximal corner of box
+        */
+        void GatherParticlesInBox( Vector< unsigned > & particles , const Vec3 & vMin , const Vec3 & vMax ) const
+        {
+            const size_t numBefore = particles.Size() ;
+            const Vec3  vMinRel( vMin - mGeometry.GetMinCorner() ) ;
+            const Vec3  vMaxRel( vMax - mGeometry.GetMinCorner() ) ;
+            const Vec3 & rCellsPerExtent = mGeometry.GetCellsPerExtent() ;
+            const unsigned idxMin[3] = {    ClampIndex( vMinRel.x * rCellsPerExtent.x , 0 ) ,
+                                            ClampIndex( vMinRel.y * rCellsPerExtent.y , 1 ) ,
+                                            ClampIndex( vMinRel.z * rCellsPerExtent.z , 2 ) } ;
+            const unsigned idxMax[3] = {    ClampIndex( vMaxRel.x * rCellsPerExtent.x , 0 ) ,
+                                            ClampIndex( vMaxRel.y * rCellsPerExtent.y , 1 ) ,
+                                            ClampIndex( vMaxRel.z * rCellsPerExtent.z , 2 ) } ;
+            const unsigned nx  = mGeometry.GetNumPoints( 0 ) ;
+            const unsigned nxy = nx * mGeometry.GetNumPoints( 1 ) ;
+            unsigned idx[3] ;
+            for( idx[2] = idxMin[2] ; idx[2] <= idxMax[2] ; ++ idx[2] )
+            {
+                for( idx[1] = idxMin[1] ; idx[1] <= idxMax[1] ; ++ idx[1] )
+                {
+                    for( idx[0] = idxMin[0] ; idx[0] <= idxMax[0] ; ++ idx[0] )
+                    {   // For each cell overlapping the box...
+                        const unsigned cell = idx[0] + idx[1] * nx + idx[2] * nxy ;
+                        for( unsigned iSorted = mCellStart[ cell ] ; iSorted < mCellEnd[ cell ] ; ++ iSorted )
+                        {
+                            particles.PushBack( mSortedParticles[ iSorted ] ) ;
+                        }
+                    }
+                }
+            }
+            sort( particles.Begin() + numBefore , particles.End() ) ;
+        }
+
+
+        /*! \brief Return whether ScatterChunk must execute for each chunk to complete this index
+        */
+        bool NeedsScatter( void ) const { return mNeedsScatter ; }
+
+
+        /*! \brief Return largest size given to AddParticle since Reset or BeginUpdate
+        */
+        float GetMaxParticleSize( void ) const
+        {
+            float maxSize = 0.0f ;
+            for( size_t iChunk = 0 ; iChunk < mChunkMaxSize.Size() ; ++ iChunk )
+            {
+                maxSize = MAX2( maxSize , mChunkMaxSize[ iChunk ] ) ;
+            }
+            return maxSize ;
+        }
+
+        const UniformGridGeometry & GetGeometry( void ) const                   { return mGeometry ; }
+        size_t                      GetNumParticles( void ) const               { return mCellOfParticle.Size() ; }
+        size_t                      GetNumChunks( void ) const                  { return mNumChunks ; }
+        unsigned                    GetCellOfParticle( size_t iParticle ) const { return mCellOfParticle[ iParticle ] ; }
+        unsigned                    GetCellBegin( unsigned cell ) const         { return mCellStart[ cell ] ; }
+        unsigned                    GetCellEnd( unsigned cell ) const           { return mCellEnd[ cell ] ; }
+        unsigned                    GetParticle( unsigned iSorted ) const       { return mSortedParticles[ iSorted ] ; }
+
+        void Clear( void )
+        {
+            mGeometry = UniformGridGeometry() ;
+            mNumChunks = 0 ;
+            mUpdating = false ;
+            mPendingCount = false ;
+            mNeedsScatter = false ;
+            mMovedParticles.Clear() ;
+            mCellOfParticle.Clear() ;
+            mSortedParticles.Clear() ;
+            mCellStart.Clear() ;
+            mCellEnd.Clear() ;
+            mChunkCounts.Clear() ;
+            mChunkMaxSize.Clear() ;
+        }
+
+    private:
+        /*! \brief Particle that changed cells, and the cells it left and entered
+        */
+        struct MovedParticle
+        {
+            unsigned    mPrevCell   ;   ///< Offset of cell that contained this particle when the index was last complete
+            unsigned    mCell       ;   ///< Offset of cell that now contains this particle
+            unsigned    mIndex      ;   ///< Index of particle
+        } ;
+
+        /*! \brief Abandon updating, so the caller rebuilds this index from cells AddParticle already computed
+
+            \return false, for ApplyMoves to return
+        */
+        bool DeclineMoves( void )
+        {
+            mMovedParticles.Clear() ;
+            mChunkCounts.Clear() ;
+            mChunkCounts.Resize( mGeometry.GetGridCapacity() * mNumChunks , 0 ) ;
+            mPendingCount = true ;
+            return false ;
+        }
+
+        /*! \brief Convert a fractional cell index along the given axis to the nearest valid cell index
+        */
+        unsigned ClampIndex( float fIdx , int axis ) const
+        {
+            const float maxIdx = float( mGeometry.GetNumCells( axis ) - 1 ) ;
+            return unsigned( MIN2( MAX2( fIdx , 0.0f ) , maxIdx ) ) ;
+        }
+
+        UniformGridGeometry mGeometry           ;   ///< Shape of grid whose cells partition particles
+        size_t              mNumChunks          ;   ///< Number of chunks into which particles were divided while building
+        bool                mUpdating           ;   ///< Whether AddParticle should record particles that changed cells, instead of counting every particle
+        bool                mPendingCount       ;   ///< Whether ApplyMoves declined to update, so CountChunk must count cells
+        bool                mNeedsScatter       ;   ///< Whether AccumulateCounts executed, so ScatterChunk must write particles into place
+        Vector< Vector< MovedParticle > > mMovedParticles ; ///< Particles that changed cells, for each chunk
+        Vector< unsigned >  mCellOfParticle     ;   ///< Offset of cell containing each particle
+        Vector< unsigned >  mSortedParticles    ;   ///< Particle indices, sorted by cell, with slack after each cell
+        Vector< unsigned >  mCellStart          ;   ///< Index into mSortedParticles of first particle in each cell.  Has one extra element, so cell c, with its slack, occupies [mCellStart[c],mCellStart[c+1]).
+        Vector< unsigned >  mCellEnd            ;   ///< Index into mSortedParticles one past the last particle in each cell.  Particles in cell c are [mCellStart[c],mCellEnd[c]).
+        Vector< unsigned >  mChunkCounts        ;   ///< Number of particles in each (cell,chunk), then where each (cell,chunk) run starts
+        Vector< float >     mChunkMaxSize       ;   ///< Largest particle size in each chunk
+} ;
+
+// Public variables --------------------------------------------------------------
+// Public functions --------------------------------------------------------------
+
+#endif
@@ -0,0 +1,182 @@
+/*! \file spaceFillingCurves.h
+
+    \brief Keys that map 3D grid indices onto a 1D curve which preserves spatial locality
+
+    \author Copyright 2009 Dr. Michael Jason Gourlay; All rights reserved.
+*/
+#ifndef SPACE_FILLING_CURVES_H
+#define SPACE_FILLING_CURVES_H
+
+// Macros --------------------------------------------------------------
+
+/*! \brief Number of bits per axis that a 32-bit Morton key can hold
+*/
+#define MORTON_BITS_PER_AXIS 10
+
+// Types --------------------------------------------------------------
+// Public variables --------------------------------------------------------------
+// Public functions --------------------------------------------------------------
+
+/*! \brief Spread the low 10 bits of a value so that 2 zero bits separate each bit from the next
+
+    For example, binary 1011 becomes 1000001001.
+*/
+inline unsigned MortonSpreadBits( unsigned x )
+{
+    x &= 0x000003ff ;
+    x = ( x ^ ( x << 16 ) ) & 0xff0000ff ;
+    x = ( x ^ ( x <<  8 ) ) & 0x0300f00f ;
+    x = ( x ^ ( x <<  4 ) ) & 0x030c30c3 ;
+    x = ( x ^ ( x <<  2 ) ) & 0x09249249 ;
+    return x ;
+}
+
+
+
+
+/*! \brief Inverse of MortonSpreadBits: gather every third bit into the low 10 bits
+*/
+inline unsigned MortonCompactBits( unsigned x )
+{
+    x &= 0x09249249 ;
+    x = ( x ^ ( x >>  2 ) ) & 0x030c30c3 ;
+    x = ( x ^ ( x >>  4 ) ) & 0x0300f00f ;
+    x = ( x ^ ( x >>  8 ) ) & 0xff0000ff ;
+    x = ( x ^ ( x >> 16 ) ) & 0x000003ff ;
+    return x ;
+}
+
+
+
+
+/*! \brief Compute Morton (Z-order) key from grid cell indices
+
+    \param indices - grid cell indices along x, y and z.  Each must be less than 2^MORTON_BITS_PER_AXIS.
+
+    \return key whose bits interleave those of the indices, as ...z1y1x1z0y0x0.
+
+    Sorting by this key visits cells in a recursive Z pattern, so cells with
+    nearby keys tend to lie near each other in space.  Also, shifting a key
+    right by 3 bits yields the key of the parent cell in an octree whose
+    cells are twice as large, i.e. whose indices are half as large.
+*/
+inline unsigned MortonKey( const unsigned indices[3] )
+{
+    return MortonSpreadBits( indices[0] ) | ( MortonSpreadBits( indices[1] ) << 1 ) | ( MortonSpreadBits( indices[2] ) << 2 ) ;
+}
+
+
+
+
+/*! \brief Compute grid cell indices from Morton key
+
+    \param indices - (out) grid cell indices along x, y and z.
+
+    \param key - Morton key, as computed by MortonKey.
+*/
+inline void MortonIndices( unsigned indices[3] , unsigned key )
+{
+    indices[0] = MortonCompactBits( key      ) ;
+    indices[1] = MortonCompactBits( key >> 1 ) ;
+    indices[2] = MortonCompactBits( key >> 2 ) ;
+}
+
+
+
+
+/*! \brief Compute Hilbert key from grid cell indices
+
+    \param indices - grid cell indices along x, y and z.  Each must be less than 2^numBits.
+
+    \param numBits - number of bits per axis, at most MORTON_BITS_PER_AXIS.
+
+    \return position of the cell along a Hilbert curve that fills a cube of 2^numBits cells per side.
+
+    Unlike the Z pattern of a Morton key, consecutive Hilbert keys always
+    belong to face-adjacent cells, so the curve never jumps across space.
+    So any contiguous range of keys covers a compact region.
+
+    \see John Skilling: "Programming the Hilbert curve", AIP Conference Proceedings 707 (2004).
+*/
+inline unsigned HilbertKey( const unsigned indices[3] , unsigned numBits )
+{
+    unsigned x[3] = { indices[0] , indices[1] , indices[2] } ;
+    const unsigned M = 1u << ( numBits - 1 ) ;
+    for( unsigned q = M ; q > 1 ; q >>= 1 )
+    {   // Undo excess rotations and reflections, from most to least significant bit.
+        const unsigned p = q - 1 ;
+        for( unsigned i = 0 ; i < 3 ; ++ i )
+        {
+            if( x[ i ] & q )
+            {   // Invert low bits of x[0].
+                x[ 0 ] ^= p ;
+            }
+            else
+            {   // Exchange low bits of x[0] and x[i].
+                const unsigned t = ( x[ 0 ] ^ x[ i ] ) & p ;
+                x[ 0 ] ^= t ;
+                x[ i ] ^= t ;
+            }
+        }
+    }
+    // Gray encode.
+    x[ 1 ] ^= x[ 0 ] ;
+    x[ 2 ] ^= x[ 1 ] ;
+    unsigned t = 0 ;
+    for( unsigned q = M ; q > 1 ; q >>= 1 )
+    {
+        if( x[ 2 ] & q )
+        {
+            t ^= q - 1 ;
+        }
+    }
+    x[ 0 ] ^= t ;
+    x[ 1 ] ^= t ;
+    x[ 2 ] ^= t ;
+    // Interleave transposed bits, with x[0] most significant within each triple.
+    return MortonSpreadBits( x[ 2 ] ) | ( MortonSpreadBits( x[ 1 ] ) << 1 ) | ( MortonSpreadBits( x[ 0 ] ) << 2 ) ;
+}
+
+
+
+
+/*! \brief Compute grid cell indices from Hilbert key
+
+    \param indices - (out) grid cell indices along x, y and z.
+
+    \param key - Hilbert key, as computed by HilbertKey.
+
+    \param numBits - number of bits per axis, which must match that given to HilbertKey.
+*/
+inline void HilbertIndices( unsigned indices[3] , unsigned key , unsigned numBits )
+{
+    unsigned x[3] = { MortonCompactBits( key >> 2 ) , MortonCompactBits( key >> 1 ) , MortonCompactBits( key ) } ;
+    const unsigned N = 2u << ( numBits - 1 ) ;
+    // Gray decode.
+    const unsigned t = x[ 2 ] >> 1 ;
+    x[ 2 ] ^= x[ 1 ] ;
+    x[ 1 ] ^= x[ 0 ] ;
+    x[ 0 ] ^= t ;
+    for( unsigned q = 2 ; q != N ; q <<= 1 )
+    {   // Redo rotations and reflections, from least to most significant bit.
+        const unsigned p = q - 1 ;
+        for( int i = 2 ; i >= 0 ; -- i )
+        {
+            if( x[ i ] & q )
+            {   // Invert low bits of x[0].
+                x[ 0 ] ^= p ;
+            }
+            else
+            {   // Exchange low bits of x[0] and x[i].
+                const unsigned t2 = ( x[ 0 ] ^ x[ i ] ) & p ;
+                x[ 0 ] ^= t2 ;
+                x[ i ] ^= t2 ;
+            }
+        }
+    }
+    indices[0] = x[ 0 ] ;
+    indices[1] = x[ 1 ] ;
+    indices[2] = x[ 2 ] ;
+}
+
+#endif
@@ -0,0 +1,476 @@
+/*! \file sparseUniformGrid.h
+
+    \brief A container for fast spatial lookups and insertions, over an unbounded region
+
+    \author Copyright 2009 Dr. Michael Jason Gourlay; All rights reserved.
+*/
+#ifndef SPARSE_UNIFORM_GRID_H
+#define SPARSE_UNIFORM_GRID_H
+
+#include <math.h>
+
+#include "Core/Math/vec3.h"
+
+#include "uniformGrid.h"
+
+// Macros --------------------------------------------------------------
+// Types --------------------------------------------------------------
+
+/*! \brief Templated container for fast spatial lookups and insertions, over an unbounded region
+
+    Like UniformGrid, this container holds values at the points of a lattice
+    whose cells all have the same size, and it interpolates and inserts
+    values the same way.  Unlike UniformGrid, the lattice has no bounds:
+    indices can be any integer, including negative.  This container only
+    allocates storage for the regions that callers touch, in blocks of
+    BLOCK_SIZE^3 points.  So memory grows with the number of regions
+    occupied, not with the extent of the region that contains them.
+
+    An open-addressing hash table, keyed by block coordinates, locates blocks.
+    Points inside blocks that do not exist have the "background" value.
+
+    Lookups that hit the same block as the previous lookup skip the hash table.
+    Each thread should use its own BlockCache to benefit from this.
+
+    \see UniformGrid
+
+*/
+template <class ItemT> class SparseUniformGrid
+{
+    public:
+        enum
+        {
+            BLOCK_SIZE_LOG2     = 3                                     ,   ///< Log base 2 of number of points along each side of a block
+            BLOCK_SIZE          = 1 << BLOCK_SIZE_LOG2                  ,   ///< Number of points along each side of a block
+            BLOCK_MASK          = BLOCK_SIZE - 1                        ,   ///< Mask that extracts index within a block from a point index
+            NUM_POINTS_PER_BLOCK= BLOCK_SIZE * BLOCK_SIZE * BLOCK_SIZE      ///< Number of points in each block
+        } ;
+
+        static const unsigned NOT_FOUND = ~0U ;   ///< Block index that FindBlock returns when block does not exist
+
+        /*! \brief Cubic region of points, stored densely
+        */
+        struct Block
+        {
+            int     mCoords[3]                      ;   ///< Block coordinates, i.e. indices of minimal point divided by BLOCK_SIZE
+            ItemT   mPoints[ NUM_POINTS_PER_BLOCK ] ;   ///< Values at points in this block, with x varying fastest
+        } ;
+
+        /*! \brief Most recently used block, to skip hash lookups when consecutive queries hit the same block
+        */
+        struct BlockCache
+        {
+            BlockCache() : mBlockIndex( NOT_FOUND ) {}
+            unsigned    mBlockIndex ;   ///< Index of cached block, or NOT_FOUND if the cache is empty
+        } ;
+
+        /*! \brief Construct an empty sparse uniform grid
+        */
+        SparseUniformGrid()
+            : mMinCorner( 0.0f , 0.0f , 0.0f )
+            , mCellExtent( 0.0f , 0.0f , 0.0f )
+            , mCellsPerExtent( 0.0f , 0.0f , 0.0f )
+            , mNumSlotsMask( 0 )
+        {
+        }
+
+
+        /*! \brief Define the lattice of this grid to coincide with the points of a given uniform grid
+
+            \param reference - grid whose points this grid shares.  Points of this grid
+                extend indefinitely beyond the reference grid, in every direction.
+
+            \param background - value of points which no block contains.
+
+            This removes all blocks.
+
+        */
+        void DefineShape( const UniformGridGeometry & reference , const ItemT & background )
+        {
+            Clear() ;
+            mMinCorner      = reference.GetMinCorner() ;
+            mCellExtent     = reference.GetCellSpacing() ;
+            mCellsPerExtent = reference.GetCellsPerExtent() ;
+            mBackground     = background ;
+        }
+
+
+        const Vec3 &    GetMinCorner( void ) const          { return mMinCorner ; }
+        const Vec3 &    GetCellSpacing( void ) const        { return mCellExtent ; }
+        const Vec3 &    GetCellsPerExtent( void ) const     { return mCellsPerExtent ; }
+
+
+        /*! \brief Compute indices of the point at the minimal corner of the cell containing a given position
+
+            \param indices - (out) indices of minimal corner of grid cell containing vPosition
+
+            \param vPosition - position of a point.  It can lie anywhere.
+
+        */
+        void IndicesOfPosition( int indices[3] , const Vec3 & vPosition ) const
+        {
+            const Vec3 vPosRel( vPosition - GetMinCorner() ) ;
+            indices[0] = int( floorf( vPosRel.x * GetCellsPerExtent().x ) ) ;
+            indices[1] = int( floorf( vPosRel.y * GetCellsPerExtent().y ) ) ;
+            indices[2] = int( floorf( vPosRel.z * GetCellsPerExtent().z ) ) ;
+        }
+
+
+        /*! \brief Compute position of point with given indices
+        */
+        void PositionFromIndices( Vec3 & vPosition , const int indices[3] ) const
+        {
+            vPosition.x = GetMinCorner().x + float( indices[0] ) * GetCellSpacing().x ;
+            vPosition.y = GetMinCorner().y + float( indices[1] ) * GetCellSpacing().y ;
+            vPosition.z = GetMinCorner().z + float( indices[2] ) * GetCellSpacing().z ;
+        }
+
+
+        /*! \brief Compute position of a point inside a block
+
+            \param vPosition - (out) position of point
+
+            \param block - block that contains the point
+
+            \param offset - offset of point within block
+        */
+        void PositionFromBlockOffset( Vec3 & vPosition , const Block & block , unsigned offset ) const
+        {
+            const int indices[3] = {    ( block.mCoords[0] << BLOCK_SIZE_LOG2 ) + int(   offset                                   & BLOCK_MASK ) ,
+                                        ( block.mCoords[1] << BLOCK_SIZE_LOG2 ) + int( ( offset >>     BLOCK_SIZE_LOG2        ) & BLOCK_MASK ) ,
+                                        ( block.mCoords[2] << BLOCK_SIZE_LOG2 ) + int( ( offset >> ( 2 * BLOCK_SIZE_LOG2 )  ) & BLOCK_MASK ) } ;
+            PositionFromIndices( vPosition , indices ) ;
+        }
+
+
+        /*! \brief Return number of blocks this grid contains
+        */
+        size_t GetNumBlocks( void ) const { return mBlocks.Size() ; }
+
+
+              Block & GetBlock( size_t iBlock )         { return mBlocks[ iBlock ] ; }
+        const Block & GetBlock( size_t iBlock ) const   { return mBlocks[ iBlock ] ; }
+
+
+        /*! \brief Return index of block with given block coordinates, or NOT_FOUND if it does not exist
+        */
+        unsigned FindBlock( const int blockCoords[3] ) const
+        {
+            if( 0 == mBlocks.Size() )
+            {   // Hash table is empty (and might not exist).
+                return NOT_FOUND ;
+            }
+            for( unsigned iSlot = HashOfBlockCoords( blockCoords ) & mNumSlotsMask ; ; iSlot = ( iSlot + 1 ) & mNumSlotsMask )
+            {   // Probe slots until finding the block or an empty slot.
+                const unsigned iBlockPlus1 = mSlots[ iSlot ] ;
+                if( 0 == iBlockPlus1 )
+                {   // Reached empty slot so block does not exist.
+                    return NOT_FOUND ;
+                }
+                const Block & rBlock = mBlocks[ iBlockPlus1 - 1 ] ;
+                if(     ( rBlock.mCoords[0] == blockCoords[0] )
+                    &&  ( rBlock.mCoords[1] == blockCoords[1] )
+                    &&  ( rBlock.mCoords[2] == blockCoords[2] ) )
+                {   // Found block.
+                    return iBlockPlus1 - 1 ;
+                }
+            }
+        }
+
+
+        /*! \brief Return index of block with given block coordinates, creating it if it does not exist
+
+            New blocks contain the background value at every point.
+
+            \note This can reallocate blocks, which invalidates references to them.
+        */
+        unsigned FindOrCreateBlock( const int blockCoords[3] )
+        {
+            const unsigned iExisting = FindBlock( blockCoords ) ;
+            if( iExisting != NOT_FOUND )
+            {   // Block already exists.
+                return iExisting ;
+            }
+
+            if( 2 * ( mBlocks.Size() + 1 ) > mSlots.Size() )
+            {   // Hash table would become more than half full.
+                Rehash( MAX2( 64 , 2 * mSlots.Size() ) ) ;
+            }
+
+            const unsigned iBlock = unsigned( mBlocks.Size() ) ;
+            mBlocks.PushBack( Block() ) ;
+            Block & rBlock = mBlocks.Back() ;
+            rBlock.mCoords[0] = blockCoords[0] ;
+            rBlock.mCoords[1] = blockCoords[1] ;
+            rBlock.mCoords[2] = blockCoords[2] ;
+            for( unsigned offset = 0 ; offset < NUM_POINTS_PER_BLOCK ; ++ offset )
+            {
+                rBlock.mPoints[ offset ] = mBackground ;
+            }
+            InsertIntoSlots( iBlock ) ;
+            return iBlock ;
+        }
+
+
+        /*! \brief Return address of value at point with given indices, or 0 if no block contains it
+
+            \param indices - indices of point
+
+            \param cache - most recently used block.  This routine updates it.
+        */
+        const ItemT * FindPoint( const int indices[3] , BlockCache & cache ) const
+        {
+            int blockCoords[3] ;
+            BlockCoordsOfIndices( blockCoords , indices ) ;
+            if( ! CacheHolds( cache , blockCoords ) )
+            {   // Cache misses so consult hash table.
+                cache.mBlockIndex = FindBlock( blockCoords ) ;
+                if( NOT_FOUND == cache.mBlockIndex )
+                {   // No block contains the point.
+                    return 0 ;
+                }
+            }
+            return & mBlocks[ cache.mBlockIndex ].mPoints[ OffsetWithinBlock( indices ) ] ;
+        }
+
+
+        /*! \brief Return reference to value at point with given indices, creating its block if needed
+        */
+        ItemT & GetOrCreatePoint( const int indices[3] )
+        {
+            int blockCoords[3] ;
+            BlockCoordsOfIndices( blockCoords , indices ) ;
+            const unsigned iBlock = FindOrCreateBlock( blockCoords ) ;
+            return mBlocks[ iBlock ].mPoints[ OffsetWithinBlock( indices ) ] ;
+        }
+
+
+        /*! \brief Create blocks for every corner point of the grid cell containing the given position
+
+            After this, Interpolate at vPosition will read only values stored in blocks.
+        */
+        void AllocateCell( const Vec3 & vPosition )
+        {
+            int indices[3] ;
+            IndicesOfPosition( indices , vPosition ) ;
+            int corner[3] ;
+            for( corner[2] = indices[2] ; corner[2] <= indices[2] + 1 ; ++ corner[2] )
+            for( corner[1] = indices[1] ; corner[1] <= indices[1] + 1 ; ++ corner[1] )
+            for( corner[0] = indices[0] ; corner[0] <= indices[0] + 1 ; ++ corner[0] )
+            {   // For each corner of the cell containing vPosition...
+                int blockCoords[3] ;
+                BlockCoordsOfIndices( blockCoords , corner ) ;
+                FindOrCreateBlock( blockCoords ) ;
+            }
+        }
+
+
+        /*! \brief Interpolate values from grid to get value at given position
+
+            \param vResult - (out) interpolated value at vPosition
+
+            \param vPosition - position to sample.  Corner points which no block contains
+                contribute the background value.
+
+            \param cache - most recently used block.  This routine updates it.
+
+        */
+        void Interpolate( ItemT & vResult , const Vec3 & vPosition , BlockCache & cache ) const
+        {
+            int             indices[3] ; // Indices of grid cell containing position.
+            IndicesOfPosition( indices , vPosition ) ;
+            Vec3            vMinCorner ;
+            PositionFromIndices( vMinCorner , indices ) ;
+            const Vec3      vDiff         = vPosition - vMinCorner ; // Relative location of position within its containing grid cell.
+            const Vec3      tween         = Vec3( vDiff.x * GetCellsPerExtent().x , vDiff.y * GetCellsPerExtent().y , vDiff.z * GetCellsPerExtent().z ) ;
+            const Vec3      oneMinusTween = Vec3( 1.0f , 1.0f , 1.0f ) - tween ;
+            const float     weights[8]    = {   oneMinusTween.x * oneMinusTween.y * oneMinusTween.z ,
+                                                        tween.x * oneMinusTween.y * oneMinusTween.z ,
+                                                oneMinusTween.x *         tween.y * oneMinusTween.z ,
+                                                        tween.x *         tween.y * oneMinusTween.z ,
+                                                oneMinusTween.x * oneMinusTween.y *         tween.z ,
+                                                        tween.x * oneMinusTween.y *         tween.z ,
+                                                oneMinusTween.x *         tween.y *         tween.z ,
+                                                        tween.x *         tween.y *         tween.z } ;
+
+            if(     ( ( indices[0] & BLOCK_MASK ) < BLOCK_MASK )
+                &&  ( ( indices[1] & BLOCK_MASK ) < BLOCK_MASK )
+                &&  ( ( indices[2] & BLOCK_MASK ) < BLOCK_MASK ) )
+            {   // All corners of cell lie in the same block, so look it up once.
+                const ItemT * pX0Y0Z0 = FindPoint( indices , cache ) ;
+                if( 0 == pX0Y0Z0 )
+                {   // No block contains this cell.
+                    vResult = mBackground ;
+                    return ;
+                }
+                static const unsigned numX  = BLOCK_SIZE ;
+                static const unsigned numXY = BLOCK_SIZE * BLOCK_SIZE ;
+                vResult = weights[0] * pX0Y0Z0[ 0                 ]
+                        + weights[1] * pX0Y0Z0[ 1                 ]
+                        + weights[2] * pX0Y0Z0[ numX              ]
+                        + weights[3] * pX0Y0Z0[ numX + 1          ]
+                        + weights[4] * pX0Y0Z0[ numXY             ]
+                        + weights[5] * pX0Y0Z0[ numXY + 1         ]
+                        + weights[6] * pX0Y0Z0[ numXY + numX      ]
+                        + weights[7] * pX0Y0Z0[ numXY + numX + 1  ] ;
+                return ;
+            }
+
+            // Cell straddles blocks, so look up each corner separately.
+            int corner[3] ;
+            unsigned iCorner = 0 ;
+            for( corner[2] = indices[2] ; corner[2] <= indices[2] + 1 ; ++ corner[2] )
+            for( corner[1] = indices[1] ; corner[1] <= indices[1] + 1 ; ++ corner[1] )
+            for( corner[0] = indices[0] ; corner[0] <= indices[0] + 1 ; ++ corner[0] )
+            {   // For each corner of the cell containing vPosition...
+                const ItemT * pCorner = FindPoint( corner , cache ) ;
+                const ItemT & rCorner = pCorner ? * pCorner : mBackground ;
+                if( 0 == iCorner )
+                {
+                    vResult  = weights[ iCorner ] * rCorner ;
+                }
+                else
+                {
+                    vResult += weights[ iCorner ] * rCorner ;
+                }
+                ++ iCorner ;
+            }
+        }
+
+
+        /*! \brief Interpolate values from grid to get value at given position
+
+            \see Interpolate( ItemT & , const Vec3 & , BlockCache & )
+        */
+        void Interpolate( ItemT & vResult , const Vec3 & vPosition ) const
+        {
+            BlockCache cache ;
+            Interpolate( vResult , vPosition , cache ) ;
+        }
+
+
+        /*! \brief Insert given value into grid at given position, creating blocks as needed
+        */
+        void Insert( const Vec3 & vPosition , const ItemT & item )
+        {
+            int             indices[3] ; // Indices of grid cell containing position.
+            IndicesOfPosition( indices , vPosition ) ;
+            Vec3            vMinCorner ;
+            PositionFromIndices( vMinCorner , indices ) ;
+            const Vec3      vDiff         = vPosition - vMinCorner ; // Relative location of position within its containing grid cell.
+            const Vec3      tween         = Vec3( vDiff.x * GetCellsPerExtent().x , vDiff.y * GetCellsPerExtent().y , vDiff.z * GetCellsPerExtent().z ) ;
+            const Vec3      oneMinusTween = Vec3( 1.0f , 1.0f , 1.0f ) - tween ;
+            int             corner[3] ;
+            for( corner[2] = indices[2] ; corner[2] <= indices[2] + 1 ; ++ corner[2] )
+            {
+                const float wz = ( corner[2] == indices[2] ) ? oneMinusTween.z : tween.z ;
+                for( corner[1] = indices[1] ; corner[1] <= indices[1] + 1 ; ++ corner[1] )
+                {
+                    const float wyz = wz * ( ( corner[1] == indices[1] ) ? oneMinusTween.y : tween.y ) ;
+                    for( corner[0] = indices[0] ; corner[0] <= indices[0] + 1 ; ++ corner[0] )
+                    {   // For each corner of the cell containing vPosition...
+                        const float wxyz = wyz * ( ( corner[0] == indices[0] ) ? oneMinusTween.x : tween.x ) ;
+                        GetOrCreatePoint( corner ) += wxyz * item ;
+                    }
+                }
+            }
+        }
+
+
+        /*! \brief Remove all blocks, retaining shape and background value
+        */
+        void Clear( void )
+        {
+            mBlocks.Clear() ;
+            mSlots.Clear() ;
+            mNumSlotsMask = 0 ;
+        }
+
+
+    private:
+        /*! \brief Compute coordinates of block containing the point with the given indices
+
+            \note Arithmetic shift rounds toward negative infinity, so negative indices map to negative blocks.
+        */
+        static void BlockCoordsOfIndices( int blockCoords[3] , const int indices[3] )
+        {
+            blockCoords[0] = indices[0] >> BLOCK_SIZE_LOG2 ;
+            blockCoords[1] = indices[1] >> BLOCK_SIZE_LOG2 ;
+            blockCoords[2] = indices[2] >> BLOCK_SIZE_LOG2 ;
+        }
+
+
+        /*! \brief Compute offset, within its block, of the point with the given indices
+        */
+        static unsigned OffsetWithinBlock( const int indices[3] )
+        {
+            return      unsigned( indices[0] & BLOCK_MASK )
+                    + ( unsigned( indices[1] & BLOCK_MASK ) <<       BLOCK_SIZE_LOG2   )
+                    + ( unsigned( indices[2] & BLOCK_MASK ) << ( 2 * BLOCK_SIZE_LOG2 ) ) ;
+        }
+
+
+        /*! \brief Hash block coordinates into an index, which callers reduce to the size of the table
+        */
+        static unsigned HashOfBlockCoords( const int blockCoords[3] )
+        {
+            return ( unsigned( blockCoords[0] ) * 73856093U ) ^ ( unsigned( blockCoords[1] ) * 19349663U ) ^ ( unsigned( blockCoords[2] ) * 83492791U ) ;
+        }
+
+
+        /*! \brief Return whether the given cache holds the block with the given coordinates
+        */
+        bool CacheHolds( const BlockCache & cache , const int blockCoords[3] ) const
+        {
+            if( cache.mBlockIndex >= mBlocks.Size() )
+            {   // Cache is empty, or refers to a block from before the grid was cleared.
+                return false ;
+            }
+            const Block & rBlock = mBlocks[ cache.mBlockIndex ] ;
+            return  ( rBlock.mCoords[0] == blockCoords[0] )
+                &&  ( rBlock.mCoords[1] == blockCoords[1] )
+                &&  ( rBlock.mCoords[2] == blockCoords[2] ) ;
+        }
+
+
+        /*! \brief Put given block into the first available slot of the hash table
+        */
+        void InsertIntoSlots( unsigned iBlock )
+        {
+            unsigned iSlot = HashOfBlockCoords( mBlocks[ iBlock ].mCoords ) & mNumSlotsMask ;
+            while( mSlots[ iSlot ] != 0 )
+            {   // Slot is occupied so probe next one.
+                iSlot = ( iSlot + 1 ) & mNumSlotsMask ;
+            }
+            mSlots[ iSlot ] = iBlock + 1 ;
+        }
+
+
+        /*! \brief Rebuild hash table with the given number of slots, which must be a power of 2
+        */
+        void Rehash( size_t numSlots )
+        {
+            mSlots.Clear() ;
+            mSlots.Resize( numSlots , 0 ) ;
+            mNumSlotsMask = unsigned( numSlots - 1 ) ;
+            const size_t numBlocks = mBlocks.Size() ;
+            for( unsigned iBlock = 0 ; iBlock < numBlocks ; ++ iBlock )
+            {
+                InsertIntoSlots( iBlock ) ;
+            }
+        }
+
+
+        Vec3                mMinCorner      ;   ///< Position of point with indices {0,0,0}
+        Vec3                mCellExtent     ;   ///< Size (in world units) of a cell.
+        Vec3                mCellsPerExtent ;   ///< Reciprocal of cell size (precomputed once to avoid excess divides).
+        ItemT               mBackground     ;   ///< Value of points which no block contains
+        Vector< Block >     mBlocks         ;   ///< Dynamic array of blocks, in order of creation.
+        Vector< unsigned >  mSlots          ;   ///< Open-addressing hash table.  Each slot holds 1 + index into mBlocks, or 0 if empty.
+        unsigned            mNumSlotsMask   ;   ///< Number of slots in hash table, minus one.
+} ;
+
+// Public variables --------------------------------------------------------------
+// Public functions --------------------------------------------------------------
+
+#endif
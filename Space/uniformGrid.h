@@ -13,6 +13,7 @@
 #include <math.h>
 
 #include "Core/Math/vec3.h"
+#include "Core/Memory/alignedVector.h"
 
 #include "../wrapperMacros.h"
 
@@ -212,6 +213,62 @@ class UniformGridGeometry
 
 
 
+        /*! \brief Define shape to cover a box of cells of another grid, with each of those cells subdivided
+
+            \param src - Source uniform grid whose cells to subdivide
+
+            \param cellMin - indices of minimal cell of src to cover
+
+            \param cellEnd - indices one past the maximal cell of src to cover
+
+            \param iRefinement - number of cells into which to subdivide each cell of src, in each dimension.
+
+            \note Every gridpoint of src within the box coincides with a gridpoint of this grid.
+
+        */
+        void Refine( const UniformGridGeometry & src , const unsigned cellMin[3] , const unsigned cellEnd[3] , unsigned iRefinement )
+        {
+            src.PositionFromIndices( mMinCorner , cellMin ) ;
+            mGridExtent.x       = float( cellEnd[ 0 ] - cellMin[ 0 ] ) * src.GetCellSpacing().x ;
+            mGridExtent.y       = float( cellEnd[ 1 ] - cellMin[ 1 ] ) * src.GetCellSpacing().y ;
+            mGridExtent.z       = float( cellEnd[ 2 ] - cellMin[ 2 ] ) * src.GetCellSpacing().z ;
+            mNumPoints[ 0 ]     = ( cellEnd[ 0 ] - cellMin[ 0 ] ) * iRefinement + 1 ;
+            mNumPoints[ 1 ]     = ( cellEnd[ 1 ] - cellMin[ 1 ] ) * iRefinement + 1 ;
+            mNumPoints[ 2 ]     = ( cellEnd[ 2 ] - cellMin[ 2 ] ) * iRefinement + 1 ;
+            PrecomputeSpacing() ;
+        }
+
+
+
+        /*! \brief Define shape to extend another grid by whole cells beyond its faces
+
+            \param src - Source uniform grid to extend
+
+            \param numCellsBefore - number of cells to add below the minimal corner of src, along each axis
+
+            \param numCells - total number of cells along each axis, which must be at least
+                the number of cells of src plus numCellsBefore.
+
+            \note Every gridpoint of src coincides with a gridpoint of this grid.
+
+        */
+        void Expand( const UniformGridGeometry & src , const unsigned numCellsBefore[3] , const unsigned numCells[3] )
+        {
+            const Vec3 & vSpacing = src.GetCellSpacing() ;
+            mMinCorner.x        = src.GetMinCorner().x - float( numCellsBefore[ 0 ] ) * vSpacing.x ;
+            mMinCorner.y        = src.GetMinCorner().y - float( numCellsBefore[ 1 ] ) * vSpacing.y ;
+            mMinCorner.z        = src.GetMinCorner().z - float( numCellsBefore[ 2 ] ) * vSpacing.z ;
+            mGridExtent.x       = float( numCells[ 0 ] ) * vSpacing.x ;
+            mGridExtent.y       = float( numCells[ 1 ] ) * vSpacing.y ;
+            mGridExtent.z       = float( numCells[ 2 ] ) * vSpacing.z ;
+            mNumPoints[ 0 ]     = numCells[ 0 ] + 1 ;
+            mNumPoints[ 1 ]     = numCells[ 1 ] + 1 ;
+            mNumPoints[ 2 ]     = numCells[ 2 ] + 1 ;
+            PrecomputeSpacing() ;
+        }
+
+
+
         /*! \brief Get world-space dimensions of UniformGridGeometry
         */
         const Vec3 & GetExtent( void ) const { return mGridExtent ; }
@@ -328,7 +385,7 @@ class UniformGridGeometry
 
             \param offset - Offset into mContents.
         */
-        void    IndicesFromOffset( unsigned indices[3] , const unsigned & offset )
+        void    IndicesFromOffset( unsigned indices[3] , const unsigned & offset ) const
         {
             indices[2] = offset / ( GetNumPoints(0) * GetNumPoints(1) ) ;
             indices[1] = ( offset - indices[2] * GetNumPoints(0) * GetNumPoints(1) ) / GetNumPoints(0) ;
@@ -350,7 +407,7 @@ class UniformGridGeometry
             \note Derived class provides actual contents array.
 
         */
-        void    PositionFromOffset( Vec3 & vPos , const unsigned & offset )
+        void    PositionFromOffset( Vec3 & vPos , const unsigned & offset ) const
         {
             unsigned indices[3] ;
             IndicesFromOffset( indices , offset ) ;
@@ -505,6 +562,42 @@ template <class ItemT> class UniformGrid : public UniformGridGeometry
         }
 
 
+        /*! \brief Initialize every element to the given value.
+
+            Use this for grids into which callers accumulate values, such as
+            grids that Insert populates, which must start at zero.
+        */
+        void Init( const ItemT & initialValue )
+        {
+            mContents.Resize( GetGridCapacity() ) ;
+            mContents.Fill( initialValue ) ;
+        }
+
+
+        /*! \brief Reserve memory for contents without initializing them.
+
+            For item types without a user-provided default ctor, such as float
+            and PackedFloat4, Init zeroes the contents but this avoids that
+            pass, so use it for such grids which the caller will completely
+            overwrite before reading.  Vec3 and Mat33 have default ctors that
+            do nothing, so for them Init already costs no pass, and is preferable.
+        */
+        void InitUninitialized( void )
+        {
+            mContents.ResizeUninitialized( GetGridCapacity() ) ;
+        }
+
+
+        /*! \brief Request that contents reside in large pages, when the platform provides them.
+
+            This takes effect the next time contents grow beyond their previous capacity.
+
+            \see AlignedAllocate
+        */
+        void SetLargePages( bool bUseLargePages ) { mContents.SetLargePages( bUseLargePages ) ; }
+        bool GetLargePages( void ) const          { return mContents.GetLargePages() ; }
+
+
         void DefineShape( size_t uNumElements , const Vec3 & vMin , const Vec3 & vMax , bool bPowerOf2 )
         {
             mContents.Clear() ;
@@ -593,6 +686,51 @@ template <class ItemT> class UniformGrid : public UniformGridGeometry
 
 
 
+        /*! \brief Interpolate values from grid, converting each value before blending
+
+            \param vResult - (out) interpolated value
+
+            \param vPosition - position to sample
+
+            \param convert - function object which converts an ItemT into a ResultT.
+                ResultT must support addition, and multiplication by a float.
+
+            This blends the same gridpoints with the same weights as Interpolate.
+            It lets a grid store values in a compact form, such as reduced precision,
+            yet blend them in a wider form, such as float.
+
+        */
+        template< class ResultT , class ConvertT > void InterpolateConverted( ResultT & vResult , const Vec3 & vPosition , const ConvertT & convert ) const
+        {
+            unsigned        indices[3] ; // Indices of grid cell containing position.
+            IndicesOfPosition( indices , vPosition ) ;
+            Vec3            vMinCorner ;
+            PositionFromIndices( vMinCorner , indices ) ;
+            const unsigned  offsetX0Y0Z0 = OffsetFromIndices( indices ) ;
+            const Vec3      vDiff         = vPosition - vMinCorner ; // Relative location of position within its containing grid cell.
+            const Vec3      tween         = Vec3( vDiff.x * GetCellsPerExtent().x , vDiff.y * GetCellsPerExtent().y , vDiff.z * GetCellsPerExtent().z ) ;
+            const Vec3      oneMinusTween = Vec3( 1.0f , 1.0f , 1.0f ) - tween ;
+            const unsigned  numXY         = GetNumPoints( 0 ) * GetNumPoints( 1 ) ;
+            const unsigned  offsetX1Y0Z0  = offsetX0Y0Z0 + 1 ;
+            const unsigned  offsetX0Y1Z0  = offsetX0Y0Z0 + GetNumPoints(0) ;
+            const unsigned  offsetX1Y1Z0  = offsetX0Y0Z0 + GetNumPoints(0) + 1 ;
+            const unsigned  offsetX0Y0Z1  = offsetX0Y0Z0 + numXY ;
+            const unsigned  offsetX1Y0Z1  = offsetX0Y0Z0 + numXY + 1 ;
+            const unsigned  offsetX0Y1Z1  = offsetX0Y0Z0 + numXY + GetNumPoints(0) ;
+            const unsigned  offsetX1Y1Z1  = offsetX0Y0Z0 + numXY + GetNumPoints(0) + 1 ;
+            vResult = convert( (*this)[ offsetX0Y0Z0 ] ) * ( oneMinusTween.x * oneMinusTween.y * oneMinusTween.z )
+                    + convert( (*this)[ offsetX1Y0Z0 ] ) * (         tween.x * oneMinusTween.y * oneMinusTween.z )
+                    + convert( (*this)[ offsetX0Y1Z0 ] ) * ( oneMinusTween.x *         tween.y * oneMinusTween.z )
+                    + convert( (*this)[ offsetX1Y1Z0 ] ) * (         tween.x *         tween.y * oneMinusTween.z )
+                    + convert( (*this)[ offsetX0Y0Z1 ] ) * ( oneMinusTween.x * oneMinusTween.y *         tween.z )
+                    + convert( (*this)[ offsetX1Y0Z1 ] ) * (         tween.x * oneMinusTween.y *         tween.z )
+                    + convert( (*this)[ offsetX0Y1Z1 ] ) * ( oneMinusTween.x *         tween.y *         tween.z )
+                    + convert( (*this)[ offsetX1Y1Z1 ] ) * (         tween.x *         tween.y *         tween.z ) ;
+        }
+
+
+
+
         /*! \brief Insert given value into grid at given position
         */
         void Insert( const Vec3 & vPosition , const ItemT & item )
@@ -635,7 +773,7 @@ template <class ItemT> class UniformGrid : public UniformGridGeometry
 
 
     private:
-        Vector<ItemT>       mContents           ;   ///< 3D array of items.
+        AlignedVector<ItemT>    mContents       ;   ///< 3D array of items, aligned to a cache line.
 } ;
 
 // Public variables --------------------------------------------------------------
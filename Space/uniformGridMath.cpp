@@ -13,37 +13,75 @@
 
 
 
-/*! \brief Compute curl of a vector field, from its Jacobian
+/*! \brief Compute curl of a vector field, from its Jacobian, for a subset of z-slices
 
     \param curl - (output) UniformGrid of 3-vector values.
+                    Caller must have initialized it to the same shape as jacobian.
 
     \param jacobian - UniformGrid of 3x3 matrix values.
 
+    \param izStart - first z index to compute
+
+    \param izEnd - one past the last z index to compute
+
     \see ComputeJacobian.
 
 */
-void ComputeCurlFromJacobian( UniformGrid< Vec3 > & curl , const UniformGrid< Mat33 > & jacobian )
+void ComputeCurlFromJacobian( UniformGrid< Vec3 > & curl , const UniformGrid< Mat33 > & jacobian , size_t izStart , size_t izEnd )
 {
-    const unsigned  dims[3]     = { jacobian.GetNumPoints( 0 ) , jacobian.GetNumPoints( 1 ) , jacobian.GetNumPoints( 2 ) } ;
-    const unsigned  numXY       = dims[0] * dims[1] ;
-    unsigned        index[3] ;
+    const unsigned  numXY       = jacobian.GetNumPoints( 0 ) * jacobian.GetNumPoints( 1 ) ;
+    const unsigned  offsetEnd   = unsigned( izEnd ) * numXY ;
 
     // Compute curl from Jacobian
-    for( index[2] = 0 ; index[2] < dims[2] ; ++ index[2] )
+    for( unsigned offset = unsigned( izStart ) * numXY ; offset < offsetEnd ; ++ offset )
     {
-        const unsigned offsetZ = numXY * index[2]       ;
-        for( index[1] = 0 ; index[1] < dims[1] ; ++ index[1] )
-        {
-            const unsigned offsetYZ = dims[ 0 ] * index[1] + offsetZ ;
-            for( index[0] = 0 ; index[0] < dims[0] ; ++ index[0] )
-            {
-                const unsigned offsetXYZ = index[0] + offsetYZ ;
-                const Mat33 & j     = jacobian[ offsetXYZ ] ;
-                Vec3        & rCurl = curl[ offsetXYZ ] ;
-                // Meaning of j.i.k is the derivative of the kth component with respect to i, i.e. di/dk.
-                rCurl = Vec3( j.y.z - j.z.y , j.z.x - j.x.z , j.x.y - j.y.x ) ;
-            }
-        }
+        const Mat33 & j     = jacobian[ offset ] ;
+        Vec3        & rCurl = curl[ offset ] ;
+        // Meaning of j.i.k is the derivative of the kth component with respect to i, i.e. di/dk.
+        rCurl = Vec3( j.y.z - j.z.y , j.z.x - j.x.z , j.x.y - j.y.x ) ;
+    }
+}
+
+
+
+
+/*! \brief Compute curl of a vector field, from its Jacobian
+
+    \see ComputeCurlFromJacobian( UniformGrid< Vec3 > & , const UniformGrid< Mat33 > & , size_t , size_t )
+
+*/
+void ComputeCurlFromJacobian( UniformGrid< Vec3 > & curl , const UniformGrid< Mat33 > & jacobian )
+{
+    ComputeCurlFromJacobian( curl , jacobian , 0 , jacobian.GetNumPoints( 2 ) ) ;
+}
+
+
+
+
+/*! \brief Compute divergence of a vector field, from its Jacobian, for a subset of z-slices
+
+    \param divergence - (output) UniformGrid of scalar values.
+                    Caller must have initialized it to the same shape as jacobian.
+
+    \param jacobian - UniformGrid of 3x3 matrix values.
+
+    \param izStart - first z index to compute
+
+    \param izEnd - one past the last z index to compute
+
+    \see ComputeJacobian.
+
+*/
+void ComputeDivergenceFromJacobian( UniformGrid< float > & divergence , const UniformGrid< Mat33 > & jacobian , size_t izStart , size_t izEnd )
+{
+    const unsigned  numXY       = jacobian.GetNumPoints( 0 ) * jacobian.GetNumPoints( 1 ) ;
+    const unsigned  offsetEnd   = unsigned( izEnd ) * numXY ;
+
+    for( unsigned offset = unsigned( izStart ) * numXY ; offset < offsetEnd ; ++ offset )
+    {
+        const Mat33 & j = jacobian[ offset ] ;
+        // Divergence is the trace of the Jacobian.
+        divergence[ offset ] = j.x.x + j.y.y + j.z.z ;
     }
 }
 
@@ -109,7 +147,292 @@ void UniformGrid<Mat33>::ComputeStatistics( Mat33 & min , Mat33 & max ) const
 
 
 
-/*! \brief Compute Jacobian of a vector field
+/*! \brief Compute second-order derivative of a vector field along one axis, at one gridpoint
+
+    \param vec - UniformGrid of 3-vector values
+
+    \param offset - offset of gridpoint into vec
+
+    \param index - index of gridpoint along the axis
+
+    \param num - number of gridpoints along the axis
+
+    \param stride - difference in offset between neighbors along the axis
+
+    \param reciprocalSpacing - reciprocal of spacing between gridpoints along the axis
+
+    This uses the same differences as FINITE_DIFFERENCE_CENTRAL2, so higher-order
+    schemes can fall back on it along axes with too few points for their stencils.
+*/
+static Vec3 DifferentiateCentral2( const UniformGrid< Vec3 > & vec , unsigned offset , unsigned index , unsigned num , unsigned stride , float reciprocalSpacing )
+{
+    if( num < 2 )
+    {   // Axis is degenerate, so nothing varies along it.
+        return Vec3( 0.0f , 0.0f , 0.0f ) ;
+    }
+    if( 0 == index )
+    {
+        return ( vec[ offset + stride ] - vec[ offset ] ) * reciprocalSpacing ;
+    }
+    if( num - 1 == index )
+    {
+        return ( vec[ offset ] - vec[ offset - stride ] ) * reciprocalSpacing ;
+    }
+    return ( vec[ offset + stride ] - vec[ offset - stride ] ) * ( 0.5f * reciprocalSpacing ) ;
+}
+
+
+
+
+/*! \brief Compute fourth-order derivative of a vector field along one axis, at one gridpoint
+
+    \see DifferentiateCentral2 for parameters.
+
+    Interior points use the 5-point central stencil.  The two points nearest
+    each face use 5-point one-sided stencils, which are also fourth-order,
+    so accuracy does not degrade near faces.
+*/
+static Vec3 DifferentiateCentral4( const UniformGrid< Vec3 > & vec , unsigned offset , unsigned index , unsigned num , unsigned stride , float reciprocalSpacing )
+{
+    if( num < 5 )
+    {   // Too few points for fourth-order stencils.
+        return DifferentiateCentral2( vec , offset , index , num , stride , reciprocalSpacing ) ;
+    }
+    const float reciprocal12Spacing = reciprocalSpacing * ( 1.0f / 12.0f ) ;
+    if( ( index >= 2 ) && ( index + 2 < num ) )
+    {   // Point is far enough from faces to use central stencil.
+        return ( 8.0f * ( vec[ offset + stride ] - vec[ offset - stride ] ) - ( vec[ offset + 2 * stride ] - vec[ offset - 2 * stride ] ) ) * reciprocal12Spacing ;
+    }
+    if( 0 == index )
+    {
+        return ( -25.0f * vec[ offset ] + 48.0f * vec[ offset + stride ] - 36.0f * vec[ offset + 2 * stride ] + 16.0f * vec[ offset + 3 * stride ] - 3.0f * vec[ offset + 4 * stride ] ) * reciprocal12Spacing ;
+    }
+    if( 1 == index )
+    {
+        return ( -3.0f * vec[ offset - stride ] - 10.0f * vec[ offset ] + 18.0f * vec[ offset + stride ] - 6.0f * vec[ offset + 2 * stride ] + vec[ offset + 3 * stride ] ) * reciprocal12Spacing ;
+    }
+    if( num - 2 == index )
+    {   // Mirror image of the stencil for index 1.
+        return ( 3.0f * vec[ offset + stride ] + 10.0f * vec[ offset ] - 18.0f * vec[ offset - stride ] + 6.0f * vec[ offset - 2 * stride ] - vec[ offset - 3 * stride ] ) * reciprocal12Spacing ;
+    }
+    // Mirror image of the stencil for index 0.
+    return ( 25.0f * vec[ offset ] - 48.0f * vec[ offset - stride ] + 36.0f * vec[ offset - 2 * stride ] - 16.0f * vec[ offset - 3 * stride ] + 3.0f * vec[ offset - 4 * stride ] ) * reciprocal12Spacing ;
+}
+
+
+
+
+/*! \brief Fewest points along a line for which to use the compact stencil
+
+    With 3 points, the face closures make the matrix singular.  Fewer than 5
+    points leave no interior point, so lines that short fall back to second-order.
+*/
+static const unsigned sMinCompactPoints = 5 ;
+
+
+
+
+/*! \brief LU factorization of the tridiagonal matrix of the compact fourth-order derivative stencil
+
+    Interior rows solve f'[i-1] + 4 f'[i] + f'[i+1] = 3 ( f[i+1] - f[i-1] ) / h.
+    Face rows use the third-order closure f'[0] + 2 f'[1] = ( -5 f[0] + 4 f[1] + f[2] ) / 2h,
+    and its mirror image.
+
+    The matrix depends only on the number of points along a line, so each
+    axis factors it once and reuses it for every line along that axis.
+
+    \see DifferentiateCompactLine
+*/
+struct CompactStencil
+{
+    /*! \brief Factor the matrix for lines with the given number of points, which must be at least sMinCompactPoints
+    */
+    void Factor( unsigned num )
+    {
+        mUpper.Resize( num ) ;
+        mReciprocalPivot.Resize( num ) ;
+        // Row 0: diagonal 1, super-diagonal 2.
+        mReciprocalPivot[ 0 ] = 1.0f ;
+        mUpper[ 0 ] = 2.0f ;
+        for( unsigned i = 1 ; i < num - 1 ; ++ i )
+        {   // Interior rows, scaled by 1/4: sub-diagonal 1/4, diagonal 1, super-diagonal 1/4.
+            mReciprocalPivot[ i ] = 1.0f / ( 1.0f - 0.25f * mUpper[ i - 1 ] ) ;
+            mUpper[ i ] = 0.25f * mReciprocalPivot[ i ] ;
+        }
+        // Last row: sub-diagonal 2, diagonal 1.
+        mReciprocalPivot[ num - 1 ] = 1.0f / ( 1.0f - 2.0f * mUpper[ num - 2 ] ) ;
+        mUpper[ num - 1 ] = 0.0f ;
+    }
+
+    Vector< float > mUpper              ;   ///< Super-diagonal of the upper-triangular factor, whose diagonal is 1
+    Vector< float > mReciprocalPivot    ;   ///< Reciprocal of the diagonal of the lower-triangular factor
+} ;
+
+
+
+
+/*! \brief Compute compact fourth-order derivative of a vector field along an entire line of gridpoints
+
+    \param pResult - (output) derivative at each gridpoint along the line
+
+    \param vec - UniformGrid of 3-vector values
+
+    \param offsetStart - offset of first gridpoint of the line into vec
+
+    \param num - number of gridpoints along the line
+
+    \param stride - difference in offset between neighbors along the line
+
+    \param reciprocalSpacing - reciprocal of spacing between gridpoints along the line
+
+    \param stencil - factored matrix for lines with num points
+
+    This uses the Thomas algorithm, i.e. forward elimination then back-substitution.
+*/
+static void DifferentiateCompactLine( Vec3 * pResult , const UniformGrid< Vec3 > & vec , unsigned offsetStart , unsigned num , unsigned stride , float reciprocalSpacing , const CompactStencil & stencil )
+{
+    const unsigned  offsetLast          = offsetStart + ( num - 1 ) * stride ;
+    const float     halfReciprocal      = 0.5f  * reciprocalSpacing ;
+    const float     threeQuarterRecip   = 0.75f * reciprocalSpacing ;
+
+    // Forward elimination.
+    pResult[ 0 ] = ( -5.0f * vec[ offsetStart ] + 4.0f * vec[ offsetStart + stride ] + vec[ offsetStart + 2 * stride ] ) * halfReciprocal ;
+    unsigned offset = offsetStart + stride ;
+    for( unsigned i = 1 ; i < num - 1 ; ++ i , offset += stride )
+    {   // Interior rows, scaled by 1/4.
+        const Vec3 rhs = ( vec[ offset + stride ] - vec[ offset - stride ] ) * threeQuarterRecip ;
+        pResult[ i ] = ( rhs - 0.25f * pResult[ i - 1 ] ) * stencil.mReciprocalPivot[ i ] ;
+    }
+    const Vec3 rhsLast = ( 5.0f * vec[ offsetLast ] - 4.0f * vec[ offsetLast - stride ] - vec[ offsetLast - 2 * stride ] ) * halfReciprocal ;
+    pResult[ num - 1 ] = ( rhsLast - 2.0f * pResult[ num - 2 ] ) * stencil.mReciprocalPivot[ num - 1 ] ;
+
+    // Back-substitution.
+    for( unsigned i = num - 1 ; i > 0 ; -- i )
+    {
+        pResult[ i - 1 ] -= stencil.mUpper[ i - 1 ] * pResult[ i ] ;
+    }
+}
+
+
+
+
+/*! \brief Compute Jacobian of a vector field using fourth-order central differences, for a subset of z-slices
+
+    \see ComputeJacobian( UniformGrid< Mat33 > & , const UniformGrid< Vec3 > & , size_t , size_t , FiniteDifferenceScheme )
+*/
+static void ComputeJacobianCentral4( UniformGrid< Mat33 > & jacobian , const UniformGrid< Vec3 > & vec , size_t izStart , size_t izEnd )
+{
+    const Vec3      spacing                 = vec.GetCellSpacing() ;
+    // Avoid divide-by-zero when z size is effectively 0 (for 2D domains)
+    const Vec3      reciprocalSpacing( 1.0f / spacing.x , 1.0f / spacing.y , spacing.z > FLT_EPSILON ? 1.0f / spacing.z : 0.0f ) ;
+    const unsigned  dims[3]                 = { vec.GetNumPoints( 0 )   , vec.GetNumPoints( 1 )   , vec.GetNumPoints( 2 )   } ;
+    const unsigned  numXY                   = dims[0] * dims[1] ;
+    unsigned        index[3] ;
+
+    for( index[2] = unsigned( izStart ) ; index[2] < izEnd ; ++ index[2] )
+    {
+        const unsigned offsetZ = numXY * index[2] ;
+        for( index[1] = 0 ; index[1] < dims[1] ; ++ index[1] )
+        {
+            const unsigned offsetYZ = dims[0] * index[1] + offsetZ ;
+            for( index[0] = 0 ; index[0] < dims[0] ; ++ index[0] )
+            {
+                const unsigned  offsetXYZ   = index[0] + offsetYZ ;
+                Mat33 &         rMatrix     = jacobian[ offsetXYZ ] ;
+                rMatrix.x = DifferentiateCentral4( vec , offsetXYZ , index[0] , dims[0] , 1       , reciprocalSpacing.x ) ;
+                rMatrix.y = DifferentiateCentral4( vec , offsetXYZ , index[1] , dims[1] , dims[0] , reciprocalSpacing.y ) ;
+                rMatrix.z = DifferentiateCentral4( vec , offsetXYZ , index[2] , dims[2] , numXY   , reciprocalSpacing.z ) ;
+            }
+        }
+    }
+}
+
+
+
+
+/*! \brief Compute Jacobian of a vector field using compact fourth-order differences, for a subset of z-slices
+
+    Derivatives along x and y couple only points within the same slice, but
+    derivatives along z couple every slice, so this solves each whole line
+    along z, and keeps only the requested slices.  Therefore, splitting a
+    grid into many small ranges of slices repeats work along z.
+
+    \see ComputeJacobian( UniformGrid< Mat33 > & , const UniformGrid< Vec3 > & , size_t , size_t , FiniteDifferenceScheme )
+*/
+static void ComputeJacobianCompact4( UniformGrid< Mat33 > & jacobian , const UniformGrid< Vec3 > & vec , size_t izStart , size_t izEnd )
+{
+    const Vec3      spacing                 = vec.GetCellSpacing() ;
+    // Avoid divide-by-zero when z size is effectively 0 (for 2D domains)
+    const Vec3      reciprocalSpacing( 1.0f / spacing.x , 1.0f / spacing.y , spacing.z > FLT_EPSILON ? 1.0f / spacing.z : 0.0f ) ;
+    const unsigned  dims[3]                 = { vec.GetNumPoints( 0 )   , vec.GetNumPoints( 1 )   , vec.GetNumPoints( 2 )   } ;
+    const unsigned  numXY                   = dims[0] * dims[1] ;
+    const unsigned  strides[3]              = { 1 , dims[0] , numXY } ;
+    CompactStencil  stencils[3] ;
+    Vector< Vec3 >  line ;
+    line.Resize( MAX2( dims[0] , MAX2( dims[1] , dims[2] ) ) ) ;
+    for( unsigned axis = 0 ; axis < 3 ; ++ axis )
+    {
+        if( dims[ axis ] >= sMinCompactPoints )
+        {
+            stencils[ axis ].Factor( dims[ axis ] ) ;
+        }
+    }
+    unsigned index[3] ;
+
+    // Differentiate along x and y, one slice at a time.
+    for( index[2] = unsigned( izStart ) ; index[2] < izEnd ; ++ index[2] )
+    {
+        const unsigned offsetZ = numXY * index[2] ;
+        for( index[1] = 0 ; index[1] < dims[1] ; ++ index[1] )
+        {   // For each line along x in this slice...
+            const unsigned offsetYZ = dims[0] * index[1] + offsetZ ;
+            if( dims[0] >= sMinCompactPoints )
+            {
+                DifferentiateCompactLine( & line[ 0 ] , vec , offsetYZ , dims[0] , strides[0] , reciprocalSpacing.x , stencils[0] ) ;
+            }
+            for( index[0] = 0 ; index[0] < dims[0] ; ++ index[0] )
+            {
+                jacobian[ index[0] + offsetYZ ].x = ( dims[0] >= sMinCompactPoints ) ? line[ index[0] ] : DifferentiateCentral2( vec , index[0] + offsetYZ , index[0] , dims[0] , strides[0] , reciprocalSpacing.x ) ;
+            }
+        }
+        for( index[0] = 0 ; index[0] < dims[0] ; ++ index[0] )
+        {   // For each line along y in this slice...
+            const unsigned offsetXZ = index[0] + offsetZ ;
+            if( dims[1] >= sMinCompactPoints )
+            {
+                DifferentiateCompactLine( & line[ 0 ] , vec , offsetXZ , dims[1] , strides[1] , reciprocalSpacing.y , stencils[1] ) ;
+            }
+            for( index[1] = 0 ; index[1] < dims[1] ; ++ index[1] )
+            {
+                const unsigned offsetXYZ = offsetXZ + dims[0] * index[1] ;
+                jacobian[ offsetXYZ ].y = ( dims[1] >= sMinCompactPoints ) ? line[ index[1] ] : DifferentiateCentral2( vec , offsetXYZ , index[1] , dims[1] , strides[1] , reciprocalSpacing.y ) ;
+            }
+        }
+    }
+
+    // Differentiate along z, one whole line at a time.
+    for( index[1] = 0 ; index[1] < dims[1] ; ++ index[1] )
+    {
+        for( index[0] = 0 ; index[0] < dims[0] ; ++ index[0] )
+        {   // For each line along z...
+            const unsigned offsetXY = index[0] + dims[0] * index[1] ;
+            if( dims[2] >= sMinCompactPoints )
+            {
+                DifferentiateCompactLine( & line[ 0 ] , vec , offsetXY , dims[2] , strides[2] , reciprocalSpacing.z , stencils[2] ) ;
+            }
+            for( index[2] = unsigned( izStart ) ; index[2] < izEnd ; ++ index[2] )
+            {
+                const unsigned offsetXYZ = offsetXY + numXY * index[2] ;
+                jacobian[ offsetXYZ ].z = ( dims[2] >= sMinCompactPoints ) ? line[ index[2] ] : DifferentiateCentral2( vec , offsetXYZ , index[2] , dims[2] , strides[2] , reciprocalSpacing.z ) ;
+            }
+        }
+    }
+}
+
+
+
+
+/*! \brief Compute Jacobian of a vector field, for a subset of z-slices
 
     \param jacobian - (output) UniformGrid of 3x3 matrix values.
                         The matrix is a vector of vectors.
@@ -121,9 +444,33 @@ void UniformGrid<Mat33>::ComputeStatistics( Mat33 & min , Mat33 & max ) const
 
     \param vec - UniformGrid of 3-vector values
 
+    \param izStart - first z index to compute
+
+    \param izEnd - one past the last z index to compute
+
+    \param scheme - finite difference stencil to use
+
+    With FINITE_DIFFERENCE_CENTRAL2, interior points use central differences,
+    and boundary points use one-sided differences along axes where a neighbor
+    is missing.  Other schemes are more accurate but cost more per point.
+
+    Each slice reads only vec and writes only its own slices of jacobian,
+    so callers can process disjoint ranges of z concurrently.
+
 */
-void ComputeJacobian( UniformGrid< Mat33 > & jacobian , const UniformGrid< Vec3 > & vec )
+void ComputeJacobian( UniformGrid< Mat33 > & jacobian , const UniformGrid< Vec3 > & vec , size_t izStart , size_t izEnd , FiniteDifferenceScheme scheme )
 {
+    if( FINITE_DIFFERENCE_CENTRAL4 == scheme )
+    {
+        ComputeJacobianCentral4( jacobian , vec , izStart , izEnd ) ;
+        return ;
+    }
+    else if( FINITE_DIFFERENCE_COMPACT4 == scheme )
+    {
+        ComputeJacobianCompact4( jacobian , vec , izStart , izEnd ) ;
+        return ;
+    }
+
     const Vec3      spacing                 = vec.GetCellSpacing() ;
     // Avoid divide-by-zero when z size is effectively 0 (for 2D domains)
     const Vec3      reciprocalSpacing( 1.0f / spacing.x , 1.0f / spacing.y , spacing.z > FLT_EPSILON ? 1.0f / spacing.z : 0.0f ) ;
@@ -154,33 +501,7 @@ void ComputeJacobian( UniformGrid< Mat33 > & jacobian , const UniformGrid< Vec3
     const unsigned offsetX0Y0ZM = index[0]     + offsetY0ZM ;   \
     const unsigned offsetX0Y0ZP = index[0]     + offsetY0ZP ;
 
-    // Compute derivatives for interior (i.e. away from boundaries).
-    for( index[2] = 1 ; index[2] < dimsMinus1[2] ; ++ index[2] )
-    {
-        ASSIGN_Z_OFFSETS ;
-        for( index[1] = 1 ; index[1] < dimsMinus1[1] ; ++ index[1] )
-        {
-            ASSIGN_YZ_OFFSETS ;
-            for( index[0] = 1 ; index[0] < dimsMinus1[0] ; ++ index[0] )
-            {
-                ASSIGN_XYZ_OFFSETS ;
-
-                Mat33 & rMatrix = jacobian[ offsetX0Y0Z0 ] ;
-                /* Compute d/dx */
-                rMatrix.x = ( vec[ offsetXPY0Z0 ] - vec[ offsetXMY0Z0 ] ) * halfReciprocalSpacing.x ;
-                /* Compute d/dy */
-                rMatrix.y = ( vec[ offsetX0YPZ0 ] - vec[ offsetX0YMZ0 ] ) * halfReciprocalSpacing.y ;
-                /* Compute d/dz */
-                rMatrix.z = ( vec[ offsetX0Y0ZP ] - vec[ offsetX0Y0ZM ] ) * halfReciprocalSpacing.z ;
-            }
-        }
-    }
-
-    // Compute derivatives for boundaries: 6 faces of box.
-    // In some situations, these macros compute extraneous data.
-    // A tiny bit more efficiency could be squeezed from this routine,
-    // but it turns out to be well under 1% of the total expense.
-
+    // Near boundaries, a one-sided difference replaces the central difference along each axis where a neighbor is missing.
 #define COMPUTE_FINITE_DIFF                                                                                                             \
     Mat33 & rMatrix = jacobian[ offsetX0Y0Z0 ] ;                                                                                        \
     if( index[0] == 0 )                     { rMatrix.x = ( vec[ offsetXPY0Z0 ] - vec[ offsetX0Y0Z0 ] ) * reciprocalSpacing.x ;     }   \
@@ -193,100 +514,497 @@ void ComputeJacobian( UniformGrid< Mat33 > & jacobian , const UniformGrid< Vec3
     else if( index[2] == dimsMinus1[2] )    { rMatrix.z = ( vec[ offsetX0Y0Z0 ] - vec[ offsetX0Y0ZM ] ) * reciprocalSpacing.z ;     }   \
     else                                    { rMatrix.z = ( vec[ offsetX0Y0ZP ] - vec[ offsetX0Y0ZM ] ) * halfReciprocalSpacing.z ; }
 
-    // Compute derivatives for -X boundary.
-    index[0] = 0 ;
-    for( index[2] = 0 ; index[2] < dims[2] ; ++ index[2] )
+    for( index[2] = unsigned( izStart ) ; index[2] < izEnd ; ++ index[2] )
     {
         ASSIGN_Z_OFFSETS ;
+        const bool isInteriorZ = ( index[2] > 0 ) && ( index[2] < dimsMinus1[2] ) ;
         for( index[1] = 0 ; index[1] < dims[1] ; ++ index[1] )
         {
             ASSIGN_YZ_OFFSETS ;
+            const bool isInteriorYZ = isInteriorZ && ( index[1] > 0 ) && ( index[1] < dimsMinus1[1] ) ;
+            for( index[0] = 0 ; index[0] < dims[0] ; ++ index[0] )
             {
                 ASSIGN_XYZ_OFFSETS ;
-                COMPUTE_FINITE_DIFF ;
+                if( isInteriorYZ && ( index[0] > 0 ) && ( index[0] < dimsMinus1[0] ) )
+                {   // Point is in interior (i.e. away from boundaries).
+                    Mat33 & rMatrix = jacobian[ offsetX0Y0Z0 ] ;
+                    /* Compute d/dx */
+                    rMatrix.x = ( vec[ offsetXPY0Z0 ] - vec[ offsetXMY0Z0 ] ) * halfReciprocalSpacing.x ;
+                    /* Compute d/dy */
+                    rMatrix.y = ( vec[ offsetX0YPZ0 ] - vec[ offsetX0YMZ0 ] ) * halfReciprocalSpacing.y ;
+                    /* Compute d/dz */
+                    rMatrix.z = ( vec[ offsetX0Y0ZP ] - vec[ offsetX0Y0ZM ] ) * halfReciprocalSpacing.z ;
+                }
+                else
+                {   // Point lies on a face of the box.
+                    COMPUTE_FINITE_DIFF ;
+                }
             }
         }
     }
 
-    // Compute derivatives for -Y boundary.
-    index[1] = 0 ;
-    for( index[2] = 0 ; index[2] < dims[2] ; ++ index[2] )
+#undef COMPUTE_FINITE_DIFF
+#undef ASSIGN_XYZ_OFFSETS
+#undef ASSIGN_YZ_OFFSETS
+#undef ASSIGN_Z_OFFSETS
+
+}
+
+
+
+
+/*! \brief Compute Jacobian of a vector field
+
+    \see ComputeJacobian( UniformGrid< Mat33 > & , const UniformGrid< Vec3 > & , size_t , size_t , FiniteDifferenceScheme )
+
+*/
+void ComputeJacobian( UniformGrid< Mat33 > & jacobian , const UniformGrid< Vec3 > & vec , FiniteDifferenceScheme scheme )
+{
+    ComputeJacobian( jacobian , vec , 0 , vec.GetNumPoints( 2 ) , scheme ) ;
+}
+
+
+
+
+/*! \brief Compute Laplacian of a vector field, for a subset of z-slices
+
+    \param laplacian - (output) UniformGrid of 3-vector values.
+                        Caller must have initialized it to the same shape as vec.
+
+    \param vec - UniformGrid of 3-vector values
+
+    \param izStart - first z index to compute
+
+    \param izEnd - one past the last z index to compute
+
+    This uses the 7-point stencil.  At the domain boundary, the missing
+    neighbor takes the value at the boundary point itself, which amounts to
+    a zero-flux (Neumann) condition, so diffusion neither creates nor destroys
+    the total of the field.
+
+    Each slice reads only vec and writes only its own slices of laplacian,
+    so callers can process disjoint ranges of z concurrently.
+
+*/
+void ComputeLaplacian( UniformGrid< Vec3 > & laplacian , const UniformGrid< Vec3 > & vec , size_t izStart , size_t izEnd )
+{
+    const Vec3      spacing                 = vec.GetCellSpacing() ;
+    // Avoid divide-by-zero when any size is effectively 0 (for 2D domains)
+    const Vec3      reciprocalSpacing2( spacing.x > FLT_EPSILON ? 1.0f / POW2( spacing.x ) : 0.0f
+                                      , spacing.y > FLT_EPSILON ? 1.0f / POW2( spacing.y ) : 0.0f
+                                      , spacing.z > FLT_EPSILON ? 1.0f / POW2( spacing.z ) : 0.0f ) ;
+    const unsigned  dims[3]                 = { vec.GetNumPoints( 0 )   , vec.GetNumPoints( 1 )   , vec.GetNumPoints( 2 )   } ;
+    const unsigned  dimsMinus1[3]           = { vec.GetNumPoints( 0 )-1 , vec.GetNumPoints( 1 )-1 , vec.GetNumPoints( 2 )-1 } ;
+    const unsigned  numXY                   = dims[0] * dims[1] ;
+    unsigned        index[3] ;
+
+    for( index[2] = unsigned( izStart ) ; index[2] < izEnd ; ++ index[2] )
     {
-        ASSIGN_Z_OFFSETS ;
+        const unsigned offsetZ0 = numXY * index[2] ;
+        const unsigned offsetZM = index[2] > 0              ? offsetZ0 - numXY : offsetZ0 ;
+        const unsigned offsetZP = index[2] < dimsMinus1[2]  ? offsetZ0 + numXY : offsetZ0 ;
+        for( index[1] = 0 ; index[1] < dims[1] ; ++ index[1] )
         {
-            ASSIGN_YZ_OFFSETS ;
+            const unsigned offsetY0 = dims[0] * index[1] ;
+            const unsigned offsetYM = index[1] > 0              ? offsetY0 - dims[0] : offsetY0 ;
+            const unsigned offsetYP = index[1] < dimsMinus1[1]  ? offsetY0 + dims[0] : offsetY0 ;
             for( index[0] = 0 ; index[0] < dims[0] ; ++ index[0] )
             {
-                ASSIGN_XYZ_OFFSETS ;
-                COMPUTE_FINITE_DIFF ;
+                const unsigned  offsetX0Y0Z0    = index[0] + offsetY0 + offsetZ0 ;
+                const unsigned  offsetXMY0Z0    = ( index[0] > 0             ? index[0] - 1 : index[0] ) + offsetY0 + offsetZ0 ;
+                const unsigned  offsetXPY0Z0    = ( index[0] < dimsMinus1[0] ? index[0] + 1 : index[0] ) + offsetY0 + offsetZ0 ;
+                const Vec3 &    vCenter         = vec[ offsetX0Y0Z0 ] ;
+                const Vec3      vCenterTimes2   = 2.0f * vCenter ;
+                laplacian[ offsetX0Y0Z0 ] = ( vec[ offsetXPY0Z0 ] + vec[ offsetXMY0Z0 ] - vCenterTimes2 ) * reciprocalSpacing2.x
+                                          + ( vec[ index[0] + offsetYP + offsetZ0 ] + vec[ index[0] + offsetYM + offsetZ0 ] - vCenterTimes2 ) * reciprocalSpacing2.y
+                                          + ( vec[ index[0] + offsetY0 + offsetZP ] + vec[ index[0] + offsetY0 + offsetZM ] - vCenterTimes2 ) * reciprocalSpacing2.z ;
             }
         }
     }
+}
+
+
+
+
+/*! \brief Compute Laplacian of a vector field
+
+    \see ComputeLaplacian( UniformGrid< Vec3 > & , const UniformGrid< Vec3 > & , size_t , size_t )
 
-    // Compute derivatives for -Z boundary.
-    index[2] = 0 ;
+*/
+void ComputeLaplacian( UniformGrid< Vec3 > & laplacian , const UniformGrid< Vec3 > & vec )
+{
+    ComputeLaplacian( laplacian , vec , 0 , vec.GetNumPoints( 2 ) ) ;
+}
+
+
+
+
+/*! \brief Apply the backward-Euler diffusion operator to a vector field, for a subset of z-slices
+
+    This computes result = ( 1 - diffusivityTimesStep * Laplacian ) vec, using
+    the same stencil and zero-flux boundaries as ComputeLaplacian.  That operator
+    is symmetric and positive definite, so conjugate gradients can invert it.
+
+    \param result - (output) operator applied to vec.  Caller must have initialized it to the same shape as vec.
+
+    \param vec - UniformGrid of 3-vector values
+
+    \param diffusivityTimesStep - product of diffusivity (e.g. viscosity) and time step
+
+    \param sliceDots - (output) for each z-slice computed, sum over its gridpoints of vec * result.
+        Caller must have sized this to the number of z-slices.
+
+    \param izStart - first z index to compute
+
+    \param izEnd - one past the last z index to compute
+
+    \see VortonSim::SolveDiffusionConjugateGradient
+
+*/
+void ApplyDiffusionOperator( UniformGrid< Vec3 > & result , const UniformGrid< Vec3 > & vec , float diffusivityTimesStep , Vector< double > & sliceDots , size_t izStart , size_t izEnd )
+{
+    const Vec3      spacing                 = vec.GetCellSpacing() ;
+    const Vec3      coefficient( spacing.x > FLT_EPSILON ? diffusivityTimesStep / POW2( spacing.x ) : 0.0f
+                               , spacing.y > FLT_EPSILON ? diffusivityTimesStep / POW2( spacing.y ) : 0.0f
+                               , spacing.z > FLT_EPSILON ? diffusivityTimesStep / POW2( spacing.z ) : 0.0f ) ;
+    const unsigned  dims[3]                 = { vec.GetNumPoints( 0 )   , vec.GetNumPoints( 1 )   , vec.GetNumPoints( 2 )   } ;
+    const unsigned  dimsMinus1[3]           = { vec.GetNumPoints( 0 )-1 , vec.GetNumPoints( 1 )-1 , vec.GetNumPoints( 2 )-1 } ;
+    const unsigned  numXY                   = dims[0] * dims[1] ;
+    unsigned        index[3] ;
+
+    for( index[2] = unsigned( izStart ) ; index[2] < izEnd ; ++ index[2] )
     {
-        ASSIGN_Z_OFFSETS ;
+        const unsigned  offsetZ0    = numXY * index[2] ;
+        const bool      hasZM       = index[2] > 0 ;
+        const bool      hasZP       = index[2] < dimsMinus1[2] ;
+        double          sliceDot    = 0.0 ;
         for( index[1] = 0 ; index[1] < dims[1] ; ++ index[1] )
         {
-            ASSIGN_YZ_OFFSETS ;
+            const unsigned  offsetY0Z0  = dims[0] * index[1] + offsetZ0 ;
+            const bool      hasYM       = index[1] > 0 ;
+            const bool      hasYP       = index[1] < dimsMinus1[1] ;
             for( index[0] = 0 ; index[0] < dims[0] ; ++ index[0] )
             {
-                ASSIGN_XYZ_OFFSETS ;
-                COMPUTE_FINITE_DIFF ;
+                const unsigned  offsetX0Y0Z0    = index[0] + offsetY0Z0 ;
+                const Vec3 &    vCenter         = vec[ offsetX0Y0Z0 ] ;
+                // Missing neighbors (beyond the boundary) mirror the center value, so contribute nothing.
+                Vec3            vResult         = vCenter ;
+                if( index[0] > 0 )              { vResult -= coefficient.x * ( vec[ offsetX0Y0Z0 - 1       ] - vCenter ) ; }
+                if( index[0] < dimsMinus1[0] )  { vResult -= coefficient.x * ( vec[ offsetX0Y0Z0 + 1       ] - vCenter ) ; }
+                if( hasYM )                     { vResult -= coefficient.y * ( vec[ offsetX0Y0Z0 - dims[0] ] - vCenter ) ; }
+                if( hasYP )                     { vResult -= coefficient.y * ( vec[ offsetX0Y0Z0 + dims[0] ] - vCenter ) ; }
+                if( hasZM )                     { vResult -= coefficient.z * ( vec[ offsetX0Y0Z0 - numXY   ] - vCenter ) ; }
+                if( hasZP )                     { vResult -= coefficient.z * ( vec[ offsetX0Y0Z0 + numXY   ] - vCenter ) ; }
+                result[ offsetX0Y0Z0 ] = vResult ;
+                sliceDot += vCenter * vResult ;
             }
         }
+        sliceDots[ index[2] ] = sliceDot ;
     }
+}
 
-    // Compute derivatives for +X boundary.
-    index[0] = dimsMinus1[0] ;
-    for( index[2] = 0 ; index[2] < dims[2] ; ++ index[2] )
+
+
+
+/*! \brief Advance the solution and residual of a conjugate-gradient solve along a search direction, for a subset of z-slices
+
+    This computes soln += alpha * direction and residual -= alpha * operatorTimesDirection.
+
+    \param soln - (in/out) estimate of the solution
+
+    \param residual - (in/out) residual of soln
+
+    \param direction - search direction
+
+    \param operatorTimesDirection - operator applied to direction, which ApplyDiffusionOperator computed
+
+    \param alpha - distance to move along direction
+
+    \param sliceDots - (output) for each z-slice computed, sum over its gridpoints of the squared updated residual.
+        Caller must have sized this to the number of z-slices.
+
+    \param izStart - first z index to compute
+
+    \param izEnd - one past the last z index to compute
+
+    \see VortonSim::SolveDiffusionConjugateGradient
+
+*/
+void UpdateConjugateGradientSolution( UniformGrid< Vec3 > & soln , UniformGrid< Vec3 > & residual , const UniformGrid< Vec3 > & direction , const UniformGrid< Vec3 > & operatorTimesDirection , float alpha , Vector< double > & sliceDots , size_t izStart , size_t izEnd )
+{
+    const unsigned numXY = soln.GetNumPoints( 0 ) * soln.GetNumPoints( 1 ) ;
+    for( size_t iz = izStart ; iz < izEnd ; ++ iz )
     {
-        ASSIGN_Z_OFFSETS ;
-        for( index[1] = 0 ; index[1] < dims[1] ; ++ index[1] )
+        const unsigned  offsetEnd   = numXY * unsigned( iz + 1 ) ;
+        double          sliceDot    = 0.0 ;
+        for( unsigned offset = numXY * unsigned( iz ) ; offset < offsetEnd ; ++ offset )
         {
-            ASSIGN_YZ_OFFSETS ;
+            soln[ offset ]      += alpha * direction[ offset ] ;
+            residual[ offset ]  -= alpha * operatorTimesDirection[ offset ] ;
+            sliceDot += residual[ offset ] * residual[ offset ] ;
+        }
+        sliceDots[ iz ] = sliceDot ;
+    }
+}
+
+
+
+
+/*! \brief Compute the next search direction of a conjugate-gradient solve, for a subset of z-slices
+
+    This computes direction = residual + beta * direction.
+
+    \param direction - (in/out) search direction
+
+    \param residual - residual of current estimate of the solution
+
+    \param beta - weight of previous search direction.  Zero starts a new sequence of directions,
+        in which case direction must hold finite values, e.g. zero.
+
+    \param izStart - first z index to compute
+
+    \param izEnd - one past the last z index to compute
+
+    \see VortonSim::SolveDiffusionConjugateGradient
+
+*/
+void UpdateConjugateGradientDirection( UniformGrid< Vec3 > & direction , const UniformGrid< Vec3 > & residual , float beta , size_t izStart , size_t izEnd )
+{
+    const unsigned numXY        = direction.GetNumPoints( 0 ) * direction.GetNumPoints( 1 ) ;
+    const unsigned offsetBegin  = numXY * unsigned( izStart ) ;
+    const unsigned offsetEnd    = numXY * unsigned( izEnd ) ;
+    for( unsigned offset = offsetBegin ; offset < offsetEnd ; ++ offset )
+    {
+        direction[ offset ] = residual[ offset ] + beta * direction[ offset ] ;
+    }
+}
+
+
+
+
+/*! \brief Perform one half-sweep of red-black Gauss-Seidel relaxation of a vector Poisson equation, for a subset of z-slices
+
+    This relaxes Laplacian( soln ) = rhs, using the 7-point stencil,
+    at interior gridpoints whose index sum has the given parity.
+    Boundary gridpoints keep their values, which amounts to a Dirichlet condition.
+
+    \param soln - (in/out) estimate of the solution, which this improves in place
+
+    \param rhs - right-hand side of the Poisson equation
+
+    \param color - parity, 0 or 1, of the sum of indices of gridpoints to update
+
+    \param izStart - first z index to compute
+
+    \param izEnd - one past the last z index to compute
+
+    Gridpoints of one color depend only on gridpoints of the other color,
+    so callers can process disjoint ranges of z concurrently.
+    Call this for color 0 then color 1 to make one full Gauss-Seidel sweep.
+
+*/
+void SolvePoissonRedBlack( UniformGrid< Vec3 > & soln , const UniformGrid< Vec3 > & rhs , unsigned color , size_t izStart , size_t izEnd )
+{
+    const Vec3      spacing                 = soln.GetCellSpacing() ;
+    const Vec3      reciprocalSpacing2( 1.0f / POW2( spacing.x ) , 1.0f / POW2( spacing.y ) , 1.0f / POW2( spacing.z ) ) ;
+    const float     oneOverDiagonal         = 1.0f / ( 2.0f * ( reciprocalSpacing2.x + reciprocalSpacing2.y + reciprocalSpacing2.z ) ) ;
+    const unsigned  dims[3]                 = { soln.GetNumPoints( 0 )   , soln.GetNumPoints( 1 )   , soln.GetNumPoints( 2 )   } ;
+    const unsigned  dimsMinus1[3]           = { soln.GetNumPoints( 0 )-1 , soln.GetNumPoints( 1 )-1 , soln.GetNumPoints( 2 )-1 } ;
+    const unsigned  numXY                   = dims[0] * dims[1] ;
+    unsigned        index[3] ;
+
+    for( index[2] = MAX2( 1u , unsigned( izStart ) ) ; ( index[2] < izEnd ) && ( index[2] < dimsMinus1[2] ) ; ++ index[2] )
+    {
+        const unsigned offsetZ0 = numXY * index[2] ;
+        for( index[1] = 1 ; index[1] < dimsMinus1[1] ; ++ index[1] )
+        {
+            const unsigned offsetY0Z0   = dims[0] * index[1] + offsetZ0 ;
+            // Start at the first interior gridpoint along x with the requested parity.
+            const unsigned ixStart      = 1 + ( ( 1 + index[1] + index[2] + color ) & 1 ) ;
+            for( index[0] = ixStart ; index[0] < dimsMinus1[0] ; index[0] += 2 )
             {
-                ASSIGN_XYZ_OFFSETS ;
-                COMPUTE_FINITE_DIFF ;
+                const unsigned  offsetX0Y0Z0    = index[0] + offsetY0Z0 ;
+                const Vec3      vNeighborSum    = ( soln[ offsetX0Y0Z0 - 1       ] + soln[ offsetX0Y0Z0 + 1       ] ) * reciprocalSpacing2.x
+                                                + ( soln[ offsetX0Y0Z0 - dims[0] ] + soln[ offsetX0Y0Z0 + dims[0] ] ) * reciprocalSpacing2.y
+                                                + ( soln[ offsetX0Y0Z0 - numXY   ] + soln[ offsetX0Y0Z0 + numXY   ] ) * reciprocalSpacing2.z ;
+                soln[ offsetX0Y0Z0 ] = ( vNeighborSum - rhs[ offsetX0Y0Z0 ] ) * oneOverDiagonal ;
             }
         }
     }
+}
 
 
-    // Compute derivatives for +Y boundary.
-    index[1] = dimsMinus1[1] ;
-    for( index[2] = 0 ; index[2] < dims[2] ; ++ index[2] )
+
+
+/*! \brief Compute residual of a vector Poisson equation, for a subset of z-slices
+
+    \param residual - (output) rhs - Laplacian( soln ) at interior gridpoints, and zero at boundary gridpoints.
+                        Caller must have initialized it to the same shape as soln.
+
+    \param soln - estimate of the solution
+
+    \param rhs - right-hand side of the Poisson equation
+
+    \param izStart - first z index to compute
+
+    \param izEnd - one past the last z index to compute
+
+    \see SolvePoissonRedBlack
+
+*/
+void ComputePoissonResidual( UniformGrid< Vec3 > & residual , const UniformGrid< Vec3 > & soln , const UniformGrid< Vec3 > & rhs , size_t izStart , size_t izEnd )
+{
+    const Vec3      spacing                 = soln.GetCellSpacing() ;
+    const Vec3      reciprocalSpacing2( 1.0f / POW2( spacing.x ) , 1.0f / POW2( spacing.y ) , 1.0f / POW2( spacing.z ) ) ;
+    const unsigned  dims[3]                 = { soln.GetNumPoints( 0 )   , soln.GetNumPoints( 1 )   , soln.GetNumPoints( 2 )   } ;
+    const unsigned  dimsMinus1[3]           = { soln.GetNumPoints( 0 )-1 , soln.GetNumPoints( 1 )-1 , soln.GetNumPoints( 2 )-1 } ;
+    const unsigned  numXY                   = dims[0] * dims[1] ;
+    unsigned        index[3] ;
+
+    for( index[2] = unsigned( izStart ) ; index[2] < izEnd ; ++ index[2] )
     {
-        ASSIGN_Z_OFFSETS ;
+        const unsigned  offsetZ0    = numXY * index[2] ;
+        const bool      interiorZ   = ( index[2] > 0 ) && ( index[2] < dimsMinus1[2] ) ;
+        for( index[1] = 0 ; index[1] < dims[1] ; ++ index[1] )
         {
-            ASSIGN_YZ_OFFSETS ;
+            const unsigned  offsetY0Z0  = dims[0] * index[1] + offsetZ0 ;
+            const bool      interiorYZ  = interiorZ && ( index[1] > 0 ) && ( index[1] < dimsMinus1[1] ) ;
             for( index[0] = 0 ; index[0] < dims[0] ; ++ index[0] )
             {
-                ASSIGN_XYZ_OFFSETS ;
-                COMPUTE_FINITE_DIFF ;
+                const unsigned  offsetX0Y0Z0    = index[0] + offsetY0Z0 ;
+                if( ! interiorYZ || ( 0 == index[0] ) || ( dimsMinus1[0] == index[0] ) )
+                {   // Gridpoint lies on boundary, where solution is given.
+                    residual[ offsetX0Y0Z0 ] = Vec3( 0.0f , 0.0f , 0.0f ) ;
+                    continue ;
+                }
+                const Vec3 &    vCenter         = soln[ offsetX0Y0Z0 ] ;
+                const Vec3      vCenterTimes2   = 2.0f * vCenter ;
+                const Vec3      vLaplacian      = ( soln[ offsetX0Y0Z0 - 1       ] + soln[ offsetX0Y0Z0 + 1       ] - vCenterTimes2 ) * reciprocalSpacing2.x
+                                                + ( soln[ offsetX0Y0Z0 - dims[0] ] + soln[ offsetX0Y0Z0 + dims[0] ] - vCenterTimes2 ) * reciprocalSpacing2.y
+                                                + ( soln[ offsetX0Y0Z0 - numXY   ] + soln[ offsetX0Y0Z0 + numXY   ] - vCenterTimes2 ) * reciprocalSpacing2.z ;
+                residual[ offsetX0Y0Z0 ] = rhs[ offsetX0Y0Z0 ] - vLaplacian ;
             }
         }
     }
+}
+
+
+
+
+/*! \brief Transfer a field to a grid with half as many cells along each axis, using full weighting, for a subset of z-slices
 
-    // Compute derivatives for +Z boundary.
-    index[2] = dimsMinus1[2] ;
+    \param coarse - (output) coarse field.  Caller must have initialized it to have
+                        half as many cells as fine, along each axis, over the same region.
+                        This assigns zero at its boundary gridpoints.
+
+    \param fine - fine field.  Its number of cells along each axis must be even.
+
+    \param izStart - first z index of coarse to compute
+
+    \param izEnd - one past the last z index of coarse to compute
+
+    Each interior coarse gridpoint takes the average of the 27 fine gridpoints
+    around the one it coincides with, weighted by the product of
+    1/2 for the coincident index and 1/4 for each neighbor, along each axis.
+    This preserves the integral of the field, so it suits densities such as
+    the residual of a Poisson equation.
+
+    \see ProlongateAndAdd
+
+*/
+void RestrictFullWeighting( UniformGrid< Vec3 > & coarse , const UniformGrid< Vec3 > & fine , size_t izStart , size_t izEnd )
+{
+    static const float  weights[3]              = { 0.25f , 0.5f , 0.25f } ;
+    const unsigned      dims[3]                 = { coarse.GetNumPoints( 0 )   , coarse.GetNumPoints( 1 )   , coarse.GetNumPoints( 2 )   } ;
+    const unsigned      dimsMinus1[3]           = { coarse.GetNumPoints( 0 )-1 , coarse.GetNumPoints( 1 )-1 , coarse.GetNumPoints( 2 )-1 } ;
+    const unsigned      numXY                   = dims[0] * dims[1] ;
+    const unsigned      numXFine                = fine.GetNumPoints( 0 ) ;
+    const unsigned      numXYFine               = numXFine * fine.GetNumPoints( 1 ) ;
+    unsigned            index[3] ;
+
+    for( index[2] = unsigned( izStart ) ; index[2] < izEnd ; ++ index[2] )
     {
-        ASSIGN_Z_OFFSETS ;
+        const bool interiorZ = ( index[2] > 0 ) && ( index[2] < dimsMinus1[2] ) ;
         for( index[1] = 0 ; index[1] < dims[1] ; ++ index[1] )
         {
-            ASSIGN_YZ_OFFSETS ;
+            const bool interiorYZ = interiorZ && ( index[1] > 0 ) && ( index[1] < dimsMinus1[1] ) ;
             for( index[0] = 0 ; index[0] < dims[0] ; ++ index[0] )
             {
-                ASSIGN_XYZ_OFFSETS ;
-                COMPUTE_FINITE_DIFF ;
+                const unsigned offsetX0Y0Z0 = index[0] + dims[0] * index[1] + numXY * index[2] ;
+                Vec3 vSum( 0.0f , 0.0f , 0.0f ) ;
+                if( interiorYZ && ( index[0] > 0 ) && ( index[0] < dimsMinus1[0] ) )
+                {   // Gridpoint is interior, so average fine gridpoints around the one it coincides with.
+                    const unsigned offsetFine = 2 * index[0] + numXFine * 2 * index[1] + numXYFine * 2 * index[2] ;
+                    for( int dz = -1 ; dz <= 1 ; ++ dz )
+                    {
+                        for( int dy = -1 ; dy <= 1 ; ++ dy )
+                        {
+                            const float weightYZ = weights[ dy + 1 ] * weights[ dz + 1 ] ;
+                            for( int dx = -1 ; dx <= 1 ; ++ dx )
+                            {
+                                vSum += ( weightYZ * weights[ dx + 1 ] ) * fine[ offsetFine + dx + int( numXFine ) * dy + int( numXYFine ) * dz ] ;
+                            }
+                        }
+                    }
+                }
+                coarse[ offsetX0Y0Z0 ] = vSum ;
             }
         }
     }
+}
 
-#undef COMPUTE_FINITE_DIFF
-#undef ASSIGN_XYZ_OFFSETS
-#undef ASSIGN_YZ_OFFSETS
-#undef ASSIGN_Z_OFFSETS
 
+
+
+/*! \brief Interpolate a field from a grid with half as many cells along each axis and add it to a finer one, for a subset of z-slices
+
+    \param fine - (in/out) fine field, to whose interior gridpoints to add interpolated values
+
+    \param coarse - coarse field, with half as many cells as fine along each axis, over the same region
+
+    \param izStart - first z index of fine to compute
+
+    \param izEnd - one past the last z index of fine to compute
+
+    Fine gridpoints coincident with coarse gridpoints take their values,
+    and others take the average of the 2, 4 or 8 nearest coarse gridpoints,
+    i.e. trilinear interpolation.
+
+    \see RestrictFullWeighting
+
+*/
+void ProlongateAndAdd( UniformGrid< Vec3 > & fine , const UniformGrid< Vec3 > & coarse , size_t izStart , size_t izEnd )
+{
+    const unsigned  dimsMinus1[3]           = { fine.GetNumPoints( 0 )-1 , fine.GetNumPoints( 1 )-1 , fine.GetNumPoints( 2 )-1 } ;
+    const unsigned  numXFine                = fine.GetNumPoints( 0 ) ;
+    const unsigned  numXYFine               = numXFine * fine.GetNumPoints( 1 ) ;
+    const unsigned  numX                    = coarse.GetNumPoints( 0 ) ;
+    const unsigned  numXY                   = numX * coarse.GetNumPoints( 1 ) ;
+    unsigned        index[3] ;
+
+    for( index[2] = MAX2( 1u , unsigned( izStart ) ) ; ( index[2] < izEnd ) && ( index[2] < dimsMinus1[2] ) ; ++ index[2] )
+    {
+        // Coarse gridpoints on either side of this fine gridpoint, which coincide when the fine index is even.
+        const unsigned offsetsZ[2] = { numXY * ( index[2] / 2 ) , numXY * ( ( index[2] + 1 ) / 2 ) } ;
+        for( index[1] = 1 ; index[1] < dimsMinus1[1] ; ++ index[1] )
+        {
+            const unsigned offsetsY[2] = { numX * ( index[1] / 2 ) , numX * ( ( index[1] + 1 ) / 2 ) } ;
+            for( index[0] = 1 ; index[0] < dimsMinus1[0] ; ++ index[0] )
+            {
+                const unsigned offsetsX[2] = { index[0] / 2 , ( index[0] + 1 ) / 2 } ;
+                Vec3 vSum( 0.0f , 0.0f , 0.0f ) ;
+                for( unsigned iz = 0 ; iz < 2 ; ++ iz )
+                {
+                    for( unsigned iy = 0 ; iy < 2 ; ++ iy )
+                    {
+                        for( unsigned ix = 0 ; ix < 2 ; ++ ix )
+                        {
+                            vSum += coarse[ offsetsX[ ix ] + offsetsY[ iy ] + offsetsZ[ iz ] ] ;
+                        }
+                    }
+                }
+                fine[ index[0] + numXFine * index[1] + numXYFine * index[2] ] += 0.125f * vSum ;
+            }
+        }
+    }
 }
@@ -16,10 +16,38 @@
 
 // Macros --------------------------------------------------------------
 // Types --------------------------------------------------------------
+
+/*! \brief Stencil with which to approximate first derivatives on a uniform grid
+
+    Higher-order stencils resolve the same features with fewer gridpoints,
+    so a coarser grid can yield derivatives as accurate as those that
+    second-order differences yield from a finer grid.
+
+    \see ComputeJacobian
+*/
+enum FiniteDifferenceScheme
+{
+    FINITE_DIFFERENCE_CENTRAL2  ,   ///< Second-order central differences, first-order one-sided at faces.  Cheapest.
+    FINITE_DIFFERENCE_CENTRAL4  ,   ///< Fourth-order central differences, fourth-order one-sided near faces.
+    FINITE_DIFFERENCE_COMPACT4      ///< Fourth-order compact (Pade) differences, third-order closure at faces.  Most accurate for short wavelengths, but couples each whole grid line.
+} ;
+
 // Public variables --------------------------------------------------------------
 // Public functions --------------------------------------------------------------
 
-extern void ComputeJacobian( UniformGrid< Mat33 > & jacobian , const UniformGrid< Vec3 > & vec ) ;
+extern void ComputeJacobian( UniformGrid< Mat33 > & jacobian , const UniformGrid< Vec3 > & vec , FiniteDifferenceScheme scheme = FINITE_DIFFERENCE_CENTRAL2 ) ;
+extern void ComputeJacobian( UniformGrid< Mat33 > & jacobian , const UniformGrid< Vec3 > & vec , size_t izStart , size_t izEnd , FiniteDifferenceScheme scheme = FINITE_DIFFERENCE_CENTRAL2 ) ;
 extern void ComputeCurlFromJacobian( UniformGrid< Vec3 > & curl , const UniformGrid< Mat33 > & jacobian ) ;
+extern void ComputeCurlFromJacobian( UniformGrid< Vec3 > & curl , const UniformGrid< Mat33 > & jacobian , size_t izStart , size_t izEnd ) ;
+extern void ComputeDivergenceFromJacobian( UniformGrid< float > & divergence , const UniformGrid< Mat33 > & jacobian , size_t izStart , size_t izEnd ) ;
+extern void ComputeLaplacian( UniformGrid< Vec3 > & laplacian , const UniformGrid< Vec3 > & vec ) ;
+extern void ComputeLaplacian( UniformGrid< Vec3 > & laplacian , const UniformGrid< Vec3 > & vec , size_t izStart , size_t izEnd ) ;
+extern void ApplyDiffusionOperator( UniformGrid< Vec3 > & result , const UniformGrid< Vec3 > & vec , float diffusivityTimesStep , Vector< double > & sliceDots , size_t izStart , size_t izEnd ) ;
+extern void UpdateConjugateGradientSolution( UniformGrid< Vec3 > & soln , UniformGrid< Vec3 > & residual , const UniformGrid< Vec3 > & direction , const UniformGrid< Vec3 > & operatorTimesDirection , float alpha , Vector< double > & sliceDots , size_t izStart , size_t izEnd ) ;
+extern void UpdateConjugateGradientDirection( UniformGrid< Vec3 > & direction , const UniformGrid< Vec3 > & residual , float beta , size_t izStart , size_t izEnd ) ;
+extern void SolvePoissonRedBlack( UniformGrid< Vec3 > & soln , const UniformGrid< Vec3 > & rhs , unsigned color , size_t izStart , size_t izEnd ) ;
+extern void ComputePoissonResidual( UniformGrid< Vec3 > & residual , const UniformGrid< Vec3 > & soln , const UniformGrid< Vec3 > & rhs , size_t izStart , size_t izEnd ) ;
+extern void RestrictFullWeighting( UniformGrid< Vec3 > & coarse , const UniformGrid< Vec3 > & fine , size_t izStart , size_t izEnd ) ;
+extern void ProlongateAndAdd( UniformGrid< Vec3 > & fine , const UniformGrid< Vec3 > & coarse , size_t izStart , size_t izEnd ) ;
 
 #endif
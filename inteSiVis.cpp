@@ -9,6 +9,8 @@
 */
 
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 #if defined( WIN32 )
     #include <windows.h>
 #endif
@@ -36,6 +38,20 @@
 static InteSiVis * sInstance = 0 ;
 static const float  timeStep    = 1.0f / 30.0f ;
 
+/*! \brief Magnitude, relative to each vorton's vorticity, of perturbation that Restart adds when it upsamples
+
+    This seeds the small scales that the low-resolution run could not
+    represent, without overwhelming the flow it developed.
+*/
+static const float  sRestartPerturbation = 0.1f ;
+
+/*! \brief Wall-clock time, in seconds, that each idle callback spends on the simulation before rendering
+
+    Updates that take longer resume during later idle callbacks, so the
+    display keeps refreshing, showing the last complete update meanwhile.
+*/
+static const double sUpdateBudgetSeconds = 0.015 ;
+
 static const Vorton vortonDummy ;
 static const size_t vortonStride            = sizeof( Vorton ) ;
 static const size_t vortonOffsetToAngVel    = OFFSET_OF_MEMBER( vortonDummy , mVorticity ) ;
@@ -62,8 +78,11 @@ bool gPrintProfileData = false ;
 
     \param density - fluid density
 
+    \param randomSeed - seed for the pseudo-random number generator.
+        The default, 1, matches the seed the C runtime uses when nothing seeds it.
+
 */
-InteSiVis::InteSiVis( float viscosity , float density )
+InteSiVis::InteSiVis( float viscosity , float density , unsigned randomSeed )
     : mFluidBodySim( viscosity , density )
 #if 0
     , mCamera( 640 , 480 )  // Standard definition
@@ -77,6 +96,13 @@ InteSiVis::InteSiVis( float viscosity , float density )
     , mFrame( 0 )
     , mTimeNow( 0.0 )
     , mInitialized( false )
+    , mRandomSeed( randomSeed )
+    , mNumUpdates( 0 )
+    , mCheckpointFilename( 0 )
+    , mCheckpointUpdate( 0 )
+    , mRestartFilename( 0 )
+    , mRestartRefinement( 1 )
+    , mNumFilamentSegments( 0 )
 {
     assert( 0 == sInstance ) ;
     sInstance = this ;
@@ -160,6 +186,10 @@ void InteSiVis::InitialConditions( unsigned ic )
     sInstance->mFrame = 0 ;
     sInstance->mTimeNow = 0.0 ;
 
+    // Each scenario uses pseudo-random numbers to initialize itself, so reseed
+    // to make each scenario start identically, which lets a Session reproduce it.
+    srand( mRandomSeed ) ;
+
     mFluidBodySim.Clear() ;
 
     static const float      fRadius         = 1.0f ;
@@ -169,22 +199,20 @@ void InteSiVis::InitialConditions( unsigned ic )
     static const unsigned   numVortonsMax   = numCellsPerDim * numCellsPerDim * numCellsPerDim ;
     unsigned                numTracersPer   = 3 ;
 
-    Vector< Vorton > & vortons = mFluidBodySim.GetVortonSim().GetVortons() ;
-
     switch( ic )
     {   // Switch on initial conditions
         case 0: // vortex ring -- vorticity in [0,1]
-            AssignVorticity( vortons , 2.0f * fMagnitude , numVortonsMax , VortexRing( fRadius , fThickness , Vec3( 1.0f , 0.0f , 0.0f ) ) ) ;
+            AssignScenarioVorticity( 2.0f * fMagnitude , numVortonsMax , VortexRing( fRadius , fThickness , Vec3( 1.0f , 0.0f , 0.0f ) ) ) ;
             mCamera.SetTarget( Vec3( 10.f , 0.f , 0.f ) ) ;
             mCamera.SetEye( Vec3( 10.f , -10.0f , 0.0f ) ) ;
         break ;
         case 1: // "jet" vortex ring -- velocity in [0,1]
-            AssignVorticity( vortons , fMagnitude , numVortonsMax , JetRing( fRadius , fThickness , Vec3( 1.0f , 0.0f , 0.0f ) ) ) ;
+            AssignScenarioVorticity( fMagnitude , numVortonsMax , JetRing( fRadius , fThickness , Vec3( 1.0f , 0.0f , 0.0f ) ) ) ;
             mCamera.SetTarget( Vec3( 10.f , 0.f , 0.f ) ) ;
             mCamera.SetEye( Vec3( 10.f , -10.0f , 0.0f ) ) ;
         break ;
         case 2: // Projectile
-            AssignVorticity( vortons , 0.125f * FLT_EPSILON , 2048 , VortexNoise( Vec3( 4.0f * fThickness , 0.5f * fThickness , 0.5f * fThickness ) ) ) ;
+            AssignScenarioVorticity( 0.125f * FLT_EPSILON , 2048 , VortexNoise( Vec3( 4.0f * fThickness , 0.5f * fThickness , 0.5f * fThickness ) ) ) ;
             // Add a sphere
             mFluidBodySim.GetSpheres().PushBack( RbSphere( Vec3( -2.0f , 0.0f , 0.0f ) , Vec3( 5.0f , 0.0f , 0.0f ) , 0.2f , 0.2f ) ) ;
             mCamera.SetTarget( Vec3( 1.0f , 0.0f , 0.0f ) ) ;
@@ -192,7 +220,7 @@ void InteSiVis::InitialConditions( unsigned ic )
             numTracersPer = 6 ;
         break ;
         case 3: // Spinning sphere
-            AssignVorticity( vortons , 0.125f * FLT_EPSILON , 2048 , VortexNoise( Vec3( fThickness , fThickness , fThickness ) ) ) ;
+            AssignScenarioVorticity( 0.125f * FLT_EPSILON , 2048 , VortexNoise( Vec3( fThickness , fThickness , fThickness ) ) ) ;
             // Add a sphere
             mFluidBodySim.GetSpheres().PushBack( RbSphere( Vec3( 0.f , 0.0f , 0.0f ) , Vec3( 0.f , 0.0f , 0.0f ) , 100.0f , 0.2f ) ) ;
             mFluidBodySim.GetSpheres()[0].ApplyImpulsiveTorque( Vec3( 0.0f , 0.0f , 10.0f ) ) ; // Make sphere spin
@@ -201,21 +229,21 @@ void InteSiVis::InitialConditions( unsigned ic )
             numTracersPer = 6 ;
         break ;
         case 4: // Vortex sheet with spanwise variation
-            AssignVorticity( vortons , fMagnitude , numVortonsMax , VortexSheet( fThickness , /* variation */ 0.2f , /* width */ 7.0f * fThickness ) ) ;
+            AssignScenarioVorticity( fMagnitude , numVortonsMax , VortexSheet( fThickness , /* variation */ 0.2f , /* width */ 7.0f * fThickness ) ) ;
             mCamera.SetTarget( Vec3( 0.0f , 0.0f , 0.0f ) ) ;
             mCamera.SetEye( Vec3( 0.0f , -20.0f , 0.0f ) ) ;
         break ;
         case 5: // Vortex tube
-            AssignVorticity( vortons , fMagnitude , numVortonsMax , VortexTube( fThickness , /* variation */ 0.0f , /* width */ 2.0f * fThickness , 2 , 0 ) ) ;
+            AssignScenarioVorticity( fMagnitude , numVortonsMax , VortexTube( fThickness , /* variation */ 0.0f , /* width */ 2.0f * fThickness , 2 , 0 ) ) ;
         break ;
         case 6: // 2 orthogonal vortex tubes
-            AssignVorticity( vortons , fMagnitude , numVortonsMax , VortexTube( fThickness , /* variation */ 0.0f , /* width */ 4.0f * fThickness , 2 , -1 ) ) ;
-            AssignVorticity( vortons , fMagnitude , numVortonsMax , VortexTube( fThickness , /* variation */ 0.0f , /* width */ 4.0f * fThickness , 2 ,  1 ) ) ;
+            AssignScenarioVorticity( fMagnitude , numVortonsMax , VortexTube( fThickness , /* variation */ 0.0f , /* width */ 4.0f * fThickness , 2 , -1 ) ) ;
+            AssignScenarioVorticity( fMagnitude , numVortonsMax , VortexTube( fThickness , /* variation */ 0.0f , /* width */ 4.0f * fThickness , 2 ,  1 ) ) ;
             mCamera.SetTarget( Vec3( 0.0f , 0.0f , 0.0f ) ) ;
             mCamera.SetEye( Vec3( 0.0f , -2.0f , 0.0f ) ) ;
         break ;
         case 7: // 2D sheet
-            AssignVorticity( vortons , fMagnitude , numVortonsMax , VortexSheet( fThickness , /* variation */ 0.0f , /* width */ 2.0f * fThickness ) ) ;
+            AssignScenarioVorticity( fMagnitude , numVortonsMax , VortexSheet( fThickness , /* variation */ 0.0f , /* width */ 2.0f * fThickness ) ) ;
             mCamera.SetTarget( Vec3( 0.0f , 0.0f , 0.0f ) ) ;
             mCamera.SetEye( Vec3( 0.0f , -10.0f , 0.0f ) ) ;
         break ;
@@ -260,6 +288,45 @@ void InteSiVis::InitialConditions( unsigned ic )
 
 
 
+/*! \brief Assign vorticity for a scenario, as filaments when so configured, else as vortons
+
+    \param fMagnitude - maximum vorticity of the distribution
+
+    \param numVortonsMax - maximum number of vortons to use when assigning vortons
+
+    \param distribution - vorticity distribution to assign
+
+    Distributions without a filament equivalent use vortons even when
+    mNumFilamentSegments is nonzero.
+
+    \see UseFilaments
+*/
+void InteSiVis::AssignScenarioVorticity( float fMagnitude , unsigned numVortonsMax , const IVorticityDistribution & distribution )
+{
+    if( ( mNumFilamentSegments > 0 ) && AssignFilaments( mFluidBodySim.GetVortonSim().GetFilaments() , fMagnitude , mNumFilamentSegments , distribution ) )
+    {   // Distribution became a filament.
+        return ;
+    }
+    AssignVorticity( mFluidBodySim.GetVortonSim().GetVortons() , fMagnitude , numVortonsMax , distribution ) ;
+}
+
+
+
+
+/*! \brief Represent vortex rings and tubes as filaments, and restart the current scenario
+
+    \param numSegments - number of segments per filament, or zero to use vortons
+
+*/
+void InteSiVis::UseFilaments( unsigned numSegments )
+{
+    mNumFilamentSegments = numSegments ;
+    InitialConditions( mScenario ) ;
+}
+
+
+
+
 /*! \brief Destruct application for interactive simulation and visualization
 */
 InteSiVis::~InteSiVis()
@@ -322,9 +389,16 @@ static void GlutDisplayCallback(void)
     //sInstance->mVortonRenderer.SetParticleData( (char*) & rVortonSim.GetVortons()[0] ) ;
     //sInstance->mVortonRenderer.Render( sInstance->mTimeNow , timeStep , rVortonSim.GetVortons().Size() ) ;
 
-    // Render tracers:
-    sInstance->mTracerRenderer.SetParticleData( (char*) & rVortonSim.GetTracers()[0] ) ;
-    sInstance->mTracerRenderer.Render( sInstance->mTimeNow , timeStep , rVortonSim.GetTracers().Size() ) ;
+    // Render tracers.  The renderer reads them in place, from the chunks that hold them.
+    const ChunkedVector< Particle > &   rTracers    = rVortonSim.GetTracers() ;
+    const size_t                        numChunks   = rTracers.GetNumChunks() ;
+    sInstance->mTracerChunks.Resize( numChunks ) ;
+    for( size_t iChunk = 0 ; iChunk < numChunks ; ++ iChunk )
+    {
+        sInstance->mTracerChunks[ iChunk ] = (const char*) rTracers.GetChunk( iChunk ) ;
+    }
+    sInstance->mTracerRenderer.SetParticleChunks( numChunks > 0 ? & sInstance->mTracerChunks[0] : 0 , ChunkedVector< Particle >::CHUNK_SHIFT ) ;
+    sInstance->mTracerRenderer.Render( sInstance->mTimeNow , timeStep , rTracers.Size() ) ;
 
     QUERY_PERFORMANCE_ENTER ;
     glutSwapBuffers() ;
@@ -336,6 +410,103 @@ static void GlutDisplayCallback(void)
 
 
 
+/*! \brief Advance simulation by one time step, or toward it
+
+    \param deadlineSeconds - wall-clock time, as Session::GetSecondsNow reports it,
+        after which the simulation should yield.  The default finishes the step.
+
+    \return whether the step finished.  If not, the next call resumes it.
+
+    Frame and update counters, and virtual time, advance only when a step finishes.
+*/
+bool InteSiVis::Step( double deadlineSeconds )
+{
+    bool bFinished ;
+    QUERY_PERFORMANCE_ENTER ;
+    bFinished = mFluidBodySim.UpdateSliced( timeStep , mFrame , deadlineSeconds ) ;
+    QUERY_PERFORMANCE_EXIT( InteSiVis_FluidBodySim_Update ) ;
+    if( ! bFinished )
+    {   // Deadline passed.  Keep displaying particles as they are, and resume the step next time.
+        return false ;
+    }
+
+    ++ mFrame ;
+    ++ mNumUpdates ;
+    mTimeNow += timeStep ;
+
+    if( mCheckpointFilename && ( mNumUpdates == mCheckpointUpdate ) )
+    {   // Reached the update after which to save a checkpoint.
+        if( ! mFluidBodySim.SaveCheckpoint( mCheckpointFilename ) )
+        {
+            fprintf( stderr , "Could not save checkpoint to %s\n" , mCheckpointFilename ) ;
+        }
+    }
+    return true ;
+}
+
+
+
+
+/*! \brief Save a checkpoint after the given number of updates
+
+    \param strFilename - name of file to which to save the checkpoint.
+        Caller must keep this string alive until then.
+
+    \param numUpdates - number of updates, since the application began, after which to save
+
+    Combined with Replay, this runs the warm-up of a session at low resolution,
+    without a display, to produce a checkpoint from which Restart continues.
+*/
+void InteSiVis::ScheduleCheckpoint( const char * strFilename , unsigned numUpdates )
+{
+    mCheckpointFilename = strFilename ;
+    mCheckpointUpdate   = numUpdates ;
+}
+
+
+
+
+/*! \brief Continue the simulation from a checkpoint, at higher resolution
+
+    \param strFilename - name of file that a checkpoint saved.
+        Caller must keep this string alive until any capture begins.
+
+    \param refinement - number of vortons and tracers into which to split each one, along each axis.
+        1 continues at the resolution of the checkpoint.
+
+    \return whether the file held a valid checkpoint, and no capture was in progress
+
+    This lets expensive high-resolution runs start from a flow that a
+    cheap low-resolution run already developed, rather than spending
+    most of their time on the warm-up.
+
+    A capture that begins after this records the restart, so its replay
+    restarts the same way.  A session cannot record a restart partway
+    through, so this refuses to restart while capturing.
+
+    \see VortonSim::Upsample, BeginCapture
+*/
+bool InteSiVis::Restart( const char * strFilename , unsigned refinement )
+{
+    if( mSession.IsCapturing() )
+    {   // Replaying the capture would not reproduce this restart.
+        return false ;
+    }
+    if( ! mFluidBodySim.LoadCheckpoint( strFilename ) )
+    {
+        return false ;
+    }
+    mFluidBodySim.GetVortonSim().Upsample( refinement , refinement , sRestartPerturbation , mRandomSeed ) ;
+    mFrame              = 0 ;
+    mTimeNow            = 0.0 ;
+    mRestartFilename    = strFilename ;
+    mRestartRefinement  = refinement ;
+    return true ;
+}
+
+
+
+
 /*! \brief Function that GLUT calls when nothing else is happening
 */
 void GlutIdleCallback(void)
@@ -346,12 +517,8 @@ void GlutIdleCallback(void)
     tbb::tick_count time0 = tbb::tick_count::now() ;
 #endif
 
-    QUERY_PERFORMANCE_ENTER ;
-    sInstance->mFluidBodySim.Update( timeStep , sInstance->mFrame ) ;
-    QUERY_PERFORMANCE_EXIT( InteSiVis_FluidBodySim_Update ) ;
-
-    ++ sInstance->mFrame ;
-    sInstance->mTimeNow += timeStep ;
+    // Spend at most a budget on the simulation, so rendering does not wait for a whole update.
+    sInstance->Step( Session::GetSecondsNow() + sUpdateBudgetSeconds ) ;
 
 #if USE_TBB
     tbb::tick_count timeFinal = tbb::tick_count::now() ;
@@ -366,23 +533,50 @@ void GlutIdleCallback(void)
 
 
 
+/*! \brief Determine which scenario a function key selects
+
+    \param key - GLUT special key code
+
+    \param rScenario - (out) scenario that key selects, if any
+
+    \return whether key selects a scenario
+*/
+static bool ScenarioOfFunctionKey( int key , unsigned & rScenario )
+{
+    switch( key )
+    {
+        case GLUT_KEY_F1: rScenario = 1 ; break;
+        case GLUT_KEY_F2: rScenario = 2 ; break;
+        case GLUT_KEY_F3: rScenario = 3 ; break;
+        case GLUT_KEY_F4: rScenario = 4 ; break;
+        case GLUT_KEY_F5: rScenario = 5 ; break;
+        case GLUT_KEY_F6: rScenario = 6 ; break;
+        case GLUT_KEY_F7: rScenario = 0 ; break;
+
+        default:
+        return false ;
+        break;
+    }
+    return true ;
+}
+
+
+
+
 /*! \brief Function that GLUT calls to handle a special key
 */
 static void GlutSpecialKeyHandler (int key, int x, int y)
 {
     QdCamera &  cam     = sInstance->mCamera ;
     Vec3        vTarget = cam.GetTarget() ;
+    unsigned    scenario ;
 
-    switch (key)
+    if( ScenarioOfFunctionKey( key , scenario ) )
+    {
+        sInstance->InitialConditions( scenario ) ;
+    }
+    else switch (key)
     {
-        case GLUT_KEY_F1: sInstance->InitialConditions( 1 ) ; break;
-        case GLUT_KEY_F2: sInstance->InitialConditions( 2 ) ; break;
-        case GLUT_KEY_F3: sInstance->InitialConditions( 3 ) ; break;
-        case GLUT_KEY_F4: sInstance->InitialConditions( 4 ) ; break;
-        case GLUT_KEY_F5: sInstance->InitialConditions( 5 ) ; break;
-        case GLUT_KEY_F6: sInstance->InitialConditions( 6 ) ; break;
-        case GLUT_KEY_F7: sInstance->InitialConditions( 0 ) ; break;
-
         case GLUT_KEY_UP   : vTarget.z += 0.1f ; cam.SetTarget( vTarget ) ; break ;
         case GLUT_KEY_DOWN : vTarget.z -= 0.1f ; cam.SetTarget( vTarget ) ; break ;
         case GLUT_KEY_RIGHT: vTarget.x -= 1.0f ; cam.SetTarget( vTarget ) ; break ;
@@ -392,7 +586,8 @@ static void GlutSpecialKeyHandler (int key, int x, int y)
         return;
         break;
     }
-    
+
+    sInstance->RecordEvent( SessionEvent::SPECIAL_KEY , key , 0 , x , y ) ;
     glutPostRedisplay() ;
 }
 
@@ -416,6 +611,7 @@ void GlutKeyboardHandler (unsigned char key, int x, int y)
         case 127 /* delete */ : ; break;
 
         case 27 /* escape */ :
+            sInstance->mSession.EndCapture( sInstance->mNumUpdates ) ;
             exit( 0 ) ;
         break;
 
@@ -425,6 +621,7 @@ void GlutKeyboardHandler (unsigned char key, int x, int y)
         break;
     }
     cam.SetOrbit( azimuth , elevation , radius ) ;
+    sInstance->RecordEvent( SessionEvent::KEY , key , 0 , x , y ) ;
 }
 
 
@@ -444,6 +641,7 @@ void GlutMouseHandler( int button , int state , int x , int y )
     }
     sMousePrevX = x ;
     sMousePrevY = y ;
+    sInstance->RecordEvent( SessionEvent::MOUSE_BUTTON , button , GLUT_DOWN == state , x , y ) ;
 }
 
 
@@ -504,6 +702,11 @@ void GlutMouseMotionHandler( int x , int y )
         cam.SetTarget( Vec3( rTarget.x + delta.x , rTarget.y + delta.y , rTarget.z + delta.z ) ) ;
     }
 
+    if( sInstance->mMouseButtons[0] || sInstance->mMouseButtons[1] || sInstance->mMouseButtons[2] )
+    {   // Motion changed camera.  (Motion with no buttons pressed has no effect, so omit it from sessions.)
+        sInstance->RecordEvent( SessionEvent::MOUSE_MOTION , 0 , 0 , x , y ) ;
+    }
+
     sMousePrevX = x ;
     sMousePrevY = y ;
 }
@@ -567,9 +770,297 @@ void InteSiVis::InitDevice( int * pArgc , char ** argv )
 
 
 
+/*! \brief Begin capturing input to a session file
+
+    \param strFilename - name of file to which to write the session
+
+    \return whether the file opened successfully
+
+    If this application restarted from a checkpoint, the session records that too.
+
+    \see Replay, Restart
+*/
+bool InteSiVis::BeginCapture( const char * strFilename )
+{
+    if( ! mSession.BeginCapture( strFilename , mRandomSeed ) )
+    {
+        return false ;
+    }
+    if( mRestartFilename )
+    {
+        mSession.RecordRestart( mRestartFilename , mRestartRefinement ) ;
+    }
+    return true ;
+}
+
+
+
+
+/*! \brief Record an input event, along with the camera it left behind, if capturing
+
+    \param type - kind of input
+
+    \param code - key or button
+
+    \param state - button state
+
+    \param x, y - mouse position
+*/
+void InteSiVis::RecordEvent( SessionEvent::Type type , int code , int state , int x , int y )
+{
+    if( ! mSession.IsCapturing() )
+    {
+        return ;
+    }
+    SessionEvent event ;
+    event.mUpdate   = mNumUpdates ;
+    event.mType     = type ;
+    event.mCode     = code ;
+    event.mState    = state ;
+    event.mX        = x ;
+    event.mY        = y ;
+    event.mEye      = mCamera.GetEye() ;
+    event.mTarget   = mCamera.GetTarget() ;
+    mSession.Record( event ) ;
+}
+
+
+
+
+/*! \brief Reproduce the effect of a recorded input event, without a display
+
+    Events that change scenario or profiling re-execute the same change.
+    The camera takes the state the event recorded, instead of recomputing it
+    from mouse motion, since that computation depends on rendering state.
+*/
+void InteSiVis::ApplyEvent( const SessionEvent & event )
+{
+    unsigned scenario ;
+    if( ( SessionEvent::SPECIAL_KEY == event.mType ) && ScenarioOfFunctionKey( event.mCode , scenario ) )
+    {
+        InitialConditions( scenario ) ;
+    }
+    else if( ( SessionEvent::KEY == event.mType ) && ( '?' == event.mCode ) )
+    {
+        gPrintProfileData = ! gPrintProfileData ;
+    }
+    mCamera.SetEye( event.mEye ) ;
+    mCamera.SetTarget( event.mTarget ) ;
+}
+
+
+
+
+/*! \brief Replay a captured session without a display, timing each update
+
+    \param session - session that Session::Load read.
+        This application must have been constructed with session.GetRandomSeed(),
+        and, if the session restarted from a checkpoint, have restarted the same way.
+
+    This performs the same sequence of InitialConditions, camera changes and
+    Update calls as the captured session, so it reproduces the simulation
+    bit-exactly, given the same build and number of threads.
+    It writes the duration of each update to stdout, one per line,
+    so that one can locate a frame-time spike and then profile the replay.
+*/
+void InteSiVis::Replay( const Session & session )
+{
+    const Vector< SessionEvent > &  events      = session.GetEvents() ;
+    const size_t                    numEvents   = events.Size() ;
+    const unsigned                  numUpdates  = session.GetNumUpdates() ;
+    size_t                          iEvent      = 0 ;
+    double                          secondsMax  = 0.0 ;
+    unsigned                        iUpdateMax  = 0 ;
+    const double                    secondsBegin= Session::GetSecondsNow() ;
+
+    while( mNumUpdates < numUpdates )
+    {   // For each update in the session...
+        while( ( iEvent < numEvents ) && ( events[ iEvent ].mUpdate <= mNumUpdates ) )
+        {   // For each event that preceded this update...
+            ApplyEvent( events[ iEvent ] ) ;
+            ++ iEvent ;
+        }
+        const unsigned  iUpdate     = mNumUpdates ;
+        const double    seconds0    = Session::GetSecondsNow() ;
+        Step() ;
+        const double    seconds     = Session::GetSecondsNow() - seconds0 ;
+        printf( "%u %g\n" , iUpdate , seconds ) ;
+        if( seconds > secondsMax )
+        {
+            secondsMax = seconds ;
+            iUpdateMax = iUpdate ;
+        }
+    }
+
+    fprintf( stderr , "Replayed %u updates in %g seconds.  Slowest was update %u, which took %g seconds.\n"
+        , numUpdates , Session::GetSecondsNow() - secondsBegin , iUpdateMax , secondsMax ) ;
+}
+
+
+
+
+/*! \brief Entry point
+
+    Command-line options, which GLUT ignores:
+
+        -capture filename : Record input, and the random seed, to the given file.
+
+        -replay filename : Instead of running interactively, replay the session
+            in the given file without a display, then exit.  If the session
+            restarted from a checkpoint, the replay restarts from it too.
+
+        -checkpoint filename numUpdates : Save a checkpoint to the given file
+            after the given number of updates.
+
+        -restart filename refinement : Continue from the checkpoint in the given
+            file, splitting each vorton and tracer into refinement^3 of them.
+
+        -largepages : Request that the largest grids reside in large pages.
+
+        -p3m : Compute velocity with particle-particle/particle-mesh
+            instead of the influence tree.
+
+        -leafcapacity number : Make each leaf of the influence tree hold
+            about the given number of vortons, and sum them individually.
+
+        -directlimit number : Sum velocity directly, vorton by vorton,
+            while there are no more than the given number of vortons.
+
+        -refit tolerance : Pad the influence tree by the given fraction
+            of its extent, and refit it between frames while vortons stay inside.
+
+        -filaments number : Represent vortex rings and tubes as filaments
+            with the given number of segments, rather than as vortons.
+
+        A replay needs the same simulation options as the capture it replays.
+
+        -test : Instead of running interactively, run unit tests of the
+            simulation without a display, then exit.
+*/
 int main( int argc , char ** argv )
 {
-    InteSiVis inteSiVis( 0.05f , 1.0f ) ;
+    bool bLargePages = false ;
+    bool bP3M        = false ;
+    for( int iArg = 1 ; iArg < argc ; ++ iArg )
+    {   // For each command-line argument...
+        if( 0 == strcmp( argv[ iArg ] , "-test" ) )
+        {   // Run unit tests instead of the interactive simulation.
+            VortonSim::UnitTest() ;
+            FluidBodySim::UnitTest() ;
+            Session::UnitTest() ;
+            return 0 ;
+        }
+        else if( 0 == strcmp( argv[ iArg ] , "-largepages" ) )
+        {
+            bLargePages = true ;
+        }
+        else if( 0 == strcmp( argv[ iArg ] , "-p3m" ) )
+        {
+            bP3M = true ;
+        }
+    }
+
+    const char * strCaptureFilename     = 0 ;
+    const char * strReplayFilename      = 0 ;
+    const char * strCheckpointFilename  = 0 ;
+    unsigned     checkpointUpdate       = 0 ;
+    const char * strRestartFilename     = 0 ;
+    unsigned     restartRefinement      = 1 ;
+    unsigned     leafCapacity           = 0 ;   // Zero means the option is absent, so keep the default.
+    int          directSummationLimit   = -1 ;  // Negative means the option is absent, so keep the default.
+    float        refitTolerance         = -1.0f ;
+    unsigned     numFilamentSegments    = 0 ;
+    for( int iArg = 1 ; iArg + 1 < argc ; ++ iArg )
+    {   // For each command-line argument that has a successor...
+        if( 0 == strcmp( argv[ iArg ] , "-capture" ) )
+        {
+            strCaptureFilename = argv[ ++ iArg ] ;
+        }
+        else if( 0 == strcmp( argv[ iArg ] , "-replay" ) )
+        {
+            strReplayFilename = argv[ ++ iArg ] ;
+        }
+        else if( ( 0 == strcmp( argv[ iArg ] , "-checkpoint" ) ) && ( iArg + 2 < argc ) )
+        {
+            strCheckpointFilename   = argv[ ++ iArg ] ;
+            checkpointUpdate        = unsigned( atoi( argv[ ++ iArg ] ) ) ;
+        }
+        else if( ( 0 == strcmp( argv[ iArg ] , "-restart" ) ) && ( iArg + 2 < argc ) )
+        {
+            strRestartFilename      = argv[ ++ iArg ] ;
+            restartRefinement       = unsigned( MAX2( 1 , atoi( argv[ ++ iArg ] ) ) ) ;
+        }
+        else if( 0 == strcmp( argv[ iArg ] , "-leafcapacity" ) )
+        {
+            leafCapacity = unsigned( MAX2( 1 , atoi( argv[ ++ iArg ] ) ) ) ;
+        }
+        else if( 0 == strcmp( argv[ iArg ] , "-directlimit" ) )
+        {
+            directSummationLimit = MAX2( 0 , atoi( argv[ ++ iArg ] ) ) ;
+        }
+        else if( 0 == strcmp( argv[ iArg ] , "-refit" ) )
+        {
+            refitTolerance = MAX2( 0.0f , float( atof( argv[ ++ iArg ] ) ) ) ;
+        }
+        else if( 0 == strcmp( argv[ iArg ] , "-filaments" ) )
+        {
+            numFilamentSegments = unsigned( MAX2( 0 , atoi( argv[ ++ iArg ] ) ) ) ;
+        }
+    }
+
+    Session session ;
+    if( strReplayFilename && ! session.Load( strReplayFilename ) )
+    {
+        fprintf( stderr , "Could not load session from %s\n" , strReplayFilename ) ;
+        return 1 ;
+    }
+    InteSiVis   inteSiVis( 0.05f , 1.0f , strReplayFilename ? session.GetRandomSeed() : 1 ) ;
+    VortonSim & rVortonSim = inteSiVis.mFluidBodySim.GetVortonSim() ;
+    rVortonSim.SetLargePages( bLargePages ) ;
+    if( bP3M )
+    {
+        rVortonSim.SetVelocitySolver( VortonSim::VELOCITY_SOLVER_P3M ) ;
+    }
+    if( leafCapacity > 0 )
+    {
+        rVortonSim.SetLeafCapacity( leafCapacity ) ;
+    }
+    if( directSummationLimit >= 0 )
+    {
+        rVortonSim.SetDirectSummationLimit( unsigned( directSummationLimit ) ) ;
+    }
+    if( refitTolerance >= 0.0f )
+    {
+        rVortonSim.SetRefitTolerance( refitTolerance ) ;
+    }
+    if( numFilamentSegments > 0 )
+    {
+        inteSiVis.UseFilaments( numFilamentSegments ) ;
+    }
+    if( strCheckpointFilename )
+    {
+        inteSiVis.ScheduleCheckpoint( strCheckpointFilename , checkpointUpdate ) ;
+    }
+
+    if( strReplayFilename )
+    {
+        if( session.GetRestartFilename() && ! inteSiVis.Restart( session.GetRestartFilename() , session.GetRestartRefinement() ) )
+        {
+            fprintf( stderr , "Could not restart from checkpoint %s, as the session did\n" , session.GetRestartFilename() ) ;
+            return 1 ;
+        }
+        inteSiVis.Replay( session ) ;
+        return 0 ;
+    }
+
+    if( strRestartFilename && ! inteSiVis.Restart( strRestartFilename , restartRefinement ) )
+    {
+        fprintf( stderr , "Could not restart from checkpoint %s\n" , strRestartFilename ) ;
+    }
+    if( strCaptureFilename && ! inteSiVis.BeginCapture( strCaptureFilename ) )
+    {
+        fprintf( stderr , "Could not capture session to %s\n" , strCaptureFilename ) ;
+    }
     inteSiVis.InitDevice( & argc , argv ) ;
     return 0 ;
 }
\ No newline at end of file
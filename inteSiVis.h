@@ -10,27 +10,43 @@
 #ifndef INTE_SI_VIS_H
 #define INTE_SI_VIS_H
 
+#include <float.h>
+
 #include "Sim/fluidBodySim.h"
 #include "Render/qdMaterial.h"
 #include "Render/qdCamera.h"
 #include "Render/particleRenderer.h"
+#include "session.h"
+
+class IVorticityDistribution ;
 
 /*! \brief Application for interactive simulation and visualization
 */
 class InteSiVis
 {
     public:
-        InteSiVis( float viscosity , float density ) ;
+        InteSiVis( float viscosity , float density , unsigned randomSeed = 1 ) ;
         ~InteSiVis() ;
 
         void InitDevice( int * pArgc , char ** argv ) ;
         void InitialConditions( unsigned ic ) ;
+        void UseFilaments( unsigned numSegments ) ;
+        bool Step( double deadlineSeconds = DBL_MAX ) ;
+
+        bool BeginCapture( const char * strFilename ) ;
+        void RecordEvent( SessionEvent::Type type , int code , int state , int x , int y ) ;
+        void ApplyEvent( const SessionEvent & event ) ;
+        void Replay( const Session & session ) ;
+
+        void ScheduleCheckpoint( const char * strFilename , unsigned numUpdates ) ;
+        bool Restart( const char * strFilename , unsigned refinement ) ;
 
         FluidBodySim        mFluidBodySim       ;   ///< Simulation of fluid and rigid bodies
         QdCamera            mCamera             ;   ///< Camera for rendering
         QdMaterial          mParticleMaterial   ;   ///< Material used to render vortons
         ParticleRenderer    mVortonRenderer     ;   ///< Renderer for vortons
         ParticleRenderer    mTracerRenderer     ;   ///< Renderer for tracers
+        Vector< const char * > mTracerChunks    ;   ///< Address of each chunk of tracers, which the renderer reads in place
         int                 mRenderWindow       ;   ///< Identifier for render window
         int                 mStatusWindow       ;   ///< Identifier for status window
         unsigned            mFrame              ;   ///< Frame counter
@@ -38,6 +54,14 @@ class InteSiVis
         int                 mMouseButtons[3]    ;   ///< Mouse buttons pressed
         bool                mInitialized        ;   ///< Whether this application has been initialized
         int                 mScenario           ;   ///< Which scenario is being simulated now
+        unsigned            mRandomSeed         ;   ///< Seed for the pseudo-random number generator, which each scenario uses to initialize itself
+        unsigned            mNumUpdates         ;   ///< Number of simulation updates since the application began.  Unlike mFrame, changing scenarios does not reset this.
+        Session             mSession            ;   ///< Session to which this application records input, when capturing
+        const char *        mCheckpointFilename ;   ///< Name of file to which to save a checkpoint, or NULL for none
+        unsigned            mCheckpointUpdate   ;   ///< Value of mNumUpdates after which to save a checkpoint
+        const char *        mRestartFilename    ;   ///< Name of checkpoint file from which this application restarted, or NULL if it did not
+        unsigned            mRestartRefinement  ;   ///< Refinement with which this application restarted from mRestartFilename
+        unsigned            mNumFilamentSegments;   ///< Number of segments per vortex filament, or zero to represent every scenario with vortons
 
     #if USE_TBB
         tbb::task_scheduler_init tbb_init ;
@@ -46,6 +70,8 @@ class InteSiVis
     private:
         InteSiVis( const InteSiVis & re) ;                // Disallow copy construction.
         InteSiVis & operator=( const InteSiVis & re ) ;   // Disallow assignment
+
+        void AssignScenarioVorticity( float fMagnitude , unsigned numVortonsMax , const IVorticityDistribution & distribution ) ;
 } ;
 
 // Public variables --------------------------------------------------------------
@@ -0,0 +1,220 @@
+/*! \file session.cpp
+
+    \brief Capture and replay of interactive sessions
+
+    \author Copyright 2009 Dr. Michael Jason Gourlay; All rights reserved.
+*/
+
+#include <string.h>
+#if defined( WIN32 )
+    #include <windows.h>
+#endif
+
+#include "Core/Performance/perf.h"
+
+#include "session.h"
+
+// Private variables --------------------------------------------------------------
+
+/*! \brief Start of first line of every session file, which continues with the format version
+*/
+static const char sSessionHeader[] = "InteSiVis session" ;
+
+/*! \brief Version of session format that BeginCapture writes
+
+    Version 2 added the restart line.
+*/
+static const unsigned sSessionVersion = 2 ;
+
+// Functions --------------------------------------------------------------
+
+
+/*! \brief Construct an empty session
+*/
+Session::Session()
+    : mFile( 0 )
+    , mBeginSeconds( 0.0 )
+    , mRandomSeed( 1 )
+    , mNumUpdates( 0 )
+    , mRestartRefinement( 1 )
+{
+    mRestartFilename[ 0 ] = '\0' ;
+}
+
+
+
+
+/*! \brief Destruct session, closing the file of any capture in progress
+*/
+Session::~Session()
+{
+    if( mFile )
+    {
+        fclose( mFile ) ;
+    }
+}
+
+
+
+
+/*! \brief Return wall-clock time, in seconds, from a high-resolution counter
+
+    \see QueryPerformanceSeconds
+*/
+double Session::GetSecondsNow( void )
+{
+    return QueryPerformanceSeconds() ;
+}
+
+
+
+
+/*! \brief Begin capturing a session to a file
+
+    \param strFilename - name of file to which to write the session
+
+    \param randomSeed - seed with which the application seeds the pseudo-random number generator
+
+    \return whether the file opened successfully
+*/
+bool Session::BeginCapture( const char * strFilename , unsigned randomSeed )
+{
+    mFile = fopen( strFilename , "w" ) ;
+    if( 0 == mFile )
+    {
+        return false ;
+    }
+    mBeginSeconds   = GetSecondsNow() ;
+    mRandomSeed     = randomSeed ;
+    fprintf( mFile , "%s %u\n" , sSessionHeader , sSessionVersion ) ;
+    fprintf( mFile , "seed %u\n" , mRandomSeed ) ;
+    fflush( mFile ) ;
+    return true ;
+}
+
+
+
+
+/*! \brief Record that the application restarted from a checkpoint, if capturing
+
+    \param strFilename - name of checkpoint file from which the application restarted
+
+    \param refinement - number of vortons and tracers into which the restart split each one, along each axis
+
+    Call this immediately after BeginCapture, before recording any event,
+    since a replay restarts before it applies events.
+*/
+void Session::RecordRestart( const char * strFilename , unsigned refinement )
+{
+    if( 0 == mFile )
+    {
+        return ;
+    }
+    strncpy( mRestartFilename , strFilename , sizeof( mRestartFilename ) - 1 ) ;
+    mRestartFilename[ sizeof( mRestartFilename ) - 1 ] = '\0' ;
+    mRestartRefinement = refinement ;
+    fprintf( mFile , "restart %u %s\n" , mRestartRefinement , mRestartFilename ) ;
+    fflush( mFile ) ;
+}
+
+
+
+
+/*! \brief Record an input event, if capturing
+
+    \param event - event to record.  This assigns its timestamp.
+        Caller must have assigned all other members.
+
+    Floating-point values use 9 significant digits so that they read back exactly.
+*/
+void Session::Record( SessionEvent & event )
+{
+    if( 0 == mFile )
+    {
+        return ;
+    }
+    event.mSeconds = GetSecondsNow() - mBeginSeconds ;
+    fprintf( mFile , "event %u %.6f %d %d %d %d %d %.9g %.9g %.9g %.9g %.9g %.9g\n"
+        , event.mUpdate , event.mSeconds , event.mType , event.mCode , event.mState , event.mX , event.mY
+        , event.mEye.x , event.mEye.y , event.mEye.z , event.mTarget.x , event.mTarget.y , event.mTarget.z ) ;
+    fflush( mFile ) ;
+}
+
+
+
+
+/*! \brief Finish capturing a session
+
+    \param numUpdates - number of simulation updates the application performed since it began
+*/
+void Session::EndCapture( unsigned numUpdates )
+{
+    if( 0 == mFile )
+    {
+        return ;
+    }
+    mNumUpdates = numUpdates ;
+    fprintf( mFile , "end %u\n" , mNumUpdates ) ;
+    fclose( mFile ) ;
+    mFile = 0 ;
+}
+
+
+
+
+/*! \brief Load a session that BeginCapture wrote
+
+    \param strFilename - name of file from which to read the session
+
+    \return whether the file contained a valid session
+
+    If the capture ended abruptly, without EndCapture, then the session
+    spans only the updates up to and including the one after the last event.
+*/
+bool Session::Load( const char * strFilename )
+{
+    FILE * pFile = fopen( strFilename , "r" ) ;
+    if( 0 == pFile )
+    {
+        return false ;
+    }
+
+    mEvents.Clear() ;
+    mRandomSeed = 1 ;
+    mNumUpdates = 0 ;
+    mRestartFilename[ 0 ] = '\0' ;
+    mRestartRefinement = 1 ;
+    char        line[ 512 ] ;
+    unsigned    version = 0 ;
+    if(     ( 0 == fgets( line , sizeof( line ) , pFile ) )
+        ||  ( strncmp( line , sSessionHeader , strlen( sSessionHeader ) ) != 0 )
+        ||  ( sscanf( line + strlen( sSessionHeader ) , "%u" , & version ) != 1 )
+        ||  ( version > sSessionVersion ) )
+    {   // File is not a session, or is a later version than this reads.
+        fclose( pFile ) ;
+        return false ;
+    }
+    while( fgets( line , sizeof( line ) , pFile ) )
+    {   // For each line in the file...
+        SessionEvent event ;
+        if( 1 == sscanf( line , "seed %u" , & mRandomSeed ) )
+        {   // Line holds random seed, which sscanf already stored.
+        }
+        else if( 2 == sscanf( line , "restart %u %255[^\r\n]" , & mRestartRefinement , mRestartFilename ) )
+        {   // Line holds checkpoint restart, which sscanf already stored.
+        }
+        else if( 13 == sscanf( line , "event %u %lf %d %d %d %d %d %f %f %f %f %f %f"
+                , & event.mUpdate , & event.mSeconds , & event.mType , & event.mCode , & event.mState , & event.mX , & event.mY
+                , & event.mEye.x , & event.mEye.y , & event.mEye.z , & event.mTarget.x , & event.mTarget.y , & event.mTarget.z ) )
+        {
+            mEvents.PushBack( event ) ;
+            mNumUpdates = MAX2( mNumUpdates , event.mUpdate + 1 ) ;
+        }
+        else if( 1 == sscanf( line , "end %u" , & mNumUpdates ) )
+        {   // Capture ended normally.
+            break ;
+        }
+    }
+    fclose( pFile ) ;
+    return true ;
+}
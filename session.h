@@ -0,0 +1,109 @@
+/*! \file session.h
+
+    \brief Capture and replay of interactive sessions
+
+    \author Copyright 2009 Dr. Michael Jason Gourlay; All rights reserved.
+*/
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <stdio.h>
+
+#include "Core/Math/vec3.h"
+
+#include "wrapperMacros.h"
+
+// Macros --------------------------------------------------------------
+// Types --------------------------------------------------------------
+
+/*! \brief Input event that a Session captures
+*/
+struct SessionEvent
+{
+    /*! \brief Kind of input
+    */
+    enum Type
+    {
+        KEY             ,   ///< Regular key.  mCode holds the character.
+        SPECIAL_KEY     ,   ///< Special key, such as a function or arrow key.  mCode holds the GLUT key code.
+        MOUSE_BUTTON    ,   ///< Mouse button press or release.  mCode holds the button and mState whether it went down.
+        MOUSE_MOTION        ///< Mouse motion.  Only mX and mY apply.
+    } ;
+
+    unsigned    mUpdate     ;   ///< Number of simulation updates that preceded this event
+    double      mSeconds    ;   ///< Wall-clock time, in seconds, since capture began
+    int         mType       ;   ///< Kind of input, one of Type
+    int         mCode       ;   ///< Key or button
+    int         mState      ;   ///< Button state
+    int         mX          ;   ///< Horizontal mouse position
+    int         mY          ;   ///< Vertical mouse position
+    Vec3        mEye        ;   ///< Camera eye position after the application handled this event
+    Vec3        mTarget     ;   ///< Camera target position after the application handled this event
+} ;
+
+
+
+
+/*! \brief Record of an interactive session, for reproducing it without interaction
+
+    A session consists of the seed for the pseudo-random number generator,
+    the input events the user generated, and the number of simulation
+    updates the application performed.  Each event records how many updates
+    preceded it, rather than only when it happened, so that replaying it
+    reproduces the same sequence of initial conditions, camera changes and
+    updates regardless of how fast the replay runs.
+
+    Each event also records the camera it left behind, because some camera
+    motions depend on rendering state (such as the view matrix) which a
+    replay without a display does not have.
+
+    When the application restarted from a checkpoint before capture began,
+    the session also records the checkpoint file and refinement, so that a
+    replay can restart from the same checkpoint.
+
+    A capture writes each event as it happens, so the file remains usable
+    even if the application terminates abruptly.
+*/
+class Session
+{
+    public:
+        Session() ;
+        ~Session() ;
+
+        bool            BeginCapture( const char * strFilename , unsigned randomSeed ) ;
+        void            RecordRestart( const char * strFilename , unsigned refinement ) ;
+        void            Record( SessionEvent & event ) ;
+        void            EndCapture( unsigned numUpdates ) ;
+        bool            IsCapturing( void ) const           { return mFile != 0 ; }
+
+        bool            Load( const char * strFilename ) ;
+
+        unsigned                        GetRandomSeed( void ) const { return mRandomSeed ; }
+        unsigned                        GetNumUpdates( void ) const { return mNumUpdates ; }
+        const Vector< SessionEvent > &  GetEvents( void ) const     { return mEvents ; }
+
+        /// Return name of checkpoint file from which the session restarted, or NULL if it did not.
+        const char *                    GetRestartFilename( void ) const    { return mRestartFilename[ 0 ] ? mRestartFilename : 0 ; }
+        unsigned                        GetRestartRefinement( void ) const  { return mRestartRefinement ; }
+
+        static double   GetSecondsNow( void ) ;
+
+        static void     UnitTest( void ) ;
+
+    private:
+        Session( const Session & re ) ;                 // Disallow copy construction.
+        Session & operator=( const Session & re ) ;     // Disallow assignment
+
+        FILE *                  mFile           ;   ///< File to which a capture writes, or NULL when not capturing
+        double                  mBeginSeconds   ;   ///< Wall-clock time when capture began
+        unsigned                mRandomSeed     ;   ///< Seed for the pseudo-random number generator
+        unsigned                mNumUpdates     ;   ///< Number of simulation updates the session spans
+        Vector< SessionEvent >  mEvents         ;   ///< Events that Load read, in the order they happened
+        char                    mRestartFilename[ 256 ] ;   ///< Name of checkpoint file from which the session restarted, or empty if it did not
+        unsigned                mRestartRefinement  ;   ///< Refinement with which the session restarted from mRestartFilename
+} ;
+
+// Public variables --------------------------------------------------------------
+// Public functions --------------------------------------------------------------
+
+#endif
@@ -0,0 +1,114 @@
+/*! \file sessionDiagnostics.cpp
+
+    \brief Capture and replay of interactive sessions, diagnostic routines
+
+    \author Copyright 2009 Dr. Michael Jason Gourlay; All rights reserved.
+*/
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "session.h"
+
+
+
+
+/*! \brief Return whether two events hold identical values, other than timestamps
+*/
+static bool EventsMatch( const SessionEvent & a , const SessionEvent & b )
+{
+    return  ( a.mUpdate     == b.mUpdate    )
+        &&  ( a.mType       == b.mType      )
+        &&  ( a.mCode       == b.mCode      )
+        &&  ( a.mState      == b.mState     )
+        &&  ( a.mX          == b.mX         )
+        &&  ( a.mY          == b.mY         )
+        &&  ( a.mEye.x      == b.mEye.x     ) && ( a.mEye.y    == b.mEye.y    ) && ( a.mEye.z    == b.mEye.z    )
+        &&  ( a.mTarget.x   == b.mTarget.x  ) && ( a.mTarget.y == b.mTarget.y ) && ( a.mTarget.z == b.mTarget.z ) ;
+}
+
+
+
+
+/*! \brief Run unit tests on Session
+*/
+/* static */ void Session::UnitTest( void )
+{
+    fprintf( stderr , "Session::UnitTest------------------------\n" ) ;
+
+    static const char strFilename[] = "sessionUnitTest.txt" ;
+
+    SessionEvent events[ 3 ] ;
+    memset( events , 0 , sizeof( events ) ) ;
+    events[ 0 ].mUpdate = 0 ;   events[ 0 ].mType = SessionEvent::SPECIAL_KEY ;   events[ 0 ].mCode = 3 ;
+    events[ 1 ].mUpdate = 4 ;   events[ 1 ].mType = SessionEvent::MOUSE_BUTTON ;  events[ 1 ].mCode = 2 ;   events[ 1 ].mState = 1 ;  events[ 1 ].mX = 320 ; events[ 1 ].mY = 240 ;
+    events[ 2 ].mUpdate = 9 ;   events[ 2 ].mType = SessionEvent::MOUSE_MOTION ;  events[ 2 ].mX = -7 ;   events[ 2 ].mY = 1023 ;
+    for( unsigned iEvent = 0 ; iEvent < 3 ; ++ iEvent )
+    {   // Use camera values that do not have short decimal representations, so they test that floats read back exactly.
+        events[ iEvent ].mEye       = Vec3( 1.0f / 3.0f , -7.25e3f , 0.1f * float( iEvent + 1 ) ) ;
+        events[ iEvent ].mTarget    = Vec3( 3.14159274f , 1.0e-7f , - 2.0f / 7.0f ) ;
+    }
+
+    {   // Test that a complete capture, including a checkpoint restart, loads back exactly.
+        {
+            Session capture ;
+            assert( ! capture.IsCapturing() ) ;
+            const bool bBegan = capture.BeginCapture( strFilename , 12345 ) ;
+            assert( bBegan && capture.IsCapturing() ) ;
+            capture.RecordRestart( "checkpoint.vort" , 2 ) ;
+            for( unsigned iEvent = 0 ; iEvent < 3 ; ++ iEvent )
+            {
+                capture.Record( events[ iEvent ] ) ;
+            }
+            capture.EndCapture( 17 ) ;
+            assert( ! capture.IsCapturing() ) ;
+        }
+        Session replay ;
+        const bool bLoaded = replay.Load( strFilename ) ;
+        assert( bLoaded ) ;
+        assert( 12345 == replay.GetRandomSeed() ) ;
+        assert( 17 == replay.GetNumUpdates() ) ;
+        assert( replay.GetRestartFilename() && ( 0 == strcmp( replay.GetRestartFilename() , "checkpoint.vort" ) ) ) ;
+        assert( 2 == replay.GetRestartRefinement() ) ;
+        assert( 3 == replay.GetEvents().Size() ) ;
+        for( unsigned iEvent = 0 ; iEvent < 3 ; ++ iEvent )
+        {
+            assert( EventsMatch( replay.GetEvents()[ iEvent ] , events[ iEvent ] ) ) ;
+            assert( replay.GetEvents()[ iEvent ].mSeconds >= 0.0 ) ;
+        }
+        assert( replay.GetEvents()[ 1 ].mSeconds >= replay.GetEvents()[ 0 ].mSeconds ) ;
+        fprintf( stderr , "session: complete capture loaded %u events over %u updates\n" , (unsigned) replay.GetEvents().Size() , replay.GetNumUpdates() ) ;
+    }
+
+    {   // Test that a capture which ended abruptly, without a restart, spans updates through its last event.
+        {
+            Session capture ;
+            capture.BeginCapture( strFilename , 7 ) ;
+            capture.Record( events[ 0 ] ) ;
+            capture.Record( events[ 1 ] ) ;
+        }   // Destructor closes file without recording the end.
+        Session replay ;
+        const bool bLoaded = replay.Load( strFilename ) ;
+        assert( bLoaded ) ;
+        assert( 7 == replay.GetRandomSeed() ) ;
+        assert( 0 == replay.GetRestartFilename() ) ;
+        assert( 2 == replay.GetEvents().Size() ) ;
+        assert( events[ 1 ].mUpdate + 1 == replay.GetNumUpdates() ) ;
+        fprintf( stderr , "session: abrupt capture loaded %u events over %u updates\n" , (unsigned) replay.GetEvents().Size() , replay.GetNumUpdates() ) ;
+    }
+
+    {   // Test that Load rejects files that are not sessions.
+        FILE * pFile = fopen( strFilename , "w" ) ;
+        assert( pFile ) ;
+        fprintf( pFile , "seed 99\nend 5\n" ) ;
+        fclose( pFile ) ;
+        Session replay ;
+        assert( ! replay.Load( strFilename ) ) ;
+        assert( ! replay.Load( "sessionUnitTestMissing.txt" ) ) ;
+    }
+
+    remove( strFilename ) ;
+
+    fprintf( stderr , "Session::UnitTest END ------------------------\n" ) ;
+}
@@ -51,6 +51,7 @@
 
     #include "tbb/task_scheduler_init.h"
     #include "tbb/parallel_for.h"
+    #include "tbb/parallel_sort.h"
     #include "tbb/blocked_range.h"
     #include "tbb/tick_count.h"
 #endif
@@ -41,6 +41,7 @@ using namespace std ;
 #define Capacity            capacity
 #define Clear               clear
 #define Erase               erase
+#define Swap                swap
 
 
 // Macros --------------------------------------------------------------